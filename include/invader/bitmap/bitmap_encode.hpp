@@ -9,6 +9,20 @@
 #include "../tag/hek/definition.hpp"
 
 namespace Invader::BitmapEncode {
+    /**
+     * Quality to use when compressing to DXT1, DXT3, or DXT5
+     */
+    enum DXTCompressionQuality {
+        /** Range fit; fastest, but lowest quality (good for iterating) */
+        DXT_COMPRESSION_QUALITY_FAST,
+
+        /** Cluster fit */
+        DXT_COMPRESSION_QUALITY_NORMAL,
+
+        /** Iterative cluster fit; slowest, but highest quality */
+        DXT_COMPRESSION_QUALITY_BEST
+    };
+
     /**
      * Encode the pixel data to another format
      * @param input_data    input pixel data
@@ -17,9 +31,10 @@ namespace Invader::BitmapEncode {
      * @param width         width in pixels
      * @param height        height in pixels
      * @param dither        dither
+     * @param dxt_quality   quality to use if compressing to DXT
      * @output              encoded data
      */
-    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither = false);
+    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither = false, DXTCompressionQuality dxt_quality = DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST);
     
     /**
      * Encode the pixel data to another format. Use bitmap_data_size() to determine how big output_data should be.
@@ -30,9 +45,10 @@ namespace Invader::BitmapEncode {
      * @param width         width in pixels
      * @param height        height in pixels
      * @param dither        dither
+     * @param dxt_quality   quality to use if compressing to DXT
      * @output              encoded data
      */
-    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither = false);
+    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither = false, DXTCompressionQuality dxt_quality = DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST);
     
     /**
      * Encode the pixel data to another format
@@ -45,9 +61,10 @@ namespace Invader::BitmapEncode {
      * @param type          type of the bitmap
      * @param mipmap_count  number of mipmaps
      * @param dither        dither
+     * @param dxt_quality   quality to use if compressing to DXT
      * @output              encoded data
      */
-    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither = false);
+    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither = false, DXTCompressionQuality dxt_quality = DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST);
     
     /**
      * Encode the pixel data to another format. Use bitmap_data_size() to determine how big output_data should be.
@@ -60,10 +77,42 @@ namespace Invader::BitmapEncode {
      * @param depth         depth of the bitmap
      * @param type          type of the bitmap
      * @param dither        dither
+     * @param dxt_quality   quality to use if compressing to DXT
      * @output              encoded data
      */
-    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither = false);
+    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither = false, DXTCompressionQuality dxt_quality = DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST);
     
+    /**
+     * How far an encoded bitmap is from its source, per channel
+     */
+    struct EncodingError {
+        /** Root-mean-square error of each channel (alpha, red, green, blue) from 0 to 255 */
+        double rmse[4] = {};
+
+        /** Peak signal-to-noise ratio of each channel in decibels (infinity if the channel is lossless) */
+        double psnr[4] = {};
+
+        /**
+         * Get the lowest peak signal-to-noise ratio of any channel
+         * @return worst PSNR in decibels
+         */
+        double worst_psnr() const noexcept;
+    };
+
+    /**
+     * Decode an encoded bitmap and compare it with the bitmap it was encoded from. The source bitmap MUST be in 32-bit BGRA (A8R8G8B8) format.
+     * @param source_data  source pixel data
+     * @param encoded_data encoded pixel data
+     * @param format       format of the encoded pixel data
+     * @param width        width of the bitmap in pixels
+     * @param height       height of the bitmap in pixels
+     * @param depth        depth of the bitmap
+     * @param type         type of the bitmap
+     * @param mipmap_count number of mipmaps
+     * @return             error of each channel, over every face and mipmap
+     */
+    EncodingError measure_encoding_error(const std::byte *source_data, const std::byte *encoded_data, HEK::BitmapDataFormat format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count);
+
     /**
      * Calculate the size of a bitmap
      * @param width        width of the bitmap
@@ -76,6 +125,49 @@ namespace Invader::BitmapEncode {
      */
     std::size_t bitmap_data_size(std::size_t width, std::size_t height, std::size_t depth, std::size_t mipmap_count, HEK::BitmapDataFormat format, HEK::BitmapDataType type) noexcept;
     
+    /**
+     * Properties of a bitmap's pixels used to pick its format
+     */
+    struct PixelAnalysis {
+        enum AlphaPresent {
+            /** Every pixel is fully opaque */
+            ALPHA_PRESENT_NONE = 0,
+
+            /** Every pixel is either fully opaque or fully transparent */
+            ALPHA_PRESENT_ONE_BIT = 1,
+
+            /** At least one pixel is partially transparent */
+            ALPHA_PRESENT_MULTI_BIT = 2
+        };
+
+        /** How much alpha is used */
+        AlphaPresent alpha_present = ALPHA_PRESENT_NONE;
+
+        /** Every pixel's color is white */
+        bool all_white = true;
+
+        /** Every pixel's luminosity is equal to its alpha */
+        bool luminosity_equals_alpha = true;
+
+        /** At least one pixel that isn't fully opaque has a color other than black */
+        bool color_in_transparency = false;
+    };
+
+    /**
+     * Analyze the pixels of a bitmap in one pass. The input bitmap MUST be in 32-bit BGRA (A8R8G8B8) format.
+     * @param input_data  pixel data
+     * @param pixel_count number of pixels
+     * @return            analysis
+     */
+    PixelAnalysis analyze_pixels(const std::byte *input_data, std::size_t pixel_count) noexcept;
+
+    /**
+     * Find the most efficient format without any loss in data from an analysis of the bitmap's pixels
+     * @param analysis analysis from analyze_pixels()
+     * @param category category of formats to use
+     */
+    HEK::BitmapDataFormat most_efficient_format(const PixelAnalysis &analysis, HEK::BitmapFormat category) noexcept;
+
     /**
      * Find the most efficient format without any loss in data. The input bitmap MUST be in 32-bit BGRA (A8R8G8B8) format.
      * @param input_data pixel data
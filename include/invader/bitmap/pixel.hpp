@@ -4,6 +4,7 @@
 #define INVADER__BITMAP__PIXEL_HPP
 
 #include <cstdint>
+#include <cstddef>
 #include <optional>
 
 namespace Invader {
@@ -119,6 +120,17 @@ namespace Invader {
             return rg_convert_to_p8(this->red, this->green, this->blue, this->alpha);
         }
 
+        /**
+         * Convert a row of colors to p8. This is faster than converting each color separately.
+         * @param pixels pixels to convert
+         * @param output p8 indices output
+         * @param count  number of pixels
+         */
+        static void convert_row_to_p8(const Pixel *pixels, std::uint8_t *output, std::size_t count) noexcept {
+            extern void rg_convert_row_to_p8(const std::uint8_t *bgra, std::uint8_t *p8, std::size_t count);
+            rg_convert_row_to_p8(reinterpret_cast<const std::uint8_t *>(pixels), output, count);
+        }
+
         /**
          * Convert p8 to color
          * @param  p8 p8 index
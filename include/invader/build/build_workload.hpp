@@ -3,19 +3,164 @@
 #ifndef INVADER__BUILD__BUILD_WORKLOAD_HPP
 #define INVADER__BUILD__BUILD_WORKLOAD_HPP
 
+#include <algorithm>
 #include <vector>
 #include <optional>
 #include <string>
 #include <filesystem>
+#include <fstream>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <tuple>
+#include <unordered_map>
 #include "../hek/map.hpp"
 #include "../resource/resource_map.hpp"
 #include "../tag/parser/parser.hpp"
 #include "../error_handler/error_handler.hpp"
+#include "../file/tag_path_index.hpp"
+#include "../file/file_prefetcher.hpp"
+#include "../file/memory_mapped_file.hpp"
+#include "../memory_usage.hpp"
 
 namespace Invader {
     class BuildWorkload : public ErrorHandler {
     public:
+        /** Compiled tags kept in memory that can be shared between builds running in the same process */
+        class SharedTagCache {
+        public:
+            /**
+             * Find a compiled tag
+             * @param key cache key of the tag
+             * @return    the cached tag data, or nullptr if it isn't cached
+             */
+            std::shared_ptr<const std::vector<std::byte>> find(std::uint64_t key) const {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                auto iterator = this->tags.find(key);
+                return iterator == this->tags.end() ? nullptr : iterator->second;
+            }
+            
+            /**
+             * Add a compiled tag, replacing it if it was already added
+             * @param key  cache key of the tag
+             * @param data cached tag data
+             */
+            void insert(std::uint64_t key, std::shared_ptr<const std::vector<std::byte>> data) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->tags[key] = std::move(data);
+            }
+            
+        private:
+            mutable std::mutex mutex;
+            std::unordered_map<std::uint64_t, std::shared_ptr<const std::vector<std::byte>>> tags;
+        };
+        
+        /**
+         * Compiled tags kept somewhere other machines can reach, such as a server or a network drive, so a tag compiled on
+         * one machine doesn't have to be compiled on the others. Tags are found by a hash of everything that goes into
+         * compiling them, so which machine compiled them doesn't matter. This can be called by several builds at once.
+         */
+        class RemoteTagCache {
+        public:
+            /**
+             * Fetch a compiled tag
+             * @param key cache key of the tag
+             * @return    the cached tag data, or std::nullopt if it isn't cached or it couldn't be fetched
+             */
+            virtual std::optional<std::vector<std::byte>> fetch(std::uint64_t key) = 0;
+            
+            /**
+             * Store a compiled tag. Failing to store it isn't an error, since it'll just be compiled again.
+             * @param key  cache key of the tag
+             * @param data cached tag data
+             */
+            virtual void store(std::uint64_t key, const std::vector<std::byte> &data) = 0;
+            
+            virtual ~RemoteTagCache() = default;
+        };
+        
+        /**
+         * Remote tag cache in a directory shared between machines, such as a network drive. Tags are written to a
+         * temporary file first and then renamed, so nobody reads a tag that's only partly written.
+         */
+        class DirectoryRemoteTagCache : public RemoteTagCache {
+        public:
+            std::optional<std::vector<std::byte>> fetch(std::uint64_t key) override;
+            void store(std::uint64_t key, const std::vector<std::byte> &data) override;
+            
+            /**
+             * Use a shared directory
+             * @param directory directory to keep the compiled tags in
+             */
+            DirectoryRemoteTagCache(const std::filesystem::path &directory) : directory(directory) {}
+            
+        private:
+            std::filesystem::path directory;
+        };
+        
+        /** Time and memory spent compiling every tag of a tag group */
+        struct TagGroupProfile {
+            /** Number of tags compiled */
+            std::size_t tag_count = 0;
+            
+            /** Time spent reading and parsing the tags */
+            std::chrono::nanoseconds parse_time = {};
+            
+            /** Time spent compiling the tags, including pre_compile() and post_compile() but not their dependencies */
+            std::chrono::nanoseconds compile_time = {};
+            
+            /** Bytes of tag data and raw data allocated for the tags, not counting their dependencies */
+            std::size_t allocated_bytes = 0;
+        };
+        
+        /** Time and memory spent compiling a reflexive, summed over every struct it is in */
+        struct ReflexiveProfile {
+            /** Number of times a non-empty reflexive was compiled */
+            std::size_t compile_count = 0;
+            
+            /** Number of elements compiled */
+            std::size_t element_count = 0;
+            
+            /** Time spent compiling the elements, including reflexives in them but not dependencies */
+            std::chrono::nanoseconds compile_time = {};
+            
+            /** Bytes of tag data and raw data allocated for the elements, including reflexives in them but not dependencies */
+            std::size_t allocated_bytes = 0;
+        };
+        
+        /** Time and memory spent on each build phase, tag group, and reflexive */
+        struct ProfileResults {
+            /** Build phases that were done, in order, with the wall time spent on each */
+            std::vector<std::pair<std::string, std::chrono::nanoseconds>> phases;
+            
+            /** Tag groups that were compiled */
+            std::map<TagFourCC, TagGroupProfile> tag_groups;
+            
+            /** Reflexives that were compiled, by struct and member name (e.g. "ScenarioStructureBSP::clusters") */
+            std::map<std::string, ReflexiveProfile> reflexives;
+        };
+        
+        /** How far along a build is, passed to BuildParameters::progress_callback */
+        struct BuildProgress {
+            /** Build phase that is running (the same names used when profiling), or "Done" once the build is finished */
+            const char *phase = nullptr;
+            
+            /** Number of tags compiled so far */
+            std::size_t tags_compiled = 0;
+            
+            /** Number of tags in the map so far, including ones that are stubbed or not yet compiled */
+            std::size_t tag_count = 0;
+            
+            /** Number of bytes of the cache file laid out so far (before compression) */
+            std::size_t bytes_laid_out = 0;
+        };
+        
         struct BuildParameters {
             /**
             * Select how much is output
@@ -70,17 +215,17 @@ namespace Invader {
             /**
              * Bitmap data
              */
-            std::optional<std::vector<Resource>> bitmap_data;
+            std::optional<ResourceMapView> bitmap_data;
             
             /**
              * Sound data
              */
-            std::optional<std::vector<Resource>> sound_data;
+            std::optional<ResourceMapView> sound_data;
             
             /**
              * Loc data
              */
-            std::optional<std::vector<Resource>> loc_data;
+            std::optional<ResourceMapView> loc_data;
             
             /**
              * How verbose to make the output
@@ -97,6 +242,81 @@ namespace Invader {
              */
             bool optimize_space = false;
             
+            /**
+             * If set, move each node rotation, transform, and scale in a base animation that never moves further than this from its first frame out of the frame data and into the default data, so it's stored once instead of once per frame
+             */
+            std::optional<float> animation_trim_tolerance;
+            
+            /**
+             * Lay out the tag data so each tag's structs are contiguous and frequently accessed tags (globals, HUD, weapons) are together at the front?
+             */
+            bool locality_layout = false;
+            
+            /**
+             * File to keep the layout of the map in. If it exists, each tag's data and bitmap/sound data is put where it was in the previous build whenever it still fits, and anything else is put after it, so consecutive builds only differ where tags changed. The file is then updated with the new layout. Space left behind by tags that grew or were removed is not reused until a build is done without it.
+             */
+            std::optional<std::filesystem::path> stable_layout_path;
+            
+            /**
+             * Move each bitmap's and sound's raw data to a temporary file once its tag is compiled, reading it back only when it's needed, so it isn't all held in memory at once
+             */
+            bool spill_raw_data = false;
+            
+            /**
+             * Only check that the map would build without errors? Bitmap and sound data isn't kept, nothing after the tags are compiled and checked is done, and compile_map() returns an empty vector.
+             */
+            bool check_only = false;
+            
+            /**
+             * Number of threads to use for loading and parsing tags and for compressing Xbox maps. Tags are still compiled in the same order and maps are compressed in fixed chunks, so this does not change the output.
+             */
+            std::size_t thread_count = 1;
+            
+            /**
+             * Directory to keep compiled tags in so unchanged tags don't have to be compiled again on subsequent builds
+             */
+            std::optional<std::filesystem::path> tag_cache_directory;
+            
+            /**
+             * Compiled tags to share with other builds in the same process, such as when building several maps at once. Tags compiled by any of the builds that can be cached are only compiled once.
+             */
+            std::shared_ptr<SharedTagCache> shared_tag_cache;
+            
+            /**
+             * Compiled tags to share with other machines. Tags not found in the other caches are fetched from here, and any tag that is compiled is stored here.
+             */
+            std::shared_ptr<RemoteTagCache> remote_tag_cache;
+            
+            /**
+             * File to write timing and memory usage of each build phase and the slowest tags to as JSON
+             */
+            std::optional<std::filesystem::path> profile_path;
+            
+            /**
+             * File to write the same timings to as Chrome trace events (viewable in chrome://tracing or Perfetto)
+             */
+            std::optional<std::filesystem::path> profile_trace_path;
+            
+            /**
+             * File to write the tag dependency graph to with the time spent on each tag, the critical path (the longest chain of tags that depend on each other), and how much faster the tags could be compiled in parallel at best. This is written as a DOT graph if the file ends in .dot or as JSON otherwise.
+             */
+            std::optional<std::filesystem::path> profile_graph_path;
+            
+            /**
+             * If set, profile the build and store the time and memory spent on each phase, tag group, and reflexive here
+             */
+            std::shared_ptr<ProfileResults> profile_results;
+            
+            /**
+             * If set, this is called on the building thread when each build phase starts and when each tag is compiled
+             */
+            std::function<void (const BuildProgress &)> progress_callback;
+            
+            /**
+             * If set to true while building, the build stops when the next build phase would start and throws BuildCancelledException
+             */
+            std::shared_ptr<std::atomic<bool>> cancelled;
+            
             /**
              * Control how cache files are built. Changing these may result in an incompatible cache file
              */
@@ -225,6 +445,13 @@ namespace Invader {
          */
         static std::vector<std::byte> compile_map(const BuildParameters &parameters);
 
+        /**
+         * Compile a map on another thread. Set parameters.cancelled to stop it early, in which case the future throws BuildCancelledException.
+         * @param parameters build parameters to use (copied so they don't need to outlive the call)
+         * @return           future for the map data
+         */
+        static std::future<std::vector<std::byte>> compile_map_async(BuildParameters parameters);
+
         /**
          * Compile a single tag
          * @param tag               tag to use
@@ -285,10 +512,10 @@ namespace Invader {
             /** Data in the struct */
             std::vector<std::byte> data;
 
-            /** Dependencies in the struct */
+            /** Dependencies in the struct, sorted by offset (use add_dependency() to add them) */
             std::vector<BuildWorkloadDependency> dependencies;
 
-            /** Struct dependencies in the struct */
+            /** Struct dependencies in the struct, sorted by offset (use add_pointer() to add them) */
             std::vector<BuildWorkloadStructPointer> pointers;
 
             /** Offset of the struct in tag data if it's currently present */
@@ -306,14 +533,42 @@ namespace Invader {
              * @return       the struct index if found
              */
             std::optional<std::size_t> resolve_pointer(std::size_t offset) const noexcept {
-                for(auto &p : pointers) {
-                    if(p.offset == offset) {
-                        return p.struct_index;
-                    }
+                auto p = std::lower_bound(this->pointers.begin(), this->pointers.end(), offset, [](const BuildWorkloadStructPointer &pointer, std::size_t offset) { return pointer.offset < offset; });
+                if(p != this->pointers.end() && p->offset == offset) {
+                    return p->struct_index;
                 }
                 return std::nullopt;
             }
 
+            /**
+             * Add a pointer, keeping the pointers sorted by offset
+             * @param offset       offset of the pointer
+             * @param struct_index index of the depended struct
+             * @return             the new pointer (only valid until another pointer is added)
+             */
+            BuildWorkloadStructPointer &add_pointer(std::size_t offset, std::size_t struct_index) {
+                // Pointers are almost always added in order, so this is almost always just an append
+                auto p = std::upper_bound(this->pointers.begin(), this->pointers.end(), offset, [](std::size_t offset, const BuildWorkloadStructPointer &pointer) { return offset < pointer.offset; });
+                auto &pointer = *this->pointers.emplace(p);
+                pointer.offset = offset;
+                pointer.struct_index = struct_index;
+                return pointer;
+            }
+
+            /**
+             * Add a dependency, keeping the dependencies sorted by offset
+             * @param offset    offset of the dependency
+             * @param tag_index index of the depended tag
+             * @return          the new dependency (only valid until another dependency is added)
+             */
+            BuildWorkloadDependency &add_dependency(std::size_t offset, std::size_t tag_index) {
+                auto d = std::upper_bound(this->dependencies.begin(), this->dependencies.end(), offset, [](std::size_t offset, const BuildWorkloadDependency &dependency) { return offset < dependency.offset; });
+                auto &dependency = *this->dependencies.emplace(d);
+                dependency.offset = offset;
+                dependency.tag_index = tag_index;
+                return dependency;
+            }
+
             /**
              * Resolve the pointer at the given address
              * @param pointer_pointer pointer to look at
@@ -348,9 +603,6 @@ namespace Invader {
             /** Class of the tag */
             TagFourCC tag_fourcc;
 
-            /** Original tag class, if applicable */
-            std::optional<TagFourCC> alias;
-
             /** Asset data structs */
             std::vector<std::size_t> asset_data;
 
@@ -393,9 +645,25 @@ namespace Invader {
         /** Model data parts' struct indices and their offsets */
         std::vector<BuildWorkloadModelPart> model_parts;
 
+        struct BuildWorkloadModelDataIndex {
+            /** positions in the model data, keyed by a hash of the data starting at that position */
+            std::unordered_map<std::uint64_t, std::vector<std::size_t>> positions;
+
+            /** number of positions indexed so far */
+            std::size_t indexed_count = 0;
+        };
+
+        /** Indices of uncompressed_model_vertices, compressed_model_vertices, and model_indices for deduping model parts */
+        BuildWorkloadModelDataIndex uncompressed_model_vertices_index;
+        BuildWorkloadModelDataIndex compressed_model_vertices_index;
+        BuildWorkloadModelDataIndex model_indices_index;
+
         /** Raw data for bitmaps and sounds */
         std::vector<std::vector<std::byte>> raw_data;
 
+        /** Predicted resources (tag indices) found under each shared struct (e.g. a shader or model), keyed by struct index */
+        std::unordered_map<std::size_t, std::vector<std::size_t>> predicted_resources;
+
         /** Tags being worked with */
         std::vector<BuildWorkloadTag> tags;
         
@@ -418,6 +686,12 @@ namespace Invader {
         /** Disabling error checking (besides completely invalid tag data) */
         bool disable_error_checking = false;
 
+        /** Warn if blocks exceed the stock limits (i.e. not building for the native engine); set with the build parameters */
+        bool check_stock_limits = false;
+
+        /** Warn if blocks exceed the legacy stock limits (i.e. not building for MCC or the native engine); set with the build parameters */
+        bool check_legacy_stock_limits = false;
+
         /** Are we building a stock map? */
         bool building_stock_map = false;
         
@@ -427,6 +701,79 @@ namespace Invader {
         /** Scenario index? */
         std::size_t scenario_index;
         
+        /** Steps of compiling a tag that are timed when profiling */
+        enum ProfileStep {
+            /** Reading and parsing the tag file */
+            PROFILE_STEP_PARSE,
+            
+            /** pre_compile() of any struct in the tag */
+            PROFILE_STEP_PRE_COMPILE,
+            
+            /** Compiling the tag besides everything else here */
+            PROFILE_STEP_COMPILE,
+            
+            /** post_compile() of any struct in the tag */
+            PROFILE_STEP_POST_COMPILE,
+            
+            PROFILE_STEP_COUNT
+        };
+        
+        /**
+         * Time a step of compiling a tag while this is in scope. Time spent in steps started in the meantime (such as
+         * compiling dependencies) is not counted. This does nothing if not profiling, except count memory allocated in
+         * the meantime towards parsing or compiling if Invader was built with INVADER_MEMORY_USAGE.
+         */
+        class ProfileScope {
+        public:
+            /**
+             * Start timing
+             * @param workload  workload to record the time in
+             * @param tag_index index of the tag
+             * @param step      step being timed
+             */
+            ProfileScope(BuildWorkload &workload, std::size_t tag_index, ProfileStep step);
+            ~ProfileScope();
+            
+            ProfileScope(const ProfileScope &) = delete;
+            ProfileScope &operator=(const ProfileScope &) = delete;
+        private:
+            BuildWorkload *workload;
+            MemoryUsage::Scope memory_usage_scope;
+        };
+        
+        /**
+         * Time compiling the elements of a reflexive while this is in scope. Time spent compiling other tags in the
+         * meantime is not counted. This does nothing if not profiling.
+         */
+        class ReflexiveProfileScope {
+        public:
+            /**
+             * Start timing
+             * @param workload      workload to record the time in
+             * @param name          struct and member name of the reflexive; this must outlive the workload
+             * @param element_count number of elements being compiled
+             */
+            ReflexiveProfileScope(BuildWorkload &workload, const char *name, std::size_t element_count);
+            ~ReflexiveProfileScope();
+            
+            ReflexiveProfileScope(const ReflexiveProfileScope &) = delete;
+            ReflexiveProfileScope &operator=(const ReflexiveProfileScope &) = delete;
+        private:
+            BuildWorkload *workload;
+            const char *name;
+            std::chrono::steady_clock::time_point start;
+            std::size_t struct_start;
+            std::size_t raw_data_start;
+            std::chrono::nanoseconds dependency_time_start;
+            std::size_t dependency_bytes_start;
+        };
+        
+        /**
+         * Get the time and memory spent on each phase, tag group, and reflexive so far
+         * @return results, or std::nullopt if not profiling
+         */
+        std::optional<ProfileResults> get_profile_results() const;
+        
         /** 
          * Get the build parameters
          * @return build parameters
@@ -449,8 +796,9 @@ namespace Invader {
          * @param tag_data_size size of the tag
          * @param tag_index     index of the tag
          * @param tag_fourcc    explicitly give a tag class
+         * @param parsed_tag    already parsed tag data, if available (this will be moved from)
          */
-        void compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagFourCC> tag_fourcc = std::nullopt);
+        void compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagFourCC> tag_fourcc = std::nullopt, Parser::ParserStruct *parsed_tag = nullptr);
         
         ~BuildWorkload() override = default;
 
@@ -467,19 +815,463 @@ namespace Invader {
         std::vector<std::byte> all_raw_data;
         std::size_t generate_tag_data();
         void generate_bitmap_sound_data(std::size_t file_offset);
+        
+        /** Where each tag's data was put in one part of the cache file (tag data or raw data) when using a stable layout */
+        struct StableLayoutSection {
+            /** Offset of each tag's data in the previous build and how much space there is before the next tag's data, by tag path and extension */
+            std::unordered_map<std::string, std::pair<std::size_t, std::size_t>> previous;
+            
+            /** Size of this part in the previous build */
+            std::size_t previous_size = 0;
+            
+            /** Tag path and extension, offset, and size of each tag's data in this build */
+            std::vector<std::tuple<std::string, std::size_t, std::size_t>> current;
+        };
+        
+        /** Stable layout of the tag data */
+        StableLayoutSection stable_tag_data_layout;
+        
+        /** Stable layout of the raw data */
+        StableLayoutSection stable_raw_data_layout;
+        
+        /**
+         * Read the previous build's layout from the stable layout file, if there is one
+         */
+        void read_stable_layout();
+        
+        /**
+         * Write this build's layout to the stable layout file
+         */
+        void write_stable_layout();
+        
+        /**
+         * Find where a tag's data goes, recording it in the section
+         * @param section   section the data is in
+         * @param tag_index index of the tag
+         * @param offset    offset the data was appended at
+         * @param size      size of the data
+         * @param start     lowest offset tag data can be put at
+         * @return          offset the data was at in the previous build if it still fits there, or offset otherwise
+         */
+        std::size_t place_stable_layout_data(StableLayoutSection &section, std::size_t tag_index, std::size_t offset, std::size_t size, std::size_t start);
         HEK::TagString scenario_name = {};
         void set_scenario_name(const char *name);
         std::size_t raw_bitmap_size = 0;
         std::size_t raw_sound_size = 0;
         void externalize_tags() noexcept;
         void delete_raw_data(std::size_t index);
+        
+        /** Errors found while checking a tag against a resource map, which are reported once every tag is checked so they stay in order */
+        class ResourceMatchErrors {
+        public:
+            /**
+             * Instantiate a list of errors
+             * @param handler handler the errors will be reported to
+             */
+            ResourceMatchErrors(const ErrorHandler &handler) noexcept : handler(&handler) {}
+            
+            /**
+             * Get whether errors of the given type are shown by the handler the errors will be reported to
+             * @param type error type
+             * @return     true if shown
+             */
+            bool is_reported(ErrorType type) const noexcept {
+                return this->handler->is_reported(type);
+            }
+            
+            /**
+             * Add an error
+             * @param type      error type
+             * @param error     error message
+             * @param tag_index tag index
+             */
+            void report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index = std::nullopt);
+            
+            /**
+             * Report the errors
+             * @param handler handler to report the errors to
+             */
+            void report_to(ErrorHandler &handler) const;
+            
+        private:
+            const ErrorHandler *handler;
+            std::vector<std::tuple<ErrorType, std::string, std::optional<std::size_t>>> errors;
+        };
+        
+        /**
+         * Check if a bitmap tag matches a bitmap in bitmaps.map. This only reads the workload, so tags can be checked on multiple threads.
+         * @param tag_index index of the tag
+         * @param bitmaps   resource map
+         * @param index     index of the tag in the resource map (the raw data is the resource before it)
+         * @param errors    errors found if the resource map is corrupt
+         * @param buffer    buffer to read spilled raw data into
+         * @return          true if it matches, false if not, or std::nullopt if the resource map is too corrupt to say
+         */
+        std::optional<bool> bitmap_matches_resource(std::size_t tag_index, const ResourceMapView &bitmaps, std::size_t index, ResourceMatchErrors &errors, std::vector<std::byte> &buffer) const;
+        
+        /**
+         * Check if a sound tag matches a sound in sounds.map. This only reads the workload, so tags can be checked on multiple threads.
+         * @param tag_index index of the tag
+         * @param sounds    resource map
+         * @param index     index of the tag in the resource map (the raw data is the resource before it)
+         * @param errors    errors found if the resource map is corrupt
+         * @param buffer    buffer to read spilled raw data into
+         * @return          true if it matches, false if not, or std::nullopt if the resource map is too corrupt to say
+         */
+        std::optional<bool> sound_matches_resource(std::size_t tag_index, const ResourceMapView &sounds, std::size_t index, ResourceMatchErrors &errors, std::vector<std::byte> &buffer) const;
+        
+        /**
+         * Check if a font, unicode_string_list, or hud_message_text tag matches the one in loc.map. This only reads the workload, so tags can be checked on multiple threads.
+         * @param tag_index index of the tag
+         * @param loc       resource map
+         * @param index     index of the tag in the resource map
+         * @param errors    errors found if the resource map is corrupt
+         * @return          true if it matches
+         */
+        bool loc_matches_resource(std::size_t tag_index, const ResourceMapView &loc, std::size_t index, ResourceMatchErrors &errors) const;
+        
+        /** Temporary file raw data is spilled to, removed once the workload is done with it */
+        struct RawDataSpillFile {
+            /** Path to the file */
+            std::filesystem::path path;
+            
+            /** Stream for reading and writing the file */
+            std::fstream stream;
+            
+            /** Held while reading raw data back with get_raw_data() from multiple threads */
+            std::mutex mutex;
+            
+            ~RawDataSpillFile();
+        };
+        
+        /** Spill file, if anything was spilled */
+        std::shared_ptr<RawDataSpillFile> raw_data_spill_file;
+        
+        /** Offset and size in the spill file of each raw data, if it was spilled */
+        std::vector<std::optional<std::pair<std::uint64_t, std::size_t>>> spilled_raw_data;
+        
+        /** Last raw data read back from the spill file */
+        std::vector<std::byte> spilled_raw_data_buffer;
+        
+        /**
+         * Move the tag's raw data to the spill file
+         * @param tag_index index of the tag
+         */
+        void spill_raw_data(std::size_t tag_index);
+        
+        /**
+         * Get the raw data, reading it back from the spill file if it was spilled
+         * @param index index of the raw data
+         * @return      raw data; if spilled, this is only valid until the next call
+         */
+        const std::vector<std::byte> &get_raw_data(std::size_t index);
+        
+        /**
+         * Get the raw data, reading it back into the buffer if it was spilled. This can be called from multiple threads.
+         * @param index  index of the raw data
+         * @param buffer buffer to read the raw data into if it was spilled
+         * @return       raw data, or buffer if it was spilled
+         */
+        const std::vector<std::byte> &get_raw_data(std::size_t index, std::vector<std::byte> &buffer) const;
+        
+        /**
+         * Get the size of the raw data, including if it was spilled
+         * @param index index of the raw data
+         * @return      size in bytes
+         */
+        std::size_t get_raw_data_size(std::size_t index) const noexcept;
         std::size_t stubbed_tag_count = 0;
         std::size_t indexed_data_amount = 0;
         std::size_t raw_data_indices_offset;
         std::uint32_t tag_file_checksums = 0;
         const BuildParameters *parameters = nullptr;
+
+        /**
+         * Set the build parameters, resolving anything that depends on the target engine so it doesn't have to be checked
+         * for every struct compiled
+         * @param parameters parameters to use
+         */
+        void set_build_parameters(const BuildParameters &parameters) noexcept;
+
         void generate_compressed_model_tag_array();
         void check_hud_text_indices();
+
+        /**
+         * Print how many errors there were and throw if there were any
+         * @throws InvalidTagDataException if any errors were reported
+         */
+        void fail_if_errors();
+        
+        /** Progress passed to the progress callback */
+        BuildProgress progress;
+        
+        /**
+         * Pass the progress to the progress callback, if there is one
+         * @param phase phase to report, or nullptr to keep the current one
+         */
+        void report_progress(const char *phase = nullptr);
+        
+        /** Tag that was loaded and parsed ahead of time */
+        struct PreloadedTag {
+            /** Tag file data, mapped so the tag isn't copied into memory while it waits to be compiled */
+            std::shared_ptr<File::MemoryMappedFile> data;
+            
+            /** Parsed tag data */
+            std::shared_ptr<Parser::ParserStruct> parsed;
+            
+            /** Time spent loading and parsing it */
+            std::chrono::nanoseconds parse_time;
+        };
+        
+        /** Index of tags by path and class, kept in sync with tags */
+        File::TagPathIndex tag_lookup;
+        
+        /**
+         * Add the tag to the tag lookup index
+         * @param tag_index index of the tag
+         */
+        void index_tag(std::size_t tag_index);
+        
+        /**
+         * Remove the tag from the tag lookup index. This must be done before changing the tag's path or class.
+         * @param tag_index index of the tag
+         */
+        void unindex_tag(std::size_t tag_index);
+        
+        /** Highest priority file of each tag in the tags directories, keyed by its preferred path with an extension; only built if there are multiple tags directories */
+        std::optional<std::unordered_map<std::string, std::filesystem::path>> tag_file_index;
+        
+        /**
+         * Find the file of a tag, using the tag file index if it was built
+         * @param formatted_path preferred path of the tag with an extension
+         * @return               path to the file, or std::nullopt if it wasn't found
+         */
+        std::optional<std::filesystem::path> find_tag_file(const std::string &formatted_path) const;
+        
+        /** Reads tag files in the background while compiling on one thread, keyed by their preferred path with an extension */
+        std::shared_ptr<File::FilePrefetcher> prefetcher;
+        
+        /**
+         * Queue the dependencies of a parsed tag to be read in the background if they haven't been compiled yet
+         * @param tag parsed tag
+         */
+        void prefetch_dependencies(const Parser::ParserStruct &tag);
+        
+        /** Tags that were loaded ahead of time, keyed by their preferred path with an extension */
+        std::map<std::string, PreloadedTag> preloaded_tags;
+        
+        /** Tags that were queued for preloading, keyed the same way */
+        std::set<std::string> preload_queued_tags;
+        
+        /**
+         * Load and parse the given tags and their dependencies in parallel if multiple threads are used
+         * @param tags_to_preload tags to load
+         */
+        void preload_tags(const std::vector<File::TagFilePath> &tags_to_preload);
+        
+        /** Tag currently being compiled that may be stored in the tag cache */
+        struct TagCacheRecording {
+            /** Index of the tag */
+            std::size_t tag_index;
+            
+            /** Cache key of the tag */
+            std::uint64_t key;
+            
+            /** Tags compiled directly by this tag, in order, and the indices they returned */
+            std::vector<std::pair<File::TagFilePath, std::size_t>> calls;
+            
+            /** Number of structs created by this tag before each call and after the last call */
+            std::vector<std::size_t> struct_counts;
+            
+            /** Indices of structs created by this tag, in order */
+            std::vector<std::size_t> struct_indices;
+            
+            /** Struct count at the start of the current run of structs */
+            std::size_t struct_start;
+            
+            /** State of the workload at the start of the current run of structs, used to detect anything that can't be cached */
+            std::vector<std::size_t> side_effects;
+            
+            /** The tag can be cached */
+            bool cacheable = true;
+        };
+        
+        /** Tags currently being recorded for the tag cache, innermost last */
+        std::vector<TagCacheRecording> tag_cache_recordings;
+        
+        /**
+         * Add the tag, recording the call for the tag cache if needed
+         * @param tag_path      path of the tag
+         * @param tag_fourcc    class of the tag
+         * @return              index of the tag
+         */
+        std::size_t compile_tag_recursively_internal(const char *tag_path, TagFourCC tag_fourcc);
+        
+        /**
+         * End the current run of structs created by the recorded tag
+         * @param recording recording to use
+         */
+        void end_tag_cache_struct_run(TagCacheRecording &recording);
+        
+        /**
+         * Get the cache key of the tag if it can be cached
+         * @param tag_data      tag data
+         * @param tag_data_size size of the tag data
+         * @param tag_index     index of the tag
+         * @param tag_fourcc    class of the tag
+         * @return              cache key if the tag can be cached
+         */
+        std::optional<std::uint64_t> get_tag_cache_key(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, TagFourCC tag_fourcc) const;
+        
+        /**
+         * Get the path of the cached tag
+         * @param key cache key
+         * @return    path to the cached tag
+         */
+        std::filesystem::path get_tag_cache_path(std::uint64_t key) const;
+        
+        /**
+         * Compile the tag from the tag cache if it's there
+         * @param key       cache key
+         * @param tag_index index of the tag
+         * @return          true if the tag was compiled from the cache
+         */
+        bool load_cached_tag(std::uint64_t key, std::size_t tag_index);
+        
+        /**
+         * Start recording the tag for the tag cache
+         * @param key       cache key
+         * @param tag_index index of the tag
+         */
+        void begin_tag_cache_recording(std::uint64_t key, std::size_t tag_index);
+        
+        /**
+         * Stop recording the tag and store it in the tag cache if it can be cached
+         * @param tag_index index of the tag
+         */
+        void end_tag_cache_recording(std::size_t tag_index);
+        
+        /** Everything recorded for --profile */
+        struct Profile {
+            struct Phase {
+                /** Name of the phase */
+                const char *name;
+                
+                /** Wall time since the build started at the start of the phase */
+                std::chrono::nanoseconds start;
+                
+                /** Wall time spent */
+                std::chrono::nanoseconds wall_time;
+                
+                /** CPU time spent on all threads */
+                std::chrono::nanoseconds cpu_time;
+                
+                /** Peak resident memory usage (in bytes) by the end of the phase */
+                std::size_t peak_rss;
+            };
+            
+            /** Phases done so far; the last one is still going if phase_running is set */
+            std::vector<Phase> phases;
+            bool phase_running = false;
+            
+            /** Process CPU time at the start of the current phase */
+            std::chrono::nanoseconds phase_cpu_start;
+            
+            struct Frame {
+                std::size_t tag_index;
+                ProfileStep step;
+                std::chrono::steady_clock::time_point start;
+                
+                /** Time spent in frames started inside of this one */
+                std::chrono::nanoseconds children;
+                
+                /** Number of structs and raw data when the frame started */
+                std::size_t struct_start;
+                std::size_t raw_data_start;
+                
+                /** Bytes allocated in frames started inside of this one */
+                std::size_t children_bytes;
+                
+                /** dependency_time and dependency_bytes when the frame started */
+                std::chrono::nanoseconds dependency_time_start;
+                std::size_t dependency_bytes_start;
+            };
+            
+            /** Steps currently being timed, innermost last */
+            std::vector<Frame> frames;
+            
+            /** Time spent in each step, indexed by tag */
+            std::vector<std::array<std::chrono::nanoseconds, PROFILE_STEP_COUNT>> tag_times;
+            
+            /** Bytes allocated by each tag, not counting its dependencies */
+            std::vector<std::size_t> tag_bytes;
+            
+            /** Wall time and bytes allocated in frames of a different tag than the frame they were started in */
+            std::chrono::nanoseconds dependency_time = {};
+            std::size_t dependency_bytes = 0;
+            
+            /** Reflexives compiled, by name */
+            std::map<const char *, ReflexiveProfile> reflexives;
+            
+            struct TraceEvent {
+                std::size_t tag_index;
+                ProfileStep step;
+                std::chrono::nanoseconds start;
+                std::chrono::nanoseconds duration;
+            };
+            
+            /** Every step timed, if writing a trace */
+            std::vector<TraceEvent> trace_events;
+            
+            /** Number of structs before deduping */
+            std::size_t struct_count = 0;
+            
+            /** Number of structs merged by deduping and the tag space saved */
+            std::size_t deduped_struct_count = 0;
+            std::size_t dedupe_savings = 0;
+        };
+        
+        /** Set if profiling */
+        std::shared_ptr<Profile> profile;
+        
+        /**
+         * End the current build phase, if any, report the next one to the progress callback, and start timing it
+         * @param name name of the next phase
+         * @throws     BuildCancelledException if the build was cancelled
+         */
+        void begin_profile_phase(const char *name);
+        
+        /**
+         * End the current build phase, if any
+         */
+        void end_profile_phase();
+        
+        /**
+         * Add time to a step of compiling a tag
+         * @param tag_index index of the tag
+         * @param step      step
+         * @param time      time to add
+         */
+        void add_profile_time(std::size_t tag_index, ProfileStep step, std::chrono::nanoseconds time);
+        
+        /**
+         * Get the number of bytes allocated in structs and raw data since the given counts
+         * @param struct_start   number of structs at the start
+         * @param raw_data_start number of raw data at the start
+         * @return               bytes allocated
+         */
+        std::size_t get_allocated_bytes_since(std::size_t struct_start, std::size_t raw_data_start) const noexcept;
+        
+        /**
+         * Write the profile to the files given in the build parameters
+         */
+        void write_profile();
+        
+        /**
+         * Write the tag dependency graph with the time spent on each tag and the critical path
+         * @param path path to write to (DOT if it ends in .dot, JSON otherwise)
+         */
+        void write_profile_graph(const std::filesystem::path &path);
     };
 }
 
@@ -3,8 +3,18 @@
 #ifndef INVADER__COMPRESS__COMPRESSION_HPP
 #define INVADER__COMPRESS__COMPRESSION_HPP
 
+#include <cstddef>
 #include <vector>
 #include <optional>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace Invader::HEK {
+    struct CacheFileHeader;
+}
 
 namespace Invader::Compression {
     /**
@@ -29,13 +39,109 @@ namespace Invader::Compression {
     std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size);
 
     /**
-     * Compress the map data
+     * Check if the map data is a native map compressed into independently decompressible frames
+     * @param data              data pointer
+     * @param data_size         size of the data
+     * @return                  true if the map data is framed
+     */
+    bool is_framed_map_data(const std::byte *data, std::size_t data_size) noexcept;
+
+    /**
+     * Compress the map data. The data is split into chunks which are compressed in parallel and joined into a single stream, so the output is the same regardless of the number of threads. Native maps are instead split into frames which are stored separately with an index so they can also be decompressed in parallel.
      * @param data              data pointer
      * @param data_size         size of the data
      * @param compression_level compression level to use
+     * @param thread_count      number of threads to compress with
      * @return                  vector of compressed data
      */
-    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level = 19);
+    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level = 19, std::size_t thread_count = 1);
+
+    /**
+     * Compresses map data as it is written, so each chunk can be compressed in the background as soon as it is complete
+     * rather than after the whole map is put together. Only the chunks still waiting to be compressed are held
+     * uncompressed. The output is the same as compress_map_data().
+     */
+    class MapCompressor {
+    public:
+        /**
+         * Start the compression threads
+         * @param compression_level compression level to use
+         * @param thread_count      number of threads to compress with
+         */
+        MapCompressor(int compression_level = 19, std::size_t thread_count = 1);
+
+        /**
+         * Stop the compression threads, discarding anything that wasn't finished
+         */
+        ~MapCompressor();
+
+        MapCompressor(const MapCompressor &) = delete;
+        MapCompressor &operator=(const MapCompressor &) = delete;
+
+        /**
+         * Write the next part of the map data, not including the cache file header. This waits if too many chunks are
+         * waiting to be compressed.
+         * @param data      data pointer
+         * @param data_size size of the data
+         * @throws          CompressionFailureException if a chunk failed to compress
+         */
+        void write(const std::byte *data, std::size_t data_size);
+
+        /**
+         * Write zeroes
+         * @param size number of zeroes to write
+         * @throws     CompressionFailureException if a chunk failed to compress
+         */
+        void write_zeroes(std::size_t size);
+
+        /**
+         * Get the number of bytes written so far, including the cache file header
+         * @return number of bytes written
+         */
+        std::size_t get_size() const noexcept {
+            return this->size;
+        }
+
+        /**
+         * Compress whatever is left and put the compressed map together
+         * @param header cache file header of the map
+         * @return       vector of compressed data
+         * @throws       CompressionFailureException if the map isn't sector aligned or failed to compress
+         */
+        std::vector<std::byte> finish(const HEK::CacheFileHeader &header);
+
+    private:
+        struct Chunk {
+            std::vector<std::byte> input;
+            std::size_t dictionary_size;
+            std::size_t size;
+            bool last;
+            bool done = false;
+            std::vector<std::byte> output;
+            unsigned long checksum = 0;
+        };
+
+        void submit_chunk(bool last);
+        void compress_chunks();
+
+        int compression_level;
+        std::size_t max_waiting_chunks;
+        std::size_t size;
+
+        // The end of the previous chunk (for the dictionary), followed by what's been written of the current chunk
+        std::vector<std::byte> pending;
+        std::size_t pending_dictionary_size = 0;
+
+        std::mutex mutex;
+        std::condition_variable chunk_condition;
+        std::condition_variable done_condition;
+        std::deque<Chunk> chunks;
+        std::size_t next_chunk = 0;
+        std::size_t done_chunks = 0;
+        bool failed = false;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+    };
 
     /**
      * Decompress the map data
@@ -45,6 +151,24 @@ namespace Invader::Compression {
      */
     std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size);
 
+    /**
+     * Function for reading compressed data into a buffer. It returns the number of bytes read, which is 0 once there is nothing left to read.
+     */
+    using StreamReadFunction = std::function<std::size_t (std::byte *buffer, std::size_t buffer_size)>;
+
+    /**
+     * Function for writing decompressed data. It receives the decompressed data in order, starting with the cache file header.
+     */
+    using StreamWriteFunction = std::function<void (const std::byte *data, std::size_t data_size)>;
+
+    /**
+     * Decompress the map data incrementally, holding only a small buffer of input and output in memory at a time
+     * @param read  function to read compressed data from
+     * @param write function to write decompressed data to
+     * @return      size of the decompressed data in bytes
+     */
+    std::size_t decompress_map_stream(const StreamReadFunction &read, const StreamWriteFunction &write);
+
     /**
      * Decompress one file to another file, using significantly less memory but also significantly more disk I/O
      * @param input  path to the compressed file
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+#define INVADER__DEPENDENCY__DEPENDENCY_INDEX_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+#include "../file/file.hpp"
+
+namespace Invader {
+    /**
+     * On-disk index of the references of every tag in a set of tags directories.
+     *
+     * Each tag is stored with its size, modification time, and content hash so only tags that changed since the index
+     * was last updated need to be read again.
+     */
+    class DependencyIndex {
+    public:
+        struct Entry {
+            /** Full filesystem path of the tag */
+            std::filesystem::path full_path;
+
+            /** Size of the tag file */
+            std::uint64_t size = 0;
+
+            /** Modification time of the tag file */
+            std::int64_t modification_time = 0;
+
+            /** Hash of the tag file */
+            std::uint64_t content_hash = 0;
+
+            /** Non-empty references in the tag, using Halo path separators */
+            std::vector<File::TagFilePath> dependencies;
+        };
+
+        /**
+         * Load an index. If it doesn't exist or is invalid, an empty index is returned.
+         * @param index_path path to the index
+         * @return           index
+         */
+        static DependencyIndex load(const std::filesystem::path &index_path);
+
+        /**
+         * Save the index
+         * @param index_path path to the index
+         * @return           true if successful
+         */
+        bool save(const std::filesystem::path &index_path) const;
+
+        /**
+         * Bring the index up to date with the tags directories, reading only tags that were added or changed and
+         * removing tags that no longer exist.
+         * @param tags tags directories, ordered by precedence
+         * @return     number of tags that had to be read
+         */
+        std::size_t update(const std::vector<std::filesystem::path> &tags);
+
+        /**
+         * Get the entry for a tag
+         * @param tag tag path using Halo path separators
+         * @return    entry, or nullptr if the tag is not in the index
+         */
+        const Entry *find_tag(const File::TagFilePath &tag) const;
+
+        /**
+         * Find all tags that reference the given tag
+         * @param tag tag path using Halo path separators
+         * @return    tags that reference it, using Halo path separators, sorted by path
+         */
+        std::vector<File::TagFilePath> find_referencing_tags(const File::TagFilePath &tag) const;
+
+        /**
+         * Get all tags in the index
+         * @return tags, using Halo path separators
+         */
+        const std::map<File::TagFilePath, Entry> &get_tags() const noexcept {
+            return this->tags;
+        }
+
+    private:
+        std::map<File::TagFilePath, Entry> tags;
+    };
+}
+
+#endif
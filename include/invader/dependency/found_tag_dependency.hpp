@@ -10,13 +10,26 @@
 #include "../hek/fourcc.hpp"
 
 namespace Invader {
+    class DependencyIndex;
+
     struct FoundTagDependency {
         std::string path;
         Invader::TagFourCC fourcc;
         bool broken;
         std::optional<std::filesystem::path> file_path;
 
-        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success);
+        /**
+         * Find the dependencies of a tag or, if reverse is set, the tags that depend on it
+         * @param tag_path_to_find tag path
+         * @param tag_int_to_find  tag class
+         * @param tags             tags directories, ordered by precedence
+         * @param reverse          find tags that depend on the tag instead
+         * @param recursive        also find dependencies of dependencies (not used if reverse is set)
+         * @param success          set to false if a tag could not be opened
+         * @param index            if set, use this up-to-date index instead of reading tags where possible
+         * @return                 tags found
+         */
+        static std::vector<FoundTagDependency> find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success, const DependencyIndex *index = nullptr);
 
         FoundTagDependency(std::string path, Invader::TagFourCC fourcc, bool broken, std::optional<std::filesystem::path> file_path) : path(path), fourcc(fourcc), broken(broken), file_path(file_path) {}
     };
@@ -161,5 +161,15 @@ namespace Invader {
      * This is thrown when a resource map was not supplied when it should have
      */
     DEFINE_EXCEPTION(ResourceMapRequiredException, "no resource map was supplied");
+
+    /**
+     * This is thrown when a build was cancelled
+     */
+    DEFINE_EXCEPTION(BuildCancelledException, "build was cancelled");
+
+    /**
+     * This is thrown when a patch is invalid or was made for a different file
+     */
+    DEFINE_EXCEPTION(InvalidPatchException, "patch is invalid");
 }
 #endif
@@ -70,6 +70,23 @@ namespace Invader {
          */
         void report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index = std::nullopt);
         
+        /**
+         * Get whether errors of the given type are shown at the current reporting level. Use this to skip putting
+         * together messages (or doing checks) that would only be thrown away.
+         * @param type error type
+         * @return     true if shown
+         */
+        bool is_reported(ErrorType type) const noexcept {
+            switch(type) {
+                case ErrorType::ERROR_TYPE_WARNING_PEDANTIC:
+                    return this->reporting_level > ReportingLevel::REPORTING_LEVEL_HIDE_ALL_PEDANTIC_WARNINGS;
+                case ErrorType::ERROR_TYPE_WARNING:
+                    return this->reporting_level > ReportingLevel::REPORTING_LEVEL_HIDE_ALL_WARNINGS;
+                default:
+                    return this->reporting_level > ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING;
+            }
+        }
+        
         /**
          * Get the number of warnings reported
          * @return number of warnings
@@ -126,10 +143,13 @@ namespace Invader {
         
     };
     
+    // The message (and anything in the arguments, like path conversions) is only put together if it will be shown
     #define REPORT_ERROR_PRINTF(handler, type, tag_index, ...) { \
-        char report_error_message[2048]; \
-        std::snprintf(report_error_message, sizeof(report_error_message), __VA_ARGS__); \
-        (handler).report_error(Invader::ErrorHandler::ErrorType::type, report_error_message, tag_index); \
+        if((handler).is_reported(Invader::ErrorHandler::ErrorType::type)) { \
+            char report_error_message[2048]; \
+            std::snprintf(report_error_message, sizeof(report_error_message), __VA_ARGS__); \
+            (handler).report_error(Invader::ErrorHandler::ErrorType::type, report_error_message, tag_index); \
+        } \
     }
 }
 
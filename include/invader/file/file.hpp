@@ -3,10 +3,12 @@
 #ifndef INVADER__FILE__FILE_HPP
 #define INVADER__FILE__FILE_HPP
 
+#include <atomic>
 #include <vector>
 #include <cstdlib>
 #include <filesystem>
 #include <optional>
+#include <string_view>
 #include <mutex>
 
 #include "../hek/fourcc.hpp"
@@ -76,6 +78,13 @@ namespace Invader::File {
      */
     bool save_file(const std::filesystem::path &path, const std::vector<std::byte> &data);
 
+    /**
+     * Hash the file's size and modification time, which is enough to tell if it was touched without reading it
+     * @param  path path to the file
+     * @return      hash, or std::nullopt if the file couldn't be checked
+     */
+    std::optional<std::uint64_t> stamp_file(const std::filesystem::path &path);
+
     /**
      * Convert a tag path to a file path for one tags directory. The file must exist, or std::nullopt will be returned.
      * @param  tag_path   tag path to use
@@ -163,9 +172,10 @@ namespace Invader::File {
      * @param  filter_duplicates filter out duplicates (by default)
      * @param  status            optional pointer to a size_t to store the current number of tags loaded (for status messages)
      * @param  errors            optional pointer to hold the number of errors
-     * @return                   all tags in the folder
+     * @param  cancel            optional flag that, when set from another thread, stops listing early
+     * @return                   all tags in the folder, or nothing if cancelled
      */
-    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates = true, std::pair<std::mutex, std::size_t> *status = nullptr, std::size_t *errors = nullptr);
+    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates = true, std::pair<std::mutex, std::size_t> *status = nullptr, std::size_t *errors = nullptr, const std::atomic<bool> *cancel = nullptr);
 
     /**
      * Convert the tag path to a path using the system's preferred separators
@@ -213,6 +223,13 @@ namespace Invader::File {
      */
     std::string remove_duplicate_slashes(const std::string &path);
 
+    /**
+     * Check if the path has any duplicate slashes without copying it
+     * @param  path path to check
+     * @return      true if remove_duplicate_slashes would change the path
+     */
+    bool has_duplicate_slashes(std::string_view path) noexcept;
+
     /**
      * Remove duplicate slashes from the path
      * @param  path path to remove duplicate slashes from
@@ -240,6 +257,14 @@ namespace Invader::File {
      * @return                base name
      */
     std::string base_name(const std::string &tag_path, bool drop_extension = false);
+
+    /**
+     * Get the base name of the tag path without copying it
+     * @param  tag_path       tag path to get
+     * @param  drop_extension drop the extension
+     * @return                view into tag_path of the base name
+     */
+    std::string_view base_name_view(std::string_view tag_path, bool drop_extension = false) noexcept;
     
     /**
      * Check working directory (April Fools)
@@ -263,6 +288,49 @@ namespace Invader::File {
      * @return        true if a match was found
      */
     bool path_matches(const char *path, const std::vector<std::string> &include, const std::vector<std::string> &exclude) noexcept;
+    
+    /**
+     * Include and exclude patterns (with the same syntax as path_matches) compiled into one automaton, so each path is
+     * checked against every pattern in a single pass without backtracking
+     */
+    class PathMatcher {
+    public:
+        /**
+         * Compile the patterns
+         * @param include include patterns to check (empty matches all)
+         * @param exclude exclude patterns to check
+         */
+        PathMatcher(const std::vector<std::string> &include, const std::vector<std::string> &exclude);
+        
+        /**
+         * Check if the path matches an include pattern (or there are none) and no exclude pattern
+         * @param path path to check
+         * @return     true if a match was found
+         */
+        bool matches(const char *path) const noexcept;
+        
+    private:
+        /** Number of 64-bit words needed to hold a bit for every state */
+        std::size_t word_count = 0;
+        
+        /** States active before anything is read */
+        std::vector<std::uint64_t> start_states;
+        
+        /** States at a '*' which stay active on any character */
+        std::vector<std::uint64_t> star_states;
+        
+        /** States that advance to the next state on each byte (256 * word_count) */
+        std::vector<std::uint64_t> advancing_states;
+        
+        /** States at the end of an include pattern */
+        std::vector<std::uint64_t> include_states;
+        
+        /** States at the end of an exclude pattern */
+        std::vector<std::uint64_t> exclude_states;
+        
+        /** Match everything not excluded if there are no include patterns */
+        bool include_all;
+    };
 }
 
 #endif
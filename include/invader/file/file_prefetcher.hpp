@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__FILE_PREFETCHER_HPP
+#define INVADER__FILE__FILE_PREFETCHER_HPP
+
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Reads files on background threads so they are already in memory by the time they are needed. Files are
+     * identified by a key which is resolved to a path on the reading thread, so finding the file doesn't hold up the
+     * caller, either.
+     */
+    class FilePrefetcher {
+    public:
+        /** Function used to find the file of a key, returning std::nullopt if there isn't one */
+        using Resolver = std::function<std::optional<std::filesystem::path> (const std::string &key)>;
+
+        /**
+         * Start the reading threads
+         * @param resolver     function to find the file of a key; this is called from the reading threads
+         * @param thread_count number of files to read at once
+         */
+        FilePrefetcher(Resolver resolver, std::size_t thread_count);
+
+        /**
+         * Stop the reading threads, discarding anything that wasn't taken
+         */
+        ~FilePrefetcher();
+
+        FilePrefetcher(const FilePrefetcher &) = delete;
+        FilePrefetcher &operator=(const FilePrefetcher &) = delete;
+
+        /**
+         * Queue the file to be read. Keys that were already queued before are ignored.
+         * @param key key of the file
+         */
+        void prefetch(const std::string &key);
+
+        /**
+         * Take the data of a file that was queued, waiting for it if it is being read. If it hasn't started being read
+         * yet, it is removed from the queue so the caller can read it.
+         * @param key key of the file
+         * @return    the file data, or std::nullopt if the file wasn't queued, wasn't read yet, or failed to be read
+         */
+        std::optional<std::vector<std::byte>> take(const std::string &key);
+
+    private:
+        struct Request {
+            bool started = false;
+            bool done = false;
+            std::optional<std::vector<std::byte>> data;
+        };
+
+        void read_files();
+
+        Resolver resolver;
+        std::mutex mutex;
+        std::condition_variable queue_condition;
+        std::condition_variable done_condition;
+        std::deque<std::string> queue;
+        std::unordered_map<std::string, Request> requests;
+        std::unordered_set<std::string> queued_keys;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+    };
+}
+
+#endif
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__FILE_WRITER_HPP
+#define INVADER__FILE__FILE_WRITER_HPP
+
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Writes files on background threads so the caller can keep going instead of waiting on each file. Parent directories
+     * are created as needed, and each directory is only created once.
+     */
+    class FileWriter {
+    public:
+        /** Function called on a writing thread once a file is written, with whether or not it was saved */
+        using Callback = std::function<void (const std::filesystem::path &path, bool saved)>;
+
+        /**
+         * Start the writing threads
+         * @param thread_count     number of files to write at once
+         * @param max_queued_files number of files that can be waiting to be written before write() waits for one to finish
+         * @param skip_unchanged   don't write files that already exist with the same data (they still count as saved)
+         */
+        FileWriter(std::size_t thread_count, std::size_t max_queued_files, bool skip_unchanged = false);
+
+        /**
+         * Write everything still queued, then stop the writing threads
+         */
+        ~FileWriter();
+
+        FileWriter(const FileWriter &) = delete;
+        FileWriter &operator=(const FileWriter &) = delete;
+
+        /**
+         * Queue the file to be written, waiting for room in the queue if it is full
+         * @param path     path to write to
+         * @param data     data to write
+         * @param callback function to call once it is written, if any
+         */
+        void write(std::filesystem::path path, std::vector<std::byte> data, Callback callback = nullptr);
+
+        /**
+         * Write everything still queued, then stop the writing threads. Nothing else can be written afterward.
+         * @return paths of every file that failed to be saved
+         */
+        std::vector<std::filesystem::path> finish();
+
+    private:
+        struct Write {
+            std::filesystem::path path;
+            std::vector<std::byte> data;
+            Callback callback;
+        };
+
+        void write_files();
+        bool save(const Write &write);
+
+        std::size_t max_queued_files;
+        bool skip_unchanged;
+        std::mutex mutex;
+        std::condition_variable queue_condition;
+        std::condition_variable space_condition;
+        std::deque<Write> queue;
+        std::unordered_set<std::filesystem::path::string_type> created_directories;
+        std::vector<std::filesystem::path> failed;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+    };
+}
+
+#endif
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__MEMORY_MAPPED_FILE_HPP
+#define INVADER__FILE__MEMORY_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+
+namespace Invader::File {
+    /**
+     * File mapped into memory. Pages are only read from the disk when they are accessed.
+     *
+     * The mapping is copy-on-write, so the data can be modified without modifying the file.
+     */
+    class MemoryMappedFile {
+    public:
+        /**
+         * Attempt to map the file into memory
+         * @param path path to the file
+         * @return     the mapped file or std::nullopt if failed
+         */
+        static std::optional<MemoryMappedFile> map_file(const std::filesystem::path &path);
+
+        /**
+         * Get the data of the file
+         * @return data of the file
+         */
+        std::byte *data() noexcept {
+            return this->file_data;
+        }
+
+        /**
+         * Get the data of the file
+         * @return data of the file
+         */
+        const std::byte *data() const noexcept {
+            return this->file_data;
+        }
+
+        /**
+         * Get the size of the file
+         * @return size of the file in bytes
+         */
+        std::size_t size() const noexcept {
+            return this->file_size;
+        }
+
+        MemoryMappedFile(MemoryMappedFile &&move) noexcept;
+        MemoryMappedFile &operator=(MemoryMappedFile &&move) noexcept;
+        MemoryMappedFile(const MemoryMappedFile &) = delete;
+        MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+        ~MemoryMappedFile();
+
+    private:
+        MemoryMappedFile() = default;
+        void unmap() noexcept;
+
+        std::byte *file_data = nullptr;
+        std::size_t file_size = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__PATH_INDEX_HPP
+#define INVADER__FILE__PATH_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Index of every three character sequence in a list of paths. Finding the paths that match a pattern only checks the
+     * paths that contain every sequence in the pattern's text (e.g. "*warthog*" only checks paths containing "war",
+     * "art", "rth", "tho", and "hog") rather than every path.
+     */
+    class PathIndex {
+    public:
+        /**
+         * Index the paths
+         * @param paths paths to index
+         */
+        PathIndex(std::vector<std::string> paths);
+
+        /**
+         * Find the paths matching the pattern (with the same syntax as path_matches)
+         * @param pattern pattern to check
+         * @return        indices of the matching paths, in order
+         */
+        std::vector<std::size_t> find(const char *pattern) const;
+
+        /**
+         * Get the number of paths indexed
+         * @return number of paths
+         */
+        std::size_t size() const noexcept {
+            return this->paths.size();
+        }
+
+    private:
+        std::vector<std::string> paths;
+
+        /** Each three character sequence found, in order */
+        std::vector<std::uint32_t> trigrams;
+
+        /** Where each sequence's paths start in trigram_paths, plus the end of the last one */
+        std::vector<std::uint32_t> trigram_offsets;
+
+        /** Indices of the paths containing each sequence, in order */
+        std::vector<std::uint32_t> trigram_paths;
+    };
+}
+
+#endif
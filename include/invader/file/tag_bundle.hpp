@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAG_BUNDLE_HPP
+#define INVADER__FILE__TAG_BUNDLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_mapped_file.hpp"
+
+namespace Invader::File {
+    /**
+     * Tag files packed into one file with a sorted index of their paths, so tags can be found and read without touching
+     * the filesystem for each one. A bundle can be given anywhere a tags directory can.
+     */
+    class TagBundle {
+    public:
+        /** A tag file to put in a bundle */
+        struct BundledTag {
+            /** Path of the tag file relative to the tags directory, including its extension */
+            std::string path;
+
+            /** Tag file data */
+            std::vector<std::byte> data;
+        };
+
+        /**
+         * Open a tag bundle
+         * @param path path to the bundle
+         * @return     the bundle, or std::nullopt if it isn't a valid bundle
+         */
+        static std::optional<TagBundle> open_bundle(const std::filesystem::path &path);
+
+        /**
+         * Get the bundle at the given tags directory, opening it the first time it's asked for
+         * @param tags_directory tags directory, which may be a bundle
+         * @return               the bundle, or nullptr if it isn't a bundle
+         */
+        static std::shared_ptr<const TagBundle> get_bundle(const std::filesystem::path &tags_directory);
+
+        /**
+         * Make a bundle in memory and use it for the given tags directory, replacing any bundle already used for it. The
+         * tags directory does not need to exist, and anything that takes tags directories finds the tags in it without
+         * anything being written to the disk. Put it before other tags directories to use its tags in place of theirs.
+         * @param tags_directory tags directory to use the bundle for (this should not be an existing directory)
+         * @param tags           tags to put in the bundle
+         * @return               the bundle
+         * @throws               InvalidTagPathException if a path is given twice
+         */
+        static std::shared_ptr<const TagBundle> add_memory_bundle(const std::filesystem::path &tags_directory, const std::vector<BundledTag> &tags);
+
+        /**
+         * Read a tag file from a path inside of a bundle that was opened with get_bundle()
+         * @param path path to the tag file, starting with the path to the bundle
+         * @return     the tag file data, or std::nullopt if the path isn't in a bundle
+         */
+        static std::optional<std::vector<std::byte>> open_bundled_file(const std::filesystem::path &path);
+
+        /**
+         * Generate a tag bundle
+         * @param tags     tags to put in the bundle
+         * @param compress compress each tag if it makes it smaller
+         * @return         bundle data
+         * @throws         InvalidTagPathException if a path is given twice
+         */
+        static std::vector<std::byte> generate_bundle(const std::vector<BundledTag> &tags, bool compress);
+
+        /**
+         * Get whether the bundle contains the tag file
+         * @param tag_path path of the tag file, including its extension
+         * @return         true if the bundle contains it
+         */
+        bool contains(std::string_view tag_path) const noexcept;
+
+        /**
+         * Read a tag file from the bundle
+         * @param tag_path path of the tag file, including its extension
+         * @return         the tag file data, or std::nullopt if the bundle does not contain it or it failed to decompress
+         */
+        std::optional<std::vector<std::byte>> read_tag(std::string_view tag_path) const;
+
+        /**
+         * Get the paths of all tag files in the bundle, in sorted order
+         * @return paths of the tag files, using Halo path separators
+         */
+        std::vector<std::string> get_tag_paths() const;
+
+        /**
+         * Get the number of tag files in the bundle
+         * @return number of tag files
+         */
+        std::size_t get_tag_count() const noexcept {
+            return this->entries.size();
+        }
+
+    private:
+        enum Compression : std::uint32_t {
+            COMPRESSION_NONE,
+            COMPRESSION_DEFLATE
+        };
+
+        struct Entry {
+            std::string_view path;
+            Compression compression;
+            std::uint64_t data_offset;
+            std::uint64_t stored_size;
+            std::uint64_t size;
+        };
+
+        TagBundle(MemoryMappedFile &&file) : file(std::move(file)) {}
+        TagBundle(std::vector<std::byte> &&memory) : memory(std::move(memory)) {}
+
+        const Entry *find(std::string_view tag_path) const noexcept;
+        bool read_index(const char *name);
+
+        const std::byte *data() const noexcept {
+            return this->file.has_value() ? this->file->data() : this->memory.data();
+        }
+
+        std::size_t size() const noexcept {
+            return this->file.has_value() ? this->file->size() : this->memory.size();
+        }
+
+        std::optional<MemoryMappedFile> file;
+        std::vector<std::byte> memory;
+        std::vector<Entry> entries;
+    };
+}
+
+#endif
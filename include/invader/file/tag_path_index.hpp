@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAG_PATH_INDEX_HPP
+#define INVADER__FILE__TAG_PATH_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "../hek/fourcc.hpp"
+#include "tag_path_table.hpp"
+
+namespace Invader::File {
+    /**
+     * Hash index for finding a tag's index by its path and class in constant time. Paths are interned in a TagPathTable, so
+     * they are matched case-insensitively and each one is stored once no matter how many classes use it.
+     */
+    class TagPathIndex {
+    public:
+        /**
+         * Add a tag to the index. If other tags share its path and class, the lowest index is found.
+         * @param path   path of the tag
+         * @param fourcc class of the tag
+         * @param index  index of the tag
+         */
+        void add(const std::string &path, TagFourCC fourcc, std::size_t index) {
+            auto key = make_key(this->paths.intern(path), fourcc);
+            auto [iterator, added] = this->indices.try_emplace(key, index);
+            if(added) {
+                return;
+            }
+
+            // Keep the other tags around so they can be found again if the lowest one is removed
+            if(index < iterator->second) {
+                std::swap(index, iterator->second);
+            }
+            this->duplicates[key].emplace_back(index);
+        }
+
+        /**
+         * Remove a tag from the index. If other tags share its path and class, the lowest remaining index is found afterward.
+         * @param path   path of the tag
+         * @param fourcc class of the tag
+         * @param index  index of the tag
+         */
+        void remove(const std::string &path, TagFourCC fourcc, std::size_t index) {
+            auto id = this->paths.find(path);
+            if(!id.has_value()) {
+                return;
+            }
+            auto key = make_key(*id, fourcc);
+            auto iterator = this->indices.find(key);
+            if(iterator == this->indices.end()) {
+                return;
+            }
+
+            auto duplicate = this->duplicates.find(key);
+            if(duplicate == this->duplicates.end()) {
+                if(iterator->second == index) {
+                    this->indices.erase(iterator);
+                }
+                return;
+            }
+
+            // If it's the indexed tag, the lowest of the others takes its place
+            auto &others = duplicate->second;
+            if(iterator->second == index) {
+                auto lowest = std::min_element(others.begin(), others.end());
+                iterator->second = *lowest;
+                others.erase(lowest);
+            }
+            else if(auto other = std::find(others.begin(), others.end(), index); other != others.end()) {
+                others.erase(other);
+            }
+            if(others.empty()) {
+                this->duplicates.erase(duplicate);
+            }
+        }
+
+        /**
+         * Find a tag
+         * @param path   path of the tag
+         * @param fourcc class of the tag
+         * @return       index of the tag if found
+         */
+        std::optional<std::size_t> find(std::string_view path, TagFourCC fourcc) const noexcept {
+            auto id = this->paths.find(path);
+            if(!id.has_value()) {
+                return std::nullopt;
+            }
+            auto iterator = this->indices.find(make_key(*id, fourcc));
+            if(iterator == this->indices.end()) {
+                return std::nullopt;
+            }
+            return iterator->second;
+        }
+
+        /**
+         * Reserve space for the given number of tags
+         * @param count number of tags
+         */
+        void reserve(std::size_t count) {
+            this->indices.reserve(count);
+            this->paths.reserve(count);
+        }
+
+        /**
+         * Remove all tags from the index
+         */
+        void clear() noexcept {
+            this->indices.clear();
+            this->duplicates.clear();
+            this->paths.clear();
+        }
+
+        /**
+         * Get the number of indexed paths and classes
+         * @return number of indexed paths and classes
+         */
+        std::size_t size() const noexcept {
+            return this->indices.size();
+        }
+
+        /**
+         * Get the table the indexed paths are interned in
+         * @return path table
+         */
+        const TagPathTable &get_path_table() const noexcept {
+            return this->paths;
+        }
+
+    private:
+        // Path ID in the upper half, class in the lower half
+        static std::uint64_t make_key(TagPathTable::ID id, TagFourCC fourcc) noexcept {
+            return (static_cast<std::uint64_t>(id) << 32) | static_cast<std::uint32_t>(fourcc);
+        }
+
+        TagPathTable paths;
+        std::unordered_map<std::uint64_t, std::size_t> indices;
+
+        // Every other tag sharing an indexed path and class, which is rare
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> duplicates;
+    };
+}
+
+#endif
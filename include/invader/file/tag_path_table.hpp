@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TAG_PATH_TABLE_HPP
+#define INVADER__FILE__TAG_PATH_TABLE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <unordered_map>
+
+#include "../hash/fnv1a.hpp"
+
+namespace Invader::File {
+    /**
+     * Table of interned tag paths, each stored once and given a compact ID so comparing and hashing paths is done with
+     * integers. Paths are matched like Halo does: case-insensitively, with forward slashes and backslashes treated the same.
+     */
+    class TagPathTable {
+    public:
+        /** ID of a path in the table */
+        using ID = std::uint32_t;
+
+        TagPathTable() = default;
+        TagPathTable(TagPathTable &&) noexcept = default;
+        TagPathTable &operator=(TagPathTable &&) noexcept = default;
+
+        TagPathTable(const TagPathTable &copy) : paths(copy.paths) {
+            this->rebuild_ids();
+        }
+
+        TagPathTable &operator=(const TagPathTable &copy) {
+            this->paths = copy.paths;
+            this->rebuild_ids();
+            return *this;
+        }
+
+        /**
+         * Get the ID of a path, adding it if it is not in the table yet
+         * @param path path to intern
+         * @return     ID of the path
+         */
+        ID intern(std::string_view path) {
+            auto iterator = this->ids.find(path);
+            if(iterator != this->ids.end()) {
+                return iterator->second;
+            }
+
+            auto id = static_cast<ID>(this->paths.size());
+            auto &stored = this->paths.emplace_back(path);
+            this->ids.emplace(stored, id);
+            return id;
+        }
+
+        /**
+         * Get the ID of a path without adding it
+         * @param path path to find
+         * @return     ID of the path if it was interned
+         */
+        std::optional<ID> find(std::string_view path) const noexcept {
+            auto iterator = this->ids.find(path);
+            if(iterator == this->ids.end()) {
+                return std::nullopt;
+            }
+            return iterator->second;
+        }
+
+        /**
+         * Get the path of an ID as it was first interned
+         * @param id ID of the path
+         * @return   path
+         */
+        const std::string &get(ID id) const noexcept {
+            return this->paths[id];
+        }
+
+        /**
+         * Reserve space for the given number of paths
+         * @param count number of paths
+         */
+        void reserve(std::size_t count) {
+            this->ids.reserve(count);
+        }
+
+        /**
+         * Remove all paths from the table, invalidating all IDs
+         */
+        void clear() noexcept {
+            this->ids.clear();
+            this->paths.clear();
+        }
+
+        /**
+         * Get the number of interned paths
+         * @return number of interned paths
+         */
+        std::size_t size() const noexcept {
+            return this->paths.size();
+        }
+
+    private:
+        // The keys are views into paths, so a copy needs its own keys
+        void rebuild_ids() {
+            this->ids.clear();
+            this->ids.reserve(this->paths.size());
+            for(std::size_t i = 0; i < this->paths.size(); i++) {
+                this->ids.emplace(this->paths[i], static_cast<ID>(i));
+            }
+        }
+
+        static constexpr char fold(char c) noexcept {
+            if(c >= 'A' && c <= 'Z') {
+                return static_cast<char>(c - 'A' + 'a');
+            }
+            if(c == '/') {
+                return '\\';
+            }
+            return c;
+        }
+
+        struct PathHash {
+            using is_transparent = void;
+            std::size_t operator()(std::string_view path) const noexcept {
+                FNV1AHash hash;
+                for(char c : path) {
+                    hash.add_byte(static_cast<std::uint8_t>(fold(c)));
+                }
+                return static_cast<std::size_t>(hash.get());
+            }
+        };
+
+        struct PathEqual {
+            using is_transparent = void;
+            bool operator()(std::string_view a, std::string_view b) const noexcept {
+                if(a.size() != b.size()) {
+                    return false;
+                }
+                for(std::size_t i = 0; i < a.size(); i++) {
+                    if(fold(a[i]) != fold(b[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+
+        // Deque so the views used as keys stay valid as paths are added
+        std::deque<std::string> paths;
+        std::unordered_map<std::string_view, ID, PathHash, PathEqual> ids;
+    };
+}
+
+#endif
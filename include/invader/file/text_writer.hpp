@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__FILE__TEXT_WRITER_HPP
+#define INVADER__FILE__TEXT_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Invader::File {
+    /**
+     * Buffer for writing large text files such as JMS files. Numbers are formatted with std::to_chars straight into the
+     * buffer, so they always use '.' as the decimal point regardless of the locale.
+     *
+     * Large files can be written in sections on multiple threads with write_sections(), with each section formatted
+     * into its own writer and then appended in order.
+     */
+    class TextWriter {
+    public:
+        /**
+         * Write text
+         * @param text text to write
+         * @return     this
+         */
+        TextWriter &write(std::string_view text) {
+            this->text.append(text);
+            return *this;
+        }
+
+        /**
+         * Write a character
+         * @param character character to write
+         * @return          this
+         */
+        TextWriter &write(char character) {
+            this->text.push_back(character);
+            return *this;
+        }
+
+        /**
+         * Write a signed integer
+         * @param value value to write
+         * @return      this
+         */
+        TextWriter &write_integer(std::int64_t value);
+
+        /**
+         * Write an unsigned integer
+         * @param value value to write
+         * @return      this
+         */
+        TextWriter &write_unsigned(std::uint64_t value);
+
+        /**
+         * Write a number rounded to a fixed number of decimal places, removing any trailing zeroes after the decimal point
+         * and then the decimal point if nothing is left after it (e.g. 1.5 is written as "1.5" and 2.0 is written as "2")
+         * @param value          value to write
+         * @param decimal_places number of decimal places to round to
+         * @return               this
+         */
+        TextWriter &write_decimal(double value, int decimal_places);
+
+        /**
+         * Write everything that was written to another writer
+         * @param other writer to write from
+         * @return      this
+         */
+        TextWriter &write(const TextWriter &other) {
+            this->text.append(other.text);
+            return *this;
+        }
+
+        /**
+         * Call the function with a writer for each section from 0 to count - 1 on multiple threads, then write what was
+         * written to each section in order
+         * @param count             number of sections
+         * @param function          function to call with each section's writer and index
+         * @param size_per_section  rough number of bytes each section will need, to avoid growing each section's buffer
+         */
+        template<typename F> void write_sections(std::size_t count, const F &function, std::size_t size_per_section = 0) {
+            std::vector<TextWriter> sections(count);
+            for_each_section(count, [&sections, &function, &size_per_section](std::size_t i) {
+                sections[i].reserve(size_per_section);
+                function(sections[i], i);
+            });
+
+            std::size_t total_size = this->text.size();
+            for(auto &s : sections) {
+                total_size += s.text.size();
+            }
+            this->reserve(total_size);
+            for(auto &s : sections) {
+                this->write(s);
+            }
+        }
+
+        /**
+         * Reserve space for the text so it doesn't need to be reallocated while writing
+         * @param size total size in bytes
+         */
+        void reserve(std::size_t size) {
+            this->text.reserve(size);
+        }
+
+        /**
+         * Get the number of bytes written
+         * @return number of bytes
+         */
+        std::size_t size() const noexcept {
+            return this->text.size();
+        }
+
+        /**
+         * Get everything written as a string, leaving the writer empty
+         * @return text
+         */
+        std::string take_string() noexcept {
+            std::string text;
+            text.swap(this->text);
+            return text;
+        }
+
+        /**
+         * Get everything written as bytes (e.g. for File::save_file()), leaving the writer empty
+         * @return text as bytes
+         */
+        std::vector<std::byte> take_bytes();
+
+    private:
+        std::string text;
+
+        static void for_each_section(std::size_t count, const std::function<void (std::size_t)> &function);
+    };
+}
+
+#endif
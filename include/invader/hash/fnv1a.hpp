@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__HASH__FNV1A_HPP
+#define INVADER__HASH__FNV1A_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+
+namespace Invader {
+    /**
+     * FNV-1a hash that can be fed data a piece at a time. This is fast and good enough for bucketing and for noticing
+     * when something changed, but it is not a cryptographic hash.
+     */
+    template <typename Int> class BasicFNV1AHash {
+        static_assert(std::is_same_v<Int, std::uint32_t> || std::is_same_v<Int, std::uint64_t>, "FNV-1a is only defined here for 32-bit and 64-bit hashes");
+    public:
+        /** Hash of nothing */
+        static constexpr Int OFFSET_BASIS = sizeof(Int) == sizeof(std::uint64_t) ? static_cast<Int>(0xCBF29CE484222325) : static_cast<Int>(0x811C9DC5);
+
+        /** Multiplied in after each byte */
+        static constexpr Int PRIME = sizeof(Int) == sizeof(std::uint64_t) ? static_cast<Int>(0x100000001B3) : static_cast<Int>(0x01000193);
+
+        /**
+         * Start a hash
+         * @param hash hash to continue from (by default, the hash of nothing)
+         */
+        constexpr BasicFNV1AHash(Int hash = OFFSET_BASIS) noexcept : hash(hash) {}
+
+        /**
+         * Hash a byte
+         * @param byte byte to hash
+         * @return     this
+         */
+        constexpr BasicFNV1AHash &add_byte(std::uint8_t byte) noexcept {
+            this->hash = (this->hash ^ byte) * PRIME;
+            return *this;
+        }
+
+        /**
+         * Hash bytes
+         * @param data data to hash
+         * @param size number of bytes
+         * @return     this
+         */
+        BasicFNV1AHash &add_bytes(const void *data, std::size_t size) noexcept {
+            auto *bytes = reinterpret_cast<const std::uint8_t *>(data);
+            for(std::size_t i = 0; i < size; i++) {
+                this->add_byte(bytes[i]);
+            }
+            return *this;
+        }
+
+        /**
+         * Hash a value's bytes as they are in memory (so the hash depends on the host's byte order)
+         * @param value value to hash
+         * @return      this
+         */
+        template <typename T> BasicFNV1AHash &add_value(const T &value) noexcept {
+            static_assert(std::is_trivially_copyable_v<T>, "only values that can be copied byte by byte can be hashed");
+            return this->add_bytes(&value, sizeof(value));
+        }
+
+        /**
+         * Hash whether an optional value is set, and then the value if it is
+         * @param value value to hash
+         * @return      this
+         */
+        template <typename T> BasicFNV1AHash &add_value(const std::optional<T> &value) noexcept {
+            this->add_value(value.has_value());
+            if(value.has_value()) {
+                this->add_value(*value);
+            }
+            return *this;
+        }
+
+        /**
+         * Hash a 64-bit integer one byte at a time from least to most significant, so the hash is the same on every host
+         * @param value value to hash
+         * @return      this
+         */
+        constexpr BasicFNV1AHash &add_uint64_le(std::uint64_t value) noexcept {
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                this->add_byte(static_cast<std::uint8_t>(value >> (i * 8)));
+            }
+            return *this;
+        }
+
+        /**
+         * Get the hash of everything added so far
+         * @return hash
+         */
+        constexpr Int get() const noexcept {
+            return this->hash;
+        }
+
+        /**
+         * Hash bytes in one go
+         * @param data data to hash
+         * @param size number of bytes
+         * @return     hash
+         */
+        static Int hash_bytes(const void *data, std::size_t size) noexcept {
+            return BasicFNV1AHash().add_bytes(data, size).get();
+        }
+
+        /**
+         * Hash bytes eight at a time, mixing in the size first. This is much faster than hash_bytes() for large data such
+         * as assets, but it gives a different hash, and the hash depends on the host's byte order.
+         * @param data data to hash
+         * @param size number of bytes
+         * @return     hash
+         */
+        static Int hash_words(const void *data, std::size_t size) noexcept {
+            static_assert(std::is_same_v<Int, std::uint64_t>, "only 64-bit hashes can be done a word at a time");
+            auto *bytes = reinterpret_cast<const std::uint8_t *>(data);
+            Int hash = OFFSET_BASIS ^ size;
+            std::size_t i = 0;
+            for(; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+                std::uint64_t word;
+                std::memcpy(&word, bytes + i, sizeof(word));
+                hash = (hash ^ word) * PRIME;
+                hash ^= hash >> 32;
+            }
+            for(; i < size; i++) {
+                hash = (hash ^ bytes[i]) * PRIME;
+            }
+            return hash;
+        }
+    private:
+        Int hash;
+    };
+
+    /** 64-bit FNV-1a hash */
+    using FNV1AHash = BasicFNV1AHash<std::uint64_t>;
+
+    /** 32-bit FNV-1a hash */
+    using FNV1AHash32 = BasicFNV1AHash<std::uint32_t>;
+}
+
+#endif
@@ -1056,6 +1056,15 @@ namespace Invader::HEK {
     ScenarioStructureBSPMaterialCompressedLightmapVertex<NativeEndian> compress_sbsp_lightmap_vertex(const ScenarioStructureBSPMaterialUncompressedLightmapVertex<NativeEndian> &vertex) noexcept;
     ScenarioStructureBSPMaterialUncompressedLightmapVertex<NativeEndian> decompress_sbsp_lightmap_vertex(const ScenarioStructureBSPMaterialCompressedLightmapVertex<NativeEndian> &vertex) noexcept;
 
+    // Array versions of the above, converting count vertices from vertices into output. These are instantiated for
+    // LittleEndian and BigEndian so tag data can be converted without copying each vertex.
+    ENDIAN_TEMPLATE(EndianType) void compress_model_vertex_array(const ModelVertexUncompressed<EndianType> *vertices, ModelVertexCompressed<EndianType> *output, std::size_t count) noexcept;
+    ENDIAN_TEMPLATE(EndianType) void decompress_model_vertex_array(const ModelVertexCompressed<EndianType> *vertices, ModelVertexUncompressed<EndianType> *output, std::size_t count) noexcept;
+    ENDIAN_TEMPLATE(EndianType) void compress_sbsp_rendered_vertex_array(const ScenarioStructureBSPMaterialUncompressedRenderedVertex<EndianType> *vertices, ScenarioStructureBSPMaterialCompressedRenderedVertex<EndianType> *output, std::size_t count) noexcept;
+    ENDIAN_TEMPLATE(EndianType) void decompress_sbsp_rendered_vertex_array(const ScenarioStructureBSPMaterialCompressedRenderedVertex<EndianType> *vertices, ScenarioStructureBSPMaterialUncompressedRenderedVertex<EndianType> *output, std::size_t count) noexcept;
+    ENDIAN_TEMPLATE(EndianType) void compress_sbsp_lightmap_vertex_array(const ScenarioStructureBSPMaterialUncompressedLightmapVertex<EndianType> *vertices, ScenarioStructureBSPMaterialCompressedLightmapVertex<EndianType> *output, std::size_t count) noexcept;
+    ENDIAN_TEMPLATE(EndianType) void decompress_sbsp_lightmap_vertex_array(const ScenarioStructureBSPMaterialCompressedLightmapVertex<EndianType> *vertices, ScenarioStructureBSPMaterialUncompressedLightmapVertex<EndianType> *output, std::size_t count) noexcept;
+
     bool intersect_plane_with_points(const Plane3D<NativeEndian> &plane, const Point3D<NativeEndian> &point_a, const Point3D<NativeEndian> &point_b, Point3D<NativeEndian> *intersection = nullptr, float epsilon = 0.0001);
 
     inline float dot3(const Vector3D<NativeEndian> &vector_a, const Vector3D<NativeEndian> &vector_b) {
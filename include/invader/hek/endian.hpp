@@ -13,6 +13,56 @@ namespace Invader::HEK {
     #define COPY_THIS(what) copy . what = this -> what;
     #define COPY_THIS_ARRAY(what) for(std::size_t copy_this_array_iterator = 0; copy_this_array_iterator < sizeof(this -> what)/sizeof(this -> what[0]); copy_this_array_iterator++) { copy . what [copy_this_array_iterator] = this -> what [copy_this_array_iterator]; }
 
+    /**
+     * Copy a value of the given size, reversing its bytes. Common sizes compile to a single byte swap instruction.
+     * @param output where to write the swapped bytes
+     * @param input  bytes to swap
+     */
+    template <std::size_t size> inline void swap_bytes(std::byte *output, const std::byte *input) noexcept {
+        #if defined(__GNUC__) || defined(__clang__)
+        if constexpr(size == sizeof(std::uint16_t)) {
+            std::uint16_t v;
+            std::memcpy(&v, input, sizeof(v));
+            v = __builtin_bswap16(v);
+            std::memcpy(output, &v, sizeof(v));
+            return;
+        }
+        else if constexpr(size == sizeof(std::uint32_t)) {
+            std::uint32_t v;
+            std::memcpy(&v, input, sizeof(v));
+            v = __builtin_bswap32(v);
+            std::memcpy(output, &v, sizeof(v));
+            return;
+        }
+        else if constexpr(size == sizeof(std::uint64_t)) {
+            std::uint64_t v;
+            std::memcpy(&v, input, sizeof(v));
+            v = __builtin_bswap64(v);
+            std::memcpy(output, &v, sizeof(v));
+            return;
+        }
+        #endif
+
+        // Copy first so input and output can be the same
+        std::byte input_copy[size];
+        std::memcpy(input_copy, input, size);
+        for(std::size_t i = 0; i < size; i++) {
+            output[i] = input_copy[size - (i + 1)];
+        }
+    }
+
+    /**
+     * Reverse the bytes of each value in an array. This is kept to a plain loop so the compiler can vectorize it.
+     * @param output where to write the swapped values (can be the same as input)
+     * @param input  values to swap
+     * @param count  number of values
+     */
+    template <std::size_t size> inline void swap_bytes_array(std::byte *output, const std::byte *input, std::size_t count) noexcept {
+        for(std::size_t i = 0; i < count; i++) {
+            swap_bytes<size>(output + i * size, input + i * size);
+        }
+    }
+
     /**
      * This is a simple interface for reading/writing swapped endian data
      */
@@ -27,11 +77,9 @@ namespace Invader::HEK {
          * @return the value in host endian
          */
         T read() const noexcept {
-            std::byte value_copy_byte[sizeof(T)];
-            for(std::size_t i = 0; i < sizeof(T); i++) {
-                value_copy_byte[i] = value[sizeof(T) - (i + 1)];
-            }
-            return *reinterpret_cast<const T *>(value_copy_byte);
+            alignas(T) std::byte host_value[sizeof(T)];
+            swap_bytes<sizeof(T)>(host_value, this->value);
+            return *reinterpret_cast<const T *>(host_value);
         }
 
         /**
@@ -47,7 +95,7 @@ namespace Invader::HEK {
          * @param new_value value to overwrite
          */
         void write(const T &new_value) noexcept {
-            *reinterpret_cast<T *>(this->value) = reinterpret_cast<const SwappedEndian<T> *>(&new_value)->read();
+            swap_bytes<sizeof(T)>(this->value, reinterpret_cast<const std::byte *>(&new_value));
         }
 
         /**
@@ -195,6 +195,11 @@ namespace Invader::HEK {
         CACHE_FILE_XBOX_BITMAP_SIZE_GRANULARITY = 128
     };
 
+    enum CacheFileNativeConstants : std::uint32_t {
+        CACHE_FILE_NATIVE_PAGE_SIZE = 4096,
+        CACHE_FILE_NATIVE_ASSET_ALIGNMENT = 16
+    };
+
     enum CacheFileLimits : Pointer64 {
         CACHE_FILE_MEMORY_LENGTH_PC = 0x1700000,
         CACHE_FILE_MEMORY_LENGTH_XBOX = 0x1600000,
@@ -3,14 +3,20 @@
 #ifndef INVADER__MAP__MAP_HPP
 #define INVADER__MAP__MAP_HPP
 
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
 
 #include "../resource/resource_map.hpp"
+#include "../file/memory_mapped_file.hpp"
 #include "../hek/map.hpp"
+#include "../file/tag_path_index.hpp"
 #include "tag.hpp"
 
 namespace Invader {
@@ -176,6 +182,48 @@ namespace Invader {
                                  std::vector<std::byte> &&loc_data = std::vector<std::byte>(),
                                  std::vector<std::byte> &&sounds_data = std::vector<std::byte>());
 
+        /**
+         * Create a Map by moving the given data and using the given memory-mapped resource maps. The resource maps are
+         * not copied. Compressed maps can be loaded this way.
+         * @param  data         map data vector
+         * @param  bitmaps_data bitmaps resource map, if any
+         * @param  loc_data     loc resource map, if any
+         * @param  sounds_data  sounds resource map, if any
+         * @return              map
+         */
+        static Map map_with_move(std::vector<std::byte> &&data,
+                                 std::optional<ResourceMapView> &&bitmaps_data,
+                                 std::optional<ResourceMapView> &&loc_data,
+                                 std::optional<ResourceMapView> &&sounds_data);
+
+        /**
+         * Create a Map backed by the given memory-mapped cache file so only the parts of the map that are accessed are
+         * read from the disk. Compressed maps can be loaded this way, but they will be decompressed into memory.
+         * @param  file         memory-mapped cache file
+         * @param  bitmaps_data bitmaps resource map, if any
+         * @param  loc_data     loc resource map, if any
+         * @param  sounds_data  sounds resource map, if any
+         * @return              map
+         */
+        static Map map_with_mmap(File::MemoryMappedFile &&file,
+                                 std::optional<ResourceMapView> &&bitmaps_data = std::nullopt,
+                                 std::optional<ResourceMapView> &&loc_data = std::nullopt,
+                                 std::optional<ResourceMapView> &&sounds_data = std::nullopt);
+
+        /**
+         * Create a Map by memory-mapping the cache file at the given path
+         * @param  path         path to the cache file
+         * @param  bitmaps_data bitmaps resource map, if any
+         * @param  loc_data     loc resource map, if any
+         * @param  sounds_data  sounds resource map, if any
+         * @return              map
+         * @throws              FailedToOpenFileException if the file could not be mapped
+         */
+        static Map map_with_mmap(const std::filesystem::path &path,
+                                 std::optional<ResourceMapView> &&bitmaps_data = std::nullopt,
+                                 std::optional<ResourceMapView> &&loc_data = std::nullopt,
+                                 std::optional<ResourceMapView> &&sounds_data = std::nullopt);
+
         /**
          * Get the data at the specified offset
          * @param  offset       offset
@@ -215,6 +263,13 @@ namespace Invader {
          */
         std::size_t get_data_length(DataMapType map_type = DATA_MAP_CACHE) const noexcept;
 
+        /**
+         * Move the cache file data out of the map, leaving the map empty. This is for getting back data that was moved
+         * in with map_with_move() without copying it, so the map must not be used afterwards.
+         * @return cache file data
+         */
+        std::vector<std::byte> release_data() noexcept;
+
         /**
          * Get the tag data at the specified offset
          * @param  offset       offset
@@ -278,8 +333,17 @@ namespace Invader {
          * @param tag_path      tag path to find
          * @param tag_fourcc tag class to find
          * @return              the index of the first tag found or std::nullopt if not found
+         * @throws              std::exception if the tag array could not be read
+         */
+        std::optional<std::size_t> find_tag(const char *tag_path, TagFourCC tag_fourcc) const;
+
+        /**
+         * Get all tags of the given class
+         * @param tag_fourcc tag class to find
+         * @return           indices of the tags, in order
+         * @throws           std::exception if the tag array could not be read
          */
-        std::optional<std::size_t> find_tag(const char *tag_path, TagFourCC tag_fourcc) const noexcept;
+        const std::vector<std::size_t> &get_tags_of_class(TagFourCC tag_fourcc) const;
 
         /**
          * Get the scenario tag ID
@@ -324,6 +388,9 @@ namespace Invader {
         /** Map data if managed */
         std::vector<std::byte> data;
 
+        /** Memory-mapped map data, used instead of the above if present */
+        std::optional<File::MemoryMappedFile> mapped_data;
+
 
         /** Bitmaps data if managed */
         std::vector<std::byte> bitmap_data;
@@ -335,6 +402,18 @@ namespace Invader {
 
         /** Sounds data if managed */
         std::vector<std::byte> sound_data;
+
+        /** Memory-mapped resource maps, used instead of the above if present */
+        std::optional<ResourceMapView> mapped_bitmap_data;
+        std::optional<ResourceMapView> mapped_loc_data;
+        std::optional<ResourceMapView> mapped_sound_data;
+
+        /**
+         * Get the size of the resource map, or 0 if there is no resource map
+         * @param map_type map to get the size of
+         * @return         size of the resource map
+         */
+        std::size_t get_resource_map_length(DataMapType map_type) const noexcept;
         
 
         /** Model data offset */
@@ -347,9 +426,40 @@ namespace Invader {
         std::size_t model_data_size;
 
 
-        /** Tag array */
+        /** Location of a BSP tag's data, as given by the scenario tag */
+        struct BSPLocation {
+            std::size_t size;
+            std::size_t offset;
+            HEK::Pointer pointer;
+        };
+
+        /** Tag array; each tag is read from the map the first time it's accessed */
         std::vector<Tag> tags;
 
+        /** Whether or not each tag has been read */
+        std::unique_ptr<std::atomic<bool>[]> tags_read;
+
+        /** Whether or not every tag has been read and indexed */
+        std::atomic<bool> all_tags_read = false;
+
+        /** Held while reading tags */
+        std::mutex tag_read_mutex;
+
+        /** Pointer to the tag array in tag data */
+        const std::byte *tag_array = nullptr;
+
+        /** BSP locations by tag index, read from the scenario tag when first needed */
+        std::optional<std::unordered_map<std::size_t, BSPLocation>> bsp_locations;
+
+        /** Paths in each resource map, indexed the first time a tag needs to be looked up by path in it */
+        std::optional<std::unordered_map<std::string_view, std::uint32_t>> resource_path_indices[DataMapType::DATA_MAP_LOC + 1];
+
+        /** Index of tags by path and class */
+        File::TagPathIndex tag_path_index;
+
+        /** Indices of tags by class */
+        std::unordered_map<TagFourCC, std::vector<std::size_t>> tags_by_class;
+
         /** Scenario tag ID */
         std::size_t scenario_tag_id = 0;
 
@@ -402,10 +512,22 @@ namespace Invader {
         /** Load the map now */
         void load_map();
 
-        /** Populate tag array */
+        /** Read the tag data header and set up the tag array without reading any tags */
         void populate_tag_array();
 
-        /** Get BSPs */
+        /**
+         * Read the tag at the given index if it hasn't been read yet
+         * @param index tag index
+         */
+        void read_tag(std::size_t index);
+
+        /** Read every tag and index them by path and class if this hasn't been done yet */
+        void read_all_tags();
+
+        /** Read the tag at the given index; tag_read_mutex must be held */
+        void read_tag_unlocked(std::size_t index);
+
+        /** Get BSP locations from the scenario tag; tag_read_mutex must be held */
         void get_bsps();
 
         /**
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__MAP__PATCH_HPP
+#define INVADER__MAP__PATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Invader::Patch {
+    /**
+     * Generate a patch that turns one build of a cache file into another. Data in the new cache file that is anywhere
+     * in the old one is copied from it rather than stored in the patch. If both cache files are uncompressed, each tag
+     * in the new cache file is compared against the same tag in the old one first, so a tag that moved only costs the
+     * bytes that changed (such as pointers) rather than the whole tag.
+     * @param source      old cache file
+     * @param source_size size of the old cache file
+     * @param target      new cache file
+     * @param target_size size of the new cache file
+     * @param compress    compress the patch
+     * @return            patch data
+     */
+    std::vector<std::byte> generate_patch(const std::byte *source, std::size_t source_size, const std::byte *target, std::size_t target_size, bool compress = true);
+
+    /**
+     * Apply a patch made with generate_patch()
+     * @param source      old cache file
+     * @param source_size size of the old cache file
+     * @param patch       patch data
+     * @param patch_size  size of the patch data
+     * @return            new cache file
+     * @throws            InvalidPatchException if the patch is invalid or it was made for a different cache file
+     */
+    std::vector<std::byte> apply_patch(const std::byte *source, std::size_t source_size, const std::byte *patch, std::size_t patch_size);
+
+    /**
+     * Check if the data is a patch
+     * @param data      data pointer
+     * @param data_size size of the data
+     * @return          true if the data is a patch
+     */
+    bool is_patch(const std::byte *data, std::size_t data_size) noexcept;
+}
+
+#endif
@@ -90,6 +90,12 @@ namespace Invader {
          */
         bool is_stub() const noexcept;
 
+        /**
+         * Get the base struct of the tag without needing to know its type
+         * @return pointer to the base struct, or nullptr if the tag data is not available
+         */
+        const std::byte *get_base_struct_data() const noexcept;
+
         /**
          * Get the tag data index
          * @return tag data index
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__MEMORY_USAGE_HPP
+#define INVADER__MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Invader::MemoryUsage {
+    /**
+     * Part of Invader that memory is allocated for. Allocations are counted towards the category of the innermost Scope
+     * on the thread that made them, and work done with ThreadPool::parallel_for() counts towards the category of the
+     * thread that started it.
+     */
+    enum Category {
+        /** Anything not inside of a scope */
+        MEMORY_USAGE_CATEGORY_OTHER,
+
+        /** Parsing tag files */
+        MEMORY_USAGE_CATEGORY_PARSER,
+
+        /** Compiling tags into cache file structs */
+        MEMORY_USAGE_CATEGORY_BUILD_STRUCTS,
+
+        /** Bitmap and sound data put into cache files */
+        MEMORY_USAGE_CATEGORY_RAW_DATA,
+
+        /** Generating and encoding bitmaps */
+        MEMORY_USAGE_CATEGORY_BITMAP_PROCESSING,
+
+        /** Decoding, converting, and encoding sound samples */
+        MEMORY_USAGE_CATEGORY_SOUND_PCM,
+
+        MEMORY_USAGE_CATEGORY_COUNT
+    };
+
+    struct Counters {
+        /** Number of allocations made */
+        std::uint64_t allocation_count = 0;
+
+        /** Total number of bytes allocated, including bytes that have since been freed */
+        std::uint64_t allocated_bytes = 0;
+
+        /** Number of bytes currently allocated */
+        std::uint64_t bytes_in_use = 0;
+
+        /** Most bytes allocated at once */
+        std::uint64_t peak_bytes_in_use = 0;
+    };
+
+    /**
+     * Get whether allocations are being counted. This is only the case if Invader was built with INVADER_MEMORY_USAGE,
+     * since counting requires replacing the global operator new and operator delete for the whole process.
+     * @return true if allocations are being counted
+     */
+    bool is_enabled() noexcept;
+
+    /**
+     * Get the name of the category (e.g. "sound_pcm")
+     * @param category category
+     * @return         name of the category
+     */
+    const char *category_name(Category category) noexcept;
+
+    /**
+     * Get the counters for a category so far
+     * @param category category
+     * @return         counters, or all zeroes if allocations are not being counted
+     */
+    Counters get_counters(Category category) noexcept;
+
+    /**
+     * Get the counters for every category combined. The peak is the most bytes allocated at once overall rather than the
+     * sum of each category's peak.
+     * @return counters, or all zeroes if allocations are not being counted
+     */
+    Counters get_total_counters() noexcept;
+
+    /**
+     * Get the category allocations on this thread are currently counted towards
+     * @return category
+     */
+    Category get_current_category() noexcept;
+
+    /**
+     * Start measuring the peaks over again from the number of bytes currently allocated, such as to measure the peak of
+     * one build out of several in the same process
+     */
+    void reset_peaks() noexcept;
+
+    /**
+     * Print the counters for each category that memory was allocated for, if allocations are being counted
+     */
+    void print_counters();
+
+    /**
+     * Count allocations made on this thread towards a category until the scope ends
+     */
+    class Scope {
+    public:
+        /**
+         * Start counting allocations towards the category
+         * @param category category to count allocations towards
+         */
+        Scope(Category category) noexcept;
+
+        /**
+         * Go back to counting allocations towards the category used before this scope
+         */
+        ~Scope() noexcept;
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Category previous;
+    };
+}
+
+#endif
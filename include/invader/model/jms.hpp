@@ -105,6 +105,15 @@ namespace Invader {
         std::string string() const;
         static JMS from_string(const char *string, const char **end = nullptr);
         
+        /**
+         * Parse JMS data, parsing the vertices and triangles on multiple threads
+         * @param data         data to parse; this does not need to be null-terminated
+         * @param size         size of the data
+         * @param thread_count number of threads to use
+         * @return             parsed JMS
+         */
+        static JMS from_data(const char *data, std::size_t size, std::size_t thread_count = 1);
+        
         /**
          * Optimize, removing duplicate vertices
          */
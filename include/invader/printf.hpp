@@ -17,76 +17,31 @@ bool is_on_color_term() noexcept;
 #include <cstring>
 #include <cstdio>
 
+#ifdef __GNUC__
+#define INVADER_PRINTF_FORMAT(format_index, first_argument_index) __attribute__((format(printf, format_index, first_argument_index)))
+#else
+#define INVADER_PRINTF_FORMAT(format_index, first_argument_index)
+#endif
+
+/**
+ * Print a line, in the given color if on a color terminal. The whole line is written at once so lines printed from
+ * different threads don't get mixed together.
+ * @param file   file to print to
+ * @param color  escape sequence of the color
+ * @param format printf format
+ */
+void print_colored_line(std::FILE *file, const char *color, const char *format, ...) noexcept INVADER_PRINTF_FORMAT(3, 4);
+
 #define eprintf(...) std::fprintf(stderr, __VA_ARGS__)
 #define oprintf(...) std::fprintf(stdout, __VA_ARGS__)
 #define oflush(...) std::fflush(stdout)
 
-#define eprintf_error(...) if(ON_COLOR_TERM(stderr)) {\
-    eprintf("\x1B[1;31m"); \
-    eprintf(__VA_ARGS__); \
-    eprintf("\x1B[m\n"); \
-} \
-else {\
-    eprintf(__VA_ARGS__); \
-    eprintf("\n"); \
-}
-
-#define eprintf_warn(...) if(ON_COLOR_TERM(stderr)) {\
-    eprintf("\x1B[1;33m"); \
-    eprintf(__VA_ARGS__); \
-    eprintf("\x1B[m\n"); \
-} \
-else {\
-    eprintf(__VA_ARGS__); \
-    eprintf("\n"); \
-}
-
-#define eprintf_warn_lesser(...) if(ON_COLOR_TERM(stderr)) {\
-    eprintf("\x1B[1;35m"); \
-    eprintf(__VA_ARGS__); \
-    eprintf("\x1B[m\n"); \
-} \
-else {\
-    eprintf(__VA_ARGS__); \
-    eprintf("\n"); \
-}
-
-#define oprintf_success(...) if(ON_COLOR_TERM(stdout)) {\
-    oprintf("\x1B[32m"); \
-    oprintf(__VA_ARGS__); \
-    oprintf("\x1B[m\n"); \
-} \
-else {\
-    oprintf(__VA_ARGS__); \
-    oprintf("\n"); \
-}
-
-#define oprintf_success_warn(...) if(ON_COLOR_TERM(stdout)) {\
-    oprintf("\x1B[1;33m"); \
-    oprintf(__VA_ARGS__); \
-    oprintf("\x1B[m\n"); \
-} \
-else {\
-    oprintf(__VA_ARGS__); \
-    oprintf("\n"); \
-}
-#define oprintf_success_lesser_warn(...) if(ON_COLOR_TERM(stdout)) {\
-    oprintf("\x1B[1;35m"); \
-    oprintf(__VA_ARGS__); \
-    oprintf("\x1B[m\n"); \
-} \
-else {\
-    oprintf(__VA_ARGS__); \
-    oprintf("\n"); \
-}
-#define oprintf_fail(...) if(ON_COLOR_TERM(stdout)) {\
-    oprintf("\x1B[1;31m"); \
-    oprintf(__VA_ARGS__); \
-    oprintf("\x1B[m\n"); \
-} \
-else {\
-    oprintf(__VA_ARGS__); \
-    oprintf("\n"); \
-}
+#define eprintf_error(...) print_colored_line(stderr, "\x1B[1;31m", __VA_ARGS__)
+#define eprintf_warn(...) print_colored_line(stderr, "\x1B[1;33m", __VA_ARGS__)
+#define eprintf_warn_lesser(...) print_colored_line(stderr, "\x1B[1;35m", __VA_ARGS__)
+#define oprintf_success(...) print_colored_line(stdout, "\x1B[32m", __VA_ARGS__)
+#define oprintf_success_warn(...) print_colored_line(stdout, "\x1B[1;33m", __VA_ARGS__)
+#define oprintf_success_lesser_warn(...) print_colored_line(stdout, "\x1B[1;35m", __VA_ARGS__)
+#define oprintf_fail(...) print_colored_line(stdout, "\x1B[1;31m", __VA_ARGS__)
 
 #endif
@@ -4,9 +4,16 @@
 #define INVADER__RESOURCE__RESOURCE_MAP_HPP
 
 #include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "../file/memory_mapped_file.hpp"
+
 namespace Invader {
     struct Resource {
         std::string path;
@@ -23,5 +30,116 @@ namespace Invader {
      * @throws      if failed
      */
     std::vector<Resource> load_resource_map(const std::byte *data, std::size_t size);
+
+    struct ResourceView {
+        std::string path;
+        std::span<const std::byte> data;
+        std::size_t path_offset;
+        std::size_t data_offset;
+    };
+
+    /**
+     * Resource map backed by a memory-mapped file. Resources point into the mapping rather than being copied.
+     */
+    class ResourceMapView {
+    public:
+        /**
+         * Map the resource map file into memory and read its resources
+         * @param  path path to the resource map
+         * @return      resource map
+         * @throws      FailedToOpenFileException if the file could not be mapped, or another exception if the resource map is invalid
+         */
+        static ResourceMapView map_file(const std::filesystem::path &path);
+
+        /**
+         * Get the resources
+         * @return resources
+         */
+        const std::vector<ResourceView> &get_resources() const noexcept {
+            return this->resources;
+        }
+
+        /**
+         * Get the resource at the given index
+         * @param  index index of the resource
+         * @return       resource
+         */
+        const ResourceView &operator[](std::size_t index) const noexcept {
+            return this->resources[index];
+        }
+
+        /**
+         * Get the number of resources
+         * @return number of resources
+         */
+        std::size_t size() const noexcept {
+            return this->resources.size();
+        }
+
+        /**
+         * Get the raw data of the resource map file
+         * @return raw data
+         */
+        std::byte *get_data() noexcept {
+            return this->file->data();
+        }
+
+        /**
+         * Get the raw data of the resource map file
+         * @return raw data
+         */
+        const std::byte *get_data() const noexcept {
+            return this->file->data();
+        }
+
+        /**
+         * Get the size of the resource map file
+         * @return size in bytes
+         */
+        std::size_t get_data_size() const noexcept {
+            return this->file->size();
+        }
+
+    private:
+        ResourceMapView(File::MemoryMappedFile &&file);
+
+        /** Shared so copies of the view (such as in copied build parameters) don't need to map the file again */
+        std::shared_ptr<File::MemoryMappedFile> file;
+        std::vector<ResourceView> resources;
+    };
+
+    /**
+     * Index of resources by path and by data so resources can be found without comparing against every resource
+     */
+    class ResourceMapIndex {
+    public:
+        /**
+         * Index the resources. The resources must outlive the index.
+         * @param resources resources to index
+         */
+        ResourceMapIndex(const ResourceMapView &resources);
+
+        /**
+         * Find the first resource with the given path
+         * @param path       path to find
+         * @param every_other only look at every other resource starting with the second one (used for bitmaps and sounds maps, where the even indices are raw data)
+         * @return           index of the resource if found
+         */
+        std::optional<std::size_t> find_path(const std::string &path, bool every_other = false) const noexcept;
+
+        /**
+         * Find the first resource whose data starts with the given data
+         * @param data data to find
+         * @param size size of the data
+         * @return     index of the resource if found
+         */
+        std::optional<std::size_t> find_data(const std::byte *data, std::size_t size) const noexcept;
+
+    private:
+        const ResourceMapView &resources;
+        std::unordered_map<std::string, std::size_t> paths;
+        std::unordered_map<std::string, std::size_t> paths_every_other;
+        std::unordered_map<std::size_t, std::vector<std::size_t>> data_prefixes;
+    };
 }
 #endif
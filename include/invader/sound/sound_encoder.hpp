@@ -9,6 +9,23 @@
 #include <optional>
 
 namespace Invader::SoundEncoder {
+    /**
+     * Quality to use when resampling
+     */
+    enum ResampleQuality {
+        /** Linear interpolation; fastest, but lowest quality (good for iterating) */
+        RESAMPLE_QUALITY_LINEAR,
+
+        /** Fastest band-limited sinc interpolation */
+        RESAMPLE_QUALITY_FAST,
+
+        /** Medium quality band-limited sinc interpolation */
+        RESAMPLE_QUALITY_MEDIUM,
+
+        /** Best quality band-limited sinc interpolation; slowest, but highest quality */
+        RESAMPLE_QUALITY_BEST
+    };
+
     /**
      * Encode the PCM data to Ogg Vorbis with a variable bitrate. This is lossy.
      * @param pcm             PCM data
@@ -48,18 +65,21 @@ namespace Invader::SoundEncoder {
      * @param channel_count     channel count
      * @param sample_rate       sample rate
      * @param compression_level compression level to use (0 to 8)
+     * @param thread_count      number of threads to encode with if libFLAC was built with threading (0 for the number of CPU threads)
      * @return                  FLAC data
      */
-    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level = 5);
+    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level = 5, std::uint32_t thread_count = 0);
 
     /**
      * Encode the PCM data to Xbox ADPCM. This is lossy.
      * @param pcm             PCM data
      * @param bits_per_sample bits per sample of the PCM data
      * @param channel_count   number of channels
+     * @param lookahead       number of samples to look ahead when picking each nibble (higher is slower but better quality)
+     * @param thread_count    number of threads to encode blocks on
      * @return                Xbox ADPCM data
      */
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count);
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t lookahead = 3, std::size_t thread_count = 1);
     
     /**
      * Calculate the PCM block size to use for encoding to ADPCM. Basically the number of samples must be a multiple of this.
@@ -85,6 +105,14 @@ namespace Invader::SoundEncoder {
      */
     std::vector<std::byte> convert_int_to_int(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t new_bits_per_sample);
 
+    /**
+     * Mix stereo PCM down to mono by averaging the channels.
+     * @param pcm             interleaved stereo PCM data
+     * @param bits_per_sample bits per sample
+     * @return                mono PCM data
+     */
+    std::vector<std::byte> convert_stereo_to_mono(const std::vector<std::byte> &pcm, std::size_t bits_per_sample);
+
     /**
      * Encode from one PCM size to another. This is lossless.
      * @param pcm             PCM data
@@ -93,6 +121,15 @@ namespace Invader::SoundEncoder {
      */
     std::vector<float> convert_int_to_float(const std::vector<std::byte> &pcm, std::size_t bits_per_sample);
 
+    /**
+     * Encode from one PCM size to another. This is lossless.
+     * @param pcm             PCM data
+     * @param sample_count    number of samples
+     * @param bits_per_sample bits per sample
+     * @param output          float samples output (must be sample_count long)
+     */
+    void convert_int_to_float(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, float *output) noexcept;
+
     /**
      * Encode from one PCM size to another. This is lossy unless the PCM data was originally integer PCM of the same bitness or smaller.
      * @param pcm                 PCM data
@@ -100,6 +137,29 @@ namespace Invader::SoundEncoder {
      */
     std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample);
 
+    /**
+     * Encode from one PCM size to another. This is lossy unless the PCM data was originally integer PCM of the same bitness or smaller.
+     * @param pcm                 PCM data
+     * @param sample_count        number of samples
+     * @param new_bits_per_sample new bits per sample
+     * @param output              PCM output (must be sample_count * new_bits_per_sample / 8 bytes long)
+     */
+    void convert_float_to_int(const float *pcm, std::size_t sample_count, std::size_t new_bits_per_sample, std::byte *output) noexcept;
+
+    /**
+     * Resample the PCM data. This is done a block at a time, so only a few blocks are ever converted to float at once.
+     * @param pcm                 PCM data
+     * @param sample_count        number of samples
+     * @param bits_per_sample     bits per sample
+     * @param channel_count       number of channels
+     * @param ratio               output sample rate divided by input sample rate
+     * @param new_bits_per_sample bits per sample of the output
+     * @param max_sample_count    stop once this many samples are output
+     * @param quality             quality of the resampler
+     * @return                    resampled PCM data
+     */
+    std::vector<std::byte> resample(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::size_t channel_count, double ratio, std::size_t new_bits_per_sample, std::size_t max_sample_count = SIZE_MAX, ResampleQuality quality = ResampleQuality::RESAMPLE_QUALITY_BEST);
+
     /**
      * Read the little sample as an int.
      * @param  pcm             pointer to sample
@@ -8,6 +8,8 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <optional>
+#include <functional>
 
 namespace Invader::SoundReader {
     struct Sound {
@@ -94,6 +96,16 @@ namespace Invader::SoundReader {
      */
     Sound sound_from_xbox_adpcm(const std::byte *data, std::size_t data_length, std::size_t channel_count, std::size_t sample_rate);
 
+    /**
+     * Decode Xbox ADPCM data a piece at a time into 16-bit PCM, such as to start playing it before all of it is decoded
+     * @param  data          pointer to data
+     * @param  data_length   data size
+     * @param  channel_count number of channels
+     * @param  callback      function called with each piece of PCM in order; return false to stop decoding
+     * @throws               InvalidInputSoundException if the data is not mono or stereo Xbox ADPCM, before any callback
+     */
+    void stream_from_xbox_adpcm(const std::byte *data, std::size_t data_length, std::size_t channel_count, const std::function<bool (const std::byte *pcm, std::size_t pcm_size)> &callback);
+
     /**
      * Get the sound from 16-bit big endian PCM
      * @param  data          pointer to data
@@ -111,6 +123,15 @@ namespace Invader::SoundReader {
      * @return             number of samples
      */
     std::size_t ogg_vorbis_sample_count(const std::byte *data, std::size_t data_length);
+    
+    /**
+     * Get the number of PCM samples in an Ogg Vorbis stream from the granule position of its last page without decoding
+     * anything. This assumes the stream's first sample is at granule position 0, as it is for streams made by libvorbis.
+     * @param  data        pointer to data
+     * @param  data_length data size
+     * @return             number of samples, or std::nullopt if the stream isn't a single Vorbis stream that can be counted this way
+     */
+    std::optional<std::size_t> ogg_vorbis_sample_count_from_pages(const std::byte *data, std::size_t data_length) noexcept;
 }
 
 #endif
@@ -3,10 +3,15 @@
 #ifndef INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 #define INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY_HPP
 
+#include <memory>
+#include <optional>
+#include <vector>
 #include "../../../hek/data_type.hpp"
 #include "../definition.hpp"
 
 namespace Invader::HEK {
+    class CompiledCollisionBSP;
+
     /**
      * Struct for containing all information required to find intersections among other things
      */
@@ -29,6 +34,18 @@ namespace Invader::HEK {
         std::uint32_t vertex_count = 0;
         const ScenarioStructureBSPLeaf<LittleEndian> *render_leaves = nullptr;
         std::uint32_t render_leaf_count = 0;
+
+        /**
+         * Validated, native-endian copy of the collision BSP used for checks. This is created by compile().
+         */
+        mutable std::shared_ptr<const CompiledCollisionBSP> compiled;
+
+        /**
+         * Validate the collision BSP and copy it for checking if this wasn't done already. The check functions call
+         * this automatically, but it is not thread-safe, so call it before checking the same BSP from multiple threads.
+         * @throws OutOfBoundsException if any index in the BSP is out of bounds
+         */
+        void compile() const;
         
         /**
          * Determine if a point intersects vertically with the BSP.
@@ -58,6 +75,34 @@ namespace Invader::HEK {
          * @param leaf_index if non-null and this function returns true, this will be set to the leaf index where the point is located
          */
         bool check_if_point_inside_bsp(const Point3D<LittleEndian> &point, std::uint32_t *leaf_index = nullptr) const;
+
+        /**
+         * Result of checking a point with query_points()
+         */
+        struct PointQueryResult {
+            /** true if the point was found */
+            bool found = false;
+
+            /** leaf index where the point was found */
+            std::uint32_t leaf_index = 0;
+
+            /** surface index where an intersection was found (only set when checking with a range) */
+            std::uint32_t surface_index = 0;
+
+            /** cluster index of the leaf, or NULL_INDEX if not found or no render leaves are set */
+            Index cluster_index = NULL_INDEX;
+        };
+
+        /**
+         * Check many points at once. Points are checked in spatial order so nearby points walk the same nodes, and
+         * large batches are split across threads.
+         * @param points       points to check
+         * @param point_count  number of points
+         * @param range        if set, check for an intersection this far up-and-down (like check_for_intersection); otherwise, check if each point lays inside of the BSP (like check_if_point_inside_bsp)
+         * @param thread_count maximum number of threads to use
+         * @return             results in the same order as the points
+         */
+        std::vector<PointQueryResult> query_points(const Point3D<LittleEndian> *points, std::size_t point_count, std::optional<float> range, std::size_t thread_count = 1) const;
     };
 }
 #endif
@@ -11,13 +11,24 @@ namespace Invader::Parser {
      * @param offset bit offset
      * @param fields pointer to fields
      */
-    bool read_bit_from_bitfield(std::size_t offset, std::uint32_t *fields) noexcept;
+    bool read_bit_from_bitfield(std::size_t offset, const std::uint32_t *fields) noexcept;
 
     /**
      * Calculate the expected uncompressed frame size for the animation in bytes.
      * @param animation animation
      */
-    std::size_t expected_uncompressed_frame_size_for_animation(ModelAnimationsAnimation &animation) noexcept;
+    std::size_t expected_uncompressed_frame_size_for_animation(const ModelAnimationsAnimation &animation) noexcept;
+
+    /**
+     * Swap the endianness of the animation's uncompressed frame data or default data. The sizes must have already been
+     * checked.
+     * @param animation    animation the data belongs to
+     * @param from         data to swap
+     * @param to           where to write the swapped data (can be the same as from)
+     * @param frame_count  number of frames to swap (1 for default data)
+     * @param default_data true if this is default data, which holds the nodes that aren't animated
+     */
+    void swap_animation_frame_data_endianness(const ModelAnimationsAnimation &animation, const std::byte *from, std::byte *to, std::size_t frame_count, bool default_data);
 }
 
 #endif
@@ -23,8 +23,9 @@ namespace Invader::Parser {
      * @param warnings           array to hold warnings
      * @param tags_directories   tags directories in order of precedence
      * @param scripts            optional array of scripts (filename-data pairs). If not set, use source data from the scenario tag
+     * @param cache_directory    optional directory to keep compiled scripts in so unchanged scripts don't have to be compiled again
      */
-    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &scripts = std::nullopt);
+    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &scripts = std::nullopt, const std::optional<std::filesystem::path> &cache_directory = std::nullopt);
 }
 
 #endif
@@ -19,12 +19,14 @@ namespace Invader::Parser {
     ShaderTransparentChicago convert_shader_transparent_chicago_extended_to_shader_transparent_chicago(const ShaderTransparentChicagoExtended &shader);
     
     /**
-     * Recursively get all predicted resources from the struct
+     * Recursively get all predicted resources from the struct. Resources already in the array aren't added again, and
+     * the resources of shared structs (e.g. shaders and models) are only searched for once per build.
+     * @param workload                workload
      * @param struct_index            struct index
      * @param resources               array of resources to fill with tag indices
      * @param ignore_shader_resources ignore immediate shader tags
      */
-    void recursively_get_all_predicted_resources_from_struct(const BuildWorkload &workload, std::size_t struct_index, std::vector<std::size_t> &resources, bool ignore_shader_resources);
+    void recursively_get_all_predicted_resources_from_struct(BuildWorkload &workload, std::size_t struct_index, std::vector<std::size_t> &resources, bool ignore_shader_resources);
 }
 
 #endif
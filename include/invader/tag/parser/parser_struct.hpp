@@ -6,10 +6,12 @@
 #include <vector>
 #include <deque>
 #include <cstddef>
+#include <cstdint>
 #include <list>
 #include <optional>
 #include <variant>
 #include <memory>
+#include <functional>
 #include "../hek/definition.hpp"
 
 namespace Invader {
@@ -214,7 +216,7 @@ namespace Invader::Parser {
          * @return the comment
          */
         const char *get_comment() const noexcept {
-            return this->comment;
+            return this->descriptor->comment;
         }
         
         /**
@@ -222,7 +224,7 @@ namespace Invader::Parser {
          * @return minimum value or nullopt if there is no minimum
          */
         std::optional<Number> get_minimum() const noexcept {
-            return this->minimum;
+            return this->descriptor->minimum;
         }
         
         /**
@@ -230,7 +232,7 @@ namespace Invader::Parser {
          * @return maximum value or nullopt if there is no maximum
          */
         std::optional<Number> get_maximum() const noexcept {
-            return this->maximum;
+            return this->descriptor->maximum;
         }
 
         /**
@@ -270,7 +272,7 @@ namespace Invader::Parser {
          * @return value type
          */
         ValueType get_type() const noexcept {
-            return this->type;
+            return this->descriptor->type;
         }
 
         /**
@@ -278,7 +280,7 @@ namespace Invader::Parser {
          * @return name of the value
          */
         const char *get_name() const noexcept {
-            return this->name;
+            return this->descriptor->name;
         }
 
         /**
@@ -286,7 +288,7 @@ namespace Invader::Parser {
          * @return member name of the value
          */
         const char *get_member_name() const noexcept {
-            return this->member_name;
+            return this->descriptor->member_name;
         }
 
         /**
@@ -302,7 +304,7 @@ namespace Invader::Parser {
          * @return unit
          */
         const char *get_unit() const noexcept {
-            return this->unit;
+            return this->descriptor->unit;
         }
         
         /**
@@ -310,7 +312,15 @@ namespace Invader::Parser {
          * @return volatile
          */
         bool is_volatile() const noexcept {
-            return this->volatile_value;
+            return this->descriptor->volatile_value;
+        }
+
+        /**
+         * Get the address of the value in the struct it's in
+         * @return address of the value
+         */
+        const void *get_address() const noexcept {
+            return this->address;
         }
 
         /**
@@ -329,7 +339,7 @@ namespace Invader::Parser {
          * @return       object in array
          */
         ParserStruct &get_object_in_array(std::size_t index) {
-            return this->get_object_in_array_fn(index, this->address);
+            return this->descriptor->get_object_in_array_fn(index, this->address);
         }
 
         /**
@@ -346,7 +356,7 @@ namespace Invader::Parser {
          * @return number of elements in array
          */
         std::size_t get_array_size() const noexcept {
-            return this->get_array_size_fn(this->address);
+            return this->descriptor->get_array_size_fn(this->address);
         }
 
         /**
@@ -354,7 +364,7 @@ namespace Invader::Parser {
          * @return minimum number of elements in array
          */
         std::size_t get_array_minimum_size() const noexcept {
-            return this->min_array_size;
+            return this->descriptor->min_array_size;
         }
 
         /**
@@ -362,7 +372,7 @@ namespace Invader::Parser {
          * @return maximum number of elements in array
          */
         std::size_t get_array_maximum_size() const noexcept {
-            return this->max_array_size;
+            return this->descriptor->max_array_size;
         }
 
         /**
@@ -371,7 +381,7 @@ namespace Invader::Parser {
          * @param count number of objects to delete
          */
         void delete_objects_in_array(std::size_t index, std::size_t count) {
-            return this->delete_objects_in_array_fn(index, count, this->address);
+            return this->descriptor->delete_objects_in_array_fn(index, count, this->address);
         }
 
         /**
@@ -380,7 +390,7 @@ namespace Invader::Parser {
          * @param count number of objects to create
          */
         void insert_objects_in_array(std::size_t index, std::size_t count) {
-            return this->insert_objects_in_array_fn(index, count, this->address);
+            return this->descriptor->insert_objects_in_array_fn(index, count, this->address);
         }
 
         /**
@@ -390,7 +400,7 @@ namespace Invader::Parser {
          * @param count      number of objects to create
          */
         void duplicate_objects_in_array(std::size_t index_from, std::size_t index_to, std::size_t count) {
-            return this->duplicate_objects_in_array_fn(index_from, index_to, count, this->address);
+            return this->descriptor->duplicate_objects_in_array_fn(index_from, index_to, count, this->address);
         }
 
         /**
@@ -400,7 +410,7 @@ namespace Invader::Parser {
          * @param count      number of objects to create
          */
         void swap_objects_in_array(std::size_t index_from, std::size_t index_to, std::size_t count) {
-            return this->swap_objects_in_array_fn(index_from, index_to, count, this->address);
+            return this->descriptor->swap_objects_in_array_fn(index_from, index_to, count, this->address);
         }
 
         /**
@@ -408,7 +418,7 @@ namespace Invader::Parser {
          * @return is bounds
          */
         bool is_bounds() const noexcept {
-            return this->bounds;
+            return this->descriptor->bounds;
         }
 
         /**
@@ -432,7 +442,7 @@ namespace Invader::Parser {
          * @return enum
          */
         const char *read_enum() const {
-            return this->read_enum_fn(address);
+            return this->descriptor->read_enum_fn(address);
         }
 
         /**
@@ -440,7 +450,7 @@ namespace Invader::Parser {
          * @param value value to write
          */
         void write_enum(const char *value) {
-            this->write_enum_fn(value, address);
+            this->descriptor->write_enum_fn(value, address);
         }
 
         /**
@@ -449,7 +459,7 @@ namespace Invader::Parser {
          * @return value
          */
         bool read_bitfield(const char *field) const {
-            return this->read_bitfield_fn(field, address);
+            return this->descriptor->read_bitfield_fn(field, address);
         }
 
         /**
@@ -458,7 +468,7 @@ namespace Invader::Parser {
          * @param  value value name
          */
         void write_bitfield(const char *field, bool value) {
-            this->write_bitfield_fn(field, value, address);
+            this->descriptor->write_bitfield_fn(field, value, address);
         }
 
         /**
@@ -474,7 +484,7 @@ namespace Invader::Parser {
          * @return all enum values
          */
         std::vector<const char *> list_enum() const noexcept {
-            return this->list_enum_fn();
+            return this->descriptor->list_enum_fn();
         }
 
         /**
@@ -482,7 +492,7 @@ namespace Invader::Parser {
          * @return all enum values
          */
         std::vector<const char *> list_enum_pretty() const noexcept {
-            return this->list_enum_pretty_fn();
+            return this->descriptor->list_enum_pretty_fn();
         }
 
         using get_object_in_array_fn_type = ParserStruct &(*)(std::size_t index, void *addr);
@@ -709,7 +719,7 @@ namespace Invader::Parser {
          * @return all allowed classes
          */
         const std::vector<TagFourCC> &get_allowed_classes() const noexcept {
-            return this->allowed_classes;
+            return this->descriptor->allowed_classes;
         }
 
         /**
@@ -717,213 +727,254 @@ namespace Invader::Parser {
          * @return true if value is read only
          */
         bool is_read_only() const noexcept {
-            return this->read_only;
+            return this->descriptor->read_only;
         }
 
         /**
-         * Instantiate a ParserStructValue with a group start
-         * @param name    name of the group
-         * @param comment comments
-         */
-        ParserStructValue(
-            const char *name,
-            const char *comment
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a dependency
-         * @param name            name of the dependency
-         * @param member_name     variable name of the dependency
-         * @param comment         comments
-         * @param dependency      pointer to the dependency
-         * @param allowed_classes array of allowed classes
-         * @param count           number of allowed classes in array
-         * @param read_only       value is read only
-         */
-        ParserStructValue(
-            const char *       name,
-            const char *       member_name,
-            const char *       comment,
-            Dependency *       dependency,
-            const TagFourCC *allowed_classes,
-            std::size_t        count,
-            bool               read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with an array
-         * @param name                          name of the array
-         * @param member_name                   variable name of the array
-         * @param comment                       comments
-         * @param array                         pointer to the array
-         * @param get_object_in_array_fn        pointer to function for getting object in array
-         * @param get_array_size_fn             pointer to function for getting the size of array
-         * @param delete_objects_in_array_fn    pointer to function for deleting objects from an array
-         * @param insert_objects_in_array_fn    pointer to function for inserting objects in an array
-         * @param duplicate_objects_in_array_fn pointer to function for duplicating objects in an array
-         * @param swap_objects_in_array_fn      pointer to function for swapping objects in an array
-         * @param minimum_array_size            minimum number of elements in the array
-         * @param maximum_array_size            maximum number of elements in the array
-         * @param read_only                     value is read only
-         */
-        ParserStructValue(
-            const char *                        name,
-            const char *                        member_name,
-            const char *                        comment,
-            void *                              array,
-            get_object_in_array_fn_type         get_object_in_array_fn,
-            get_array_size_fn_type              get_array_size_fn,
-            delete_objects_in_array_fn_type     delete_objects_in_array_fn,
-            insert_objects_in_array_fn_type     insert_objects_in_array_fn,
-            duplicate_objects_in_array_fn_type  duplicate_objects_in_array_fn,
-            swap_objects_in_array_fn_type       swap_objects_in_array_fn,
-            std::size_t                         minimum_array_size,
-            std::size_t                         maximum_array_size,
-            bool                                read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a TagString
-         * @param name        name of the value
-         * @param member_name variable name of the value
-         * @param comment     comments
-         * @param string      pointer to string
-         * @param read_only   value is read only
-         */
-        ParserStructValue(
-            const char *    name,
-            const char *    member_name,
-            const char *    comment,
-            HEK::TagString *string,
-            bool            read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a TagDataOffset
-         * @param name        name of the value
-         * @param member_name variable name of the value
-         * @param comment     comments
-         * @param offset      pointer to offset
-         * @param read_only   value is read only
-         */
-        ParserStructValue(
-            const char *            name,
-            const char *            member_name,
-            const char *            comment,
-            std::vector<std::byte> *offset,
-            bool                    read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a TagEnum
-         * @param name                 name of the value
-         * @param member_name          variable name of the value
-         * @param comment              comments
-         * @param value                pointer to value
-         * @param list_enum_fn         pointer to function for listing enums
-         * @param list_enum_pretty_fn  pointer to function for listing enums with definition naming
-         * @param read_enum_fn         pointer to function for reading enums
-         * @param write_enum_fn        pointer to function for writing enums
-         * @param read_only            value is read only
-         */
-        ParserStructValue(
-            const char *       name,
-            const char *       member_name,
-            const char *       comment,
-            void *             value,
-            list_enum_fn_type  list_enum_fn,
-            list_enum_fn_type  list_enum_pretty_fn,
-            read_enum_fn_type  read_enum_fn,
-            write_enum_fn_type write_enum_fn,
-            bool               read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a bitfield
-         * @param name                 name of the value
-         * @param member_name          variable name of the value
-         * @param comment              comments
-         * @param value                pointer to value
-         * @param list_enum_fn         pointer to function for listing enums
-         * @param list_enum_pretty_fn  pointer to function for listing enums with definition naming
-         * @param read_bitfield_fn     pointer to function for reading enums
-         * @param write_bitfield_fn    pointer to function for writing enums
-         * @param read_only            value is read only
-         */
-        ParserStructValue(
-            const char *           name,
-            const char *           member_name,
-            const char *           comment,
-            void *                 value,
-            list_enum_fn_type      list_enum_fn,
-            list_enum_fn_type      list_enum_pretty_fn,
-            read_bitfield_fn_type  read_bitfield_fn,
-            write_bitfield_fn_type write_bitfield_fn,
-            bool                   read_only
-        );
-
-        /**
-         * Instantiate a ParserStructValue with a value
-         * @param name           name of the value
-         * @param member_name    variable name of the value
-         * @param comment        comments
-         * @param object         pointer to the object
-         * @param type           type of value
-         * @param unit           unit to use
-         * @param count          number of values (if multiple values or bounds)
-         * @param bounds         whether or not this is bounds
-         * @param volatile_value value is volatile
-         * @param read_only      value is read only
-         * @param minimum        optional minimum value
-         * @param maximum        optional maximum value
-         */
-        ParserStructValue(
-            const char *          name,
-            const char *          member_name,
-            const char *          comment,
-            void *                object,
-            ValueType             type,
-            const char *          unit = nullptr,
-            std::size_t           count = 1,
-            bool                  bounds = false,
-            bool                  volatile_value = false,
-            bool                  read_only = false,
-            std::optional<Number> minimum = std::nullopt,
-            std::optional<Number> maximum = std::nullopt
-        );
+         * Everything about a value except where it is, which is the same for every instance of a struct. These are made
+         * once per struct type and shared, so getting the values of a struct only has to look up addresses.
+         */
+        struct Descriptor {
+            /**
+             * Instantiate a descriptor with a group start
+             * @param name    name of the group
+             * @param comment comments
+             */
+            Descriptor(
+                const char *name,
+                const char *comment
+            );
+
+            /**
+             * Instantiate a descriptor with a dependency
+             * @param base            struct the value is in, used to get the offset of the value
+             * @param name            name of the dependency
+             * @param member_name     variable name of the dependency
+             * @param comment         comments
+             * @param dependency      pointer to the dependency
+             * @param allowed_classes array of allowed classes
+             * @param count           number of allowed classes in array
+             * @param read_only       value is read only
+             */
+            Descriptor(
+                const void *       base,
+                const char *       name,
+                const char *       member_name,
+                const char *       comment,
+                Dependency *       dependency,
+                const TagFourCC *allowed_classes,
+                std::size_t        count,
+                bool               read_only
+            );
+
+            /**
+             * Instantiate a descriptor with an array
+             * @param base                          struct the value is in, used to get the offset of the value
+             * @param name                          name of the array
+             * @param member_name                   variable name of the array
+             * @param comment                       comments
+             * @param array                         pointer to the array
+             * @param get_object_in_array_fn        pointer to function for getting object in array
+             * @param get_array_size_fn             pointer to function for getting the size of array
+             * @param delete_objects_in_array_fn    pointer to function for deleting objects from an array
+             * @param insert_objects_in_array_fn    pointer to function for inserting objects in an array
+             * @param duplicate_objects_in_array_fn pointer to function for duplicating objects in an array
+             * @param swap_objects_in_array_fn      pointer to function for swapping objects in an array
+             * @param minimum_array_size            minimum number of elements in the array
+             * @param maximum_array_size            maximum number of elements in the array
+             * @param read_only                     value is read only
+             */
+            Descriptor(
+                const void *                        base,
+                const char *                        name,
+                const char *                        member_name,
+                const char *                        comment,
+                void *                              array,
+                get_object_in_array_fn_type         get_object_in_array_fn,
+                get_array_size_fn_type              get_array_size_fn,
+                delete_objects_in_array_fn_type     delete_objects_in_array_fn,
+                insert_objects_in_array_fn_type     insert_objects_in_array_fn,
+                duplicate_objects_in_array_fn_type  duplicate_objects_in_array_fn,
+                swap_objects_in_array_fn_type       swap_objects_in_array_fn,
+                std::size_t                         minimum_array_size,
+                std::size_t                         maximum_array_size,
+                bool                                read_only
+            );
+
+            /**
+             * Instantiate a descriptor with a TagString
+             * @param base        struct the value is in, used to get the offset of the value
+             * @param name        name of the value
+             * @param member_name variable name of the value
+             * @param comment     comments
+             * @param string      pointer to string
+             * @param read_only   value is read only
+             */
+            Descriptor(
+                const void *    base,
+                const char *    name,
+                const char *    member_name,
+                const char *    comment,
+                HEK::TagString *string,
+                bool            read_only
+            );
+
+            /**
+             * Instantiate a descriptor with a TagDataOffset
+             * @param base        struct the value is in, used to get the offset of the value
+             * @param name        name of the value
+             * @param member_name variable name of the value
+             * @param comment     comments
+             * @param data_offset pointer to offset
+             * @param read_only   value is read only
+             */
+            Descriptor(
+                const void *            base,
+                const char *            name,
+                const char *            member_name,
+                const char *            comment,
+                std::vector<std::byte> *data_offset,
+                bool                    read_only
+            );
+
+            /**
+             * Instantiate a descriptor with a TagEnum
+             * @param base                 struct the value is in, used to get the offset of the value
+             * @param name                 name of the value
+             * @param member_name          variable name of the value
+             * @param comment              comments
+             * @param value                pointer to value
+             * @param list_enum_fn         pointer to function for listing enums
+             * @param list_enum_pretty_fn  pointer to function for listing enums with definition naming
+             * @param read_enum_fn         pointer to function for reading enums
+             * @param write_enum_fn        pointer to function for writing enums
+             * @param read_only            value is read only
+             */
+            Descriptor(
+                const void *       base,
+                const char *       name,
+                const char *       member_name,
+                const char *       comment,
+                void *             value,
+                list_enum_fn_type  list_enum_fn,
+                list_enum_fn_type  list_enum_pretty_fn,
+                read_enum_fn_type  read_enum_fn,
+                write_enum_fn_type write_enum_fn,
+                bool               read_only
+            );
+
+            /**
+             * Instantiate a descriptor with a bitfield
+             * @param base                 struct the value is in, used to get the offset of the value
+             * @param name                 name of the value
+             * @param member_name          variable name of the value
+             * @param comment              comments
+             * @param value                pointer to value
+             * @param list_enum_fn         pointer to function for listing enums
+             * @param list_enum_pretty_fn  pointer to function for listing enums with definition naming
+             * @param read_bitfield_fn     pointer to function for reading enums
+             * @param write_bitfield_fn    pointer to function for writing enums
+             * @param read_only            value is read only
+             */
+            Descriptor(
+                const void *           base,
+                const char *           name,
+                const char *           member_name,
+                const char *           comment,
+                void *                 value,
+                list_enum_fn_type      list_enum_fn,
+                list_enum_fn_type      list_enum_pretty_fn,
+                read_bitfield_fn_type  read_bitfield_fn,
+                write_bitfield_fn_type write_bitfield_fn,
+                bool                   read_only
+            );
+
+            /**
+             * Instantiate a descriptor with a value
+             * @param base           struct the value is in, used to get the offset of the value
+             * @param name           name of the value
+             * @param member_name    variable name of the value
+             * @param comment        comments
+             * @param object         pointer to the object
+             * @param type           type of value
+             * @param unit           unit to use
+             * @param count          number of values (if multiple values or bounds)
+             * @param bounds         whether or not this is bounds
+             * @param volatile_value value is volatile
+             * @param read_only      value is read only
+             * @param minimum        optional minimum value
+             * @param maximum        optional maximum value
+             */
+            Descriptor(
+                const void *          base,
+                const char *          name,
+                const char *          member_name,
+                const char *          comment,
+                void *                object,
+                ValueType             type,
+                const char *          unit = nullptr,
+                std::size_t           count = 1,
+                bool                  bounds = false,
+                bool                  volatile_value = false,
+                bool                  read_only = false,
+                std::optional<Number> minimum = std::nullopt,
+                std::optional<Number> maximum = std::nullopt
+            );
+
+            const char *name = nullptr;
+            const char *member_name = nullptr;
+            const char *comment = nullptr;
+            ValueType type;
+            std::vector<TagFourCC> allowed_classes;
+            std::size_t count = 1;
+            bool bounds = false;
+            const char *unit = nullptr;
+            std::optional<Number> minimum;
+            std::optional<Number> maximum;
+
+            get_object_in_array_fn_type get_object_in_array_fn = nullptr;
+            get_array_size_fn_type get_array_size_fn = nullptr;
+            delete_objects_in_array_fn_type delete_objects_in_array_fn = nullptr;
+            insert_objects_in_array_fn_type insert_objects_in_array_fn = nullptr;
+            duplicate_objects_in_array_fn_type duplicate_objects_in_array_fn = nullptr;
+            swap_objects_in_array_fn_type swap_objects_in_array_fn = nullptr;
+
+            list_enum_fn_type list_enum_fn = nullptr;
+            list_enum_fn_type list_enum_pretty_fn = nullptr;
+            read_enum_fn_type read_enum_fn = nullptr;
+            write_enum_fn_type write_enum_fn = nullptr;
+            read_bitfield_fn_type read_bitfield_fn = nullptr;
+            write_bitfield_fn_type write_bitfield_fn = nullptr;
+
+            std::size_t min_array_size = 0;
+            std::size_t max_array_size = 0;
+
+            bool volatile_value = false;
+            bool read_only = false;
+
+            std::ptrdiff_t offset = 0;
+        };
+
+        /**
+         * Instantiate a ParserStructValue for a value of a struct
+         * @param descriptor descriptor of the value; must outlive this
+         * @param base       struct the value is in
+         */
+        ParserStructValue(const Descriptor &descriptor, void *base) noexcept :
+            descriptor(&descriptor),
+            address(reinterpret_cast<std::byte *>(base) + descriptor.offset) {}
+
+        /**
+         * Get the values of a struct from its descriptors
+         * @param descriptors descriptors of the values; must outlive the values
+         * @param base        struct the values are in
+         * @return            values
+         */
+        static std::vector<ParserStructValue> from_descriptors(const std::vector<Descriptor> &descriptors, void *base);
 
     private:
-        const char *name = nullptr;
-        const char *member_name = nullptr;
-        const char *comment = nullptr;
-        ValueType type;
+        const Descriptor *descriptor;
         void *address;
-        std::vector<TagFourCC> allowed_classes;
-        std::size_t count = 1;
-        bool bounds = false;
-        const char *unit = nullptr;
-        std::optional<Number> minimum;
-        std::optional<Number> maximum;
-
-        get_object_in_array_fn_type get_object_in_array_fn = nullptr;
-        get_array_size_fn_type get_array_size_fn = nullptr;
-        delete_objects_in_array_fn_type delete_objects_in_array_fn = nullptr;
-        insert_objects_in_array_fn_type insert_objects_in_array_fn = nullptr;
-        duplicate_objects_in_array_fn_type duplicate_objects_in_array_fn = nullptr;
-        swap_objects_in_array_fn_type swap_objects_in_array_fn = nullptr;
-
-        list_enum_fn_type list_enum_fn = nullptr;
-        list_enum_fn_type list_enum_pretty_fn = nullptr;
-        read_enum_fn_type read_enum_fn = nullptr;
-        write_enum_fn_type write_enum_fn = nullptr;
-        read_bitfield_fn_type read_bitfield_fn = nullptr;
-        write_bitfield_fn_type write_bitfield_fn = nullptr;
-
-        std::size_t min_array_size;
-        std::size_t max_array_size;
-
-        bool volatile_value = false;
-        bool read_only = false;
 
         template <typename T>
         static void assert_range_exists(std::size_t index, std::size_t count, const T &array) {
@@ -955,6 +1006,34 @@ namespace Invader::Parser {
          */
         static std::unique_ptr<ParserStruct> parse_hek_tag_file(const std::byte *data, std::size_t data_size, bool postprocess = false);
 
+        /**
+         * Parse only the fields stored in the main struct of the HEK tag file.
+         *
+         * Dependency paths, reflexives, and data are left empty, and nothing after the main struct is read, so this is
+         * much faster than parse_hek_tag_file() when only simple fields in the main struct are needed.
+         * @param  data        Tag file data to read from
+         * @param  data_size   Size of the tag file
+         * @param  postprocess Set default values
+         * @return             parsed tag data
+         */
+        static std::unique_ptr<ParserStruct> parse_hek_tag_file_base_struct(const std::byte *data, std::size_t data_size, bool postprocess = false);
+
+        /**
+         * Function called for each dependency found by scan_hek_tag_file_dependencies(); the path is null-terminated
+         */
+        using DependencyScanFunction = std::function<void (TagFourCC tag_fourcc, const char *path, std::size_t path_length)>;
+
+        /**
+         * Find all non-empty dependencies in the HEK tag file without parsing it.
+         *
+         * Only the tag references are read; everything else is skipped by its size, so this is much faster than
+         * parse_hek_tag_file() when only the dependencies are needed.
+         * @param  data      Tag file data to read from
+         * @param  data_size Size of the tag file
+         * @param  callback  Function to call for each dependency, in the same order as they are in the tag
+         */
+        static void scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size, const DependencyScanFunction &callback);
+
         /**
          * Generate a tag base struct
          * @param  tag_class tag class
@@ -1034,7 +1113,34 @@ namespace Invader::Parser {
          * @param  clear_on_save         clear data as it's being saved (reduces memory usage but you can't work on the tag anymore)
          * @return cache file data
          */
-        virtual std::vector<std::byte> generate_hek_tag_data(std::optional<TagFourCC> generate_header_class = std::nullopt, bool clear_on_save = false) = 0;
+        std::vector<std::byte> generate_hek_tag_data(std::optional<TagFourCC> generate_header_class = std::nullopt, bool clear_on_save = false);
+
+        /**
+         * Convert the struct into HEK tag data, writing it into the given buffer.
+         * @param  output                buffer to write to; this needs to be at least calculate_hek_tag_data_size() bytes, plus the size of the header if one is generated
+         * @param  output_size           size of the buffer
+         * @param  generate_header_class generate a cache file header with the class, too
+         * @param  clear_on_save         clear data as it's being saved (reduces memory usage but you can't work on the tag anymore)
+         * @return                       number of bytes written
+         * @throws OutOfBoundsException  if the buffer is too small
+         */
+        std::size_t generate_hek_tag_data(std::byte *output, std::size_t output_size, std::optional<TagFourCC> generate_header_class = std::nullopt, bool clear_on_save = false);
+
+        /**
+         * Calculate the size of the HEK tag data of the struct, not including any header.
+         * @return size in bytes
+         */
+        virtual std::size_t calculate_hek_tag_data_size() = 0;
+
+        /**
+         * Write the HEK tag data of the struct, not including any header.
+         * @param  output        buffer to write to
+         * @param  output_size   size of the buffer
+         * @param  clear_on_save clear data as it's being saved
+         * @return               number of bytes written
+         * @throws OutOfBoundsException if the buffer is too small
+         */
+        virtual std::size_t write_hek_tag_data(std::byte *output, std::size_t output_size, bool clear_on_save = false) = 0;
 
         /**
          * Refactor the tag reference, replacing all references with the given reference. Paths must use Halo path separators.
@@ -1101,7 +1207,15 @@ namespace Invader::Parser {
          * @param differences     an optional pointer to a list of strings to be filled with the differences (verbose mode)
          */
         bool compare(const ParserStruct *what, bool precision = false, bool ignore_volatile = false, std::list<std::string> *differences = nullptr) const;
-        
+
+        /**
+         * Hash the contents of the struct. Each array element is hashed on its own and its hash is used in place of its
+         * contents, so structs that compare() as equal without precision have the same hash, and equal hashes of
+         * elements mean the elements are almost certainly equal.
+         * @return hash of the contents
+         */
+        std::uint64_t content_hash() const;
+
         bool operator==(const ParserStruct &other) const {
             return this->compare(&other);
         }
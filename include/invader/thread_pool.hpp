@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__THREAD_POOL_HPP
+#define INVADER__THREAD_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "memory_usage.hpp"
+
+namespace Invader {
+    /**
+     * Worker threads shared by everything in the process. Work is split up with parallel_for(), where the calling thread
+     * does the work along with whichever workers are idle, so parallel work started from inside other parallel work
+     * (such as a tag compiled on one of several build threads) is spread over the same workers instead of starting
+     * more threads than there are cores.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * Get the thread pool shared by the whole process, starting it if it hasn't been started yet
+         * @return shared thread pool
+         */
+        static ThreadPool &shared();
+
+        /**
+         * Set the number of threads the shared thread pool uses, including the thread calling parallel_for(). This has
+         * to be called before the shared thread pool is first used; otherwise, INVADER_THREADS is used if it is set, or
+         * the number of CPU threads if it isn't.
+         * @param thread_count number of threads
+         */
+        static void set_shared_thread_count(std::size_t thread_count) noexcept;
+
+        /**
+         * Get the number of threads the shared thread pool uses (or will use if it hasn't been started yet)
+         * @return number of threads
+         */
+        static std::size_t get_shared_thread_count() noexcept;
+
+        /**
+         * Get the number of threads that can work at once, including the thread calling parallel_for()
+         * @return number of threads
+         */
+        std::size_t get_thread_count() const noexcept {
+            return this->workers.size() + 1;
+        }
+
+        /**
+         * Call the function once for each index from 0 to count - 1, returning once every call is done. The calling
+         * thread works too, so this never waits on work that can't be started.
+         * @param count       number of indices
+         * @param function    function to call with each index
+         * @param max_threads maximum number of threads to use, including the calling thread
+         * @throws            the first exception thrown by the function, after which the remaining indices are skipped
+         */
+        void parallel_for(std::size_t count, const std::function<void (std::size_t)> &function, std::size_t max_threads = SIZE_MAX);
+
+        /**
+         * Start the worker threads
+         * @param thread_count number of threads, including the thread calling parallel_for()
+         */
+        ThreadPool(std::size_t thread_count);
+
+        /**
+         * Stop the worker threads
+         */
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+    private:
+        struct Job {
+            const std::function<void (std::size_t)> *function;
+            std::size_t count;
+            std::atomic<std::size_t> next = 0;
+            std::size_t helpers_wanted;
+            std::size_t helpers_working = 0;
+            MemoryUsage::Category memory_usage_category;
+            std::mutex exception_mutex;
+            std::exception_ptr exception;
+        };
+
+        static void run_job(Job &job) noexcept;
+        void work();
+
+        std::vector<std::thread> workers;
+        std::deque<Job *> jobs;
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable job_available;
+        std::condition_variable helper_done;
+    };
+}
+
+#endif
@@ -3,29 +3,43 @@
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <archive.h>
 #include <archive_entry.h>
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/map/map.hpp>
 #include <invader/dependency/found_tag_dependency.hpp>
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
+#include <invader/file/tag_bundle.hpp>
 
 struct Format {
     const char *name;
     const char *extension;
     int (*filter)(archive *a);
     int (*format)(archive *a);
+    bool threaded_filter;
+    bool tag_bundle = false;
+    bool tag_bundle_compressed = false;
 };
 
 static const constexpr Format formats[] = {
-    {"7z", ".7z", nullptr, archive_write_set_format_7zip},
-    {"tar-gz", ".tar.xz", archive_write_add_filter_gzip, archive_write_set_format_pax_restricted},
-    {"tar-xz", ".tar.xz", archive_write_add_filter_xz, archive_write_set_format_pax_restricted},
-    {"tar-zst", ".tar.zst", archive_write_add_filter_zstd, archive_write_set_format_pax_restricted},
-    {"zip", ".zip", nullptr, archive_write_set_format_zip}
+    {"7z", ".7z", nullptr, archive_write_set_format_7zip, false},
+    {"bundle", ".tagbundle", nullptr, nullptr, false, true, false},
+    {"bundle-deflate", ".tagbundle", nullptr, nullptr, false, true, true},
+    {"tar-gz", ".tar.xz", archive_write_add_filter_gzip, archive_write_set_format_pax_restricted, false},
+    {"tar-xz", ".tar.xz", archive_write_add_filter_xz, archive_write_set_format_pax_restricted, true},
+    {"tar-zst", ".tar.zst", archive_write_add_filter_zstd, archive_write_set_format_pax_restricted, true},
+    {"zip", ".zip", nullptr, archive_write_set_format_zip, false}
 };
 
 static std::string list_formats() {
@@ -39,27 +53,544 @@ static std::string list_formats() {
     return f;
 }
 
+struct ArchiveOptions {
+    bool single_tag = false;
+    std::vector<std::filesystem::path> tags;
+    std::vector<std::filesystem::path> tags_excluded;
+    std::vector<std::filesystem::path> tags_excluded_same;
+    std::optional<std::filesystem::path> hash_cache;
+    std::string output;
+    bool use_filesystem_path = false;
+    bool copy = false;
+    bool verbose = false;
+    bool overwrite = false;
+    bool separate = false;
+    std::optional<Invader::HEK::GameEngine> engine;
+    const Format *format = &formats[0];
+    std::size_t thread_count = Invader::ThreadPool::get_shared_thread_count();
+};
+
+// Pairs of the tag's file path and the path to store it at in the archive
+using ArchiveList = std::vector<std::pair<std::filesystem::path, std::string>>;
+
+// Finds tags in the tags directories, remembering what was found so tags shared between scenarios are only looked up once
+class TagFileResolver {
+public:
+    TagFileResolver(const std::vector<std::filesystem::path> &tags) : tags(tags) {}
+
+    std::optional<std::filesystem::path> resolve(const std::string &full_tag_path) {
+        std::unique_lock lock(this->mutex);
+        auto found = this->resolved.find(full_tag_path);
+        if(found != this->resolved.end()) {
+            return found->second;
+        }
+        lock.unlock();
+
+        std::optional<std::filesystem::path> file_path;
+        for(auto &dir : this->tags) {
+            std::filesystem::path tag_path = std::filesystem::path(dir) / full_tag_path;
+            if(std::filesystem::exists(tag_path)) {
+                file_path = tag_path;
+                break;
+            }
+        }
+
+        lock.lock();
+        this->resolved.emplace(full_tag_path, file_path);
+        return file_path;
+    }
+
+private:
+    const std::vector<std::filesystem::path> &tags;
+    std::map<std::string, std::optional<std::filesystem::path>> resolved;
+    std::mutex mutex;
+};
+
+// Functional hashes of tags, kept between runs so tags that were already found to be the same don't need to be compared again
+class FunctionalHashCache {
+public:
+    // Increment this if the format of the cache or how tags are hashed changes
+    static constexpr std::uint64_t VERSION = 1;
+    static constexpr char MAGIC[8] = { 'i', 'n', 'v', 'a', 'r', 'c', 'f', 'h' };
+
+    void load(const std::filesystem::path &path) {
+        using namespace Invader;
+
+        auto data = File::open_file(path);
+        if(!data.has_value() || data->size() < sizeof(MAGIC) || std::memcmp(data->data(), MAGIC, sizeof(MAGIC)) != 0) {
+            return;
+        }
+
+        std::size_t offset = sizeof(MAGIC);
+        auto read_value = [&data, &offset](std::uint64_t &value) -> bool {
+            if(data->size() - offset < sizeof(value)) {
+                return false;
+            }
+            value = 0;
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                value |= static_cast<std::uint64_t>((*data)[offset++]) << (i * 8);
+            }
+            return true;
+        };
+        auto read_string = [&data, &offset, &read_value](std::string &string) -> bool {
+            std::uint64_t length;
+            if(!read_value(length) || data->size() - offset < length) {
+                return false;
+            }
+            string = std::string(reinterpret_cast<const char *>(data->data() + offset), length);
+            offset += length;
+            return true;
+        };
+
+        // Tag definitions can change between versions, so hashes from other versions can't be used
+        std::uint64_t version, count;
+        std::string invader_version;
+        if(!read_value(version) || version != VERSION || !read_string(invader_version) || invader_version != full_version() || !read_value(count)) {
+            return;
+        }
+
+        // Throw away the whole thing if anything is wrong with it
+        std::unordered_map<std::string, Entry> entries;
+        for(std::uint64_t e = 0; e < count; e++) {
+            std::string key;
+            std::uint64_t size, modification_time, hash;
+            if(!read_string(key) || !read_value(size) || !read_value(modification_time) || !read_value(hash)) {
+                return;
+            }
+            entries[std::move(key)] = { size, static_cast<std::int64_t>(modification_time), hash };
+        }
+
+        if(offset == data->size()) {
+            this->entries = std::move(entries);
+        }
+    }
+
+    bool save(const std::filesystem::path &path) const {
+        using namespace Invader;
+
+        std::vector<std::byte> data(reinterpret_cast<const std::byte *>(MAGIC), reinterpret_cast<const std::byte *>(MAGIC) + sizeof(MAGIC));
+        auto write_value = [&data](std::uint64_t value) {
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+            }
+        };
+        auto write_string = [&data, &write_value](const std::string &string) {
+            write_value(string.size());
+            data.insert(data.end(), reinterpret_cast<const std::byte *>(string.data()), reinterpret_cast<const std::byte *>(string.data()) + string.size());
+        };
+
+        write_value(VERSION);
+        write_string(full_version());
+        write_value(this->entries.size());
+        for(auto &[key, entry] : this->entries) {
+            write_string(key);
+            write_value(entry.size);
+            write_value(static_cast<std::uint64_t>(entry.modification_time));
+            write_value(entry.hash);
+        }
+
+        return File::save_file(path, data);
+    }
+
+    std::optional<std::uint64_t> find(const std::filesystem::path &path) const {
+        auto [size, modification_time] = file_info(path);
+        auto entry = this->entries.find(path.string());
+        if(entry == this->entries.end() || entry->second.size != size || entry->second.modification_time != modification_time) {
+            return std::nullopt;
+        }
+        return entry->second.hash;
+    }
+
+    void add(const std::filesystem::path &path, std::uint64_t hash) {
+        auto [size, modification_time] = file_info(path);
+        this->entries[path.string()] = { size, modification_time, hash };
+    }
+
+private:
+    struct Entry {
+        std::uint64_t size;
+        std::int64_t modification_time;
+        std::uint64_t hash;
+    };
+    std::unordered_map<std::string, Entry> entries;
+
+    static std::pair<std::uint64_t, std::int64_t> file_info(const std::filesystem::path &path) {
+        std::error_code ec;
+        std::uint64_t size = std::filesystem::file_size(path, ec);
+        std::int64_t modification_time = ec ? 0 : std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        return { ec ? 0 : size, modification_time };
+    }
+};
+
+static std::optional<ArchiveList> resolve_scenario(const std::string &base_tag, const ArchiveOptions &archive_options, TagFileResolver &resolver, std::size_t thread_count, const std::shared_ptr<Invader::BuildWorkload::SharedTagCache> &shared_tag_cache) {
+    using namespace Invader;
+
+    // Build the map
+    std::vector<std::byte> map;
+
+    try {
+        BuildWorkload::BuildParameters parameters(*archive_options.engine);
+        parameters.scenario = base_tag;
+        parameters.tags_directories = archive_options.tags;
+        parameters.use_tags_for_script_data = true; // TODODILE: use data folder and implement tags/ and data/ split in output archive
+        if(parameters.details.build_cache_file_engine == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            parameters.details.build_compression_level = 0;
+        }
+        if(parameters.details.build_cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            parameters.details.build_maximum_cache_file_size = UINT32_MAX;
+        }
+        parameters.verbosity = BuildWorkload::BuildParameters::BUILD_VERBOSITY_QUIET;
+        parameters.thread_count = thread_count;
+        parameters.shared_tag_cache = shared_tag_cache;
+
+        map = BuildWorkload::compile_map(parameters);
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to compile scenario %s into a map: %s", base_tag.c_str(), e.what());
+        return std::nullopt;
+    }
+
+    // Parse the map
+    std::unique_ptr<Map> parsed_map;
+    try {
+        parsed_map = std::make_unique<Map>(Map::map_with_move(std::move(map)));
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to parse the map file generated with scenario %s: %s", base_tag.c_str(), e.what());
+        return std::nullopt;
+    }
+    auto tag_count = parsed_map->get_tag_count();
+
+    // Go through each tag and see if we can find everything.
+    ArchiveList archive_list;
+    archive_list.reserve(tag_count + 64);
+
+    auto archive_it = [&resolver, &archive_list](const std::string &path, TagFourCC fourcc) -> bool {
+        std::string full_tag_path = File::halo_path_to_preferred_path(path) + "." + tag_fourcc_to_extension(fourcc);
+
+        // Check each tags directory if it exists. If so, archive it
+        auto tag_path = resolver.resolve(full_tag_path);
+        if(!tag_path.has_value()) {
+            eprintf_error("Failed to find %s. Archive could not be made.", full_tag_path.c_str());
+            return false;
+        }
+
+        archive_list.emplace_back(*tag_path, full_tag_path);
+        return true;
+    };
+
+    for(std::size_t i = 0; i < tag_count; i++) {
+        // Get the tag path information
+        auto &tag = parsed_map->get_tag(i);
+        if(!archive_it(tag.get_path(), tag.get_tag_fourcc())) {
+            return std::nullopt;
+        }
+    }
+
+    // Archive child scenarios
+    try {
+        auto path = Invader::File::tag_path_to_file_path(base_tag + ".scenario", archive_options.tags);
+        auto scenario_data = Invader::File::open_file(path.value()).value();
+        auto scenario_ptr = Invader::Parser::ParserStruct::parse_hek_tag_file(scenario_data.data(), scenario_data.size());
+        auto &scenario = dynamic_cast<Invader::Parser::Scenario &>(*scenario_ptr);
+        for(auto &child : scenario.child_scenarios) {
+            if(!child.child_scenario.path.empty() && !archive_it(child.child_scenario.path, child.child_scenario.tag_fourcc)) {
+                return std::nullopt;
+            }
+        }
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to get dependencies of %s.scenario: %s", base_tag.c_str(), e.what());
+        return std::nullopt;
+    }
+
+    return archive_list;
+}
+
+static std::optional<ArchiveList> resolve_single_tag(const std::string &base_tag, const ArchiveOptions &archive_options, TagFileResolver &resolver) {
+    using namespace Invader;
+
+    // Turn it into something the filesystem can understand
+    auto base_tag_copy = base_tag;
+    auto base_tag_split_maybe = File::split_tag_class_extension_chars(base_tag_copy.data());
+
+    // Split the extension
+    if(!base_tag_split_maybe.has_value()) {
+        eprintf_error("%s is not a valid tag. Archive could not be made.", base_tag.c_str());
+        return std::nullopt;
+    }
+
+    // Add it
+    ArchiveList archive_list;
+    auto tag_path = resolver.resolve(base_tag);
+    if(!tag_path.has_value()) {
+        eprintf_error("Failed to find %s. Archive could not be made.", base_tag.c_str());
+        return std::nullopt;
+    }
+    archive_list.emplace_back(*tag_path, base_tag);
+
+    // Now find its dependencies
+    bool success;
+    auto &base_tag_split = base_tag_split_maybe.value();
+    auto dependencies = FoundTagDependency::find_dependencies(base_tag_split.path.c_str(), base_tag_split.fourcc, archive_options.tags, false, true, success);
+    if(!success) {
+        eprintf_error("Failed to find dependencies for %s. Archive could not be made.", base_tag.c_str());
+        return std::nullopt;
+    }
+
+    // Make sure there aren't any broken dependencies
+    for(auto &dependency : dependencies) {
+        if(dependency.broken) {
+            eprintf_error("%s.%s is missing (broken dependency). Archive could not be made.", dependency.path.c_str(), tag_fourcc_to_extension(dependency.fourcc));
+            return std::nullopt;
+        }
+
+        std::string path_copy = File::halo_path_to_preferred_path(dependency.path + "." + tag_fourcc_to_extension(dependency.fourcc));
+        archive_list.emplace_back(*dependency.file_path, path_copy);
+    }
+
+    return archive_list;
+}
+
+static bool write_archive(const ArchiveList &archive_list, const std::string &output, const ArchiveOptions &archive_options) {
+    using namespace Invader;
+
+    // Begin making the archive
+    auto *archive = archive_write_new();
+    if(archive_options.format->filter) {
+        archive_options.format->filter(archive);
+
+        // Let xz and zstd compress on multiple threads (older versions of libarchive don't support this, in which case it's just done on one thread)
+        if(archive_options.format->threaded_filter) {
+            auto threads = std::to_string(archive_options.thread_count);
+            archive_write_set_filter_option(archive, nullptr, "threads", threads.c_str());
+        }
+    }
+    if(archive_options.format->format) {
+        archive_options.format->format(archive);
+    }
+    archive_write_open_filename(archive, output.c_str());
+
+    // Read the tags on another thread while we compress
+    struct ReadTag {
+        std::optional<std::vector<std::byte>> data;
+        struct stat s;
+    };
+    std::deque<ReadTag> read_tags;
+    std::mutex read_mutex;
+    std::condition_variable read_tags_changed;
+    bool stop_reading = false;
+    static constexpr std::size_t MAX_READ_AHEAD = 16;
+
+    std::thread reader([&archive_list, &read_tags, &read_mutex, &read_tags_changed, &stop_reading]() {
+        for(auto &tag : archive_list) {
+            auto str_path = tag.first.string();
+            ReadTag read_tag;
+            read_tag.data = File::open_file(str_path.c_str());
+            stat(str_path.c_str(), &read_tag.s);
+
+            std::unique_lock lock(read_mutex);
+            read_tags_changed.wait(lock, [&read_tags, &stop_reading]() { return stop_reading || read_tags.size() < MAX_READ_AHEAD; });
+            if(stop_reading) {
+                return;
+            }
+            read_tags.emplace_back(std::move(read_tag));
+            lock.unlock();
+            read_tags_changed.notify_all();
+        }
+    });
+
+    auto stop_reader = [&reader, &read_mutex, &read_tags_changed, &stop_reading]() {
+        {
+            std::scoped_lock lock(read_mutex);
+            stop_reading = true;
+        }
+        read_tags_changed.notify_all();
+        reader.join();
+    };
+
+    // Go through each tag path we got
+    for(std::size_t i = 0; i < archive_list.size(); i++) {
+        auto str_path = archive_list[i].first.string();
+        const char *path = str_path.c_str();
+
+        // libarchive always needs POSIX paths.
+        auto archive_path = archive_list[i].second;
+        for(char &c : archive_path) {
+            if(c == std::filesystem::path::preferred_separator) {
+                c = '/';
+            }
+        }
+
+        // Get the next tag from the reader
+        std::unique_lock lock(read_mutex);
+        read_tags_changed.wait(lock, [&read_tags]() { return !read_tags.empty(); });
+        auto read_tag = std::move(read_tags.front());
+        read_tags.pop_front();
+        lock.unlock();
+        read_tags_changed.notify_all();
+
+        if(!read_tag.data.has_value()) {
+            eprintf_error("Failed to open %s\n", path);
+            stop_reader();
+            archive_write_free(archive);
+            return false;
+        }
+        auto &data = read_tag.data.value();
+        auto &s = read_tag.s;
+
+        // Begin
+        auto *entry = archive_entry_new();
+        archive_entry_set_pathname(entry, archive_path.c_str());
+        archive_entry_set_perm(entry, 0644);
+        archive_entry_set_filetype(entry, AE_IFREG);
+
+        // Windows uses mtime which is a time_t rather than a struct with nanoseconds
+        #ifdef _WIN32
+        archive_entry_set_mtime(entry, s.st_mtime, 0);
+        #else
+        archive_entry_set_mtime(entry, s.st_mtim.tv_sec, 0);
+        #endif
+
+        // Archive that bastard
+        archive_entry_set_size(entry, data.size());
+        archive_write_header(archive, entry);
+        archive_write_data(archive, data.data(), data.size());
+
+        // Close it
+        archive_entry_free(entry);
+    }
+
+    stop_reader();
+
+    // Save and close
+    archive_write_close(archive);
+    archive_write_free(archive);
+
+    oprintf("Saved %s\n", output.c_str());
+    return true;
+}
+
+static bool write_tag_bundle(const ArchiveList &archive_list, const std::string &output, const ArchiveOptions &archive_options) {
+    using namespace Invader;
+
+    // Read the tags on multiple threads
+    std::vector<File::TagBundle::BundledTag> tags(archive_list.size());
+    std::atomic<bool> failed = false;
+    ThreadPool::shared().parallel_for(archive_list.size(), [&archive_list, &tags, &failed](std::size_t i) {
+        auto data = File::open_file(archive_list[i].first);
+        if(!data.has_value()) {
+            eprintf_error("Failed to open %s\n", archive_list[i].first.string().c_str());
+            failed = true;
+            return;
+        }
+        tags[i].path = File::preferred_path_to_halo_path(archive_list[i].second);
+        tags[i].data = std::move(*data);
+    }, archive_options.thread_count);
+    if(failed) {
+        return false;
+    }
+
+    std::vector<std::byte> bundle;
+    try {
+        bundle = File::TagBundle::generate_bundle(tags, archive_options.format->tag_bundle_compressed);
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to make a tag bundle: %s", e.what());
+        return false;
+    }
+
+    if(!File::save_file(output, bundle)) {
+        eprintf_error("Failed to write to %s", output.c_str());
+        return false;
+    }
+
+    oprintf("Saved %s\n", output.c_str());
+    return true;
+}
+
+static bool copy_tags(const ArchiveList &archive_list, const std::string &output, const ArchiveOptions &archive_options) {
+    using namespace Invader;
+
+    // Make the directory if it doesn't yet exist
+    auto base_path = std::filesystem::path(output.c_str());
+    if(!std::filesystem::is_directory(base_path)) {
+        try {
+            std::filesystem::create_directory(base_path);
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to create directory %s: %s", base_path.string().c_str(), e.what());
+            return false;
+        }
+    }
+
+    // Go through each file to archive
+    for(std::size_t i = 0; i < archive_list.size(); i++) {
+        auto old_path = std::filesystem::path(archive_list[i].first.c_str());
+        auto new_path = base_path / std::filesystem::path(archive_list[i].second.c_str());
+
+        // Copy function
+        auto place_if_possible = [&new_path, &old_path, &archive_options]() -> bool {
+            // If it exists, continue
+            bool tag_exists = std::filesystem::exists(new_path);
+            if(!archive_options.overwrite && tag_exists) {
+                return false;
+            }
+
+            // Try to see if we need to create the directory
+            auto up_one_dir = new_path.parent_path();
+            if(!std::filesystem::exists(up_one_dir)) {
+                try {
+                    std::filesystem::create_directories(up_one_dir);
+                }
+                catch(std::exception &e) {
+                    eprintf_error("Failed to create directory %s: %s", up_one_dir.string().c_str(), e.what());
+                    return false;
+                }
+            }
+
+            // Now copy
+            try {
+                // std::filesystem::copy_options::overwrite_existing is broken on mingw-w64
+                // See https://sourceforge.net/p/mingw-w64/bugs/852/
+                // TODO: Remove this if they fix it
+                #ifdef __MINGW32__
+                if(tag_exists) {
+                    std::filesystem::remove(new_path);
+                }
+                std::filesystem::copy_file(old_path, new_path);
+                #else
+                std::filesystem::copy_file(old_path, new_path, std::filesystem::copy_options::overwrite_existing);
+                #endif
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to create copy %s to %s: %s", old_path.string().c_str(), new_path.string().c_str(), e.what());
+                return false;
+            }
+
+            return true;
+        };
+
+        if(place_if_possible()) {
+            oprintf_success("Saved %s", new_path.string().c_str());
+        }
+        else {
+            eprintf_warn("Skipping %s...", new_path.string().c_str());
+        }
+    }
+
+    return true;
+}
+
 int main(int argc, const char **argv) {
     set_up_color_term();
 
     using namespace Invader;
 
-    struct ArchiveOptions {
-        bool single_tag = false;
-        std::vector<std::filesystem::path> tags;
-        std::vector<std::filesystem::path> tags_excluded;
-        std::vector<std::filesystem::path> tags_excluded_same;
-        std::string output;
-        bool use_filesystem_path = false;
-        bool copy = false;
-        bool verbose = false;
-        bool overwrite = false;
-        std::optional<HEK::GameEngine> engine;
-        const Format *format = &formats[0];
-    } archive_options;
+    ArchiveOptions archive_options;
 
     static constexpr char DESCRIPTION[] = "Generate .tar.xz archives of the tags required to build a cache file.";
-    static constexpr char USAGE[] = "[options] <-g <engine> <scenario> | -s tag.class>";
+    static constexpr char USAGE[] = "[options] <-g <engine> <scenario...> | -s <tag.class...>>";
 
     std::string formats_argument = std::string("Specify format. Valid formats are: ") + list_formats() + ". Default format is 7z";
 
@@ -70,15 +601,18 @@ int main(int argc, const char **argv) {
         CommandLineOption("format", 'F', 1, formats_argument.c_str(), "<format>"),
         CommandLineOption("single-tag", 's', 0, "Archive a tag tree instead of a cache file."),
         CommandLineOption("exclude-matched", 'E', 1, "Exclude copying any tags that are also located in the specified directory and are functionally the same. Use multiple times to exclude multiple directories."),
+        CommandLineOption("hash-cache", 'H', 1, "Keep functional hashes of tags in the given file between runs so --exclude-matched only has to compare tags that changed since they were found to be the same.", "<file>"),
         CommandLineOption("overwrite", 'O', 0, "Overwrite tags if they already exist if using --copy"),
         CommandLineOption("exclude", 'e', 1, "Exclude copying any tags that share a path with a tag in specified directory. Use multiple times to exclude multiple directories.", "<dir>"),
-        CommandLineOption("output", 'o', 1, "Output to a specific file. Extension must be .tar.xz unless using --copy which then it's a directory.", "<file>"),
+        CommandLineOption("output", 'o', 1, "Output to a specific file. Extension must be .tar.xz unless using --copy which then it's a directory. This is required if archiving more than one scenario or tag into one archive.", "<file>"),
         CommandLineOption("fs-path", 'P', 0, "Use a filesystem path for the tag."),
         CommandLineOption("copy", 'C', 0, "Copy instead of making an archive."),
-        CommandLineOption("verbose", 'v', 0, "Print whether or not tags are omitted. Do verbose comparisons.")
+        CommandLineOption("verbose", 'v', 0, "Print whether or not tags are omitted. Do verbose comparisons."),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("separate", 'S', 0, "When given more than one scenario or tag, make one archive for each instead of one archive with all of them. Each archive is named after its scenario or tag. Dependencies are still only resolved once.")
     };
 
-    auto remaining_arguments = CommandLineOption::parse_arguments<ArchiveOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, archive_options, [](char opt, const auto &arguments, auto &archive_options) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<ArchiveOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 65535, archive_options, [](char opt, const auto &arguments, auto &archive_options) {
         switch(opt) {
             case 'F': {
                 bool found = false;
@@ -104,6 +638,9 @@ int main(int argc, const char **argv) {
             case 'E':
                 archive_options.tags_excluded_same.push_back(arguments[0]);
                 break;
+            case 'H':
+                archive_options.hash_cache = arguments[0];
+                break;
             case 'o':
                 archive_options.output = arguments[0];
                 break;
@@ -136,9 +673,18 @@ int main(int argc, const char **argv) {
             case 'C':
                 archive_options.copy = true;
                 break;
+            case 'S':
+                archive_options.separate = true;
+                break;
+            case 'j':
+                archive_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
         }
     });
 
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(archive_options.thread_count);
+
     // Figure out our engine target
     if(!archive_options.engine.has_value() && !archive_options.single_tag) {
         eprintf_error("No engine target specified for map archival. Use -h for more information.");
@@ -151,211 +697,151 @@ int main(int argc, const char **argv) {
     }
 
     // Require a tag
-    std::string base_tag;
-    if(archive_options.use_filesystem_path) {
-        // See if the tag path is valid
-        std::optional<std::string> base_tag_maybe;
-        if(std::filesystem::exists(remaining_arguments[0])) {
-            base_tag_maybe = File::file_path_to_tag_path(remaining_arguments[0], archive_options.tags);
-        }
-        if(base_tag_maybe.has_value()) {
-            base_tag = *base_tag_maybe;
-
-            // Remove extension if necessary
-            if(!archive_options.single_tag) {
-                auto path_test = std::filesystem::path(base_tag);
-                if(path_test.extension() != ".scenario") {
-                    eprintf_error("This function only accepts scenario tags. To use other tags, use -s");
-                    return EXIT_FAILURE;
+    std::vector<std::string> base_tags;
+    for(auto *argument : remaining_arguments) {
+        std::string base_tag;
+        if(archive_options.use_filesystem_path) {
+            // See if the tag path is valid
+            std::optional<std::string> base_tag_maybe;
+            if(std::filesystem::exists(argument)) {
+                base_tag_maybe = File::file_path_to_tag_path(argument, archive_options.tags);
+            }
+            if(base_tag_maybe.has_value()) {
+                base_tag = *base_tag_maybe;
+
+                // Remove extension if necessary
+                if(!archive_options.single_tag) {
+                    auto path_test = std::filesystem::path(base_tag);
+                    if(path_test.extension() != ".scenario") {
+                        eprintf_error("This function only accepts scenario tags. To use other tags, use -s");
+                        return EXIT_FAILURE;
+                    }
+                    base_tag = path_test.replace_extension().string();
                 }
-                base_tag = path_test.replace_extension().string();
+            }
+            else {
+                eprintf_error("Failed to find a valid%stag %s in the tags directory", archive_options.single_tag ? " " : " scenario ", argument);
+                return EXIT_FAILURE;
             }
         }
         else {
-            eprintf_error("Failed to find a valid%stag %s in the tags directory", archive_options.single_tag ? " " : " scenario ", remaining_arguments[0]);
-            return EXIT_FAILURE;
+            base_tag = argument;
         }
-    }
-    else {
-        base_tag.insert(base_tag.end(), remaining_arguments[0], remaining_arguments[0] + std::strlen(remaining_arguments[0]));
+        base_tags.emplace_back(std::move(base_tag));
     }
 
-    // Variables to hold this
-    std::vector<std::pair<std::filesystem::path, std::string>> archive_list;
+    bool separate = archive_options.separate && base_tags.size() > 1;
+    if(base_tags.size() > 1 && !separate && archive_options.output.empty()) {
+        eprintf_error("An output path is required to put more than one %s in one archive. Use -S to make one archive for each instead.", archive_options.single_tag ? "tag" : "scenario");
+        return EXIT_FAILURE;
+    }
+    if(separate && !archive_options.output.empty()) {
+        eprintf_error("An output path cannot be given when making one archive for each %s", archive_options.single_tag ? "tag" : "scenario");
+        return EXIT_FAILURE;
+    }
 
     // If no output filename was given, make one
     const char *extension = archive_options.format->extension;
-    if(archive_options.output.size() == 0) {
-        // Set output
-        archive_options.output = File::base_name(base_tag.data()) + ((archive_options.copy) ? "" : extension);
-    }
-    else {
-        bool fail = true;
-        auto extension_len = std::strlen(extension);
-        if(archive_options.output.size() > extension_len) {
-            fail = std::strcmp(archive_options.output.c_str() + archive_options.output.size() - extension_len + 1, extension) != 0;
+    std::vector<std::string> outputs;
+    for(auto &base_tag : base_tags) {
+        if(!separate && !outputs.empty()) {
+            break;
         }
-
-        if(!archive_options.copy) {
-            if(fail) {
-                eprintf_error("Invalid output file path %s. This should end with %s.\n", archive_options.output.c_str(), extension);
-                return EXIT_FAILURE;
-            }
+        auto &output = outputs.emplace_back(archive_options.output);
+        if(output.size() == 0) {
+            // Set output
+            output = File::base_name(base_tag.data()) + ((archive_options.copy) ? "" : extension);
         }
         else {
-            if(!fail) {
-                eprintf_warn("Output directory path %s ends with %s.\nThis is technically valid, but you probably didn't want to do this.", archive_options.output.c_str(), extension);
-            }
-        }
-    }
-
-    // Fix this a bit
-    File::halo_path_to_preferred_path_chars(base_tag.data());
-    File::remove_duplicate_slashes_chars(base_tag.data());
-
-    if(!archive_options.single_tag) {
-        // Build the map
-        std::vector<std::byte> map;
-
-        try {
-            BuildWorkload::BuildParameters parameters(*archive_options.engine);
-            parameters.scenario = base_tag;
-            parameters.tags_directories = archive_options.tags;
-            parameters.use_tags_for_script_data = true; // TODODILE: use data folder and implement tags/ and data/ split in output archive
-            if(parameters.details.build_cache_file_engine == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                parameters.details.build_compression_level = 0;
-            }
-            if(parameters.details.build_cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                parameters.details.build_maximum_cache_file_size = UINT32_MAX;
+            bool fail = true;
+            auto extension_len = std::strlen(extension);
+            if(output.size() > extension_len) {
+                fail = std::strcmp(output.c_str() + output.size() - extension_len + 1, extension) != 0;
             }
-            parameters.verbosity = BuildWorkload::BuildParameters::BUILD_VERBOSITY_QUIET;
-
-            map = BuildWorkload::compile_map(parameters);
-        }
-        catch(std::exception &e) {
-            eprintf_error("Failed to compile scenario %s into a map: %s", base_tag.c_str(), e.what());
-            return EXIT_FAILURE;
-        }
-
-        // Parse the map
-        std::unique_ptr<Map> parsed_map;
-        try {
-            parsed_map = std::make_unique<Map>(Map::map_with_move(std::move(map)));
-        }
-        catch(std::exception &e) {
-            eprintf_error("Failed to parse the map file generated with scenario %s: %s", base_tag.c_str(), e.what());
-            return EXIT_FAILURE;
-        }
-        auto tag_count = parsed_map->get_tag_count();
-
-        // Go through each tag and see if we can find everything.
-        archive_list.reserve(tag_count + 64);
-
-        auto archive_it = [&archive_options, &archive_list](const std::string &path, TagFourCC fourcc) {
-            std::string full_tag_path = File::halo_path_to_preferred_path(path) + "." + tag_fourcc_to_extension(fourcc);
 
-            // Check each tags directory if it exists. If so, archive it (todo: refactor to tag_path_to_file_path())
-            bool exists = false;
-            for(auto &dir : archive_options.tags) {
-                std::filesystem::path tag_path = std::filesystem::path(dir) / full_tag_path;
-                if(std::filesystem::exists(tag_path)) {
-                    exists = true;
-                    archive_list.emplace_back(tag_path.string(), full_tag_path);
-                    break;
+            if(!archive_options.copy) {
+                if(fail) {
+                    eprintf_error("Invalid output file path %s. This should end with %s.\n", output.c_str(), extension);
+                    return EXIT_FAILURE;
                 }
             }
-
-            if(!exists) {
-                eprintf_error("Failed to find %s. Archive could not be made.", full_tag_path.c_str());
-                std::exit(EXIT_FAILURE);
-            }
-        };
-
-        for(std::size_t i = 0; i < tag_count; i++) {
-            // Get the tag path information
-            auto &tag = parsed_map->get_tag(i);
-            archive_it(tag.get_path(), tag.get_tag_fourcc());
-        }
-
-        // Archive child scenarios
-        try {
-            auto path = Invader::File::tag_path_to_file_path(base_tag + ".scenario", archive_options.tags);
-            auto scenario_data = Invader::File::open_file(path.value()).value();
-            auto scenario_ptr = Invader::Parser::ParserStruct::parse_hek_tag_file(scenario_data.data(), scenario_data.size());
-            auto &scenario = dynamic_cast<Invader::Parser::Scenario &>(*scenario_ptr);
-            for(auto &child : scenario.child_scenarios) {
-                if(!child.child_scenario.path.empty()) {
-                    archive_it(child.child_scenario.path, child.child_scenario.tag_fourcc);
+            else {
+                if(!fail) {
+                    eprintf_warn("Output directory path %s ends with %s.\nThis is technically valid, but you probably didn't want to do this.", output.c_str(), extension);
                 }
             }
         }
-        catch(std::exception &e) {
-            eprintf_error("Failed to get dependencies of %s.scenario: %s", base_tag.c_str(), e.what());
-            return EXIT_FAILURE;
-        }
     }
-    else {
-        // Turn it into something the filesystem can understand
-        auto base_tag_split_maybe = File::split_tag_class_extension_chars(base_tag.data());
 
-        // Split the extension
-        if(!base_tag_split_maybe.has_value()) {
-            eprintf_error("%s is not a valid tag. Archive could not be made.", base_tag.data());
-            return EXIT_FAILURE;
-        }
+    // Fix this a bit
+    for(auto &base_tag : base_tags) {
+        File::halo_path_to_preferred_path_chars(base_tag.data());
+        File::remove_duplicate_slashes_chars(base_tag.data());
+    }
 
-        // Add it
-        bool exists = false;
-        for(auto &dir : archive_options.tags) {
-            std::filesystem::path tag_path = std::filesystem::path(dir) / base_tag.data();
-            if(std::filesystem::exists(tag_path)) {
-                exists = true;
-                archive_list.emplace_back(tag_path.string(), base_tag.data());
-                break;
-            }
-        }
+    // Resolve everything, sharing tag lookups between scenarios. If there's more than one, each scenario is built on its own thread instead of loading tags on multiple threads.
+    TagFileResolver resolver(archive_options.tags);
+    std::vector<std::optional<ArchiveList>> resolved(base_tags.size());
+    std::size_t build_thread_count = base_tags.size() == 1 ? archive_options.thread_count : 1;
 
-        if(!exists) {
-            eprintf_error("Failed to find %s. Archive could not be made.", base_tag.data());
-            return EXIT_FAILURE;
-        }
+    // Tags that compile the same way for every scenario are compiled once and shared
+    std::shared_ptr<BuildWorkload::SharedTagCache> shared_tag_cache;
+    if(base_tags.size() > 1 && !archive_options.single_tag) {
+        shared_tag_cache = std::make_shared<BuildWorkload::SharedTagCache>();
+    }
 
-        // Now find its dependencies
-        bool success;
-        auto &base_tag_split = base_tag_split_maybe.value();
-        auto dependencies = FoundTagDependency::find_dependencies(base_tag_split.path.c_str(), base_tag_split.fourcc, archive_options.tags, false, true, success);
-        if(!success) {
-            eprintf_error("Failed to find dependencies for %s. Archive could not be made.", base_tag.data());
+    ThreadPool::shared().parallel_for(base_tags.size(), [&](std::size_t i) {
+        if(archive_options.single_tag) {
+            resolved[i] = resolve_single_tag(base_tags[i], archive_options, resolver);
+        }
+        else {
+            resolved[i] = resolve_scenario(base_tags[i], archive_options, resolver, build_thread_count, shared_tag_cache);
+        }
+    }, archive_options.thread_count);
+
+    // Merge them, keeping only one of each tag, and remember which tags each one needs
+    ArchiveList archive_list;
+    std::map<std::string, std::size_t> archive_list_indices;
+    std::vector<std::vector<std::size_t>> tags_used(base_tags.size());
+    for(std::size_t i = 0; i < resolved.size(); i++) {
+        if(!resolved[i].has_value()) {
             return EXIT_FAILURE;
         }
-
-        // Make sure there aren't any broken dependencies
-        for(auto &dependency : dependencies) {
-            if(dependency.broken) {
-                eprintf_error("%s.%s is missing (broken dependency). Archive could not be made.", dependency.path.c_str(), tag_fourcc_to_extension(dependency.fourcc));
-                return EXIT_FAILURE;
+        for(auto &tag : *resolved[i]) {
+            auto [index, inserted] = archive_list_indices.try_emplace(tag.second, archive_list.size());
+            if(inserted) {
+                archive_list.emplace_back(std::move(tag));
             }
-
-            std::string path_copy = File::halo_path_to_preferred_path(dependency.path + "." + tag_fourcc_to_extension(dependency.fourcc));
-            archive_list.emplace_back(*dependency.file_path, path_copy);
+            tags_used[i].emplace_back(index->second);
         }
     }
 
     // Don't archive anything that is in an excluded directory
+    std::vector<bool> excluded(archive_list.size(), false);
     for(auto &i : archive_options.tags_excluded) {
         for(std::size_t t = 0; t < archive_list.size(); t++) {
             // First check if it exists
             auto path_to_test = i / File::halo_path_to_preferred_path(archive_list[t].second);
-            if(std::filesystem::exists(path_to_test)) {
+            if(!excluded[t] && std::filesystem::exists(path_to_test)) {
                 // Exclude
-                archive_list.erase(archive_list.begin() + t);
-                t--;
+                excluded[t] = true;
             }
         }
     }
 
+    // Tags with the same functional hash are the same, so only tags with different (or unknown) hashes need to be compared
+    std::optional<FunctionalHashCache> hash_cache;
+    if(archive_options.hash_cache.has_value() && !archive_options.tags_excluded_same.empty()) {
+        hash_cache.emplace();
+        hash_cache->load(*archive_options.hash_cache);
+    }
+
     for(auto &i : archive_options.tags_excluded_same) {
         for(std::size_t t = 0; t < archive_list.size(); t++) {
+            if(excluded[t]) {
+                continue;
+            }
+
             // First check if it exists
             auto path_to_test = i / File::halo_path_to_preferred_path(archive_list[t].second);
 
@@ -364,15 +850,38 @@ int main(int argc, const char **argv) {
                 std::list<std::string> differences;
 
                 try {
-                    auto tag_archive_data = File::open_file(archive_list[t].first).value();
-                    auto tag_archive = Parser::ParserStruct::parse_hek_tag_file(tag_archive_data.data(), tag_archive_data.size(), true);
-
-                    auto tag_exclude_data = File::open_file(path_to_test).value();
-                    auto tag_exclude = Parser::ParserStruct::parse_hek_tag_file(tag_exclude_data.data(), tag_exclude_data.size(), true);
+                    auto open_tag = [](const std::filesystem::path &path) {
+                        auto data = File::open_file(path).value();
+                        return Parser::ParserStruct::parse_hek_tag_file(data.data(), data.size(), true);
+                    };
+
+                    std::unique_ptr<Parser::ParserStruct> tag_archive, tag_exclude;
+                    bool matched = false;
+
+                    if(hash_cache.has_value()) {
+                        auto hash_of = [&hash_cache, &open_tag](const std::filesystem::path &path, std::unique_ptr<Parser::ParserStruct> &tag) {
+                            if(auto hash = hash_cache->find(path); hash.has_value()) {
+                                return *hash;
+                            }
+                            tag = open_tag(path);
+                            auto hash = tag->content_hash();
+                            hash_cache->add(path, hash);
+                            return hash;
+                        };
+                        matched = hash_of(archive_list[t].first, tag_archive) == hash_of(path_to_test, tag_exclude);
+                    }
 
                     // Do a functional comparison
-                    if(!tag_archive->compare(tag_exclude.get(), true, true, archive_options.verbose ? &differences : nullptr)) {
-                        continue;
+                    if(!matched) {
+                        if(!tag_archive) {
+                            tag_archive = open_tag(archive_list[t].first);
+                        }
+                        if(!tag_exclude) {
+                            tag_exclude = open_tag(path_to_test);
+                        }
+                        if(!tag_archive->compare(tag_exclude.get(), true, true, archive_options.verbose ? &differences : nullptr)) {
+                            continue;
+                        }
                     }
                 }
                 catch (std::exception &) {
@@ -388,154 +897,61 @@ int main(int argc, const char **argv) {
                     }
                 }
 
-                archive_list.erase(archive_list.begin() + t);
-                t--;
+                excluded[t] = true;
             }
         }
     }
 
-    // If we eliminate all tags, don't bother archiving anything
-    if(archive_list.size() == 0) {
-        oprintf_success_warn("There were no tags to archive");
-        return EXIT_SUCCESS;
+    if(hash_cache.has_value() && !hash_cache->save(*archive_options.hash_cache)) {
+        eprintf_warn("Warning: Failed to save the hash cache to %s", archive_options.hash_cache->string().c_str());
     }
 
     // Archive
-    if(!archive_options.copy) {
-        // Begin making the archive
-        auto *archive = archive_write_new();
-        if(archive_options.format->filter) {
-            archive_options.format->filter(archive);
-        }
-        if(archive_options.format->format) {
-            archive_options.format->format(archive);
-        }
-        archive_write_open_filename(archive, archive_options.output.c_str());
-
-        // Go through each tag path we got
-        for(std::size_t i = 0; i < archive_list.size(); i++) {
-            auto str_path = archive_list[i].first.string();
-            const char *path = str_path.c_str();
-
-            // libarchive always needs POSIX paths.
-            auto archive_path = archive_list[i].second;
-            for(char &c : archive_path) {
-                if(c == std::filesystem::path::preferred_separator) {
-                    c = '/';
-                }
+    auto make_output = [&archive_list, &excluded, &archive_options](const std::vector<std::size_t> *indices, const std::string &output) -> bool {
+        ArchiveList output_list;
+        auto add_tag = [&archive_list, &excluded, &output_list](std::size_t t) {
+            if(!excluded[t]) {
+                output_list.emplace_back(archive_list[t]);
             }
-
-            // Begin
-            auto *entry = archive_entry_new();
-            archive_entry_set_pathname(entry, archive_path.c_str());
-            archive_entry_set_perm(entry, 0644);
-            archive_entry_set_filetype(entry, AE_IFREG);
-
-            auto data_maybe = File::open_file(path);
-            if(!data_maybe.has_value()) {
-                eprintf_error("Failed to open %s\n", path);
-                return EXIT_FAILURE;
+        };
+        if(indices) {
+            for(auto t : *indices) {
+                add_tag(t);
             }
-            auto &data = data_maybe.value();
-
-            // Get the filesystem path and write time
-            std::filesystem::path path_path = path;
-
-            // Get the modified time
-            struct stat s;
-            stat(path, &s);
-
-            // Windows uses mtime which is a time_t rather than a struct with nanoseconds
-            #ifdef _WIN32
-            archive_entry_set_mtime(entry, s.st_mtime, 0);
-            #else
-            archive_entry_set_mtime(entry, s.st_mtim.tv_sec, 0);
-            #endif
-
-            // Archive that bastard
-            archive_entry_set_size(entry, data.size());
-            archive_write_header(archive, entry);
-            archive_write_data(archive, data.data(), data.size());
-
-            // Close it
-            archive_entry_free(entry);
         }
-
-        // Save and close
-        archive_write_close(archive);
-        archive_write_free(archive);
-
-        oprintf("Saved %s\n", archive_options.output.c_str());
-    }
-    // Copy
-    else {
-        // Make the directory if it doesn't yet exist
-        auto base_path = std::filesystem::path(archive_options.output.c_str());
-        if(!std::filesystem::is_directory(base_path)) {
-            try {
-                std::filesystem::create_directory(base_path);
-            }
-            catch(std::exception &e) {
-                eprintf_error("Failed to create directory %s: %s", base_path.string().c_str(), e.what());
-                return EXIT_FAILURE;
+        else {
+            for(std::size_t t = 0; t < archive_list.size(); t++) {
+                add_tag(t);
             }
         }
 
-        // Go through each file to archive
-        for(std::size_t i = 0; i < archive_list.size(); i++) {
-            auto old_path = std::filesystem::path(archive_list[i].first.c_str());
-            auto new_path = base_path / std::filesystem::path(archive_list[i].second.c_str());
-
-            // Copy function
-            auto place_if_possible = [&new_path, &old_path, &archive_options]() -> bool {
-                // If it exists, continue
-                bool tag_exists = std::filesystem::exists(new_path);
-                if(!archive_options.overwrite && tag_exists) {
-                    return false;
-                }
-
-                // Try to see if we need to create the directory
-                auto up_one_dir = new_path.parent_path();
-                if(!std::filesystem::exists(up_one_dir)) {
-                    try {
-                        std::filesystem::create_directories(up_one_dir);
-                    }
-                    catch(std::exception &e) {
-                        eprintf_error("Failed to create directory %s: %s", up_one_dir.string().c_str(), e.what());
-                        return false;
-                    }
-                }
-
-                // Now copy
-                try {
-                    // std::filesystem::copy_options::overwrite_existing is broken on mingw-w64
-                    // See https://sourceforge.net/p/mingw-w64/bugs/852/
-                    // TODO: Remove this if they fix it
-                    #ifdef __MINGW32__
-                    if(tag_exists) {
-                        std::filesystem::remove(new_path);
-                    }
-                    std::filesystem::copy_file(old_path, new_path);
-                    #else
-                    std::filesystem::copy_file(old_path, new_path, std::filesystem::copy_options::overwrite_existing);
-                    #endif
-                }
-                catch(std::exception &e) {
-                    eprintf_error("Failed to create copy %s to %s: %s", old_path.string().c_str(), new_path.string().c_str(), e.what());
-                    return false;
-                }
-
-                return true;
-            };
+        // If we eliminate all tags, don't bother archiving anything
+        if(output_list.size() == 0) {
+            oprintf_success_warn("There were no tags to archive for %s", output.c_str());
+            return true;
+        }
 
-            if(place_if_possible()) {
-                oprintf_success("Saved %s", new_path.string().c_str());
+        if(!archive_options.copy) {
+            if(archive_options.format->tag_bundle) {
+                return write_tag_bundle(output_list, output, archive_options);
             }
-            else {
-                eprintf_warn("Skipping %s...", new_path.string().c_str());
+            return write_archive(output_list, output, archive_options);
+        }
+        else {
+            return copy_tags(output_list, output, archive_options);
+        }
+    };
+
+    if(separate) {
+        for(std::size_t i = 0; i < base_tags.size(); i++) {
+            if(!make_output(&tags_used[i], outputs[i])) {
+                return EXIT_FAILURE;
             }
         }
     }
+    else if(!make_output(nullptr, outputs[0])) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
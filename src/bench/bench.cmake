@@ -0,0 +1,18 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+if(NOT DEFINED ${INVADER_BENCH})
+    set(INVADER_BENCH false CACHE BOOL "Build invader-bench (benchmarks building, extracting, bitmap, and sound processing)")
+endif()
+
+if(${INVADER_BENCH})
+    add_executable(invader-bench
+        src/bench/bench.cpp
+        src/bench/synthetic_tags.cpp
+    )
+
+    target_link_libraries(invader-bench invader ${INVADER_CRT_NOGLOB})
+
+    # This is for development, so it isn't installed
+
+    do_windows_rc(invader-bench invader-bench.exe "Invader benchmark tool")
+endif()
@@ -0,0 +1,776 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <filesystem>
+#include <invader/build/build_workload.hpp>
+#include <invader/bitmap/bitmap_encode.hpp>
+#include <invader/bitmap/swizzle.hpp>
+#include <invader/compress/compression.hpp>
+#include <invader/crc/hek/crc.hpp>
+#include <invader/extract/extraction.hpp>
+#include <invader/file/file.hpp>
+#include <invader/map/map.hpp>
+#include <invader/memory_usage.hpp>
+#include <invader/printf.hpp>
+#include <invader/sound/sound_encoder.hpp>
+#include <invader/tag/parser/parser_struct.hpp>
+#include <invader/version.hpp>
+#include "../command_line_option.hpp"
+#include "synthetic_tags.hpp"
+
+using namespace Invader;
+
+// Seed for all generated input data so every run (regardless of --filter) benchmarks the same data
+static constexpr std::uint32_t BENCH_SEED = 0x1A2B3C4D;
+
+// Generated input sizes
+static constexpr std::size_t BITMAP_SIZE = 256;
+static constexpr std::size_t SWIZZLE_SIZE = 1024;
+static constexpr std::size_t SOUND_SAMPLE_RATE = 44100;
+static constexpr std::size_t SOUND_SECONDS = 5;
+static constexpr std::size_t COMPRESS_SIZE = 32 * 1024 * 1024;
+
+struct BenchOptions {
+    std::vector<std::filesystem::path> tags;
+    std::vector<std::filesystem::path> maps;
+    const HEK::GameEngineInfo *engine = &HEK::GameEngineInfo::get_game_engine_info(HEK::GameEngine::GAME_ENGINE_NATIVE);
+    std::optional<std::filesystem::path> output;
+    std::vector<std::string> filters;
+    double min_time = 1.0;
+    std::size_t min_iterations = 3;
+    std::size_t tag_limit = 64;
+    std::optional<std::filesystem::path> generate;
+    std::vector<std::size_t> scales;
+    std::size_t depth = 16;
+    bool determinism = false;
+    std::optional<double> max_build_time;
+    std::optional<std::uint64_t> max_build_memory;
+};
+
+struct BenchResult {
+    std::string name;
+    std::size_t iterations;
+    std::chrono::nanoseconds min_time;
+    std::chrono::nanoseconds median_time;
+    std::chrono::nanoseconds mean_time;
+    std::size_t bytes;
+    std::uint64_t peak_bytes = 0;
+};
+
+class Bench {
+public:
+    Bench(const BenchOptions &options) : options(options) {}
+
+    /**
+     * Time a function, running it until both the minimum time and the minimum number of iterations are reached
+     * @param name  name of the benchmark
+     * @param bytes bytes of input processed per iteration, or 0 if not applicable
+     * @param fn    function to time
+     */
+    void run(const std::string &name, std::size_t bytes, const std::function<void ()> &fn) {
+        if(!this->matches(name)) {
+            return;
+        }
+
+        // Run it once first so caches are warm and anything that can't be done is skipped
+        try {
+            fn();
+        }
+        catch(std::exception &e) {
+            eprintf_warn("Skipping %s: %s", name.c_str(), e.what());
+            return;
+        }
+
+        std::vector<std::chrono::nanoseconds> times;
+        auto total = std::chrono::nanoseconds(0);
+        auto min_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(this->options.min_time));
+        while(times.size() < this->options.min_iterations || total < min_time) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            times.emplace_back(time);
+            total += time;
+        }
+
+        auto &result = this->results.emplace_back();
+        result.name = name;
+        result.iterations = times.size();
+        result.mean_time = total / times.size();
+        std::sort(times.begin(), times.end());
+        result.min_time = times[0];
+        result.median_time = times[times.size() / 2];
+        result.bytes = bytes;
+
+        oprintf("%-56s %8zu %12.3f ms", name.c_str(), result.iterations, result.median_time.count() / 1000000.0);
+        if(bytes > 0) {
+            oprintf(" %10.2f MiB/s", bytes / 1024.0 / 1024.0 / (result.median_time.count() / 1000000000.0));
+        }
+        oprintf("\n");
+        oflush();
+    }
+
+    /**
+     * Check if a benchmark should be run
+     * @param name name of the benchmark
+     * @return     true if it matches any of the filters or there are none
+     */
+    bool matches(const std::string &name) const {
+        if(this->options.filters.empty()) {
+            return true;
+        }
+        for(auto &f : this->options.filters) {
+            if(name.find(f) != std::string::npos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<BenchResult> &get_results() const noexcept {
+        return this->results;
+    }
+
+    /**
+     * Add a result that was measured elsewhere (such as a build phase)
+     * @param result result to add
+     */
+    void add_result(const BenchResult &result) {
+        if(this->matches(result.name)) {
+            this->results.emplace_back(result);
+        }
+    }
+
+private:
+    const BenchOptions &options;
+    std::vector<BenchResult> results;
+};
+
+// Keep the optimizer from throwing away results
+static volatile std::size_t sink;
+
+static std::string escape_json(const std::string &str) {
+    std::string escaped;
+    for(char c : str) {
+        if(c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void append_printf(std::string &output, const char *format, ...) {
+    char buffer[1024];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    output += buffer;
+}
+
+static void bench_build(Bench &bench, const BenchOptions &options, const std::vector<std::filesystem::path> &tags, const std::vector<std::string> &scenarios, std::vector<std::pair<std::string, std::vector<std::byte>>> &built_maps) {
+    for(auto &scenario : scenarios) {
+        auto name = std::filesystem::path(scenario).filename().string();
+
+        BuildWorkload::BuildParameters parameters(options.engine->engine);
+        parameters.scenario = scenario;
+        parameters.tags_directories = tags;
+        parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
+        parameters.details.build_raw_data_handling = BuildWorkload::BuildParameters::BuildParametersDetails::RawDataHandling::RAW_DATA_HANDLING_RETAIN_ALL;
+
+        for(bool optimize_space : { false, true }) {
+            auto bench_name = std::string("compile_map/") + name + (optimize_space ? "/optimized" : "");
+            if(!bench.matches(bench_name)) {
+                continue;
+            }
+
+            // Keep the phase times of the last build, since deduping structs can only be timed as part of a build
+            parameters.optimize_space = optimize_space;
+            parameters.profile_results = std::make_shared<BuildWorkload::ProfileResults>();
+            std::vector<std::byte> map_data;
+            bench.run(bench_name, 0, [&parameters, &map_data]() {
+                map_data = BuildWorkload::compile_map(parameters);
+            });
+
+            for(auto &[phase, time] : parameters.profile_results->phases) {
+                bench.add_result(BenchResult { bench_name + "/" + phase, 1, time, time, time, 0 });
+            }
+
+            if(!optimize_space && !map_data.empty()) {
+                built_maps.emplace_back(name, std::move(map_data));
+            }
+        }
+    }
+}
+
+static void bench_synthetic(Bench &bench, const BenchOptions &options, std::vector<std::pair<std::string, std::vector<std::byte>>> &built_maps) {
+    for(auto scale : options.scales) {
+        auto name = "compile_map/synthetic_" + std::to_string(scale);
+        if(!bench.matches(name) && !bench.matches(name + "/optimized")) {
+            continue;
+        }
+
+        // Generate into a temporary directory so the tags don't outlive the run
+        auto directory = std::filesystem::temp_directory_path() / ("invader-bench-synthetic-" + std::to_string(scale));
+        std::filesystem::remove_all(directory);
+        try {
+            auto scenario = SyntheticTags::generate_synthetic_tags(directory, scale, options.depth);
+            bench_build(bench, options, { directory }, { File::halo_path_to_preferred_path(scenario) }, built_maps);
+        }
+        catch(std::exception &e) {
+            eprintf_warn("Failed to generate synthetic tags for scale %zu: %s", scale, e.what());
+        }
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+}
+
+// Build a scenario a few different ways that should all give the same map, and check that they do and that each one is
+// within the time and memory budgets. Returns false if not.
+static bool check_build_determinism(Bench &bench, const BenchOptions &options, const std::vector<std::filesystem::path> &tags, const std::string &scenario) {
+    struct BuildConfiguration {
+        const char *name;
+        std::size_t thread_count;
+        bool tag_cache;
+        bool touch_scenario;
+    };
+
+    std::size_t thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+    const BuildConfiguration configurations[] = {
+        { "serial", 1, false, false },
+        { "threaded", thread_count, false, false },
+        { "tag_cache_cold", thread_count, true, false },
+        { "tag_cache_warm", thread_count, true, false },
+        { "tag_cache_touched", thread_count, true, true }
+    };
+
+    auto name = std::filesystem::path(scenario).filename().string();
+    auto tag_cache = std::filesystem::temp_directory_path() / ("invader-bench-tag-cache-" + name);
+    std::error_code ec;
+    std::filesystem::remove_all(tag_cache, ec);
+
+    BuildWorkload::BuildParameters parameters(options.engine->engine);
+    parameters.scenario = scenario;
+    parameters.tags_directories = tags;
+    parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
+    parameters.details.build_raw_data_handling = BuildWorkload::BuildParameters::BuildParametersDetails::RawDataHandling::RAW_DATA_HANDLING_RETAIN_ALL;
+
+    bool passed = true;
+    std::optional<std::vector<std::byte>> first_map;
+    for(auto &configuration : configurations) {
+        auto bench_name = "determinism/" + name + "/" + configuration.name;
+        parameters.thread_count = configuration.thread_count;
+        parameters.tag_cache_directory = configuration.tag_cache ? std::optional<std::filesystem::path>(tag_cache) : std::nullopt;
+
+        // Make the scenario look modified, as it would be after saving it
+        if(configuration.touch_scenario) {
+            if(auto path = File::tag_path_to_file_path(File::preferred_path_to_halo_path(scenario) + ".scenario", tags)) {
+                std::filesystem::last_write_time(*path, std::filesystem::file_time_type::clock::now(), ec);
+            }
+        }
+
+        std::vector<std::byte> map_data;
+        MemoryUsage::reset_peaks();
+        auto start = std::chrono::steady_clock::now();
+        try {
+            map_data = BuildWorkload::compile_map(parameters);
+        }
+        catch(std::exception &e) {
+            eprintf_error("%s failed to build: %s", bench_name.c_str(), e.what());
+            passed = false;
+            continue;
+        }
+        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        auto peak_bytes = MemoryUsage::get_total_counters().peak_bytes_in_use;
+
+        bool matches = true;
+        if(!first_map.has_value()) {
+            first_map = map_data;
+        }
+        else {
+            matches = *first_map == map_data;
+        }
+
+        // Xbox maps are compressed, so this has to go through Map rather than the raw data
+        std::uint32_t crc = 0;
+        try {
+            crc = calculate_map_crc(Map::map_with_move(std::move(map_data)));
+        }
+        catch(std::exception &e) {
+            eprintf_error("%s built a map that can't be read: %s", bench_name.c_str(), e.what());
+            passed = false;
+        }
+
+        oprintf("%-56s %8s %12.3f ms", bench_name.c_str(), "", time.count() / 1000000.0);
+        if(MemoryUsage::is_enabled()) {
+            oprintf(" %10.2f MiB peak", peak_bytes / 1024.0 / 1024.0);
+        }
+        oprintf(" CRC %08X%s\n", crc, matches ? "" : " (DIFFERENT)");
+        oflush();
+        bench.add_result(BenchResult { bench_name, 1, time, time, time, 0, peak_bytes });
+
+        if(!matches) {
+            eprintf_error("%s does not match the %s build", bench_name.c_str(), configurations[0].name);
+            passed = false;
+        }
+        if(options.max_build_time.has_value() && std::chrono::duration<double>(time).count() > *options.max_build_time) {
+            eprintf_error("%s took longer than the budget of %.03f seconds", bench_name.c_str(), *options.max_build_time);
+            passed = false;
+        }
+        if(options.max_build_memory.has_value() && peak_bytes > *options.max_build_memory) {
+            eprintf_error("%s used more than the budget of %.02f MiB", bench_name.c_str(), *options.max_build_memory / 1024.0 / 1024.0);
+            passed = false;
+        }
+    }
+
+    std::filesystem::remove_all(tag_cache, ec);
+    return passed;
+}
+
+static void bench_tag_round_trip(Bench &bench, const BenchOptions &options) {
+    if(options.tags.empty()) {
+        return;
+    }
+
+    // Load up to tag_limit tags of each group
+    std::map<TagFourCC, std::vector<std::vector<std::byte>>> tag_groups;
+    for(auto &tag : File::load_virtual_tag_folder(options.tags)) {
+        auto &group = tag_groups[tag.tag_fourcc];
+        if(group.size() >= options.tag_limit) {
+            continue;
+        }
+        auto data = File::open_file(tag.full_path);
+        if(data.has_value()) {
+            group.emplace_back(std::move(*data));
+        }
+    }
+
+    for(auto &[fourcc, tags] : tag_groups) {
+        std::size_t bytes = 0;
+        for(auto &t : tags) {
+            bytes += t.size();
+        }
+
+        bench.run(std::string("parse_hek_tag_file/") + tag_fourcc_to_extension(fourcc), bytes, [&tags]() {
+            for(auto &t : tags) {
+                sink = sink + Parser::ParserStruct::parse_hek_tag_file(t.data(), t.size(), true)->get_values().size();
+            }
+        });
+
+        // Parse them up front so only generating the tag data is timed
+        std::vector<std::unique_ptr<Parser::ParserStruct>> parsed;
+        if(bench.matches(std::string("generate_hek_tag_data/") + tag_fourcc_to_extension(fourcc))) {
+            try {
+                for(auto &t : tags) {
+                    parsed.emplace_back(Parser::ParserStruct::parse_hek_tag_file(t.data(), t.size(), true));
+                }
+            }
+            catch(std::exception &) {
+                parsed.clear();
+            }
+        }
+        bench.run(std::string("generate_hek_tag_data/") + tag_fourcc_to_extension(fourcc), bytes, [&parsed, fourcc]() {
+            if(parsed.empty()) {
+                throw std::runtime_error("tags could not be parsed");
+            }
+            for(auto &p : parsed) {
+                sink = sink + p->generate_hek_tag_data(fourcc).size();
+            }
+        });
+    }
+}
+
+static void bench_maps(Bench &bench, const BenchOptions &options, std::vector<std::pair<std::string, std::vector<std::byte>>> &built_maps) {
+    std::vector<std::pair<std::string, std::unique_ptr<Map>>> maps;
+    for(auto &path : options.maps) {
+        try {
+            maps.emplace_back(path.filename().string(), std::make_unique<Map>(Map::map_with_mmap(path)));
+        }
+        catch(std::exception &e) {
+            eprintf_warn("Failed to open %s: %s", path.string().c_str(), e.what());
+        }
+    }
+    for(auto &[name, data] : built_maps) {
+        try {
+            maps.emplace_back(name, std::make_unique<Map>(Map::map_with_move(std::move(data))));
+        }
+        catch(std::exception &e) {
+            eprintf_warn("Failed to read the built %s map: %s", name.c_str(), e.what());
+        }
+    }
+
+    for(auto &[name, map] : maps) {
+        auto size = map->get_data_length();
+        bench.run("calculate_map_crc/" + name, size, [&map = *map]() {
+            sink = sink + calculate_map_crc(map);
+        });
+
+        if(map->get_cache_version() == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            bench.run("compress_map_data/" + name, size, [&map = *map, size]() {
+                sink = sink + Compression::compress_map_data(map.get_data(), size).size();
+            });
+        }
+
+        // Only time tags that can be extracted
+        std::vector<std::size_t> tags;
+        if(bench.matches("extract_single_tag/" + name)) {
+            for(std::size_t t = 0; t < map->get_tag_count(); t++) {
+                auto &tag = map->get_tag(t);
+                if(!tag.data_is_available()) {
+                    continue;
+                }
+                try {
+                    ExtractionWorkload::extract_single_tag(tag, ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
+                    tags.emplace_back(t);
+                }
+                catch(std::exception &) {}
+            }
+        }
+        bench.run("extract_single_tag/" + name, 0, [&map = *map, &tags]() {
+            for(auto t : tags) {
+                sink = sink + ExtractionWorkload::extract_single_tag(map.get_tag(t), ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING).size();
+            }
+        });
+    }
+}
+
+static void bench_compression(Bench &bench) {
+    std::mt19937 random(BENCH_SEED);
+    if(!bench.matches("compress_map_data/generated")) {
+        return;
+    }
+
+    // Repeat a handful of random blocks with some noise so it compresses about as well as tag data does
+    std::vector<std::byte> data(COMPRESS_SIZE);
+    std::vector<std::byte> blocks(64 * 1024);
+    for(auto &b : blocks) {
+        b = static_cast<std::byte>(random() & 0xFF);
+    }
+    for(std::size_t i = sizeof(HEK::CacheFileHeader); i < data.size(); i += 256) {
+        auto block_offset = (random() % (blocks.size() / 256)) * 256;
+        std::copy(blocks.begin() + block_offset, blocks.begin() + block_offset + std::min<std::size_t>(256, data.size() - i), data.begin() + i);
+        data[i + random() % std::min<std::size_t>(256, data.size() - i)] = static_cast<std::byte>(random() & 0xFF);
+    }
+
+    HEK::CacheFileHeader header = {};
+    header.head_literal = HEK::CacheFileLiteral::CACHE_FILE_HEAD;
+    header.foot_literal = HEK::CacheFileLiteral::CACHE_FILE_FOOT;
+    header.engine = HEK::CacheFileEngine::CACHE_FILE_XBOX;
+    header.decompressed_file_size = static_cast<std::uint32_t>(data.size());
+    std::copy(reinterpret_cast<const std::byte *>(&header), reinterpret_cast<const std::byte *>(&header + 1), data.begin());
+
+    bench.run("compress_map_data/generated", data.size(), [&data]() {
+        sink = sink + Compression::compress_map_data(data.data(), data.size()).size();
+    });
+}
+
+static void bench_bitmaps(Bench &bench) {
+    std::mt19937 random(BENCH_SEED);
+    // A gradient with some noise so the DXT encoders have something to work with
+    std::vector<std::uint32_t> pixels(BITMAP_SIZE * BITMAP_SIZE);
+    for(std::size_t y = 0; y < BITMAP_SIZE; y++) {
+        for(std::size_t x = 0; x < BITMAP_SIZE; x++) {
+            auto noise = random() & 0x1F;
+            std::uint32_t a = static_cast<std::uint32_t>((x + y) * 255 / (BITMAP_SIZE * 2));
+            std::uint32_t r = static_cast<std::uint32_t>(x * 255 / BITMAP_SIZE) ^ noise;
+            std::uint32_t g = static_cast<std::uint32_t>(y * 255 / BITMAP_SIZE) ^ noise;
+            std::uint32_t b = static_cast<std::uint32_t>(127 + 127 * std::sin(x * 0.05) * std::cos(y * 0.05));
+            pixels[x + y * BITMAP_SIZE] = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+    auto *input = reinterpret_cast<const std::byte *>(pixels.data());
+    auto input_size = pixels.size() * sizeof(pixels[0]);
+
+    for(std::size_t f = 0; f < HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_ENUM_COUNT; f++) {
+        auto format = static_cast<HEK::BitmapDataFormat>(f);
+        switch(format) {
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_UNUSED1:
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_UNUSED2:
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_UNUSED3:
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_UNUSED4:
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_UNUSED5:
+                continue;
+            default:
+                break;
+        }
+
+        bench.run(std::string("encode_bitmap/") + HEK::BitmapDataFormat_to_string(format), input_size, [input, format]() {
+            sink = sink + BitmapEncode::encode_bitmap(input, HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, format, BITMAP_SIZE, BITMAP_SIZE).size();
+        });
+    }
+
+    std::vector<std::byte> swizzle_input(SWIZZLE_SIZE * SWIZZLE_SIZE * 4);
+    for(auto &b : swizzle_input) {
+        b = static_cast<std::byte>(random() & 0xFF);
+    }
+    std::vector<std::byte> swizzle_output(swizzle_input.size());
+    for(bool deswizzle : { false, true }) {
+        bench.run(deswizzle ? "swizzle/deswizzle" : "swizzle/swizzle", swizzle_input.size(), [&swizzle_input, &swizzle_output, deswizzle]() {
+            Swizzle::swizzle(swizzle_input.data(), swizzle_output.data(), 32, SWIZZLE_SIZE, SWIZZLE_SIZE, 1, deswizzle);
+        });
+    }
+}
+
+static void bench_sounds(Bench &bench) {
+    std::mt19937 random(BENCH_SEED);
+    // Two detuned tones with some noise, 16-bit stereo
+    std::size_t sample_count = SOUND_SAMPLE_RATE * SOUND_SECONDS;
+    std::vector<std::byte> pcm(sample_count * 2 * sizeof(std::int16_t));
+    auto *samples = reinterpret_cast<std::int16_t *>(pcm.data());
+    std::normal_distribution<double> noise(0.0, 0.02);
+    for(std::size_t i = 0; i < sample_count; i++) {
+        double t = static_cast<double>(i) / SOUND_SAMPLE_RATE;
+        samples[i * 2] = static_cast<std::int16_t>(std::clamp(0.4 * std::sin(2 * HALO_PI * 440.0 * t) + 0.2 * std::sin(2 * HALO_PI * 660.0 * t) + noise(random), -1.0, 1.0) * INT16_MAX);
+        samples[i * 2 + 1] = static_cast<std::int16_t>(std::clamp(0.4 * std::sin(2 * HALO_PI * 443.0 * t) + 0.2 * std::sin(2 * HALO_PI * 657.0 * t) + noise(random), -1.0, 1.0) * INT16_MAX);
+    }
+
+    bench.run("sound/encode_to_ogg_vorbis_vbr", pcm.size(), [&pcm]() {
+        sink = sink + SoundEncoder::encode_to_ogg_vorbis_vbr(pcm, 16, 2, SOUND_SAMPLE_RATE, 0.5F).size();
+    });
+    bench.run("sound/encode_to_flac", pcm.size(), [&pcm]() {
+        sink = sink + SoundEncoder::encode_to_flac(pcm, 16, 2, SOUND_SAMPLE_RATE).size();
+    });
+    bench.run("sound/encode_to_xbox_adpcm", pcm.size(), [&pcm]() {
+        sink = sink + SoundEncoder::encode_to_xbox_adpcm(pcm, 16, 2).size();
+    });
+    bench.run("sound/resample", pcm.size(), [&pcm, sample_count]() {
+        sink = sink + SoundEncoder::resample(pcm.data(), sample_count * 2, 16, 2, 22050.0 / SOUND_SAMPLE_RATE, 16).size();
+    });
+}
+
+static void write_results(const std::filesystem::path &path, const std::vector<BenchResult> &results) {
+    std::string output = "{\n";
+    append_printf(output, "    \"version\": \"%s\",\n", escape_json(full_version()).c_str());
+    append_printf(output, "    \"seed\": %u,\n", BENCH_SEED);
+    output += "    \"benchmarks\": [";
+    for(auto &r : results) {
+        append_printf(output, "%s\n        { \"name\": \"%s\", \"iterations\": %zu, \"min_ns\": %lld, \"median_ns\": %lld, \"mean_ns\": %lld", &r == results.data() ? "" : ",", escape_json(r.name).c_str(), r.iterations, static_cast<long long>(r.min_time.count()), static_cast<long long>(r.median_time.count()), static_cast<long long>(r.mean_time.count()));
+        if(r.bytes > 0) {
+            append_printf(output, ", \"bytes\": %zu", r.bytes);
+        }
+        if(r.peak_bytes > 0) {
+            append_printf(output, ", \"peak_bytes\": %llu", static_cast<unsigned long long>(r.peak_bytes));
+        }
+        output += " }";
+    }
+    output += "\n    ]\n}\n";
+
+    if(!File::save_file(path, std::vector<std::byte>(reinterpret_cast<const std::byte *>(output.data()), reinterpret_cast<const std::byte *>(output.data() + output.size())))) {
+        eprintf_error("Failed to write to %s", path.string().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char * const *argv) {
+    set_up_color_term();
+
+    const CommandLineOption options[] {
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_GAME_ENGINE),
+        CommandLineOption("map", 'M', 1, "Also benchmark CRC32 calculation, compression (Xbox maps only), and tag extraction on a cache file. Use multiple times to add more maps.", "<file>"),
+        CommandLineOption("output", 'o', 1, "Write the results to a JSON file.", "<file>"),
+        CommandLineOption("filter", 'f', 1, "Only run benchmarks whose names contain the given text. Use multiple times to run more.", "<text>"),
+        CommandLineOption("min-time", 'T', 1, "Run each benchmark for at least this long. Default: 1", "<sec>"),
+        CommandLineOption("iterations", 'n', 1, "Run each benchmark at least this many times. Default: 3", "<count>"),
+        CommandLineOption("tag-limit", 'l', 1, "Use at most this many tags of each tag group for tag parsing benchmarks. Default: 64", "<count>"),
+        CommandLineOption("generate", 'G', 1, "Write a synthetic tag tree to the given directory for each scale and exit.", "<dir>"),
+        CommandLineOption("scale", 'S', 1, "Generate a synthetic tag tree with this many scenery tags (plus proportionally many bipeds, shaders, bitmaps, and encounters) and benchmark building it. Use multiple times to compare scales.", "<count>"),
+        CommandLineOption("depth", 'D', 1, "Set the length of the tag collection chains in synthetic tag trees. Default: 16", "<count>"),
+        CommandLineOption("determinism", 'd', 0, "Instead of benchmarking, build each scenario and scale serially, on multiple threads, and with a cold, warm, and touched tag cache, and fail if the maps are not identical or a budget is exceeded."),
+        CommandLineOption("max-build-time", 'B', 1, "Fail --determinism if any build takes longer than this.", "<sec>"),
+        CommandLineOption("max-build-memory", 'm', 1, "Fail --determinism if any build allocates more than this at once. This requires INVADER_MEMORY_USAGE.", "<MiB>")
+    };
+
+    static constexpr char DESCRIPTION[] = "Benchmark building, extracting, bitmap, and sound processing.";
+    static constexpr char USAGE[] = "[options] [scenario...]";
+
+    BenchOptions bench_options;
+    auto remaining_arguments = CommandLineOption::parse_arguments<BenchOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 65535, bench_options, [](char opt, const std::vector<const char *> &arguments, auto &bench_options) {
+        auto read_count = [](const char *argument) -> std::size_t {
+            try {
+                int count = std::stoi(argument);
+                if(count < 1) {
+                    throw std::exception();
+                }
+                return static_cast<std::size_t>(count);
+            }
+            catch(std::exception &) {
+                eprintf_error("Invalid count %s", argument);
+                std::exit(EXIT_FAILURE);
+            }
+        };
+
+        switch(opt) {
+            case 'i':
+                show_version_info();
+                std::exit(EXIT_SUCCESS);
+            case 't':
+                bench_options.tags.emplace_back(arguments[0]);
+                break;
+            case 'g':
+                if(const auto *engine_maybe = HEK::GameEngineInfo::get_game_engine_info(arguments[0])) {
+                    bench_options.engine = engine_maybe;
+                }
+                else {
+                    eprintf_error("Unknown engine %s. Use -h for more information.", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'M':
+                bench_options.maps.emplace_back(arguments[0]);
+                break;
+            case 'o':
+                bench_options.output = arguments[0];
+                break;
+            case 'f':
+                bench_options.filters.emplace_back(arguments[0]);
+                break;
+            case 'T':
+                try {
+                    bench_options.min_time = std::stod(arguments[0]);
+                    if(bench_options.min_time < 0.0) {
+                        throw std::exception();
+                    }
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid time %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'n':
+                bench_options.min_iterations = read_count(arguments[0]);
+                break;
+            case 'l':
+                bench_options.tag_limit = read_count(arguments[0]);
+                break;
+            case 'G':
+                bench_options.generate = arguments[0];
+                break;
+            case 'S': {
+                // Scenery palette indices are 16-bit
+                auto scale = read_count(arguments[0]);
+                if(scale >= NULL_INDEX) {
+                    eprintf_error("Scale %zu exceeds the maximum of %zu", scale, static_cast<std::size_t>(NULL_INDEX - 1));
+                    std::exit(EXIT_FAILURE);
+                }
+                bench_options.scales.emplace_back(scale);
+                break;
+            }
+            case 'D':
+                bench_options.depth = read_count(arguments[0]);
+                break;
+            case 'd':
+                bench_options.determinism = true;
+                break;
+            case 'B':
+                try {
+                    bench_options.max_build_time = std::stod(arguments[0]);
+                    if(*bench_options.max_build_time <= 0.0) {
+                        throw std::exception();
+                    }
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid time %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'm':
+                if(!MemoryUsage::is_enabled()) {
+                    eprintf_error("--max-build-memory requires Invader to be built with INVADER_MEMORY_USAGE");
+                    std::exit(EXIT_FAILURE);
+                }
+                bench_options.max_build_memory = static_cast<std::uint64_t>(read_count(arguments[0])) * 1024 * 1024;
+                break;
+        }
+    });
+
+    std::vector<std::string> scenarios;
+    for(auto *scenario : remaining_arguments) {
+        scenarios.emplace_back(File::halo_path_to_preferred_path(scenario));
+    }
+    if(!scenarios.empty() && bench_options.tags.empty()) {
+        bench_options.tags.emplace_back("tags");
+    }
+
+    if(bench_options.generate.has_value()) {
+        if(bench_options.scales.empty()) {
+            eprintf_error("--generate requires at least one --scale");
+            return EXIT_FAILURE;
+        }
+        for(auto scale : bench_options.scales) {
+            try {
+                auto scenario = SyntheticTags::generate_synthetic_tags(*bench_options.generate, scale, bench_options.depth);
+                oprintf("Generated %s\n", File::halo_path_to_preferred_path(scenario).c_str());
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to generate synthetic tags for scale %zu: %s", scale, e.what());
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+
+    Bench bench(bench_options);
+
+    if(bench_options.determinism) {
+        if(scenarios.empty() && bench_options.scales.empty()) {
+            eprintf_error("--determinism requires at least one scenario or --scale");
+            return EXIT_FAILURE;
+        }
+
+        oprintf("%-56s %8s %15s\n", "Build", "", "Time");
+
+        bool passed = true;
+        for(auto &scenario : scenarios) {
+            passed = check_build_determinism(bench, bench_options, bench_options.tags, scenario) && passed;
+        }
+        for(auto scale : bench_options.scales) {
+            auto directory = std::filesystem::temp_directory_path() / ("invader-bench-synthetic-" + std::to_string(scale));
+            std::filesystem::remove_all(directory);
+            try {
+                auto scenario = SyntheticTags::generate_synthetic_tags(directory, scale, bench_options.depth);
+                passed = check_build_determinism(bench, bench_options, { directory }, File::halo_path_to_preferred_path(scenario)) && passed;
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to generate synthetic tags for scale %zu: %s", scale, e.what());
+                passed = false;
+            }
+            std::error_code ec;
+            std::filesystem::remove_all(directory, ec);
+        }
+
+        if(bench_options.output.has_value()) {
+            write_results(*bench_options.output, bench.get_results());
+        }
+
+        return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    oprintf("%-56s %8s %15s %16s\n", "Benchmark", "Runs", "Median", "Throughput");
+
+    std::vector<std::pair<std::string, std::vector<std::byte>>> built_maps;
+    bench_build(bench, bench_options, bench_options.tags, scenarios, built_maps);
+    bench_synthetic(bench, bench_options, built_maps);
+    bench_tag_round_trip(bench, bench_options);
+    bench_maps(bench, bench_options, built_maps);
+    bench_compression(bench);
+    bench_bitmaps(bench);
+    bench_sounds(bench);
+
+    if(bench_options.output.has_value()) {
+        write_results(*bench_options.output, bench.get_results());
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <invader/error.hpp>
+#include <invader/file/file.hpp>
+#include <invader/printf.hpp>
+#include <invader/tag/parser/parser.hpp>
+#include "synthetic_tags.hpp"
+
+namespace Invader::SyntheticTags {
+    using namespace Invader::Parser;
+
+    // Fixed so the same scale always generates the same tags
+    static constexpr std::uint32_t SYNTHETIC_SEED = 0x5EED1234;
+
+    static constexpr std::size_t BITMAP_SIZE = 64;
+    static constexpr std::size_t STARTING_LOCATIONS_PER_SQUAD = 4;
+    static constexpr std::size_t SQUADS_PER_ENCOUNTER = 2;
+    static constexpr std::size_t FIRING_POSITIONS_PER_ENCOUNTER = 8;
+
+    static std::string numbered_path(const char *base, std::size_t index) {
+        return std::string(base) + std::to_string(index);
+    }
+
+    static Dependency dependency(TagFourCC tag_fourcc, const std::string &path) {
+        Dependency dependency = {};
+        dependency.tag_fourcc = tag_fourcc;
+        dependency.path = path;
+        return dependency;
+    }
+
+    static HEK::Point3D<HEK::NativeEndian> point(std::mt19937 &random) {
+        std::uniform_real_distribution<float> distribution(-512.0F, 512.0F);
+        HEK::Point3D<HEK::NativeEndian> point = {};
+        point.x = distribution(random);
+        point.y = distribution(random);
+        point.z = distribution(random) / 16.0F;
+        return point;
+    }
+
+    template <typename T> static void write_tag(const std::filesystem::path &tags_directory, const std::string &path, TagFourCC tag_fourcc, T &tag) {
+        auto file_path = tags_directory / (File::halo_path_to_preferred_path(path) + "." + HEK::tag_fourcc_to_extension(tag_fourcc));
+        std::filesystem::create_directories(file_path.parent_path());
+        if(!File::save_file(file_path, tag.generate_hek_tag_data(tag_fourcc))) {
+            eprintf_error("Failed to write to %s", file_path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+    }
+
+    std::string generate_synthetic_tags(const std::filesystem::path &tags_directory, std::size_t scale, std::size_t depth) {
+        std::mt19937 random(SYNTHETIC_SEED);
+
+        std::size_t scenery_count = scale;
+        std::size_t biped_count = std::max<std::size_t>(scale / 10, 1);
+        std::size_t shader_count = std::max<std::size_t>(scale / 2, 1);
+        std::size_t bitmap_count = std::max<std::size_t>(scale / 4, 1);
+        std::size_t encounter_count = scale / 4;
+        std::size_t chain_count = std::max<std::size_t>(scale / 10, 1);
+
+        // Bitmaps; every fourth one is a copy of the previous one so asset deduping has something to find
+        std::vector<std::byte> pixels;
+        for(std::size_t b = 0; b < bitmap_count; b++) {
+            if(b % 4 != 3 || pixels.empty()) {
+                pixels.resize(BITMAP_SIZE * BITMAP_SIZE * 4);
+                for(auto &p : pixels) {
+                    p = static_cast<std::byte>(random() & 0xFF);
+                }
+            }
+
+            Bitmap bitmap = {};
+            bitmap.type = HEK::BitmapType::BITMAP_TYPE_2D_TEXTURES;
+            bitmap.processed_pixel_data = pixels;
+
+            auto &sequence = bitmap.bitmap_group_sequence.emplace_back();
+            sequence.first_bitmap_index = 0;
+            sequence.bitmap_count = 1;
+
+            auto &data = bitmap.bitmap_data.emplace_back();
+            data.bitmap_class = TagFourCC::TAG_FOURCC_BITMAP;
+            data.width = BITMAP_SIZE;
+            data.height = BITMAP_SIZE;
+            data.depth = 1;
+            data.type = HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE;
+            data.format = HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8;
+            data.pixel_data_offset = 0;
+            data.pixel_data_size = static_cast<std::uint32_t>(pixels.size());
+
+            write_tag(tags_directory, numbered_path("synthetic\\bitmaps\\bitmap_", b), TagFourCC::TAG_FOURCC_BITMAP, bitmap);
+        }
+
+        for(std::size_t s = 0; s < shader_count; s++) {
+            ShaderEnvironment shader = {};
+            shader.base_map = dependency(TagFourCC::TAG_FOURCC_BITMAP, numbered_path("synthetic\\bitmaps\\bitmap_", s % bitmap_count));
+            write_tag(tags_directory, numbered_path("synthetic\\shaders\\shader_", s), TagFourCC::TAG_FOURCC_SHADER_ENVIRONMENT, shader);
+        }
+
+        // Scenery differ by bounding radius so they don't all dedupe into one another
+        for(std::size_t s = 0; s < scenery_count; s++) {
+            Scenery scenery = {};
+            scenery.bounding_radius = 1.0F + static_cast<float>(s) / 16.0F;
+            scenery.modifier_shader = dependency(TagFourCC::TAG_FOURCC_SHADER_ENVIRONMENT, numbered_path("synthetic\\shaders\\shader_", s % shader_count));
+            write_tag(tags_directory, numbered_path("synthetic\\scenery\\scenery_", s), TagFourCC::TAG_FOURCC_SCENERY, scenery);
+        }
+
+        for(std::size_t b = 0; b < biped_count; b++) {
+            Biped biped = {};
+            biped.bounding_radius = 0.5F + static_cast<float>(b) / 16.0F;
+            write_tag(tags_directory, numbered_path("synthetic\\bipeds\\biped_", b), TagFourCC::TAG_FOURCC_BIPED, biped);
+        }
+
+        // Chains of tag collections, each link also pointing into the next chain, ending in shaders
+        auto chain_path = [](std::size_t chain, std::size_t link) {
+            return "synthetic\\chains\\chain_" + std::to_string(chain) + "\\link_" + std::to_string(link);
+        };
+        for(std::size_t c = 0; c < chain_count; c++) {
+            for(std::size_t d = 0; d < depth; d++) {
+                TagCollection collection = {};
+                if(d + 1 < depth) {
+                    collection.tags.emplace_back().reference = dependency(TagFourCC::TAG_FOURCC_TAG_COLLECTION, chain_path(c, d + 1));
+                    collection.tags.emplace_back().reference = dependency(TagFourCC::TAG_FOURCC_TAG_COLLECTION, chain_path((c + 1) % chain_count, d + 1));
+                }
+                else {
+                    collection.tags.emplace_back().reference = dependency(TagFourCC::TAG_FOURCC_SHADER_ENVIRONMENT, numbered_path("synthetic\\shaders\\shader_", c % shader_count));
+                }
+                write_tag(tags_directory, chain_path(c, d), TagFourCC::TAG_FOURCC_TAG_COLLECTION, collection);
+            }
+        }
+
+        Globals globals = {};
+        globals.player_information.emplace_back().unit = dependency(TagFourCC::TAG_FOURCC_BIPED, "synthetic\\bipeds\\biped_0");
+        globals.falling_damage.emplace_back();
+        globals.materials.resize(32);
+        write_tag(tags_directory, "globals\\globals", TagFourCC::TAG_FOURCC_GLOBALS, globals);
+
+        Scenario scenario = {};
+        scenario.type = HEK::ScenarioType::SCENARIO_TYPE_SINGLEPLAYER;
+
+        if(depth > 0) {
+            for(std::size_t c = 0; c < chain_count; c++) {
+                scenario.references.emplace_back().reference = dependency(TagFourCC::TAG_FOURCC_TAG_COLLECTION, chain_path(c, 0));
+            }
+        }
+
+        for(std::size_t s = 0; s < scenery_count; s++) {
+            scenario.scenery_palette.emplace_back().name = dependency(TagFourCC::TAG_FOURCC_SCENERY, numbered_path("synthetic\\scenery\\scenery_", s));
+            auto &spawn = scenario.scenery.emplace_back();
+            spawn.type = static_cast<HEK::Index>(s);
+            spawn.position = point(random);
+        }
+
+        for(std::size_t b = 0; b < biped_count; b++) {
+            scenario.biped_palette.emplace_back().name = dependency(TagFourCC::TAG_FOURCC_BIPED, numbered_path("synthetic\\bipeds\\biped_", b));
+            auto &spawn = scenario.bipeds.emplace_back();
+            spawn.type = static_cast<HEK::Index>(b);
+            spawn.position = point(random);
+        }
+
+        for(std::size_t e = 0; e < encounter_count; e++) {
+            auto &encounter = scenario.encounters.emplace_back();
+            std::snprintf(encounter.name.string, sizeof(encounter.name.string), "encounter_%zu", e);
+
+            for(std::size_t s = 0; s < SQUADS_PER_ENCOUNTER; s++) {
+                auto &squad = encounter.squads.emplace_back();
+                std::snprintf(squad.name.string, sizeof(squad.name.string), "squad_%zu", s);
+                for(std::size_t l = 0; l < STARTING_LOCATIONS_PER_SQUAD; l++) {
+                    squad.starting_locations.emplace_back().position = point(random);
+                }
+            }
+
+            for(std::size_t f = 0; f < FIRING_POSITIONS_PER_ENCOUNTER; f++) {
+                encounter.firing_positions.emplace_back().position = point(random);
+            }
+        }
+
+        std::string scenario_path = "synthetic\\scenarios\\synthetic_" + std::to_string(scale);
+        write_tag(tags_directory, scenario_path, TagFourCC::TAG_FOURCC_SCENARIO, scenario);
+        return scenario_path;
+    }
+}
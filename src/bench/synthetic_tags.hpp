@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__BENCH__SYNTHETIC_TAGS_HPP
+#define INVADER__BENCH__SYNTHETIC_TAGS_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+namespace Invader::SyntheticTags {
+    /**
+     * Write a tag tree that builds into a map, sized by the given scale so compiling, deduping, and externalizing can
+     * be timed against tag count.
+     *
+     * The tree has scale scenery, scale / 10 bipeds, scale / 2 shaders, scale / 4 bitmaps (every fourth one identical
+     * to the one before it), scale / 4 encounters, and scale / 10 chains of tag collections, each depth tags deep and
+     * cross-linked with the next chain.
+     *
+     * @param tags_directory directory to write the tags to
+     * @param scale          number of scenery tags to generate
+     * @param depth          number of tag collections in each chain
+     * @return               tag path of the generated scenario
+     * @throws               if a tag could not be written
+     */
+    std::string generate_synthetic_tags(const std::filesystem::path &tags_directory, std::size_t scale, std::size_t depth);
+}
+
+#endif
@@ -3,6 +3,10 @@
 #include <zlib.h>
 #include <filesystem>
 #include <optional>
+#include <atomic>
+#include <map>
+#include <algorithm>
+#include <cstring>
 
 #include <invader/printf.hpp>
 #include <invader/version.hpp>
@@ -14,6 +18,10 @@
 #include "bitmap_data_writer.hpp"
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/memory_usage.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/parser/parser.hpp>
 
 enum SupportedFormatsInt {
@@ -58,6 +66,10 @@ struct BitmapOptions {
     // Find format automatically
     std::optional<bool> auto_format;
 
+    // Minimum PSNR in dB when finding a lossy format automatically, or based on the usage (not saved in tags)
+    std::optional<float> error_budget;
+    bool error_budget_from_usage = false;
+
     // Usage?
     std::optional<BitmapUsage> usage;
 
@@ -83,6 +95,9 @@ struct BitmapOptions {
     // Dithering?
     std::optional<bool> dithering;
 
+    // DXT compression quality (not saved in tags)
+    BitmapEncode::DXTCompressionQuality dxt_quality = BitmapEncode::DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST;
+
     // Sharpen and blur; legacy support for older tags and should not be used in newer ones
     std::optional<float> sharpen;
     std::optional<float> blur;
@@ -102,8 +117,108 @@ struct BitmapOptions {
 
     // Regenerate?
     bool regenerate = false;
+
+    // Batch expressions
+    std::vector<std::string> batch;
+    std::vector<std::string> batch_exclude;
+
+    // Number of threads to make bitmaps with (if unset, INVADER_THREADS or the CPU thread count is used)
+    std::optional<std::size_t> thread_count;
+
+    // Directory to store fingerprints in for skipping unchanged bitmaps
+    std::optional<std::filesystem::path> cache;
 };
 
+// Error budget to use for each usage when it's based on the usage. Light maps band easily and detail maps are blended over something else.
+static float error_budget_for_usage(BitmapUsage usage) noexcept {
+    switch(usage) {
+        case BitmapUsage::BITMAP_USAGE_LIGHT_MAP:
+            return 45.0F;
+        case BitmapUsage::BITMAP_USAGE_DETAIL_MAP:
+            return 36.0F;
+        default:
+            return 40.0F;
+    }
+}
+
+// Find the image a bitmap is made from
+static std::optional<std::filesystem::path> find_source_image(const std::filesystem::path &data_path, const std::string &bitmap_tag) {
+    auto bitmap_data_path = (data_path / bitmap_tag).string();
+    for(auto *format : SUPPORTED_FORMATS) {
+        std::filesystem::path image_path = bitmap_data_path + format;
+        if(std::filesystem::exists(image_path)) {
+            return image_path;
+        }
+    }
+    return std::nullopt;
+}
+
+// Increment this if what goes into a fingerprint changes
+static constexpr char BITMAP_FINGERPRINT_MAGIC[8] = { 'i', 'n', 'v', 'b', 'm', 'f', 'p', '1' };
+
+struct BitmapFingerprintFile {
+    char magic[sizeof(BITMAP_FINGERPRINT_MAGIC)];
+
+    // Hash of the source image and options
+    std::uint64_t fingerprint;
+
+    // Hash of the size and modification time of the tag that was made
+    std::uint64_t tag_stamp;
+};
+
+// Fingerprint everything that goes into making the bitmap other than the tag itself (which is checked with its stamp instead)
+static std::optional<std::uint64_t> fingerprint_bitmap(const std::string &bitmap_tag, const BitmapOptions &bitmap_options) {
+    FNV1AHash hash;
+
+    const char *version = full_version();
+    hash.add_bytes(version, std::strlen(version));
+
+    hash.add_value(bitmap_options.allow_non_power_of_two);
+    hash.add_value(bitmap_options.mipmap_scale_type);
+    hash.add_value(bitmap_options.format);
+    hash.add_value(bitmap_options.auto_format);
+    hash.add_value(bitmap_options.error_budget);
+    hash.add_value(bitmap_options.error_budget_from_usage);
+    hash.add_value(bitmap_options.usage);
+    hash.add_value(bitmap_options.bump_height);
+    hash.add_value(bitmap_options.palettize);
+    hash.add_value(bitmap_options.mipmap_fade);
+    hash.add_value(bitmap_options.bitmap_type);
+    hash.add_value(bitmap_options.sprite_usage);
+    hash.add_value(bitmap_options.sprite_budget);
+    hash.add_value(bitmap_options.sprite_budget_count);
+    hash.add_value(bitmap_options.sprite_spacing);
+    hash.add_value(bitmap_options.force_square_sprite_sheets);
+    hash.add_value(bitmap_options.dithering);
+    hash.add_value(bitmap_options.dxt_quality);
+    hash.add_value(bitmap_options.sharpen);
+    hash.add_value(bitmap_options.blur);
+    hash.add_value(bitmap_options.alpha_bias);
+    hash.add_value(bitmap_options.max_mipmap_count);
+    hash.add_value(bitmap_options.filthy_sprite_bug_fix);
+    hash.add_value(bitmap_options.ignore_tag_data);
+    hash.add_value(bitmap_options.regenerate);
+
+    // If we're regenerating, the color plate is in the tag, so there's no image to look at
+    if(!bitmap_options.regenerate) {
+        auto image_path = find_source_image(bitmap_options.data, bitmap_tag);
+        if(!image_path.has_value()) {
+            return std::nullopt;
+        }
+        auto image = File::MemoryMappedFile::map_file(*image_path);
+        if(!image.has_value()) {
+            return std::nullopt;
+        }
+
+        auto image_path_string = image_path->string();
+        hash.add_bytes(image_path_string.data(), image_path_string.size());
+        hash.add_value(image->size());
+        hash.add_bytes(image->data(), image->size());
+    }
+
+    return hash.get();
+}
+
 template <typename T> static int perform_the_ritual(const std::string &bitmap_tag, const std::filesystem::path &tag_path, const std::filesystem::path &final_path, BitmapOptions &bitmap_options, TagFourCC tag_fourcc) {
     // Let's begin
     std::filesystem::path data_path = bitmap_options.data;
@@ -120,15 +235,15 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         // These are available in the Rust implementation instead.
         if(bitmap_tag_data.flags & HEK::BitmapFlagsFlag::BITMAP_FLAGS_FLAG_INVERT_DETAIL_FADE) {
             eprintf_error("The \"invert detail fade\" option is not supported by this implementation of invader-bitmap");
-            std::exit(EXIT_FAILURE);
+            return EXIT_FAILURE;
         }
         if(bitmap_tag_data.flags & HEK::BitmapFlagsFlag::BITMAP_FLAGS_FLAG_USE_AVERAGE_COLOR_FOR_DETAIL_FADE) {
             eprintf_error("The \"use average color for detail fade\" option is not supported by this implementation of invader-bitmap");
-            std::exit(EXIT_FAILURE);
+            return EXIT_FAILURE;
         }
         if((bitmap_tag_data.encoding_format == HEK::BitmapFormat::BITMAP_FORMAT_BC7 && !bitmap_options.format.has_value()) || bitmap_options.format == HEK::BitmapFormat::BITMAP_FORMAT_BC7) {
             eprintf_error("BC7 bitmap encoding is not supported by this implementation of invader-bitmap");
-            std::exit(EXIT_FAILURE);
+            return EXIT_FAILURE;
         }
 
         // Set some default values
@@ -195,7 +310,7 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     }
     else if(bitmap_options.regenerate) {
         eprintf_error("Cannot regenerate. No bitmap tag exists at %s", final_path.string().c_str());
-        std::exit(EXIT_FAILURE);
+        return EXIT_FAILURE;
     }
 
     // If these values weren't set, set them
@@ -273,19 +388,24 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         for(auto i = static_cast<SupportedFormatsInt>(0); i < SUPPORTED_FORMATS_INT_COUNT; i = static_cast<SupportedFormatsInt>(i + 1)) {
             std::string image_path = bitmap_data_path + SUPPORTED_FORMATS[i];
             if(std::filesystem::exists(image_path)) {
-                switch(i) {
-                    case SUPPORTED_FORMATS_TIF:
-                    case SUPPORTED_FORMATS_TIFF:
-                        image_pixels = load_tiff(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    case SUPPORTED_FORMATS_PNG:
-                    case SUPPORTED_FORMATS_TGA:
-                    case SUPPORTED_FORMATS_BMP:
-                        image_pixels = load_image(image_path.c_str(), image_width, image_height, image_size);
-                        break;
-                    default:
-                        std::terminate();
-                        break;
+                try {
+                    switch(i) {
+                        case SUPPORTED_FORMATS_TIF:
+                        case SUPPORTED_FORMATS_TIFF:
+                            image_pixels = load_tiff(image_path.c_str(), image_width, image_height, image_size);
+                            break;
+                        case SUPPORTED_FORMATS_PNG:
+                        case SUPPORTED_FORMATS_TGA:
+                        case SUPPORTED_FORMATS_BMP:
+                            image_pixels = load_image(image_path.c_str(), image_width, image_height, image_size);
+                            break;
+                        default:
+                            std::terminate();
+                            break;
+                    }
+                }
+                catch(std::exception &) {
+                    return EXIT_FAILURE;
                 }
                 break;
             }
@@ -314,7 +434,7 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     }
 
     // Do it!
-    auto try_to_scan_color_plate = [&image_pixels, &image_width, &image_height, &bitmap_options, &sprite_parameters]() {
+    auto try_to_scan_color_plate = [&image_pixels, &image_width, &image_height, &bitmap_options, &sprite_parameters]() -> std::optional<GeneratedBitmapData> {
         try {
             auto scanned_data = ColorPlateScanner::scan_color_plate(image_pixels.data(), image_width, image_height, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), *bitmap_options.filthy_sprite_bug_fix, bitmap_options.allow_non_power_of_two);
             BitmapProcessor::process_bitmap_data(scanned_data, bitmap_options.bitmap_type.value(), bitmap_options.usage.value(), bitmap_options.bump_height.value(), sprite_parameters, bitmap_options.max_mipmap_count.value(), bitmap_options.mipmap_scale_type.value(), bitmap_options.usage == BitmapUsage::BITMAP_USAGE_DETAIL_MAP ? bitmap_options.mipmap_fade : std::nullopt, bitmap_options.sharpen, bitmap_options.blur, bitmap_options.alpha_bias);
@@ -322,11 +442,15 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         }
         catch (std::exception &e) {
             eprintf_error("Failed to process the image: %s", e.what());
-            std::exit(1);
+            return std::nullopt;
         };
     };
 
-    auto scanned_color_plate = try_to_scan_color_plate();
+    auto scanned_color_plate_maybe = try_to_scan_color_plate();
+    if(!scanned_color_plate_maybe.has_value()) {
+        return EXIT_FAILURE;
+    }
+    auto &scanned_color_plate = *scanned_color_plate_maybe;
 
     // Compress the original input blob
     if(!bitmap_options.regenerate) {
@@ -338,32 +462,33 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
         else {
             // Get ready
             bitmap_tag_data.compressed_color_plate_data.clear();
-            std::vector<std::byte> compressed_data(image_size * 4);
             BigEndian<std::uint32_t> decompressed_size;
             decompressed_size = static_cast<std::uint32_t>(image_size);
             bitmap_tag_data.color_plate_width = image_width;
             bitmap_tag_data.color_plate_height = image_height;
 
-            // Set compressed size
-            bitmap_tag_data.compressed_color_plate_data.resize(sizeof(decompressed_size));
-            *reinterpret_cast<BigEndian<std::uint32_t> *>(bitmap_tag_data.compressed_color_plate_data.data()) = decompressed_size;
-
             // Deflate color plate data
-            compressed_data.resize(image_size * 4);
             z_stream deflate_stream;
             deflate_stream.zalloc = Z_NULL;
             deflate_stream.zfree = Z_NULL;
             deflate_stream.opaque = Z_NULL;
+            deflateInit(&deflate_stream, Z_BEST_COMPRESSION);
+
+            // Set compressed size, then deflate directly after it
+            auto &compressed_data = bitmap_tag_data.compressed_color_plate_data;
+            compressed_data.resize(sizeof(decompressed_size) + deflateBound(&deflate_stream, image_size));
+            *reinterpret_cast<BigEndian<std::uint32_t> *>(compressed_data.data()) = decompressed_size;
+
             deflate_stream.avail_in = image_size;
             deflate_stream.next_in = const_cast<Bytef *>(reinterpret_cast<const Bytef *>(image_pixels.data()));
-            deflate_stream.avail_out = compressed_data.size();
-            deflate_stream.next_out = reinterpret_cast<Bytef *>(compressed_data.data());
+            deflate_stream.avail_out = compressed_data.size() - sizeof(decompressed_size);
+            deflate_stream.next_out = reinterpret_cast<Bytef *>(compressed_data.data() + sizeof(decompressed_size));
 
             // Do it
-            deflateInit(&deflate_stream, Z_BEST_COMPRESSION);
             deflate(&deflate_stream, Z_FINISH);
             deflateEnd(&deflate_stream);
-            bitmap_tag_data.compressed_color_plate_data.insert(bitmap_tag_data.compressed_color_plate_data.end(), compressed_data.data(), compressed_data.data() + deflate_stream.total_out);
+            compressed_data.resize(sizeof(decompressed_size) + deflate_stream.total_out);
+            compressed_data.shrink_to_fit();
         }
     }
 
@@ -373,15 +498,17 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     // Add our bitmap data
     try {
         // If we don't have a format, set it to null (it will determine it instead)
+        std::optional<float> error_budget;
         if(*bitmap_options.auto_format) {
             bitmap_options.format = std::nullopt;
+            error_budget = bitmap_options.error_budget_from_usage ? error_budget_for_usage(bitmap_options.usage.value()) : bitmap_options.error_budget;
         }
 
-        write_bitmap_data(scanned_color_plate, bitmap_tag_data.processed_pixel_data, bitmap_tag_data.bitmap_data, bitmap_options.usage.value(), bitmap_options.format, bitmap_options.bitmap_type.value(), bitmap_options.palettize.value(), bitmap_options.dithering.value());
+        write_bitmap_data(scanned_color_plate, bitmap_tag_data.processed_pixel_data, bitmap_tag_data.bitmap_data, bitmap_options.usage.value(), bitmap_options.format, bitmap_options.bitmap_type.value(), bitmap_options.palettize.value(), bitmap_options.dithering.value(), bitmap_options.dxt_quality, error_budget);
     }
     catch (std::exception &e) {
         eprintf_error("Failed to generate bitmap data: %s", e.what());
-        std::exit(1);
+        return EXIT_FAILURE;
     }
     oprintf("Total: %.03f MiB\n", BYTES_TO_MIB(bitmap_tag_data.processed_pixel_data.size()));
 
@@ -485,6 +612,131 @@ template <typename T> static int perform_the_ritual(const std::string &bitmap_ta
     return EXIT_SUCCESS;
 }
 
+static int make_bitmap(const std::string &bitmap_tag, const BitmapOptions &bitmap_options, bool &unchanged) {
+    MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_BITMAP_PROCESSING);
+    auto tag_path = bitmap_options.tags / bitmap_tag;
+    auto final_path_bitmap = std::filesystem::path(tag_path) += ".bitmap";
+    unchanged = false;
+
+    // If the source image, options, and tag are the same as the last time we made it, we don't need to make it again
+    std::optional<std::uint64_t> fingerprint;
+    std::filesystem::path fingerprint_path;
+    if(bitmap_options.cache.has_value()) {
+        fingerprint_path = std::filesystem::path(*bitmap_options.cache / bitmap_tag) += ".fingerprint";
+        fingerprint = fingerprint_bitmap(bitmap_tag, bitmap_options);
+
+        auto fingerprint_file = File::open_file(fingerprint_path);
+        auto tag_stamp = File::stamp_file(final_path_bitmap);
+        if(fingerprint.has_value() && tag_stamp.has_value() && fingerprint_file.has_value() && fingerprint_file->size() == sizeof(BitmapFingerprintFile)) {
+            BitmapFingerprintFile last_fingerprint;
+            std::memcpy(&last_fingerprint, fingerprint_file->data(), sizeof(last_fingerprint));
+            if(std::memcmp(last_fingerprint.magic, BITMAP_FINGERPRINT_MAGIC, sizeof(BITMAP_FINGERPRINT_MAGIC)) == 0 && last_fingerprint.fingerprint == *fingerprint && last_fingerprint.tag_stamp == *tag_stamp) {
+                unchanged = true;
+                return EXIT_SUCCESS;
+            }
+        }
+    }
+
+    // Each bitmap gets its own copy of the options since they're filled in from its tag
+    auto this_bitmap_options = bitmap_options;
+    auto result = perform_the_ritual<Invader::Parser::Bitmap>(bitmap_tag, tag_path, final_path_bitmap, this_bitmap_options, TagFourCC::TAG_FOURCC_BITMAP);
+
+    // Remember what we made it from
+    if(result == EXIT_SUCCESS && fingerprint.has_value()) {
+        auto tag_stamp = File::stamp_file(final_path_bitmap);
+        if(tag_stamp.has_value()) {
+            BitmapFingerprintFile new_fingerprint = {};
+            std::memcpy(new_fingerprint.magic, BITMAP_FINGERPRINT_MAGIC, sizeof(BITMAP_FINGERPRINT_MAGIC));
+            new_fingerprint.fingerprint = *fingerprint;
+            new_fingerprint.tag_stamp = *tag_stamp;
+
+            std::error_code ec;
+            std::filesystem::create_directories(fingerprint_path.parent_path(), ec);
+            auto *new_fingerprint_bytes = reinterpret_cast<const std::byte *>(&new_fingerprint);
+            if(!File::save_file(fingerprint_path, std::vector<std::byte>(new_fingerprint_bytes, new_fingerprint_bytes + sizeof(new_fingerprint)))) {
+                eprintf_warn("Failed to write to %s", fingerprint_path.string().c_str());
+            }
+        }
+    }
+
+    return result;
+}
+
+static int make_batch(const BitmapOptions &bitmap_options) {
+    // Find every bitmap we're making along with how big its input is
+    std::map<std::string, std::uintmax_t> bitmap_input_sizes;
+    std::error_code ec;
+    File::PathMatcher batch_matcher(bitmap_options.batch, bitmap_options.batch_exclude);
+
+    // If we're regenerating, the input is the tag itself. Otherwise, it's the image in the data directory.
+    if(bitmap_options.regenerate) {
+        for(auto &t : File::load_virtual_tag_folder({ bitmap_options.tags })) {
+            if(t.tag_fourcc == TagFourCC::TAG_FOURCC_BITMAP && batch_matcher.matches(t.tag_path.c_str())) {
+                auto bitmap_tag = std::filesystem::path(File::halo_path_to_preferred_path(t.tag_path)).replace_extension().string();
+                bitmap_input_sizes[bitmap_tag] = std::filesystem::file_size(t.full_path, ec);
+            }
+        }
+    }
+    else {
+        if(!std::filesystem::is_directory(bitmap_options.data)) {
+            eprintf_error("Directory %s was not found or is not a directory", bitmap_options.data.string().c_str());
+            return EXIT_FAILURE;
+        }
+
+        for(auto &i : std::filesystem::recursive_directory_iterator(bitmap_options.data)) {
+            if(!i.is_regular_file()) {
+                continue;
+            }
+
+            auto extension = i.path().extension().string();
+            if(std::find_if(std::begin(SUPPORTED_FORMATS), std::end(SUPPORTED_FORMATS), [&extension](const char *format) { return extension == format; }) == std::end(SUPPORTED_FORMATS)) {
+                continue;
+            }
+
+            auto bitmap_tag = std::filesystem::relative(i.path(), bitmap_options.data).replace_extension().string();
+            if(batch_matcher.matches((bitmap_tag + ".bitmap").c_str())) {
+                auto &size = bitmap_input_sizes[bitmap_tag];
+                size = std::max(size, i.file_size(ec));
+            }
+        }
+    }
+
+    // Make the biggest bitmaps first so one big bitmap doesn't hold up everything at the end
+    std::vector<std::pair<std::string, std::uintmax_t>> bitmaps(bitmap_input_sizes.begin(), bitmap_input_sizes.end());
+    std::stable_sort(bitmaps.begin(), bitmaps.end(), [](auto &a, auto &b) { return a.second > b.second; });
+
+    // Bitmaps share the threads with the processing and encoding done for each bitmap, so a few big bitmaps left at the
+    // end are still split across every thread
+    std::atomic<std::size_t> made = 0;
+    std::atomic<std::size_t> skipped = 0;
+    ThreadPool::shared().parallel_for(bitmaps.size(), [&bitmaps, &bitmap_options, &made, &skipped](std::size_t b) {
+        auto &bitmap_tag = bitmaps[b].first;
+        bool unchanged = false;
+        int result;
+        try {
+            result = make_bitmap(bitmap_tag, bitmap_options, unchanged);
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to make %s: %s", bitmap_tag.c_str(), e.what());
+            result = EXIT_FAILURE;
+        }
+
+        if(result != EXIT_SUCCESS) {
+            eprintf_error("Failed to make %s", bitmap_tag.c_str());
+        }
+        else if(unchanged) {
+            skipped++;
+        }
+        else {
+            oprintf_success("Made %s", bitmap_tag.c_str());
+            made++;
+        }
+    });
+
+    oprintf("Made %zu of %zu bitmap%s (%zu unchanged)\n", made.load(), bitmaps.size(), bitmaps.size() == 1 ? "" : "s", skipped.load());
+    return made + skipped == bitmaps.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[]) {
     set_up_color_term();
 
@@ -495,8 +747,14 @@ int main(int argc, char *argv[]) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
         CommandLineOption("ignore-tag", 'I', 0, "Ignore the tag data if the tag exists."),
+        CommandLineOption("cache", 'k', 1, "Store fingerprints of source images and options in a directory, and skip making bitmaps whose image, options, and tag haven't changed since they were last made.", "<dir>"),
         CommandLineOption("dithering", 'D', 1, "Apply dithering to 16-bit or p8 bitmaps. Can be: off or on. Default (new tag): off", "<val>"),
+        CommandLineOption("dxt-quality", 'q', 1, "Set the quality of DXT compression. Lower qualities are faster. This does not save in .bitmap tags. Can be: fast, normal, best. Default: best", "<quality>"),
+        CommandLineOption("error-budget", 'E', 1, "Find the smallest format (DXT1, DXT3, DXT5, monochrome, 16-bit, or 32-bit) where the PSNR of every channel is at least this many dB, or use 'usage' for a budget based on the usage (light maps: 45, detail maps: 36, anything else: 40). Height maps and vector maps are unaffected. This implies -F auto and does not save in .bitmap tags.", "<dB>"),
         CommandLineOption("format", 'F', 1, "Pixel format. Can be: 32-bit, 16-bit, monochrome, dxt5, dxt3, dxt1, or auto. 'auto' will be replaced with the best lossless format. Default (new tag): auto", "<type>"),
         CommandLineOption("type", 'T', 1, "Set the type of bitmap. Can be: 2d_textures, 3d_textures, cube_maps, interface_bitmaps, or sprites. Default (new tag): 2d_textures", "<type>"),
         CommandLineOption("mipmap-count", 'M', 1, "Set maximum mipmaps. Default (new tag): 32767", "<count>"),
@@ -515,10 +773,10 @@ int main(int argc, char *argv[]) {
     };
 
     static constexpr char DESCRIPTION[] = "Create or modify a bitmap tag.";
-    static constexpr char USAGE[] = "[options] <bitmap-tag>";
+    static constexpr char USAGE[] = "[options] <-b <expr> | <bitmap-tag>>";
 
     // Go through each argument
-    auto remaining_arguments = CommandLineOption::parse_arguments<BitmapOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, bitmap_options, [](char opt, const std::vector<const char *> &arguments, auto &bitmap_options) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<BitmapOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, bitmap_options, [](char opt, const std::vector<const char *> &arguments, auto &bitmap_options) {
         switch(opt) {
             case 'd':
                 bitmap_options.data = arguments[0];
@@ -576,6 +834,24 @@ int main(int argc, char *argv[]) {
                 }
                 break;
 
+            case 'E':
+                bitmap_options.format = std::nullopt;
+                bitmap_options.auto_format = true;
+                if(std::strcmp(arguments[0], "usage") == 0) {
+                    bitmap_options.error_budget = std::nullopt;
+                    bitmap_options.error_budget_from_usage = true;
+                }
+                else {
+                    char *end = nullptr;
+                    bitmap_options.error_budget = std::strtof(arguments[0], &end);
+                    bitmap_options.error_budget_from_usage = false;
+                    if(*end != 0 || !(*bitmap_options.error_budget > 0.0F)) {
+                        eprintf_error("Invalid error budget %s", arguments[0]);
+                        std::exit(EXIT_FAILURE);
+                    }
+                }
+                break;
+
             case 'F':
                 try {
                     if(std::strcmp(arguments[0], "auto") == 0) {
@@ -629,6 +905,22 @@ int main(int argc, char *argv[]) {
                 }
                 break;
 
+            case 'q':
+                if(std::strcmp(arguments[0], "fast") == 0) {
+                    bitmap_options.dxt_quality = BitmapEncode::DXTCompressionQuality::DXT_COMPRESSION_QUALITY_FAST;
+                }
+                else if(std::strcmp(arguments[0], "normal") == 0) {
+                    bitmap_options.dxt_quality = BitmapEncode::DXTCompressionQuality::DXT_COMPRESSION_QUALITY_NORMAL;
+                }
+                else if(std::strcmp(arguments[0], "best") == 0) {
+                    bitmap_options.dxt_quality = BitmapEncode::DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST;
+                }
+                else {
+                    eprintf_error("Unknown DXT quality %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+
             case 'p':
                 if(std::strcmp(arguments[0],"on") == 0) {
                     bitmap_options.palettize = true;
@@ -688,9 +980,48 @@ int main(int argc, char *argv[]) {
             case 'P':
                 bitmap_options.filesystem_path = true;
                 break;
+
+            case 'k':
+                bitmap_options.cache = arguments[0];
+                break;
+
+            case 'b':
+                bitmap_options.batch.emplace_back(arguments[0]);
+                break;
+
+            case 'e':
+                bitmap_options.batch_exclude.emplace_back(arguments[0]);
+                break;
+
+            case 'j':
+                bitmap_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
         }
     });
 
+    // Check if the tags directory exists
+    if(!std::filesystem::is_directory(bitmap_options.tags)) {
+        eprintf_error("Directory %s was not found or is not a directory", bitmap_options.tags.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    if(bitmap_options.thread_count.has_value()) {
+        ThreadPool::set_shared_thread_count(*bitmap_options.thread_count);
+    }
+
+    auto uses_batching = !(bitmap_options.batch.empty() && bitmap_options.batch_exclude.empty());
+    if(uses_batching != remaining_arguments.empty()) {
+        eprintf_error("Expected a bitmap tag path OR batching (not both)");
+        return EXIT_FAILURE;
+    }
+
+    if(uses_batching) {
+        auto result = make_batch(bitmap_options);
+        MemoryUsage::print_counters();
+        return result;
+    }
+
     // Resolve the bitmap tag
     std::string bitmap_tag;
     if(bitmap_options.filesystem_path) {
@@ -708,13 +1039,11 @@ int main(int argc, char *argv[]) {
         bitmap_tag = remaining_arguments[0];
     }
 
-    // Check if the tags directory exists
-    if(!std::filesystem::is_directory(bitmap_options.tags)) {
-        eprintf_error("Directory %s was not found or is not a directory", bitmap_options.tags.string().c_str());
-        return EXIT_FAILURE;
+    bool unchanged;
+    auto result = make_bitmap(bitmap_tag, bitmap_options, unchanged);
+    if(unchanged) {
+        oprintf("%s is unchanged\n", bitmap_tag.c_str());
     }
-
-    auto tag_path = bitmap_options.tags / bitmap_tag;
-    auto final_path_bitmap = std::filesystem::path(tag_path) += ".bitmap";
-    return perform_the_ritual<Invader::Parser::Bitmap>(bitmap_tag, tag_path, final_path_bitmap, bitmap_options, TagFourCC::TAG_FOURCC_BITMAP);
+    MemoryUsage::print_counters();
+    return result;
 }
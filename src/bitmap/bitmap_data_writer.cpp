@@ -4,14 +4,116 @@
 #include <invader/tag/hek/class/bitmap.hpp>
 #include <invader/printf.hpp>
 #include <invader/bitmap/bitmap_encode.hpp>
+#include <invader/thread_pool.hpp>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace Invader {
-    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, std::optional<BitmapFormat> &format, BitmapType bitmap_type, bool palettize, bool dither) {
+    // Encode every bitmap in each format that could fit and pick the smallest format where no channel is further from the source than the
+    // error budget. The bitmaps encoded in the picked format are kept so they don't have to be encoded again.
+    static BitmapFormat pick_format_within_error_budget(const GeneratedBitmapData &scanned_color_plate, BitmapType bitmap_type, float error_budget, bool dither, BitmapEncode::DXTCompressionQuality dxt_quality, std::vector<std::vector<std::byte>> &encoded_bitmaps) {
+        using namespace Invader::HEK;
+
+        // P8 isn't here since its palette is made for height maps, which don't get here
+        static constexpr const BitmapFormat CANDIDATES[] = {
+            BitmapFormat::BITMAP_FORMAT_DXT1,
+            BitmapFormat::BITMAP_FORMAT_DXT3,
+            BitmapFormat::BITMAP_FORMAT_DXT5,
+            BitmapFormat::BITMAP_FORMAT_MONOCHROME,
+            BitmapFormat::BITMAP_FORMAT_16_BIT,
+            BitmapFormat::BITMAP_FORMAT_32_BIT
+        };
+        static constexpr const std::size_t CANDIDATE_COUNT = sizeof(CANDIDATES) / sizeof(*CANDIDATES);
+
+        auto bitmap_count = scanned_color_plate.bitmaps.size();
+        auto data_type = bitmap_type == BitmapType::BITMAP_TYPE_CUBE_MAPS ? BitmapDataType::BITMAP_DATA_TYPE_CUBE_MAP : bitmap_type == BitmapType::BITMAP_TYPE_3D_TEXTURES ? BitmapDataType::BITMAP_DATA_TYPE_3D_TEXTURE : BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE;
+        auto depth_of = [&bitmap_type](const GeneratedBitmapDataBitmap &bitmap) -> std::size_t {
+            return bitmap_type == BitmapType::BITMAP_TYPE_3D_TEXTURES ? bitmap.depth : 1;
+        };
+
+        // Each candidate has an encoding of each bitmap. If a bitmap ends up in the same format as it did in an earlier candidate (e.g. DXT3 and
+        // DXT5 both fall back to DXT1 without alpha), it's only encoded once.
+        struct Encoding {
+            BitmapDataFormat format;
+            std::size_t encoded_by;
+            std::vector<std::byte> encoded;
+            BitmapEncode::EncodingError error;
+        };
+        std::vector<Encoding> encodings(CANDIDATE_COUNT * bitmap_count);
+        std::vector<std::size_t> to_encode;
+        for(std::size_t i = 0; i < bitmap_count; i++) {
+            auto &bitmap = scanned_color_plate.bitmaps[i];
+            auto pixel_count = BitmapEncode::bitmap_data_size(bitmap.width, bitmap.height, depth_of(bitmap), bitmap.mipmaps.size(), BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, data_type) / sizeof(Pixel);
+            auto analysis = BitmapEncode::analyze_pixels(reinterpret_cast<const std::byte *>(bitmap.pixels.data()), pixel_count);
+            for(std::size_t c = 0; c < CANDIDATE_COUNT; c++) {
+                auto &encoding = encodings[c * bitmap_count + i];
+                encoding.format = BitmapEncode::most_efficient_format(analysis, CANDIDATES[c]);
+                encoding.encoded_by = c * bitmap_count + i;
+                for(std::size_t earlier = 0; earlier < c; earlier++) {
+                    if(encodings[earlier * bitmap_count + i].format == encoding.format) {
+                        encoding.encoded_by = earlier * bitmap_count + i;
+                        break;
+                    }
+                }
+                if(encoding.encoded_by == c * bitmap_count + i) {
+                    to_encode.emplace_back(encoding.encoded_by);
+                }
+            }
+        }
+
+        // Encode and measure them all at once
+        ThreadPool::shared().parallel_for(to_encode.size(), [&](std::size_t e) {
+            auto &encoding = encodings[to_encode[e]];
+            auto &bitmap = scanned_color_plate.bitmaps[to_encode[e] % bitmap_count];
+            auto *first_pixel = reinterpret_cast<const std::byte *>(bitmap.pixels.data());
+            encoding.encoded = BitmapEncode::encode_bitmap(first_pixel, BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, encoding.format, bitmap.width, bitmap.height, depth_of(bitmap), data_type, bitmap.mipmaps.size(), dither, dxt_quality);
+            encoding.error = BitmapEncode::measure_encoding_error(first_pixel, encoding.encoded.data(), encoding.format, bitmap.width, bitmap.height, depth_of(bitmap), data_type, bitmap.mipmaps.size());
+        });
+
+        // Pick the smallest one that fits (32-bit is lossless, so something always fits), going with the more accurate one if they're the same size
+        oprintf("Error budget: %.02f dB\n", error_budget);
+        std::optional<std::size_t> best;
+        std::size_t best_size = 0;
+        double best_psnr = 0.0;
+        for(std::size_t c = 0; c < CANDIDATE_COUNT; c++) {
+            std::size_t size = 0;
+            double worst_psnr = std::numeric_limits<double>::infinity();
+            for(std::size_t i = 0; i < bitmap_count; i++) {
+                auto &encoding = encodings[encodings[c * bitmap_count + i].encoded_by];
+                size += encoding.encoded.size();
+                worst_psnr = std::min(worst_psnr, encoding.error.worst_psnr());
+            }
+
+            bool fits = worst_psnr >= error_budget;
+            if(std::isinf(worst_psnr)) {
+                oprintf("    %-10s - %.03f MiB, lossless\n", BitmapFormat_to_string(CANDIDATES[c]), size / 1024.0F / 1024.0F);
+            }
+            else {
+                oprintf("    %-10s - %.03f MiB, %.02f dB%s\n", BitmapFormat_to_string(CANDIDATES[c]), size / 1024.0F / 1024.0F, worst_psnr, fits ? "" : " (over budget)");
+            }
+
+            if(fits && (!best.has_value() || size < best_size || (size == best_size && worst_psnr > best_psnr))) {
+                best = c;
+                best_size = size;
+                best_psnr = worst_psnr;
+            }
+        }
+
+        for(std::size_t i = 0; i < bitmap_count; i++) {
+            encoded_bitmaps[i] = std::move(encodings[encodings[*best * bitmap_count + i].encoded_by].encoded);
+        }
+        return CANDIDATES[*best];
+    }
+
+    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, std::optional<BitmapFormat> &format, BitmapType bitmap_type, bool palettize, bool dither, BitmapEncode::DXTCompressionQuality dxt_quality, std::optional<float> error_budget) {
         using namespace Invader::HEK;
 
         auto bitmap_count = scanned_color_plate.bitmaps.size();
 
+        // Bitmaps that were already encoded while picking the format don't get encoded again
+        std::vector<std::vector<std::byte>> encoded_bitmaps(bitmap_count);
+
         // If format is nullopt, automatically determine a format
         bool automatically_determined_format = !format.has_value();
         if(automatically_determined_format) {
@@ -19,6 +121,9 @@ namespace Invader {
             if(usage == BitmapUsage::BITMAP_USAGE_HEIGHT_MAP || usage == BitmapUsage::BITMAP_USAGE_VECTOR_MAP) {
                 format = BitmapFormat::BITMAP_FORMAT_32_BIT;
             }
+            else if(error_budget.has_value()) {
+                format = pick_format_within_error_budget(scanned_color_plate, bitmap_type, *error_budget, dither, dxt_quality, encoded_bitmaps);
+            }
             else {
                 // Determine if we can make it smaller
                 bool is_monochrome = true;
@@ -62,6 +167,15 @@ namespace Invader {
                 case BitmapFormat::BITMAP_FORMAT_MONOCHROME:
                     oprintf("Automatically determined format as monochrome\n");
                     break;
+                case BitmapFormat::BITMAP_FORMAT_DXT1:
+                    oprintf("Automatically determined format as DXT1\n");
+                    break;
+                case BitmapFormat::BITMAP_FORMAT_DXT3:
+                    oprintf("Automatically determined format as DXT3\n");
+                    break;
+                case BitmapFormat::BITMAP_FORMAT_DXT5:
+                    oprintf("Automatically determined format as DXT5\n");
+                    break;
                 default:
                     std::terminate();
             }
@@ -72,6 +186,8 @@ namespace Invader {
         bool warn_on_semi_transparent_1_bit_alpha = false;
         bool warn_on_lost_color = false;
 
+        auto first_new_bitmap = bitmap_data.size();
+
         for(std::size_t i = 0; i < bitmap_count; i++) {
             // Write all of the fields here
             auto &bitmap = bitmap_data.emplace_back();
@@ -93,13 +209,13 @@ namespace Invader {
                     bitmap.depth = 1;
                     break;
             }
-            bitmap.pixel_data_offset = static_cast<std::uint32_t>(bitmap_data_pixels.size());
             std::uint32_t mipmap_count = bitmap_color_plate.mipmaps.size();
 
             // Get the data
-            std::vector<std::byte> current_bitmap_pixels(reinterpret_cast<const std::byte *>(bitmap_color_plate.pixels.data()), reinterpret_cast<const std::byte *>(bitmap_color_plate.pixels.data() + bitmap_color_plate.pixels.size()));
-            auto *first_pixel = reinterpret_cast<Pixel *>(current_bitmap_pixels.data());
-            bitmap.format = BitmapEncode::most_efficient_format(current_bitmap_pixels.data(), bitmap.width, bitmap.height, bitmap.depth, *format, bitmap.type, mipmap_count);
+            auto *first_pixel = reinterpret_cast<const std::byte *>(bitmap_color_plate.pixels.data());
+            auto pixel_count = BitmapEncode::bitmap_data_size(bitmap.width, bitmap.height, bitmap.depth, mipmap_count, BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, bitmap.type) / sizeof(Pixel);
+            auto analysis = BitmapEncode::analyze_pixels(first_pixel, pixel_count);
+            bitmap.format = BitmapEncode::most_efficient_format(analysis, *format);
 
             // Set the format
             bool compressed = (format == BitmapFormat::BITMAP_FORMAT_DXT1 || format == BitmapFormat::BITMAP_FORMAT_DXT3 || format == BitmapFormat::BITMAP_FORMAT_DXT5);
@@ -116,20 +232,16 @@ namespace Invader {
 
             // Warn on 1-bit alpha being memed away
             if(should_p8 || format == BitmapFormat::BITMAP_FORMAT_DXT1) {
-                for(auto &p : bitmap_color_plate.pixels) {
-                    if(p.alpha != 0 && p.alpha != 255) {
-                        warn_on_semi_transparent_1_bit_alpha = true;
-                    }
-                    if(p.alpha != 255 && (p.red != 0 || p.green != 0 || p.blue != 0)) {
-                        warn_on_lost_color = true;
-                    }
+                if(analysis.alpha_present == BitmapEncode::PixelAnalysis::ALPHA_PRESENT_MULTI_BIT) {
+                    warn_on_semi_transparent_1_bit_alpha = true;
+                }
+                if(analysis.color_in_transparency) {
+                    warn_on_lost_color = true;
                 }
             }
 
-            // Go through each mipmap; compress
+            // Mipmaps are compressed below
             bitmap.mipmap_count = mipmap_count;
-            auto encoded_pixels = BitmapEncode::encode_bitmap(reinterpret_cast<const std::byte *>(first_pixel), BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, bitmap.format, bitmap.width, bitmap.height, bitmap.depth, bitmap.type, bitmap.mipmap_count, dither);
-            bitmap_data_pixels.insert(bitmap_data_pixels.end(), encoded_pixels.begin(), encoded_pixels.end());
 
             BitmapDataFlags flags = {};
             if(compressed) {
@@ -150,10 +262,31 @@ namespace Invader {
 
             bitmap.registration_point.x = bitmap_color_plate.registration_point_x;
             bitmap.registration_point.y = bitmap_color_plate.registration_point_y;
+        }
+
+        // Go through each bitmap and its mipmaps; compress. Bitmaps are independent, so they can be encoded on separate threads.
+        ThreadPool::shared().parallel_for(bitmap_count, [&](std::size_t i) {
+            if(!encoded_bitmaps[i].empty()) {
+                return;
+            }
+            auto &bitmap = bitmap_data[first_new_bitmap + i];
+            auto *first_pixel = reinterpret_cast<const std::byte *>(scanned_color_plate.bitmaps[i].pixels.data());
+            encoded_bitmaps[i] = BitmapEncode::encode_bitmap(first_pixel, BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, bitmap.format, bitmap.width, bitmap.height, bitmap.depth, bitmap.type, bitmap.mipmap_count, dither, dxt_quality);
+        });
+
+        // Gather them in order
+        for(std::size_t i = 0; i < bitmap_count; i++) {
+            auto &bitmap = bitmap_data[first_new_bitmap + i];
+            auto &encoded_pixels = encoded_bitmaps[i];
+            std::uint32_t mipmap_count = bitmap.mipmap_count;
+            bitmap.pixel_data_offset = static_cast<std::uint32_t>(bitmap_data_pixels.size());
+            bitmap_data_pixels.insert(bitmap_data_pixels.end(), encoded_pixels.begin(), encoded_pixels.end());
 
             #define BYTES_TO_MIB(bytes) (bytes / 1024.0F / 1024.0F)
 
             oprintf("    Bitmap #%zu: %ux%u, %u mipmap%s, %s - %.03f MiB\n", i, scanned_color_plate.bitmaps[i].width, scanned_color_plate.bitmaps[i].height, mipmap_count, mipmap_count == 1 ? "" : "s", bitmap_data_format_name(bitmap.format), BYTES_TO_MIB(encoded_pixels.size()));
+
+            std::vector<std::byte>().swap(encoded_pixels);
         }
 
         if(warn_on_semi_transparent_1_bit_alpha) {
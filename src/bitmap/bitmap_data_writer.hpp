@@ -5,14 +5,15 @@
 
 #include <invader/bitmap/color_plate_scanner.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/bitmap/bitmap_encode.hpp>
 
 namespace Invader {
     using BitmapFormat = HEK::BitmapFormat;
 
     /**
-     * if format is nullopt, it will determine one
+     * if format is nullopt, it will determine one; if error_budget is set, it will be the smallest format whose worst channel PSNR (in dB) is at least that
      */
-    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, std::optional<BitmapFormat> &format, BitmapType bitmap_type, bool palettize, bool dither);
+    void write_bitmap_data(const GeneratedBitmapData &scanned_color_plate, std::vector<std::byte> &bitmap_data_pixels, std::vector<Parser::BitmapData> &bitmap_data, BitmapUsage usage, std::optional<BitmapFormat> &format, BitmapType bitmap_type, bool palettize, bool dither, BitmapEncode::DXTCompressionQuality dxt_quality, std::optional<float> error_budget = std::nullopt);
 }
 
 #endif
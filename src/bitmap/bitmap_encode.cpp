@@ -3,7 +3,11 @@
 #include <invader/bitmap/bitmap_encode.hpp>
 #include <invader/tag/hek/class/bitmap.hpp>
 #include <invader/bitmap/pixel.hpp>
+#include <invader/thread_pool.hpp>
 #include <cassert>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 #include <squish.h>
 
 #include "bcdec/bcdec.h"
@@ -11,7 +15,110 @@
 namespace Invader::BitmapEncode {
     static std::vector<Pixel> decode_to_32_bit(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::size_t width, std::size_t height);
 
-    static void encode_bitmap(Pixel *input_data, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither) {
+    // Rows of 4x4 blocks are split across threads, but small surfaces (i.e. most mipmaps) aren't worth it
+    static constexpr const std::size_t MIN_BLOCK_ROWS_PER_THREAD = 16;
+
+    static void compress_dxt(const Pixel *input_data, std::byte *output_data, std::size_t width, std::size_t height, int flags) {
+        std::size_t block_size = (flags & squish::kDxt1) ? 8 : 16;
+        std::size_t blocks_x = (width + 3) / 4;
+        std::size_t blocks_y = (height + 3) / 4;
+
+        // Compress one row of 4x4 blocks at a time, writing each block directly to the output
+        auto compress_row = [&input_data, &output_data, &width, &height, &flags, &block_size, &blocks_x](std::size_t block_y) {
+            auto *block_output = output_data + block_y * blocks_x * block_size;
+
+            for(std::size_t block_x = 0; block_x < blocks_x; block_x++, block_output += block_size) {
+                Pixel block[4 * 4] = {};
+                int mask = 0;
+
+                for(std::size_t y = 0; y < 4; y++) {
+                    std::size_t pixel_y = block_y * 4 + y;
+                    if(pixel_y >= height) {
+                        break;
+                    }
+                    for(std::size_t x = 0; x < 4; x++) {
+                        std::size_t pixel_x = block_x * 4 + x;
+                        if(pixel_x >= width) {
+                            break;
+                        }
+
+                        auto &pixel = block[x + y * 4];
+                        pixel = input_data[pixel_x + pixel_y * width];
+                        std::swap(pixel.blue, pixel.red);
+                        mask |= 1 << (x + y * 4);
+                    }
+                }
+
+                squish::CompressMasked(reinterpret_cast<const squish::u8 *>(block), mask, block_output, flags);
+            }
+        };
+
+        ThreadPool::shared().parallel_for(blocks_y, compress_row, blocks_y / MIN_BLOCK_ROWS_PER_THREAD);
+    }
+
+    static void decompress_blocks(const std::byte *input_data, HEK::BitmapDataFormat input_format, Pixel *output_data, std::size_t width, std::size_t height) {
+        void (*decompress_block)(const void *, void *, int);
+        std::size_t block_size;
+        switch(input_format) {
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
+                decompress_block = bcdec_bc1;
+                block_size = BCDEC_BC1_BLOCK_SIZE;
+                break;
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
+                decompress_block = bcdec_bc2;
+                block_size = BCDEC_BC2_BLOCK_SIZE;
+                break;
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
+                decompress_block = bcdec_bc3;
+                block_size = BCDEC_BC3_BLOCK_SIZE;
+                break;
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_BC7:
+                decompress_block = bcdec_bc7;
+                block_size = BCDEC_BC7_BLOCK_SIZE;
+                break;
+            default:
+                std::terminate();
+        }
+
+        std::size_t blocks_x = (width + 3) / 4;
+        std::size_t blocks_y = (height + 3) / 4;
+
+        // Decompress one row of 4x4 blocks at a time. Blocks are decompressed straight into the output unless they're cut off by the edge of the bitmap.
+        auto decompress_row = [&input_data, &output_data, &width, &height, &decompress_block, &block_size, &blocks_x](std::size_t block_y) {
+            const auto *block_input = input_data + block_y * blocks_x * block_size;
+            std::size_t y = block_y * 4;
+            std::size_t rows = std::min(height - y, static_cast<std::size_t>(4));
+
+            for(std::size_t block_x = 0; block_x < blocks_x; block_x++, block_input += block_size) {
+                std::size_t x = block_x * 4;
+                std::size_t columns = std::min(width - x, static_cast<std::size_t>(4));
+                auto *output = output_data + x + y * width;
+
+                if(rows == 4 && columns == 4) {
+                    decompress_block(block_input, output, static_cast<int>(width * sizeof(*output)));
+                }
+                else {
+                    Pixel block[4 * 4];
+                    decompress_block(block_input, block, static_cast<int>(4 * sizeof(*block)));
+                    for(std::size_t r = 0; r < rows; r++) {
+                        std::copy(block + r * 4, block + r * 4 + columns, output + r * width);
+                    }
+                }
+
+                // bcdec gives us RGBA
+                for(std::size_t r = 0; r < rows; r++) {
+                    for(std::size_t c = 0; c < columns; c++) {
+                        auto &pixel = output[c + r * width];
+                        std::swap(pixel.red, pixel.blue);
+                    }
+                }
+            }
+        };
+
+        ThreadPool::shared().parallel_for(blocks_y, decompress_row, blocks_y / MIN_BLOCK_ROWS_PER_THREAD);
+    }
+
+    static void encode_bitmap(Pixel *input_data, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither, DXTCompressionQuality dxt_quality) {
         auto pixel_count = width * height;
         auto first_pixel = input_data;
         auto last_pixel = first_pixel + width * height;
@@ -171,9 +278,7 @@ namespace Invader::BitmapEncode {
                     dither_do(&Pixel::convert_to_p8, Pixel::convert_from_p8, first_pixel, pixel_8_bit, width, height);
                 }
                 else {
-                    for(auto *pixel = first_pixel; pixel < last_pixel; pixel++, pixel_8_bit++) {
-                        *pixel_8_bit = pixel->convert_to_p8();
-                    }
+                    Pixel::convert_row_to_p8(first_pixel, pixel_8_bit, pixel_count);
                 }
 
                 break;
@@ -183,7 +288,21 @@ namespace Invader::BitmapEncode {
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5: {
-                int flags = squish::kColourIterativeClusterFit | squish::kSourceBGRA;
+                int flags = squish::kSourceBGRA;
+                switch(dxt_quality) {
+                    case DXTCompressionQuality::DXT_COMPRESSION_QUALITY_FAST:
+                        flags |= squish::kColourRangeFit;
+                        break;
+                    case DXTCompressionQuality::DXT_COMPRESSION_QUALITY_NORMAL:
+                        flags |= squish::kColourClusterFit;
+                        break;
+                    case DXTCompressionQuality::DXT_COMPRESSION_QUALITY_BEST:
+                        flags |= squish::kColourIterativeClusterFit;
+                        break;
+                    default:
+                        std::terminate();
+                }
+
                 switch(output_format) {
                     case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
                         flags |= squish::kDxt1;
@@ -198,12 +317,7 @@ namespace Invader::BitmapEncode {
                         std::terminate();
                 }
 
-                std::vector<Pixel> data_to_compress(first_pixel, first_pixel + pixel_count);
-                for(auto &i : data_to_compress) {
-                    std::swap(i.blue, i.red);
-                }
-                squish::CompressImage(reinterpret_cast<const squish::u8 *>(data_to_compress.data()), width, height, output_data, flags);
-
+                compress_dxt(first_pixel, output_data, width, height, flags);
                 break;
             }
 
@@ -233,44 +347,45 @@ namespace Invader::BitmapEncode {
         }
     }
 
-    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither) {
-        encode_bitmap(decode_to_32_bit(input_data, input_format, width, height).data(), output_data, output_format, width, height, dither);
+    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither, DXTCompressionQuality dxt_quality) {
+        encode_bitmap(decode_to_32_bit(input_data, input_format, width, height).data(), output_data, output_format, width, height, dither, dxt_quality);
     }
 
-    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither) {
+    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, bool dither, DXTCompressionQuality dxt_quality) {
         // Get our output buffer
         std::vector<std::byte> output(bitmap_data_size(width, height, 1, 0, output_format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE));
 
         // Do it
-        encode_bitmap(input_data, input_format, output.data(), output_format, width, height, dither);
+        encode_bitmap(input_data, input_format, output.data(), output_format, width, height, dither, dxt_quality);
 
         // Done
         return output;
     }
 
-    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither) {
+    std::vector<std::byte> encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither, DXTCompressionQuality dxt_quality) {
         // Get our output buffer
         std::vector<std::byte> output(bitmap_data_size(width, height, depth, mipmap_count, output_format, type));
 
         // Do it
-        encode_bitmap(input_data, input_format, output.data(), output_format, width, height, depth, type, mipmap_count, dither);
+        encode_bitmap(input_data, input_format, output.data(), output_format, width, height, depth, type, mipmap_count, dither, dxt_quality);
 
         // Done
         return output;
     }
 
-    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither) {
+    void encode_bitmap(const std::byte *input_data, HEK::BitmapDataFormat input_format, std::byte *output_data, HEK::BitmapDataFormat output_format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count, bool dither, DXTCompressionQuality dxt_quality) {
         struct UserData {
             HEK::BitmapDataFormat input_format;
             std::byte *output_data;
             HEK::BitmapDataFormat output_format;
             bool dither;
-        } data = { input_format, output_data, output_format, dither };
+            DXTCompressionQuality dxt_quality;
+        } data = { input_format, output_data, output_format, dither, dxt_quality };
 
         auto do_the_thing = [](const std::byte *data, std::size_t width, std::size_t height, std::size_t depth, void *output) {
             auto *output_actual = reinterpret_cast<UserData *>(output);
             for(std::size_t i = 0; i < depth; i++) {
-                encode_bitmap(data, output_actual->input_format, output_actual->output_data, output_actual->output_format, width, height, output_actual->dither);
+                encode_bitmap(data, output_actual->input_format, output_actual->output_data, output_actual->output_format, width, height, output_actual->dither, output_actual->dxt_quality);
                 data += bitmap_data_size(width, height, 1, 0, output_actual->input_format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
                 output_actual->output_data += bitmap_data_size(width, height, 1, 0, output_actual->output_format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
             }
@@ -314,63 +429,14 @@ namespace Invader::BitmapEncode {
             }
         };
 
-        auto decode_dxt = [&width, &height, &input_format, &data, &input_data]() {
-            int flags = squish::kSourceBGRA;
-
-            switch(input_format) {
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
-                    flags |= squish::kDxt1;
-                    break;
-
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
-                    flags |= squish::kDxt3;
-                    break;
-
-                case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
-                    flags |= squish::kDxt5;
-                    break;
-
-                default:
-                    std::terminate();
-            }
-
-            squish::DecompressImage(reinterpret_cast<squish::u8 *>(data.data()), width, height, input_data, flags);
-
-            for(auto &color : data) {
-                std::swap(color.red, color.blue);
-            }
-        };
-
         switch(input_format) {
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT3:
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT5:
-                decode_dxt();
+            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_BC7:
+                decompress_blocks(input_data, input_format, data.data(), width, height);
                 break;
 
-            case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_BC7: {
-                Pixel pixels[4*4];
-                const std::byte *input_bc7 = input_data;
-
-                for(size_t y = 0; y < height; y += 4) {
-                    for(size_t x = 0; x < width; x += 4) {
-                        bcdec_bc7(input_bc7, &pixels, 16);
-                        input_bc7 += 16;
-
-                        for(size_t y_in = y; y_in < height && y_in < y + 4; y_in++) {
-                            for(size_t x_in = x; x_in < width && x_in < x + 4; x_in++) {
-                                auto &pixel = pixels[(y_in - y) * 4 + (x_in - x)];
-                                std::swap(pixel.red, pixel.blue);
-
-                                data[y_in * width + x_in] = pixel;
-                            }
-                        }
-                    }
-                }
-
-                break;
-            }
-
             case HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8:
                 std::memcpy(reinterpret_cast<std::byte *>(data.data()), input_data, data.size() * sizeof(data[0]));
                 break;
@@ -419,41 +485,92 @@ namespace Invader::BitmapEncode {
         return data;
     }
 
-    static HEK::BitmapDataFormat most_efficient_format(const std::byte *input_data, std::size_t pixel_count, HEK::BitmapFormat category) noexcept {
-        // No need to check anything here
-        if(category == HEK::BitmapFormat::BITMAP_FORMAT_DXT1) {
-            return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1;
-        }
-
-        enum AlphaPresent {
-            ALPHA_PRESENT_NONE = 0,
-            ALPHA_PRESENT_ONE_BIT = 1,
-            ALPHA_PRESENT_MULTI_BIT = 2
-        } alpha_present = AlphaPresent::ALPHA_PRESENT_NONE;
+    double EncodingError::worst_psnr() const noexcept {
+        return *std::min_element(this->psnr, this->psnr + sizeof(this->psnr) / sizeof(*this->psnr));
+    }
 
-        bool all_white = true;
-        bool luminosity_equals_alpha = true;
+    EncodingError measure_encoding_error(const std::byte *source_data, const std::byte *encoded_data, HEK::BitmapDataFormat format, std::size_t width, std::size_t height, std::size_t depth, HEK::BitmapDataType type, std::size_t mipmap_count) {
+        std::uint64_t squared_error[4] = {};
+        std::uint64_t pixel_count = 0;
 
-        // Analyze each pixel
-        auto *starting_pixel = reinterpret_cast<const Pixel *>(input_data);
-        for(std::size_t i = 0; i < pixel_count; i++, starting_pixel++) {
-            if(starting_pixel->alpha == 0x00 && alpha_present == AlphaPresent::ALPHA_PRESENT_NONE) {
-                alpha_present = AlphaPresent::ALPHA_PRESENT_ONE_BIT;
-            }
-            else if(starting_pixel->alpha != 0x00 && starting_pixel->alpha != 0xFF) {
-                alpha_present = AlphaPresent::ALPHA_PRESENT_MULTI_BIT;
+        // Both are laid out the same way (each mipmap's faces, each face's slices), so walk them together
+        std::size_t face_count = type == HEK::BitmapDataType::BITMAP_DATA_TYPE_CUBE_MAP ? 6 : 1;
+        for(std::size_t m = 0; m <= mipmap_count; m++) {
+            for(std::size_t i = 0; i < face_count * depth; i++) {
+                auto decoded = decode_to_32_bit(encoded_data, format, width, height);
+                auto *source = reinterpret_cast<const Pixel *>(source_data);
+                for(std::size_t p = 0; p < decoded.size(); p++) {
+                    auto difference = [](std::uint8_t a, std::uint8_t b) {
+                        std::int32_t delta = static_cast<std::int32_t>(a) - static_cast<std::int32_t>(b);
+                        return static_cast<std::uint64_t>(delta * delta);
+                    };
+                    squared_error[0] += difference(source[p].alpha, decoded[p].alpha);
+                    squared_error[1] += difference(source[p].red, decoded[p].red);
+                    squared_error[2] += difference(source[p].green, decoded[p].green);
+                    squared_error[3] += difference(source[p].blue, decoded[p].blue);
+                }
+                pixel_count += decoded.size();
+                source_data += bitmap_data_size(width, height, 1, 0, HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
+                encoded_data += bitmap_data_size(width, height, 1, 0, format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
             }
 
-            if(starting_pixel->convert_to_y8() != starting_pixel->alpha) {
-                luminosity_equals_alpha = false;
+            width = std::max(width / 2, static_cast<std::size_t>(1));
+            height = std::max(height / 2, static_cast<std::size_t>(1));
+            depth = std::max(depth / 2, static_cast<std::size_t>(1));
+        }
+
+        EncodingError error;
+        for(std::size_t c = 0; c < 4; c++) {
+            double mean_squared_error = pixel_count == 0 ? 0.0 : static_cast<double>(squared_error[c]) / pixel_count;
+            error.rmse[c] = std::sqrt(mean_squared_error);
+            error.psnr[c] = mean_squared_error == 0.0 ? std::numeric_limits<double>::infinity() : 10.0 * std::log10(255.0 * 255.0 / mean_squared_error);
+        }
+        return error;
+    }
+
+    PixelAnalysis analyze_pixels(const std::byte *input_data, std::size_t pixel_count) noexcept {
+        // Pixels are checked in chunks without branching on each one (so the checks can be vectorized), and we stop after
+        // any chunk once every check has gone the way it can't come back from
+        static constexpr const std::size_t CHUNK_SIZE = 1024;
+
+        bool zero_alpha = false;
+        bool partial_alpha = false;
+        bool not_white = false;
+        bool luminosity_differs = false;
+        bool color_in_transparency = false;
+
+        auto *pixels = reinterpret_cast<const Pixel *>(input_data);
+        for(std::size_t chunk = 0; chunk < pixel_count; chunk += CHUNK_SIZE) {
+            auto chunk_end = std::min(chunk + CHUNK_SIZE, pixel_count);
+            for(std::size_t i = chunk; i < chunk_end; i++) {
+                auto &pixel = pixels[i];
+                zero_alpha |= pixel.alpha == 0x00;
+                partial_alpha |= pixel.alpha != 0x00 && pixel.alpha != 0xFF;
+                not_white |= (pixel.red & pixel.green & pixel.blue) != 0xFF;
+                luminosity_differs |= pixel.convert_to_y8() != pixel.alpha;
+                color_in_transparency |= pixel.alpha != 0xFF && (pixel.red | pixel.green | pixel.blue) != 0x00;
             }
 
-            if(starting_pixel->red != 0xFF || starting_pixel->green != 0xFF || starting_pixel->blue != 0xFF) {
-                all_white = false;
+            if(zero_alpha && partial_alpha && not_white && luminosity_differs && color_in_transparency) {
+                break;
             }
         }
 
+        PixelAnalysis analysis;
+        analysis.alpha_present = partial_alpha ? PixelAnalysis::ALPHA_PRESENT_MULTI_BIT : zero_alpha ? PixelAnalysis::ALPHA_PRESENT_ONE_BIT : PixelAnalysis::ALPHA_PRESENT_NONE;
+        analysis.all_white = !not_white;
+        analysis.luminosity_equals_alpha = !luminosity_differs;
+        analysis.color_in_transparency = color_in_transparency;
+        return analysis;
+    }
+
+    HEK::BitmapDataFormat most_efficient_format(const PixelAnalysis &analysis, HEK::BitmapFormat category) noexcept {
+        auto alpha_present = analysis.alpha_present;
+
         switch(category) {
+            case HEK::BitmapFormat::BITMAP_FORMAT_DXT1:
+                return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1;
+
             case HEK::BitmapFormat::BITMAP_FORMAT_BC7:
                 return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_BC7;
 
@@ -465,20 +582,20 @@ namespace Invader::BitmapEncode {
 
             case HEK::BitmapFormat::BITMAP_FORMAT_16_BIT:
                 return alpha_present ? (
-                        alpha_present == AlphaPresent::ALPHA_PRESENT_MULTI_BIT ? HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A4R4G4B4 : HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A1R5G5B5
+                        alpha_present == PixelAnalysis::ALPHA_PRESENT_MULTI_BIT ? HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A4R4G4B4 : HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A1R5G5B5
                     ) : HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_R5G6B5;
 
             case HEK::BitmapFormat::BITMAP_FORMAT_32_BIT:
                 return alpha_present ? HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8 : HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_X8R8G8B8;
 
             case HEK::BitmapFormat::BITMAP_FORMAT_MONOCHROME:
-                if(alpha_present == AlphaPresent::ALPHA_PRESENT_NONE) {
+                if(alpha_present == PixelAnalysis::ALPHA_PRESENT_NONE) {
                     return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_Y8;
                 }
-                else if(all_white) {
+                else if(analysis.all_white) {
                     return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8;
                 }
-                else if(luminosity_equals_alpha) {
+                else if(analysis.luminosity_equals_alpha) {
                     return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_AY8;
                 }
                 else {
@@ -486,13 +603,21 @@ namespace Invader::BitmapEncode {
                 }
 
             case HEK::BitmapFormat::BITMAP_FORMAT_ENUM_COUNT:
-            case HEK::BitmapFormat::BITMAP_FORMAT_DXT1:
-                std::terminate(); // we just checked
+                break;
         }
 
         std::terminate(); // this shouldn't be reached
     }
 
+    static HEK::BitmapDataFormat most_efficient_format(const std::byte *input_data, std::size_t pixel_count, HEK::BitmapFormat category) noexcept {
+        // No need to check anything here
+        if(category == HEK::BitmapFormat::BITMAP_FORMAT_DXT1) {
+            return HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_DXT1;
+        }
+
+        return most_efficient_format(analyze_pixels(input_data, pixel_count), category);
+    }
+
     std::size_t bitmap_data_size(std::size_t width, std::size_t height, std::size_t depth, std::size_t mipmap_count, HEK::BitmapDataFormat format, HEK::BitmapDataType type) noexcept {
         std::size_t size = 0;
         std::size_t bits_per_pixel = HEK::calculate_bits_per_pixel(format);
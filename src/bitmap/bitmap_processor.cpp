@@ -1,8 +1,47 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <invader/bitmap/bitmap_processor.hpp>
+#include <invader/thread_pool.hpp>
+#include <cmath>
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
 
 namespace Invader {
+    // Below this many rows per thread, splitting a bitmap across threads costs more than it saves
+    static constexpr std::uint32_t MIN_ROWS_PER_THREAD = 64;
+
+    // Bitmaps are processed independently of each other, so spread them across threads
+    template<typename T> static void for_each_bitmap(GeneratedBitmapData &generated_bitmap, const T &function) {
+        auto &bitmaps = generated_bitmap.bitmaps;
+        ThreadPool::shared().parallel_for(bitmaps.size(), [&bitmaps, &function](std::size_t b) {
+            function(bitmaps[b]);
+        });
+    }
+
+    // Average each 2x2 block of the last mipmap into one pixel, keeping the top-left pixel's channels for any that aren't interpolated
+    static void downsample_2x2(const Pixel *last_mipmap_data, Pixel *this_mipmap_data, std::uint32_t mipmap_width, std::uint32_t mipmap_height, std::uint32_t last_mipmap_width, bool interpolate_color, bool interpolate_alpha) {
+        // Work on the channels as bytes so the loops can be vectorized
+        std::uint8_t channel_mask[4];
+        channel_mask[offsetof(Pixel, blue)] = interpolate_color ? 0xFF : 0x00;
+        channel_mask[offsetof(Pixel, green)] = interpolate_color ? 0xFF : 0x00;
+        channel_mask[offsetof(Pixel, red)] = interpolate_color ? 0xFF : 0x00;
+        channel_mask[offsetof(Pixel, alpha)] = interpolate_alpha ? 0xFF : 0x00;
+
+        for(std::uint32_t y = 0; y < mipmap_height; y++) {
+            const auto *top = reinterpret_cast<const std::uint8_t *>(last_mipmap_data + y * 2 * last_mipmap_width);
+            const auto *bottom = top + last_mipmap_width * sizeof(Pixel);
+            auto *output = reinterpret_cast<std::uint8_t *>(this_mipmap_data + y * mipmap_width);
+
+            for(std::uint32_t x = 0; x < mipmap_width; x++, top += 2 * sizeof(Pixel), bottom += 2 * sizeof(Pixel), output += sizeof(Pixel)) {
+                for(std::size_t c = 0; c < sizeof(Pixel); c++) {
+                    auto average = static_cast<std::uint8_t>((static_cast<std::uint16_t>(top[c]) + top[c + sizeof(Pixel)] + bottom[c] + bottom[c + sizeof(Pixel)]) / 4);
+                    output[c] = (average & channel_mask[c]) | (top[c] & ~channel_mask[c]);
+                }
+            }
+        }
+    }
+
     void BitmapProcessor::process_bitmap_data(
         GeneratedBitmapData &generated_bitmap,
         BitmapType type,
@@ -196,68 +235,67 @@ namespace Invader {
             bump_height = 0.5F;
         }
 
-        for(auto &bitmap : generated_bitmap.bitmaps) {
-            std::vector<Pixel> bitmap_pixels_copy = bitmap.pixels;
-
-            auto largest_dimension = bitmap.width > bitmap.height ? bitmap.height : bitmap.width;
-            float bump_scale = 1.5F / (largest_dimension / 256.0F);
-
-            for(std::uint32_t y = 0; y < bitmap.height; y++) {
-                for(std::uint32_t x = 0; x < bitmap.width; x++) {
-                    // from https://stackoverflow.com/a/2368794
-
-                    #define CLAMP_SUBTRACT(a,b) (b > a ? 0 : (a - b))
-                    #define CLAMP_ADD(a,b,max) (a + b > (max - 1) ? (max - 1) : (a + b))
-
-                    // Get the surrounding pixels' positions
-                    std::uint32_t down = CLAMP_SUBTRACT(y,1);
-                    std::uint32_t up = CLAMP_ADD(y,1,bitmap.height);
-                    std::uint32_t right = CLAMP_SUBTRACT(x,1);
-                    std::uint32_t left = CLAMP_ADD(x,1,bitmap.width);
-
-                    #define GET_COPY_PIXELS_INTENSITY(x,y) (static_cast<float>(bitmap_pixels_copy[x + y * bitmap.width].convert_to_y8() / 255.0F))
-
-                    // Get all of our pixels
-                    float left_up_pixel = GET_COPY_PIXELS_INTENSITY(left,up);
-                    float up_pixel = GET_COPY_PIXELS_INTENSITY(x,up);
-                    float right_up_pixel = GET_COPY_PIXELS_INTENSITY(right,up);
-
-                    float left_pixel = GET_COPY_PIXELS_INTENSITY(left,y);
-                    //float center_pixel = GET_COPY_PIXELS_INTENSITY(x,y);
-                    float right_pixel = GET_COPY_PIXELS_INTENSITY(right,y);
-
-                    float left_down_pixel = GET_COPY_PIXELS_INTENSITY(left,down);
-                    float down_pixel = GET_COPY_PIXELS_INTENSITY(x,down);
-                    float right_down_pixel = GET_COPY_PIXELS_INTENSITY(right,down);
-
-                    #undef GET_COPY_PIXELS_INTENSITY
-
-                    auto &mut_pixel = bitmap.pixels[x + y * (bitmap.width)];
+        for_each_bitmap(generated_bitmap, [&bump_height](GeneratedBitmapDataBitmap &bitmap) {
+            std::uint32_t width = bitmap.width;
+            std::uint32_t height = bitmap.height;
+            if(width == 0 || height == 0) {
+                return;
+            }
 
-                    float x_intensity = (right_up_pixel + 2.0F * right_pixel + right_down_pixel) - (left_up_pixel + 2.0F * left_pixel + left_down_pixel);
-                    float y_intensity = (left_down_pixel + 2.0F * down_pixel + right_down_pixel) - (left_up_pixel + 2.0F * up_pixel + right_up_pixel);
-                    float z_intensity = bump_scale / (bump_height / 0.02F);
-                    HEK::Vector3D<HEK::NativeEndian> v;
-                    v.i = x_intensity;
-                    v.j = y_intensity;
-                    v.k = z_intensity;
-                    v = v.normalize();
+            // Convert to intensity once up front rather than for each of the eight neighbors of every pixel
+            std::vector<float> heights(static_cast<std::size_t>(width) * height);
+            for(std::size_t i = 0; i < heights.size(); i++) {
+                heights[i] = static_cast<float>(bitmap.pixels[i].convert_to_y8() / 255.0F);
+            }
 
-                    mut_pixel.red = static_cast<std::uint8_t>((v.i + 1.0F) / 2.0F * 255);
-                    mut_pixel.green = static_cast<std::uint8_t>((v.j + 1.0F) / 2.0F * 255);
-                    mut_pixel.blue = static_cast<std::uint8_t>((v.k + 1.0F) / 2.0F * 255);
+            auto largest_dimension = width > height ? height : width;
+            float bump_scale = 1.5F / (largest_dimension / 256.0F);
+            float z_intensity = bump_scale / (bump_height / 0.02F);
+
+            auto process_row = [&bitmap, &heights, &width, &height, &z_intensity](std::uint32_t y) {
+                // from https://stackoverflow.com/a/2368794
+
+                // Get the surrounding rows (clamped to the edges)
+                const float *down_row = heights.data() + static_cast<std::size_t>(y == 0 ? 0 : y - 1) * width;
+                const float *row = heights.data() + static_cast<std::size_t>(y) * width;
+                const float *up_row = heights.data() + static_cast<std::size_t>(y + 1 >= height ? height - 1 : y + 1) * width;
+                auto *pixels = bitmap.pixels.data() + static_cast<std::size_t>(y) * width;
+
+                auto process_pixel = [&down_row, &row, &up_row, &pixels, &z_intensity](std::uint32_t x, std::uint32_t left, std::uint32_t right) {
+                    float x_intensity = (up_row[right] + 2.0F * row[right] + down_row[right]) - (up_row[left] + 2.0F * row[left] + down_row[left]);
+                    float y_intensity = (down_row[left] + 2.0F * down_row[x] + down_row[right]) - (up_row[left] + 2.0F * up_row[x] + up_row[right]);
+
+                    // z is always positive, so this can't be zero
+                    float m_distance = 1.0F / std::sqrt(x_intensity * x_intensity + y_intensity * y_intensity + z_intensity * z_intensity);
+
+                    auto &mut_pixel = pixels[x];
+                    mut_pixel.red = static_cast<std::uint8_t>((x_intensity * m_distance + 1.0F) / 2.0F * 255);
+                    mut_pixel.green = static_cast<std::uint8_t>((y_intensity * m_distance + 1.0F) / 2.0F * 255);
+                    mut_pixel.blue = static_cast<std::uint8_t>((z_intensity * m_distance + 1.0F) / 2.0F * 255);
+                };
+
+                // Only the edge columns need to be clamped; the ones in between are a straight run that can be vectorized
+                if(width == 1) {
+                    process_pixel(0, 0, 0);
+                    return;
                 }
-            }
-        }
+                process_pixel(0, 1, 0);
+                for(std::uint32_t x = 1; x < width - 1; x++) {
+                    process_pixel(x, x + 1, x - 1);
+                }
+                process_pixel(width - 1, width - 1, width - 2);
+            };
+
+            ThreadPool::shared().parallel_for(height, process_row, height / MIN_ROWS_PER_THREAD);
+        });
     }
 
     void BitmapProcessor::generate_mipmaps(GeneratedBitmapData &generated_bitmap, std::int16_t mipmaps, BitmapMipmapScaleType mipmap_type, std::optional<float> mipmap_fade_factor, std::optional<float> sharpen, std::optional<float> blur, std::optional<float> alpha_bias, BitmapUsage usage) {
         auto mipmaps_unsigned = static_cast<std::uint32_t>(mipmaps);
         float fade = mipmap_fade_factor.value_or(0.0F);
         
-        bool warn_on_zero_alpha = false;
-
-        for(auto &bitmap : generated_bitmap.bitmaps) {
+        std::atomic<bool> warn_on_zero_alpha = false;
+        for_each_bitmap(generated_bitmap, [&](GeneratedBitmapDataBitmap &bitmap) {
             std::uint32_t mipmap_width = bitmap.width;
             std::uint32_t mipmap_height = bitmap.height;
             std::uint32_t max_mipmap_count = mipmap_width > mipmap_height ? HEK::log2_int(mipmap_width) : HEK::log2_int(mipmap_height);
@@ -279,7 +317,7 @@ namespace Invader {
                 bitmap.mipmaps.erase(mipmap_to_remove);
             }
 
-            // If we don't need to generate mipmaps, bail
+            // If we don't need to generate mipmaps for this bitmap, bail
             if(bitmap.mipmaps.size() == max_mipmap_count) {
                 return;
             }
@@ -300,43 +338,66 @@ namespace Invader {
                 std::vector<Pixel> unblurred(pixel_data, pixel_data + mipmap_width * mipmap_height);
 
                 std::uint32_t blur_size = (blur_pixels * 2);
+                std::uint32_t blur_area = blur_size * blur_size;
 
-                // Allocate a filter of the correct size
-                std::vector<Pixel *> pixel_filter(blur_size * blur_size);
-
-                for(std::int64_t y = 0; y < mipmap_height; y++) {
-                    for(std::int64_t x = 0; x < mipmap_width; x++) {
-                        // Generate the filter
-                        for(std::uint32_t yf = 0; yf < blur_size; yf++) {
-                            for(std::uint32_t xf = 0; xf < blur_size; xf++) {
-                                std::int64_t blur_x = static_cast<std::int64_t>(xf) - blur_pixels + x;
-                                std::int64_t blur_y = static_cast<std::int64_t>(yf) - blur_pixels + y;
+                // This is a box blur, so it can be done as two passes (horizontal, then vertical) of running sums with the same result as summing each box
+                struct ChannelSums {
+                    std::uint32_t red, green, blue;
+                };
+                std::vector<ChannelSums> horizontal_sums(static_cast<std::size_t>(mipmap_width) * mipmap_height);
 
-                                std::uint32_t pixel_x = (blur_x < 0) ? 0 : (blur_x >= mipmap_width) ? (mipmap_width - 1) : static_cast<std::uint32_t>(blur_x);
-                                std::uint32_t pixel_y = (blur_y < 0) ? 0 : (blur_y >= mipmap_height) ? (mipmap_height - 1) : static_cast<std::uint32_t>(blur_y);
+                auto clamp_coordinate = [&blur_pixels](std::int64_t position, std::uint32_t offset, std::uint32_t length) -> std::uint32_t {
+                    std::int64_t coordinate = position - blur_pixels + offset;
+                    return (coordinate < 0) ? 0 : (coordinate >= length) ? (length - 1) : static_cast<std::uint32_t>(coordinate);
+                };
 
-                                pixel_filter[xf + yf * blur_size] = unblurred.data() + pixel_x + pixel_y * mipmap_width;
-                            }
-                        }
+                for(std::uint32_t y = 0; y < mipmap_height; y++) {
+                    auto *row = unblurred.data() + y * mipmap_width;
+                    auto *row_sums = horizontal_sums.data() + y * mipmap_width;
+
+                    ChannelSums sum = {};
+                    for(std::uint32_t xf = 0; xf < blur_size; xf++) {
+                        auto &color = row[clamp_coordinate(0, xf, mipmap_width)];
+                        sum.red += color.red;
+                        sum.green += color.green;
+                        sum.blue += color.blue;
+                    }
 
-                        // Do it
-                        #define BLUR_CHANNEL(channel) { \
-                            std::uint32_t channel_value = 0; \
-                            for(auto *color : pixel_filter) { \
-                                channel_value += color->channel; \
-                            } \
-                            channel_value /= pixel_filter.size(); \
-                            if(channel_value > 0xFF) { \
-                                channel_value = 0xFF; \
-                            } \
-                            pixel_data[x + y * mipmap_width].channel = static_cast<std::uint8_t>(channel_value); \
-                        }
+                    for(std::uint32_t x = 0; x < mipmap_width; x++) {
+                        row_sums[x] = sum;
+
+                        // Slide the window to the right
+                        auto &leaving = row[clamp_coordinate(x, 0, mipmap_width)];
+                        auto &entering = row[clamp_coordinate(x, blur_size, mipmap_width)];
+                        sum.red += entering.red - leaving.red;
+                        sum.green += entering.green - leaving.green;
+                        sum.blue += entering.blue - leaving.blue;
+                    }
+                }
 
-                        BLUR_CHANNEL(red);
-                        BLUR_CHANNEL(green);
-                        BLUR_CHANNEL(blue);
+                for(std::uint32_t x = 0; x < mipmap_width; x++) {
+                    ChannelSums sum = {};
+                    for(std::uint32_t yf = 0; yf < blur_size; yf++) {
+                        auto &row_sum = horizontal_sums[x + clamp_coordinate(0, yf, mipmap_height) * mipmap_width];
+                        sum.red += row_sum.red;
+                        sum.green += row_sum.green;
+                        sum.blue += row_sum.blue;
+                    }
 
-                        #undef BLUR_CHANNEL
+                    for(std::uint32_t y = 0; y < mipmap_height; y++) {
+                        auto &pixel = pixel_data[x + y * mipmap_width];
+
+                        // Sums of 8-bit values divided by the number of values can't exceed 0xFF
+                        pixel.red = static_cast<std::uint8_t>(sum.red / blur_area);
+                        pixel.green = static_cast<std::uint8_t>(sum.green / blur_area);
+                        pixel.blue = static_cast<std::uint8_t>(sum.blue / blur_area);
+
+                        // Slide the window down
+                        auto &leaving = horizontal_sums[x + clamp_coordinate(y, 0, mipmap_height) * mipmap_width];
+                        auto &entering = horizontal_sums[x + clamp_coordinate(y, blur_size, mipmap_height) * mipmap_width];
+                        sum.red += entering.red - leaving.red;
+                        sum.green += entering.green - leaving.green;
+                        sum.blue += entering.blue - leaving.blue;
                     }
                 }
             }
@@ -352,8 +413,8 @@ namespace Invader {
                     // Make a copy of the mipmap to work off of
                     std::vector<Pixel> unsharpened_pixels(pixel_data, pixel_data + mipmap_width * mipmap_height);
 
-                    // Go through each pixel and apply the sharpening filter
-                    for(std::uint32_t y = 0; y < mipmap_height; y++) {
+                    // Go through each pixel and apply the sharpening filter (each row only reads from the copy, so rows can be done at the same time)
+                    ThreadPool::shared().parallel_for(mipmap_height, [&](std::uint32_t y) {
                         for(std::uint32_t x = 0; x < mipmap_width; x++) {
                             auto &center = unsharpened_pixels[x + y * mipmap_width];
                             auto &left = (x == 0) ? center : unsharpened_pixels[x + y * mipmap_width - 1];
@@ -381,7 +442,7 @@ namespace Invader {
 
                             #undef APPLY_SHARPEN
                         }
-                    }
+                    }, mipmap_height / MIN_ROWS_PER_THREAD);
                 }
             };
             
@@ -406,84 +467,95 @@ namespace Invader {
                 
                 bool has_zero_alpha_and_alpha_blend_usage = usage == BitmapUsage::BITMAP_USAGE_ALPHA_BLEND;
 
-                // Combine each 2x2 block based on the given algorithm
-                for(std::uint32_t y = 0; y < mipmap_height; y++) {
-                    for(std::uint32_t x = 0; x < mipmap_width; x++) {
-                        auto &pixel = this_mipmap_data[x + y * mipmap_width];
+                // If both dimensions were halved and no pixels need to be discarded, every 2x2 block is just averaged, so do that without any per-pixel branching
+                if(mipmap_width < last_mipmap_width && mipmap_height < last_mipmap_height && usage != BitmapUsage::BITMAP_USAGE_ALPHA_BLEND) {
+                    bool interpolate_color = mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR || mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_NEAREST_ALPHA;
+                    bool interpolate_alpha = mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR && usage != BitmapUsage::BITMAP_USAGE_VECTOR_MAP;
+                    ThreadPool::shared().parallel_for(mipmap_height, [&](std::uint32_t y) {
+                        downsample_2x2(last_mipmap_data + y * 2 * last_mipmap_width, this_mipmap_data + y * mipmap_width, mipmap_width, 1, last_mipmap_width, interpolate_color, interpolate_alpha);
+                    }, mipmap_height / MIN_ROWS_PER_THREAD);
+                }
+
+                // Otherwise, combine each 2x2 block based on the given algorithm
+                else {
+                    for(std::uint32_t y = 0; y < mipmap_height; y++) {
+                        for(std::uint32_t x = 0; x < mipmap_width; x++) {
+                            auto &pixel = this_mipmap_data[x + y * mipmap_width];
                         
-                        // Start getting our pixels for mipmaps
-                        Pixel last_a, last_b, last_c, last_d;
-                        last_a = last_mipmap_data[x * 2 + y * 2 * last_mipmap_width];
+                            // Start getting our pixels for mipmaps
+                            Pixel last_a, last_b, last_c, last_d;
+                            last_a = last_mipmap_data[x * 2 + y * 2 * last_mipmap_width];
                         
-                        // If we went down a dimension, use the pixel from the last mipmap. Otherwise, just use last_a so we don't go out-of-bounds
-                        bool went_down_both_dimensions = true;
+                            // If we went down a dimension, use the pixel from the last mipmap. Otherwise, just use last_a so we don't go out-of-bounds
+                            bool went_down_both_dimensions = true;
                         
-                        // Right pixel
-                        if(mipmap_width < last_mipmap_width) {
-                            last_b = last_mipmap_data[x * 2 + 1 + y * 2 * last_mipmap_width];
-                        }
-                        else {
-                            last_b = last_a;
-                            went_down_both_dimensions = false;
-                        }
+                            // Right pixel
+                            if(mipmap_width < last_mipmap_width) {
+                                last_b = last_mipmap_data[x * 2 + 1 + y * 2 * last_mipmap_width];
+                            }
+                            else {
+                                last_b = last_a;
+                                went_down_both_dimensions = false;
+                            }
                         
-                        // Bottom pixel
-                        if(mipmap_height < last_mipmap_height) {
-                            last_c = last_mipmap_data[x * 2     + (y * 2 + 1) * last_mipmap_width];
-                        }
-                        else {
-                            last_c = last_a;
-                            went_down_both_dimensions = false;
-                        }
+                            // Bottom pixel
+                            if(mipmap_height < last_mipmap_height) {
+                                last_c = last_mipmap_data[x * 2     + (y * 2 + 1) * last_mipmap_width];
+                            }
+                            else {
+                                last_c = last_a;
+                                went_down_both_dimensions = false;
+                            }
                         
-                        // Bottom-right pixel - this one's a little tricky
-                        if(went_down_both_dimensions) {
-                            last_d = last_mipmap_data[x * 2 + 1 + (y * 2 + 1) * last_mipmap_width];
-                        }
-                        else if(mipmap_height < last_mipmap_height) {
-                            last_d = last_c;
-                        }
-                        else if(mipmap_width < last_mipmap_width) {
-                            last_d = last_b;
-                        }
-                        else {
-                            last_d = last_a;
-                        }
+                            // Bottom-right pixel - this one's a little tricky
+                            if(went_down_both_dimensions) {
+                                last_d = last_mipmap_data[x * 2 + 1 + (y * 2 + 1) * last_mipmap_width];
+                            }
+                            else if(mipmap_height < last_mipmap_height) {
+                                last_d = last_c;
+                            }
+                            else if(mipmap_width < last_mipmap_width) {
+                                last_d = last_b;
+                            }
+                            else {
+                                last_d = last_a;
+                            }
                         
-                        int pixel_count = 4;
-                        pixel = last_a;
+                            int pixel_count = 4;
+                            pixel = last_a;
 
-                        #define INTERPOLATE_CHANNEL(channel) pixel.channel = static_cast<std::uint8_t>((static_cast<std::uint16_t>(last_a.channel) + static_cast<std::uint16_t>(last_b.channel) + static_cast<std::uint16_t>(last_c.channel) + static_cast<std::uint16_t>(last_d.channel)) / 4)
-                        #define ZERO_OUT_IF_NO_ALPHA(what) if(what.alpha == 0) { what = {}; pixel_count--; } else { has_zero_alpha_and_alpha_blend_usage = false; }
-                        
-                        // If alpha blend, discard anything with 0 alpha
-                        if(usage == BitmapUsage::BITMAP_USAGE_ALPHA_BLEND) {
-                            ZERO_OUT_IF_NO_ALPHA(last_a);
-                            ZERO_OUT_IF_NO_ALPHA(last_b);
-                            ZERO_OUT_IF_NO_ALPHA(last_c);
-                            ZERO_OUT_IF_NO_ALPHA(last_d);
-                        }
+                            #define INTERPOLATE_CHANNEL(channel) pixel.channel = static_cast<std::uint8_t>((static_cast<std::uint16_t>(last_a.channel) + static_cast<std::uint16_t>(last_b.channel) + static_cast<std::uint16_t>(last_c.channel) + static_cast<std::uint16_t>(last_d.channel)) / 4)
+                            #define ZERO_OUT_IF_NO_ALPHA(what) if(what.alpha == 0) { what = {}; pixel_count--; } else { has_zero_alpha_and_alpha_blend_usage = false; }
                         
-                        if(pixel_count > 0) {
-                            // Interpolate color?
-                            if(mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR || mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_NEAREST_ALPHA) {
-                                INTERPOLATE_CHANNEL(red);
-                                INTERPOLATE_CHANNEL(green);
-                                INTERPOLATE_CHANNEL(blue);
+                            // If alpha blend, discard anything with 0 alpha
+                            if(usage == BitmapUsage::BITMAP_USAGE_ALPHA_BLEND) {
+                                ZERO_OUT_IF_NO_ALPHA(last_a);
+                                ZERO_OUT_IF_NO_ALPHA(last_b);
+                                ZERO_OUT_IF_NO_ALPHA(last_c);
+                                ZERO_OUT_IF_NO_ALPHA(last_d);
                             }
+                        
+                            if(pixel_count > 0) {
+                                // Interpolate color?
+                                if(mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR || mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_NEAREST_ALPHA) {
+                                    INTERPOLATE_CHANNEL(red);
+                                    INTERPOLATE_CHANNEL(green);
+                                    INTERPOLATE_CHANNEL(blue);
+                                }
 
-                            // Interpolate alpha?
-                            if(mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR && usage != BitmapUsage::BITMAP_USAGE_VECTOR_MAP) {
-                                INTERPOLATE_CHANNEL(alpha);
+                                // Interpolate alpha?
+                                if(mipmap_type == BitmapMipmapScaleType::BITMAP_MIPMAP_SCALE_TYPE_LINEAR && usage != BitmapUsage::BITMAP_USAGE_VECTOR_MAP) {
+                                    INTERPOLATE_CHANNEL(alpha);
+                                }
+                            }
+                            else {
+                                // Delete if no pixels
+                                pixel = {};
                             }
-                        }
-                        else {
-                            // Delete if no pixels
-                            pixel = {};
-                        }
                         
-                        #undef ZERO_OUT_IF_NO_ALPHA
-                        #undef INTERPOLATE_CHANNEL
+                            #undef ZERO_OUT_IF_NO_ALPHA
+                            #undef INTERPOLATE_CHANNEL
+                        }
                     }
                 }
                 
@@ -497,7 +569,9 @@ namespace Invader {
                 mipmap_width = std::max(static_cast<std::size_t>(mipmap_width / 2), static_cast<std::size_t>(1));
                 last_mipmap_offset = this_mipmap_offset;
                 
-                warn_on_zero_alpha = warn_on_zero_alpha || has_zero_alpha_and_alpha_blend_usage;
+                if(has_zero_alpha_and_alpha_blend_usage) {
+                    warn_on_zero_alpha = true;
+                }
             }
 
             // Do fade-to-gray for each mipmap (TODO: CHECK HOW THIS WORKS WITH ALL BITMAP USAGES)
@@ -565,7 +639,7 @@ namespace Invader {
                     }
                 }
             }
-        }
+        });
         
         if(warn_on_zero_alpha) {
             eprintf_warn("Usage is alpha blend, and a bitmap has zero alpha; its mipmaps will be black.");
@@ -621,6 +695,7 @@ namespace Invader {
 
             std::uint32_t mipmap_width = BITMAP_WIDTH;
             std::uint32_t mipmap_height = BITMAP_HEIGHT;
+            std::size_t pixel_count = 0;
 
             for(std::uint32_t i = 0; i <= MIPMAP_COUNT; i++) {
                 // Calculate the mipmap size in pixels (6 faces x length^2)
@@ -629,19 +704,22 @@ namespace Invader {
                 // Add everything
                 if(i) {
                     auto &mipmap = new_bitmap.mipmaps.emplace_back();
-                    mipmap.first_pixel = new_bitmap.pixels.size();
+                    mipmap.first_pixel = pixel_count;
                     mipmap.pixel_count = mipmap_size;
                     mipmap.mipmap_height = mipmap_height;
                     mipmap.mipmap_width = mipmap_width;
                     mipmap.mipmap_depth = FACES;
                 }
 
-                new_bitmap.pixels.insert(new_bitmap.pixels.end(), mipmap_size, Pixel {});
+                pixel_count += mipmap_size;
 
                 mipmap_width /= 2;
                 mipmap_height /= 2;
             }
 
+            // Allocate every mipmap at once rather than growing the pixels for each one
+            new_bitmap.pixels.resize(pixel_count);
+
             // Go through each face
             for(std::size_t f = 0; f < FACES; f++) {
                 auto &bitmap = bitmaps[f];
@@ -684,6 +762,9 @@ namespace Invader {
                     std::copy(source_buffer, source_buffer + pixel_count, destination_buffer);
                 }
                 while(m.value() < MIPMAP_COUNT);
+
+                // Free the face now rather than holding onto every face until they're all copied
+                std::vector<Pixel>().swap(bitmap.pixels);
             }
         }
 
@@ -694,50 +775,50 @@ namespace Invader {
     void BitmapProcessor::merge_3d_texture_mipmaps(GeneratedBitmapData &generated_bitmap) {
         for(auto &bitmap : generated_bitmap.bitmaps) {
             std::uint32_t bitmaps_to_merge = 2;
-            std::uint32_t bitmap_pixel_count = bitmap.height * bitmap.width;
-            std::vector<Pixel> new_pixels(bitmap.pixels.data(), bitmap.pixels.data() + bitmap_pixel_count * bitmap.depth);
-            std::vector<GeneratedBitmapDataBitmapMipmap> new_mipmaps;
+            std::size_t new_pixel_count = static_cast<std::size_t>(bitmap.height) * bitmap.width * bitmap.depth;
+            std::size_t new_mipmap_count = 0;
+
+            // Each merged mipmap is written over the pixels in front of it. It's never bigger than the mipmap it comes from and
+            // each layer is written no further in than the first layer it's averaged from, so nothing is overwritten before it's read.
             for(auto &mipmap : bitmap.mipmaps) {
                 if(bitmaps_to_merge > bitmap.depth) {
                     break;
                 }
 
                 // Make the new mipmap metadata
-                auto &new_mipmap = new_mipmaps.emplace_back();
-                new_mipmap.first_pixel = new_pixels.size();
+                auto *old_pixels = bitmap.pixels.data() + mipmap.first_pixel;
                 std::size_t layer_size = mipmap.mipmap_height * mipmap.mipmap_width;
-                new_mipmap.mipmap_height = mipmap.mipmap_height;
-                new_mipmap.mipmap_width = mipmap.mipmap_width;
-                new_mipmap.mipmap_depth = mipmap.mipmap_depth / bitmaps_to_merge;
-                new_mipmap.pixel_count = static_cast<std::uint32_t>(layer_size * new_mipmap.mipmap_depth);
+                mipmap.first_pixel = static_cast<std::uint32_t>(new_pixel_count);
+                mipmap.mipmap_depth = mipmap.mipmap_depth / bitmaps_to_merge;
+                mipmap.pixel_count = static_cast<std::uint32_t>(layer_size * mipmap.mipmap_depth);
+                auto *new_pixel = bitmap.pixels.data() + mipmap.first_pixel;
 
                 // Go through each pixel and average
-                for(std::uint32_t d = 0; d < new_mipmap.mipmap_depth; d++) {
-                    for(std::uint32_t y = 0; y < new_mipmap.mipmap_height; y++) {
-                        for(std::uint32_t x = 0; x < new_mipmap.mipmap_width; x++) {
-                                std::size_t alpha = 0, red = 0, green = 0, blue = 0;
-                                for(std::uint32_t d_inner = d * bitmaps_to_merge; d_inner < (d + 1) * bitmaps_to_merge; d_inner++) {
-                                    auto &pixel = *(bitmap.pixels.data() + (x + y * new_mipmap.mipmap_height) + layer_size * d_inner + mipmap.first_pixel);
-                                    alpha += pixel.alpha;
-                                    red += pixel.red;
-                                    green += pixel.green;
-                                    blue += pixel.blue;
-                                }
-
-                                auto &new_pixel = new_pixels.emplace_back();
-                                new_pixel.alpha = static_cast<std::uint8_t>(alpha / bitmaps_to_merge);
-                                new_pixel.red = static_cast<std::uint8_t>(red / bitmaps_to_merge);
-                                new_pixel.green = static_cast<std::uint8_t>(green / bitmaps_to_merge);
-                                new_pixel.blue = static_cast<std::uint8_t>(blue / bitmaps_to_merge);
-                            }
+                for(std::uint32_t d = 0; d < mipmap.mipmap_depth; d++) {
+                    for(std::size_t p = 0; p < layer_size; p++, new_pixel++) {
+                        std::size_t alpha = 0, red = 0, green = 0, blue = 0;
+                        for(std::uint32_t d_inner = d * bitmaps_to_merge; d_inner < (d + 1) * bitmaps_to_merge; d_inner++) {
+                            auto &pixel = old_pixels[p + layer_size * d_inner];
+                            alpha += pixel.alpha;
+                            red += pixel.red;
+                            green += pixel.green;
+                            blue += pixel.blue;
                         }
+
+                        new_pixel->alpha = static_cast<std::uint8_t>(alpha / bitmaps_to_merge);
+                        new_pixel->red = static_cast<std::uint8_t>(red / bitmaps_to_merge);
+                        new_pixel->green = static_cast<std::uint8_t>(green / bitmaps_to_merge);
+                        new_pixel->blue = static_cast<std::uint8_t>(blue / bitmaps_to_merge);
+                    }
                 }
 
+                new_pixel_count += mipmap.pixel_count;
+                new_mipmap_count++;
                 bitmaps_to_merge *= 2;
             }
 
-            bitmap.mipmaps = new_mipmaps;
-            bitmap.pixels = new_pixels;
+            bitmap.mipmaps.resize(new_mipmap_count);
+            bitmap.pixels.resize(new_pixel_count);
         }
     }
 }
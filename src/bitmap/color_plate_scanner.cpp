@@ -3,6 +3,7 @@
 #include <cassert>
 #include <optional>
 #include <algorithm>
+#include <vector>
 
 #include <invader/hek/data_type.hpp>
 #include <invader/bitmap/color_plate_scanner.hpp>
@@ -201,172 +202,175 @@ namespace Invader {
             // This is used for the registration point
             const double MID_Y = (static_cast<double>(Y_START) + static_cast<double>(Y_END)) / 2.0;
 
-            // Go through each pixel
-            for(std::uint32_t x = 0; x < X_END; x++) {
-                for(std::uint32_t y = Y_START; y < Y_END; y++) {
-                    auto &pixel = GET_PIXEL(x,y);
+            // Find which rows each column has pixels in, going through the sequence one row at a time
+            struct ColumnBounds {
+                // Anything that's not a cyan/magenta/blue pixel
+                bool has_pixels = false;
+                std::uint32_t min_y;
+                std::uint32_t max_y;
+
+                // Anything that's not a magenta/blue pixel
+                bool has_virtual_pixels = false;
+                std::uint32_t virtual_min_y;
+                std::uint32_t virtual_max_y;
+            };
+            std::vector<ColumnBounds> columns(X_END);
+
+            for(std::uint32_t y = Y_START; y < Y_END; y++) {
+                const auto *row = pixels + static_cast<std::size_t>(y) * width;
+                for(std::uint32_t x = 0; x < X_END; x++) {
+                    auto &pixel = row[x];
+                    auto &column = columns[x];
 
-                    // Ignore? Okay.
                     if(this->is_transparency_color(pixel) || this->is_sequence_divider_color(pixel)) {
                         continue;
                     }
 
-                    // Begin.
-                    std::optional<std::uint32_t> min_x;
-                    std::optional<std::uint32_t> max_x;
-                    std::optional<std::uint32_t> min_y;
-                    std::optional<std::uint32_t> max_y;
-
-                    std::optional<std::uint32_t> virtual_min_x;
-                    std::optional<std::uint32_t> virtual_max_x;
-                    std::optional<std::uint32_t> virtual_min_y;
-                    std::optional<std::uint32_t> virtual_max_y;
-
-                    // Find the minimum x, y, max x, and max y stuff
-                    for(std::uint32_t xb = x; xb < X_END; xb++) {
-                        // Set this to false if we got something this column
-                        bool ignored_this_x = true;
-
-                        for(std::uint32_t yb = Y_START; yb < Y_END; yb++) {
-                            auto &pixel = GET_PIXEL(xb, yb);
-
-                            // This is for anything that's not a cyan/magenta/blue pixel
-                            if(!this->is_ignored(pixel)) {
-                                if(min_x.has_value()) {
-                                    if(min_x.value() > xb) {
-                                        min_x = xb;
-                                    }
-                                    if(min_y.value() > yb) {
-                                        min_y = yb;
-                                    }
-                                    if(max_x.value() < xb) {
-                                        max_x = xb;
-                                    }
-                                    if(max_y.value() < yb) {
-                                        max_y = yb;
-                                    }
-                                }
-                                else {
-                                    min_x = xb;
-                                    min_y = yb;
-                                    max_x = xb;
-                                    max_y = yb;
-                                }
-                            }
-
-                            // Anything that's not a magenta/blue pixel then
-                            if(!this->is_transparency_color(pixel) && !this->is_sequence_divider_color(pixel)) {
-                                ignored_this_x = false;
-
-                                if(virtual_min_x.has_value()) {
-                                    if(virtual_min_x.value() > xb) {
-                                        virtual_min_x = xb;
-                                    }
-                                    if(virtual_min_y.value() > yb) {
-                                        virtual_min_y = yb;
-                                    }
-                                    if(virtual_max_x.value() < xb) {
-                                        virtual_max_x = xb;
-                                    }
-                                    if(virtual_max_y.value() < yb) {
-                                        virtual_max_y = yb;
-                                    }
-                                }
-                                else {
-                                    virtual_min_x = xb;
-                                    virtual_min_y = yb;
-                                    virtual_max_x = xb;
-                                    virtual_max_y = yb;
-                                }
-                            }
-                        }
-
-                        if(ignored_this_x) {
-                            break;
-                        }
+                    if(!column.has_virtual_pixels) {
+                        column.has_virtual_pixels = true;
+                        column.virtual_min_y = y;
                     }
+                    column.virtual_max_y = y;
 
-                    // If we never got a minimum x, then continue on
-                    if(!min_x.has_value()) {
-                        continue;
+                    if(!this->is_spacing_color(pixel)) {
+                        if(!column.has_pixels) {
+                            column.has_pixels = true;
+                            column.min_y = y;
+                        }
+                        column.max_y = y;
                     }
+                }
+            }
 
-                    // Get the width and height
-                    std::uint32_t bitmap_width = max_x.value() - min_x.value() + 1;
-                    std::uint32_t bitmap_height = max_y.value() - min_y.value() + 1;
+            // Go through each column
+            for(std::uint32_t x = 0; x < X_END; x++) {
+                // Ignore? Okay.
+                if(!columns[x].has_virtual_pixels) {
+                    continue;
+                }
 
-                    // If we require power-of-two, check
-                    if(power_of_two) {
-                        if(!HEK::is_power_of_two(bitmap_width)) {
-                            eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
-                            throw InvalidInputBitmapException();
+                // Begin.
+                std::optional<std::uint32_t> min_x;
+                std::optional<std::uint32_t> max_x;
+                std::optional<std::uint32_t> min_y;
+                std::optional<std::uint32_t> max_y;
+
+                std::optional<std::uint32_t> virtual_min_x;
+                std::optional<std::uint32_t> virtual_max_x;
+                std::optional<std::uint32_t> virtual_min_y;
+                std::optional<std::uint32_t> virtual_max_y;
+
+                // Find the minimum x, y, max x, and max y stuff, stopping at the first column with nothing in it
+                for(std::uint32_t xb = x; xb < X_END && columns[xb].has_virtual_pixels; xb++) {
+                    auto &column = columns[xb];
+
+                    if(column.has_pixels) {
+                        if(min_x.has_value()) {
+                            max_x = xb;
+                            min_y = std::min(*min_y, column.min_y);
+                            max_y = std::max(*max_y, column.max_y);
                         }
-                        if(!HEK::is_power_of_two(bitmap_height)) {
-                            eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
-                            throw InvalidInputBitmapException();
+                        else {
+                            min_x = xb;
+                            max_x = xb;
+                            min_y = column.min_y;
+                            max_y = column.max_y;
                         }
                     }
 
-                    // Add the bitmap
-                    auto &bitmap = generated_bitmap.bitmaps.emplace_back();
-                    bitmap.width = bitmap_width;
-                    bitmap.height = bitmap_height;
-                    bitmap.color_plate_x = min_x.value();
-                    bitmap.color_plate_y = min_y.value();
-                    
-                    assert(min_x.has_value());
-                    assert(min_y.has_value());
-                    assert(virtual_min_x.has_value());
-                    assert(virtual_min_y.has_value());
-                    
-                    assert(max_x.has_value());
-                    assert(max_y.has_value());
-                    assert(virtual_max_x.has_value());
-                    assert(virtual_max_y.has_value());
-                    
-                    auto min_x_f = static_cast<double>(*min_x);
-                    auto min_y_f = static_cast<double>(*min_y);
-                    auto virtual_min_x_f = static_cast<double>(*virtual_min_x);
-                    auto virtual_min_y_f = static_cast<double>(*virtual_min_y);
-                    
-                    //auto max_x_f = static_cast<double>(*max_x);
-                    //auto max_y_f = static_cast<double>(*max_y);
-                    auto virtual_max_x_f = static_cast<double>(*virtual_max_x);
-                    auto virtual_max_y_f = static_cast<double>(*virtual_max_y);
+                    if(virtual_min_x.has_value()) {
+                        virtual_max_x = xb;
+                        virtual_min_y = std::min(*virtual_min_y, column.virtual_min_y);
+                        virtual_max_y = std::max(*virtual_max_y, column.virtual_max_y);
+                    }
+                    else {
+                        virtual_min_x = xb;
+                        virtual_max_x = xb;
+                        virtual_min_y = column.virtual_min_y;
+                        virtual_max_y = column.virtual_max_y;
+                    }
+                }
 
-                    // Calculate registration point.
-                    const double MID_X = (virtual_max_x_f + virtual_min_x_f) / 2.0;
+                // If we never got a minimum x, then continue on
+                if(!min_x.has_value()) {
+                    continue;
+                }
 
-                    // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
-                    bitmap.registration_point_x = MID_X - min_x_f + 0.5;
+                // Get the width and height
+                std::uint32_t bitmap_width = max_x.value() - min_x.value() + 1;
+                std::uint32_t bitmap_height = max_y.value() - min_y.value() + 1;
 
-                    // The y point is the midpoint of the height of the entire sequence relative to the top (or if we have the reg point hack, relative to the top of the bitmap itself)
-                    if(!reg_point_hack) {
-                        bitmap.registration_point_y = MID_Y - min_y_f + 0.5;
+                // If we require power-of-two, check
+                if(power_of_two) {
+                    if(!HEK::is_power_of_two(bitmap_width)) {
+                        eprintf(ERROR_INVALID_BITMAP_WIDTH, bitmap_width);
+                        throw InvalidInputBitmapException();
                     }
-                    else {
-                        bitmap.registration_point_y = virtual_min_y_f - min_y_f + (virtual_max_y_f - virtual_min_y_f) / 2.0 + 0.5;
+                    if(!HEK::is_power_of_two(bitmap_height)) {
+                        eprintf(ERROR_INVALID_BITMAP_HEIGHT, bitmap_height);
+                        throw InvalidInputBitmapException();
                     }
+                }
 
-                    // Load the pixels
-                    for(std::uint32_t by = min_y.value(); by <= max_y.value(); by++) {
-                        for(std::uint32_t bx = min_x.value(); bx <= max_x.value(); bx++) {
-                            auto &pixel = GET_PIXEL(bx, by);
-                            if(this->is_ignored(pixel)) {
-                                bitmap.pixels.push_back(Pixel {});
-                            }
-                            else {
-                                bitmap.pixels.push_back(pixel);
-                            }
+                // Add the bitmap
+                auto &bitmap = generated_bitmap.bitmaps.emplace_back();
+                bitmap.width = bitmap_width;
+                bitmap.height = bitmap_height;
+                bitmap.color_plate_x = min_x.value();
+                bitmap.color_plate_y = min_y.value();
+                
+                assert(min_x.has_value());
+                assert(min_y.has_value());
+                assert(virtual_min_x.has_value());
+                assert(virtual_min_y.has_value());
+                
+                assert(max_x.has_value());
+                assert(max_y.has_value());
+                assert(virtual_max_x.has_value());
+                assert(virtual_max_y.has_value());
+                
+                auto min_x_f = static_cast<double>(*min_x);
+                auto min_y_f = static_cast<double>(*min_y);
+                auto virtual_min_x_f = static_cast<double>(*virtual_min_x);
+                auto virtual_min_y_f = static_cast<double>(*virtual_min_y);
+                
+                //auto max_x_f = static_cast<double>(*max_x);
+                //auto max_y_f = static_cast<double>(*max_y);
+                auto virtual_max_x_f = static_cast<double>(*virtual_max_x);
+                auto virtual_max_y_f = static_cast<double>(*virtual_max_y);
+
+                // Calculate registration point.
+                const double MID_X = (virtual_max_x_f + virtual_min_x_f) / 2.0;
+
+                // The x point is the midpoint of the width of the bitmap and cyan stuff relative to the left
+                bitmap.registration_point_x = MID_X - min_x_f + 0.5;
+
+                // The y point is the midpoint of the height of the entire sequence relative to the top (or if we have the reg point hack, relative to the top of the bitmap itself)
+                if(!reg_point_hack) {
+                    bitmap.registration_point_y = MID_Y - min_y_f + 0.5;
+                }
+                else {
+                    bitmap.registration_point_y = virtual_min_y_f - min_y_f + (virtual_max_y_f - virtual_min_y_f) / 2.0 + 0.5;
+                }
+
+                // Load the pixels
+                bitmap.pixels.reserve(static_cast<std::size_t>(bitmap_width) * bitmap_height);
+                for(std::uint32_t by = min_y.value(); by <= max_y.value(); by++) {
+                    for(std::uint32_t bx = min_x.value(); bx <= max_x.value(); bx++) {
+                        auto &pixel = GET_PIXEL(bx, by);
+                        if(this->is_ignored(pixel)) {
+                            bitmap.pixels.push_back(Pixel {});
+                        }
+                        else {
+                            bitmap.pixels.push_back(pixel);
                         }
                     }
+                }
 
-                    sequence.bitmap_count++;
+                sequence.bitmap_count++;
 
-                    // Set it to the max value. Add 1 since sprites can't possibly be adjacent to each other. Then, the for loop will add 1 again to get to the minimum possible x value.
-                    x = virtual_max_x.value() + 1;
-                    break;
-                }
+                // Set it to the max value. Add 1 since sprites can't possibly be adjacent to each other. Then, the for loop will add 1 again to get to the minimum possible x value.
+                x = virtual_max_x.value() + 1;
             }
         }
     }
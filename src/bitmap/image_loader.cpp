@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <atomic>
 #include <tiffio.h>
 #include "image_loader.hpp"
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include "stb/stb_image.h"
 
 namespace Invader {
@@ -28,16 +31,17 @@ namespace Invader {
         auto *image_buffer = stbi_load(path, &x, &y, &channels, 4);
         if(!image_buffer) {
             eprintf_error("Failed to load %s. Error was: %s", path, stbi_failure_reason());
-            exit(EXIT_FAILURE);
+            throw std::exception();
         }
 
         // Get the width and height
         image_width = static_cast<std::uint32_t>(x);
         image_height = static_cast<std::uint32_t>(y);
-        image_size = image_width * image_height * sizeof(Invader::Pixel);
+        std::size_t pixel_count = static_cast<std::size_t>(image_width) * image_height;
+        image_size = pixel_count * sizeof(Invader::Pixel);
 
         // Do the thing
-        auto return_value = rgba_to_pixel(reinterpret_cast<std::uint8_t *>(image_buffer), image_width * image_height);
+        auto return_value = rgba_to_pixel(reinterpret_cast<std::uint8_t *>(image_buffer), pixel_count);
 
         // Free the buffer
         stbi_image_free(image_buffer);
@@ -45,16 +49,8 @@ namespace Invader {
         return return_value;
     }
 
-    std::vector<Pixel> load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
-        TIFF *image_tiff = TIFFOpen(path, "r");
-        if(!image_tiff) {
-            eprintf_error("Cannot open %s", path);
-            exit(EXIT_FAILURE);
-        }
-        TIFFGetField(image_tiff, TIFFTAG_IMAGEWIDTH, &image_width);
-        TIFFGetField(image_tiff, TIFFTAG_IMAGELENGTH, &image_height);
-
-        // Force associated alpha if we have alpha so alpha doesn't get multiplied in TIFFReadRGBAImageOriented
+    // Stop libtiff from multiplying alpha into the color in the TIFFReadRGBA functions by calling it associated alpha
+    static void force_associated_alpha(TIFF *image_tiff) {
         std::uint16_t count;
         std::uint16_t *attributes;
         int defined = TIFFGetField(image_tiff, TIFFTAG_EXTRASAMPLES, &count, &attributes);
@@ -64,17 +60,107 @@ namespace Invader {
                 TIFFSetField(image_tiff, TIFFTAG_EXTRASAMPLES, 1, &new_value);
             }
         }
+    }
+
+    static Pixel tiff_rgba_to_pixel(std::uint32_t rgba) noexcept {
+        Pixel pixel;
+        pixel.red = static_cast<std::uint8_t>(TIFFGetR(rgba));
+        pixel.green = static_cast<std::uint8_t>(TIFFGetG(rgba));
+        pixel.blue = static_cast<std::uint8_t>(TIFFGetB(rgba));
+        pixel.alpha = static_cast<std::uint8_t>(TIFFGetA(rgba));
+        return pixel;
+    }
+
+    // Below this many strips per thread, opening the file again for each thread costs more than it saves
+    static constexpr std::size_t MIN_TIFF_STRIPS_PER_THREAD = 4;
+
+    // Read the strips of a TIFF straight into the image, with each thread reading its strips from its own handle since
+    // a handle can't be shared between threads. Each strip is compressed on its own, so they can be read in any order.
+    static bool read_tiff_strips(TIFF *image_tiff, const char *path, std::uint32_t image_width, std::uint32_t image_height, Pixel *image_pixels) {
+        std::uint16_t orientation = ORIENTATION_TOPLEFT;
+        std::uint32_t rows_per_strip = 0;
+        TIFFGetFieldDefaulted(image_tiff, TIFFTAG_ORIENTATION, &orientation);
+        TIFFGetFieldDefaulted(image_tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+
+        // TIFFReadRGBAStrip doesn't reorient the image, so leave anything unusual to TIFFReadRGBAImageOriented
+        if(TIFFIsTiled(image_tiff) || orientation != ORIENTATION_TOPLEFT || rows_per_strip == 0) {
+            return false;
+        }
+        rows_per_strip = std::min(rows_per_strip, image_height);
+        std::size_t strip_count = (static_cast<std::size_t>(image_height) + rows_per_strip - 1) / rows_per_strip;
+
+        std::atomic<std::size_t> next_strip = 0;
+        std::atomic<bool> failed = false;
+        auto read_strips = [&](TIFF *handle) {
+            std::vector<std::uint32_t> strip(static_cast<std::size_t>(image_width) * rows_per_strip);
+            for(std::size_t s; !failed && (s = next_strip++) < strip_count;) {
+                auto first_row = static_cast<std::uint32_t>(s * rows_per_strip);
+                if(!TIFFReadRGBAStrip(handle, first_row, strip.data())) {
+                    failed = true;
+                    break;
+                }
+
+                // Strips come out bottom-up
+                std::size_t row_count = std::min(rows_per_strip, image_height - first_row);
+                for(std::size_t r = 0; r < row_count; r++) {
+                    const auto *input = strip.data() + (row_count - 1 - r) * image_width;
+                    auto *output = image_pixels + (first_row + r) * image_width;
+                    for(std::size_t x = 0; x < image_width; x++) {
+                        output[x] = tiff_rgba_to_pixel(input[x]);
+                    }
+                }
+            }
+        };
+
+        // The first reader uses the handle that's already open
+        auto &pool = ThreadPool::shared();
+        std::size_t reader_count = std::max(std::min(pool.get_thread_count(), strip_count / MIN_TIFF_STRIPS_PER_THREAD), static_cast<std::size_t>(1));
+        pool.parallel_for(reader_count, [&read_strips, &failed, image_tiff, path](std::size_t r) {
+            if(r == 0) {
+                read_strips(image_tiff);
+                return;
+            }
+            TIFF *handle = TIFFOpen(path, "r");
+            if(!handle) {
+                failed = true;
+                return;
+            }
+            force_associated_alpha(handle);
+            read_strips(handle);
+            TIFFClose(handle);
+        }, reader_count);
+
+        return !failed;
+    }
+
+    std::vector<Pixel> load_tiff(const char *path, std::uint32_t &image_width, std::uint32_t &image_height, std::size_t &image_size) {
+        TIFF *image_tiff = TIFFOpen(path, "r");
+        if(!image_tiff) {
+            eprintf_error("Cannot open %s", path);
+            throw std::exception();
+        }
+        TIFFGetField(image_tiff, TIFFTAG_IMAGEWIDTH, &image_width);
+        TIFFGetField(image_tiff, TIFFTAG_IMAGELENGTH, &image_height);
+
+        // Force associated alpha if we have alpha so alpha doesn't get multiplied in TIFFReadRGBAImageOriented
+        force_associated_alpha(image_tiff);
 
         // Read it all
-        image_size = image_width * image_height * sizeof(Invader::Pixel);
-        auto image_pixels = std::vector<Invader::Pixel>(image_size);
+        std::size_t pixel_count = static_cast<std::size_t>(image_width) * image_height;
+        image_size = pixel_count * sizeof(Invader::Pixel);
+        auto image_pixels = std::vector<Invader::Pixel>(pixel_count);
+        if(read_tiff_strips(image_tiff, path, image_width, image_height, image_pixels.data())) {
+            TIFFClose(image_tiff);
+            return image_pixels;
+        }
+
         TIFFReadRGBAImageOriented(image_tiff, image_width, image_height, reinterpret_cast<std::uint32_t *>(image_pixels.data()), ORIENTATION_TOPLEFT);
 
         // Close the TIFF
         TIFFClose(image_tiff);
 
         // Swap red and blue channels
-        for(std::size_t i = 0; i < image_size / 4; i++) {
+        for(std::size_t i = 0; i < pixel_count; i++) {
             Invader::Pixel swapped = image_pixels[i];
             swapped.red = image_pixels[i].blue;
             swapped.blue = image_pixels[i].red;
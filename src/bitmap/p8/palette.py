@@ -53,6 +53,7 @@ for red in range(0,256):
 with open(sys.argv[2], "w") as cpp:
     cpp.write("// This value was auto-generated. Changes made to this file may get overwritten.\n")
     cpp.write("#include <cstdint>\n")
+    cpp.write("#include <cstddef>\n")
     cpp.write("namespace Invader {\n")
 
     cpp.write("    static constexpr std::uint8_t p8_map[] = {")
@@ -77,6 +78,12 @@ with open(sys.argv[2], "w") as cpp:
     cpp.write("        return p8_map[red * 256 + green];\n")
     cpp.write("    }\n")
 
+    cpp.write("    void rg_convert_row_to_p8(const std::uint8_t *bgra, std::uint8_t *p8, std::size_t count) {\n")
+    cpp.write("        for(std::size_t i = 0; i < count; i++, bgra += 4) {\n")
+    cpp.write("            p8[i] = rg_convert_to_p8(bgra[2], bgra[1], bgra[0], bgra[3]);\n")
+    cpp.write("        }\n")
+    cpp.write("    }\n")
+
     cpp.write("    void p8_convert_to_rgba(std::uint8_t p8, std::uint8_t &red, std::uint8_t &green, std::uint8_t &blue, std::uint8_t &alpha) {\n")
     cpp.write("        alpha = p8_colors[p8][0];\n")
     cpp.write("        red = p8_colors[p8][1];\n")
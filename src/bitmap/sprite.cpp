@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cassert>
+#include <algorithm>
 
 #include <invader/bitmap/bitmap_processor.hpp>
 #include <invader/hek/data_type.hpp>
+#include <invader/thread_pool.hpp>
 
 namespace Invader {
     struct SpriteSheet {
@@ -125,25 +127,37 @@ namespace Invader {
                 
                 auto &sprite = *this;
                 
-                auto search_row = [&x_end, &sprite]() {
-                    // Scan left to right
-                    for(sprite.x = 0; sprite.x <= x_end; sprite.x++) {
-                        bool overlap_fail = false;
-                        for(auto &s : sprite.sheet->sprites) {
-                            if(s.overlaps(sprite)) {
-                                overlap_fail = true;
-                                break;
-                            }
+                std::vector<std::pair<unsigned int, unsigned int>> taken_spans;
+                
+                auto search_row = [&x_end, &width, &height, &sprite, &taken_spans]() {
+                    // Get the horizontal spans of every sprite that shares any rows with us
+                    auto y_start = sprite.y;
+                    auto y_stop = sprite.y + height;
+                    taken_spans.clear();
+                    for(auto &s : sprite.sheet->sprites) {
+                        if(s.y < y_stop && s.y + s.effective_height() > y_start) {
+                            taken_spans.emplace_back(s.x, s.x + s.effective_width());
                         }
-                        
-                        // Success
-                        if(!overlap_fail) {
-                            return true;
+                    }
+                    std::sort(taken_spans.begin(), taken_spans.end());
+                    
+                    // Scan left to right, skipping to the end of any span we'd overlap
+                    unsigned int x = 0;
+                    for(auto &[span_start, span_end] : taken_spans) {
+                        if(span_start >= x + width) {
+                            break;
                         }
+                        x = std::max(x, span_end);
                     }
                     
                     // Fail
-                    return false;
+                    if(x > x_end) {
+                        return false;
+                    }
+                    
+                    // Success
+                    sprite.x = x;
+                    return true;
                 };
                 
                 // Try packing it nicely
@@ -443,32 +457,42 @@ namespace Invader {
             
             // If we have more than 1 sprite, brute force a smaller sprite sheet
             if(this->sprites.size() > 1 && !this->locked) {
-                while(this->max_length > 1) {
-                    // Copy the old values
-                    auto old_max_length = this->max_length;
-                    auto old_sprites = this->sprites;
-                    
-                    // Halve max length, clear sprites
-                    this->max_length >>= 1;
-                    this->sprites.clear();
+                // Each smaller length is tried independently since where sprites end up only depends on the order they're placed in, so try them all at once
+                std::vector<SpriteSheet> candidates;
+                candidates.reserve(sizeof(this->max_length) * 8);
+                for(auto length = this->max_length >> 1; length >= 1; length >>= 1) {
+                    auto &candidate = candidates.emplace_back(this->spacing, *this->bitmap_data, length);
+                    candidate.sprites.reserve(this->sprites.size());
+                }
+                
+                std::vector<char> candidate_fits(candidates.size(), 0);
+                auto try_candidate = [this, &candidates, &candidate_fits](std::size_t c) {
+                    auto &candidate = candidates[c];
                     
                     // Go through each sprite and see if we can re-add all of them again
-                    for(auto s : old_sprites) {
-                        // Fail - copy back in old values
+                    for(auto s : this->sprites) {
+                        s.sheet = &candidate;
                         if(!s.place_in_sheet()) {
-                            this->max_length = old_max_length;
-                            this->sprites = old_sprites;
-                            goto done_brute_forcing_sprites;
+                            return;
                         }
-                        
-                        // Success - added!
-                        this->sprites.emplace_back(s);
+                        candidate.sprites.emplace_back(s);
+                    }
+                    candidate_fits[c] = 1;
+                };
+                
+                ThreadPool::shared().parallel_for(candidates.size(), try_candidate);
+                
+                // Keep halving until a length doesn't fit
+                for(std::size_t c = 0; c < candidates.size() && candidate_fits[c]; c++) {
+                    this->max_length = candidates[c].max_length;
+                    this->sprites = std::move(candidates[c].sprites);
+                    for(auto &s : this->sprites) {
+                        s.sheet = this;
                     }
                 }
             }
             
-            // Bad
-            done_brute_forcing_sprites:
+            // Shrink the height too if we can
             if(allow_non_square_sprite_sheets) {
                 decltype(this->max_length) new_max_height = 0;
                 for(auto s : sprites) {
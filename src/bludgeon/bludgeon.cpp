@@ -5,13 +5,22 @@
 #include <filesystem>
 #include <invader/printf.hpp>
 #include <invader/version.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
 #include "../command_line_option.hpp"
 #include <invader/tag/parser/parser.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/thread_pool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <thread>
 #include <mutex>
+#include <unordered_set>
 
 #include "bludgeoner.hpp"
 
@@ -92,28 +101,169 @@ static BludgeonAction all_fixes[] = {
     { .name = "everything", .fix_bit = static_cast<std::uint64_t>(~0) }
 };
 
+// Content hashes of tags that passed every check, which can be kept between runs so unchanged tags don't need to be
+// parsed and checked again
+class TagPassCache {
+public:
+    // Increment this if the format of the cache changes or if checks are added or changed
+    static constexpr std::uint64_t VERSION = 1;
+    static constexpr char MAGIC[8] = { 'i', 'n', 'v', 'b', 'l', 'u', 'p', 'c' };
+
+    void load(const std::filesystem::path &path) {
+        auto data = File::open_file(path);
+        if(!data.has_value() || data->size() < sizeof(MAGIC) || std::memcmp(data->data(), MAGIC, sizeof(MAGIC)) != 0) {
+            return;
+        }
+
+        std::size_t offset = sizeof(MAGIC);
+        auto read_value = [&data, &offset](std::uint64_t &value) -> bool {
+            if(data->size() - offset < sizeof(value)) {
+                return false;
+            }
+            value = 0;
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                value |= static_cast<std::uint64_t>((*data)[offset++]) << (i * 8);
+            }
+            return true;
+        };
+
+        std::uint64_t version, count;
+        if(!read_value(version) || version != VERSION || !read_value(count)) {
+            return;
+        }
+
+        // Throw away the whole thing if anything is wrong with it
+        std::unordered_set<std::uint64_t> hashes;
+        for(std::uint64_t e = 0; e < count; e++) {
+            std::uint64_t hash;
+            if(!read_value(hash)) {
+                return;
+            }
+            hashes.insert(hash);
+        }
+
+        if(offset == data->size()) {
+            this->hashes = std::move(hashes);
+        }
+    }
+
+    bool save(const std::filesystem::path &path) const {
+        std::vector<std::byte> data(reinterpret_cast<const std::byte *>(MAGIC), reinterpret_cast<const std::byte *>(MAGIC) + sizeof(MAGIC));
+        auto write_value = [&data](std::uint64_t value) {
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+            }
+        };
+
+        write_value(VERSION);
+        write_value(this->hashes.size());
+        for(auto hash : this->hashes) {
+            write_value(hash);
+        }
+
+        return File::save_file(path, data);
+    }
+
+    bool contains(std::uint64_t hash) {
+        std::scoped_lock lock(this->mutex);
+        return this->hashes.contains(hash);
+    }
+
+    void add(std::uint64_t hash) {
+        std::scoped_lock lock(this->mutex);
+        this->hashes.insert(hash);
+    }
+
+private:
+    std::unordered_set<std::uint64_t> hashes;
+    std::mutex mutex;
+};
+
+// Writes bludgeoned tags on its own thread so workers can move on to the next tag while the last one is being saved
+class TagWriter {
+public:
+    TagWriter(std::size_t max_queued) : max_queued(max_queued), thread(&TagWriter::write_tags, this) {}
+
+    ~TagWriter() {
+        {
+            std::unique_lock lock(this->mutex);
+            this->done = true;
+        }
+        this->queue_changed.notify_all();
+        this->thread.join();
+    }
+
+    void queue_write(const std::filesystem::path &file_path, std::vector<std::byte> &&data) {
+        std::unique_lock lock(this->mutex);
+
+        // Don't let the queue get too far ahead of the disk
+        this->queue_changed.wait(lock, [this]() { return this->queue.size() < this->max_queued; });
+        this->queue.emplace_back(file_path, std::move(data));
+        lock.unlock();
+        this->queue_changed.notify_all();
+    }
+
+private:
+    std::size_t max_queued;
+    std::deque<std::pair<std::filesystem::path, std::vector<std::byte>>> queue;
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+    bool done = false;
+    std::thread thread;
+
+    void write_tags();
+};
+
 // Singleton the printf!
 static std::mutex bad_code_design_mutex;
 #define badly_designed_printf(function, ...) bad_code_design_mutex.lock(); \
                                              function(__VA_ARGS__); \
                                              bad_code_design_mutex.unlock();
 
-static int bludgeon_tag(const std::filesystem::path &file_path, const std::string &tag_path, std::uint64_t fixes, bool &bludgeoned) {
+void TagWriter::write_tags() {
+    while(true) {
+        std::unique_lock lock(this->mutex);
+        this->queue_changed.wait(lock, [this]() { return this->done || !this->queue.empty(); });
+        if(this->queue.empty()) {
+            return;
+        }
+        auto [file_path, data] = std::move(this->queue.front());
+        this->queue.pop_front();
+        lock.unlock();
+        this->queue_changed.notify_all();
+
+        if(!File::save_file(file_path, data)) {
+            badly_designed_printf(eprintf_error, "Error: Failed to write to %s.", file_path.string().c_str());
+        }
+    }
+}
+
+static int bludgeon_tag(const std::filesystem::path &file_path, const std::string &tag_path, std::uint64_t fixes, TagWriter &writer, TagPassCache *pass_cache, bool &bludgeoned, bool &skipped) {
     using namespace Bludgeoner;
     using namespace HEK;
     using namespace File;
 
     bludgeoned = false;
+    skipped = false;
 
     // Open the tag
-    auto tag = open_file(file_path);
+    auto tag = MemoryMappedFile::map_file(file_path);
     if(!tag.has_value()) {
         badly_designed_printf(eprintf_error, "Failed to open %s", file_path.string().c_str());
         return EXIT_FAILURE;
     }
 
+    // If it passed every check before, there's nothing to detect or fix
+    std::uint64_t hash = 0;
+    if(pass_cache != nullptr) {
+        hash = FNV1AHash::hash_bytes(tag->data(), tag->size());
+        if(pass_cache->contains(hash)) {
+            skipped = true;
+            return EXIT_SUCCESS;
+        }
+    }
+
     // Get the header
-    std::vector<std::byte> file_data;
     try {
         const auto *header = reinterpret_cast<const TagFileHeader *>(tag->data());
         HEK::TagFileHeader::validate_header(header, tag->size());
@@ -144,6 +294,10 @@ static int bludgeon_tag(const std::filesystem::path &file_path, const std::strin
 
         // No issues? OK
         if(!issues_present) {
+            // Only remember it if every check was done
+            if(pass_cache != nullptr && (fixes == 0 || fixes == static_cast<std::uint64_t>(~0))) {
+                pass_cache->add(hash);
+            }
             return EXIT_SUCCESS;
         }
 
@@ -154,12 +308,10 @@ static int bludgeon_tag(const std::filesystem::path &file_path, const std::strin
             return EXIT_SUCCESS;
         }
 
-        // Do it!
-        file_data = parsed_data->generate_hek_tag_data(header->tag_fourcc, true);
-        if(!File::save_file(file_path, file_data)) {
-            badly_designed_printf(eprintf_error, "Error: Failed to write to %s.", file_path.string().c_str());
-            return EXIT_FAILURE;
-        }
+        // Do it! Unmap the tag first, since it can't be overwritten while it's mapped on Windows.
+        auto tag_data = parsed_data->generate_hek_tag_data(header->tag_fourcc, true);
+        tag.reset();
+        writer.queue_write(file_path, std::move(tag_data));
 
         return EXIT_SUCCESS;
     }
@@ -187,8 +339,9 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH),
-        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for parallel bludgeoning when using --batch. Default: CPU thread count"),
-        CommandLineOption("type", 'T', 1, issues_list.c_str())
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("type", 'T', 1, issues_list.c_str()),
+        CommandLineOption("pass-cache", 'C', 1, "Remember which tags passed every check in the given file so they are skipped on later runs until they change.", "<file>")
     };
 
     static constexpr char DESCRIPTION[] = "Convinces tags to work with Invader.";
@@ -200,7 +353,8 @@ int main(int argc, char * const *argv) {
         bool fs_path = false;
         std::vector<std::string> search;
         std::vector<std::string> search_exclude;
-        std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+        std::optional<std::filesystem::path> pass_cache;
+        std::size_t max_threads = ThreadPool::get_shared_thread_count();
     } bludgeon_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<BludgeonOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, bludgeon_options, [](char opt, const std::vector<const char *> &arguments, auto &bludgeon_options) {
@@ -225,17 +379,12 @@ int main(int argc, char * const *argv) {
                 bludgeon_options.fs_path = true;
                 break;
 
+            case 'C':
+                bludgeon_options.pass_cache = arguments[0];
+                break;
+
             case 'j':
-                try {
-                    bludgeon_options.max_threads = std::stoi(arguments[0]);
-                    if(bludgeon_options.max_threads < 1) {
-                        throw std::exception();
-                    }
-                }
-                catch(std::exception &) {
-                    eprintf_error("Invalid number of threads %s\n", arguments[0]);
-                    std::exit(EXIT_FAILURE);
-                }
+                bludgeon_options.max_threads = CommandLineOption::parse_thread_count(arguments[0]);
                 break;
             case 'T':
                 for(auto &i : all_fixes) {
@@ -274,7 +423,6 @@ int main(int argc, char * const *argv) {
 
     auto &fixes = bludgeon_options.fixes;
 
-    std::size_t success = 0;
     std::vector<File::TagFile> all_tags;
 
     if(single_tag.has_value()) {
@@ -294,52 +442,70 @@ int main(int argc, char * const *argv) {
     else {
         auto all_virtual_tags = File::load_virtual_tag_folder(std::vector<std::filesystem::path>(&bludgeon_options.tags, &bludgeon_options.tags + 1));
         all_tags.reserve(all_virtual_tags.size());
+        File::PathMatcher search_matcher(bludgeon_options.search, bludgeon_options.search_exclude);
         for(auto &i : all_virtual_tags) {
-            if(File::path_matches(i.tag_path.c_str(), bludgeon_options.search, bludgeon_options.search_exclude)) {
+            if(search_matcher.matches(i.tag_path.c_str())) {
                 all_tags.emplace_back(std::move(i));
             }
         }
     }
 
-    std::mutex thread_mutex;
-    std::vector<std::thread> threads;
-    std::size_t tag_index = 0;
-    threads.reserve(bludgeon_options.max_threads);
-
-    auto bludgeon_worker = [](auto *all_tags, std::size_t *tag_index, std::mutex *thread_mutex, std::size_t *success, auto *fixes) {
-        while(true) {
-            thread_mutex->lock();
-            std::size_t this_index = *tag_index;
-            if(this_index == all_tags->size()) {
-                thread_mutex->unlock();
-                return;
-            }
-            (*tag_index)++;
-            thread_mutex->unlock();
-
-            // Bludgeon
-            bool bludgeoned;
-            auto &tag = all_tags->data()[this_index];
-            bludgeon_tag(tag.full_path, tag.tag_path, *fixes, bludgeoned);
-
-            // Increment
-            thread_mutex->lock();
-            (*success) += bludgeoned;
-            thread_mutex->unlock();
+    // Start with the largest tags so a big scenario doesn't end up being the last thing still running
+    if(all_tags.size() > 1) {
+        std::vector<std::pair<std::uintmax_t, std::size_t>> tag_sizes;
+        tag_sizes.reserve(all_tags.size());
+        for(std::size_t i = 0; i < all_tags.size(); i++) {
+            std::error_code ec;
+            auto size = std::filesystem::file_size(all_tags[i].full_path, ec);
+            tag_sizes.emplace_back(ec ? 0 : size, i);
         }
-    };
+        std::stable_sort(tag_sizes.begin(), tag_sizes.end(), [](auto &a, auto &b) { return a.first > b.first; });
+
+        std::vector<File::TagFile> sorted_tags;
+        sorted_tags.reserve(all_tags.size());
+        for(auto &[size, i] : tag_sizes) {
+            sorted_tags.emplace_back(std::move(all_tags[i]));
+        }
+        all_tags = std::move(sorted_tags);
+    }
+
+    std::optional<TagPassCache> pass_cache;
+    if(bludgeon_options.pass_cache.has_value()) {
+        pass_cache.emplace();
+        pass_cache->load(*bludgeon_options.pass_cache);
+    }
 
-    // Go through each tag
-    for(std::size_t i = 0; i < bludgeon_options.max_threads; i++) {
-        threads.emplace_back(bludgeon_worker, &all_tags, &tag_index, &thread_mutex, &success, &fixes);
+    std::size_t tag_count = all_tags.size();
+    std::size_t thread_count = std::min(bludgeon_options.max_threads, std::max(tag_count, static_cast<std::size_t>(1)));
+    std::atomic<std::size_t> bludgeoned_count = 0;
+    std::atomic<std::size_t> skipped_count = 0;
+
+    // Use the shared thread pool so any parallel work done while checking or fixing a tag uses the same threads
+    ThreadPool::set_shared_thread_count(bludgeon_options.max_threads);
+
+    {
+        TagWriter writer(thread_count * 2);
+
+        // Go through each tag (the writer finishes writing everything when it goes out of scope)
+        ThreadPool::shared().parallel_for(tag_count, [&all_tags, &bludgeoned_count, &skipped_count, &fixes, &writer, &pass_cache](std::size_t i) {
+            bool bludgeoned, skipped;
+            auto &tag = all_tags[i];
+            bludgeon_tag(tag.full_path, tag.tag_path, fixes, writer, pass_cache.has_value() ? &*pass_cache : nullptr, bludgeoned, skipped);
+            bludgeoned_count += bludgeoned;
+            skipped_count += skipped;
+        }, thread_count);
     }
 
-    // Wait for all threads to end
-    for(auto &i : threads) {
-        i.join();
+    if(pass_cache.has_value() && !pass_cache->save(*bludgeon_options.pass_cache)) {
+        eprintf_warn("Warning: Failed to save the pass cache to %s", bludgeon_options.pass_cache->string().c_str());
     }
 
-    oprintf("%s %zu out of %zu tag%s\n", fixes ? "Bludgeoned" : "Identified issues with", success, tag_index, tag_index == 1 ? "" : "s");
+    std::size_t success = bludgeoned_count;
+    oprintf("%s %zu out of %zu tag%s\n", fixes ? "Bludgeoned" : "Identified issues with", success, tag_count, tag_count == 1 ? "" : "s");
+    if(skipped_count > 0) {
+        std::size_t skipped = skipped_count;
+        oprintf("Skipped %zu unchanged tag%s that passed every check before\n", skipped, skipped == 1 ? "" : "s");
+    }
 
     return EXIT_SUCCESS;
 }
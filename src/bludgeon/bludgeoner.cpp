@@ -100,7 +100,12 @@ namespace Invader::Bludgeoner {
             // We need to decode this first
             case SoundFormat::SOUND_FORMAT_OGG_VORBIS: {
                 try {
-                    auto expected_buffer_size = Invader::SoundReader::ogg_vorbis_sample_count(samples.data(), samples.size()) * sizeof(std::uint16_t);
+                    // Count from the page headers first, only opening the stream with libvorbisfile if that doesn't match
+                    auto sample_count = Invader::SoundReader::ogg_vorbis_sample_count_from_pages(samples.data(), samples.size());
+                    if(!sample_count.has_value() || *sample_count * sizeof(std::uint16_t) != buffer_size) {
+                        sample_count = Invader::SoundReader::ogg_vorbis_sample_count(samples.data(), samples.size());
+                    }
+                    auto expected_buffer_size = *sample_count * sizeof(std::uint16_t);
                     if(expected_buffer_size != buffer_size) {
                         fucked = true;
                         if(fix) {
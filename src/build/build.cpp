@@ -1,10 +1,14 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <cstring>
 #include <filesystem>
+#include <map>
+#include <thread>
 
 #include <invader/build/build_workload.hpp>
 #include <invader/compress/compression.hpp>
@@ -14,6 +18,7 @@
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
 #include <invader/tag/index/index.hpp>
+#include <invader/thread_pool.hpp>
 
 static std::uint32_t read_str32(const char *err, const char *s) {
     // Make sure it starts with '0x'
@@ -41,6 +46,28 @@ static std::uint32_t read_str32(const char *err, const char *s) {
     return static_cast<std::uint32_t>(std::strtoul(s + 2, nullptr, 16));
 }
 
+// Size and modification time of every file in the given directories, for checking if anything changed
+using DirectorySnapshot = std::map<std::filesystem::path, std::pair<std::uintmax_t, std::filesystem::file_time_type>>;
+static DirectorySnapshot snapshot_directories(const std::vector<std::filesystem::path> &directories) {
+    DirectorySnapshot snapshot;
+    for(auto &directory : directories) {
+        // Files may be added or removed while we're looking, so skip anything we can't read rather than failing
+        std::error_code ec;
+        for(auto i = std::filesystem::recursive_directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, ec); !ec && i != std::filesystem::recursive_directory_iterator(); i.increment(ec)) {
+            std::error_code file_ec;
+            if(!i->is_regular_file(file_ec) || file_ec) {
+                continue;
+            }
+            auto size = i->file_size(file_ec);
+            auto time = i->last_write_time(file_ec);
+            if(!file_ec) {
+                snapshot.emplace(i->path(), std::pair(size, time));
+            }
+        }
+    }
+    return snapshot;
+}
+
 int main(int argc, const char **argv) {
     set_up_color_term();
 
@@ -66,8 +93,14 @@ int main(int argc, const char **argv) {
         bool use_filesystem_path = false;
         std::optional<std::string> rename_scenario;
         bool optimize_space = false;
+        std::optional<float> animation_trim_tolerance;
+        bool locality_layout = false;
+        bool spill_raw_data = false;
+        bool check_only = false;
+        bool watch = false;
         bool hide_pedantic_warnings = false;
         std::optional<int> compression_level;
+        bool compress = false;
         bool increased_file_size_limits = false;
         std::optional<std::string> build_version;
         bool check_custom_edition_resource_bounds = false;
@@ -76,6 +109,13 @@ int main(int argc, const char **argv) {
         bool do_not_auto_forge = false;
         bool use_anniverary_mode = false;
         bool use_tags_for_script_source = false;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
+        std::optional<std::filesystem::path> tag_cache;
+        std::optional<std::filesystem::path> remote_tag_cache;
+        std::optional<std::filesystem::path> stable_layout;
+        std::optional<std::filesystem::path> profile;
+        std::optional<std::filesystem::path> profile_trace;
+        std::optional<std::filesystem::path> profile_graph;
     } build_options;
 
     const CommandLineOption options[] = {
@@ -87,14 +127,27 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_GAME_ENGINE),
         CommandLineOption("quiet", 'q', 0, "Only output error messages."),
         CommandLineOption("script-source", 'S', 1, "Specify the script source data location. Can be \"data\" or \"tags\". Default: data", "<source>"),
+        CommandLineOption("watch", 'W', 0, "Keep running after building, rebuilding the map whenever anything in the tags or data directories changes. Tags that haven't changed are kept in memory so they don't have to be compiled again."),
         CommandLineOption("with-index", 'w', 1, "Use an index file for the tags, ensuring the map's tags are ordered in the same way.", "<file>"),
         CommandLineOption("output", 'o', 1, "Output to a specific file.", "<file>"),
         CommandLineOption("auto-forge", 'A', 0, "Ensure the map will be network compatible with the target engine's stock maps."),
         CommandLineOption("forge-crc", 'C', 1, "Forge the CRC32 value of the map after building it.", "<crc>"),
         CommandLineOption("rename-scenario", 'N', 1, "Rename the scenario.", "<name>"),
-        CommandLineOption("level", 'l', 1, "Set the compression level (Xbox maps only). Must be between 0 and 9. Default: 9", "<level>"),
-        CommandLineOption("optimize", 'O', 0, "Optimize tag space. This will drastically increase the amount of time required to build the cache file."),
+        CommandLineOption("level", 'l', 1, "Set the compression level (Xbox and compressed native maps only). Must be between 0 and 9. Default: 9", "<level>"),
+        CommandLineOption("compress", 'c', 0, "Compress the map into frames which can be decompressed in parallel when loaded. (native maps only)"),
+        CommandLineOption("optimize", 'O', 0, "Optimize tag space by merging duplicate structs. This will increase the amount of time required to build the cache file."),
+        CommandLineOption("trim-animations", 'M', 1, "Store each node rotation, transform, and scale in a base animation that never moves further than the tolerance from its first frame once instead of in every frame, and show how much smaller each animation gets. Use 0 to only trim what never moves at all.", "<tol>"),
+        CommandLineOption("locality-layout", 'L', 0, "Lay out each tag's data contiguously with frequently accessed tags such as globals, HUDs, and weapons at the front of tag space."),
+        CommandLineOption("stable-layout", 'Y', 1, "Keep each map's layout in a directory and keep each tag's data and bitmap/sound data where it was in the previous build whenever it still fits, so rebuilding a map only changes the parts of it that changed. This may use more space than a normal build.", "<dir>"),
+        CommandLineOption("spill-raw-data", 's', 0, "Move bitmap and sound data to a temporary file as tags are compiled instead of keeping it all in memory. This does not change the output."),
+        CommandLineOption("check", 'V', 0, "Only check that the map builds without errors, stopping once the tags are compiled and checked. No cache file is written."),
         CommandLineOption("hide-pedantic-warnings", 'H', 0, "Don't show minor warnings."),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("profile", 'p', 1, "Write the time and memory used by each build phase and the slowest tags to compile to a JSON file.", "<file>"),
+        CommandLineOption("profile-trace", 'x', 1, "Write the same timings to a file as Chrome trace events, viewable in chrome://tracing or Perfetto.", "<file>"),
+        CommandLineOption("profile-graph", 'G', 1, "Write the tag dependency graph with the time spent on each tag to a file, along with the critical path (the longest chain of tags that depend on each other) and how much faster tags could be compiled in parallel at best. The graph is written as DOT if the file ends in .dot or as JSON otherwise.", "<file>"),
+        CommandLineOption("tag-cache", 'k', 1, "Keep compiled tags and scripts in a directory so tags and scripts that haven't changed don't have to be compiled again on subsequent builds. This does not change the output.", "<dir>"),
+        CommandLineOption("remote-tag-cache", 'K', 1, "Share compiled tags with other machines through a directory such as a network drive. Tags compiled by any machine using the same version of Invader don't have to be compiled again by the others. This does not change the output.", "<dir>"),
         CommandLineOption("extend-file-limits", 'E', 0, "Extend file size limits to 2 GiB regardless of if the target engine will support the cache file."),
         CommandLineOption("build-string", 'B', 1, "Set the build string in the header.", "<ver>"),
         CommandLineOption("stock-resource-bounds", 'b', 0, "Only index tags if the tag's index is within stock Custom Edition's resource map bounds. (Custom Edition only)"),
@@ -104,10 +157,10 @@ int main(int argc, const char **argv) {
         CommandLineOption("resource-usage", 'r', 1, "Specify the behavior for using resource maps. Must be: none (don't use resource maps), check (check resource maps), always (always index tags in resource maps - Custom Edition only). Default: none", "<usage>")
     };
 
-    static constexpr char DESCRIPTION[] = "Build a cache file.";
-    static constexpr char USAGE[] = "[options] -g <target> <scenario>";
+    static constexpr char DESCRIPTION[] = "Build a cache file. If more than one scenario is given, each one is built, sharing compiled tags between them.";
+    static constexpr char USAGE[] = "[options] -g <target> <scenario...>";
 
-    auto remaining_arguments = CommandLineOption::parse_arguments<BuildOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, build_options, [](char opt, const auto &arguments, auto &build_options) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<BuildOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 65535, build_options, [](char opt, const auto &arguments, auto &build_options) {
         switch(opt) {
             case 'r':
                 if(std::strcmp(arguments[0], "none") == 0) {
@@ -171,6 +224,9 @@ int main(int argc, const char **argv) {
                     std::exit(EXIT_FAILURE);
                 }
                 break;
+            case 'c':
+                build_options.compress = true;
+                break;
 
             case 'S':
                 if(std::strcmp(arguments[0], "tags") == 0) {
@@ -216,6 +272,48 @@ int main(int argc, const char **argv) {
             case 'O':
                 build_options.optimize_space = true;
                 break;
+            case 'M': {
+                char *end = nullptr;
+                build_options.animation_trim_tolerance = std::strtof(arguments[0], &end);
+                if(*end != 0 || !(*build_options.animation_trim_tolerance >= 0.0F)) {
+                    eprintf_error("Invalid animation trim tolerance %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'L':
+                build_options.locality_layout = true;
+                break;
+            case 's':
+                build_options.spill_raw_data = true;
+                break;
+            case 'V':
+                build_options.check_only = true;
+                break;
+            case 'W':
+                build_options.watch = true;
+                break;
+            case 'j':
+                build_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
+            case 'k':
+                build_options.tag_cache = arguments[0];
+                break;
+            case 'K':
+                build_options.remote_tag_cache = arguments[0];
+                break;
+            case 'Y':
+                build_options.stable_layout = arguments[0];
+                break;
+            case 'p':
+                build_options.profile = arguments[0];
+                break;
+            case 'x':
+                build_options.profile_trace = arguments[0];
+                break;
+            case 'G':
+                build_options.profile_graph = arguments[0];
+                break;
             case 'H':
                 build_options.hide_pedantic_warnings = true;
                 break;
@@ -272,72 +370,96 @@ int main(int argc, const char **argv) {
         }
     });
 
-    std::string scenario;
+    // These only make sense for one map
+    bool multiple_scenarios = remaining_arguments.size() > 1;
+    if(multiple_scenarios) {
+        const char *single_map_option = nullptr;
+        if(build_options.output.has_value()) {
+            single_map_option = "--output";
+        }
+        else if(build_options.rename_scenario.has_value()) {
+            single_map_option = "--rename-scenario";
+        }
+        else if(!build_options.index.empty()) {
+            single_map_option = "--with-index";
+        }
+        else if(build_options.forged_crc.has_value()) {
+            single_map_option = "--forge-crc";
+        }
+        else if(build_options.profile.has_value()) {
+            single_map_option = "--profile";
+        }
+        else if(build_options.profile_trace.has_value()) {
+            single_map_option = "--profile-trace";
+        }
+        if(single_map_option) {
+            eprintf_error("%s can't be used when building more than one scenario", single_map_option);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(build_options.thread_count);
 
     // By default, just use tags
     if(build_options.tags.size() == 0) {
         build_options.tags.emplace_back("tags");
     }
 
-    if(build_options.use_filesystem_path) {
-        auto scenario_maybe = Invader::File::file_path_to_tag_path(remaining_arguments[0], build_options.tags);
-        if(scenario_maybe.has_value()) std::printf("%s\n", scenario_maybe->c_str());
-        if(scenario_maybe.has_value() && std::filesystem::exists(remaining_arguments[0])) {
-            scenario = std::filesystem::path(*scenario_maybe).replace_extension().string();
+    std::vector<std::string> scenarios;
+    for(auto *scenario_argument : remaining_arguments) {
+        if(build_options.use_filesystem_path) {
+            auto scenario_maybe = Invader::File::file_path_to_tag_path(scenario_argument, build_options.tags);
+            if(scenario_maybe.has_value()) std::printf("%s\n", scenario_maybe->c_str());
+            if(scenario_maybe.has_value() && std::filesystem::exists(scenario_argument)) {
+                scenarios.emplace_back(std::filesystem::path(*scenario_maybe).replace_extension().string());
+            }
+            else {
+                eprintf_error("Failed to find a valid tag %s in the tags directory", scenario_argument);
+                return EXIT_FAILURE;
+            }
         }
         else {
-            eprintf_error("Failed to find a valid tag %s in the tags directory", remaining_arguments[0]);
-            return EXIT_FAILURE;
+            scenarios.emplace_back(File::halo_path_to_preferred_path(scenario_argument));
         }
     }
-    else {
-        scenario = File::halo_path_to_preferred_path(remaining_arguments[0]);
-    }
 
     try {
         // Get the index
         std::optional<std::vector<File::TagFilePath>> with_index;
         if(build_options.index.size()) {
-            with_index = std::vector<File::TagFilePath>();
-
-            std::fstream index_file(build_options.index, std::ios_base::in);
-            std::string tag;
-
-            if(!index_file.is_open()) {
+            auto index_data = File::open_file(build_options.index);
+            if(!index_data.has_value()) {
                 eprintf_error("Failed to open index file %s", build_options.index.c_str());
                 return EXIT_FAILURE;
             }
 
-            while(std::getline(index_file, tag)) {
+            // Read the whole index at once and go through each line in place rather than copying each line out
+            std::string_view index_text(reinterpret_cast<const char *>(index_data->data()), index_data->size());
+            with_index = std::vector<File::TagFilePath>();
+            with_index->reserve(std::count(index_text.begin(), index_text.end(), '\n') + 1);
+
+            while(!index_text.empty()) {
+                auto line_end = index_text.find('\n');
+                auto tag = index_text.substr(0, line_end);
+                index_text.remove_prefix(line_end == std::string_view::npos ? index_text.size() : line_end + 1);
+
                 // Check if empty
                 if(tag.size() == 0) {
                     break;
                 }
 
                 // Get the extension
-                const char *extension = nullptr;
-                for(char &c : tag) {
-                    if(c == '.') {
-                        extension = &c + 1;
-                    }
-                }
-
-                if(!extension) {
-                    eprintf_error("Invalid index given. \"%s\" is missing an extension.", tag.c_str());
+                auto extension = tag.rfind('.');
+                if(extension == std::string_view::npos) {
+                    eprintf_error("Invalid index given. \"%s\" is missing an extension.", std::string(tag).c_str());
                     return EXIT_FAILURE;
                 }
 
-                auto substr = tag.substr(0, extension - tag.c_str() - 1);
-                const char *substr_c = substr.c_str();
-                std::vector<char> substr_v(substr_c, substr_c + substr.size() + 1);
-                File::preferred_path_to_halo_path_chars(substr_v.data());
-
-                // Lowercase everything
-                for(char &c : substr) {
-                    c = std::tolower(c);
-                }
-
-                with_index->emplace_back(substr_v.data(), tag_extension_to_fourcc(extension));
+                auto &index_tag = with_index->emplace_back();
+                index_tag.path = tag.substr(0, extension);
+                File::preferred_path_to_halo_path_chars(index_tag.path.data());
+                index_tag.fourcc = tag_extension_to_fourcc(std::string(tag.substr(extension + 1)).c_str());
             }
         }
 
@@ -353,9 +475,28 @@ int main(int argc, const char **argv) {
         parameters.use_tags_for_script_data = build_options.use_tags_for_script_source;
         parameters.tags_directories = build_options.tags;
         parameters.data_directory = build_options.data;
-        parameters.scenario = scenario;
         parameters.rename_scenario = build_options.rename_scenario;
         parameters.optimize_space = build_options.optimize_space;
+        parameters.animation_trim_tolerance = build_options.animation_trim_tolerance;
+        parameters.locality_layout = build_options.locality_layout;
+        parameters.spill_raw_data = build_options.spill_raw_data;
+        parameters.check_only = build_options.check_only;
+        parameters.thread_count = build_options.thread_count;
+        parameters.tag_cache_directory = build_options.tag_cache;
+        if(build_options.remote_tag_cache.has_value()) {
+            parameters.remote_tag_cache = std::make_shared<BuildWorkload::DirectoryRemoteTagCache>(*build_options.remote_tag_cache);
+        }
+        if(build_options.stable_layout.has_value()) {
+            std::error_code ec;
+            std::filesystem::create_directories(*build_options.stable_layout, ec);
+            if(!std::filesystem::is_directory(*build_options.stable_layout)) {
+                eprintf_error("Failed to create %s", build_options.stable_layout->string().c_str());
+                return EXIT_FAILURE;
+            }
+        }
+        parameters.profile_path = build_options.profile;
+        parameters.profile_trace_path = build_options.profile_trace;
+        parameters.profile_graph_path = build_options.profile_graph;
         parameters.forge_crc = build_options.forged_crc;
         parameters.index = with_index;
 
@@ -381,6 +522,13 @@ int main(int argc, const char **argv) {
         if(build_options.compression_level.has_value()) {
             parameters.details.build_compression_level = build_options.compression_level;
         }
+        if(build_options.compress) {
+            if(engine_info.engine != HEK::GameEngine::GAME_ENGINE_NATIVE) {
+                eprintf_error("Only native maps can be compressed with --compress");
+                return EXIT_FAILURE;
+            }
+            parameters.details.build_compress = true;
+        }
 
         // Do we need resource maps?
         bool require_resource_maps = engine_info.supports_external_resource_maps();
@@ -403,14 +551,13 @@ int main(int argc, const char **argv) {
             bool error = false;
 
             auto try_open = [](const std::filesystem::path &path) {
-                auto file = File::open_file(path);
-                if(!file.has_value()) {
+                try {
+                    return ResourceMapView::map_file(path);
+                }
+                catch(FailedToOpenFileException &) {
                     eprintf_error("Failed to open %s", path.string().c_str());
                     std::exit(EXIT_FAILURE);
                 }
-                try {
-                    return load_resource_map(file->data(), file->size());
-                }
                 catch(std::exception &e) {
                     eprintf_error("Failed to read %s: %s", path.string().c_str(), e.what());
                     std::exit(EXIT_FAILURE);
@@ -473,143 +620,225 @@ int main(int argc, const char **argv) {
             parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
         }
 
-        // Set the map name
-        std::string map_name;
-        if(build_options.rename_scenario) {
-            map_name = *build_options.rename_scenario;
-        }
-        else {
-            map_name = File::base_name(scenario.c_str());
-        }
+        // Build a map, returning false if it failed
+        auto build_map = [&build_options, &engine_info, &multiple_scenarios](const std::string &scenario, BuildWorkload::BuildParameters parameters) -> bool {
+            try {
+                parameters.scenario = scenario;
 
-        // CRC32 spoofing, indexing, etc.
-        if(build_options.auto_forge) {
-            if(!parameters.index.has_value()) {
-                switch(engine_info.engine) {
-                    case HEK::GameEngine::GAME_ENGINE_GEARBOX_RETAIL:
-                        parameters.index = retail_indices(map_name.c_str());
-                        break;
-                    case HEK::GameEngine::GAME_ENGINE_GEARBOX_CUSTOM_EDITION:
-                        parameters.index = custom_edition_indices(map_name.c_str());
-
-                        if(!parameters.forge_crc.has_value()) {
-                            if(map_name == "beavercreek") {
-                                parameters.forge_crc = 0x07B3876A;
-                            }
-                            else if(map_name == "bloodgulch") {
-                                parameters.forge_crc = 0x7B309554;
-                            }
-                            else if(map_name == "boardingaction") {
-                                parameters.forge_crc = 0xF4DEEF94;
-                            }
-                            else if(map_name == "carousel") {
-                                parameters.forge_crc = 0x9C301A08;
-                            }
-                            else if(map_name == "chillout") {
-                                parameters.forge_crc = 0x93C53C27;
-                            }
-                            else if(map_name == "damnation") {
-                                parameters.forge_crc = 0x0FBA059D;
-                            }
-                            else if(map_name == "dangercanyon") {
-                                parameters.forge_crc = 0xC410CD74;
-                            }
-                            else if(map_name == "deathisland") {
-                                parameters.forge_crc = 0x1DF8C97F;
-                            }
-                            else if(map_name == "gephyrophobia") {
-                                parameters.forge_crc = 0xD2872165;
-                            }
-                            else if(map_name == "hangemhigh") {
-                                parameters.forge_crc = 0xA7C8B9C6;
-                            }
-                            else if(map_name == "icefields") {
-                                parameters.forge_crc = 0x5EC1DEB7;
-                            }
-                            else if(map_name == "infinity") {
-                                parameters.forge_crc = 0x0E7F7FE7;
-                            }
-                            else if(map_name == "longest") {
-                                parameters.forge_crc = 0xC8F48FF6;
-                            }
-                            else if(map_name == "prisoner") {
-                                parameters.forge_crc = 0x43B81A8B;
-                            }
-                            else if(map_name == "putput") {
-                                parameters.forge_crc = 0xAF2F0B84;
-                            }
-                            else if(map_name == "ratrace") {
-                                parameters.forge_crc = 0xF7F8E14C;
-                            }
-                            else if(map_name == "sidewinder") {
-                                parameters.forge_crc = 0xBD95CF55;
-                            }
-                            else if(map_name == "timberland") {
-                                parameters.forge_crc = 0x54446470;
-                            }
-                            else if(map_name == "wizard") {
-                                parameters.forge_crc = 0xCF3359B1;
-                            }
-                        }
+                // Set the map name
+                std::string map_name;
+                if(build_options.rename_scenario) {
+                    map_name = *build_options.rename_scenario;
+                }
+                else {
+                    map_name = File::base_name(scenario.c_str());
+                }
 
-                        break;
-                    case HEK::GameEngine::GAME_ENGINE_GEARBOX_DEMO:
-                        parameters.index = demo_indices(map_name.c_str());
-                        break;
-                    case HEK::GameEngine::GAME_ENGINE_MCC_COMBAT_EVOLVED_ANNIVERSARY:
-                        parameters.index = mcc_cea_indices(map_name.c_str());
-                        break;
-                    default: break;
+                // Each map gets its own layout
+                if(build_options.stable_layout.has_value()) {
+                    parameters.stable_layout_path = *build_options.stable_layout / (map_name + ".layout");
+                }
+
+                // CRC32 spoofing, indexing, etc.
+                if(build_options.auto_forge) {
+                    if(!parameters.index.has_value()) {
+                        switch(engine_info.engine) {
+                            case HEK::GameEngine::GAME_ENGINE_GEARBOX_RETAIL:
+                                parameters.index = retail_indices(map_name.c_str());
+                                break;
+                            case HEK::GameEngine::GAME_ENGINE_GEARBOX_CUSTOM_EDITION:
+                                parameters.index = custom_edition_indices(map_name.c_str());
+
+                                if(!parameters.forge_crc.has_value()) {
+                                    if(map_name == "beavercreek") {
+                                        parameters.forge_crc = 0x07B3876A;
+                                    }
+                                    else if(map_name == "bloodgulch") {
+                                        parameters.forge_crc = 0x7B309554;
+                                    }
+                                    else if(map_name == "boardingaction") {
+                                        parameters.forge_crc = 0xF4DEEF94;
+                                    }
+                                    else if(map_name == "carousel") {
+                                        parameters.forge_crc = 0x9C301A08;
+                                    }
+                                    else if(map_name == "chillout") {
+                                        parameters.forge_crc = 0x93C53C27;
+                                    }
+                                    else if(map_name == "damnation") {
+                                        parameters.forge_crc = 0x0FBA059D;
+                                    }
+                                    else if(map_name == "dangercanyon") {
+                                        parameters.forge_crc = 0xC410CD74;
+                                    }
+                                    else if(map_name == "deathisland") {
+                                        parameters.forge_crc = 0x1DF8C97F;
+                                    }
+                                    else if(map_name == "gephyrophobia") {
+                                        parameters.forge_crc = 0xD2872165;
+                                    }
+                                    else if(map_name == "hangemhigh") {
+                                        parameters.forge_crc = 0xA7C8B9C6;
+                                    }
+                                    else if(map_name == "icefields") {
+                                        parameters.forge_crc = 0x5EC1DEB7;
+                                    }
+                                    else if(map_name == "infinity") {
+                                        parameters.forge_crc = 0x0E7F7FE7;
+                                    }
+                                    else if(map_name == "longest") {
+                                        parameters.forge_crc = 0xC8F48FF6;
+                                    }
+                                    else if(map_name == "prisoner") {
+                                        parameters.forge_crc = 0x43B81A8B;
+                                    }
+                                    else if(map_name == "putput") {
+                                        parameters.forge_crc = 0xAF2F0B84;
+                                    }
+                                    else if(map_name == "ratrace") {
+                                        parameters.forge_crc = 0xF7F8E14C;
+                                    }
+                                    else if(map_name == "sidewinder") {
+                                        parameters.forge_crc = 0xBD95CF55;
+                                    }
+                                    else if(map_name == "timberland") {
+                                        parameters.forge_crc = 0x54446470;
+                                    }
+                                    else if(map_name == "wizard") {
+                                        parameters.forge_crc = 0xCF3359B1;
+                                    }
+                                }
+
+                                break;
+                            case HEK::GameEngine::GAME_ENGINE_GEARBOX_DEMO:
+                                parameters.index = demo_indices(map_name.c_str());
+                                break;
+                            case HEK::GameEngine::GAME_ENGINE_MCC_COMBAT_EVOLVED_ANNIVERSARY:
+                                parameters.index = mcc_cea_indices(map_name.c_str());
+                                break;
+                            default: break;
+                        }
+                    }
                 }
-            }
-        }
 
-        // Build!
-        auto map = Invader::BuildWorkload::compile_map(parameters);
+                // Build!
+                auto map = Invader::BuildWorkload::compile_map(parameters);
+                if(parameters.check_only) {
+                    return true;
+                }
 
-        static const char MAP_EXTENSION[] = ".map";
-        auto map_name_with_extension = std::string(map_name) + MAP_EXTENSION;
+                static const char MAP_EXTENSION[] = ".map";
+                auto map_name_with_extension = std::string(map_name) + MAP_EXTENSION;
 
-        // Format path to maps/map_name.map if output not specified
-        std::filesystem::path final_file;
-        if(!build_options.output.has_value()) {
-            final_file = std::filesystem::path(build_options.maps) / map_name_with_extension;
-        }
-        else {
-            final_file = *build_options.output;
-            auto final_file_name_no_extension = final_file.filename().replace_extension();
-            auto final_file_name_no_extension_string = final_file_name_no_extension.string();
+                // Format path to maps/map_name.map if output not specified
+                std::filesystem::path final_file;
+                if(!build_options.output.has_value()) {
+                    final_file = std::filesystem::path(build_options.maps) / map_name_with_extension;
+                }
+                else {
+                    final_file = *build_options.output;
+                    auto final_file_name_no_extension = final_file.filename().replace_extension();
+                    auto final_file_name_no_extension_string = final_file_name_no_extension.string();
 
-            // If it's not a .map, warn
-            if(final_file.extension() != MAP_EXTENSION) {
-                eprintf_warn("The base file extension is not \"%s\" which is required by the target engine", MAP_EXTENSION);
-            }
+                    // If it's not a .map, warn
+                    if(final_file.extension() != MAP_EXTENSION) {
+                        eprintf_warn("The base file extension is not \"%s\" which is required by the target engine", MAP_EXTENSION);
+                    }
 
-            // If we are not building for MCC and the scenario name is mismatched, warn
-            if(final_file_name_no_extension_string != map_name && engine_info.scenario_name_and_file_name_must_be_equal) {
-                eprintf_warn("The base name (%s) does not match the scenario (%s)", final_file_name_no_extension_string.c_str(), map_name.c_str());
-                eprintf_warn("The map will fail to load correctly in the target engine with this file name.");
+                    // If we are not building for MCC and the scenario name is mismatched, warn
+                    if(final_file_name_no_extension_string != map_name && engine_info.scenario_name_and_file_name_must_be_equal) {
+                        eprintf_warn("The base name (%s) does not match the scenario (%s)", final_file_name_no_extension_string.c_str(), map_name.c_str());
+                        eprintf_warn("The map will fail to load correctly in the target engine with this file name.");
 
-                bool incorrect_case = false;
-                for(char &c : final_file_name_no_extension_string) {
-                    if(std::tolower(c) != c) {
-                        incorrect_case = true;
-                        break;
+                        bool incorrect_case = false;
+                        for(char &c : final_file_name_no_extension_string) {
+                            if(std::tolower(c) != c) {
+                                incorrect_case = true;
+                                break;
+                            }
+                        }
+                        if(!incorrect_case) {
+                            eprintf_warn("Did you intend to use --rename-scenario \"%s\"", final_file_name_no_extension_string.c_str());
+                        }
                     }
                 }
-                if(!incorrect_case) {
-                    eprintf_warn("Did you intend to use --rename-scenario \"%s\"", final_file_name_no_extension_string.c_str());
+
+                // Save the file
+                if(!File::save_file(final_file, map)) {
+                    eprintf_error("Failed to save %s", final_file.string().c_str());
+                    return false;
                 }
+
+                return true;
             }
+            catch(std::exception &exception) {
+                if(multiple_scenarios) {
+                    eprintf_error("Failed to compile %s.", scenario.c_str());
+                }
+                else {
+                    eprintf_error("Failed to compile the map.");
+                }
+                eprintf_error("%s", exception.what());
+                return false;
+            }
+        };
+
+        // Tags that compile the same way for every map are compiled once and shared. When watching, this also keeps them
+        // in memory between rebuilds, so only tags that changed are compiled again.
+        if(multiple_scenarios || build_options.watch) {
+            parameters.shared_tag_cache = std::make_shared<BuildWorkload::SharedTagCache>();
         }
 
-        // Save the file
-        if(!File::save_file(final_file, map)) {
-            eprintf_error("Failed to save %s", final_file.string().c_str());
-            return EXIT_FAILURE;
+        auto build_all_maps = [&scenarios, &parameters, &build_map, &build_options, &multiple_scenarios]() -> bool {
+            if(!multiple_scenarios) {
+                return build_map(scenarios[0], parameters);
+            }
+
+            // The first map is built on its own so the tags that most maps share (globals, HUD, UI, etc.) are already
+            // compiled when the rest are built at once.
+            std::atomic<bool> failed = !build_map(scenarios[0], parameters);
+
+            std::size_t remaining_maps = scenarios.size() - 1;
+            std::size_t maps_at_once = std::min(build_options.thread_count, remaining_maps);
+            auto maps_parameters = parameters;
+            maps_parameters.thread_count = std::max<std::size_t>(build_options.thread_count / maps_at_once, 1);
+
+            ThreadPool::shared().parallel_for(remaining_maps, [&scenarios, &maps_parameters, &build_map, &failed](std::size_t m) {
+                if(!build_map(scenarios[m + 1], maps_parameters)) {
+                    failed = true;
+                }
+            }, maps_at_once);
+
+            return !failed;
+        };
+
+        if(!build_options.watch) {
+            return build_all_maps() ? EXIT_SUCCESS : EXIT_FAILURE;
         }
 
-        return EXIT_SUCCESS;
+        // Poll rather than subscribe to change notifications so this works the same on every platform
+        static constexpr auto WATCH_POLL_INTERVAL = std::chrono::milliseconds(500);
+        auto watched_directories = build_options.tags;
+        watched_directories.emplace_back(build_options.data);
+
+        auto snapshot = snapshot_directories(watched_directories);
+        build_all_maps();
+        while(true) {
+            oprintf("Watching for changes...\n");
+            DirectorySnapshot new_snapshot;
+            while((new_snapshot = snapshot_directories(watched_directories)) == snapshot) {
+                std::this_thread::sleep_for(WATCH_POLL_INTERVAL);
+            }
+
+            // Wait for things to settle down so we don't build while tags are still being saved
+            do {
+                snapshot = std::move(new_snapshot);
+                std::this_thread::sleep_for(WATCH_POLL_INTERVAL);
+            }
+            while((new_snapshot = snapshot_directories(watched_directories)) != snapshot);
+
+            build_all_maps();
+        }
     }
     catch(std::exception &exception) {
         eprintf_error("Failed to compile the map.");
@@ -2,22 +2,33 @@
 
 #include <ctime>
 #include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
 
 #include <invader/build/build_workload.hpp>
 #include <invader/hek/map.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/version.hpp>
 #include <invader/crc/hek/crc.hpp>
+#include <invader/map/map.hpp>
 #include <invader/compress/compression.hpp>
 #include <invader/tag/index/index.hpp>
 #include <invader/tag/parser/compile/scenario_structure_bsp.hpp>
 #include <invader/resource/list/resource_list.hpp>
+#include <invader/thread_pool.hpp>
 #include "../crc/crc32.h"
 
 namespace Invader {
     using namespace HEK;
 
+    // Reading tag files mostly waits on the disk, so this doesn't need to be tied to the CPU thread count
+    static constexpr std::size_t PREFETCH_THREAD_COUNT = 4;
+
     BuildWorkload::BuildParameters::BuildParametersDetails::BuildParametersDetails(const HEK::GameEngineInfo &engine_info) noexcept {
         this->build_maximum_tag_space = engine_info.tag_space_length;
         this->build_tag_data_address = engine_info.base_memory_address;
@@ -51,12 +62,24 @@ namespace Invader {
 
     BuildWorkload::BuildWorkload() : ErrorHandler() {}
 
+    void BuildWorkload::set_build_parameters(const BuildParameters &parameters) noexcept {
+        this->parameters = &parameters;
+
+        auto cache_file_engine = parameters.details.build_cache_file_engine;
+        auto game_engine = parameters.details.build_game_engine;
+        this->check_stock_limits = cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE;
+        this->check_legacy_stock_limits = this->check_stock_limits && game_engine != HEK::GameEngine::GAME_ENGINE_MCC_COMBAT_EVOLVED_ANNIVERSARY && game_engine != HEK::GameEngine::GAME_ENGINE_NATIVE;
+    }
+
     std::vector<std::byte> BuildWorkload::compile_map(const BuildParameters &parameters) {
         BuildWorkload workload;
-        workload.parameters = &parameters;
+        workload.set_build_parameters(parameters);
 
         // Start benchmark
         workload.start = std::chrono::steady_clock::now();
+        if(parameters.profile_path.has_value() || parameters.profile_trace_path.has_value() || parameters.profile_graph_path.has_value() || parameters.profile_results) {
+            workload.profile = std::make_shared<Profile>();
+        }
 
         // Hide these?
         switch(parameters.verbosity) {
@@ -77,8 +100,40 @@ namespace Invader {
         return workload.build_cache_file();
     }
 
+    std::future<std::vector<std::byte>> BuildWorkload::compile_map_async(BuildParameters parameters) {
+        return std::async(std::launch::async, [parameters = std::move(parameters)]() {
+            return compile_map(parameters);
+        });
+    }
+
+    void BuildWorkload::report_progress(const char *phase) {
+        if(phase) {
+            this->progress.phase = phase;
+        }
+        if(this->parameters->progress_callback) {
+            this->progress.tag_count = this->tags.size();
+            this->parameters->progress_callback(this->progress);
+        }
+    }
+
     #define BYTES_TO_MiB(bytes) (bytes / 1024.0 / 1024.0)
 
+    void BuildWorkload::fail_if_errors() {
+        auto errors = this->get_errors();
+        if(errors) {
+            auto warnings = this->get_warnings();
+            if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
+                if(warnings) {
+                    oprintf_fail("Build failed with %zu error%s and %zu warning%s", errors, errors == 1 ? "" : "s", warnings, warnings == 1 ? "" : "s");
+                }
+                else {
+                    oprintf_fail("Build failed with %zu error%s", errors, errors == 1 ? "" : "s");
+                }
+            }
+            throw InvalidTagDataException();
+        }
+    }
+
     std::vector<std::byte> BuildWorkload::build_cache_file() {
         // Yay
         File::check_working_directory("./toolbeta.map");
@@ -102,6 +157,7 @@ namespace Invader {
             auto &index = *this->parameters->index;
             auto &tag_paths = this->get_tag_paths();
             this->tags.reserve(index.size());
+            this->tag_lookup.reserve(index.size());
             tag_paths.reserve(index.size());
             for(auto &i : index) {
                 auto &tag = this->tags.emplace_back();
@@ -109,6 +165,7 @@ namespace Invader {
                 tag.path = i.path;
                 tag.tag_fourcc = i.fourcc;
                 tag.stubbed = true;
+                this->index_tag(this->tags.size() - 1);
             }
         }
 
@@ -121,30 +178,46 @@ namespace Invader {
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf("Reading tags...\n");
         }
+        this->begin_profile_phase("Reading tags");
         this->add_tags();
 
         // Check this stuff
         this->check_hud_text_indices();
 
+        // If we're only checking, there's nothing else that can fail
+        if(this->parameters->check_only) {
+            this->fail_if_errors();
+            this->write_profile();
+            this->report_progress("Done");
+            if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
+                auto warnings = this->get_warnings();
+                if(warnings) {
+                    oprintf_success_warn("Check passed with %zu warning%s", warnings, warnings == 1 ? "" : "s");
+                }
+                else {
+                    oprintf_success("Check passed");
+                }
+            }
+            return std::vector<std::byte>();
+        }
+
         // If we have resource maps to check, check them
         if(this->parameters->details.build_raw_data_handling != BuildParameters::BuildParametersDetails::RawDataHandling::RAW_DATA_HANDLING_RETAIN_ALL) {
+            this->begin_profile_phase("Checking resource maps");
             this->externalize_tags();
         }
 
         // Generate the tag array
+        this->begin_profile_phase("Generating tag array");
         this->generate_tag_array();
 
         // Set the scenario tag thingy
         auto make_tag_data_header_struct = [](std::size_t scenario_index, auto &structs, auto size) {
-            auto &scenario_tag_dependency = TAG_DATA_HEADER_STRUCT.dependencies.emplace_back();
-            scenario_tag_dependency.tag_id_only = true;
-            scenario_tag_dependency.tag_index = scenario_index;
             auto *header_struct_data_temp = reinterpret_cast<HEK::CacheFileTagDataHeader *>(TAG_DATA_HEADER_STRUCT.data.data());
-            scenario_tag_dependency.offset = reinterpret_cast<const std::byte *>(&header_struct_data_temp->scenario_tag) - reinterpret_cast<const std::byte *>(header_struct_data_temp);
+            auto &scenario_tag_dependency = TAG_DATA_HEADER_STRUCT.add_dependency(reinterpret_cast<const std::byte *>(&header_struct_data_temp->scenario_tag) - reinterpret_cast<const std::byte *>(header_struct_data_temp), scenario_index);
+            scenario_tag_dependency.tag_id_only = true;
             TAG_DATA_HEADER_STRUCT.data.resize(size);
-            auto &tag_data_ptr = TAG_DATA_HEADER_STRUCT.pointers.emplace_back();
-            tag_data_ptr.offset = reinterpret_cast<const std::byte *>(&header_struct_data_temp->tag_array_address) - reinterpret_cast<const std::byte *>(header_struct_data_temp);
-            tag_data_ptr.struct_index = 1;
+            auto &tag_data_ptr = TAG_DATA_HEADER_STRUCT.add_pointer(reinterpret_cast<const std::byte *>(&header_struct_data_temp->tag_array_address) - reinterpret_cast<const std::byte *>(header_struct_data_temp), 1);
             tag_data_ptr.limit_to_32_bits = true;
         };
         switch(cache_version) {
@@ -159,27 +232,20 @@ namespace Invader {
                 break;
         }
 
-        auto errors = this->get_errors();
-        if(errors) {
-            auto warnings = this->get_warnings();
-            if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
-                if(warnings) {
-                    oprintf_fail("Build failed with %zu error%s and %zu warning%s", errors, errors == 1 ? "" : "s", warnings, warnings == 1 ? "" : "s");
-                }
-                else {
-                    oprintf_fail("Build failed with %zu error%s", errors, errors == 1 ? "" : "s");
-                }
-            }
-            throw InvalidTagDataException();
-        }
+        this->fail_if_errors();
 
         // Generate memes on Xbox
         if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            this->begin_profile_phase("Generating compressed models");
             this->generate_compressed_model_tag_array();
         }
 
         // Dedupe structs
+        if(this->profile) {
+            this->profile->struct_count = this->structs.size();
+        }
         if(this->parameters->optimize_space) {
+            this->begin_profile_phase("Optimizing tag space");
             this->dedupe_structs();
         }
 
@@ -188,6 +254,8 @@ namespace Invader {
             oprintf("Building tag data...");
             oflush();
         }
+        this->begin_profile_phase("Building tag data");
+        this->read_stable_layout();
         std::size_t end_of_bsps = this->generate_tag_data();
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf(" done\n");
@@ -224,12 +292,22 @@ namespace Invader {
             }
         }
 
+        // Native maps start each section on a page boundary so the map can be mapped into memory and used in place
+        if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            end_of_bsps += REQUIRED_PADDING_N_BYTES(end_of_bsps, HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_PAGE_SIZE);
+        }
+
         // Get the bitmap and sound data in there
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf("Building raw data...");
             oflush();
         }
-        this->generate_bitmap_sound_data(end_of_bsps);
+        this->progress.bytes_laid_out = end_of_bsps;
+        this->begin_profile_phase("Building raw data");
+        {
+            MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_RAW_DATA);
+            this->generate_bitmap_sound_data(end_of_bsps);
+        }
         if(this->parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
             oprintf(" done\n");
         }
@@ -256,47 +334,46 @@ namespace Invader {
                 oprintf("Building cache file data...");
                 oflush();
             }
+            workload.progress.bytes_laid_out += workload.all_raw_data.size();
+            workload.begin_profile_phase("Building cache file data");
 
-            // Add header stuff
-            final_data.resize(sizeof(HEK::CacheFileHeader));
-
-            // Add each BSP data thing
+            // Lay out every section first so the cache file is allocated once instead of being grown (and copied) as
+            // each section is added
+            std::size_t raw_data_offset = sizeof(HEK::CacheFileHeader);
             for(auto &b : workload.bsp_data) {
-                final_data.insert(final_data.end(), b.begin(), b.end());
+                raw_data_offset += b.size();
             }
-
-            // Go through each BSP and add that stuff
             if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                 for(std::size_t b = 0; b < workload.bsp_count; b++) {
-                    final_data.insert(final_data.end(), workload.map_data_structs[b + 1].begin(), workload.map_data_structs[b + 1].end());
+                    raw_data_offset += workload.map_data_structs[b + 1].size();
                 }
             }
-            workload.map_data_structs.resize(1);
-
-            // Now add all the raw data
-            final_data.insert(final_data.end(), workload.all_raw_data.begin(), workload.all_raw_data.end());
+            else {
+                raw_data_offset += REQUIRED_PADDING_N_BYTES(raw_data_offset, HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_PAGE_SIZE);
+            }
             auto raw_data_size = workload.all_raw_data.size();
-            workload.all_raw_data = std::vector<std::byte>();
+            std::size_t end_of_raw_data = raw_data_offset + raw_data_size;
 
             std::size_t model_data_size;
             std::size_t vertex_size;
             std::size_t model_offset;
             std::size_t tag_data_offset;
 
-            // If we're not on Xbox, we put the model data here
-            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                // Let's get the model data there
-                model_offset = final_data.size() + REQUIRED_PADDING_32_BIT(final_data.size());
-                final_data.resize(model_offset, std::byte());
-                final_data.insert(final_data.end(), reinterpret_cast<std::byte *>(workload.uncompressed_model_vertices.data()), reinterpret_cast<std::byte *>(workload.uncompressed_model_vertices.data() + workload.uncompressed_model_vertices.size()));
-
-                // Now add model indices
+            // Native maps put the model data and the tag data on their own pages
+            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                model_offset = end_of_raw_data + REQUIRED_PADDING_N_BYTES(end_of_raw_data, HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_PAGE_SIZE);
                 vertex_size = workload.uncompressed_model_vertices.size() * sizeof(*workload.uncompressed_model_vertices.data());
-                final_data.insert(final_data.end(), reinterpret_cast<std::byte *>(workload.model_indices.data()), reinterpret_cast<std::byte *>(workload.model_indices.data() + workload.model_indices.size()));
-                workload.uncompressed_model_vertices = decltype(workload.uncompressed_model_vertices)();
-                workload.model_indices = decltype(workload.model_indices)();
+                model_data_size = vertex_size + workload.model_indices.size() * sizeof(*workload.model_indices.data());
+                std::size_t end_of_model_data = model_offset + model_data_size;
+                tag_data_offset = end_of_model_data + REQUIRED_PADDING_N_BYTES(end_of_model_data, HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_PAGE_SIZE);
+            }
 
-                tag_data_offset = final_data.size() + REQUIRED_PADDING_32_BIT(final_data.size());
+            // If we're not on Xbox, we put the model data after the raw data
+            else if(cache_version != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                model_offset = end_of_raw_data + REQUIRED_PADDING_32_BIT(end_of_raw_data);
+                vertex_size = workload.uncompressed_model_vertices.size() * sizeof(*workload.uncompressed_model_vertices.data());
+                std::size_t end_of_model_data = model_offset + vertex_size + workload.model_indices.size() * sizeof(*workload.model_indices.data());
+                tag_data_offset = end_of_model_data + REQUIRED_PADDING_32_BIT(end_of_model_data);
                 model_data_size = tag_data_offset - model_offset;
             }
 
@@ -305,35 +382,114 @@ namespace Invader {
                 vertex_size = workload.compressed_model_vertices.size() * sizeof(*workload.compressed_model_vertices.data());
                 model_data_size = vertex_size + workload.model_indices.size() * sizeof(*workload.model_indices.data());
                 model_offset = 0;
-                tag_data_offset = final_data.size() + REQUIRED_PADDING_N_BYTES(final_data.size(), HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
+                tag_data_offset = end_of_raw_data + REQUIRED_PADDING_N_BYTES(end_of_raw_data, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
+            }
+
+            std::size_t tag_data_size = workload.map_data_structs[0].size();
+            std::size_t final_size = tag_data_offset + tag_data_size;
+            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                final_size += REQUIRED_PADDING_N_BYTES(final_size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
+            }
+
+            // Check to make sure we aren't too big
+            std::size_t uncompressed_size = final_size;
+            if(static_cast<std::uint64_t>(uncompressed_size) > max_size) {
+                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, std::nullopt, "Map file exceeds maximum size for the target engine when uncompressed (%.04f MiB > %.04f MiB)", BYTES_TO_MiB(uncompressed_size), BYTES_TO_MiB(static_cast<std::size_t>(max_size)));
+                throw MaximumFileSizeException();
+            }
+
+            // Make sure we don't go beyond the maximum tag space usage
+            std::size_t tag_space_usage = workload.indexed_data_amount + tag_data_size;
+            if(bsp_size_affects_tag_space) {
+                tag_space_usage += largest_bsp_size;
+            }
+            if(tag_space_usage > workload.parameters->details.build_maximum_tag_space) {
+                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, std::nullopt, "Maximum tag space exceeded (%.04f MiB > %.04f MiB)", BYTES_TO_MiB(tag_space_usage), BYTES_TO_MiB(workload.parameters->details.build_maximum_tag_space));
+                throw MaximumFileSizeException();
+            }
+
+            // Nothing after the header changes once it's written, so Xbox maps can be compressed as they're written
+            // rather than holding the whole uncompressed map and then the compressed map at once
+            std::optional<Compression::MapCompressor> compressor;
+            if(workload.parameters->details.build_compress && cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                compressor.emplace(workload.parameters->details.build_compression_level.value_or(19), workload.parameters->thread_count);
+            }
+            else {
+                final_data.reserve(final_size);
+                final_data.resize(sizeof(HEK::CacheFileHeader));
+            }
+
+            auto write_data = [&final_data, &compressor](const void *data, std::size_t size) {
+                auto *bytes = reinterpret_cast<const std::byte *>(data);
+                if(compressor.has_value()) {
+                    compressor->write(bytes, size);
+                }
+                else {
+                    final_data.insert(final_data.end(), bytes, bytes + size);
+                }
+            };
+            auto write_padding = [&final_data, &compressor](std::size_t offset) {
+                if(compressor.has_value()) {
+                    compressor->write_zeroes(offset - compressor->get_size());
+                }
+                else {
+                    final_data.resize(offset, std::byte());
+                }
+            };
+
+            // Add each BSP data thing
+            for(auto &b : workload.bsp_data) {
+                write_data(b.data(), b.size());
+                b = std::vector<std::byte>();
+            }
+
+            // Go through each BSP and add that stuff
+            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                for(std::size_t b = 0; b < workload.bsp_count; b++) {
+                    write_data(workload.map_data_structs[b + 1].data(), workload.map_data_structs[b + 1].size());
+                }
+            }
+            workload.map_data_structs.resize(1);
+
+            // Now add all the raw data
+            write_padding(raw_data_offset);
+            write_data(workload.all_raw_data.data(), workload.all_raw_data.size());
+            workload.all_raw_data = std::vector<std::byte>();
+
+            // Let's get the model data there
+            if(cache_version != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                write_padding(model_offset);
+                write_data(workload.uncompressed_model_vertices.data(), workload.uncompressed_model_vertices.size() * sizeof(*workload.uncompressed_model_vertices.data()));
+                write_data(workload.model_indices.data(), workload.model_indices.size() * sizeof(*workload.model_indices.data()));
+                workload.uncompressed_model_vertices = decltype(workload.uncompressed_model_vertices)();
+                workload.model_indices = decltype(workload.model_indices)();
             }
 
             // We're almost there
-            final_data.resize(tag_data_offset, std::byte());
+            write_padding(tag_data_offset);
 
-            // Add tag data
-            std::size_t tag_data_size = workload.map_data_structs[0].size();
-            final_data.insert(final_data.end(), workload.map_data_structs[0].begin(), workload.map_data_structs[0].end());
+            // Fill in the tag data header before adding the tag data
+            auto *tag_data = workload.map_data_structs[0].data();
             auto part_count = workload.model_parts.size();
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                auto &tag_data_struct = *reinterpret_cast<HEK::NativeCacheFileTagDataHeader *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::NativeCacheFileTagDataHeader *>(tag_data);
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
-                tag_data_struct.model_data_file_offset = static_cast<std::uint32_t>(model_offset);
-                tag_data_struct.vertex_size = static_cast<std::uint32_t>(vertex_size);
-                tag_data_struct.model_data_size = static_cast<std::uint32_t>(model_data_size);
+                tag_data_struct.model_data_file_offset = static_cast<std::uint64_t>(model_offset);
+                tag_data_struct.vertex_size = static_cast<std::uint64_t>(vertex_size);
+                tag_data_struct.model_data_size = static_cast<std::uint64_t>(model_data_size);
                 tag_data_struct.raw_data_indices = workload.raw_data_indices_offset;
             }
             else if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderXbox *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderXbox *>(tag_data);
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
                 tag_data_struct.model_part_count_again = static_cast<std::uint32_t>(part_count);
             }
             else {
-                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderPC *>(final_data.data() + tag_data_offset);
+                auto &tag_data_struct = *reinterpret_cast<HEK::CacheFileTagDataHeaderPC *>(tag_data);
                 tag_data_struct.tag_count = static_cast<std::uint32_t>(workload.tags.size());
                 tag_data_struct.tags_literal = CacheFileLiteral::CACHE_FILE_TAGS;
                 tag_data_struct.model_part_count = static_cast<std::uint32_t>(part_count);
@@ -343,49 +499,43 @@ namespace Invader {
                 tag_data_struct.model_data_size = static_cast<std::uint32_t>(model_data_size);
             }
 
+            // Hold this here, of course
+            reinterpret_cast<HEK::CacheFileTagDataHeader *>(tag_data)->tag_file_checksums = workload.tag_file_checksums;
+
+            // Add tag data
+            write_data(tag_data, tag_data_size);
+
+            // Resize to ye ol' sector
+            write_padding(final_size);
+
             // Lastly, do the header
             header.tag_data_size = static_cast<std::uint32_t>(tag_data_size);
             header.tag_data_offset = static_cast<std::uint32_t>(tag_data_offset);
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_DEMO) {
                 header.head_literal = CacheFileLiteral::CACHE_FILE_HEAD_DEMO;
                 header.foot_literal = CacheFileLiteral::CACHE_FILE_FOOT_DEMO;
-                *reinterpret_cast<HEK::CacheFileDemoHeader *>(final_data.data()) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
             }
             else {
                 header.head_literal = CacheFileLiteral::CACHE_FILE_HEAD;
                 header.foot_literal = CacheFileLiteral::CACHE_FILE_FOOT;
-                std::memcpy(final_data.data(), &header, sizeof(header));
+            }
+            auto copy_header = [&final_data, &header, &cache_version]() {
+                if(cache_version == HEK::CacheFileEngine::CACHE_FILE_DEMO) {
+                    *reinterpret_cast<HEK::CacheFileDemoHeader *>(final_data.data()) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
+                }
+                else {
+                    std::memcpy(final_data.data(), &header, sizeof(header));
+                }
+            };
+            if(!compressor.has_value()) {
+                copy_header();
             }
 
             if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                 oprintf(" done\n");
             }
 
-            // Resize to ye ol' sector
-            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                final_data.insert(final_data.end(), REQUIRED_PADDING_N_BYTES(final_data.size(), HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE), std::byte());
-            }
-
-            // Check to make sure we aren't too big
-            std::size_t uncompressed_size = final_data.size();
-            if(static_cast<std::uint64_t>(uncompressed_size) > max_size) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, std::nullopt, "Map file exceeds maximum size for the target engine when uncompressed (%.04f MiB > %.04f MiB)", BYTES_TO_MiB(uncompressed_size), BYTES_TO_MiB(static_cast<std::size_t>(max_size)));
-                throw MaximumFileSizeException();
-            }
-
-            // Make sure we don't go beyond the maximum tag space usage
-            std::size_t tag_space_usage = workload.indexed_data_amount + tag_data_size;
-            if(bsp_size_affects_tag_space) {
-                tag_space_usage += largest_bsp_size;
-            }
-            if(tag_space_usage > workload.parameters->details.build_maximum_tag_space) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, std::nullopt, "Maximum tag space exceeded (%.04f MiB > %.04f MiB)", BYTES_TO_MiB(tag_space_usage), BYTES_TO_MiB(workload.parameters->details.build_maximum_tag_space));
-                throw MaximumFileSizeException();
-            }
-
-            // Hold this here, of course
-            auto &tag_file_checksums = reinterpret_cast<HEK::CacheFileTagDataHeader *>(final_data.data() + tag_data_offset)->tag_file_checksums;
-            tag_file_checksums = workload.tag_file_checksums;
+            workload.progress.bytes_laid_out = uncompressed_size;
 
             // If we can calculate the CRC32, do it
             std::uint32_t new_crc = 0;
@@ -396,15 +546,20 @@ namespace Invader {
                     oprintf("Calculating CRC32...");
                     oflush();
                 }
+                workload.begin_profile_phase("Calculating CRC32");
 
-                // Calculate the CRC32 and/or forge one if we must
+                // Calculate the CRC32 and/or forge one if we must. The data is lent to the map rather than copied into it.
+                std::uint32_t checksum_delta = 0;
+                auto crc_map = Map::map_with_move(std::move(final_data));
                 if(workload.parameters->forge_crc.has_value()) {
-                    std::uint32_t checksum_delta = 0;
-                    new_crc = calculate_map_crc(final_data.data(), final_data.size(), &workload.parameters->forge_crc.value(), &checksum_delta);
-                    tag_file_checksums = checksum_delta;
+                    new_crc = calculate_map_crc(crc_map, &workload.parameters->forge_crc.value(), &checksum_delta);
                 }
                 else {
-                    new_crc = calculate_map_crc(final_data.data(), final_data.size());
+                    new_crc = calculate_map_crc(crc_map);
+                }
+                final_data = crc_map.release_data();
+                if(workload.parameters->forge_crc.has_value()) {
+                    reinterpret_cast<HEK::CacheFileTagDataHeader *>(final_data.data() + tag_data_offset)->tag_file_checksums = checksum_delta;
                 }
 
                 header.crc32 = new_crc;
@@ -417,27 +572,41 @@ namespace Invader {
             }
 
             // Set the file size
-            header.decompressed_file_size = final_data.size();
-
-            // Copy it again, this time with the new CRC32
-            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_DEMO) {
-                *reinterpret_cast<HEK::CacheFileDemoHeader *>(final_data.data()) = *reinterpret_cast<HEK::CacheFileHeader *>(&header);
-            }
-            else {
-                std::memcpy(final_data.data(), &header, sizeof(header));
-            }
+            header.decompressed_file_size = uncompressed_size;
 
-            // Compress if needed
-            if(workload.parameters->details.build_compress) {
+            // Compress if needed (whatever wasn't compressed while it was written)
+            if(compressor.has_value()) {
                 if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                     oprintf("Compressing...");
                     oflush();
                 }
-                final_data = Compression::compress_map_data(final_data.data(), final_data.size(), workload.parameters->details.build_compression_level.value_or(19));
+                workload.begin_profile_phase("Compressing");
+                final_data = compressor->finish(*reinterpret_cast<HEK::CacheFileHeader *>(&header));
                 if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
                     oprintf(" done\n");
                 }
             }
+            else {
+                // Copy it again, this time with the new CRC32
+                copy_header();
+
+                if(workload.parameters->details.build_compress) {
+                    if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
+                        oprintf("Compressing...");
+                        oflush();
+                    }
+                    workload.begin_profile_phase("Compressing");
+                    final_data = Compression::compress_map_data(final_data.data(), final_data.size(), workload.parameters->details.build_compression_level.value_or(19), workload.parameters->thread_count);
+                    if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
+                        oprintf(" done\n");
+                    }
+                }
+            }
+
+            // Done; write the profile before the summary so the summary isn't counted
+            workload.write_stable_layout();
+            workload.write_profile();
+            workload.report_progress("Done");
 
             // Display the scenario name and information
             if(workload.parameters->verbosity > BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
@@ -581,9 +750,17 @@ namespace Invader {
         }
     }
 
-    void BuildWorkload::compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagFourCC> tag_fourcc) {
+    void BuildWorkload::compile_tag_data_recursively(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, std::optional<TagFourCC> tag_fourcc, Parser::ParserStruct *parsed_tag) {
         #define COMPILE_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
-            do_compile_tag(std::move(Parser::class_struct::parse_hek_tag_file(tag_data, tag_data_size, true))); \
+            if(auto *parsed_tag_struct = dynamic_cast<Parser::class_struct *>(parsed_tag)) { \
+                do_compile_tag(std::move(*parsed_tag_struct)); \
+            } \
+            else { \
+                std::optional<ProfileScope> parse_scope(std::in_place, *this, tag_index, PROFILE_STEP_PARSE); \
+                auto new_tag_struct = Parser::class_struct::parse_hek_tag_file(tag_data, tag_data_size, true); \
+                parse_scope.reset(); \
+                do_compile_tag(std::move(new_tag_struct)); \
+            } \
             break; \
         }
 
@@ -594,7 +771,11 @@ namespace Invader {
         }
 
         // Set this in case it's not set yet
-        this->tags[tag_index].tag_fourcc = *tag_fourcc;
+        if(this->tags[tag_index].tag_fourcc != *tag_fourcc) {
+            this->unindex_tag(tag_index);
+            this->tags[tag_index].tag_fourcc = *tag_fourcc;
+            this->index_tag(tag_index);
+        }
 
         // Make sure the path isn't bullshit
         bool invalid_path = false;
@@ -659,9 +840,27 @@ namespace Invader {
             auto &new_struct = structs.emplace_back();
             tags[tag_index].base_struct = &new_struct - structs.data();
             new_struct.data.resize(sizeof(typename decltype(new_tag_struct)::struct_little), std::byte());
+
+            // Start reading what this tag depends on now so it's there when the compiler gets to it
+            if(workload.prefetcher) {
+                workload.prefetch_dependencies(new_tag_struct);
+            }
+
             new_tag_struct.compile(workload, tag_index, &new_struct - structs.data());
         };
 
+        // Everything from here on is compiling the tag (parsing, pre_compile(), post_compile(), and other tags are timed separately)
+        ProfileScope compile_scope(*this, tag_index, PROFILE_STEP_COMPILE);
+
+        // If the tag is in the tag cache, use that instead. Otherwise, record it so it can be cached.
+        auto cache_key = this->get_tag_cache_key(tag_data, tag_data_size, tag_index, *tag_fourcc);
+        if(cache_key.has_value()) {
+            if(this->load_cached_tag(*cache_key, tag_index)) {
+                return;
+            }
+            this->begin_tag_cache_recording(*cache_key, tag_index);
+        }
+
         switch(*tag_fourcc) {
             COMPILE_TAG_CLASS(Actor, TAG_FOURCC_ACTOR)
             COMPILE_TAG_CLASS(ActorVariant, TAG_FOURCC_ACTOR_VARIANT)
@@ -749,8 +948,11 @@ namespace Invader {
 
             // And, of course, BSP tags
             case TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP: {
-                // First thing's first - parse the tag data
-                auto tag_data_parsed = Parser::ScenarioStructureBSP::parse_hek_tag_file(tag_data, tag_data_size, true);
+                // First thing's first - parse the tag data (if it wasn't already parsed)
+                auto *parsed_bsp = dynamic_cast<Parser::ScenarioStructureBSP *>(parsed_tag);
+                std::optional<ProfileScope> parse_scope(std::in_place, *this, tag_index, PROFILE_STEP_PARSE);
+                auto tag_data_parsed = parsed_bsp ? std::move(*parsed_bsp) : Parser::ScenarioStructureBSP::parse_hek_tag_file(tag_data, tag_data_size, true);
+                parse_scope.reset();
                 std::size_t bsp = this->bsp_count++;
 
                 auto cache_version = this->parameters->details.build_cache_file_engine;
@@ -769,9 +971,8 @@ namespace Invader {
                     Parser::ScenarioStructureBSPCompiledHeader::struct_little *bsp_data;
                     new_bsp_header_struct.data.resize(sizeof(*bsp_data), std::byte());
                     bsp_data = reinterpret_cast<decltype(bsp_data)>(new_bsp_header_struct.data.data());
-                    auto &new_ptr = new_bsp_header_struct.pointers.emplace_back();
+                    auto &new_ptr = new_bsp_header_struct.add_pointer(reinterpret_cast<std::byte *>(&bsp_data->pointer) - reinterpret_cast<std::byte *>(bsp_data), 0);
                     new_ptr.limit_to_32_bits = true;
-                    new_ptr.offset = reinterpret_cast<std::byte *>(&bsp_data->pointer) - reinterpret_cast<std::byte *>(bsp_data);
                     bsp_data->signature = TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP;
 
                     // Make the new BSP struct thingy and make the header point to it
@@ -808,12 +1009,23 @@ namespace Invader {
             default:
                 throw UnknownTagClassException();
         }
+
+        if(cache_key.has_value()) {
+            this->end_tag_cache_recording(tag_index);
+        }
+
+        if(this->parameters && this->parameters->spill_raw_data) {
+            this->spill_raw_data(tag_index);
+        }
     }
 
-    std::size_t BuildWorkload::compile_tag_recursively(const char *tag_path, TagFourCC tag_fourcc) {
-        // Remove duplicate slashes
-        auto fixed_path = Invader::File::remove_duplicate_slashes(tag_path);
-        tag_path = fixed_path.c_str();
+    std::size_t BuildWorkload::compile_tag_recursively_internal(const char *tag_path, TagFourCC tag_fourcc) {
+        // Remove duplicate slashes (only copying the path if there are any)
+        std::string fixed_path;
+        if(Invader::File::has_duplicate_slashes(tag_path)) {
+            fixed_path = Invader::File::remove_duplicate_slashes(tag_path);
+            tag_path = fixed_path.c_str();
+        }
         std::optional<std::string> renamed_path;
 
         // If it's a scenario tag, rename it
@@ -829,23 +1041,25 @@ namespace Invader {
             renamed_path = std::string(first_char, last_slash - first_char) + this->scenario_name.string;
         }
 
-        // Search for the tag
+        // Search for the tag (if both the original and renamed path were found, use whichever tag comes first)
         std::size_t return_value = this->tags.size();
         bool found = false;
-        for(std::size_t i = 0; i < return_value; i++) {
-            auto &tag = this->tags[i];
-            if((tag.tag_fourcc == tag_fourcc || tag.alias == tag_fourcc) && (tag.path == tag_path || renamed_path == tag.path)) {
-                if(tag.base_struct.has_value()) {
-                    return i;
-                }
-                return_value = i;
-                found = true;
-                tag.stubbed = false;
-                break;
+        auto existing_tag = this->tag_lookup.find(tag_path, tag_fourcc);
+        if(renamed_path.has_value()) {
+            auto existing_renamed_tag = this->tag_lookup.find(*renamed_path, tag_fourcc);
+            if(existing_renamed_tag.has_value() && (!existing_tag.has_value() || *existing_renamed_tag < *existing_tag)) {
+                existing_tag = existing_renamed_tag;
             }
         }
-
-        auto &tags_directories = this->parameters->tags_directories;
+        if(existing_tag.has_value()) {
+            auto &tag = this->tags[*existing_tag];
+            if(tag.base_struct.has_value()) {
+                return *existing_tag;
+            }
+            return_value = *existing_tag;
+            found = true;
+            tag.stubbed = false;
+        }
 
         // Find it
         char formatted_path[512];
@@ -853,10 +1067,8 @@ namespace Invader {
         std::snprintf(formatted_path, sizeof(formatted_path), "%s.%s", tag_path, tag_fourcc_to_extension(tag_fourcc));
         Invader::File::halo_path_to_preferred_path_chars(formatted_path);
 
-        // Only set the new path if it exists
-        if((new_path = Invader::File::tag_path_to_file_path(formatted_path, tags_directories)).has_value() && !std::filesystem::exists(*new_path)) {
-            new_path = std::nullopt;
-        }
+        // Only set the new path if it exists (this also finds tags in tag bundles, which aren't on the filesystem)
+        new_path = this->find_tag_file(formatted_path);
 
         // If it wasn't found in the current array list, add it to the list and let's begin
         if(!found) {
@@ -864,11 +1076,14 @@ namespace Invader {
             tag.path = tag_path;
             tag.tag_fourcc = tag_fourcc;
             this->get_tag_paths().emplace_back(tag_path, tag_fourcc);
+            this->index_tag(return_value);
         }
 
         // Rename the path
         if(renamed_path.has_value()) {
+            this->unindex_tag(return_value);
             this->tags[return_value].path = *renamed_path;
+            this->index_tag(return_value);
         }
 
         // And we're done! Maybe?
@@ -881,21 +1096,53 @@ namespace Invader {
             throw InvalidTagPathException();
         }
 
+        // If we already loaded it, use that
+        auto preloaded = this->preloaded_tags.find(formatted_path);
+        if(preloaded != this->preloaded_tags.end()) {
+            auto preloaded_tag = std::move(preloaded->second);
+            this->preloaded_tags.erase(preloaded);
+            this->add_profile_time(return_value, PROFILE_STEP_PARSE, preloaded_tag.parse_time);
+
+            try {
+                this->compile_tag_data_recursively(preloaded_tag.data->data(), preloaded_tag.data->size(), return_value, tag_fourcc, preloaded_tag.parsed.get());
+            }
+            catch(std::exception &e) {
+                eprintf("Failed to compile tag %s\n", formatted_path);
+                throw;
+            }
+            this->progress.tags_compiled++;
+            this->report_progress();
+
+            return return_value;
+        }
+
         // Open it
-        auto tag_file = Invader::File::open_file(*new_path);
+        std::optional<ProfileScope> open_scope(std::in_place, *this, return_value, PROFILE_STEP_PARSE);
+        std::optional<std::vector<std::byte>> tag_file;
+        std::optional<File::MemoryMappedFile> mapped_tag_file;
+        if(this->prefetcher) {
+            tag_file = this->prefetcher->take(formatted_path);
+        }
         if(!tag_file.has_value()) {
-            eprintf_error("Failed to open %s\n", formatted_path);
-            throw FailedToOpenFileException();
+            mapped_tag_file = File::MemoryMappedFile::map_file(*new_path);
+            if(!mapped_tag_file.has_value()) {
+                eprintf_error("Failed to open %s\n", formatted_path);
+                throw FailedToOpenFileException();
+            }
         }
-        auto &tag_file_data = *tag_file;
+        open_scope.reset();
+        const auto *tag_file_data = tag_file.has_value() ? tag_file->data() : mapped_tag_file->data();
+        auto tag_file_size = tag_file.has_value() ? tag_file->size() : mapped_tag_file->size();
 
         try {
-            this->compile_tag_data_recursively(tag_file_data.data(), tag_file_data.size(), return_value, tag_fourcc);
+            this->compile_tag_data_recursively(tag_file_data, tag_file_size, return_value, tag_fourcc);
         }
         catch(std::exception &e) {
             eprintf("Failed to compile tag %s\n", formatted_path);
             throw;
         }
+        this->progress.tags_compiled++;
+        this->report_progress();
 
         return return_value;
     }
@@ -932,6 +1179,29 @@ namespace Invader {
                                    std::strcmp(this->scenario_name.string, "ui") == 0 ||
                                    std::strcmp(this->scenario_name.string, "wizard") == 0;
 
+        // With more than one tags directory, each dependency would otherwise be checked in every directory until it's
+        // found, so list them all once up front and look tags up from that instead
+        const auto &tags_directories = this->parameters->tags_directories;
+        if(tags_directories.size() > 1 && !this->disable_recursion) {
+            std::size_t listing_errors = 0;
+            auto all_tags = File::load_virtual_tag_folder(tags_directories, true, nullptr, &listing_errors);
+
+            // If anything couldn't be listed, the index may be missing tags, so just check the filesystem
+            if(listing_errors == 0) {
+                auto &index = this->tag_file_index.emplace();
+                index.reserve(all_tags.size());
+                for(auto &tag : all_tags) {
+                    index.emplace(std::move(tag.tag_path), std::move(tag.full_path));
+                }
+            }
+        }
+
+        // Without threads to preload tags with, at least have the tags read in the background while compiling
+        if(this->parameters->thread_count <= 1 && !this->disable_recursion) {
+            this->prefetcher = std::make_shared<File::FilePrefetcher>([this](const std::string &formatted_path) { return this->find_tag_file(formatted_path); }, PREFETCH_THREAD_COUNT);
+        }
+
+        this->preload_tags({ File::TagFilePath(this->scenario, TagFourCC::TAG_FOURCC_SCENARIO) });
         this->scenario_index = this->compile_tag_recursively(this->scenario, TagFourCC::TAG_FOURCC_SCENARIO);
 
         const auto &required_tags = this->parameters->details.build_required_tags;
@@ -940,6 +1210,16 @@ namespace Invader {
         auto import_all = [&workload](auto &what) {
             std::size_t count = what.count;
             auto *arr = what.ptr;
+            std::vector<File::TagFilePath> tags_to_preload;
+            for(std::size_t c = 0; c < count; c++) {
+                tags_to_preload.emplace_back(arr[c].path, arr[c].fourcc);
+            }
+            workload.preload_tags(tags_to_preload);
+            if(workload.prefetcher) {
+                for(auto &tag : tags_to_preload) {
+                    workload.prefetcher->prefetch(File::halo_path_to_preferred_path(File::remove_duplicate_slashes(tag.path) + "." + tag_fourcc_to_extension(tag.fourcc)));
+                }
+            }
             for(std::size_t c = 0; c < count; c++) {
                 auto &tag = arr[c];
                 workload.compile_tag_recursively(tag.path, tag.fourcc);
@@ -1006,6 +1286,9 @@ namespace Invader {
                 std::terminate();
         };
 
+        // Everything's been read by now
+        this->prefetcher.reset();
+
         // Mark stubs
         std::size_t warned = 0;
         for(auto &tag : this->tags) {
@@ -1016,8 +1299,11 @@ namespace Invader {
                     warned++;
                 }
 
+                std::size_t tag_index = &tag - this->tags.data();
+                this->unindex_tag(tag_index);
                 tag.path = "MISSINGNO.";
                 tag.tag_fourcc = TagFourCC::TAG_FOURCC_NONE;
+                this->index_tag(tag_index);
                 this->stubbed_tag_count++;
             }
         }
@@ -1029,45 +1315,183 @@ namespace Invader {
         }
     }
 
-    BuildWorkload BuildWorkload::compile_single_tag(const std::byte *tag_data, std::size_t tag_data_size, const std::vector<std::filesystem::path> &tags_directories, bool recursion, bool error_checking) {
-        BuildWorkload workload = {};
-        workload.set_reporting_level(ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
-        workload.disable_recursion = !recursion;
-        workload.disable_error_checking = !error_checking;
-        workload.cache_file_type = HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER;
-
-        BuildParameters parameters;
-        parameters.tags_directories = tags_directories;
-        workload.parameters = &parameters;
+    void BuildWorkload::index_tag(std::size_t tag_index) {
+        auto &tag = this->tags[tag_index];
+        this->tag_lookup.add(tag.path, tag.tag_fourcc, tag_index);
+    }
 
-        auto &tag = workload.tags.emplace_back();
-        tag.path = "unknown";
-        workload.compile_tag_data_recursively(tag_data, tag_data_size, 0);
-        return workload;
+    void BuildWorkload::unindex_tag(std::size_t tag_index) {
+        auto &tag = this->tags[tag_index];
+        this->tag_lookup.remove(tag.path, tag.tag_fourcc, tag_index);
     }
 
-    BuildWorkload BuildWorkload::compile_single_tag(const char *tag, TagFourCC tag_fourcc, const std::vector<std::filesystem::path> &tags_directories, bool recursion, bool error_checking) {
-        BuildWorkload workload = {};
+    std::optional<std::filesystem::path> BuildWorkload::find_tag_file(const std::string &formatted_path) const {
+        if(this->tag_file_index.has_value()) {
+            auto iterator = this->tag_file_index->find(formatted_path);
 
-        BuildParameters parameters;
-        parameters.tags_directories = tags_directories;
-        workload.parameters = &parameters;
+            // Repeated separators still resolve on the filesystem, so try without them before giving up
+            if(iterator == this->tag_file_index->end()) {
+                auto cleaned_path = File::remove_duplicate_slashes(formatted_path);
+                if(cleaned_path == formatted_path || (iterator = this->tag_file_index->find(cleaned_path)) == this->tag_file_index->end()) {
+                    return std::nullopt;
+                }
+            }
+            return iterator->second;
+        }
+        return File::tag_path_to_file_path(formatted_path, this->parameters->tags_directories);
+    }
 
-        workload.set_reporting_level(ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
-        workload.disable_recursion = !recursion;
-        workload.disable_error_checking = !error_checking;
-        workload.cache_file_type = HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER;
-        workload.compile_tag_recursively(tag, tag_fourcc);
-        return workload;
+    static void get_tag_dependencies(const Parser::ParserStruct &st, std::vector<File::TagFilePath> &dependencies) {
+        for(auto &v : st.get_values()) {
+            switch(v.get_type()) {
+                case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE: {
+                    auto count = v.get_array_size();
+                    for(std::size_t i = 0; i < count; i++) {
+                        get_tag_dependencies(v.get_object_in_array(i), dependencies);
+                    }
+                    break;
+                }
+                case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY: {
+                    auto &dep = v.get_dependency();
+                    if(!dep.path.empty()) {
+                        dependencies.emplace_back(dep.path, dep.tag_fourcc);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
     }
 
-    template <typename Tag, HEK::Pointer64 stub_address, bool native> static void do_generate_tag_array(std::size_t tag_count, std::vector<BuildWorkload::BuildWorkloadTag> &tags, std::vector<BuildWorkload::BuildWorkloadStruct> &structs) {
-        TAG_ARRAY_STRUCT.data.resize(sizeof(Tag) * tag_count);
+    void BuildWorkload::prefetch_dependencies(const Parser::ParserStruct &tag) {
+        std::vector<File::TagFilePath> dependencies;
+        get_tag_dependencies(tag, dependencies);
 
-        // Reserve tag paths
-        std::size_t potential_size = 0;
-        for(std::size_t t = 0; t < tag_count; t++) {
-            potential_size += tags[t].path.size() + 1;
+        for(auto &dependency : dependencies) {
+            auto path = File::remove_duplicate_slashes(dependency.path);
+            auto existing_tag = this->tag_lookup.find(path, dependency.fourcc);
+            if(existing_tag.has_value() && this->tags[*existing_tag].base_struct.has_value()) {
+                continue;
+            }
+            this->prefetcher->prefetch(File::halo_path_to_preferred_path(path + "." + tag_fourcc_to_extension(dependency.fourcc)));
+        }
+    }
+
+    void BuildWorkload::preload_tags(const std::vector<File::TagFilePath> &tags_to_preload) {
+        std::size_t thread_count = this->parameters->thread_count;
+        if(thread_count <= 1 || this->disable_recursion) {
+            return;
+        }
+
+        std::mutex preload_mutex;
+        std::condition_variable preload_condition;
+        std::deque<std::string> queue;
+        std::size_t busy_threads = 0;
+
+        // Queue the tag if it hasn't been queued before (preload_mutex must be locked if threads are running)
+        auto queue_tag = [&queue, this](const std::string &path, TagFourCC fourcc) {
+            auto formatted_path = File::halo_path_to_preferred_path(File::remove_duplicate_slashes(path) + "." + tag_fourcc_to_extension(fourcc));
+            if(this->preload_queued_tags.insert(formatted_path).second) {
+                queue.emplace_back(std::move(formatted_path));
+            }
+        };
+
+        for(auto &tag : tags_to_preload) {
+            queue_tag(tag.path, tag.fourcc);
+        }
+
+        auto preload_worker = [&]() {
+            std::unique_lock<std::mutex> lock(preload_mutex);
+            while(true) {
+                // Wait until we have something to do, or everyone is done
+                preload_condition.wait(lock, [&queue, &busy_threads]() { return !queue.empty() || busy_threads == 0; });
+                if(queue.empty()) {
+                    break;
+                }
+
+                auto formatted_path = std::move(queue.front());
+                queue.pop_front();
+                busy_threads++;
+                lock.unlock();
+
+                // Load and parse it. If anything fails, we leave it for the compile step to report.
+                PreloadedTag preloaded;
+                std::vector<File::TagFilePath> dependencies;
+                auto parse_start = std::chrono::steady_clock::now();
+                auto file_path = this->find_tag_file(formatted_path);
+                if(file_path.has_value()) {
+                    auto file_data = File::MemoryMappedFile::map_file(*file_path);
+                    if(file_data.has_value()) {
+                        try {
+                            preloaded.parsed = Parser::ParserStruct::parse_hek_tag_file(file_data->data(), file_data->size(), true);
+                            preloaded.data = std::make_shared<File::MemoryMappedFile>(std::move(*file_data));
+                            preloaded.parse_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - parse_start);
+
+                            get_tag_dependencies(*preloaded.parsed, dependencies);
+                        }
+                        catch(std::exception &) {
+                            preloaded.parsed.reset();
+                            dependencies.clear();
+                        }
+                    }
+                }
+
+                lock.lock();
+                if(preloaded.parsed) {
+                    this->preloaded_tags.emplace(formatted_path, std::move(preloaded));
+                    for(auto &dependency : dependencies) {
+                        queue_tag(dependency.path, dependency.fourcc);
+                    }
+                }
+                busy_threads--;
+                preload_condition.notify_all();
+            }
+        };
+
+        ThreadPool::shared().parallel_for(thread_count, [&preload_worker](std::size_t) { preload_worker(); }, thread_count);
+    }
+
+    BuildWorkload BuildWorkload::compile_single_tag(const std::byte *tag_data, std::size_t tag_data_size, const std::vector<std::filesystem::path> &tags_directories, bool recursion, bool error_checking) {
+        BuildWorkload workload = {};
+        workload.set_reporting_level(ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
+        workload.disable_recursion = !recursion;
+        workload.disable_error_checking = !error_checking;
+        workload.cache_file_type = HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER;
+
+        BuildParameters parameters;
+        parameters.tags_directories = tags_directories;
+        workload.set_build_parameters(parameters);
+
+        auto &tag = workload.tags.emplace_back();
+        tag.path = "unknown";
+        workload.index_tag(0);
+        workload.compile_tag_data_recursively(tag_data, tag_data_size, 0);
+        return workload;
+    }
+
+    BuildWorkload BuildWorkload::compile_single_tag(const char *tag, TagFourCC tag_fourcc, const std::vector<std::filesystem::path> &tags_directories, bool recursion, bool error_checking) {
+        BuildWorkload workload = {};
+
+        BuildParameters parameters;
+        parameters.tags_directories = tags_directories;
+        workload.set_build_parameters(parameters);
+
+        workload.set_reporting_level(ErrorHandler::ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING);
+        workload.disable_recursion = !recursion;
+        workload.disable_error_checking = !error_checking;
+        workload.cache_file_type = HEK::CacheFileType::SCENARIO_TYPE_MULTIPLAYER;
+        workload.compile_tag_recursively(tag, tag_fourcc);
+        return workload;
+    }
+
+    template <typename Tag, HEK::Pointer64 stub_address, bool native> static void do_generate_tag_array(std::size_t tag_count, std::vector<BuildWorkload::BuildWorkloadTag> &tags, std::vector<BuildWorkload::BuildWorkloadStruct> &structs) {
+        TAG_ARRAY_STRUCT.data.resize(sizeof(Tag) * tag_count);
+
+        // Reserve tag paths
+        std::size_t potential_size = 0;
+        for(std::size_t t = 0; t < tag_count; t++) {
+            potential_size += tags[t].path.size() + 1;
         }
         TAG_ARRAY_STRUCT.data.reserve(TAG_ARRAY_STRUCT.data.size() + potential_size);
 
@@ -1111,16 +1535,12 @@ namespace Invader {
                 tag_index.tag_data = *tag.resource_index;
             }
             else if(primary_class != TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP || native) {
-                auto &tag_data_ptr = TAG_ARRAY_STRUCT.pointers.emplace_back();
-                tag_data_ptr.offset = reinterpret_cast<std::byte *>(&tag_index.tag_data) - reinterpret_cast<std::byte *>(tag_array);
-                tag_data_ptr.struct_index = *tag.base_struct;
+                TAG_ARRAY_STRUCT.add_pointer(reinterpret_cast<std::byte *>(&tag_index.tag_data) - reinterpret_cast<std::byte *>(tag_array), *tag.base_struct);
             }
 
             // Tag ID
-            auto &tag_id = TAG_ARRAY_STRUCT.dependencies.emplace_back();
+            auto &tag_id = TAG_ARRAY_STRUCT.add_dependency(reinterpret_cast<std::byte *>(&tag_index.tag_id) - reinterpret_cast<std::byte *>(tag_array), t);
             tag_id.tag_id_only = true;
-            tag_id.offset = reinterpret_cast<std::byte *>(&tag_index.tag_id) - reinterpret_cast<std::byte *>(tag_array);
-            tag_id.tag_index = t;
 
             // Not strictly required to set the secondary or tertiary classes, but we do it anyway
             tag_index.primary_class = tag.tag_fourcc;
@@ -1176,6 +1596,47 @@ namespace Invader {
         }
     }
 
+    // Tags the game reads every frame, so keeping them together keeps them on the same pages
+    static bool is_hot_tag_group(TagFourCC tag_fourcc) noexcept {
+        switch(tag_fourcc) {
+            case TagFourCC::TAG_FOURCC_GLOBALS:
+            case TagFourCC::TAG_FOURCC_HUD_GLOBALS:
+            case TagFourCC::TAG_FOURCC_HUD_NUMBER:
+            case TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT:
+            case TagFourCC::TAG_FOURCC_UNIT_HUD_INTERFACE:
+            case TagFourCC::TAG_FOURCC_WEAPON_HUD_INTERFACE:
+            case TagFourCC::TAG_FOURCC_GRENADE_HUD_INTERFACE:
+            case TagFourCC::TAG_FOURCC_WEAPON:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Order in which to lay out what the tag data header and tag array point to: hot tags first, then the remaining tags, then anything else
+    static std::vector<std::size_t> plan_locality_layout(const std::vector<BuildWorkload::BuildWorkloadTag> &tags, const std::vector<BuildWorkload::BuildWorkloadStruct> &structs) {
+        std::vector<std::size_t> tag_roots;
+        std::vector<bool> in_tag_array(structs.size());
+        for(auto &pointer : TAG_ARRAY_STRUCT.pointers) {
+            tag_roots.emplace_back(pointer.struct_index);
+            in_tag_array[pointer.struct_index] = true;
+        }
+
+        // BSPs aren't in the tag array unless they're in the same tag space, so only go by what the tag array points to
+        std::vector<std::size_t> roots;
+        for(auto &tag : tags) {
+            if(tag.base_struct.has_value() && is_hot_tag_group(tag.tag_fourcc) && in_tag_array[*tag.base_struct]) {
+                roots.emplace_back(*tag.base_struct);
+            }
+        }
+        roots.insert(roots.end(), tag_roots.begin(), tag_roots.end());
+        for(auto &pointer : TAG_DATA_HEADER_STRUCT.pointers) {
+            roots.emplace_back(pointer.struct_index);
+        }
+
+        return roots;
+    }
+
     std::size_t BuildWorkload::generate_tag_data() {
         auto &structs = this->structs;
         auto &tags = this->tags;
@@ -1188,8 +1649,6 @@ namespace Invader {
             std::size_t to_offset;
         };
 
-        std::vector<PointerInternal> pointers;
-        std::vector<PointerInternal> pointers_64_bit;
         auto name_tag_data_pointer = this->parameters->details.build_tag_data_address;
         auto &tag_array_struct = TAG_ARRAY_STRUCT;
 
@@ -1199,7 +1658,11 @@ namespace Invader {
 
         auto &cache_version = this->parameters->details.build_cache_file_engine;
 
-        auto recursively_generate_data = [&structs, &tags, &pointers, &pointers_64_bit, &pointer_of_tag_path, &cache_version](std::vector<std::byte> &data, std::size_t struct_index, auto &recursively_generate_data) {
+        // Structs are laid out first so the tag data can be allocated once at its final size, and then each struct is
+        // copied straight to its offset rather than growing the tag data one struct at a time
+        std::vector<std::size_t> laid_out_structs;
+        std::size_t laid_out_size = 0;
+        auto recursively_lay_out_data = [&structs, &laid_out_structs, &laid_out_size](std::size_t struct_index, bool follow_pointers, auto &recursively_lay_out_data) -> void {
             auto &s = structs[struct_index];
 
             // Return the pointer thingy
@@ -1208,74 +1671,131 @@ namespace Invader {
             }
 
             // Set the offset thingy
-            std::size_t offset = data.size();
-            s.offset = offset;
-            data.insert(data.end(), s.data.begin(), s.data.end());
-
-            // Get the pointers
-            for(auto &pointer : s.pointers) {
-                recursively_generate_data(data, pointer.struct_index, recursively_generate_data);
-                PointerInternal pointer_internal { pointer.offset + offset, pointer.struct_index, pointer.struct_data_offset };
-                if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE || pointer.limit_to_32_bits) {
-                    pointers.emplace_back(pointer_internal);
-                }
-                else {
-                    pointers_64_bit.emplace_back(pointer_internal);
+            s.offset = laid_out_size;
+            laid_out_size += s.data.size();
+            laid_out_structs.emplace_back(struct_index);
+
+            // Follow the pointers
+            if(follow_pointers) {
+                for(auto &pointer : s.pointers) {
+                    recursively_lay_out_data(pointer.struct_index, true, recursively_lay_out_data);
                 }
             }
 
-            // Get the pointers
-            for(auto &dependency : s.dependencies) {
-                auto tag_index = dependency.tag_index;
-                std::uint32_t full_id = static_cast<std::uint32_t>((tag_index + 0x6174) | 0x8000) << 16 | static_cast<std::uint16_t>(tag_index); // salt = (0x6174 'at' | 0x8000) + index
-                HEK::TagID new_tag_id = { full_id };
+            // Append stuff
+            laid_out_size += REQUIRED_PADDING_32_BIT(laid_out_size);
+        };
+
+        auto write_laid_out_data = [&structs, &tags, &pointer_of_tag_path, &cache_version](const std::vector<std::size_t> &laid_out_structs, std::size_t laid_out_size, std::vector<std::byte> &data, std::vector<PointerInternal> &pointers, std::vector<PointerInternal> &pointers_64_bit) {
+            data.resize(laid_out_size);
 
-                if(dependency.tag_id_only) {
-                    *reinterpret_cast<HEK::LittleEndian<HEK::TagID> *>(data.data() + offset + dependency.offset) = new_tag_id;
+            for(auto struct_index : laid_out_structs) {
+                auto &s = structs[struct_index];
+                std::size_t offset = *s.offset;
+                std::copy(s.data.begin(), s.data.end(), data.begin() + offset);
+
+                // Get the pointers
+                for(auto &pointer : s.pointers) {
+                    PointerInternal pointer_internal { pointer.offset + offset, pointer.struct_index, pointer.struct_data_offset };
+                    if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE || pointer.limit_to_32_bits) {
+                        pointers.emplace_back(pointer_internal);
+                    }
+                    else {
+                        pointers_64_bit.emplace_back(pointer_internal);
+                    }
                 }
-                else {
-                    auto &dependency_struct = *reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(data.data() + offset + dependency.offset);
-                    dependency_struct.tag_fourcc = tags[tag_index].tag_fourcc;
-                    dependency_struct.tag_id = new_tag_id;
-                    if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                        dependency_struct.path_pointer = pointer_of_tag_path(tag_index);
+
+                // Get the pointers
+                for(auto &dependency : s.dependencies) {
+                    auto tag_index = dependency.tag_index;
+                    std::uint32_t full_id = static_cast<std::uint32_t>((tag_index + 0x6174) | 0x8000) << 16 | static_cast<std::uint16_t>(tag_index); // salt = (0x6174 'at' | 0x8000) + index
+                    HEK::TagID new_tag_id = { full_id };
+
+                    if(dependency.tag_id_only) {
+                        *reinterpret_cast<HEK::LittleEndian<HEK::TagID> *>(data.data() + offset + dependency.offset) = new_tag_id;
+                    }
+                    else {
+                        auto &dependency_struct = *reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(data.data() + offset + dependency.offset);
+                        dependency_struct.tag_fourcc = tags[tag_index].tag_fourcc;
+                        dependency_struct.tag_id = new_tag_id;
+                        if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                            dependency_struct.path_pointer = pointer_of_tag_path(tag_index);
+                        }
                     }
                 }
             }
-
-            // Append stuff
-            data.insert(data.end(), REQUIRED_PADDING_32_BIT(data.size()), std::byte());
         };
 
         // Build the tag data for the main tag data
-        auto &tag_data_struct = this->map_data_structs.emplace_back();
-        recursively_generate_data(tag_data_struct, 0, recursively_generate_data);
-        auto *tag_data_b = tag_data_struct.data();
+        if(this->parameters->stable_layout_path.has_value()) {
+            // Keep the header and tag array in front, then put each tag's structs where they were in the previous build
+            // if they still fit there, or after everything from the previous build if not
+            recursively_lay_out_data(0, false, recursively_lay_out_data);
+            recursively_lay_out_data(1, false, recursively_lay_out_data);
+            std::size_t header_end = laid_out_size;
+            laid_out_size = std::max(laid_out_size, this->stable_tag_data_layout.previous_size);
+
+            std::vector<bool> in_tag_array(structs.size());
+            for(auto &pointer : TAG_ARRAY_STRUCT.pointers) {
+                in_tag_array[pointer.struct_index] = true;
+            }
+            for(std::size_t t = 0; t < tag_count; t++) {
+                auto &tag = tags[t];
+                if(!tag.base_struct.has_value() || !in_tag_array[*tag.base_struct]) {
+                    continue;
+                }
 
-        // Adjust the pointers
-        for(auto &p : pointers) {
-            *reinterpret_cast<HEK::LittleEndian<HEK::Pointer> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer>(name_tag_data_pointer + *this->structs[p.to_struct].offset + p.to_offset);
+                // Lay it out at the end, then move it if it goes somewhere else
+                std::size_t first_struct = laid_out_structs.size();
+                std::size_t offset = laid_out_size;
+                recursively_lay_out_data(*tag.base_struct, true, recursively_lay_out_data);
+                std::size_t new_offset = this->place_stable_layout_data(this->stable_tag_data_layout, t, offset, laid_out_size - offset, header_end);
+                if(new_offset != offset) {
+                    for(std::size_t s = first_struct; s < laid_out_structs.size(); s++) {
+                        *structs[laid_out_structs[s]].offset = *structs[laid_out_structs[s]].offset - offset + new_offset;
+                    }
+                    laid_out_size = offset;
+                }
+            }
+            for(auto &pointer : TAG_DATA_HEADER_STRUCT.pointers) {
+                recursively_lay_out_data(pointer.struct_index, true, recursively_lay_out_data);
+            }
         }
-
-        for(auto &p : pointers_64_bit) {
-            *reinterpret_cast<HEK::LittleEndian<HEK::Pointer64> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer64>(name_tag_data_pointer + *this->structs[p.to_struct].offset + p.to_offset);
+        else if(this->parameters->locality_layout) {
+            // Keep the header and tag array in front, then lay out each tag's structs together, starting with the hot ones
+            recursively_lay_out_data(0, false, recursively_lay_out_data);
+            recursively_lay_out_data(1, false, recursively_lay_out_data);
+            for(auto root : plan_locality_layout(tags, structs)) {
+                recursively_lay_out_data(root, true, recursively_lay_out_data);
+            }
         }
-
-        // Get the tag path pointers working
-        auto *tag_array = reinterpret_cast<HEK::CacheFileTagDataTag *>(tag_data_struct.data() + *TAG_ARRAY_STRUCT.offset);
-        for(std::size_t t = 0; t < tag_count; t++) {
-            tag_array[t].tag_path = pointer_of_tag_path(t);
+        else {
+            recursively_lay_out_data(0, true, recursively_lay_out_data);
         }
+        std::vector<std::size_t> tag_data_structs = std::move(laid_out_structs);
+        std::size_t tag_data_size = laid_out_size;
+        laid_out_structs.clear();
+        laid_out_size = 0;
 
         // Get this set
         std::size_t bsp_end = this->bsp_offset;
 
-        // Get the scenario tag (if we're not on a native map)
+        // BSPs (if we're not on a native map) get their own tag data with their own base address, and they're laid out
+        // after the main tag data so anything they share with it stays there
+        struct BSPTagData {
+            std::size_t tag_index;
+            std::vector<std::size_t> laid_out_structs;
+            std::size_t laid_out_size;
+            std::size_t bsp_size = 0;
+            HEK::Pointer64 tag_data_base = 0;
+        };
+        std::vector<BSPTagData> bsps;
+        std::size_t bsp_count = 0;
+
         if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
             auto &scenario_tag = tags[this->scenario_index];
             auto &scenario_tag_data = *reinterpret_cast<const Parser::Scenario::struct_little *>(structs[*scenario_tag.base_struct].data.data());
-            std::size_t bsp_count = scenario_tag_data.structure_bsps.count.read();
-            std::size_t max_bsp_size = this->parameters->details.build_maximum_tag_space;
+            bsp_count = scenario_tag_data.structure_bsps.count.read();
 
             if(bsp_count != this->bsp_count) {
                 oprintf("\n");
@@ -1283,93 +1803,143 @@ namespace Invader {
                 throw InvalidTagDataException();
             }
             else if(bsp_count) {
-                auto scenario_bsps_struct_index = *structs[*scenario_tag.base_struct].resolve_pointer(reinterpret_cast<const std::byte *>(&scenario_tag_data.structure_bsps.pointer) - reinterpret_cast<const std::byte *>(&scenario_tag_data));
-                auto *scenario_bsps_struct_data = reinterpret_cast<Parser::ScenarioBSP::struct_little *>(map_data_structs[0].data() + *structs[scenario_bsps_struct_index].offset);
-
-                // Go through each BSP tag
                 for(std::size_t i = 0; i < tag_count; i++) {
                     auto &t = tags[i];
                     if(t.tag_fourcc != TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP) {
                         continue;
                     }
 
-                    // Do it!
-                    auto &base_struct = *t.base_struct;
-                    // Build the tag data for the BSP data now
-                    pointers.clear();
-                    pointers_64_bit.clear();
-                    auto &bsp_data_struct = this->map_data_structs.emplace_back();
-                    recursively_generate_data(bsp_data_struct, base_struct, recursively_generate_data);
+                    recursively_lay_out_data(*t.base_struct, true, recursively_lay_out_data);
+                    auto &bsp = bsps.emplace_back();
+                    bsp.tag_index = i;
+                    bsp.laid_out_structs = std::move(laid_out_structs);
+                    bsp.laid_out_size = laid_out_size;
+                    laid_out_structs.clear();
+                    laid_out_size = 0;
+                }
+            }
+        }
 
-                    std::size_t bsp_size = bsp_data_struct.size();
+        // Laying out only picks the offsets, so the main tag data and each BSP's tag data can now be built at the same time
+        this->map_data_structs.resize(1 + bsps.size());
+        std::size_t max_bsp_size = this->parameters->details.build_maximum_tag_space;
+        ThreadPool::shared().parallel_for(1 + bsps.size(), [this, &structs, &tags, &tag_count, &bsps, &tag_data_structs, &tag_data_size, &write_laid_out_data, &pointer_of_tag_path, &name_tag_data_pointer, &cache_version, &max_bsp_size](std::size_t m) {
+            std::vector<PointerInternal> pointers;
+            std::vector<PointerInternal> pointers_64_bit;
+            auto &data = this->map_data_structs[m];
 
-                    // Resize the BSP to 2048 bytes alignment if on Xbox
-                    if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-                        bsp_size = bsp_size + REQUIRED_PADDING_N_BYTES(bsp_size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE * 4);
-                        bsp_data_struct.resize(bsp_size);
-                    }
+            // Build the tag data for the main tag data
+            if(m == 0) {
+                write_laid_out_data(tag_data_structs, tag_data_size, data, pointers, pointers_64_bit);
+                auto *tag_data_b = data.data();
 
-                    if(bsp_size > max_bsp_size) {
-                        oprintf("\n");
-                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_FATAL_ERROR, i, "BSP size exceeds the maximum size for this engine (%zu > %zu)", bsp_size, max_bsp_size);
-                        throw InvalidTagDataException();
-                    }
+                // Adjust the pointers
+                for(auto &p : pointers) {
+                    *reinterpret_cast<HEK::LittleEndian<HEK::Pointer> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer>(name_tag_data_pointer + *this->structs[p.to_struct].offset + p.to_offset);
+                }
 
-                    HEK::Pointer64 tag_data_base;
-                    if(cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                        tag_data_base = this->parameters->details.build_tag_data_address + this->parameters->details.build_maximum_tag_space - bsp_size;
-                        if(static_cast<std::uint32_t>(tag_data_base + bsp_size) != static_cast<std::uint64_t>(tag_data_base + bsp_size)) {
-                            oprintf("\n");
-                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_FATAL_ERROR, i, "Tag space overflows BSP past 0x00000000");
-                            throw InvalidTagDataException();
-                        }
-                    }
-                    else {
-                        tag_data_base = 0;
-                    }
-                    tag_data_b = bsp_data_struct.data();
+                for(auto &p : pointers_64_bit) {
+                    *reinterpret_cast<HEK::LittleEndian<HEK::Pointer64> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer64>(name_tag_data_pointer + *this->structs[p.to_struct].offset + p.to_offset);
+                }
 
-                    // Chu
-                    for(auto &p : pointers) {
-                        auto &struct_pointed_to = this->structs[p.to_struct];
-                        auto base = struct_pointed_to.bsp.has_value() ? tag_data_base : name_tag_data_pointer;
-                        *reinterpret_cast<HEK::LittleEndian<HEK::Pointer> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer>(base + *struct_pointed_to.offset + p.to_offset);
-                    }
-                    for(auto &p : pointers_64_bit) {
-                        auto &struct_pointed_to = this->structs[p.to_struct];
-                        auto base = struct_pointed_to.bsp.has_value() ? tag_data_base : name_tag_data_pointer;
-                        *reinterpret_cast<HEK::LittleEndian<HEK::Pointer64> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer64>(base + *struct_pointed_to.offset + p.to_offset);
-                    }
+                // Get the tag path pointers working
+                auto *tag_array = reinterpret_cast<HEK::CacheFileTagDataTag *>(tag_data_b + *TAG_ARRAY_STRUCT.offset);
+                for(std::size_t t = 0; t < tag_count; t++) {
+                    tag_array[t].tag_path = pointer_of_tag_path(t);
+                }
+                return;
+            }
 
-                    // Find the BSP in the scenario array thingy
-                    bool found = false;
-                    for(std::size_t b = 0; b < bsp_count; b++) {
-                        if(scenario_bsps_struct_data[b].structure_bsp.tag_id.read().index == i) {
-                            scenario_bsps_struct_data[b].bsp_address = tag_data_base;
-                            scenario_bsps_struct_data[b].bsp_size = bsp_size;
-                            scenario_bsps_struct_data[b].bsp_start = bsp_end;
-                            found = true;
-                        }
-                    }
+            // Build the tag data for the BSP data now
+            auto &bsp = bsps[m - 1];
+            write_laid_out_data(bsp.laid_out_structs, bsp.laid_out_size, data, pointers, pointers_64_bit);
 
-                    // Add up the size
-                    bsp_end += bsp_size;
+            std::size_t bsp_size = data.size();
 
-                    if(!found) {
-                        oprintf("\n");
-                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, this->scenario_index, "Scenario structure BSP array is missing %s.%s", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
+            // Resize the BSP to 2048 bytes alignment if on Xbox
+            if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+                bsp_size = bsp_size + REQUIRED_PADDING_N_BYTES(bsp_size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE * 4);
+                data.resize(bsp_size);
+            }
+            bsp.bsp_size = bsp_size;
+
+            // This is checked afterwards
+            if(bsp_size > max_bsp_size) {
+                return;
+            }
+
+            HEK::Pointer64 tag_data_base = this->parameters->details.build_tag_data_address + max_bsp_size - bsp_size;
+            bsp.tag_data_base = tag_data_base;
+            auto *tag_data_b = data.data();
+
+            // Chu
+            for(auto &p : pointers) {
+                auto &struct_pointed_to = this->structs[p.to_struct];
+                auto base = struct_pointed_to.bsp.has_value() ? tag_data_base : name_tag_data_pointer;
+                *reinterpret_cast<HEK::LittleEndian<HEK::Pointer> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer>(base + *struct_pointed_to.offset + p.to_offset);
+            }
+            for(auto &p : pointers_64_bit) {
+                auto &struct_pointed_to = this->structs[p.to_struct];
+                auto base = struct_pointed_to.bsp.has_value() ? tag_data_base : name_tag_data_pointer;
+                *reinterpret_cast<HEK::LittleEndian<HEK::Pointer64> *>(tag_data_b + p.from_offset) = static_cast<HEK::Pointer64>(base + *struct_pointed_to.offset + p.to_offset);
+            }
+        });
+
+        if(!bsps.empty()) {
+            auto &scenario_tag = tags[this->scenario_index];
+            auto &scenario_tag_data = *reinterpret_cast<const Parser::Scenario::struct_little *>(structs[*scenario_tag.base_struct].data.data());
+            auto scenario_bsps_struct_index = *structs[*scenario_tag.base_struct].resolve_pointer(reinterpret_cast<const std::byte *>(&scenario_tag_data.structure_bsps.pointer) - reinterpret_cast<const std::byte *>(&scenario_tag_data));
+            auto *scenario_bsps_struct_data = reinterpret_cast<Parser::ScenarioBSP::struct_little *>(map_data_structs[0].data() + *structs[scenario_bsps_struct_index].offset);
+
+            // Go through each BSP tag
+            for(auto &bsp : bsps) {
+                auto i = bsp.tag_index;
+                auto &t = tags[i];
+                auto bsp_size = bsp.bsp_size;
+                auto tag_data_base = bsp.tag_data_base;
+
+                if(bsp_size > max_bsp_size) {
+                    oprintf("\n");
+                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_FATAL_ERROR, i, "BSP size exceeds the maximum size for this engine (%zu > %zu)", bsp_size, max_bsp_size);
+                    throw InvalidTagDataException();
+                }
+
+                if(static_cast<std::uint32_t>(tag_data_base + bsp_size) != static_cast<std::uint64_t>(tag_data_base + bsp_size)) {
+                    oprintf("\n");
+                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_FATAL_ERROR, i, "Tag space overflows BSP past 0x00000000");
+                    throw InvalidTagDataException();
+                }
+
+                // Find the BSP in the scenario array thingy
+                bool found = false;
+                for(std::size_t b = 0; b < bsp_count; b++) {
+                    if(scenario_bsps_struct_data[b].structure_bsp.tag_id.read().index == i) {
+                        scenario_bsps_struct_data[b].bsp_address = tag_data_base;
+                        scenario_bsps_struct_data[b].bsp_size = bsp_size;
+                        scenario_bsps_struct_data[b].bsp_start = bsp_end;
+                        found = true;
                     }
                 }
+
+                // Add up the size
+                bsp_end += bsp_size;
+
+                if(!found) {
+                    oprintf("\n");
+                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, this->scenario_index, "Scenario structure BSP array is missing %s.%s", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
+                }
             }
         }
         return bsp_end;
     }
 
+    // Hash an asset's size and contents for bucketing exact duplicates. Assets can be megabytes, so this goes eight
+    // bytes at a time rather than byte by byte.
     void BuildWorkload::generate_bitmap_sound_data(std::size_t file_offset) {
         // Prepare for the worst
         std::size_t total_raw_data_size = 0;
-        for(auto &r : this->raw_data) {
-            total_raw_data_size += r.size();
+        for(std::size_t r = 0; r < this->raw_data.size(); r++) {
+            total_raw_data_size += this->get_raw_data_size(r);
         }
         auto &all_raw_data = this->all_raw_data;
         all_raw_data.reserve(total_raw_data_size);
@@ -1378,20 +1948,30 @@ namespace Invader {
         // Offset followed by size
         std::vector<std::pair<std::size_t, std::size_t>> all_assets;
 
-        auto add_or_dedupe_asset = [&all_assets, &all_raw_data, &cache_version](const std::vector<std::byte> &raw_data, std::size_t &counter) -> std::uint32_t {
+        // Asset indices by hash, so only assets that are probably identical get compared
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> asset_buckets;
+        asset_buckets.reserve(this->raw_data.size());
+
+        auto add_or_dedupe_asset = [&all_assets, &asset_buckets, &all_raw_data, &cache_version](const std::vector<std::byte> &raw_data, std::size_t &counter) -> std::uint32_t {
             std::size_t raw_data_size = raw_data.size();
-            for(auto &a : all_assets) {
-                if(a.second == raw_data_size && std::memcmp(raw_data.data(), all_raw_data.data() + a.first, raw_data_size) == 0) {
-                    return static_cast<std::uint32_t>(&a - all_assets.data());
+            auto &bucket = asset_buckets[FNV1AHash::hash_words(raw_data.data(), raw_data.size())];
+            for(auto a : bucket) {
+                auto &asset = all_assets[a];
+                if(asset.second == raw_data_size && std::memcmp(raw_data.data(), all_raw_data.data() + asset.first, raw_data_size) == 0) {
+                    return a;
                 }
             }
 
-            // Pad to 512 bytes if Xbox
+            // Pad to 512 bytes if Xbox, or align it so it can be used in place if native
             auto all_raw_data_offset = all_raw_data.size();
             if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
                 all_raw_data_offset += REQUIRED_PADDING_N_BYTES(all_raw_data_offset, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
                 all_raw_data.resize(all_raw_data_offset);
             }
+            else if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                all_raw_data_offset += REQUIRED_PADDING_N_BYTES(all_raw_data_offset, HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_ASSET_ALIGNMENT);
+                all_raw_data.resize(all_raw_data_offset);
+            }
 
             // Add the new asset
             auto &new_asset = all_assets.emplace_back();
@@ -1399,16 +1979,43 @@ namespace Invader {
             new_asset.second = raw_data_size;
             counter += raw_data_size;
             all_raw_data.insert(all_raw_data.end(), raw_data.begin(), raw_data.end());
-            return static_cast<std::uint32_t>(all_assets.size() - 1);
+            auto new_index = static_cast<std::uint32_t>(all_assets.size() - 1);
+            bucket.emplace_back(new_index);
+            return new_index;
         };
 
+        // If using a stable layout, each tag's assets are aligned together so they can be moved to where they were in the
+        // previous build, and anything that doesn't fit there goes after everything from the previous build
+        bool stable_layout = this->parameters->stable_layout_path.has_value();
+        std::size_t stable_layout_alignment = 1;
+        if(cache_version == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            stable_layout_alignment = HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE;
+        }
+        else if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            stable_layout_alignment = HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_ASSET_ALIGNMENT;
+        }
+        if(stable_layout) {
+            all_raw_data.reserve(total_raw_data_size + this->stable_raw_data_layout.previous_size);
+            all_raw_data.resize(this->stable_raw_data_layout.previous_size);
+        }
+
+        // Offsets to set once the tag's assets are where they're going (not used on native maps, which use indices)
+        std::vector<std::pair<LittleEndian<std::uint32_t> *, std::uint32_t>> asset_offsets;
+
         // Go through each tag
-        for(auto &t : this->tags) {
+        for(std::size_t tag_index = 0; tag_index < this->tags.size(); tag_index++) {
+            auto &t = this->tags[tag_index];
             auto asset_count = t.asset_data.size();
             if(t.resource_index.has_value() || asset_count == 0 || t.external_asset_data) {
                 continue;
             }
             std::size_t resource_index = 0;
+            if(stable_layout) {
+                all_raw_data.resize(all_raw_data.size() + REQUIRED_PADDING_N_BYTES(all_raw_data.size(), stable_layout_alignment));
+            }
+            std::size_t first_asset = all_assets.size();
+            std::size_t tag_assets_offset = all_raw_data.size();
+            asset_offsets.clear();
             if(t.tag_fourcc == TagFourCC::TAG_FOURCC_BITMAP) {
                 auto &bitmap_struct = this->structs[*t.base_struct];
                 auto &bitmap_header = *reinterpret_cast<Parser::Bitmap::struct_little *>(bitmap_struct.data.data());
@@ -1422,12 +2029,12 @@ namespace Invader {
                     }
 
                     // Put it in its place
-                    auto resource_index = add_or_dedupe_asset(this->raw_data[index], this->raw_bitmap_size);
+                    auto resource_index = add_or_dedupe_asset(this->get_raw_data(index), this->raw_bitmap_size);
                     if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                         bitmap_data.pixel_data_offset = resource_index;
                     }
                     else {
-                        bitmap_data.pixel_data_offset = all_assets[resource_index].first + file_offset;
+                        asset_offsets.emplace_back(&bitmap_data.pixel_data_offset, resource_index);
                     }
 
                     // Set this size to be correct
@@ -1454,16 +2061,33 @@ namespace Invader {
                         }
 
                         // Put it in its place
-                        auto resource_index = add_or_dedupe_asset(this->raw_data[index], this->raw_sound_size);
+                        auto resource_index = add_or_dedupe_asset(this->get_raw_data(index), this->raw_sound_size);
                         if(cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
                             permutation.samples.file_offset = resource_index;
                         }
                         else {
-                            permutation.samples.file_offset = all_assets[resource_index].first + file_offset;
+                            asset_offsets.emplace_back(&permutation.samples.file_offset, resource_index);
                         }
                     }
                 }
             }
+
+            // Move the tag's new assets back to where they were in the previous build if they fit
+            if(stable_layout) {
+                std::size_t tag_assets_size = all_raw_data.size() - tag_assets_offset;
+                std::size_t new_offset = this->place_stable_layout_data(this->stable_raw_data_layout, tag_index, tag_assets_offset, tag_assets_size, 0);
+                if(new_offset != tag_assets_offset) {
+                    std::copy(all_raw_data.begin() + tag_assets_offset, all_raw_data.end(), all_raw_data.begin() + new_offset);
+                    all_raw_data.resize(tag_assets_offset);
+                    for(std::size_t a = first_asset; a < all_assets.size(); a++) {
+                        all_assets[a].first = all_assets[a].first - tag_assets_offset + new_offset;
+                    }
+                }
+            }
+
+            for(auto &[offset, asset_index] : asset_offsets) {
+                *offset = static_cast<std::uint32_t>(all_assets[asset_index].first + file_offset);
+            }
         }
 
         // Put the offsets in an array
@@ -1472,6 +2096,7 @@ namespace Invader {
             for(auto &i : all_assets) {
                 offsets.emplace_back(i.first + file_offset);
             }
+            this->all_raw_data.resize(this->all_raw_data.size() + REQUIRED_PADDING_N_BYTES(this->all_raw_data.size(), HEK::CacheFileNativeConstants::CACHE_FILE_NATIVE_ASSET_ALIGNMENT));
             this->raw_data_indices_offset = this->all_raw_data.size() + file_offset;
             this->all_raw_data.insert(this->all_raw_data.end(), reinterpret_cast<const std::byte *>(offsets.data()), reinterpret_cast<const std::byte *>(offsets.data() + offsets.size()));
         }
@@ -1501,642 +2126,160 @@ namespace Invader {
 
         bool check_ce_bounds = this->parameters->details.build_check_custom_edition_resource_map_bounds;
 
-        switch(this->parameters->details.build_cache_file_engine) {
-            case HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION:
-                for(auto &t : this->tags) {
-                    // Find the tag
-                    auto find_tag_index = [](const std::string &path, const std::optional<std::vector<Resource>> &resources, bool every_other) -> std::optional<std::size_t> {
-                        if(!resources.has_value()) {
-                            return std::nullopt;
-                        }
+        // Index the resource maps so we don't have to go through every resource for every tag
+        std::optional<ResourceMapIndex> bitmaps_index, sounds_index, loc_index;
+        if(bitmaps.has_value()) {
+            bitmaps_index.emplace(*bitmaps);
+        }
+        if(sounds.has_value()) {
+            sounds_index.emplace(*sounds);
+        }
+        if(loc.has_value()) {
+            loc_index.emplace(*loc);
+        }
 
-                        std::size_t count = resources->size();
-                        std::size_t iterate_count, iterate_start;
-                        if(every_other) {
-                            iterate_count = 2;
-                            iterate_start = 1;
-                        }
-                        else {
-                            iterate_count = 1;
-                            iterate_start = 0;
-                        }
-                        for(std::size_t i = iterate_start; i < count; i += iterate_count) {
-                            if((*resources)[i].path == path) {
-                                return i;
-                            }
-                        }
+        switch(this->parameters->details.build_cache_file_engine) {
+            case HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION: {
+                // Find the tag
+                auto find_tag_index = [](const std::string &path, const std::optional<ResourceMapIndex> &resources_index, bool every_other) -> std::optional<std::size_t> {
+                    if(!resources_index.has_value()) {
                         return std::nullopt;
-                    };
+                    }
+                    return resources_index->find_path(path, every_other);
+                };
+
+                // Checking a tag against its resource only reads the tag and the resource map, so check them all at once
+                struct ResourceMatch {
+                    std::optional<std::size_t> index;
+                    bool match;
+                    ResourceMatchErrors errors;
+                };
+                std::size_t tag_count = this->tags.size();
+                std::vector<ResourceMatch> matches(tag_count, ResourceMatch { std::nullopt, false, ResourceMatchErrors(*this) });
+
+                ThreadPool::shared().parallel_for(tag_count, [this, &matches, &find_tag_index, &bitmaps, &sounds, &loc, &bitmaps_index, &sounds_index, &loc_index, &always_index_tags, &check_ce_bounds](std::size_t i) {
+                    auto &t = this->tags[i];
+                    auto &m = matches[i];
+                    std::vector<std::byte> buffer;
 
                     switch(t.tag_fourcc) {
                         case TagFourCC::TAG_FOURCC_BITMAP: {
-                            auto index = find_tag_index(t.path, bitmaps, true);
-                            if(index.has_value()) {
-                                if((*index % 2) == 0) {
-                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (tag is on an even index)", File::halo_path_to_preferred_path(t.path).c_str());
-                                    break;
-                                }
-
-                                if(check_ce_bounds && (*index / 2 > get_default_bitmap_resources_count() || File::split_tag_class_extension_chars(get_default_bitmap_resources()[*index / 2])->path != t.path)) {
-                                    break;
-                                }
-
-                                bool match = true;
-                                if(!always_index_tags) {
-                                    const auto &bitmap_tag_struct = this->structs[*t.base_struct];
-                                    const auto &bitmap_tag = *reinterpret_cast<const Parser::Bitmap::struct_little *>(bitmap_tag_struct.data.data());
-                                    const auto &bitmap_tag_struct_other = (*bitmaps)[*index];
-                                    const auto *bitmap_tag_struct_other_data = bitmap_tag_struct_other.data.data();
-                                    std::size_t bitmap_tag_struct_other_size = bitmap_tag_struct_other.data.size();
-
-                                    if(bitmap_tag_struct_other_size < sizeof(bitmap_tag)) {
-                                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (bitmap main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                        match = false;
-                                        break;
-                                    }
-
-                                    const auto &bitmap_tag_struct_other_raw = (*bitmaps)[*index - 1];
-                                    const auto *bitmap_tag_struct_other_raw_data = bitmap_tag_struct_other_raw.data.data();
-                                    std::size_t bitmap_tag_struct_other_raw_data_size = bitmap_tag_struct_other_raw.data.size();
-
-                                    std::size_t bitmap_tag_struct_raw_data_translation = bitmap_tag_struct_other_raw.data_offset;
-                                    const auto &bitmap_tag_other = *reinterpret_cast<const Parser::Bitmap::struct_little *>(bitmap_tag_struct_other_data);
-                                    std::size_t bitmap_data_count = bitmap_tag.bitmap_data.count;
-                                    std::size_t bitmap_data_other_count = bitmap_tag_other.bitmap_data.count;
-                                    std::size_t sequence_count = bitmap_tag.bitmap_group_sequence.count;
-                                    std::size_t sequence_other_count = bitmap_tag_other.bitmap_group_sequence.count;
-
-                                    // Make sure the bitmap type matches, first off
-                                    if(bitmap_tag_other.type == bitmap_tag.type) {
-                                        // Make sure our sequences match
-                                        if(match && sequence_count > 0 && sequence_count == sequence_other_count) {
-                                            // Make sure it's not out-of-bounds
-                                            const auto *all_sequence_other = reinterpret_cast<const Parser::BitmapGroupSequence::struct_little *>(bitmap_tag_struct_other_data + bitmap_tag_other.bitmap_group_sequence.pointer);
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_sequence_other + sequence_other_count) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (sequence data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            // Also get the bitmap sequences we have
-                                            auto &sequence_struct = this->structs[*bitmap_tag_struct.resolve_pointer(&bitmap_tag.bitmap_group_sequence.pointer)];
-                                            const auto *all_sequence = reinterpret_cast<const Parser::BitmapGroupSequence::struct_little *>(sequence_struct.data.data());
-
-                                            if(bitmap_tag_other.type == BitmapType::BITMAP_TYPE_SPRITES) {
-                                                for(std::size_t s = 0; s < sequence_count && match; s++) {
-                                                    // Get sequence data
-                                                    const auto &sequence = all_sequence[s];
-                                                    const auto &sequence_other = all_sequence_other[s];
-
-                                                    // Make sure the sprites match
-                                                    std::size_t sprite_count = sequence.sprites.count;
-                                                    std::size_t sprite_count_other = sequence_other.sprites.count;
-
-                                                    if(sprite_count > 0 && sprite_count == sprite_count_other) {
-                                                        // Make sure it's not out-of-bounds
-                                                        const auto *all_sprites_other = reinterpret_cast<const Parser::BitmapGroupSprite::struct_little *>(bitmap_tag_struct_other_data + sequence_other.sprites.pointer);
-                                                        if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_sprites_other + sprite_count_other) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
-                                                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (sequence sprites goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                            match = false;
-                                                            break;
-                                                        }
-
-                                                        // And get our sprites, too
-                                                        auto &sprites_struct = this->structs[*sequence_struct.resolve_pointer(&sequence.sprites.pointer)];
-                                                        const auto *all_sprites = reinterpret_cast<const Parser::BitmapGroupSprite::struct_little *>(sprites_struct.data.data());
-
-                                                        // Check individual sprites to make sure they match
-                                                        for(std::size_t sp = 0; sp < sprite_count && match; sp++) {
-                                                            const auto &sprite = all_sprites[sp];
-                                                            const auto &sprite_other = all_sprites_other[sp];
-                                                            match = match && sprite.bitmap_index == sprite_other.bitmap_index;
-                                                            match = match && sprite.bottom == sprite_other.bottom;
-                                                            match = match && sprite.left == sprite_other.left;
-                                                            match = match && sprite.top == sprite_other.top;
-                                                            match = match && sprite.right == sprite_other.right;
-                                                            match = match && sprite.registration_point == sprite_other.registration_point;
-                                                        }
-                                                    }
-                                                    else {
-                                                        match = match && sprite_count == sprite_count_other;
-                                                    }
-                                                }
-                                            }
-                                            else {
-                                                for(std::size_t s = 0; s < sequence_count && match; s++) {
-                                                    // Get sequence data
-                                                    const auto &sequence = all_sequence[s];
-                                                    const auto &sequence_other = all_sequence_other[s];
-
-                                                    // Make sure the bitmap range matches
-                                                    match = match && sequence.bitmap_count == sequence_other.bitmap_count;
-                                                    match = match && sequence.first_bitmap_index == sequence_other.first_bitmap_index;
-                                                }
-                                            }
-                                        }
-                                        else {
-                                            match = match && sequence_count == sequence_other_count;
-                                        }
-
-                                        // Make sure we have the same number of bitmap data
-                                        if(match && bitmap_data_count > 0 && bitmap_data_count == bitmap_data_other_count) {
-                                            // Make sure it's not out-of-bounds
-                                            const auto *all_bitmap_data_other = reinterpret_cast<const Parser::BitmapData::struct_little *>(bitmap_tag_struct_other_data + bitmap_tag_other.bitmap_data.pointer);
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_bitmap_data_other + bitmap_data_other_count) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (bitmap data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            // Also get the bitmap data we have
-                                            auto &bitmap_data_struct = this->structs[*bitmap_tag_struct.resolve_pointer(&bitmap_tag.bitmap_data.pointer)];
-                                            const auto *all_bitmap_data = reinterpret_cast<const Parser::BitmapData::struct_little *>(bitmap_data_struct.data.data());
-
-                                            // Make sure we get match to equal the bitmap data count
-                                            for(std::size_t b = 0; b < bitmap_data_count && match; b++) {
-                                                // Get the bitmap data
-                                                const auto &bitmap_data = all_bitmap_data[b];
-                                                const auto &bitmap_data_other = all_bitmap_data_other[b];
-
-                                                // Get the raw data and make sure the sizes match
-                                                std::size_t raw_data_index = t.asset_data[b];
-                                                auto &asset_raw_data = this->raw_data[raw_data_index];
-                                                std::size_t raw_data_size = asset_raw_data.size();
-                                                std::size_t raw_data_other_size = bitmap_data_other.pixel_data_size;
-                                                if(raw_data_other_size != raw_data_size) {
-                                                    match = false;
-                                                    break;
-                                                }
-
-                                                // Make sure the formats and dimensions match too
-                                                match = match && bitmap_data_other.width == bitmap_data.width;
-                                                match = match && bitmap_data_other.height == bitmap_data.height;
-                                                match = match && bitmap_data_other.depth == bitmap_data.depth;
-                                                match = match && bitmap_data_other.mipmap_count == bitmap_data.mipmap_count;
-                                                match = match && bitmap_data_other.format == bitmap_data.format;
-                                                if(!match) {
-                                                    break;
-                                                }
-
-                                                auto *raw_data_data = asset_raw_data.data();
-                                                auto *raw_data_other_data = bitmap_tag_struct_other_raw_data + bitmap_data_other.pixel_data_offset - bitmap_tag_struct_raw_data_translation;
+                            auto index = find_tag_index(t.path, bitmaps_index, true);
+                            if(!index.has_value()) {
+                                break;
+                            }
 
-                                                // Make sure it's not bullshit
-                                                if(raw_data_other_data < bitmap_tag_struct_other_raw_data || raw_data_other_data > (bitmap_tag_struct_other_raw_data + bitmap_tag_struct_other_raw_data_size)) {
-                                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (pixel data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                    match = false;
-                                                    break;
-                                                }
+                            if((*index % 2) == 0) {
+                                REPORT_ERROR_PRINTF(m.errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (tag is on an even index)", File::halo_path_to_preferred_path(t.path).c_str());
+                                break;
+                            }
 
-                                                // Check the data
-                                                match = std::memcmp(raw_data_other_data, raw_data_data, raw_data_size) == 0;
-                                            }
-                                        }
-                                        else {
-                                            match = match && bitmap_data_count == bitmap_data_other_count;
-                                        }
-                                    }
-                                    else {
-                                        match = false;
-                                    }
-                                }
+                            if(check_ce_bounds && (*index / 2 > get_default_bitmap_resources_count() || File::split_tag_class_extension_chars(get_default_bitmap_resources()[*index / 2])->path != t.path)) {
+                                break;
+                            }
 
-                                if(match) {
-                                    t.resource_index = index;
-                                    this->indexed_data_amount += (*bitmaps)[*index].data.size();
-                                    t.base_struct = std::nullopt;
-                                    break;
-                                }
-                                else {
-                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING_PEDANTIC, &t - this->tags.data(), "%s.%s does not match the one found in bitmaps.map, so it will NOT be indexed out", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
-                                }
+                            auto match = always_index_tags ? std::optional<bool>(true) : this->bitmap_matches_resource(i, *bitmaps, *index, m.errors, buffer);
+                            if(match.has_value()) {
+                                m.index = index;
+                                m.match = *match;
                             }
                             break;
                         }
                         case TagFourCC::TAG_FOURCC_SOUND: {
-                            auto index = find_tag_index(t.path, sounds, true);
-                            if(index.has_value()) {
-                                if((*index % 2) == 0) {
-                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (tag is on an even index)", File::halo_path_to_preferred_path(t.path).c_str());
-                                    break;
-                                }
-
-                                if(check_ce_bounds && (*index / 2 > get_default_sound_resources_count() || File::split_tag_class_extension_chars(get_default_sound_resources()[*index / 2])->path != t.path)) {
-                                    break;
-                                }
-
-                                bool match = true;
-                                if(!always_index_tags) {
-                                    const auto &sound_tag_struct = this->structs[*t.base_struct];
-                                    const auto &sound_tag = *reinterpret_cast<const Parser::Sound::struct_little *>(sound_tag_struct.data.data());
-                                    const auto &sound_tag_struct_other = (*sounds)[*index];
-                                    const auto *sound_tag_struct_other_data = sound_tag_struct_other.data.data();
-                                    std::size_t sound_tag_struct_other_size = sound_tag_struct_other.data.size();
-
-                                    if(sound_tag_struct_other_size < sizeof(sound_tag)) {
-                                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (sound main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                        match = false;
-                                        break;
-                                    }
-
-                                    const auto &sound_tag_struct_other_raw = (*sounds)[*index - 1];
-                                    const auto *sound_tag_struct_other_raw_data = sound_tag_struct_other_raw.data.data();
-                                    std::size_t sound_tag_struct_raw_data_size = sound_tag_struct_other_raw.data.size();
-                                    std::size_t sound_tag_struct_raw_data_translation = sound_tag_struct_other_raw.data_offset;
-                                    const auto &sound_tag_other = *reinterpret_cast<const Parser::Sound::struct_little *>(sound_tag_struct_other_data);
-                                    std::size_t pitch_range_count = sound_tag.pitch_ranges.count;
-                                    std::size_t pitch_range_other_count = sound_tag_other.pitch_ranges.count;
-
-                                    match = sound_tag.format == sound_tag_other.format; // unlike bitmap tags, this matters because the engine checks this
-                                    match = sound_tag.channel_count == sound_tag_other.channel_count;
-                                    match = sound_tag.sample_rate == sound_tag_other.sample_rate;
-
-                                    // Make sure we have the same number of stuff
-                                    if(match && pitch_range_count > 0 && pitch_range_count == pitch_range_other_count) {
-                                        // Make sure it's not out-of-bounds
-                                        const auto *sound_data_ref = sound_tag_struct_other_data + sizeof(sound_tag);
-                                        const auto &pitch_range_struct = this->structs[*sound_tag_struct.resolve_pointer(&sound_tag.pitch_ranges.pointer)];
-                                        const auto *all_pitch_ranges = reinterpret_cast<const Parser::SoundPitchRange::struct_little *>(pitch_range_struct.data.data());
-                                        const auto *all_pitch_ranges_other = reinterpret_cast<const Parser::SoundPitchRange::struct_little *>(sound_data_ref);
-                                        if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_pitch_ranges_other + pitch_range_other_count) - sound_tag_struct_other_data) > sound_tag_struct_other_size) {
-                                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (pitch ranges go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                            match = false;
-                                            break;
-                                        }
-
-                                        // Make sure we get match to equal the bitmap data count
-                                        std::size_t raw_data_index_index = 0;
-                                        for(std::size_t pr = 0; pr < pitch_range_count && match; pr++) {
-                                            // Get the bitmap data
-                                            const auto &pitch_range = all_pitch_ranges[pr];
-                                            const auto &pitch_range_other = all_pitch_ranges_other[pr];
-
-                                            // Make sure these match
-                                            match = match && pitch_range.bend_bounds == pitch_range_other.bend_bounds;
-                                            match = match && pitch_range.actual_permutation_count == pitch_range_other.actual_permutation_count;
-                                            match = match && pitch_range.natural_pitch == pitch_range_other.natural_pitch; // we could check the value derived from this, but I don't want to deal with floating point precision memes, so I'll just assume that the sounds.map isn't *total* bullshit
-                                            if(!match) {
-                                                match = false;
-                                                break;
-                                            }
-
-                                            std::size_t permutation_count = pitch_range.permutations.count;
-                                            std::size_t permutation_other_count = pitch_range_other.permutations.count;
-
-                                            if(permutation_count != permutation_other_count) {
-                                                match = false;
-                                                break;
-                                            }
-
-                                            if(permutation_count == 0) {
-                                                continue;
-                                            }
-                                            if(permutation_count > 0) {
-                                                // Bounds check
-                                                const auto *all_permutations_other = reinterpret_cast<const Parser::SoundPermutation::struct_little *>(sound_data_ref + pitch_range_other.permutations.pointer);
-                                                if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_permutations_other + permutation_count) - sound_tag_struct_other_data) > sound_tag_struct_other_size) {
-                                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (permutations go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                    match = false;
-                                                    break;
-                                                }
-
-                                                const auto &permutation_struct = this->structs[*pitch_range_struct.resolve_pointer(&pitch_range.permutations.pointer)];
-                                                const auto *permutations = reinterpret_cast<const Parser::SoundPermutation::struct_little *>(permutation_struct.data.data());
-
-                                                for(std::size_t p = 0; p < permutation_count && match; p++) {
-                                                    const auto &permutation = permutations[p];
-                                                    const auto &permutation_other = all_permutations_other[p];
-
-                                                    // Make sure these match
-                                                    match = match && permutation.format == permutation_other.format;
-                                                    match = match && permutation.gain == permutation_other.gain;
-                                                    match = match && permutation.next_permutation_index == permutation_other.next_permutation_index;
-                                                    match = match && permutation.skip_fraction == permutation_other.skip_fraction;
-
-                                                    if(!match) {
-                                                        break;
-                                                    }
-
-                                                    std::size_t raw_data_index = t.asset_data[raw_data_index_index++];
-                                                    const auto &raw_data = this->raw_data[raw_data_index];
-
-                                                    const auto *raw_data_data = raw_data.data();
-                                                    std::size_t raw_data_size = raw_data.size();
-
-                                                    const auto *raw_data_other_data = sound_tag_struct_other_raw_data + permutation_other.samples.file_offset - sound_tag_struct_raw_data_translation;
-                                                    std::size_t raw_data_other_size = permutation_other.samples.size;
-
-                                                    // Make sure it's not bullshit
-                                                    if(raw_data_other_data < sound_tag_struct_other_raw_data || raw_data_other_data > (sound_tag_struct_other_raw_data + sound_tag_struct_raw_data_size)) {
-                                                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (sample data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                        match = false;
-                                                        break;
-                                                    }
-
-                                                    // Make sure the sizes match
-                                                    if(raw_data_other_size != raw_data_size) {
-                                                        match = false;
-                                                        break;
-                                                    }
-
-                                                    // Check the data
-                                                    match = match && std::memcmp(raw_data_other_data, raw_data_data, raw_data_size) == 0;
-                                                }
-                                            }
-                                        }
-                                    }
-                                    else {
-                                        match = match && pitch_range_count == pitch_range_other_count;
-                                    }
-                                }
-
-                                if(match) {
-                                    // Index it. Unlike other indexed tags, the header remains (probably for the promotion sound dependencies?)
-                                    t.resource_index = index;
-                                    this->indexed_data_amount += (*sounds)[*index].data.size() - sizeof(Sound<LittleEndian>);
+                            auto index = find_tag_index(t.path, sounds_index, true);
+                            if(!index.has_value()) {
+                                break;
+                            }
 
-                                    // Strip these values since they'll be replaced on load anyway
-                                    auto &sound_tag_struct = this->structs[*t.base_struct];
-                                    auto &sound_tag = *reinterpret_cast<Parser::Sound::struct_little *>(sound_tag_struct.data.data());
-                                    sound_tag.channel_count = {};
-                                    sound_tag.sample_rate = {};
-                                    sound_tag.format = {};
-                                    sound_tag.longest_permutation_length = {};
+                            if((*index % 2) == 0) {
+                                REPORT_ERROR_PRINTF(m.errors, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (tag is on an even index)", File::halo_path_to_preferred_path(t.path).c_str());
+                                break;
+                            }
 
-                                    // Clear the pointers so that way we only include this stuff
-                                    sound_tag_struct.pointers.clear();
+                            if(check_ce_bounds && (*index / 2 > get_default_sound_resources_count() || File::split_tag_class_extension_chars(get_default_sound_resources()[*index / 2])->path != t.path)) {
+                                break;
+                            }
 
-                                    break;
-                                }
-                                else {
-                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING_PEDANTIC, &t - this->tags.data(), "%s.%s does not match the one found in sounds.map, so it will NOT be indexed out", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
-                                }
+                            auto match = always_index_tags ? std::optional<bool>(true) : this->sound_matches_resource(i, *sounds, *index, m.errors, buffer);
+                            if(match.has_value()) {
+                                m.index = index;
+                                m.match = *match;
                             }
                             break;
                         }
                         case TagFourCC::TAG_FOURCC_FONT:
                         case TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST:
                         case TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT: {
-                            auto index = find_tag_index(t.path, loc, false);
-                            if(index.has_value()) {
-                                bool match = true;
-
-                                if(check_ce_bounds && (*index > get_default_loc_resources_count() || (t.path + "." + HEK::tag_fourcc_to_extension(t.tag_fourcc)) != get_default_loc_resources()[*index])) {
-                                    break;
-                                }
-
-                                const auto &loc_tag_struct_other = (*loc)[*index];
-                                const auto *loc_tag_struct_other_data = loc_tag_struct_other.data.data();
-                                std::size_t loc_tag_struct_other_size = loc_tag_struct_other.data.size();
-
-                                const auto &loc_tag_struct = this->structs[*t.base_struct];
-
-                                switch(t.tag_fourcc) {
-                                    case TagFourCC::TAG_FOURCC_FONT: {
-                                        const auto &font_tag = *reinterpret_cast<const Parser::Font::struct_little *>(loc_tag_struct.data.data());
-                                        if(loc_tag_struct_other_size < sizeof(font_tag)) {
-                                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (font main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                            match = false;
-                                            break;
-                                        }
-                                        const auto &font_tag_other = *reinterpret_cast<const Parser::Font::struct_little *>(loc_tag_struct_other_data);
-
-                                        // First, get the character counts of both
-                                        std::size_t character_count = font_tag.characters.count;
-                                        std::size_t character_count_other = font_tag_other.characters.count;
-                                        std::size_t pixel_data_size = font_tag.pixels.size;
-                                        std::size_t pixel_data_size_other = font_tag_other.pixels.size;
-
-                                        // Next, compare the data
-                                        match = font_tag_other.ascending_height == font_tag.ascending_height &&
-                                                font_tag_other.descending_height == font_tag.descending_height &&
-                                                font_tag.bold.tag_id.read().is_null() &&
-                                                font_tag.italic.tag_id.read().is_null() &&
-                                                font_tag.underline.tag_id.read().is_null() &&
-                                                font_tag.condense.tag_id.read().is_null() &&
-                                                std::memcmp(font_tag_other.flags.value, font_tag.flags.value, sizeof(font_tag.flags.value)) == 0 &&
-                                                font_tag_other.leading_height == font_tag.leading_height &&
-                                                font_tag_other.leading_width == font_tag.leading_width &&
-                                                character_count == character_count_other &&
-                                                pixel_data_size == pixel_data_size_other;
-
-                                        // No match? Break.
-                                        if(!match) {
-                                            break;
-                                        }
-
-                                        // Now, compare the characters
-                                        if(character_count > 0) {
-                                            const auto *character_data = reinterpret_cast<const Parser::FontCharacter::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&font_tag.characters.pointer)].data.data());
-                                            const auto *character_data_other = reinterpret_cast<const Parser::FontCharacter::struct_little *>(loc_tag_struct_other_data + font_tag_other.characters.pointer);
-
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(character_data_other + character_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING, std::nullopt, "%s in loc.map appears to be corrupt (character data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            for(std::size_t c = 0; c < character_count; c++) {
-                                                const auto &character = character_data[c];
-                                                const auto &character_other = character_data_other[c];
-
-                                                match = character.bitmap_height == character_other.bitmap_height &&
-                                                        character.bitmap_origin_x == character_other.bitmap_origin_x &&
-                                                        character.bitmap_origin_y == character_other.bitmap_origin_y &&
-                                                        character.bitmap_width == character_other.bitmap_width &&
-                                                        character.character == character_other.character &&
-                                                        character.pixels_offset == character_other.pixels_offset;
-
-                                                // No match? Break.
-                                                if(!match) {
-                                                    break;
-                                                }
-                                            }
-
-                                            // If we didn't get a match, stop
-                                            if(!match) {
-                                                break;
-                                            }
-                                        }
-
-                                        // Lastly, check pixel data
-                                        if(pixel_data_size > 0) {
-                                            const auto *pixel_data = this->structs[*loc_tag_struct.resolve_pointer(&font_tag.pixels.pointer)].data.data();
-                                            const auto *pixel_data_other = loc_tag_struct_other_data + font_tag_other.pixels.pointer;
-
-                                            if(static_cast<std::size_t>(pixel_data_other + pixel_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (pixel data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            match = std::memcmp(pixel_data, pixel_data_other, pixel_data_size) == 0;
-                                        }
-                                        break;
-                                    }
-                                    case TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST: {
-                                        const auto &ustr_tag = *reinterpret_cast<const Parser::UnicodeStringList::struct_little *>(loc_tag_struct.data.data());
-                                        if(loc_tag_struct_other_size < sizeof(ustr_tag)) {
-                                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (unicode string list main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                            match = false;
-                                            break;
-                                        }
-                                        const auto &ustr_tag_other = *reinterpret_cast<const Parser::UnicodeStringList::struct_little *>(loc_tag_struct_other_data);
-                                        std::size_t string_count = ustr_tag.strings.count;
-                                        std::size_t string_count_other = ustr_tag_other.strings.count;
-                                        if(string_count != string_count_other) {
-                                            match = false;
-                                            break;
-                                        }
-                                        if(string_count > 0) {
-                                            const auto &string_list_struct = this->structs[*loc_tag_struct.resolve_pointer(&ustr_tag.strings.pointer)];
-                                            const auto *string_list = reinterpret_cast<const Parser::UnicodeStringListString::struct_little *>(string_list_struct.data.data());
-                                            const auto *string_list_other = reinterpret_cast<const Parser::UnicodeStringListString::struct_little *>(loc_tag_struct_other_data + ustr_tag_other.strings.pointer);
-
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(string_list_other + string_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (strings go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            // Check each string
-                                            for(std::size_t s = 0; s < string_count && match; s++) {
-                                                const auto &string = string_list[s];
-                                                const auto &string_other = string_list_other[s];
-                                                std::size_t string_data_size = string.string.size;
-                                                std::size_t string_data_size_other = string_other.string.size;
-
-                                                // Make sure the sizes match
-                                                if(string_data_size != string_data_size_other) {
-                                                    match = false;
-                                                    break;
-                                                }
-
-                                                if(string_data_size > 0) {
-                                                    const auto *string_data = this->structs[*string_list_struct.resolve_pointer(&string.string.pointer)].data.data();
-                                                    const auto *string_data_other = loc_tag_struct_other_data + string_other.string.pointer;
-
-                                                    if(static_cast<std::size_t>(string_data_other + string_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (string goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                        match = false;
-                                                        break;
-                                                    }
-
-                                                    match = std::memcmp(string_data, string_data_other, string_data_size) == 0;
-                                                    if(!match) {
-                                                        break;
-                                                    }
-                                                }
-                                            }
-                                        }
-                                        break;
-                                    }
-                                    case TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT: {
-                                        const auto &hud_message_tag = *reinterpret_cast<const Parser::HUDMessageText::struct_little *>(loc_tag_struct.data.data());
-                                        if(loc_tag_struct_other_size < sizeof(hud_message_tag)) {
-                                            REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (unicode string list main struct goes out of bounds)", t.path.c_str());
-                                            match = false;
-                                            break;
-                                        }
-                                        const auto &hud_message_tag_other = *reinterpret_cast<const Parser::HUDMessageText::struct_little *>(loc_tag_struct_other_data);
-
-                                        std::size_t message_count = hud_message_tag.messages.count;
-                                        std::size_t message_count_other = hud_message_tag_other.messages.count;
-
-                                        std::size_t message_element_count = hud_message_tag.message_elements.count;
-                                        std::size_t message_element_count_other = hud_message_tag_other.message_elements.count;
-
-                                        std::size_t text_data_size = hud_message_tag.text_data.size;
-                                        std::size_t text_data_size_other = hud_message_tag_other.text_data.size;
-
-                                        match = message_count == message_count_other && message_element_count == message_element_count_other && text_data_size == text_data_size_other;
-
-                                        // Give up if needed
-                                        if(!match) {
-                                            break;
-                                        }
-
-                                        // Make sure the messages are the same
-                                        if(message_count > 0) {
-                                            const auto *messages = reinterpret_cast<const Parser::HUDMessageTextMessage::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.messages.pointer)].data.data());
-                                            const auto *messages_other = reinterpret_cast<const Parser::HUDMessageTextMessage::struct_little *>(loc_tag_struct_other_data + hud_message_tag_other.messages.pointer);
-
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(messages_other + message_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (messages go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
-
-                                            for(std::size_t i = 0; i < message_count; i++) {
-                                                auto &message = messages[i];
-                                                auto &message_other = messages_other[i];
-
-                                                // If they are different, bail
-                                                match = message.name == message_other.name && message.panel_count == message_other.panel_count && message.start_index_into_text_blob == message_other.start_index_into_text_blob && message.start_index_of_message_block == message_other.start_index_of_message_block;
-                                                if(!match) {
-                                                    break;
-                                                }
-                                            }
-                                        }
-
-                                        // Make sure the message elements are the same
-                                        if(message_element_count > 0) {
-                                            const auto *message_elements = reinterpret_cast<const Parser::HUDMessageTextElement::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.message_elements.pointer)].data.data());
-                                            const auto *message_elements_other = reinterpret_cast<const Parser::HUDMessageTextElement::struct_little *>(loc_tag_struct_other_data + hud_message_tag_other.message_elements.pointer);
-
-                                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(message_elements_other + message_element_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (message elements go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
+                            auto index = find_tag_index(t.path, loc_index, false);
+                            if(!index.has_value()) {
+                                break;
+                            }
 
-                                            for(std::size_t i = 0; i < message_element_count && match; i++) {
-                                                auto &element = message_elements[i];
-                                                auto &element_other = message_elements_other[i];
+                            if(check_ce_bounds && (*index > get_default_loc_resources_count() || (t.path + "." + HEK::tag_fourcc_to_extension(t.tag_fourcc)) != get_default_loc_resources()[*index])) {
+                                break;
+                            }
 
-                                                // If they are different, bail
-                                                match = element.data == element_other.data && element.type == element_other.type;
-                                                if(!match) {
-                                                    break;
-                                                }
-                                            }
-                                        }
+                            m.index = index;
+                            m.match = this->loc_matches_resource(i, *loc, *index, m.errors);
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+                });
 
-                                        // Make sure the text data is the same
-                                        if(text_data_size > 0) {
-                                            const auto *text_data = this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.text_data.pointer)].data.data();
-                                            const auto *text_data_other = loc_tag_struct_other_data + hud_message_tag_other.text_data.pointer;
+                // Index the ones that matched in order
+                for(std::size_t i = 0; i < tag_count; i++) {
+                    auto &t = this->tags[i];
+                    auto &m = matches[i];
+                    m.errors.report_to(*this);
+                    if(!m.index.has_value()) {
+                        continue;
+                    }
 
-                                            if(static_cast<std::size_t>(text_data_other + text_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
-                                                REPORT_ERROR_PRINTF(*this, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (text data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
-                                                match = false;
-                                                break;
-                                            }
+                    const char *resource_map_name;
+                    switch(t.tag_fourcc) {
+                        case TagFourCC::TAG_FOURCC_BITMAP:
+                            resource_map_name = "bitmaps.map";
+                            if(m.match) {
+                                t.resource_index = m.index;
+                                this->indexed_data_amount += (*bitmaps)[*m.index].data.size();
+                                t.base_struct = std::nullopt;
+                            }
+                            break;
+                        case TagFourCC::TAG_FOURCC_SOUND:
+                            resource_map_name = "sounds.map";
+                            if(m.match) {
+                                // Index it. Unlike other indexed tags, the header remains (probably for the promotion sound dependencies?)
+                                t.resource_index = m.index;
+                                this->indexed_data_amount += (*sounds)[*m.index].data.size() - sizeof(Sound<LittleEndian>);
+
+                                // Strip these values since they'll be replaced on load anyway
+                                auto &sound_tag_struct = this->structs[*t.base_struct];
+                                auto &sound_tag = *reinterpret_cast<Parser::Sound::struct_little *>(sound_tag_struct.data.data());
+                                sound_tag.channel_count = {};
+                                sound_tag.sample_rate = {};
+                                sound_tag.format = {};
+                                sound_tag.longest_permutation_length = {};
 
-                                            match = std::memcmp(text_data, text_data_other, text_data_size) == 0;
-                                        }
-                                        break;
-                                    }
-                                    default:
-                                        // There is no way we can get here
-                                        std::terminate();
-                                }
-                                if(match) {
-                                    t.resource_index = index;
-                                    this->indexed_data_amount += (*loc)[*index].data.size();
-                                    t.base_struct = std::nullopt;
-                                    break;
-                                }
-                                else {
-                                    REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING_PEDANTIC, &t - this->tags.data(), "%s.%s does not match the one found in loc.map, so it will NOT be indexed out", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
-                                }
+                                // Clear the pointers so that way we only include this stuff
+                                sound_tag_struct.pointers.clear();
                             }
                             break;
-                        }
                         default:
+                            resource_map_name = "loc.map";
+                            if(m.match) {
+                                t.resource_index = m.index;
+                                this->indexed_data_amount += (*loc)[*m.index].data.size();
+                                t.base_struct = std::nullopt;
+                            }
                             break;
                     }
 
+                    if(!m.match) {
+                        REPORT_ERROR_PRINTF(*this, ERROR_TYPE_WARNING_PEDANTIC, i, "%s.%s does not match the one found in %s, so it will NOT be indexed out", File::halo_path_to_preferred_path(t.path).c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc), resource_map_name);
+                    }
+
                     // Clear off stuff
                     if(t.resource_index.has_value()) {
                         for(auto &a : t.asset_data) {
@@ -2145,6 +2288,7 @@ namespace Invader {
                     }
                 }
                 break;
+            }
             case HEK::CacheFileEngine::CACHE_FILE_RETAIL:
             case HEK::CacheFileEngine::CACHE_FILE_DEMO:
             case HEK::CacheFileEngine::CACHE_FILE_MCC_CEA:
@@ -2161,20 +2305,18 @@ namespace Invader {
                                     for(std::size_t b = 0; b < bitmap_data_count; b++) {
                                         auto &bitmap_data = all_bitmap_data[b];
                                         std::size_t raw_data_index = t.asset_data[b];
-                                        auto &raw_data = this->raw_data[raw_data_index];
+                                        auto &raw_data = this->get_raw_data(raw_data_index);
                                         auto *raw_data_data = raw_data.data();
                                         std::size_t raw_data_size = raw_data.size();
 
                                         // Find bitmaps
-                                        for(auto &ab : *bitmaps) {
-                                            if(ab.data.size() >= raw_data_size && std::memcmp(ab.data.data(), raw_data_data, raw_data_size) == 0) {
-                                                this->delete_raw_data(raw_data_index);
-                                                bitmap_data.pixel_data_offset = static_cast<std::uint32_t>(ab.data_offset);
-                                                auto flags = bitmap_data.flags.read();
-                                                flags |= HEK::BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL;
-                                                bitmap_data.flags = flags;
-                                                break;
-                                            }
+                                        auto resource_index = bitmaps_index->find_data(raw_data_data, raw_data_size);
+                                        if(resource_index.has_value()) {
+                                            this->delete_raw_data(raw_data_index);
+                                            bitmap_data.pixel_data_offset = static_cast<std::uint32_t>((*bitmaps)[*resource_index].data_offset);
+                                            auto flags = bitmap_data.flags.read();
+                                            flags |= HEK::BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL;
+                                            bitmap_data.flags = flags;
                                         }
                                     }
                                 }
@@ -2200,18 +2342,16 @@ namespace Invader {
                                             for(std::size_t p = 0; p < permutation_count; p++) {
                                                 auto &permutation = all_permutations[p];
                                                 std::size_t raw_data_index = t.asset_data[resource_index++];
-                                                auto &raw_data = this->raw_data[raw_data_index];
+                                                auto &raw_data = this->get_raw_data(raw_data_index);
                                                 auto *raw_data_data = raw_data.data();
                                                 std::size_t raw_data_size = raw_data.size();
 
                                                 // Find sounds
-                                                for(auto &ab : *sounds) {
-                                                    if(ab.data.size() >= raw_data_size && std::memcmp(ab.data.data(), raw_data_data, raw_data_size) == 0) {
-                                                        this->delete_raw_data(raw_data_index);
-                                                        permutation.samples.file_offset = static_cast<std::uint32_t>(ab.data_offset);
-                                                        permutation.samples.external = 1;
-                                                        break;
-                                                    }
+                                                auto sound_resource_index = sounds_index->find_data(raw_data_data, raw_data_size);
+                                                if(sound_resource_index.has_value()) {
+                                                    this->delete_raw_data(raw_data_index);
+                                                    permutation.samples.file_offset = static_cast<std::uint32_t>((*sounds)[*sound_resource_index].data_offset);
+                                                    permutation.samples.external = 1;
                                                 }
                                             }
                                         }
@@ -2242,6 +2382,9 @@ namespace Invader {
             }
         }
         this->raw_data.erase(this->raw_data.begin() + index);
+        if(index < this->spilled_raw_data.size()) {
+            this->spilled_raw_data.erase(this->spilled_raw_data.begin() + index);
+        }
     }
 
     void BuildWorkload::check_hud_text_indices() {
@@ -2362,15 +2505,11 @@ namespace Invader {
 
         auto *header = reinterpret_cast<HEK::CacheFileTagDataHeaderXbox *>(TAG_DATA_HEADER_STRUCT.data.data());
 
-        auto &ptr_to_vertices = TAG_DATA_HEADER_STRUCT.pointers.emplace_back();
-        ptr_to_vertices.offset = reinterpret_cast<std::byte *>(&header->model_part_vertices_address) - reinterpret_cast<std::byte *>(header);
+        auto &ptr_to_vertices = TAG_DATA_HEADER_STRUCT.add_pointer(reinterpret_cast<std::byte *>(&header->model_part_vertices_address) - reinterpret_cast<std::byte *>(header), vertices_array_struct_index);
         ptr_to_vertices.limit_to_32_bits = true;
-        ptr_to_vertices.struct_index = vertices_array_struct_index;
 
-        auto &ptr_to_indices = TAG_DATA_HEADER_STRUCT.pointers.emplace_back();
-        ptr_to_indices.offset = reinterpret_cast<std::byte *>(&header->model_part_indices_address) - reinterpret_cast<std::byte *>(header);
+        auto &ptr_to_indices = TAG_DATA_HEADER_STRUCT.add_pointer(reinterpret_cast<std::byte *>(&header->model_part_indices_address) - reinterpret_cast<std::byte *>(header), indices_array_struct_index);
         ptr_to_indices.limit_to_32_bits = true;
-        ptr_to_indices.struct_index = indices_array_struct_index;
 
         // Set up pointers
         for(std::size_t p = 0; p < part_count; p++) {
@@ -2382,34 +2521,24 @@ namespace Invader {
             auto &part_data = *reinterpret_cast<Parser::ModelGeometryPart::struct_little *>(part_struct_bytes + part.offset);
 
             // Add three pointers - one for vertices; two for indices
-            auto &vertex_ptr = part_struct.pointers.emplace_back();
-            vertex_ptr.offset = reinterpret_cast<const std::byte *>(&part_data.vertex_offset) - part_struct_bytes;
-            vertex_ptr.struct_index = vertices_array_struct_index;
+            auto &vertex_ptr = part_struct.add_pointer(reinterpret_cast<const std::byte *>(&part_data.vertex_offset) - part_struct_bytes, vertices_array_struct_index);
             vertex_ptr.struct_data_offset = p * sizeof(vertices);
             vertex_ptr.limit_to_32_bits = true;
 
-            auto &index_ptr = part_struct.pointers.emplace_back();
-            index_ptr.offset = reinterpret_cast<const std::byte *>(&part_data.triangle_offset) - part_struct_bytes;
-            index_ptr.struct_index = indices_data_struct_index;
+            auto &index_ptr = part_struct.add_pointer(reinterpret_cast<const std::byte *>(&part_data.triangle_offset) - part_struct_bytes, indices_data_struct_index);
             index_ptr.struct_data_offset = part_data.triangle_offset;
             index_ptr.limit_to_32_bits = true;
 
-            auto &index_ptr2 = part_struct.pointers.emplace_back();
-            index_ptr2.offset = reinterpret_cast<const std::byte *>(&part_data.triangle_offset_2) - part_struct_bytes;
-            index_ptr2.struct_index = indices_array_struct_index;
+            auto &index_ptr2 = part_struct.add_pointer(reinterpret_cast<const std::byte *>(&part_data.triangle_offset_2) - part_struct_bytes, indices_array_struct_index);
             index_ptr2.struct_data_offset = p * sizeof(indices);
             index_ptr2.limit_to_32_bits = true;
 
             // Add two more pointers - one for vertices and one for indices
-            auto &part_vertex_ptr = vertices_array_struct.pointers.emplace_back();
-            part_vertex_ptr.offset = reinterpret_cast<const std::byte *>(&vertices.vertices) - reinterpret_cast<const std::byte *>(vertices_array_data);
-            part_vertex_ptr.struct_index = vertices_data_struct_index;
+            auto &part_vertex_ptr = vertices_array_struct.add_pointer(reinterpret_cast<const std::byte *>(&vertices.vertices) - reinterpret_cast<const std::byte *>(vertices_array_data), vertices_data_struct_index);
             part_vertex_ptr.struct_data_offset = part_data.vertex_offset;
             part_vertex_ptr.limit_to_32_bits = true;
 
-            auto &part_index_ptr = indices_array_struct.pointers.emplace_back();
-            part_index_ptr.offset = reinterpret_cast<const std::byte *>(&indices.indices) - reinterpret_cast<const std::byte *>(indices_array_data);
-            part_index_ptr.struct_index = indices_data_struct_index;
+            auto &part_index_ptr = indices_array_struct.add_pointer(reinterpret_cast<const std::byte *>(&indices.indices) - reinterpret_cast<const std::byte *>(indices_array_data), indices_data_struct_index);
             part_index_ptr.struct_data_offset = part_data.triangle_offset;
             part_index_ptr.limit_to_32_bits = true;
         }
@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
 #include <invader/build/build_workload.hpp>
+#include <invader/hash/fnv1a.hpp>
 
 namespace Invader {
     bool BuildWorkload::BuildWorkloadStruct::can_dedupe(const BuildWorkload::BuildWorkloadStruct &other) const noexcept {
@@ -9,31 +15,21 @@ namespace Invader {
             return false;
         }
         
-        // Make sure dependencies match
+        // Make sure dependencies match (these are sorted by offset, so the ones inside the other struct are at the start)
         if(this->dependencies != other.dependencies) {
-            std::vector<BuildWorkloadDependency> this_dep_small;
-            for(auto &td : this->dependencies) {
-                if(td.offset < other_size) {
-                    if(td.offset + sizeof(HEK::TagDependency<HEK::LittleEndian>) > other_size) { // other struct only contains part of the dependency
-                        return false;
-                    }
-                    this_dep_small.emplace_back(td);
-                }
+            auto dep_end = std::lower_bound(this->dependencies.begin(), this->dependencies.end(), other_size, [](const BuildWorkloadDependency &dependency, std::size_t offset) { return dependency.offset < offset; });
+            if(dep_end != this->dependencies.begin() && (dep_end - 1)->offset + sizeof(HEK::TagDependency<HEK::LittleEndian>) > other_size) { // other struct only contains part of the dependency
+                return false;
             }
-            if(this_dep_small != other.dependencies) {
+            if(!std::equal(this->dependencies.begin(), dep_end, other.dependencies.begin(), other.dependencies.end())) {
                 return false;
             }
         }
         
         // And now pointers
         if(this->pointers != other.pointers) {
-            std::vector<BuildWorkloadStructPointer> this_ptr_small;
-            for(auto &ptr : this->pointers) {
-                if(ptr.offset < other_size) {
-                    this_ptr_small.emplace_back(ptr);
-                }
-            }
-            if(this_ptr_small != other.pointers) {
+            auto ptr_end = std::lower_bound(this->pointers.begin(), this->pointers.end(), other_size, [](const BuildWorkloadStructPointer &pointer, std::size_t offset) { return pointer.offset < offset; });
+            if(!std::equal(this->pointers.begin(), ptr_end, other.pointers.begin(), other.pointers.end())) {
                 return false;
             }
         }
@@ -41,55 +37,152 @@ namespace Invader {
         return std::memcmp(this->data.data(), other.data.data(), other_size) == 0;
     }
 
+    // Hash a struct's contents (data, dependencies, and pointers) for bucketing exact duplicates
+    static std::uint64_t hash_struct(const BuildWorkload::BuildWorkloadStruct &s) noexcept {
+        FNV1AHash hash;
+        auto hash_bytes = [&hash](const void *data, std::size_t size) {
+            hash.add_bytes(data, size);
+        };
+        auto hash_value = [&hash](std::uint64_t value) {
+            hash.add_value(value);
+        };
+
+        hash_value(s.data.size());
+        hash_bytes(s.data.data(), s.data.size());
+        hash_value(s.bsp.has_value() ? *s.bsp : SIZE_MAX);
+        for(auto &d : s.dependencies) {
+            hash_value(d.tag_index);
+            hash_value(d.offset);
+            hash_value(d.tag_id_only);
+        }
+        for(auto &p : s.pointers) {
+            hash_value(p.struct_index);
+            hash_value(p.offset);
+            hash_value(p.struct_data_offset);
+        }
+        return hash.get();
+    }
+
     void BuildWorkload::dedupe_structs() {
-        bool found_something = true;
         std::size_t total_savings = 0;
+        std::size_t deduped_count = 0;
         std::size_t struct_count = this->structs.size();
+        auto &structs = this->structs;
 
         oprintf("Optimizing tag space...");
         oflush();
 
+        // Each struct maps to the struct replacing it (or itself if it isn't replaced)
+        std::vector<std::size_t> replacement(struct_count);
+        std::iota(replacement.begin(), replacement.end(), 0);
+        auto resolve = [&replacement](std::size_t index) {
+            std::size_t root = index;
+            while(replacement[root] != root) {
+                root = replacement[root];
+            }
+            while(replacement[index] != root) {
+                index = std::exchange(replacement[index], root);
+            }
+            return root;
+        };
+
+        // Merging structs changes the pointers of structs that point to them, possibly making those structs dedupable, so repeat until nothing changes
+        bool found_something = true;
         while(found_something) {
             found_something = false;
-            for(std::size_t i = 0; i < struct_count; i++) {
-                if(this->structs[i].unsafe_to_dedupe) {
+
+            // Go through structs in order, matching each one against the earliest struct with identical contents
+            std::unordered_map<std::uint64_t, std::vector<std::size_t>> buckets;
+            std::vector<std::size_t> unique_structs;
+            buckets.reserve(struct_count);
+            for(std::size_t j = 0; j < struct_count; j++) {
+                auto &sj = structs[j];
+                if(sj.unsafe_to_dedupe) {
                     continue;
                 }
-                for(std::size_t j = i + 1; j < struct_count; j++) {
-                    if(this->structs[j].unsafe_to_dedupe) {
-                        continue;
+
+                auto &bucket = buckets[hash_struct(sj)];
+                bool matched = false;
+                for(auto i : bucket) {
+                    auto &si = structs[i];
+                    if(si.data.size() == sj.data.size() && si.can_dedupe(sj)) {
+                        replacement[j] = i;
+                        matched = true;
+                        break;
                     }
+                }
+                if(!matched) {
+                    bucket.emplace_back(j);
+                    unique_structs.emplace_back(j);
+                }
+            }
 
-                    // Check if the structs are the same
-                    if(this->structs[i].can_dedupe(this->structs[j])) {
-                        // If so, go through every struct pointer. If they equal j, set to i. If they're greater than j, decrement
-                        for(std::size_t k = 0; k < struct_count; k++) {
-                            for(auto &pointer : this->structs[k].pointers) {
-                                auto &struct_index = pointer.struct_index;
-                                if(struct_index == j) {
-                                    struct_index = i;
-                                }
-                            }
-                        }
+            // Next, handle structs that are contained at the start of an earlier struct. Sorting by data makes every struct that starts with a struct's data immediately follow it.
+            std::sort(unique_structs.begin(), unique_structs.end(), [&structs](std::size_t a, std::size_t b) {
+                auto &da = structs[a].data;
+                auto &db = structs[b].data;
+                auto smallest = std::min(da.size(), db.size());
+                int cmp = smallest == 0 ? 0 : std::memcmp(da.data(), db.data(), smallest);
+                if(cmp != 0) {
+                    return cmp < 0;
+                }
+                if(da.size() != db.size()) {
+                    return da.size() < db.size();
+                }
+                return a < b;
+            });
+            std::size_t unique_count = unique_structs.size();
+            for(std::size_t p = 0; p < unique_count; p++) {
+                std::size_t j = unique_structs[p];
+                auto &sj = structs[j];
+                auto j_size = sj.data.size();
+                std::optional<std::size_t> best;
 
-                        // Also go through every tag, too
-                        for(auto &tag : this->tags) {
-                            if(tag.base_struct.has_value()) {
-                                auto &base_struct = tag.base_struct.value();
-                                if(base_struct == j) {
-                                    base_struct = i;
-                                }
-                            }
-                        }
+                for(std::size_t q = p + 1; q < unique_count; q++) {
+                    std::size_t i = unique_structs[q];
+                    auto &si = structs[i];
+                    if(si.data.size() < j_size || (j_size > 0 && std::memcmp(si.data.data(), sj.data.data(), j_size) != 0)) {
+                        break;
+                    }
+                    if(i < j && (!best.has_value() || i < *best) && si.data.size() > j_size && si.can_dedupe(sj)) {
+                        best = i;
+                    }
+                }
 
-                        total_savings += this->structs[j].data.size();
-                        this->structs[j].unsafe_to_dedupe = true;
+                if(best.has_value()) {
+                    replacement[j] = *best;
+                }
+            }
 
-                        found_something = true;
-                    }
+            // Now remap everything in one go
+            for(std::size_t j = 0; j < struct_count; j++) {
+                if(structs[j].unsafe_to_dedupe || resolve(j) == j) {
+                    continue;
+                }
+                total_savings += structs[j].data.size();
+                deduped_count++;
+                structs[j].unsafe_to_dedupe = true;
+                found_something = true;
+            }
+            if(!found_something) {
+                break;
+            }
+            for(auto &s : structs) {
+                for(auto &pointer : s.pointers) {
+                    pointer.struct_index = resolve(pointer.struct_index);
+                }
+            }
+            for(auto &tag : this->tags) {
+                if(tag.base_struct.has_value()) {
+                    tag.base_struct = resolve(*tag.base_struct);
                 }
             }
         }
         oprintf(" done; reduced tag space usage by %.02f MiB\n", total_savings / 1024.0 / 1024.0);
+
+        if(this->profile) {
+            this->profile->deduped_struct_count = deduped_count;
+            this->profile->dedupe_savings = total_savings;
+        }
     }
 }
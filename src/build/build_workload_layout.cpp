@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    static constexpr char STABLE_LAYOUT_MAGIC[] = "invader-layout";
+    static constexpr unsigned int STABLE_LAYOUT_VERSION = 1;
+
+    static std::string stable_layout_key(const BuildWorkload::BuildWorkloadTag &tag) {
+        return tag.path + "." + HEK::tag_fourcc_to_extension(tag.tag_fourcc);
+    }
+
+    void BuildWorkload::read_stable_layout() {
+        if(!this->parameters->stable_layout_path.has_value()) {
+            return;
+        }
+
+        // If there isn't one yet, this is the first build
+        auto &path = *this->parameters->stable_layout_path;
+        auto file = File::open_file(path);
+        if(!file.has_value()) {
+            return;
+        }
+
+        std::string text(reinterpret_cast<const char *>(file->data()), file->size());
+        std::vector<std::pair<std::size_t, std::string>> tag_data, raw_data;
+        std::size_t tag_data_size = 0, raw_data_size = 0;
+
+        // The first line is the magic, version, engine, and the size of each part; each line after it is one tag's data
+        std::size_t line_start = 0;
+        bool first_line = true;
+        while(line_start < text.size()) {
+            auto line_end = text.find('\n', line_start);
+            if(line_end == std::string::npos) {
+                line_end = text.size();
+            }
+            auto line = text.substr(line_start, line_end - line_start);
+            line_start = line_end + 1;
+
+            if(first_line) {
+                char magic[sizeof(STABLE_LAYOUT_MAGIC)] = {};
+                unsigned int version, engine;
+                std::uint64_t tag_data_size_read, raw_data_size_read;
+                if(std::sscanf(line.c_str(), "%14s %u %u %" SCNu64 " %" SCNu64, magic, &version, &engine, &tag_data_size_read, &raw_data_size_read) != 5 || std::strcmp(magic, STABLE_LAYOUT_MAGIC) != 0 || version != STABLE_LAYOUT_VERSION) {
+                    eprintf_warn("%s is not a valid layout file, so the map will be laid out from scratch", path.string().c_str());
+                    return;
+                }
+                if(engine != static_cast<unsigned int>(this->parameters->details.build_cache_file_engine)) {
+                    eprintf_warn("%s is for a different engine, so the map will be laid out from scratch", path.string().c_str());
+                    return;
+                }
+                tag_data_size = tag_data_size_read;
+                raw_data_size = raw_data_size_read;
+                first_line = false;
+                continue;
+            }
+
+            char section[4] = {};
+            std::uint64_t offset, size;
+            int path_start = 0;
+            if(std::sscanf(line.c_str(), "%3s %" SCNu64 " %" SCNu64 " %n", section, &offset, &size, &path_start) != 3 || path_start == 0) {
+                continue;
+            }
+            if(std::strcmp(section, "tag") == 0) {
+                tag_data.emplace_back(offset, line.substr(path_start));
+            }
+            else if(std::strcmp(section, "raw") == 0) {
+                raw_data.emplace_back(offset, line.substr(path_start));
+            }
+        }
+
+        // Each tag's data can grow into the space before the next tag's data
+        auto load_section = [](StableLayoutSection &section, std::vector<std::pair<std::size_t, std::string>> &entries, std::size_t size) {
+            std::sort(entries.begin(), entries.end());
+            section.previous_size = size;
+            for(std::size_t e = 0; e < entries.size(); e++) {
+                auto offset = entries[e].first;
+                auto next = e + 1 < entries.size() ? entries[e + 1].first : size;
+                if(next >= offset) {
+                    section.previous.emplace(std::move(entries[e].second), std::pair(offset, next - offset));
+                }
+            }
+        };
+        load_section(this->stable_tag_data_layout, tag_data, tag_data_size);
+        load_section(this->stable_raw_data_layout, raw_data, raw_data_size);
+    }
+
+    std::size_t BuildWorkload::place_stable_layout_data(StableLayoutSection &section, std::size_t tag_index, std::size_t offset, std::size_t size, std::size_t start) {
+        if(size == 0) {
+            return offset;
+        }
+
+        auto key = stable_layout_key(this->tags[tag_index]);
+        auto previous = section.previous.find(key);
+        if(previous != section.previous.end() && previous->second.first >= start && size <= previous->second.second) {
+            offset = previous->second.first;
+        }
+        section.current.emplace_back(std::move(key), offset, size);
+        return offset;
+    }
+
+    void BuildWorkload::write_stable_layout() {
+        if(!this->parameters->stable_layout_path.has_value()) {
+            return;
+        }
+
+        // Anything after the last tag's data (such as the native asset offsets) is laid out again each build
+        auto end_of_section = [](const StableLayoutSection &section) {
+            std::size_t end = 0;
+            for(auto &[key, offset, size] : section.current) {
+                end = std::max(end, offset + size);
+            }
+            return end;
+        };
+
+        char line[64];
+        std::snprintf(line, sizeof(line), "%s %u %u %zu %zu\n", STABLE_LAYOUT_MAGIC, STABLE_LAYOUT_VERSION, static_cast<unsigned int>(this->parameters->details.build_cache_file_engine), end_of_section(this->stable_tag_data_layout), end_of_section(this->stable_raw_data_layout));
+        std::string output = line;
+
+        auto write_section = [&output, &line](const char *name, const StableLayoutSection &section) {
+            for(auto &[key, offset, size] : section.current) {
+                std::snprintf(line, sizeof(line), "%s %zu %zu ", name, offset, size);
+                output += line;
+                output += key;
+                output += "\n";
+            }
+        };
+        write_section("tag", this->stable_tag_data_layout);
+        write_section("raw", this->stable_raw_data_layout);
+
+        auto &path = *this->parameters->stable_layout_path;
+        if(!File::save_file(path, std::vector<std::byte>(reinterpret_cast<const std::byte *>(output.data()), reinterpret_cast<const std::byte *>(output.data() + output.size())))) {
+            eprintf_warn("Failed to write the layout to %s", path.string().c_str());
+        }
+    }
+}
@@ -0,0 +1,575 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <numeric>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    // Number of tags and reflexives to list in the profile
+    static constexpr std::size_t PROFILE_SLOWEST_TAG_COUNT = 25;
+
+    static const char *PROFILE_STEP_NAMES[BuildWorkload::PROFILE_STEP_COUNT] = {
+        "parse",
+        "pre_compile",
+        "compile",
+        "post_compile"
+    };
+
+    // CPU time of the whole process (all threads)
+    static std::chrono::nanoseconds get_cpu_time() noexcept {
+        #ifdef _WIN32
+        FILETIME creation_time, exit_time, kernel_time, user_time;
+        if(!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+            return std::chrono::nanoseconds(0);
+        }
+        auto to_100ns = [](const FILETIME &time) {
+            return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        };
+        return std::chrono::nanoseconds((to_100ns(kernel_time) + to_100ns(user_time)) * 100);
+        #else
+        timespec time;
+        if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+        #endif
+    }
+
+    // Peak resident memory usage in bytes
+    static std::size_t get_peak_rss() noexcept {
+        #ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+        #else
+        rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        #ifdef __APPLE__
+        return static_cast<std::size_t>(usage.ru_maxrss);
+        #else
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+        #endif
+        #endif
+    }
+
+    static double to_ms(std::chrono::nanoseconds time) noexcept {
+        return time.count() / 1000000.0;
+    }
+
+    static double to_us(std::chrono::nanoseconds time) noexcept {
+        return time.count() / 1000.0;
+    }
+
+    static std::string escape_json(const std::string &str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for(char c : str) {
+            switch(c) {
+                case '"':
+                    escaped += "\\\"";
+                    break;
+                case '\\':
+                    escaped += "\\\\";
+                    break;
+                default:
+                    if(static_cast<unsigned char>(c) < 0x20) {
+                        char code[8];
+                        std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                        escaped += code;
+                    }
+                    else {
+                        escaped += c;
+                    }
+                    break;
+            }
+        }
+        return escaped;
+    }
+
+    static void append_printf(std::string &output, const char *format, ...) {
+        char buffer[1024];
+        va_list args;
+        va_start(args, format);
+        std::vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        output += buffer;
+    }
+
+    BuildWorkload::ProfileScope::ProfileScope(BuildWorkload &workload, std::size_t tag_index, ProfileStep step) : workload(workload.profile ? &workload : nullptr), memory_usage_scope(step == PROFILE_STEP_PARSE ? MemoryUsage::MEMORY_USAGE_CATEGORY_PARSER : MemoryUsage::MEMORY_USAGE_CATEGORY_BUILD_STRUCTS) {
+        if(this->workload) {
+            auto &profile = *this->workload->profile;
+            profile.frames.emplace_back(Profile::Frame { tag_index, step, std::chrono::steady_clock::now(), std::chrono::nanoseconds(0), workload.structs.size(), workload.raw_data.size(), 0, profile.dependency_time, profile.dependency_bytes });
+        }
+    }
+
+    BuildWorkload::ProfileScope::~ProfileScope() {
+        if(!this->workload) {
+            return;
+        }
+
+        auto &profile = *this->workload->profile;
+        auto frame = profile.frames.back();
+        profile.frames.pop_back();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - frame.start);
+        auto bytes = this->workload->get_allocated_bytes_since(frame.struct_start, frame.raw_data_start);
+        this->workload->add_profile_time(frame.tag_index, frame.step, elapsed - frame.children);
+        profile.tag_bytes[frame.tag_index] += bytes - std::min(bytes, frame.children_bytes);
+        if(!profile.frames.empty()) {
+            auto &parent = profile.frames.back();
+            parent.children += elapsed;
+            parent.children_bytes += bytes;
+
+            // Anything timed inside of this frame is part of this frame, so it replaces whatever was added meanwhile
+            if(parent.tag_index != frame.tag_index) {
+                profile.dependency_time = frame.dependency_time_start + elapsed;
+                profile.dependency_bytes = frame.dependency_bytes_start + bytes;
+            }
+        }
+
+        if(this->workload->parameters->profile_trace_path.has_value()) {
+            profile.trace_events.emplace_back(Profile::TraceEvent { frame.tag_index, frame.step, std::chrono::duration_cast<std::chrono::nanoseconds>(frame.start - this->workload->start), elapsed });
+        }
+    }
+
+    BuildWorkload::ReflexiveProfileScope::ReflexiveProfileScope(BuildWorkload &workload, const char *name, std::size_t element_count) : workload(workload.profile ? &workload : nullptr), name(name) {
+        if(!this->workload) {
+            return;
+        }
+
+        auto &profile = *workload.profile;
+        auto &reflexive = profile.reflexives[name];
+        reflexive.compile_count++;
+        reflexive.element_count += element_count;
+
+        // The struct holding the elements was already made, so count it too
+        this->struct_start = workload.structs.size() - 1;
+        this->raw_data_start = workload.raw_data.size();
+        this->dependency_time_start = profile.dependency_time;
+        this->dependency_bytes_start = profile.dependency_bytes;
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    BuildWorkload::ReflexiveProfileScope::~ReflexiveProfileScope() {
+        if(!this->workload) {
+            return;
+        }
+
+        auto &profile = *this->workload->profile;
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start);
+        auto bytes = this->workload->get_allocated_bytes_since(this->struct_start, this->raw_data_start);
+        auto dependency_time = profile.dependency_time - this->dependency_time_start;
+        auto dependency_bytes = profile.dependency_bytes - this->dependency_bytes_start;
+
+        auto &reflexive = profile.reflexives[this->name];
+        reflexive.compile_time += elapsed - std::min(elapsed, dependency_time);
+        reflexive.allocated_bytes += bytes - std::min(bytes, dependency_bytes);
+    }
+
+    std::size_t BuildWorkload::get_allocated_bytes_since(std::size_t struct_start, std::size_t raw_data_start) const noexcept {
+        std::size_t bytes = 0;
+        for(std::size_t s = struct_start; s < this->structs.size(); s++) {
+            bytes += this->structs[s].data.size();
+        }
+        for(std::size_t r = raw_data_start; r < this->raw_data.size(); r++) {
+            bytes += this->get_raw_data_size(r);
+        }
+        return bytes;
+    }
+
+    void BuildWorkload::add_profile_time(std::size_t tag_index, ProfileStep step, std::chrono::nanoseconds time) {
+        if(!this->profile) {
+            return;
+        }
+        auto &tag_times = this->profile->tag_times;
+        if(tag_index >= tag_times.size()) {
+            std::array<std::chrono::nanoseconds, PROFILE_STEP_COUNT> zero;
+            zero.fill(std::chrono::nanoseconds(0));
+            tag_times.resize(tag_index + 1, zero);
+            this->profile->tag_bytes.resize(tag_index + 1);
+        }
+        tag_times[tag_index][step] += time;
+    }
+
+    std::optional<BuildWorkload::ProfileResults> BuildWorkload::get_profile_results() const {
+        if(!this->profile) {
+            return std::nullopt;
+        }
+
+        auto &profile = *this->profile;
+        ProfileResults results;
+        for(auto &p : profile.phases) {
+            results.phases.emplace_back(p.name, p.wall_time);
+        }
+        for(std::size_t t = 0; t < profile.tag_times.size() && t < this->tags.size(); t++) {
+            auto &tag = this->tags[t];
+            if(tag.stubbed) {
+                continue;
+            }
+            auto &times = profile.tag_times[t];
+            auto &group = results.tag_groups[tag.tag_fourcc];
+            group.tag_count++;
+            group.parse_time += times[PROFILE_STEP_PARSE];
+            group.compile_time += times[PROFILE_STEP_PRE_COMPILE] + times[PROFILE_STEP_COMPILE] + times[PROFILE_STEP_POST_COMPILE];
+            group.allocated_bytes += profile.tag_bytes[t];
+        }
+        for(auto &[name, reflexive] : profile.reflexives) {
+            results.reflexives.emplace(name, reflexive);
+        }
+        return results;
+    }
+
+    void BuildWorkload::begin_profile_phase(const char *name) {
+        if(this->parameters->cancelled && *this->parameters->cancelled) {
+            this->end_profile_phase();
+            throw BuildCancelledException();
+        }
+        this->report_progress(name);
+
+        if(!this->profile) {
+            return;
+        }
+        this->end_profile_phase();
+
+        auto &phase = this->profile->phases.emplace_back();
+        phase.name = name;
+        phase.start = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start);
+        this->profile->phase_cpu_start = get_cpu_time();
+        this->profile->phase_running = true;
+    }
+
+    void BuildWorkload::end_profile_phase() {
+        if(!this->profile || !this->profile->phase_running) {
+            return;
+        }
+
+        auto &phase = this->profile->phases.back();
+        phase.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start) - phase.start;
+        phase.cpu_time = get_cpu_time() - this->profile->phase_cpu_start;
+        phase.peak_rss = get_peak_rss();
+        this->profile->phase_running = false;
+    }
+
+    void BuildWorkload::write_profile() {
+        if(!this->profile) {
+            return;
+        }
+        this->end_profile_phase();
+
+        auto &profile = *this->profile;
+        auto total_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start);
+        auto results = *this->get_profile_results();
+        if(this->parameters->profile_results) {
+            *this->parameters->profile_results = results;
+        }
+        auto tag_name = [this](std::size_t tag_index) {
+            auto &tag = this->tags[tag_index];
+            return escape_json(File::halo_path_to_preferred_path(tag.path) + "." + HEK::tag_fourcc_to_extension(tag.tag_fourcc));
+        };
+        auto save = [](const std::filesystem::path &path, const std::string &output) {
+            if(!File::save_file(path, std::vector<std::byte>(reinterpret_cast<const std::byte *>(output.data()), reinterpret_cast<const std::byte *>(output.data() + output.size())))) {
+                eprintf_warn("Failed to write the profile to %s", path.string().c_str());
+            }
+        };
+
+        if(this->parameters->profile_path.has_value()) {
+            std::string output = "{\n";
+            append_printf(output, "    \"scenario\": \"%s\",\n", escape_json(File::halo_path_to_preferred_path(this->scenario)).c_str());
+            append_printf(output, "    \"wall_time_ms\": %.03f,\n", to_ms(total_time));
+            append_printf(output, "    \"cpu_time_ms\": %.03f,\n", to_ms(get_cpu_time()));
+            append_printf(output, "    \"peak_rss_bytes\": %zu,\n", get_peak_rss());
+            append_printf(output, "    \"threads\": %zu,\n", this->parameters->thread_count);
+
+            // Memory allocated for each part of the build (only if Invader was built to count it)
+            if(MemoryUsage::is_enabled()) {
+                output += "    \"memory_usage\": [";
+                auto append_counters = [&output](const char *name, const MemoryUsage::Counters &counters, bool first) {
+                    append_printf(output, "%s\n        { \"category\": \"%s\", \"allocation_count\": %llu, \"allocated_bytes\": %llu, \"peak_bytes_in_use\": %llu }", first ? "" : ",", name, static_cast<unsigned long long>(counters.allocation_count), static_cast<unsigned long long>(counters.allocated_bytes), static_cast<unsigned long long>(counters.peak_bytes_in_use));
+                };
+                for(std::size_t c = 0; c < MemoryUsage::MEMORY_USAGE_CATEGORY_COUNT; c++) {
+                    auto category = static_cast<MemoryUsage::Category>(c);
+                    append_counters(MemoryUsage::category_name(category), MemoryUsage::get_counters(category), c == 0);
+                }
+                append_counters("total", MemoryUsage::get_total_counters(), false);
+                output += "\n    ],\n";
+            }
+
+            // Phases
+            output += "    \"phases\": [";
+            for(auto &p : profile.phases) {
+                append_printf(output, "%s\n        { \"name\": \"%s\", \"wall_time_ms\": %.03f, \"cpu_time_ms\": %.03f, \"peak_rss_bytes\": %zu }", &p == profile.phases.data() ? "" : ",", p.name, to_ms(p.wall_time), to_ms(p.cpu_time), p.peak_rss);
+            }
+            output += "\n    ],\n";
+
+            // Counts
+            append_printf(output, "    \"tag_count\": %zu,\n", this->tags.size());
+            append_printf(output, "    \"struct_count\": %zu,\n", profile.struct_count);
+            append_printf(output, "    \"deduped_struct_count\": %zu,\n", profile.deduped_struct_count);
+            append_printf(output, "    \"dedupe_savings_bytes\": %zu,\n", profile.dedupe_savings);
+
+            // Totals of each step over all tags
+            std::array<std::chrono::nanoseconds, PROFILE_STEP_COUNT> step_totals;
+            step_totals.fill(std::chrono::nanoseconds(0));
+            for(auto &t : profile.tag_times) {
+                for(std::size_t s = 0; s < PROFILE_STEP_COUNT; s++) {
+                    step_totals[s] += t[s];
+                }
+            }
+            output += "    \"tag_step_totals_ms\": {";
+            for(std::size_t s = 0; s < PROFILE_STEP_COUNT; s++) {
+                append_printf(output, "%s \"%s\": %.03f", s == 0 ? "" : ",", PROFILE_STEP_NAMES[s], to_ms(step_totals[s]));
+            }
+            output += " },\n";
+
+            // Slowest tags
+            auto tag_total = [&profile](std::size_t tag_index) {
+                auto &t = profile.tag_times[tag_index];
+                return std::accumulate(t.begin(), t.end(), std::chrono::nanoseconds(0));
+            };
+            std::vector<std::size_t> slowest(std::min(profile.tag_times.size(), this->tags.size()));
+            std::iota(slowest.begin(), slowest.end(), 0);
+            std::stable_sort(slowest.begin(), slowest.end(), [&tag_total](std::size_t a, std::size_t b) { return tag_total(a) > tag_total(b); });
+            slowest.resize(std::min(slowest.size(), PROFILE_SLOWEST_TAG_COUNT));
+
+            output += "    \"slowest_tags\": [";
+            for(auto &t : slowest) {
+                auto &times = profile.tag_times[t];
+                append_printf(output, "%s\n        { \"tag\": \"%s\", \"total_ms\": %.03f", &t == slowest.data() ? "" : ",", tag_name(t).c_str(), to_ms(tag_total(t)));
+                for(std::size_t s = 0; s < PROFILE_STEP_COUNT; s++) {
+                    append_printf(output, ", \"%s_ms\": %.03f", PROFILE_STEP_NAMES[s], to_ms(times[s]));
+                }
+                output += " }";
+            }
+            output += "\n    ],\n";
+
+            // Tag groups
+            output += "    \"tag_groups\": [";
+            bool first = true;
+            for(auto &[fourcc, group] : results.tag_groups) {
+                append_printf(output, "%s\n        { \"group\": \"%s\", \"tag_count\": %zu, \"parse_ms\": %.03f, \"compile_ms\": %.03f, \"allocated_bytes\": %zu }", first ? "" : ",", HEK::tag_fourcc_to_extension(fourcc), group.tag_count, to_ms(group.parse_time), to_ms(group.compile_time), group.allocated_bytes);
+                first = false;
+            }
+            output += "\n    ],\n";
+
+            // Slowest reflexives
+            std::vector<const std::pair<const std::string, ReflexiveProfile> *> slowest_reflexives;
+            for(auto &r : results.reflexives) {
+                slowest_reflexives.emplace_back(&r);
+            }
+            std::stable_sort(slowest_reflexives.begin(), slowest_reflexives.end(), [](auto *a, auto *b) { return a->second.compile_time > b->second.compile_time; });
+            slowest_reflexives.resize(std::min(slowest_reflexives.size(), PROFILE_SLOWEST_TAG_COUNT));
+
+            output += "    \"slowest_reflexives\": [";
+            first = true;
+            for(auto *r : slowest_reflexives) {
+                append_printf(output, "%s\n        { \"reflexive\": \"%s\", \"compile_count\": %zu, \"element_count\": %zu, \"compile_ms\": %.03f, \"allocated_bytes\": %zu }", first ? "" : ",", escape_json(r->first).c_str(), r->second.compile_count, r->second.element_count, to_ms(r->second.compile_time), r->second.allocated_bytes);
+                first = false;
+            }
+            output += "\n    ]\n}\n";
+
+            save(*this->parameters->profile_path, output);
+        }
+
+        if(this->parameters->profile_trace_path.has_value()) {
+            std::string output = "{\"traceEvents\":[\n";
+            bool first = true;
+            for(auto &p : profile.phases) {
+                append_printf(output, "%s{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.03f,\"dur\":%.03f,\"pid\":1,\"tid\":1}", first ? "" : ",\n", p.name, to_us(p.start), to_us(p.wall_time));
+                first = false;
+            }
+            for(auto &e : profile.trace_events) {
+                if(e.tag_index >= this->tags.size()) {
+                    continue;
+                }
+                append_printf(output, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.03f,\"dur\":%.03f,\"pid\":1,\"tid\":2}", first ? "" : ",\n", tag_name(e.tag_index).c_str(), PROFILE_STEP_NAMES[e.step], to_us(e.start), to_us(e.duration));
+                first = false;
+            }
+            output += "\n]}\n";
+
+            save(*this->parameters->profile_trace_path, output);
+        }
+
+        if(this->parameters->profile_graph_path.has_value()) {
+            this->write_profile_graph(*this->parameters->profile_graph_path);
+        }
+    }
+
+    void BuildWorkload::write_profile_graph(const std::filesystem::path &path) {
+        auto &profile = *this->profile;
+        std::size_t tag_count = this->tags.size();
+        auto in_graph = [this](std::size_t tag_index) {
+            auto &tag = this->tags[tag_index];
+            return !tag.stubbed && tag.base_struct.has_value();
+        };
+
+        // Find what each tag depends on by going through the structs it points to
+        std::vector<std::vector<std::size_t>> dependencies(tag_count);
+        std::vector<std::size_t> struct_visited(this->structs.size(), SIZE_MAX);
+        std::vector<std::size_t> struct_stack;
+        for(std::size_t t = 0; t < tag_count; t++) {
+            if(!in_graph(t)) {
+                continue;
+            }
+            auto &tag_dependencies = dependencies[t];
+            struct_stack.emplace_back(*this->tags[t].base_struct);
+            struct_visited[struct_stack.back()] = t;
+            while(!struct_stack.empty()) {
+                auto &s = this->structs[struct_stack.back()];
+                struct_stack.pop_back();
+                for(auto &dependency : s.dependencies) {
+                    if(dependency.tag_index != t && in_graph(dependency.tag_index)) {
+                        tag_dependencies.emplace_back(dependency.tag_index);
+                    }
+                }
+                for(auto &pointer : s.pointers) {
+                    if(struct_visited[pointer.struct_index] != t) {
+                        struct_visited[pointer.struct_index] = t;
+                        struct_stack.emplace_back(pointer.struct_index);
+                    }
+                }
+            }
+            std::sort(tag_dependencies.begin(), tag_dependencies.end());
+            tag_dependencies.erase(std::unique(tag_dependencies.begin(), tag_dependencies.end()), tag_dependencies.end());
+        }
+
+        // Time spent on each tag itself, not counting its dependencies
+        std::vector<std::chrono::nanoseconds> tag_time(tag_count, std::chrono::nanoseconds(0));
+        for(std::size_t t = 0; t < tag_count && t < profile.tag_times.size(); t++) {
+            tag_time[t] = std::accumulate(profile.tag_times[t].begin(), profile.tag_times[t].end(), std::chrono::nanoseconds(0));
+        }
+
+        // Find the longest chain of dependencies ending at each tag. Tags can depend on each other in a cycle, so a
+        // dependency on a tag that is still being gone through is left out.
+        enum : std::uint8_t { NOT_VISITED, VISITING, VISITED };
+        std::vector<std::uint8_t> state(tag_count, NOT_VISITED);
+        std::vector<std::chrono::nanoseconds> path_time(tag_count, std::chrono::nanoseconds(0));
+        std::vector<std::size_t> path_next(tag_count, SIZE_MAX);
+        std::size_t cyclic_dependencies = 0;
+        std::vector<std::pair<std::size_t, std::size_t>> tag_stack;
+        for(std::size_t root = 0; root < tag_count; root++) {
+            if(!in_graph(root) || state[root] != NOT_VISITED) {
+                continue;
+            }
+            tag_stack.emplace_back(root, 0);
+            state[root] = VISITING;
+            while(!tag_stack.empty()) {
+                auto &[t, next_dependency] = tag_stack.back();
+                if(next_dependency < dependencies[t].size()) {
+                    auto d = dependencies[t][next_dependency++];
+                    if(state[d] == NOT_VISITED) {
+                        state[d] = VISITING;
+                        tag_stack.emplace_back(d, 0);
+                    }
+                    else if(state[d] == VISITING) {
+                        cyclic_dependencies++;
+                    }
+                    continue;
+                }
+
+                auto longest = std::chrono::nanoseconds(0);
+                for(auto d : dependencies[t]) {
+                    if(state[d] == VISITED && path_time[d] > longest) {
+                        longest = path_time[d];
+                        path_next[t] = d;
+                    }
+                }
+                path_time[t] = tag_time[t] + longest;
+                state[t] = VISITED;
+                tag_stack.pop_back();
+            }
+        }
+
+        // Whatever ends the longest chain is the start of the critical path
+        std::vector<bool> on_critical_path(tag_count);
+        std::vector<std::size_t> critical_path;
+        auto total_time = std::chrono::nanoseconds(0);
+        std::size_t critical_path_start = SIZE_MAX;
+        for(std::size_t t = 0; t < tag_count; t++) {
+            if(!in_graph(t)) {
+                continue;
+            }
+            total_time += tag_time[t];
+            if(critical_path_start == SIZE_MAX || path_time[t] > path_time[critical_path_start]) {
+                critical_path_start = t;
+            }
+        }
+        for(auto t = critical_path_start; t != SIZE_MAX; t = path_next[t]) {
+            critical_path.emplace_back(t);
+            on_critical_path[t] = true;
+        }
+        auto critical_path_time = critical_path.empty() ? std::chrono::nanoseconds(0) : path_time[critical_path_start];
+        double speedup = critical_path_time.count() > 0 ? static_cast<double>(total_time.count()) / critical_path_time.count() : 1.0;
+
+        auto tag_name = [this](std::size_t tag_index) {
+            auto &tag = this->tags[tag_index];
+            return escape_json(File::halo_path_to_preferred_path(tag.path) + "." + HEK::tag_fourcc_to_extension(tag.tag_fourcc));
+        };
+
+        std::string output;
+        if(path.extension() == ".dot") {
+            append_printf(output, "digraph \"%s\" {\n", escape_json(File::halo_path_to_preferred_path(this->scenario)).c_str());
+            append_printf(output, "    label=\"total %.03f ms, critical path %.03f ms, parallel speedup %.02fx\";\n", to_ms(total_time), to_ms(critical_path_time), speedup);
+            output += "    node [shape=box];\n";
+            for(std::size_t t = 0; t < tag_count; t++) {
+                if(in_graph(t)) {
+                    append_printf(output, "    t%zu [label=\"%s\\n%.03f ms\"%s];\n", t, tag_name(t).c_str(), to_ms(tag_time[t]), on_critical_path[t] ? ", color=red" : "");
+                }
+            }
+            for(std::size_t t = 0; t < tag_count; t++) {
+                for(auto d : dependencies[t]) {
+                    append_printf(output, "    t%zu -> t%zu%s;\n", t, d, on_critical_path[t] && path_next[t] == d ? " [color=red]" : "");
+                }
+            }
+            output += "}\n";
+        }
+        else {
+            output = "{\n";
+            append_printf(output, "    \"scenario\": \"%s\",\n", escape_json(File::halo_path_to_preferred_path(this->scenario)).c_str());
+            append_printf(output, "    \"total_ms\": %.03f,\n", to_ms(total_time));
+            append_printf(output, "    \"critical_path_ms\": %.03f,\n", to_ms(critical_path_time));
+            append_printf(output, "    \"parallel_speedup\": %.03f,\n", speedup);
+            append_printf(output, "    \"cyclic_dependency_count\": %zu,\n", cyclic_dependencies);
+            output += "    \"critical_path\": [";
+            for(auto &t : critical_path) {
+                append_printf(output, "%s\"%s\"", &t == critical_path.data() ? "" : ", ", tag_name(t).c_str());
+            }
+            output += "],\n";
+            output += "    \"tags\": [";
+            bool first = true;
+            for(std::size_t t = 0; t < tag_count; t++) {
+                if(!in_graph(t)) {
+                    continue;
+                }
+                append_printf(output, "%s\n        { \"id\": %zu, \"tag\": \"%s\", \"total_ms\": %.03f, \"longest_path_ms\": %.03f, \"dependencies\": [", first ? "" : ",", t, tag_name(t).c_str(), to_ms(tag_time[t]), to_ms(path_time[t]));
+                for(auto &d : dependencies[t]) {
+                    append_printf(output, "%s%zu", &d == dependencies[t].data() ? "" : ", ", d);
+                }
+                output += "] }";
+                first = false;
+            }
+            output += "\n    ]\n}\n";
+        }
+
+        if(!File::save_file(path, std::vector<std::byte>(reinterpret_cast<const std::byte *>(output.data()), reinterpret_cast<const std::byte *>(output.data() + output.size())))) {
+            eprintf_warn("Failed to write the dependency graph to %s", path.string().c_str());
+        }
+    }
+}
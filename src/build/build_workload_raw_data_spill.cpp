@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <random>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/error.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    BuildWorkload::RawDataSpillFile::~RawDataSpillFile() {
+        this->stream.close();
+        std::error_code ec;
+        std::filesystem::remove(this->path, ec);
+    }
+
+    void BuildWorkload::spill_raw_data(std::size_t tag_index) {
+        auto &asset_data = this->tags[tag_index].asset_data;
+        if(asset_data.empty()) {
+            return;
+        }
+
+        // Several builds may be running at once, so give each one its own file
+        if(!this->raw_data_spill_file) {
+            std::random_device random;
+            char file_name[64];
+            std::snprintf(file_name, sizeof(file_name), "invader-build-%08x%08x.raw", random(), random());
+
+            auto spill_file = std::make_shared<RawDataSpillFile>();
+            spill_file->path = std::filesystem::temp_directory_path() / file_name;
+            spill_file->stream.open(spill_file->path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+            if(!spill_file->stream.is_open()) {
+                eprintf_error("Failed to open %s for spilling raw data", spill_file->path.string().c_str());
+                throw FailedToOpenFileException();
+            }
+            this->raw_data_spill_file = spill_file;
+        }
+
+        auto &spill_file = *this->raw_data_spill_file;
+        this->spilled_raw_data.resize(this->raw_data.size());
+        for(auto index : asset_data) {
+            if(index == static_cast<std::size_t>(~0) || this->spilled_raw_data[index].has_value()) {
+                continue;
+            }
+
+            auto &data = this->raw_data[index];
+            spill_file.stream.seekp(0, std::ios::end);
+            auto offset = static_cast<std::uint64_t>(spill_file.stream.tellp());
+            spill_file.stream.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+            if(!spill_file.stream) {
+                eprintf_error("Failed to write raw data to %s", spill_file.path.string().c_str());
+                throw FailedToOpenFileException();
+            }
+
+            this->spilled_raw_data[index] = std::pair(offset, data.size());
+            data = std::vector<std::byte>();
+        }
+    }
+
+    const std::vector<std::byte> &BuildWorkload::get_raw_data(std::size_t index) {
+        return this->get_raw_data(index, this->spilled_raw_data_buffer);
+    }
+
+    const std::vector<std::byte> &BuildWorkload::get_raw_data(std::size_t index, std::vector<std::byte> &buffer) const {
+        if(index >= this->spilled_raw_data.size() || !this->spilled_raw_data[index].has_value()) {
+            return this->raw_data[index];
+        }
+
+        auto [offset, size] = *this->spilled_raw_data[index];
+        auto &spill_file = *this->raw_data_spill_file;
+        buffer.resize(size);
+        std::scoped_lock lock(spill_file.mutex);
+        spill_file.stream.seekg(static_cast<std::streamoff>(offset));
+        spill_file.stream.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(size));
+        if(!spill_file.stream) {
+            eprintf_error("Failed to read raw data back from %s", spill_file.path.string().c_str());
+            throw FailedToOpenFileException();
+        }
+
+        return buffer;
+    }
+
+    std::size_t BuildWorkload::get_raw_data_size(std::size_t index) const noexcept {
+        if(index >= this->spilled_raw_data.size() || !this->spilled_raw_data[index].has_value()) {
+            return this->raw_data[index].size();
+        }
+        return this->spilled_raw_data[index]->second;
+    }
+}
@@ -0,0 +1,549 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/tag/parser/parser.hpp>
+
+namespace Invader {
+    using namespace HEK;
+
+    void BuildWorkload::ResourceMatchErrors::report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index) {
+        this->errors.emplace_back(type, error, tag_index);
+    }
+
+    void BuildWorkload::ResourceMatchErrors::report_to(ErrorHandler &handler) const {
+        for(auto &[type, error, tag_index] : this->errors) {
+            handler.report_error(type, error.c_str(), tag_index);
+        }
+    }
+
+    std::optional<bool> BuildWorkload::bitmap_matches_resource(std::size_t tag_index, const ResourceMapView &bitmaps, std::size_t index, ResourceMatchErrors &errors, std::vector<std::byte> &buffer) const {
+        const auto &t = this->tags[tag_index];
+        bool match = true;
+
+        const auto &bitmap_tag_struct = this->structs[*t.base_struct];
+        const auto &bitmap_tag = *reinterpret_cast<const Parser::Bitmap::struct_little *>(bitmap_tag_struct.data.data());
+        const auto &bitmap_tag_struct_other = bitmaps[index];
+        const auto *bitmap_tag_struct_other_data = bitmap_tag_struct_other.data.data();
+        std::size_t bitmap_tag_struct_other_size = bitmap_tag_struct_other.data.size();
+
+        if(bitmap_tag_struct_other_size < sizeof(bitmap_tag)) {
+            REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (bitmap main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+            return std::nullopt;
+        }
+
+        const auto &bitmap_tag_struct_other_raw = bitmaps[index - 1];
+        const auto *bitmap_tag_struct_other_raw_data = bitmap_tag_struct_other_raw.data.data();
+        std::size_t bitmap_tag_struct_other_raw_data_size = bitmap_tag_struct_other_raw.data.size();
+
+        std::size_t bitmap_tag_struct_raw_data_translation = bitmap_tag_struct_other_raw.data_offset;
+        const auto &bitmap_tag_other = *reinterpret_cast<const Parser::Bitmap::struct_little *>(bitmap_tag_struct_other_data);
+        std::size_t bitmap_data_count = bitmap_tag.bitmap_data.count;
+        std::size_t bitmap_data_other_count = bitmap_tag_other.bitmap_data.count;
+        std::size_t sequence_count = bitmap_tag.bitmap_group_sequence.count;
+        std::size_t sequence_other_count = bitmap_tag_other.bitmap_group_sequence.count;
+
+        // Make sure the bitmap type matches, first off
+        if(bitmap_tag_other.type == bitmap_tag.type) {
+            // Make sure our sequences match
+            if(match && sequence_count > 0 && sequence_count == sequence_other_count) {
+                // Make sure it's not out-of-bounds
+                const auto *all_sequence_other = reinterpret_cast<const Parser::BitmapGroupSequence::struct_little *>(bitmap_tag_struct_other_data + bitmap_tag_other.bitmap_group_sequence.pointer);
+                if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_sequence_other + sequence_other_count) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
+                    REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (sequence data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                    return std::nullopt;
+                }
+
+                // Also get the bitmap sequences we have
+                auto &sequence_struct = this->structs[*bitmap_tag_struct.resolve_pointer(&bitmap_tag.bitmap_group_sequence.pointer)];
+                const auto *all_sequence = reinterpret_cast<const Parser::BitmapGroupSequence::struct_little *>(sequence_struct.data.data());
+
+                if(bitmap_tag_other.type == BitmapType::BITMAP_TYPE_SPRITES) {
+                    for(std::size_t s = 0; s < sequence_count && match; s++) {
+                        // Get sequence data
+                        const auto &sequence = all_sequence[s];
+                        const auto &sequence_other = all_sequence_other[s];
+
+                        // Make sure the sprites match
+                        std::size_t sprite_count = sequence.sprites.count;
+                        std::size_t sprite_count_other = sequence_other.sprites.count;
+
+                        if(sprite_count > 0 && sprite_count == sprite_count_other) {
+                            // Make sure it's not out-of-bounds
+                            const auto *all_sprites_other = reinterpret_cast<const Parser::BitmapGroupSprite::struct_little *>(bitmap_tag_struct_other_data + sequence_other.sprites.pointer);
+                            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_sprites_other + sprite_count_other) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
+                                REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (sequence sprites goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                                match = false;
+                                break;
+                            }
+
+                            // And get our sprites, too
+                            auto &sprites_struct = this->structs[*sequence_struct.resolve_pointer(&sequence.sprites.pointer)];
+                            const auto *all_sprites = reinterpret_cast<const Parser::BitmapGroupSprite::struct_little *>(sprites_struct.data.data());
+
+                            // Check individual sprites to make sure they match
+                            for(std::size_t sp = 0; sp < sprite_count && match; sp++) {
+                                const auto &sprite = all_sprites[sp];
+                                const auto &sprite_other = all_sprites_other[sp];
+                                match = match && sprite.bitmap_index == sprite_other.bitmap_index;
+                                match = match && sprite.bottom == sprite_other.bottom;
+                                match = match && sprite.left == sprite_other.left;
+                                match = match && sprite.top == sprite_other.top;
+                                match = match && sprite.right == sprite_other.right;
+                                match = match && sprite.registration_point == sprite_other.registration_point;
+                            }
+                        }
+                        else {
+                            match = match && sprite_count == sprite_count_other;
+                        }
+                    }
+                }
+                else {
+                    for(std::size_t s = 0; s < sequence_count && match; s++) {
+                        // Get sequence data
+                        const auto &sequence = all_sequence[s];
+                        const auto &sequence_other = all_sequence_other[s];
+
+                        // Make sure the bitmap range matches
+                        match = match && sequence.bitmap_count == sequence_other.bitmap_count;
+                        match = match && sequence.first_bitmap_index == sequence_other.first_bitmap_index;
+                    }
+                }
+            }
+            else {
+                match = match && sequence_count == sequence_other_count;
+            }
+
+            // Make sure we have the same number of bitmap data
+            if(match && bitmap_data_count > 0 && bitmap_data_count == bitmap_data_other_count) {
+                // Make sure it's not out-of-bounds
+                const auto *all_bitmap_data_other = reinterpret_cast<const Parser::BitmapData::struct_little *>(bitmap_tag_struct_other_data + bitmap_tag_other.bitmap_data.pointer);
+                if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_bitmap_data_other + bitmap_data_other_count) - bitmap_tag_struct_other_data) > bitmap_tag_struct_other_size) {
+                    REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (bitmap data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                    return std::nullopt;
+                }
+
+                // Also get the bitmap data we have
+                auto &bitmap_data_struct = this->structs[*bitmap_tag_struct.resolve_pointer(&bitmap_tag.bitmap_data.pointer)];
+                const auto *all_bitmap_data = reinterpret_cast<const Parser::BitmapData::struct_little *>(bitmap_data_struct.data.data());
+
+                // Make sure we get match to equal the bitmap data count
+                for(std::size_t b = 0; b < bitmap_data_count && match; b++) {
+                    // Get the bitmap data
+                    const auto &bitmap_data = all_bitmap_data[b];
+                    const auto &bitmap_data_other = all_bitmap_data_other[b];
+
+                    // Get the raw data and make sure the sizes match
+                    std::size_t raw_data_index = t.asset_data[b];
+                    auto &asset_raw_data = this->get_raw_data(raw_data_index, buffer);
+                    std::size_t raw_data_size = asset_raw_data.size();
+                    std::size_t raw_data_other_size = bitmap_data_other.pixel_data_size;
+                    if(raw_data_other_size != raw_data_size) {
+                        match = false;
+                        break;
+                    }
+
+                    // Make sure the formats and dimensions match too
+                    match = match && bitmap_data_other.width == bitmap_data.width;
+                    match = match && bitmap_data_other.height == bitmap_data.height;
+                    match = match && bitmap_data_other.depth == bitmap_data.depth;
+                    match = match && bitmap_data_other.mipmap_count == bitmap_data.mipmap_count;
+                    match = match && bitmap_data_other.format == bitmap_data.format;
+                    if(!match) {
+                        break;
+                    }
+
+                    auto *raw_data_data = asset_raw_data.data();
+                    auto *raw_data_other_data = bitmap_tag_struct_other_raw_data + bitmap_data_other.pixel_data_offset - bitmap_tag_struct_raw_data_translation;
+
+                    // Make sure it's not bullshit
+                    if(raw_data_other_data < bitmap_tag_struct_other_raw_data || raw_data_other_data > (bitmap_tag_struct_other_raw_data + bitmap_tag_struct_other_raw_data_size)) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in bitmaps.map appears to be corrupt (pixel data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    // Check the data
+                    match = std::memcmp(raw_data_other_data, raw_data_data, raw_data_size) == 0;
+                }
+            }
+            else {
+                match = match && bitmap_data_count == bitmap_data_other_count;
+            }
+        }
+        else {
+            match = false;
+        }
+        return match;
+    }
+
+    std::optional<bool> BuildWorkload::sound_matches_resource(std::size_t tag_index, const ResourceMapView &sounds, std::size_t index, ResourceMatchErrors &errors, std::vector<std::byte> &buffer) const {
+        const auto &t = this->tags[tag_index];
+
+        const auto &sound_tag_struct = this->structs[*t.base_struct];
+        const auto &sound_tag = *reinterpret_cast<const Parser::Sound::struct_little *>(sound_tag_struct.data.data());
+        const auto &sound_tag_struct_other = sounds[index];
+        const auto *sound_tag_struct_other_data = sound_tag_struct_other.data.data();
+        std::size_t sound_tag_struct_other_size = sound_tag_struct_other.data.size();
+
+        if(sound_tag_struct_other_size < sizeof(sound_tag)) {
+            REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (sound main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+            return std::nullopt;
+        }
+
+        const auto &sound_tag_struct_other_raw = sounds[index - 1];
+        const auto *sound_tag_struct_other_raw_data = sound_tag_struct_other_raw.data.data();
+        std::size_t sound_tag_struct_raw_data_size = sound_tag_struct_other_raw.data.size();
+        std::size_t sound_tag_struct_raw_data_translation = sound_tag_struct_other_raw.data_offset;
+        const auto &sound_tag_other = *reinterpret_cast<const Parser::Sound::struct_little *>(sound_tag_struct_other_data);
+        std::size_t pitch_range_count = sound_tag.pitch_ranges.count;
+        std::size_t pitch_range_other_count = sound_tag_other.pitch_ranges.count;
+
+        bool match = sound_tag.format == sound_tag_other.format; // unlike bitmap tags, this matters because the engine checks this
+        match = match && sound_tag.channel_count == sound_tag_other.channel_count;
+        match = match && sound_tag.sample_rate == sound_tag_other.sample_rate;
+
+        // Make sure we have the same number of stuff
+        if(match && pitch_range_count > 0 && pitch_range_count == pitch_range_other_count) {
+            // Make sure it's not out-of-bounds
+            const auto *sound_data_ref = sound_tag_struct_other_data + sizeof(sound_tag);
+            const auto &pitch_range_struct = this->structs[*sound_tag_struct.resolve_pointer(&sound_tag.pitch_ranges.pointer)];
+            const auto *all_pitch_ranges = reinterpret_cast<const Parser::SoundPitchRange::struct_little *>(pitch_range_struct.data.data());
+            const auto *all_pitch_ranges_other = reinterpret_cast<const Parser::SoundPitchRange::struct_little *>(sound_data_ref);
+            if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_pitch_ranges_other + pitch_range_other_count) - sound_tag_struct_other_data) > sound_tag_struct_other_size) {
+                REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (pitch ranges go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                return std::nullopt;
+            }
+
+            // Make sure we get match to equal the bitmap data count
+            std::size_t raw_data_index_index = 0;
+            for(std::size_t pr = 0; pr < pitch_range_count && match; pr++) {
+                // Get the bitmap data
+                const auto &pitch_range = all_pitch_ranges[pr];
+                const auto &pitch_range_other = all_pitch_ranges_other[pr];
+
+                // Make sure these match
+                match = match && pitch_range.bend_bounds == pitch_range_other.bend_bounds;
+                match = match && pitch_range.actual_permutation_count == pitch_range_other.actual_permutation_count;
+                match = match && pitch_range.natural_pitch == pitch_range_other.natural_pitch; // we could check the value derived from this, but I don't want to deal with floating point precision memes, so I'll just assume that the sounds.map isn't *total* bullshit
+                if(!match) {
+                    match = false;
+                    break;
+                }
+
+                std::size_t permutation_count = pitch_range.permutations.count;
+                std::size_t permutation_other_count = pitch_range_other.permutations.count;
+
+                if(permutation_count != permutation_other_count) {
+                    match = false;
+                    break;
+                }
+
+                if(permutation_count == 0) {
+                    continue;
+                }
+                if(permutation_count > 0) {
+                    // Bounds check
+                    const auto *all_permutations_other = reinterpret_cast<const Parser::SoundPermutation::struct_little *>(sound_data_ref + pitch_range_other.permutations.pointer);
+                    if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(all_permutations_other + permutation_count) - sound_tag_struct_other_data) > sound_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (permutations go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    const auto &permutation_struct = this->structs[*pitch_range_struct.resolve_pointer(&pitch_range.permutations.pointer)];
+                    const auto *permutations = reinterpret_cast<const Parser::SoundPermutation::struct_little *>(permutation_struct.data.data());
+
+                    for(std::size_t p = 0; p < permutation_count && match; p++) {
+                        const auto &permutation = permutations[p];
+                        const auto &permutation_other = all_permutations_other[p];
+
+                        // Make sure these match
+                        match = match && permutation.format == permutation_other.format;
+                        match = match && permutation.gain == permutation_other.gain;
+                        match = match && permutation.next_permutation_index == permutation_other.next_permutation_index;
+                        match = match && permutation.skip_fraction == permutation_other.skip_fraction;
+
+                        if(!match) {
+                            break;
+                        }
+
+                        std::size_t raw_data_index = t.asset_data[raw_data_index_index++];
+                        const auto &raw_data = this->get_raw_data(raw_data_index, buffer);
+
+                        const auto *raw_data_data = raw_data.data();
+                        std::size_t raw_data_size = raw_data.size();
+
+                        const auto *raw_data_other_data = sound_tag_struct_other_raw_data + permutation_other.samples.file_offset - sound_tag_struct_raw_data_translation;
+                        std::size_t raw_data_other_size = permutation_other.samples.size;
+
+                        // Make sure it's not bullshit
+                        if(raw_data_other_data < sound_tag_struct_other_raw_data || raw_data_other_data > (sound_tag_struct_other_raw_data + sound_tag_struct_raw_data_size)) {
+                            REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in sounds.map appears to be corrupt (sample data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                            match = false;
+                            break;
+                        }
+
+                        // Make sure the sizes match
+                        if(raw_data_other_size != raw_data_size) {
+                            match = false;
+                            break;
+                        }
+
+                        // Check the data
+                        match = match && std::memcmp(raw_data_other_data, raw_data_data, raw_data_size) == 0;
+                    }
+                }
+            }
+        }
+        else {
+            match = match && pitch_range_count == pitch_range_other_count;
+        }
+        return match;
+    }
+
+    bool BuildWorkload::loc_matches_resource(std::size_t tag_index, const ResourceMapView &loc, std::size_t index, ResourceMatchErrors &errors) const {
+        const auto &t = this->tags[tag_index];
+        bool match = true;
+
+        const auto &loc_tag_struct_other = loc[index];
+        const auto *loc_tag_struct_other_data = loc_tag_struct_other.data.data();
+        std::size_t loc_tag_struct_other_size = loc_tag_struct_other.data.size();
+
+        const auto &loc_tag_struct = this->structs[*t.base_struct];
+
+        switch(t.tag_fourcc) {
+            case TagFourCC::TAG_FOURCC_FONT: {
+                const auto &font_tag = *reinterpret_cast<const Parser::Font::struct_little *>(loc_tag_struct.data.data());
+                if(loc_tag_struct_other_size < sizeof(font_tag)) {
+                    REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (font main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                    match = false;
+                    break;
+                }
+                const auto &font_tag_other = *reinterpret_cast<const Parser::Font::struct_little *>(loc_tag_struct_other_data);
+
+                // First, get the character counts of both
+                std::size_t character_count = font_tag.characters.count;
+                std::size_t character_count_other = font_tag_other.characters.count;
+                std::size_t pixel_data_size = font_tag.pixels.size;
+                std::size_t pixel_data_size_other = font_tag_other.pixels.size;
+
+                // Next, compare the data
+                match = font_tag_other.ascending_height == font_tag.ascending_height &&
+                        font_tag_other.descending_height == font_tag.descending_height &&
+                        font_tag.bold.tag_id.read().is_null() &&
+                        font_tag.italic.tag_id.read().is_null() &&
+                        font_tag.underline.tag_id.read().is_null() &&
+                        font_tag.condense.tag_id.read().is_null() &&
+                        std::memcmp(font_tag_other.flags.value, font_tag.flags.value, sizeof(font_tag.flags.value)) == 0 &&
+                        font_tag_other.leading_height == font_tag.leading_height &&
+                        font_tag_other.leading_width == font_tag.leading_width &&
+                        character_count == character_count_other &&
+                        pixel_data_size == pixel_data_size_other;
+
+                // No match? Break.
+                if(!match) {
+                    break;
+                }
+
+                // Now, compare the characters
+                if(character_count > 0) {
+                    const auto *character_data = reinterpret_cast<const Parser::FontCharacter::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&font_tag.characters.pointer)].data.data());
+                    const auto *character_data_other = reinterpret_cast<const Parser::FontCharacter::struct_little *>(loc_tag_struct_other_data + font_tag_other.characters.pointer);
+
+                    if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(character_data_other + character_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_WARNING, std::nullopt, "%s in loc.map appears to be corrupt (character data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    for(std::size_t c = 0; c < character_count; c++) {
+                        const auto &character = character_data[c];
+                        const auto &character_other = character_data_other[c];
+
+                        match = character.bitmap_height == character_other.bitmap_height &&
+                                character.bitmap_origin_x == character_other.bitmap_origin_x &&
+                                character.bitmap_origin_y == character_other.bitmap_origin_y &&
+                                character.bitmap_width == character_other.bitmap_width &&
+                                character.character == character_other.character &&
+                                character.pixels_offset == character_other.pixels_offset;
+
+                        // No match? Break.
+                        if(!match) {
+                            break;
+                        }
+                    }
+
+                    // If we didn't get a match, stop
+                    if(!match) {
+                        break;
+                    }
+                }
+
+                // Lastly, check pixel data
+                if(pixel_data_size > 0) {
+                    const auto *pixel_data = this->structs[*loc_tag_struct.resolve_pointer(&font_tag.pixels.pointer)].data.data();
+                    const auto *pixel_data_other = loc_tag_struct_other_data + font_tag_other.pixels.pointer;
+
+                    if(static_cast<std::size_t>(pixel_data_other + pixel_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (pixel data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    match = std::memcmp(pixel_data, pixel_data_other, pixel_data_size) == 0;
+                }
+                break;
+            }
+            case TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST: {
+                const auto &ustr_tag = *reinterpret_cast<const Parser::UnicodeStringList::struct_little *>(loc_tag_struct.data.data());
+                if(loc_tag_struct_other_size < sizeof(ustr_tag)) {
+                    REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (unicode string list main struct goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                    match = false;
+                    break;
+                }
+                const auto &ustr_tag_other = *reinterpret_cast<const Parser::UnicodeStringList::struct_little *>(loc_tag_struct_other_data);
+                std::size_t string_count = ustr_tag.strings.count;
+                std::size_t string_count_other = ustr_tag_other.strings.count;
+                if(string_count != string_count_other) {
+                    match = false;
+                    break;
+                }
+                if(string_count > 0) {
+                    const auto &string_list_struct = this->structs[*loc_tag_struct.resolve_pointer(&ustr_tag.strings.pointer)];
+                    const auto *string_list = reinterpret_cast<const Parser::UnicodeStringListString::struct_little *>(string_list_struct.data.data());
+                    const auto *string_list_other = reinterpret_cast<const Parser::UnicodeStringListString::struct_little *>(loc_tag_struct_other_data + ustr_tag_other.strings.pointer);
+
+                    if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(string_list_other + string_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (strings go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    // Check each string
+                    for(std::size_t s = 0; s < string_count && match; s++) {
+                        const auto &string = string_list[s];
+                        const auto &string_other = string_list_other[s];
+                        std::size_t string_data_size = string.string.size;
+                        std::size_t string_data_size_other = string_other.string.size;
+
+                        // Make sure the sizes match
+                        if(string_data_size != string_data_size_other) {
+                            match = false;
+                            break;
+                        }
+
+                        if(string_data_size > 0) {
+                            const auto *string_data = this->structs[*string_list_struct.resolve_pointer(&string.string.pointer)].data.data();
+                            const auto *string_data_other = loc_tag_struct_other_data + string_other.string.pointer;
+
+                            if(static_cast<std::size_t>(string_data_other + string_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                                REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (string goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                                match = false;
+                                break;
+                            }
+
+                            match = std::memcmp(string_data, string_data_other, string_data_size) == 0;
+                            if(!match) {
+                                break;
+                            }
+                        }
+                    }
+                }
+                break;
+            }
+            case TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT: {
+                const auto &hud_message_tag = *reinterpret_cast<const Parser::HUDMessageText::struct_little *>(loc_tag_struct.data.data());
+                if(loc_tag_struct_other_size < sizeof(hud_message_tag)) {
+                    REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (unicode string list main struct goes out of bounds)", t.path.c_str());
+                    match = false;
+                    break;
+                }
+                const auto &hud_message_tag_other = *reinterpret_cast<const Parser::HUDMessageText::struct_little *>(loc_tag_struct_other_data);
+
+                std::size_t message_count = hud_message_tag.messages.count;
+                std::size_t message_count_other = hud_message_tag_other.messages.count;
+
+                std::size_t message_element_count = hud_message_tag.message_elements.count;
+                std::size_t message_element_count_other = hud_message_tag_other.message_elements.count;
+
+                std::size_t text_data_size = hud_message_tag.text_data.size;
+                std::size_t text_data_size_other = hud_message_tag_other.text_data.size;
+
+                match = message_count == message_count_other && message_element_count == message_element_count_other && text_data_size == text_data_size_other;
+
+                // Give up if needed
+                if(!match) {
+                    break;
+                }
+
+                // Make sure the messages are the same
+                if(message_count > 0) {
+                    const auto *messages = reinterpret_cast<const Parser::HUDMessageTextMessage::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.messages.pointer)].data.data());
+                    const auto *messages_other = reinterpret_cast<const Parser::HUDMessageTextMessage::struct_little *>(loc_tag_struct_other_data + hud_message_tag_other.messages.pointer);
+
+                    if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(messages_other + message_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (messages go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    for(std::size_t i = 0; i < message_count; i++) {
+                        auto &message = messages[i];
+                        auto &message_other = messages_other[i];
+
+                        // If they are different, bail
+                        match = message.name == message_other.name && message.panel_count == message_other.panel_count && message.start_index_into_text_blob == message_other.start_index_into_text_blob && message.start_index_of_message_block == message_other.start_index_of_message_block;
+                        if(!match) {
+                            break;
+                        }
+                    }
+                }
+
+                // Make sure the message elements are the same
+                if(message_element_count > 0) {
+                    const auto *message_elements = reinterpret_cast<const Parser::HUDMessageTextElement::struct_little *>(this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.message_elements.pointer)].data.data());
+                    const auto *message_elements_other = reinterpret_cast<const Parser::HUDMessageTextElement::struct_little *>(loc_tag_struct_other_data + hud_message_tag_other.message_elements.pointer);
+
+                    if(static_cast<std::size_t>(reinterpret_cast<const std::byte *>(message_elements_other + message_element_count) - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (message elements go out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    for(std::size_t i = 0; i < message_element_count && match; i++) {
+                        auto &element = message_elements[i];
+                        auto &element_other = message_elements_other[i];
+
+                        // If they are different, bail
+                        match = element.data == element_other.data && element.type == element_other.type;
+                        if(!match) {
+                            break;
+                        }
+                    }
+                }
+
+                // Make sure the text data is the same
+                if(text_data_size > 0) {
+                    const auto *text_data = this->structs[*loc_tag_struct.resolve_pointer(&hud_message_tag.text_data.pointer)].data.data();
+                    const auto *text_data_other = loc_tag_struct_other_data + hud_message_tag_other.text_data.pointer;
+
+                    if(static_cast<std::size_t>(text_data_other + text_data_size - loc_tag_struct_other_data) > loc_tag_struct_other_size) {
+                        REPORT_ERROR_PRINTF(errors, ERROR_TYPE_ERROR, std::nullopt, "%s in loc.map appears to be corrupt (text data goes out of bounds)", File::halo_path_to_preferred_path(t.path).c_str());
+                        match = false;
+                        break;
+                    }
+
+                    match = std::memcmp(text_data, text_data_other, text_data_size) == 0;
+                }
+                break;
+            }
+            default:
+                // There is no way we can get here
+                std::terminate();
+        }
+        return match;
+    }
+}
@@ -0,0 +1,513 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+
+#include <invader/build/build_workload.hpp>
+#include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/version.hpp>
+
+namespace Invader {
+    // Increment this if the format of cached tags changes
+    static constexpr std::uint32_t TAG_CACHE_VERSION = 2;
+    static constexpr char TAG_CACHE_MAGIC[8] = { 'i', 'n', 'v', 't', 'c', 'a', 'c', 'h' };
+
+    // Only tags that don't read anything from the tags they depend on (or anything else outside of their own tag file) can be cached.
+    // Everything else is left out on purpose:
+    // - shaders check the type of the bitmaps they reference, and objects gather predicted resources from the tags they reference
+    // - bitmaps and sounds put their pixels and samples in raw data (which may end up in a resource map), which isn't cached
+    // - models put their vertices and indices in model data, where they're deduplicated against models compiled before them
+    // - BSPs put their data in BSP data and read the shaders, fog, and lightmap bitmaps they reference
+    // - scenarios merge child scenarios, open the globals and HUD message text tags, and read the objects they place
+    static bool tag_class_can_be_cached(TagFourCC tag_fourcc) noexcept {
+        switch(tag_fourcc) {
+            case TagFourCC::TAG_FOURCC_ACTOR:
+            case TagFourCC::TAG_FOURCC_ACTOR_VARIANT:
+            case TagFourCC::TAG_FOURCC_ANTENNA:
+            case TagFourCC::TAG_FOURCC_CAMERA_TRACK:
+            case TagFourCC::TAG_FOURCC_COLOR_TABLE:
+            case TagFourCC::TAG_FOURCC_CONTRAIL:
+            case TagFourCC::TAG_FOURCC_DECAL:
+            case TagFourCC::TAG_FOURCC_DIALOGUE:
+            case TagFourCC::TAG_FOURCC_FOG:
+            case TagFourCC::TAG_FOURCC_FONT:
+            case TagFourCC::TAG_FOURCC_GLOW:
+            case TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT:
+            case TagFourCC::TAG_FOURCC_HUD_NUMBER:
+            case TagFourCC::TAG_FOURCC_INPUT_DEVICE_DEFAULTS:
+            case TagFourCC::TAG_FOURCC_ITEM_COLLECTION:
+            case TagFourCC::TAG_FOURCC_LIGHT:
+            case TagFourCC::TAG_FOURCC_LIGHTNING:
+            case TagFourCC::TAG_FOURCC_MATERIAL_EFFECTS:
+            case TagFourCC::TAG_FOURCC_METER:
+            case TagFourCC::TAG_FOURCC_MODEL_ANIMATIONS:
+            case TagFourCC::TAG_FOURCC_MODEL_COLLISION_GEOMETRY:
+            case TagFourCC::TAG_FOURCC_MULTIPLAYER_SCENARIO_DESCRIPTION:
+            case TagFourCC::TAG_FOURCC_PHYSICS:
+            case TagFourCC::TAG_FOURCC_POINT_PHYSICS:
+            case TagFourCC::TAG_FOURCC_SKY:
+            case TagFourCC::TAG_FOURCC_SOUND_ENVIRONMENT:
+            case TagFourCC::TAG_FOURCC_STRING_LIST:
+            case TagFourCC::TAG_FOURCC_TAG_COLLECTION:
+            case TagFourCC::TAG_FOURCC_UI_WIDGET_COLLECTION:
+            case TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST:
+            case TagFourCC::TAG_FOURCC_VIRTUAL_KEYBOARD:
+            case TagFourCC::TAG_FOURCC_WIND:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static void write_value(std::vector<std::byte> &data, std::uint64_t value) {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    static void write_bytes(std::vector<std::byte> &data, const void *bytes, std::size_t size) {
+        write_value(data, size);
+        data.insert(data.end(), reinterpret_cast<const std::byte *>(bytes), reinterpret_cast<const std::byte *>(bytes) + size);
+    }
+
+    // Reads a cached tag, failing (rather than throwing) if it's truncated
+    class TagCacheReader {
+    public:
+        TagCacheReader(const std::vector<std::byte> &data) noexcept : data(data) {}
+
+        bool read_value(std::uint64_t &value) noexcept {
+            if(this->data.size() - this->offset < sizeof(value)) {
+                return false;
+            }
+            value = 0;
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                value |= static_cast<std::uint64_t>(this->data[this->offset++]) << (i * 8);
+            }
+            return true;
+        }
+
+        template <typename T> bool read_value(T &value) noexcept {
+            std::uint64_t value_read;
+            if(!this->read_value(value_read)) {
+                return false;
+            }
+            value = static_cast<T>(value_read);
+            return true;
+        }
+
+        bool read_bytes(const std::byte *&bytes, std::size_t &size) noexcept {
+            if(!this->read_value(size) || this->data.size() - this->offset < size) {
+                return false;
+            }
+            bytes = this->data.data() + this->offset;
+            this->offset += size;
+            return true;
+        }
+
+        bool done() const noexcept {
+            return this->offset == this->data.size();
+        }
+
+    private:
+        const std::vector<std::byte> &data;
+        std::size_t offset = 0;
+    };
+
+    static std::vector<std::size_t> get_tag_cache_side_effects(const BuildWorkload &workload) {
+        return {
+            workload.get_warnings(),
+            workload.get_errors(),
+            workload.tags.size(),
+            workload.raw_data.size(),
+            workload.uncompressed_model_vertices.size(),
+            workload.compressed_model_vertices.size(),
+            workload.model_indices.size(),
+            workload.model_parts.size(),
+            workload.bsp_data.size(),
+            workload.bsp_count
+        };
+    }
+
+    std::optional<std::uint64_t> BuildWorkload::get_tag_cache_key(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_index, TagFourCC tag_fourcc) const {
+        if(!this->parameters || (!this->parameters->tag_cache_directory.has_value() && !this->parameters->shared_tag_cache && !this->parameters->remote_tag_cache) || this->disable_recursion || !tag_class_can_be_cached(tag_fourcc)) {
+            return std::nullopt;
+        }
+
+        // Anything that can change how the tag is compiled has to go in here
+        FNV1AHash key;
+        auto &details = this->parameters->details;
+        const char *version = full_version();
+        key.add_uint64_le(TAG_CACHE_VERSION);
+        key.add_bytes(version, std::strlen(version));
+        key.add_uint64_le(static_cast<std::uint64_t>(details.build_cache_file_engine));
+        key.add_uint64_le(static_cast<std::uint64_t>(details.build_game_engine));
+        key.add_uint64_le(this->cache_file_type.has_value() ? static_cast<std::uint64_t>(*this->cache_file_type) : 0xFFFFFFFFFFFFFFFF);
+        key.add_uint64_le(static_cast<std::uint64_t>(this->get_reporting_level()));
+        key.add_uint64_le(this->disable_error_checking);
+        key.add_uint64_le(this->parameters->check_only);
+        key.add_uint64_le(this->building_stock_map);
+        key.add_uint64_le(this->jason_jones);
+        key.add_uint64_le(this->demo_ui);
+        key.add_uint64_le(this->parameters->animation_trim_tolerance.has_value());
+        auto animation_trim_tolerance = this->parameters->animation_trim_tolerance.value_or(0.0F);
+        key.add_bytes(&animation_trim_tolerance, sizeof(animation_trim_tolerance));
+        key.add_uint64_le(static_cast<std::uint64_t>(tag_fourcc));
+        auto &path = this->tags[tag_index].path;
+        key.add_bytes(path.data(), path.size());
+        key.add_uint64_le(tag_data_size);
+        key.add_bytes(tag_data, tag_data_size);
+        return key.get();
+    }
+
+    static std::string get_tag_cache_file_name(std::uint64_t key) {
+        char file_name[64];
+        std::snprintf(file_name, sizeof(file_name), "%016llx.tagcache", static_cast<unsigned long long>(key));
+        return file_name;
+    }
+
+    // Write it under a name nobody else will use and then rename it into place, so another build (or another machine) reading
+    // the cache never sees a partially written tag; if it was stored by someone else first, it's the same tag, so replace it
+    static void save_tag_cache_file(const std::filesystem::path &directory, const std::string &file_name, const std::vector<std::byte> &data) {
+        auto path = directory / file_name;
+        std::error_code ec;
+        static thread_local std::mt19937_64 random(std::random_device{}());
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(random()));
+        auto temporary_path = path;
+        temporary_path += suffix;
+
+        std::filesystem::create_directories(directory, ec);
+        if(!File::save_file(temporary_path, data)) {
+            return;
+        }
+        std::filesystem::rename(temporary_path, path, ec);
+        if(ec) {
+            std::filesystem::remove(temporary_path, ec);
+        }
+    }
+
+    std::filesystem::path BuildWorkload::get_tag_cache_path(std::uint64_t key) const {
+        return *this->parameters->tag_cache_directory / get_tag_cache_file_name(key);
+    }
+
+    std::optional<std::vector<std::byte>> BuildWorkload::DirectoryRemoteTagCache::fetch(std::uint64_t key) {
+        // Most lookups miss, so check first rather than have open_file() complain
+        auto path = this->directory / get_tag_cache_file_name(key);
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(path, ec)) {
+            return std::nullopt;
+        }
+        return File::open_file(path);
+    }
+
+    void BuildWorkload::DirectoryRemoteTagCache::store(std::uint64_t key, const std::vector<std::byte> &data) {
+        save_tag_cache_file(this->directory, get_tag_cache_file_name(key), data);
+    }
+
+    bool BuildWorkload::load_cached_tag(std::uint64_t key, std::size_t tag_index) {
+        // Check what other builds in this process compiled first, then what was compiled on previous builds
+        auto &shared_tag_cache = this->parameters->shared_tag_cache;
+        std::shared_ptr<const std::vector<std::byte>> cached_tag_data;
+        if(shared_tag_cache) {
+            cached_tag_data = shared_tag_cache->find(key);
+        }
+        if(!cached_tag_data && this->parameters->tag_cache_directory.has_value()) {
+            auto cached_tag_file = File::open_file(this->get_tag_cache_path(key));
+            if(cached_tag_file.has_value()) {
+                cached_tag_data = std::make_shared<const std::vector<std::byte>>(std::move(*cached_tag_file));
+                if(shared_tag_cache) {
+                    shared_tag_cache->insert(key, cached_tag_data);
+                }
+            }
+        }
+
+        // Lastly, check what other machines compiled, keeping a copy so it doesn't have to be fetched again
+        if(!cached_tag_data && this->parameters->remote_tag_cache) {
+            auto cached_tag_file = this->parameters->remote_tag_cache->fetch(key);
+            if(cached_tag_file.has_value()) {
+                cached_tag_data = std::make_shared<const std::vector<std::byte>>(std::move(*cached_tag_file));
+                if(this->parameters->tag_cache_directory.has_value()) {
+                    save_tag_cache_file(*this->parameters->tag_cache_directory, get_tag_cache_file_name(key), *cached_tag_data);
+                }
+                if(shared_tag_cache) {
+                    shared_tag_cache->insert(key, cached_tag_data);
+                }
+            }
+        }
+        if(!cached_tag_data) {
+            return false;
+        }
+
+        struct CachedStruct {
+            const std::byte *data;
+            std::size_t data_size;
+            std::optional<std::size_t> bsp;
+            bool unsafe_to_dedupe;
+
+            // Dependencies point to the call that returned the tag (or 0 for this tag), and pointers point to the index of the struct in the cache
+            std::vector<BuildWorkloadDependency> dependencies;
+            std::vector<BuildWorkloadStructPointer> pointers;
+        };
+
+        std::vector<File::TagFilePath> calls;
+        std::vector<std::size_t> struct_counts;
+        std::vector<CachedStruct> cached_structs;
+
+        // Read everything in first so a bad cached tag doesn't leave a half-compiled tag behind
+        TagCacheReader reader(*cached_tag_data);
+        auto read_cached_tag = [&]() -> bool {
+            const std::byte *bytes;
+            std::size_t size;
+            std::uint64_t value;
+
+            if(!reader.read_bytes(bytes, size) || size != sizeof(TAG_CACHE_MAGIC) || std::memcmp(bytes, TAG_CACHE_MAGIC, size) != 0 || !reader.read_value(value) || value != TAG_CACHE_VERSION || !reader.read_value(value) || value != key) {
+                return false;
+            }
+
+            std::size_t call_count;
+            if(!reader.read_value(call_count) || call_count > cached_tag_data->size()) {
+                return false;
+            }
+            for(std::size_t c = 0; c < call_count; c++) {
+                auto &call = calls.emplace_back();
+                if(!reader.read_value(call.fourcc) || !reader.read_bytes(bytes, size)) {
+                    return false;
+                }
+                call.path = std::string(reinterpret_cast<const char *>(bytes), size);
+            }
+
+            std::size_t struct_count = 0;
+            for(std::size_t c = 0; c <= call_count; c++) {
+                auto &count = struct_counts.emplace_back();
+                if(!reader.read_value(count) || count > cached_tag_data->size()) {
+                    return false;
+                }
+                struct_count += count;
+            }
+            if(struct_count == 0) {
+                return false;
+            }
+
+            for(std::size_t s = 0; s < struct_count; s++) {
+                auto &cached_struct = cached_structs.emplace_back();
+                std::size_t bsp_plus_one, dependency_count, pointer_count;
+                if(!reader.read_bytes(cached_struct.data, cached_struct.data_size) || !reader.read_value(bsp_plus_one) || !reader.read_value(cached_struct.unsafe_to_dedupe) || !reader.read_value(dependency_count) || dependency_count > cached_struct.data_size) {
+                    return false;
+                }
+                if(bsp_plus_one > 0) {
+                    cached_struct.bsp = bsp_plus_one - 1;
+                }
+                for(std::size_t d = 0; d < dependency_count; d++) {
+                    auto &dependency = cached_struct.dependencies.emplace_back();
+                    if(!reader.read_value(dependency.tag_index) || !reader.read_value(dependency.offset) || !reader.read_value(dependency.tag_id_only) || dependency.tag_index > call_count) {
+                        return false;
+                    }
+                    std::size_t end = dependency.offset + (dependency.tag_id_only ? sizeof(HEK::TagID) : sizeof(HEK::TagDependency<HEK::LittleEndian>));
+                    if(end < dependency.offset || end > cached_struct.data_size) {
+                        return false;
+                    }
+                }
+                if(!reader.read_value(pointer_count) || pointer_count > cached_struct.data_size) {
+                    return false;
+                }
+                for(std::size_t p = 0; p < pointer_count; p++) {
+                    auto &pointer = cached_struct.pointers.emplace_back();
+                    if(!reader.read_value(pointer.struct_index) || !reader.read_value(pointer.offset) || !reader.read_value(pointer.limit_to_32_bits) || !reader.read_value(pointer.struct_data_offset) || pointer.struct_index >= struct_count || pointer.offset >= cached_struct.data_size) {
+                        return false;
+                    }
+                }
+            }
+
+            return reader.done();
+        };
+
+        if(!read_cached_tag()) {
+            return false;
+        }
+
+        // Compile the tags this tag depends on in the same order as before, creating this tag's structs in between so every index ends up the same as if the tag was compiled normally
+        std::vector<std::size_t> struct_indices;
+        std::vector<std::size_t> call_results;
+        struct_indices.reserve(cached_structs.size());
+        call_results.reserve(calls.size() + 1);
+        call_results.emplace_back(tag_index);
+
+        this->tags[tag_index].base_struct = this->structs.size();
+        this->begin_tag_cache_recording(key, tag_index);
+        this->tag_cache_recordings.back().cacheable = false; // it's already cached
+
+        for(std::size_t c = 0; c <= calls.size(); c++) {
+            for(std::size_t s = 0; s < struct_counts[c]; s++) {
+                struct_indices.emplace_back(this->structs.size());
+                this->structs.emplace_back();
+            }
+            if(c < calls.size()) {
+                call_results.emplace_back(this->compile_tag_recursively(calls[c].path.c_str(), calls[c].fourcc));
+            }
+        }
+
+        this->tag_cache_recordings.pop_back();
+
+        // Now fill in the structs
+        for(std::size_t s = 0; s < cached_structs.size(); s++) {
+            auto &cached_struct = cached_structs[s];
+            auto &new_struct = this->structs[struct_indices[s]];
+            new_struct.data.insert(new_struct.data.end(), cached_struct.data, cached_struct.data + cached_struct.data_size);
+            new_struct.bsp = cached_struct.bsp;
+            new_struct.unsafe_to_dedupe = cached_struct.unsafe_to_dedupe;
+            new_struct.dependencies = std::move(cached_struct.dependencies);
+            new_struct.pointers = std::move(cached_struct.pointers);
+
+            for(auto &dependency : new_struct.dependencies) {
+                dependency.tag_index = call_results[dependency.tag_index];
+
+                // Put the index back in the tag ID like it would be when compiled normally
+                auto *tag_id = reinterpret_cast<HEK::LittleEndian<HEK::TagID> *>(new_struct.data.data() + dependency.offset);
+                if(!dependency.tag_id_only) {
+                    tag_id = &reinterpret_cast<HEK::TagDependency<HEK::LittleEndian> *>(new_struct.data.data() + dependency.offset)->tag_id;
+                }
+                HEK::TagID new_tag_id = tag_id->read();
+                new_tag_id.index = static_cast<std::uint16_t>(dependency.tag_index);
+                *tag_id = new_tag_id;
+            }
+            for(auto &pointer : new_struct.pointers) {
+                pointer.struct_index = struct_indices[pointer.struct_index];
+            }
+        }
+
+        return true;
+    }
+
+    void BuildWorkload::begin_tag_cache_recording(std::uint64_t key, std::size_t tag_index) {
+        auto &recording = this->tag_cache_recordings.emplace_back();
+        recording.tag_index = tag_index;
+        recording.key = key;
+        recording.struct_start = this->structs.size();
+        recording.side_effects = get_tag_cache_side_effects(*this);
+    }
+
+    void BuildWorkload::end_tag_cache_struct_run(TagCacheRecording &recording) {
+        std::size_t struct_end = this->structs.size();
+        for(std::size_t s = recording.struct_start; s < struct_end; s++) {
+            recording.struct_indices.emplace_back(s);
+        }
+        recording.struct_counts.emplace_back(struct_end - recording.struct_start);
+
+        // If anything else changed, it's not something we can cache
+        if(get_tag_cache_side_effects(*this) != recording.side_effects) {
+            recording.cacheable = false;
+        }
+    }
+
+    void BuildWorkload::end_tag_cache_recording(std::size_t tag_index) {
+        // Find our recording, discarding anything left over from tags that failed to compile
+        while(!this->tag_cache_recordings.empty() && this->tag_cache_recordings.back().tag_index != tag_index) {
+            this->tag_cache_recordings.pop_back();
+        }
+        if(this->tag_cache_recordings.empty()) {
+            return;
+        }
+
+        auto recording = std::move(this->tag_cache_recordings.back());
+        this->tag_cache_recordings.pop_back();
+        this->end_tag_cache_struct_run(recording);
+
+        auto &tag = this->tags[tag_index];
+        if(!recording.cacheable || recording.struct_indices.empty() || tag.base_struct != recording.struct_indices[0] || !tag.asset_data.empty()) {
+            return;
+        }
+
+        // Every struct has to belong to this tag, and every dependency has to be one this tag compiled (or this tag itself)
+        std::unordered_map<std::size_t, std::size_t> local_struct_indices;
+        for(auto &s : recording.struct_indices) {
+            local_struct_indices.emplace(s, local_struct_indices.size());
+        }
+
+        std::vector<std::byte> cached_tag_data;
+        write_bytes(cached_tag_data, TAG_CACHE_MAGIC, sizeof(TAG_CACHE_MAGIC));
+        write_value(cached_tag_data, TAG_CACHE_VERSION);
+        write_value(cached_tag_data, recording.key);
+        write_value(cached_tag_data, recording.calls.size());
+        for(auto &call : recording.calls) {
+            write_value(cached_tag_data, static_cast<std::uint64_t>(call.first.fourcc));
+            write_bytes(cached_tag_data, call.first.path.data(), call.first.path.size());
+        }
+        for(auto &count : recording.struct_counts) {
+            write_value(cached_tag_data, count);
+        }
+
+        for(auto &s : recording.struct_indices) {
+            auto &cached_struct = this->structs[s];
+            write_bytes(cached_tag_data, cached_struct.data.data(), cached_struct.data.size());
+            write_value(cached_tag_data, cached_struct.bsp.has_value() ? *cached_struct.bsp + 1 : 0);
+            write_value(cached_tag_data, cached_struct.unsafe_to_dedupe);
+
+            write_value(cached_tag_data, cached_struct.dependencies.size());
+            for(auto &dependency : cached_struct.dependencies) {
+                std::optional<std::size_t> call_index;
+                if(dependency.tag_index == tag_index) {
+                    call_index = 0;
+                }
+                else {
+                    for(std::size_t c = 0; c < recording.calls.size(); c++) {
+                        if(recording.calls[c].second == dependency.tag_index) {
+                            call_index = c + 1;
+                            break;
+                        }
+                    }
+                }
+                if(!call_index.has_value()) {
+                    return;
+                }
+                write_value(cached_tag_data, *call_index);
+                write_value(cached_tag_data, dependency.offset);
+                write_value(cached_tag_data, dependency.tag_id_only);
+            }
+
+            write_value(cached_tag_data, cached_struct.pointers.size());
+            for(auto &pointer : cached_struct.pointers) {
+                auto local_struct_index = local_struct_indices.find(pointer.struct_index);
+                if(local_struct_index == local_struct_indices.end()) {
+                    return;
+                }
+                write_value(cached_tag_data, local_struct_index->second);
+                write_value(cached_tag_data, pointer.offset);
+                write_value(cached_tag_data, pointer.limit_to_32_bits);
+                write_value(cached_tag_data, pointer.struct_data_offset);
+            }
+        }
+
+        // Failing to cache a tag isn't fatal; it'll just get compiled again next time
+        if(this->parameters->tag_cache_directory.has_value()) {
+            save_tag_cache_file(*this->parameters->tag_cache_directory, get_tag_cache_file_name(recording.key), cached_tag_data);
+        }
+        if(this->parameters->remote_tag_cache) {
+            this->parameters->remote_tag_cache->store(recording.key, cached_tag_data);
+        }
+        if(this->parameters->shared_tag_cache) {
+            this->parameters->shared_tag_cache->insert(recording.key, std::make_shared<const std::vector<std::byte>>(std::move(cached_tag_data)));
+        }
+    }
+
+    std::size_t BuildWorkload::compile_tag_recursively(const char *tag_path, TagFourCC tag_fourcc) {
+        if(this->tag_cache_recordings.empty()) {
+            return this->compile_tag_recursively_internal(tag_path, tag_fourcc);
+        }
+
+        // Whatever this tag does belongs to it, not to the tag depending on it
+        std::size_t recording_index = this->tag_cache_recordings.size() - 1;
+        this->end_tag_cache_struct_run(this->tag_cache_recordings[recording_index]);
+
+        auto tag_index = this->compile_tag_recursively_internal(tag_path, tag_fourcc);
+
+        auto &recording = this->tag_cache_recordings[recording_index];
+        recording.calls.emplace_back(File::TagFilePath(tag_path, tag_fourcc), tag_index);
+        recording.struct_start = this->structs.size();
+        recording.side_effects = get_tag_cache_side_effects(*this);
+
+        return tag_index;
+    }
+}
@@ -9,6 +9,7 @@
 #include <optional>
 
 #include <invader/hek/map.hpp>
+#include <invader/printf.hpp>
 
 #ifdef USES_NIX_COLORS
 #include <sys/ioctl.h>
@@ -376,7 +377,8 @@ namespace Invader {
             PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE,
             PRESET_COMMAND_LINE_OPTION_GAME_ENGINE,
             PRESET_COMMAND_LINE_OPTION_BATCH,
-            PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE
+            PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE,
+            PRESET_COMMAND_LINE_OPTION_THREADS
         };
         
         static CommandLineOption from_preset(PresetCommandLineOption option) {
@@ -409,10 +411,31 @@ namespace Invader {
                     return CommandLineOption("batch", 'b', 1, "Run the command on all tags with a given expression.", "<expr>");
                 case PresetCommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE:
                     return CommandLineOption("batch-exclude", 'e', 1, "Run the command on all tags that do not match a given expression. This takes precedence over --batch", "<expr>");
+                case PresetCommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS:
+                    return CommandLineOption("threads", 'j', 1, "Set the number of threads to use. Default: CPU thread count", "<count>");
                     
             }
             std::terminate();
         };
+
+        /**
+         * Parse the argument given to -j/--threads, exiting if it isn't a positive number
+         * @param argument argument to parse
+         * @return         number of threads
+         */
+        static std::size_t parse_thread_count(const char *argument) {
+            try {
+                int thread_count = std::stoi(argument);
+                if(thread_count < 1) {
+                    throw std::exception();
+                }
+                return static_cast<std::size_t>(thread_count);
+            }
+            catch(std::exception &) {
+                eprintf_error("Invalid number of threads %s", argument);
+                std::exit(EXIT_FAILURE);
+            }
+        }
     };
 }
 
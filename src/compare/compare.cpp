@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <cstring>
 #include <regex>
@@ -12,8 +14,10 @@
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/extract/extraction.hpp>
+#include <invader/thread_pool.hpp>
 #include "../command_line_option.hpp"
 
 using namespace Invader;
@@ -49,7 +53,102 @@ enum ByPath {
     BY_PATH_DIFFERENT = 2
 };
 
-static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count);
+// Content hashes of tags, which can be kept between runs so unchanged tags don't need to be read again to be hashed
+class TagHashCache {
+public:
+    // Increment this if the format of the cache changes
+    static constexpr std::uint64_t VERSION = 1;
+    static constexpr char MAGIC[8] = { 'i', 'n', 'v', 'c', 'm', 'p', 'h', 'c' };
+
+    void load(const std::filesystem::path &path) {
+        auto data = File::open_file(path);
+        if(!data.has_value() || data->size() < sizeof(MAGIC) || std::memcmp(data->data(), MAGIC, sizeof(MAGIC)) != 0) {
+            return;
+        }
+
+        std::size_t offset = sizeof(MAGIC);
+        auto read_value = [&data, &offset](std::uint64_t &value) -> bool {
+            if(data->size() - offset < sizeof(value)) {
+                return false;
+            }
+            value = 0;
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                value |= static_cast<std::uint64_t>((*data)[offset++]) << (i * 8);
+            }
+            return true;
+        };
+
+        std::uint64_t version, count;
+        if(!read_value(version) || version != VERSION || !read_value(count)) {
+            return;
+        }
+
+        // Throw away the whole thing if anything is wrong with it
+        std::unordered_map<std::string, Entry> entries;
+        for(std::uint64_t e = 0; e < count; e++) {
+            std::uint64_t key_length, size, modification_time, hash;
+            if(!read_value(key_length) || data->size() - offset < key_length) {
+                return;
+            }
+            std::string key(reinterpret_cast<const char *>(data->data() + offset), key_length);
+            offset += key_length;
+            if(!read_value(size) || !read_value(modification_time) || !read_value(hash)) {
+                return;
+            }
+            entries[std::move(key)] = { size, static_cast<std::int64_t>(modification_time), hash };
+        }
+
+        if(offset == data->size()) {
+            this->entries = std::move(entries);
+        }
+    }
+
+    bool save(const std::filesystem::path &path) const {
+        std::vector<std::byte> data(reinterpret_cast<const std::byte *>(MAGIC), reinterpret_cast<const std::byte *>(MAGIC) + sizeof(MAGIC));
+        auto write_value = [&data](std::uint64_t value) {
+            for(std::size_t i = 0; i < sizeof(value); i++) {
+                data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+            }
+        };
+
+        write_value(VERSION);
+        write_value(this->entries.size());
+        for(auto &[key, entry] : this->entries) {
+            write_value(key.size());
+            data.insert(data.end(), reinterpret_cast<const std::byte *>(key.data()), reinterpret_cast<const std::byte *>(key.data()) + key.size());
+            write_value(entry.size);
+            write_value(static_cast<std::uint64_t>(entry.modification_time));
+            write_value(entry.hash);
+        }
+
+        return File::save_file(path, data);
+    }
+
+    std::optional<std::uint64_t> find(const std::string &key, std::uint64_t size, std::int64_t modification_time) {
+        std::scoped_lock lock(this->mutex);
+        auto entry = this->entries.find(key);
+        if(entry == this->entries.end() || entry->second.size != size || entry->second.modification_time != modification_time) {
+            return std::nullopt;
+        }
+        return entry->second.hash;
+    }
+
+    void add(const std::string &key, std::uint64_t size, std::int64_t modification_time, std::uint64_t hash) {
+        std::scoped_lock lock(this->mutex);
+        this->entries[key] = { size, modification_time, hash };
+    }
+
+private:
+    struct Entry {
+        std::uint64_t size;
+        std::int64_t modification_time;
+        std::uint64_t hash;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    std::mutex mutex;
+};
+
+static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count, TagHashCache *hash_cache);
 
 int main(int argc, const char **argv) {
     set_up_color_term();
@@ -66,9 +165,11 @@ int main(int argc, const char **argv) {
         bool verbose = false;
         ByPath by_path = ByPath::BY_PATH_SAME;
         Show show = Show::SHOW_ALL;
-        std::optional<std::size_t> job_count;
+        std::size_t job_count = ThreadPool::get_shared_thread_count();
         std::vector<std::string> search;
         std::vector<std::string> search_exclude;
+        bool hash_first = false;
+        std::optional<std::filesystem::path> hash_cache;
     } compare_options;
 
     const CommandLineOption options[] = {
@@ -86,7 +187,9 @@ int main(int argc, const char **argv) {
         CommandLineOption("ignore-resources", 'G', 0, "Ignore resource maps for the current map input. This option must be used after --input."),
         CommandLineOption("verbose", 'v', 0, "Output more information on the differences between tags to standard output. This will not work with --functional."),
         CommandLineOption("all", 'a', 0, "Only match if tags are in all inputs."),
-        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for comparison. Default: 1")
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("hash-first", 'H', 0, "Hash the contents of each tag first and only compare tags whose contents differ. Tags in tags directories are hashed as-is, and tags in maps are hashed after being extracted."),
+        CommandLineOption("hash-cache", 'C', 1, "Keep the hashes of tags in the given file between runs so unchanged tags don't need to be read again. This implies --hash-first.", "<file>")
     };
 
     static constexpr char DESCRIPTION[] = "Compare tags against other tags.";
@@ -118,13 +221,7 @@ int main(int argc, const char **argv) {
                 break;
 
             case 'j':
-                try {
-                    compare_options.job_count = std::stoul(args[0]);
-                }
-                catch(std::exception &) {
-                    eprintf_error("Invalid number of threads %s\n", args[0]);
-                    std::exit(EXIT_FAILURE);
-                }
+                compare_options.job_count = CommandLineOption::parse_thread_count(args[0]);
                 break;
 
             case 'B':
@@ -216,6 +313,15 @@ int main(int argc, const char **argv) {
                 compare_options.match_all = true;
                 break;
 
+            case 'H':
+                compare_options.hash_first = true;
+                break;
+
+            case 'C':
+                compare_options.hash_first = true;
+                compare_options.hash_cache = args[0];
+                break;
+
             case 'S':
                 if(std::strcmp(args[0], "all") == 0) {
                     compare_options.show = Show::SHOW_ALL;
@@ -240,19 +346,18 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    // Default 0 to 1
-    if(!compare_options.job_count.has_value()) {
-        compare_options.job_count = 1;
-    }
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(compare_options.job_count);
 
     // Can we close it?
     close_input(compare_options);
 
     // Automatically make up maps directories for any map when necessary, then open their respective resources
+    File::PathMatcher search_matcher(compare_options.search, compare_options.search_exclude);
     for(auto &i : compare_options.inputs) {
         // Check if it matches our filters
-        auto add_if_matched = [&i, &compare_options](Invader::File::TagFilePath &&path) {
-            if(File::path_matches(Invader::File::preferred_path_to_halo_path(path.join()).c_str(), compare_options.search, compare_options.search_exclude)) {
+        auto add_if_matched = [&i, &search_matcher](Invader::File::TagFilePath &&path) {
+            if(search_matcher.matches(Invader::File::preferred_path_to_halo_path(path.join()).c_str())) {
                 i.tag_paths.emplace_back(std::move(path));
             }
         };
@@ -261,14 +366,21 @@ int main(int argc, const char **argv) {
             // If we don't have a maps directory explicitly set, use the current directory of the map
             auto maps = i.maps.value_or(std::filesystem::absolute(*i.map).parent_path());
             // Load resource maps
-            std::vector<std::byte> loc, bitmaps, sounds;
+            std::optional<ResourceMapView> loc, bitmaps, sounds;
             if(!i.ignore_resource_maps) {
-                auto open_if_present = [](const std::filesystem::path &path) -> std::vector<std::byte> {
-                    if(std::filesystem::exists(path)) {
-                        return File::open_file(path).value_or(std::vector<std::byte>());
+                auto open_if_present = [](const std::filesystem::path &path) -> std::optional<ResourceMapView> {
+                    if(!std::filesystem::exists(path)) {
+                        return std::nullopt;
                     }
-                    else {
-                        return {};
+                    try {
+                        return ResourceMapView::map_file(path);
+                    }
+                    catch(FailedToOpenFileException &) {
+                        return std::nullopt;
+                    }
+                    catch(std::exception &e) {
+                        eprintf_warn("Failed to read %s: %s", path.string().c_str(), e.what());
+                        return std::nullopt;
                     }
                 };
                 loc = open_if_present(maps / "loc.map");
@@ -276,13 +388,13 @@ int main(int argc, const char **argv) {
                 sounds = open_if_present(maps / "sounds.map");
             }
 
-            auto data = File::open_file(*i.map);
+            auto data = File::MemoryMappedFile::map_file(*i.map);
             if(!data.has_value()) {
                 eprintf_error("Failed to read %s", i.map->string().c_str());
                 return EXIT_FAILURE;
             }
 
-            auto &map = *(i.map_data = std::make_unique<Map>(Map::map_with_move(*std::move(data),std::move(bitmaps),std::move(loc),std::move(sounds))));
+            auto &map = *(i.map_data = std::make_unique<Map>(Map::map_with_mmap(*std::move(data),std::move(bitmaps),std::move(loc),std::move(sounds))));
 
             // Warn if we failed to open some resource maps
             if(!i.ignore_resource_maps) {
@@ -335,10 +447,90 @@ int main(int argc, const char **argv) {
         i.tag_paths.shrink_to_fit();
     }
 
-    regular_comparison(compare_options.inputs, compare_options.precision, compare_options.show, compare_options.match_all, compare_options.functional, compare_options.by_path, compare_options.verbose, *compare_options.job_count);
+    std::optional<TagHashCache> hash_cache;
+    if(compare_options.hash_first) {
+        hash_cache.emplace();
+        if(compare_options.hash_cache.has_value()) {
+            hash_cache->load(*compare_options.hash_cache);
+        }
+    }
+
+    regular_comparison(compare_options.inputs, compare_options.precision, compare_options.show, compare_options.match_all, compare_options.functional, compare_options.by_path, compare_options.verbose, compare_options.job_count, hash_cache.has_value() ? &*hash_cache : nullptr);
+
+    if(compare_options.hash_cache.has_value() && !hash_cache->save(*compare_options.hash_cache)) {
+        eprintf_warn("Warning: Failed to save the hash cache to %s", compare_options.hash_cache->string().c_str());
+    }
 }
 
-static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count) {
+// A tag found in an input (index of the tag in the map or in the input's virtual directory)
+struct TagSource {
+    std::size_t input_index;
+    std::size_t index;
+};
+
+// A tag loaded from an input, shared between threads so each tag is only loaded (and compiled) once
+struct CachedTag {
+    std::once_flag parsed_flag;
+    std::shared_ptr<Parser::ParserStruct> parsed;
+    std::once_flag functional_flag;
+    std::shared_ptr<const std::vector<std::uint8_t>> functional_data;
+};
+
+// Compile the tag and put everything that affects the compiled result into one buffer
+static std::vector<std::uint8_t> compile_for_functional_comparison(Parser::ParserStruct &struct_v, TagFourCC tag_fourcc) {
+    auto hdata = struct_v.generate_hek_tag_data(tag_fourcc);
+    std::vector<std::uint8_t> meme_data;
+
+    // Compile it
+    auto compiled = BuildWorkload::compile_single_tag(hdata.data(), hdata.size());
+
+    // Process each struct
+    for(auto &s : compiled.structs) {
+        // Process struct data
+        meme_data.insert(meme_data.end(), reinterpret_cast<const std::uint8_t *>(s.data.data()), reinterpret_cast<const std::uint8_t *>(s.data.data() + s.data.size()));
+
+        // Process each dependency
+        for(auto &d : s.dependencies) {
+            char o[1024] = {};
+            auto len = std::snprintf(o, sizeof(o), "D:%08zX->%08zX!", d.offset, d.tag_index);
+            meme_data.insert(meme_data.end(), o, o + len);
+        }
+
+        // Process each pointer
+        for(auto &p : s.pointers) {
+            char o[1024] = {};
+            auto len = std::snprintf(o, sizeof(o), "P:%08zX->%08zX!", p.offset, p.struct_index);
+            meme_data.insert(meme_data.end(), o, o + len);
+        }
+    }
+
+    // Process each tag
+    for(auto &t : compiled.tags) {
+        char o[1024] = {};
+        auto len = std::snprintf(o, sizeof(o), "T:%s.%s!", t.path.c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
+        meme_data.insert(meme_data.end(), o, o + len);
+
+        // Raw data pointers
+        for(auto &ad : t.asset_data) {
+            std::snprintf(o, sizeof(o), "AD:%zu!", ad);
+            meme_data.insert(meme_data.end(), o, o + len);
+        }
+    }
+
+    // And of course we need the raw data and model data
+    for(auto &rd : compiled.raw_data) {
+        meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*rd.begin()), reinterpret_cast<std::uint8_t *>(&*rd.end()));
+    }
+
+    // Lastly, model data
+    meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.uncompressed_model_vertices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.uncompressed_model_vertices.end()));
+    meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.compressed_model_vertices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.compressed_model_vertices.end()));
+    meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.model_indices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.model_indices.end()));
+
+    return meme_data;
+}
+
+static void regular_comparison(const std::vector<Input> &inputs, bool precision, Show show, bool match_all, bool functional, ByPath by_path, bool verbose, std::size_t job_count, TagHashCache *hash_cache) {
     // Find all tags we have in common first
     auto input_count = inputs.size();
     std::vector<File::TagFilePath> tags;
@@ -413,294 +605,321 @@ static void regular_comparison(const std::vector<Input> &inputs, bool precision,
     bool show_all = (show & Show::SHOW_ALL) == Show::SHOW_ALL;
 
     // Next, compare each tag
-    std::size_t matched_count = 0;
-    std::size_t mismatched_count = 0;
+    std::atomic<std::size_t> matched_count = 0;
+    std::atomic<std::size_t> mismatched_count = 0;
 
-    std::mutex tag_mutex;
     std::mutex log_mutex;
-    std::size_t tag_index = 0;
-
-    std::vector<std::thread> threads;
-    threads.reserve(job_count);
-    for(std::size_t t = 0; t < job_count; t++) {
-        auto perform_comparison_thread = [](auto *inputs, auto *tags, auto by_path, auto show_all, auto show, auto *matched_count, auto *mismatched_count, auto functional, auto precision, auto verbose, auto *tag_mutex, auto *tag_index, auto *log_mutex) {
-            reset_loop: while(true) {
-                tag_mutex->lock();
-                if(*tag_index >= tags->size()) {
-                    tag_mutex->unlock();
-                    return;
-                }
-                auto &tag = (*tags)[*tag_index];
-                (*tag_index)++;
-                tag_mutex->unlock();
-
-                std::vector<std::unique_ptr<Parser::ParserStruct>> structs;
-                std::vector<std::string> struct_paths;
-                std::vector<const Input *> struct_inputs;
-
-                bool first_input = true;
-                bool only_finding_same_tag = true;
-                auto path_unsplit = File::halo_path_to_preferred_path(tag.path + "." + HEK::tag_fourcc_to_extension(tag.fourcc)); // combine this
 
-                try {
-                    // Go through each input
-                    for(auto &i : *inputs) {
-                        // On the first input, we always break when we find the tag since we're only looking for tags with the same path to match the tag with the outer loop
-                        // On subsequent inputs, we only break if we're *always* looking for tags with the same path.
-                        auto by_path_copy = by_path;
-                        if(first_input) {
-                            first_input = false; // set to false
-                            by_path_copy = ByPath::BY_PATH_SAME;
-                        }
+    // If tags can be compared with tags of a different path, the same tag may be loaded many times, so keep them
+    std::vector<std::unique_ptr<CachedTag[]>> caches(input_count);
+    if(by_path != ByPath::BY_PATH_SAME) {
+        for(std::size_t i = 0; i < input_count; i++) {
+            caches[i] = std::make_unique<CachedTag[]>(inputs[i].map.has_value() ? inputs[i].map_data->get_tag_count() : inputs[i].virtual_directory.size());
+        }
+    }
 
-                        only_finding_same_tag = by_path_copy == ByPath::BY_PATH_SAME;
-
-                        // If it's a map, do this
-                        if(i.map.has_value()) {
-                            // First, extract it
-                            auto tag_count = i.map_data->get_tag_count();
-                            for(std::size_t t = 0; t < tag_count; t++) {
-                                auto &map_tag = i.map_data->get_tag(t);
-                                auto &map_tag_path = map_tag.get_path();
-                                if(map_tag.get_tag_fourcc() == tag.fourcc && CAN_COMPARE(by_path_copy, tag.path, map_tag_path)) {
-                                    // Lock the lock mutex in case issues arise when extracting the tag. This may slow down throughput a bit, but it's better than clobbering standard error while other stuff is logging.
-                                    log_mutex->lock();
-
-                                    bool successful = false;
-                                    try {
-                                        auto extracted_data = Invader::ExtractionWorkload::extract_single_tag(i.map_data->get_tag(t));
-                                        structs.emplace_back(Parser::ParserStruct::parse_hek_tag_file(extracted_data.data(), extracted_data.size(), true));
-                                        struct_paths.emplace_back(map_tag_path);
-                                        struct_inputs.emplace_back(&i);
-                                        successful = true;
-                                    }
-                                    catch(std::exception &e) {
-                                        eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
-                                        successful = false;
-                                    }
-
-                                    // We can now unlock the mutex
-                                    log_mutex->unlock();
-
-                                    // And if we failed, restart the whole loop
-                                    if(!successful) {
-                                        goto reset_loop;
-                                    }
-
-                                    if(only_finding_same_tag) {
-                                        break;
-                                    }
-                                }
-                            }
-                        }
+    // Maps are only hashed again if the map changed
+    std::vector<std::pair<std::uint64_t, std::int64_t>> input_file_info(input_count);
+    for(std::size_t i = 0; i < input_count; i++) {
+        if(inputs[i].map.has_value()) {
+            std::error_code ec;
+            input_file_info[i].first = std::filesystem::file_size(*inputs[i].map, ec);
+            input_file_info[i].second = ec ? 0 : std::filesystem::last_write_time(*inputs[i].map, ec).time_since_epoch().count();
+        }
+    }
 
-                        // If it's a tag, do this
-                        else {
-                            for(auto &vd : i.virtual_directory) {
-                                // Skip if the FourCC is different
-                                if(vd.tag_fourcc != tag.fourcc) {
-                                    continue;
-                                }
-
-                                if(CAN_COMPARE(by_path_copy, path_unsplit, vd.tag_path)) {
-                                    // Open it
-                                    auto file = Invader::File::open_file(vd.full_path).value();
-
-                                    // Parse it
-                                    structs.emplace_back(Parser::ParserStruct::parse_hek_tag_file(file.data(), file.size(), true));
-                                    struct_paths.emplace_back(File::split_tag_class_extension(File::preferred_path_to_halo_path(vd.tag_path)).value().path);
-                                    struct_inputs.emplace_back(&i);
-
-                                    if(only_finding_same_tag) {
-                                        break;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-                catch(std::exception &e) {
-                    log_mutex->lock();
-                    eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
-                    log_mutex->unlock();
-                    continue;
-                }
+    auto compare_tag = [&](std::size_t this_tag_index) {
+        auto &tag = tags[this_tag_index];
 
-                auto found_count = structs.size();
-                if(found_count < 2) {
-                    continue;
-                }
+        std::vector<TagSource> sources;
+        std::vector<std::string> struct_paths;
+        std::vector<const Input *> struct_inputs;
+
+        bool first_input = true;
+        bool only_finding_same_tag = true;
+        auto path_unsplit = File::halo_path_to_preferred_path(tag.path + "." + HEK::tag_fourcc_to_extension(tag.fourcc)); // combine this
+
+        try {
+            // Go through each input
+            for(auto &i : inputs) {
+                std::size_t input_index = &i - inputs.data();
 
-                #define MATCHED(type) "%s%s.%s", show_all ? type ": " : ""
-                #define MATCHED_TO(type) "%s%s.%s, %s.%s", show_all ? type ": " : ""
-                #define MATCHED_TO_DIFFERENT_INPUT(type) "%s%s.%s, %s.%s (%zu)", show_all ? type ": " : ""
+                // On the first input, we always break when we find the tag since we're only looking for tags with the same path to match the tag with the outer loop
+                // On subsequent inputs, we only break if we're *always* looking for tags with the same path.
+                auto by_path_copy = by_path;
+                if(first_input) {
+                    first_input = false; // set to false
+                    by_path_copy = ByPath::BY_PATH_SAME;
+                }
 
-                auto &first_struct = structs[0];
+                only_finding_same_tag = by_path_copy == ByPath::BY_PATH_SAME;
 
-                // Just for setting counter/debugging
-                auto match_log = [&tag, &matched_count, &show, &show_all, &mismatched_count, &struct_paths, &by_path, &struct_inputs, &inputs, &log_mutex](bool did_match, std::size_t i, const std::list<std::string> &other_messages = {}) {
-                    auto *extension = HEK::tag_fourcc_to_extension(tag.fourcc);
-                    auto other_path = File::halo_path_to_preferred_path(struct_paths[i]);
-                    bool show_different_input = inputs->size() > 2; // only need to show differing inputs if we have more than two inputs
-                    std::size_t input_of_other = 1;
+                // If it's a map, do this
+                if(i.map.has_value()) {
+                    auto tag_count = i.map_data->get_tag_count();
+                    for(std::size_t t = 0; t < tag_count; t++) {
+                        auto &map_tag = i.map_data->get_tag(t);
+                        auto &map_tag_path = map_tag.get_path();
+                        if(map_tag.get_tag_fourcc() == tag.fourcc && CAN_COMPARE(by_path_copy, tag.path, map_tag_path)) {
+                            sources.push_back({ input_index, t });
+                            struct_paths.emplace_back(map_tag_path);
+                            struct_inputs.emplace_back(&i);
 
-                    // If we're using multiple inputs, get the input of the other thing
-                    if(show_different_input) {
-                        auto *other_input = struct_inputs[i];
-                        for(auto &i : *inputs) {
-                            if(&i == other_input) {
-                                input_of_other = &i - inputs->data();
+                            if(only_finding_same_tag) {
                                 break;
                             }
                         }
                     }
+                }
 
-                    if(did_match) {
-                        if(show & Show::SHOW_MATCHED) {
-                            log_mutex->lock();
-                            if(by_path == ByPath::BY_PATH_SAME) {
-                                oprintf_success(MATCHED("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc));
-                            }
-                            else if(show_different_input) {
-                                oprintf_success(MATCHED_TO_DIFFERENT_INPUT("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension, input_of_other);
-                            }
-                            else {
-                                oprintf_success(MATCHED_TO("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension);
-                            }
-                            for(auto &i : other_messages) {
-                                oprintf_success("%s", i.c_str());
+                // If it's a tag, do this
+                else {
+                    for(auto &vd : i.virtual_directory) {
+                        // Skip if the FourCC is different
+                        if(vd.tag_fourcc != tag.fourcc) {
+                            continue;
+                        }
+
+                        if(CAN_COMPARE(by_path_copy, path_unsplit, vd.tag_path)) {
+                            sources.push_back({ input_index, static_cast<std::size_t>(&vd - i.virtual_directory.data()) });
+                            struct_paths.emplace_back(File::split_tag_class_extension(File::preferred_path_to_halo_path(vd.tag_path)).value().path);
+                            struct_inputs.emplace_back(&i);
+
+                            if(only_finding_same_tag) {
+                                break;
                             }
-                            log_mutex->unlock();
                         }
-                        (*matched_count)++;
+                    }
+                }
+            }
+        }
+        catch(std::exception &e) {
+            std::scoped_lock lock(log_mutex);
+            eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
+            return;
+        }
+
+        auto found_count = sources.size();
+        if(found_count < 2) {
+            return;
+        }
+
+        // Read a tag (extracting it if it's in a map); data read for hashing is kept so it isn't read twice
+        std::vector<std::optional<std::vector<std::byte>>> source_data(found_count);
+        auto read_source = [&sources, &source_data, &inputs, &log_mutex](std::size_t k) -> std::vector<std::byte> {
+            if(source_data[k].has_value()) {
+                auto data = std::move(*source_data[k]);
+                source_data[k] = std::nullopt;
+                return data;
+            }
+            auto &input = inputs[sources[k].input_index];
+            if(input.map.has_value()) {
+                // Lock the lock mutex in case issues arise when extracting the tag. This may slow down throughput a bit, but it's better than clobbering standard error while other stuff is logging.
+                std::scoped_lock lock(log_mutex);
+                return Invader::ExtractionWorkload::extract_single_tag(input.map_data->get_tag(sources[k].index));
+            }
+            return Invader::File::open_file(input.virtual_directory[sources[k].index].full_path).value();
+        };
+
+        // Load a tag, or get it from the cache if it's already loaded
+        auto load_source = [&caches, &sources, &read_source](std::size_t k) -> std::pair<std::shared_ptr<Parser::ParserStruct>, CachedTag *> {
+            auto load = [&read_source, k]() -> std::shared_ptr<Parser::ParserStruct> {
+                auto data = read_source(k);
+                return Parser::ParserStruct::parse_hek_tag_file(data.data(), data.size(), true);
+            };
+            auto &source = sources[k];
+            if(!caches[source.input_index]) {
+                return { load(), nullptr };
+            }
+            auto &cached = caches[source.input_index][source.index];
+            std::call_once(cached.parsed_flag, [&cached, &load]() { cached.parsed = load(); });
+            return { cached.parsed, &cached };
+        };
+
+        std::vector<std::shared_ptr<Parser::ParserStruct>> structs(found_count);
+        std::vector<CachedTag *> struct_cache(found_count);
+        std::vector<bool> same_as_first(found_count);
+
+        try {
+            // If the contents are the same as the first tag, they match no matter how we compare them
+            if(hash_cache != nullptr) {
+                auto hash_of = [&sources, &inputs, &input_file_info, &hash_cache, &source_data, &read_source, &struct_paths, &tag](std::size_t k) -> std::uint64_t {
+                    auto &source = sources[k];
+                    auto &input = inputs[source.input_index];
+                    std::string key;
+                    std::uint64_t size;
+                    std::int64_t modification_time;
+                    if(input.map.has_value()) {
+                        key = input.map->string() + ":" + struct_paths[k] + "." + HEK::tag_fourcc_to_extension(tag.fourcc);
+                        size = input_file_info[source.input_index].first;
+                        modification_time = input_file_info[source.input_index].second;
                     }
                     else {
-                        if(show & Show::SHOW_MISMATCHED) {
-                            log_mutex->lock();
-                            if(by_path == ByPath::BY_PATH_SAME) {
-                                oprintf_success_warn(MATCHED("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc));
-                            }
-                            else if(show_different_input) {
-                                oprintf_success_warn(MATCHED_TO_DIFFERENT_INPUT("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension, input_of_other);
-                            }
-                            else {
-                                oprintf_success_warn(MATCHED_TO("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension);
-                            }
-                            for(auto &i : other_messages) {
-                                oprintf_success_warn("%s", i.c_str());
-                            }
-                            log_mutex->unlock();
-                        }
-                        (*mismatched_count)++;
+                        auto &full_path = input.virtual_directory[source.index].full_path;
+                        std::error_code ec;
+                        key = full_path.string();
+                        size = std::filesystem::file_size(full_path, ec);
+                        modification_time = ec ? 0 : std::filesystem::last_write_time(full_path, ec).time_since_epoch().count();
                     }
-                };
 
-                if(functional) {
-                    try {
-                        auto meme_up_struct = [&tag](Parser::ParserStruct &struct_v) -> std::vector<std::uint8_t> {
-                            auto hdata = struct_v.generate_hek_tag_data(tag.fourcc);
-                            std::vector<std::uint8_t> meme_data;
-
-                            // Compile it
-                            auto compiled = BuildWorkload::compile_single_tag(hdata.data(), hdata.size());
-
-                            // Process each struct
-                            for(auto &s : compiled.structs) {
-                                // Process struct data
-                                meme_data.insert(meme_data.end(), reinterpret_cast<const std::uint8_t *>(s.data.data()), reinterpret_cast<const std::uint8_t *>(s.data.data() + s.data.size()));
-
-                                // Process each dependency
-                                for(auto &d : s.dependencies) {
-                                    char o[1024] = {};
-                                    auto len = std::snprintf(o, sizeof(o), "D:%08zX->%08zX!", d.offset, d.tag_index);
-                                    meme_data.insert(meme_data.end(), o, o + len);
-                                }
-
-                                // Process each pointer
-                                for(auto &p : s.pointers) {
-                                    char o[1024] = {};
-                                    auto len = std::snprintf(o, sizeof(o), "P:%08zX->%08zX!", p.offset, p.struct_index);
-                                    meme_data.insert(meme_data.end(), o, o + len);
-                                }
-                            }
+                    if(auto hash = hash_cache->find(key, size, modification_time); hash.has_value()) {
+                        return *hash;
+                    }
 
-                            // Process each tag
-                            for(auto &t : compiled.tags) {
-                                char o[1024] = {};
-                                auto len = std::snprintf(o, sizeof(o), "T:%s.%s!", t.path.c_str(), HEK::tag_fourcc_to_extension(t.tag_fourcc));
-                                meme_data.insert(meme_data.end(), o, o + len);
-
-                                // Raw data pointers
-                                for(auto &ad : t.asset_data) {
-                                    std::snprintf(o, sizeof(o), "AD:%zu!", ad);
-                                    meme_data.insert(meme_data.end(), o, o + len);
-                                }
-                            }
+                    auto data = read_source(k);
+                    auto hash = FNV1AHash::hash_bytes(data.data(), data.size());
+                    hash_cache->add(key, size, modification_time, hash);
+                    source_data[k] = std::move(data);
+                    return hash;
+                };
 
-                            // And of course we need the raw data and model data
-                            for(auto &rd : compiled.raw_data) {
-                                meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*rd.begin()), reinterpret_cast<std::uint8_t *>(&*rd.end()));
-                            }
+                auto first_hash = hash_of(0);
+                for(std::size_t k = 1; k < found_count; k++) {
+                    same_as_first[k] = hash_of(k) == first_hash;
+                }
+            }
 
-                            // Lastly, model data
-                            meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.uncompressed_model_vertices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.uncompressed_model_vertices.end()));
-                            meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.compressed_model_vertices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.compressed_model_vertices.end()));
-                            meme_data.insert(meme_data.end(), reinterpret_cast<std::uint8_t *>(&*compiled.model_indices.begin()), reinterpret_cast<std::uint8_t *>(&*compiled.model_indices.end()));
+            // Load everything that still needs to be compared
+            bool all_same = std::find(same_as_first.begin() + 1, same_as_first.end(), false) == same_as_first.end();
+            for(std::size_t k = all_same ? 1 : 0; k < found_count; k++) {
+                if(!same_as_first[k]) {
+                    std::tie(structs[k], struct_cache[k]) = load_source(k);
+                }
+            }
+        }
+        catch(std::exception &e) {
+            std::scoped_lock lock(log_mutex);
+            eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
+            return;
+        }
 
-                            return meme_data;
-                        };
+        #define MATCHED(type) "%s%s.%s", show_all ? type ": " : ""
+        #define MATCHED_TO(type) "%s%s.%s, %s.%s", show_all ? type ": " : ""
+        #define MATCHED_TO_DIFFERENT_INPUT(type) "%s%s.%s, %s.%s (%zu)", show_all ? type ": " : ""
+
+        auto &first_struct = structs[0];
+
+        // Just for setting counter/debugging
+        auto match_log = [&tag, &matched_count, &show, &show_all, &mismatched_count, &struct_paths, &by_path, &struct_inputs, &inputs, &log_mutex](bool did_match, std::size_t i, const std::list<std::string> &other_messages = {}) {
+            auto *extension = HEK::tag_fourcc_to_extension(tag.fourcc);
+            auto other_path = File::halo_path_to_preferred_path(struct_paths[i]);
+            bool show_different_input = inputs.size() > 2; // only need to show differing inputs if we have more than two inputs
+            std::size_t input_of_other = 1;
+
+            // If we're using multiple inputs, get the input of the other thing
+            if(show_different_input) {
+                auto *other_input = struct_inputs[i];
+                for(auto &i : inputs) {
+                    if(&i == other_input) {
+                        input_of_other = &i - inputs.data();
+                        break;
+                    }
+                }
+            }
 
-                        auto first_meme = meme_up_struct(*first_struct);
-                        for(std::size_t i = 1; i < found_count; i++) {
-                            auto mms = meme_up_struct(*structs[i]);
-                            match_log(first_meme == mms, i);
-                        }
+            if(did_match) {
+                if(show & Show::SHOW_MATCHED) {
+                    log_mutex.lock();
+                    if(by_path == ByPath::BY_PATH_SAME) {
+                        oprintf_success(MATCHED("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc));
                     }
-                    catch(std::exception &e) {
-                        log_mutex->lock();
-                        eprintf_error("Cannot functional compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
-                        log_mutex->unlock();
+                    else if(show_different_input) {
+                        oprintf_success(MATCHED_TO_DIFFERENT_INPUT("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension, input_of_other);
+                    }
+                    else {
+                        oprintf_success(MATCHED_TO("Matched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension);
                     }
+                    for(auto &i : other_messages) {
+                        oprintf_success("%s", i.c_str());
+                    }
+                    log_mutex.unlock();
                 }
-                else {
-                    for(std::size_t i = 1; i < found_count; i++) {
-                        std::list<std::string> differences;
-                        bool matched = false;
-                        bool match_successful;
-
-                        try {
-                            matched = first_struct->compare(structs[i].get(), precision, true, verbose ? &differences : nullptr);
-                            match_successful = true;
-                        }
-                        catch(std::exception &e) {
-                            log_mutex->lock();
-                            eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
-                            log_mutex->unlock();
-                            match_successful = false;
-                        }
-
-                        if(match_successful) {
-                            if(!show_all && verbose) {
-                                differences.emplace_back();
-                            }
-                            match_log(matched, i, differences);
-                        }
+                matched_count++;
+            }
+            else {
+                if(show & Show::SHOW_MISMATCHED) {
+                    log_mutex.lock();
+                    if(by_path == ByPath::BY_PATH_SAME) {
+                        oprintf_success_warn(MATCHED("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc));
+                    }
+                    else if(show_different_input) {
+                        oprintf_success_warn(MATCHED_TO_DIFFERENT_INPUT("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension, input_of_other);
+                    }
+                    else {
+                        oprintf_success_warn(MATCHED_TO("Mismatched"), File::halo_path_to_preferred_path(tag.path).c_str(), extension, other_path.c_str(), extension);
+                    }
+                    for(auto &i : other_messages) {
+                        oprintf_success_warn("%s", i.c_str());
                     }
+                    log_mutex.unlock();
                 }
+                mismatched_count++;
             }
         };
 
-        threads.emplace_back(perform_comparison_thread, &inputs, &tags, by_path, show_all, show, &matched_count, &mismatched_count, functional, precision, verbose, &tag_mutex, &tag_index, &log_mutex);
-    }
+        if(functional) {
+            try {
+                // Compile it (or get it from the cache if it was already compiled)
+                auto functional_data_of = [&structs, &struct_cache, &tag](std::size_t i) -> std::shared_ptr<const std::vector<std::uint8_t>> {
+                    auto *cached = struct_cache[i];
+                    if(cached == nullptr) {
+                        return std::make_shared<const std::vector<std::uint8_t>>(compile_for_functional_comparison(*structs[i], tag.fourcc));
+                    }
+                    std::call_once(cached->functional_flag, [cached, &structs, &tag, i]() {
+                        cached->functional_data = std::make_shared<const std::vector<std::uint8_t>>(compile_for_functional_comparison(*structs[i], tag.fourcc));
+                    });
+                    return cached->functional_data;
+                };
 
-    // Wait for threads to finish
-    for(auto &t : threads) {
-        t.join();
-    }
+                std::shared_ptr<const std::vector<std::uint8_t>> first_meme;
+                for(std::size_t i = 1; i < found_count; i++) {
+                    if(same_as_first[i]) {
+                        match_log(true, i);
+                        continue;
+                    }
+                    if(!first_meme) {
+                        first_meme = functional_data_of(0);
+                    }
+                    auto mms = functional_data_of(i);
+                    match_log(*first_meme == *mms, i);
+                }
+            }
+            catch(std::exception &e) {
+                std::scoped_lock lock(log_mutex);
+                eprintf_error("Cannot functional compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
+            }
+        }
+        else {
+            for(std::size_t i = 1; i < found_count; i++) {
+                std::list<std::string> differences;
+                bool matched = false;
+                bool match_successful;
+
+                try {
+                    matched = same_as_first[i] || first_struct->compare(structs[i].get(), precision, true, verbose ? &differences : nullptr);
+                    match_successful = true;
+                }
+                catch(std::exception &e) {
+                    std::scoped_lock lock(log_mutex);
+                    eprintf_error("Cannot compare %s.%s due to an error: %s", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.fourcc), e.what());
+                    match_successful = false;
+                }
+
+                if(match_successful) {
+                    if(!show_all && verbose) {
+                        differences.emplace_back();
+                    }
+                    match_log(matched, i, differences);
+                }
+            }
+        }
+    };
+
+    ThreadPool::shared().parallel_for(tags.size(), compare_tag, job_count);
 
     // Show the total matched if we are showing both
     if(show_all) {
-        auto total = matched_count + mismatched_count;
-        oprintf("Matched %zu / %zu tag%s\n", matched_count, total, total == 1 ? "" : "s");
+        std::size_t total = matched_count + mismatched_count;
+        oprintf("Matched %zu / %zu tag%s\n", matched_count.load(), total, total == 1 ? "" : "s");
     }
 }
@@ -3,10 +3,13 @@
 #include <invader/compress/compression.hpp>
 #include <invader/map/map.hpp>
 #include <invader/file/file.hpp>
+#include <invader/thread_pool.hpp>
 #include <cstdio>
+#include <cstring>
 #include <thread>
 #include <filesystem>
 #include <mutex>
+#include <algorithm>
 
 #ifndef DISABLE_ZLIB
 #include <zlib.h>
@@ -71,6 +74,223 @@ namespace Invader::Compression {
         }
     }
 
+    #ifndef DISABLE_ZLIB
+    // Size of each independently compressed chunk
+    static constexpr std::size_t COMPRESSION_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    // Each chunk is primed with the end of the previous chunk so it compresses just as well as one stream would
+    static constexpr std::size_t COMPRESSION_DICTIONARY_SIZE = 32 * 1024;
+
+    // Compress one chunk as raw DEFLATE. Every chunk but the last ends with a sync flush so the chunks can be concatenated.
+    static std::vector<std::byte> compress_map_chunk(const std::byte *data, std::size_t data_size, const std::byte *dictionary, std::size_t dictionary_size, bool last, int compression_level) {
+        z_stream deflate_stream = {};
+        deflate_stream.zalloc = Z_NULL;
+        deflate_stream.zfree = Z_NULL;
+        deflate_stream.opaque = Z_NULL;
+
+        if(deflateInit2(&deflate_stream, compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw CompressionFailureException();
+        }
+        if(dictionary_size > 0 && deflateSetDictionary(&deflate_stream, reinterpret_cast<const Bytef *>(dictionary), dictionary_size) != Z_OK) {
+            deflateEnd(&deflate_stream);
+            throw CompressionFailureException();
+        }
+
+        // The bound is for a finished stream; the sync flush needs a few more bytes
+        std::vector<std::byte> output(deflateBound(&deflate_stream, data_size) + 16);
+        deflate_stream.avail_in = data_size;
+        deflate_stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data));
+        deflate_stream.avail_out = output.size();
+        deflate_stream.next_out = reinterpret_cast<Bytef *>(output.data());
+
+        int result = deflate(&deflate_stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        std::size_t output_size = deflate_stream.total_out;
+        bool finished = last ? (result == Z_STREAM_END) : (result == Z_OK && deflate_stream.avail_in == 0 && deflate_stream.avail_out != 0);
+
+        // deflateEnd() reports Z_DATA_ERROR for a stream that was flushed but not finished, which is expected here
+        int end_result = deflateEnd(&deflate_stream);
+        if(!finished || (last && end_result != Z_OK)) {
+            throw CompressionFailureException();
+        }
+
+        output.resize(output_size);
+        return output;
+    }
+    #endif
+
+    // Native maps are compressed as independent raw DEFLATE frames so they can be decompressed in parallel. After the
+    // header (which is stored as-is) is an index of 64-bit little endian values: the magic, the version, the frame size,
+    // the decompressed size (including the header), and the frame count, followed by the offset and compressed size of
+    // each frame. Each frame holds NATIVE_FRAME_SIZE bytes of the data after the header, except the last one.
+    static constexpr char NATIVE_FRAMES_MAGIC[8] = { 'i', 'n', 'v', 'f', 'r', 'a', 'm', 'e' };
+    static constexpr std::uint64_t NATIVE_FRAMES_VERSION = 1;
+    static constexpr std::size_t NATIVE_FRAMES_INDEX_HEADER_SIZE = sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t) * 4;
+    static constexpr std::size_t NATIVE_FRAMES_INDEX_ENTRY_SIZE = sizeof(std::uint64_t) * 2;
+    static constexpr std::size_t NATIVE_FRAME_SIZE = 1024 * 1024;
+
+    // Below this many frames per thread, starting a thread costs more than it saves
+    static constexpr std::size_t MIN_NATIVE_FRAMES_PER_THREAD = 4;
+
+    static std::uint64_t read_native_frames_value(const std::byte *data) noexcept {
+        std::uint64_t value = 0;
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+        }
+        return value;
+    }
+
+    static void write_native_frames_value(std::byte *data, std::uint64_t value) noexcept {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data[i] = static_cast<std::byte>(value >> (i * 8));
+        }
+    }
+
+    bool is_framed_map_data(const std::byte *data, std::size_t data_size) noexcept {
+        const auto &header = *reinterpret_cast<const HEK::CacheFileHeader *>(data);
+        return data_size >= sizeof(header) + NATIVE_FRAMES_INDEX_HEADER_SIZE &&
+               header.valid() &&
+               header.engine == HEK::CacheFileEngine::CACHE_FILE_NATIVE &&
+               std::memcmp(data + sizeof(header), NATIVE_FRAMES_MAGIC, sizeof(NATIVE_FRAMES_MAGIC)) == 0;
+    }
+
+    // Run the function for each frame, spreading the frames across threads
+    template <typename F> static void for_each_native_frame(std::size_t frame_count, std::size_t thread_count, const F &function) {
+        ThreadPool::shared().parallel_for(frame_count, function, std::min(thread_count, frame_count / MIN_NATIVE_FRAMES_PER_THREAD));
+    }
+
+    #ifndef DISABLE_ZLIB
+    static std::vector<std::byte> compress_native_map_frames(const std::byte *data, std::size_t data_size, int compression_level, std::size_t thread_count) {
+        const auto &header = *reinterpret_cast<const HEK::CacheFileHeader *>(data);
+        if(!header.valid()) {
+            throw InvalidMapException();
+        }
+
+        // Clamp
+        if(compression_level > Z_BEST_COMPRESSION) {
+            compression_level = Z_BEST_COMPRESSION;
+        }
+        else if(compression_level < Z_NO_COMPRESSION) {
+            compression_level = Z_NO_COMPRESSION;
+        }
+
+        const auto *body = data + sizeof(header);
+        std::size_t body_size = data_size - sizeof(header);
+        std::size_t frame_count = (body_size + NATIVE_FRAME_SIZE - 1) / NATIVE_FRAME_SIZE;
+
+        std::vector<std::vector<std::byte>> frames(frame_count);
+        try {
+            for_each_native_frame(frame_count, thread_count, [&](std::size_t f) {
+                std::size_t offset = f * NATIVE_FRAME_SIZE;
+                frames[f] = compress_map_chunk(body + offset, std::min(NATIVE_FRAME_SIZE, body_size - offset), nullptr, 0, true, compression_level);
+            });
+        }
+        catch(std::exception &) {
+            throw CompressionFailureException();
+        }
+
+        // Put the header, index, and frames together
+        std::size_t index_size = NATIVE_FRAMES_INDEX_HEADER_SIZE + NATIVE_FRAMES_INDEX_ENTRY_SIZE * frame_count;
+        std::size_t compressed_size = sizeof(header) + index_size;
+        for(auto &frame : frames) {
+            compressed_size += frame.size();
+        }
+
+        std::vector<std::byte> new_data(sizeof(header) + index_size);
+        new_data.reserve(compressed_size);
+        std::memcpy(new_data.data(), data, sizeof(header));
+
+        auto *index = new_data.data() + sizeof(header);
+        std::memcpy(index, NATIVE_FRAMES_MAGIC, sizeof(NATIVE_FRAMES_MAGIC));
+        write_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC), NATIVE_FRAMES_VERSION);
+        write_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t), NATIVE_FRAME_SIZE);
+        write_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t) * 2, data_size);
+        write_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t) * 3, frame_count);
+
+        auto *entry = index + NATIVE_FRAMES_INDEX_HEADER_SIZE;
+        for(auto &frame : frames) {
+            write_native_frames_value(entry, new_data.size());
+            write_native_frames_value(entry + sizeof(std::uint64_t), frame.size());
+            entry += NATIVE_FRAMES_INDEX_ENTRY_SIZE;
+
+            // Write the entry before inserting the frame, since inserting can move the data
+            std::size_t entry_offset = entry - new_data.data();
+            new_data.insert(new_data.end(), frame.begin(), frame.end());
+            std::vector<std::byte>().swap(frame);
+            entry = new_data.data() + entry_offset;
+        }
+
+        return new_data;
+    }
+    #endif
+
+    static std::size_t native_frames_decompressed_size(const std::byte *data, std::size_t data_size) {
+        if(!is_framed_map_data(data, data_size)) {
+            throw InvalidMapException();
+        }
+        return read_native_frames_value(data + sizeof(HEK::CacheFileHeader) + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t) * 2);
+    }
+
+    static std::size_t decompress_native_map_frames(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size) {
+        #ifndef DISABLE_ZLIB
+        const auto *index = data + sizeof(HEK::CacheFileHeader);
+        std::uint64_t version = read_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC));
+        std::uint64_t frame_size = read_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t));
+        std::uint64_t decompressed_size = native_frames_decompressed_size(data, data_size);
+        std::uint64_t frame_count = read_native_frames_value(index + sizeof(NATIVE_FRAMES_MAGIC) + sizeof(std::uint64_t) * 3);
+
+        // Make sure the index makes sense before trusting any of it
+        std::size_t index_room = data_size - sizeof(HEK::CacheFileHeader) - NATIVE_FRAMES_INDEX_HEADER_SIZE;
+        if(version != NATIVE_FRAMES_VERSION ||
+           frame_size == 0 ||
+           decompressed_size < sizeof(HEK::CacheFileHeader) ||
+           decompressed_size > output_size ||
+           frame_count != (decompressed_size - sizeof(HEK::CacheFileHeader) + frame_size - 1) / frame_size ||
+           frame_count > index_room / NATIVE_FRAMES_INDEX_ENTRY_SIZE) {
+            throw InvalidMapException();
+        }
+
+        auto *body = output + sizeof(HEK::CacheFileHeader);
+        std::size_t body_size = decompressed_size - sizeof(HEK::CacheFileHeader);
+        try {
+            for_each_native_frame(frame_count, SIZE_MAX, [&](std::size_t f) {
+                const auto *entry = index + NATIVE_FRAMES_INDEX_HEADER_SIZE + f * NATIVE_FRAMES_INDEX_ENTRY_SIZE;
+                std::uint64_t frame_offset = read_native_frames_value(entry);
+                std::uint64_t frame_compressed_size = read_native_frames_value(entry + sizeof(std::uint64_t));
+                if(frame_offset > data_size || frame_compressed_size > data_size - frame_offset) {
+                    throw InvalidMapException();
+                }
+
+                std::size_t output_offset = f * frame_size;
+                std::size_t expected_size = std::min(static_cast<std::size_t>(frame_size), body_size - output_offset);
+
+                z_stream inflate_stream = {};
+                inflate_stream.zalloc = Z_NULL;
+                inflate_stream.zfree = Z_NULL;
+                inflate_stream.opaque = Z_NULL;
+                inflate_stream.avail_in = frame_compressed_size;
+                inflate_stream.next_in = reinterpret_cast<Bytef *>(const_cast<std::byte *>(data + frame_offset));
+                inflate_stream.avail_out = expected_size;
+                inflate_stream.next_out = reinterpret_cast<Bytef *>(body + output_offset);
+                if(inflateInit2(&inflate_stream, -15) != Z_OK) {
+                    throw DecompressionFailureException();
+                }
+                int result = inflate(&inflate_stream, Z_FINISH);
+                inflateEnd(&inflate_stream);
+                if(result != Z_STREAM_END || inflate_stream.total_out != expected_size) {
+                    throw DecompressionFailureException();
+                }
+            });
+        }
+        catch(std::exception &) {
+            throw DecompressionFailureException();
+        }
+
+        return decompressed_size;
+        #else
+        std::terminate();
+        #endif
+    }
+
     std::size_t decompress_map_data(const std::byte *data, std::size_t data_size, std::byte *output, std::size_t output_size) {
         // Check the header
         const auto &header = *reinterpret_cast<const HEK::CacheFileHeader *>(data);
@@ -97,30 +317,241 @@ namespace Invader::Compression {
             std::terminate();
             #endif
         }
+        else if(is_framed_map_data(data, data_size)) {
+            return decompress_native_map_frames(data, data_size, output, output_size);
+        }
         else {
             throw UnsupportedMapEngineException();
         }
     }
 
-    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level) {
-        // Allocate the data
+    std::vector<std::byte> compress_map_data(const std::byte *data, std::size_t data_size, int compression_level, std::size_t thread_count) {
         const auto &header = *reinterpret_cast<const HEK::CacheFileHeader *>(data);
-        std::vector<std::byte> new_data;
         if(data_size < sizeof(header)) {
             throw InvalidMapException();
         }
-        
-        // Allocate data
-        new_data.resize(data_size * 2);
 
-        // Compress
-        auto compressed_size = compress_map_data(data, data_size, new_data.data(), new_data.size(), compression_level);
+        #ifndef DISABLE_ZLIB
+        if(header.engine == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+            return compress_native_map_frames(data, data_size, compression_level, thread_count);
+        }
+        #endif
+
+        MapCompressor compressor(compression_level, thread_count);
+        compressor.write(data + sizeof(header), data_size - sizeof(header));
+        return compressor.finish(header);
+    }
+
+    #ifndef DISABLE_ZLIB
+    MapCompressor::MapCompressor(int compression_level, std::size_t thread_count) : size(sizeof(HEK::CacheFileHeader)) {
+        // Clamp
+        if(compression_level > Z_BEST_COMPRESSION) {
+            compression_level = Z_BEST_COMPRESSION;
+        }
+        else if(compression_level < Z_NO_COMPRESSION) {
+            compression_level = Z_NO_COMPRESSION;
+        }
+        this->compression_level = compression_level;
+
+        // Even with one thread, compress in the background so the map can be written at the same time
+        if(thread_count < 1) {
+            thread_count = 1;
+        }
+        this->max_waiting_chunks = thread_count * 2;
+        this->pending.reserve(COMPRESSION_DICTIONARY_SIZE + COMPRESSION_CHUNK_SIZE);
+
+        this->threads.reserve(thread_count);
+        for(std::size_t t = 0; t < thread_count; t++) {
+            this->threads.emplace_back(&MapCompressor::compress_chunks, this);
+        }
+    }
+
+    MapCompressor::~MapCompressor() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->chunk_condition.notify_all();
+        for(auto &t : this->threads) {
+            t.join();
+        }
+    }
+
+    void MapCompressor::write(const std::byte *data, std::size_t data_size) {
+        while(data_size > 0) {
+            // Only send a full chunk off once there's more to write, since the last chunk has to be compressed differently
+            std::size_t room = COMPRESSION_CHUNK_SIZE - (this->pending.size() - this->pending_dictionary_size);
+            if(room == 0) {
+                this->submit_chunk(false);
+                continue;
+            }
+
+            std::size_t amount = std::min(room, data_size);
+            this->pending.insert(this->pending.end(), data, data + amount);
+            this->size += amount;
+            data += amount;
+            data_size -= amount;
+        }
+    }
+
+    void MapCompressor::write_zeroes(std::size_t size) {
+        static constexpr std::byte ZEROES[4096] = {};
+        while(size > 0) {
+            std::size_t amount = std::min(size, sizeof(ZEROES));
+            this->write(ZEROES, amount);
+            size -= amount;
+        }
+    }
+
+    void MapCompressor::submit_chunk(bool last) {
+        std::unique_lock<std::mutex> lock(this->mutex);
 
-        // Resize and return it
-        new_data.resize(compressed_size);
+        // Don't get too far ahead of the compression threads
+        this->done_condition.wait(lock, [this]() { return this->failed || this->chunks.size() - this->done_chunks < this->max_waiting_chunks; });
+        if(this->failed) {
+            throw CompressionFailureException();
+        }
+
+        // The next chunk's dictionary is the end of this one
+        std::size_t chunk_size = this->pending.size() - this->pending_dictionary_size;
+        std::size_t next_dictionary_size = std::min(COMPRESSION_DICTIONARY_SIZE, chunk_size);
+        std::vector<std::byte> next_pending;
+        if(!last) {
+            next_pending.reserve(COMPRESSION_DICTIONARY_SIZE + COMPRESSION_CHUNK_SIZE);
+            next_pending.insert(next_pending.end(), this->pending.end() - next_dictionary_size, this->pending.end());
+        }
+
+        auto &chunk = this->chunks.emplace_back();
+        chunk.input = std::move(this->pending);
+        chunk.dictionary_size = this->pending_dictionary_size;
+        chunk.size = chunk_size;
+        chunk.last = last;
+
+        this->pending = std::move(next_pending);
+        this->pending_dictionary_size = last ? 0 : next_dictionary_size;
+
+        lock.unlock();
+        this->chunk_condition.notify_one();
+    }
+
+    void MapCompressor::compress_chunks() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true) {
+            this->chunk_condition.wait(lock, [this]() { return this->stopping || this->next_chunk < this->chunks.size(); });
+            if(this->stopping) {
+                return;
+            }
+
+            // Elements of a deque don't move when more are added, so this can be used without the lock
+            auto &chunk = this->chunks[this->next_chunk++];
+            lock.unlock();
+
+            const auto *chunk_data = chunk.input.data() + chunk.dictionary_size;
+            bool chunk_failed = false;
+            try {
+                chunk.output = compress_map_chunk(chunk_data, chunk.size, chunk.input.data(), chunk.dictionary_size, chunk.last, this->compression_level);
+                chunk.checksum = adler32(1, reinterpret_cast<const Bytef *>(chunk_data), chunk.size);
+            }
+            catch(std::exception &) {
+                chunk_failed = true;
+            }
+            std::vector<std::byte>().swap(chunk.input);
+
+            lock.lock();
+            chunk.done = true;
+            this->failed = this->failed || chunk_failed;
+            this->done_chunks++;
+            this->done_condition.notify_all();
+        }
+    }
+
+    std::vector<std::byte> MapCompressor::finish(const HEK::CacheFileHeader &header) {
+        if(!header.valid()) {
+            throw InvalidMapException();
+        }
+        if(header.engine != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            throw UnsupportedMapEngineException();
+        }
+
+        auto input_padding_required = REQUIRED_PADDING_N_BYTES(this->size, HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE);
+        if(input_padding_required) {
+            eprintf_error("map size is not divisible by sector size (%zu)", static_cast<std::size_t>(HEK::CacheFileXboxConstants::CACHE_FILE_XBOX_SECTOR_SIZE));
+            throw CompressionFailureException();
+        }
+
+        this->submit_chunk(true);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->done_condition.wait(lock, [this]() { return this->done_chunks == this->chunks.size(); });
+        if(this->failed) {
+            throw CompressionFailureException();
+        }
+
+        // Wrap the chunks in a zlib stream
+        std::size_t compressed_size = 2 + sizeof(std::uint32_t);
+        for(auto &chunk : this->chunks) {
+            compressed_size += chunk.output.size();
+        }
+
+        std::vector<std::byte> new_data;
+        new_data.reserve(sizeof(header) + compressed_size + 4096);
+        new_data.resize(sizeof(header));
+
+        // zlib header (same as what deflateInit would write)
+        unsigned int level_flags;
+        if(this->compression_level < 2) {
+            level_flags = 0;
+        }
+        else if(this->compression_level < 6) {
+            level_flags = 1;
+        }
+        else if(this->compression_level == 6) {
+            level_flags = 2;
+        }
+        else {
+            level_flags = 3;
+        }
+        unsigned int zlib_header = (Z_DEFLATED + ((15 - 8) << 4)) << 8 | level_flags << 6;
+        zlib_header += 31 - (zlib_header % 31);
+        new_data.emplace_back(static_cast<std::byte>(zlib_header >> 8));
+        new_data.emplace_back(static_cast<std::byte>(zlib_header & 0xFF));
+
+        uLong checksum = adler32(0, Z_NULL, 0);
+        for(auto &chunk : this->chunks) {
+            new_data.insert(new_data.end(), chunk.output.begin(), chunk.output.end());
+            std::vector<std::byte>().swap(chunk.output);
+            checksum = adler32_combine(checksum, chunk.checksum, static_cast<z_off_t>(chunk.size));
+        }
+
+        // Big endian Adler-32 of the uncompressed data
+        for(int shift = 24; shift >= 0; shift -= 8) {
+            new_data.emplace_back(static_cast<std::byte>((checksum >> shift) & 0xFF));
+        }
+
+        // Align to 4096 bytes
+        auto &header_output = *reinterpret_cast<HEK::CacheFileHeader *>(new_data.data());
+        header_output = header;
+        std::size_t padding_required = REQUIRED_PADDING_N_BYTES(new_data.size(), 4096);
+        header_output.compressed_padding = static_cast<std::uint32_t>(padding_required);
+        new_data.resize(new_data.size() + padding_required);
 
         return new_data;
     }
+    #else
+    MapCompressor::MapCompressor(int, std::size_t) : size(0) {
+        std::terminate();
+    }
+    MapCompressor::~MapCompressor() {}
+    void MapCompressor::write(const std::byte *, std::size_t) {
+        std::terminate();
+    }
+    void MapCompressor::write_zeroes(std::size_t) {
+        std::terminate();
+    }
+    std::vector<std::byte> MapCompressor::finish(const HEK::CacheFileHeader &) {
+        std::terminate();
+    }
+    #endif
 
     std::vector<std::byte> decompress_map_data(const std::byte *data, std::size_t data_size) {
         // Allocate and decompress using data from the header
@@ -131,7 +562,8 @@ namespace Invader::Compression {
         
         std::vector<std::byte> new_data;
 
-        new_data.resize(header.decompressed_file_size);
+        // Framed native maps store the decompressed size in their index since it may not fit in the header
+        new_data.resize(is_framed_map_data(data, data_size) ? native_frames_decompressed_size(data, data_size) : static_cast<std::size_t>(header.decompressed_file_size));
         if(new_data.size() < sizeof(header)) {
             throw InvalidMapException();
         }
@@ -145,4 +577,163 @@ namespace Invader::Compression {
 
         return new_data;
     }
+
+    // Size of the input and output buffers used when streaming
+    static constexpr std::size_t STREAM_BUFFER_SIZE = 256 * 1024;
+
+    std::size_t decompress_map_stream(const StreamReadFunction &read, const StreamWriteFunction &write) {
+        // Read the header first
+        HEK::CacheFileHeader header;
+        auto *header_bytes = reinterpret_cast<std::byte *>(&header);
+        std::size_t header_read = 0;
+        while(header_read < sizeof(header)) {
+            auto amount_read = read(header_bytes + header_read, sizeof(header) - header_read);
+            if(amount_read == 0) {
+                throw InvalidMapException();
+            }
+            header_read += amount_read;
+        }
+
+        if(!header.valid()) {
+            throw InvalidMapException();
+        }
+        if(header.engine != HEK::CacheFileEngine::CACHE_FILE_XBOX) {
+            throw UnsupportedMapEngineException();
+        }
+
+        #ifndef DISABLE_ZLIB
+        write(header_bytes, sizeof(header));
+
+        z_stream inflate_stream = {};
+        inflate_stream.zalloc = Z_NULL;
+        inflate_stream.zfree = Z_NULL;
+        inflate_stream.opaque = Z_NULL;
+        if(inflateInit(&inflate_stream) != Z_OK) {
+            throw DecompressionFailureException();
+        }
+
+        std::vector<std::byte> input(STREAM_BUFFER_SIZE);
+        std::vector<std::byte> output(STREAM_BUFFER_SIZE);
+        int result = Z_OK;
+
+        try {
+            while(result != Z_STREAM_END) {
+                // Refill the input if we've used it all up
+                if(inflate_stream.avail_in == 0) {
+                    auto amount_read = read(input.data(), input.size());
+                    if(amount_read == 0) {
+                        throw DecompressionFailureException();
+                    }
+                    inflate_stream.avail_in = amount_read;
+                    inflate_stream.next_in = reinterpret_cast<Bytef *>(input.data());
+                }
+
+                inflate_stream.avail_out = output.size();
+                inflate_stream.next_out = reinterpret_cast<Bytef *>(output.data());
+                result = inflate(&inflate_stream, Z_NO_FLUSH);
+                if(result != Z_OK && result != Z_STREAM_END) {
+                    throw DecompressionFailureException();
+                }
+
+                auto amount_decompressed = output.size() - inflate_stream.avail_out;
+                if(amount_decompressed > 0) {
+                    write(output.data(), amount_decompressed);
+                }
+            }
+        }
+        catch(std::exception &) {
+            inflateEnd(&inflate_stream);
+            throw;
+        }
+
+        std::size_t decompressed_size = inflate_stream.total_out + sizeof(header);
+        if(inflateEnd(&inflate_stream) != Z_OK) {
+            throw DecompressionFailureException();
+        }
+
+        return decompressed_size;
+        #else
+        std::terminate();
+        #endif
+    }
+
+    std::size_t decompress_map_file(const char *input, const char *output) {
+        std::FILE *input_file = std::fopen(input, "rb");
+        if(!input_file) {
+            eprintf_error("Failed to open %s for reading", input);
+            throw FailedToOpenFileException();
+        }
+
+        std::FILE *output_file = std::fopen(output, "wb");
+        if(!output_file) {
+            std::fclose(input_file);
+            eprintf_error("Failed to open %s for writing", output);
+            throw FailedToOpenFileException();
+        }
+
+        try {
+            auto decompressed_size = decompress_map_stream(
+                [&input_file](std::byte *buffer, std::size_t buffer_size) {
+                    return std::fread(buffer, 1, buffer_size, input_file);
+                },
+                [&output_file, &output](const std::byte *data, std::size_t data_size) {
+                    if(std::fwrite(data, data_size, 1, output_file) != 1) {
+                        eprintf_error("Failed to write to %s", output);
+                        throw DecompressionFailureException();
+                    }
+                }
+            );
+            std::fclose(input_file);
+            input_file = nullptr;
+
+            // Once fclose() is called, the file is closed even if it fails, so don't close it again below
+            int output_closed = std::fclose(output_file);
+            output_file = nullptr;
+            if(output_closed != 0) {
+                eprintf_error("Failed to write to %s", output);
+                throw DecompressionFailureException();
+            }
+            return decompressed_size;
+        }
+        catch(std::exception &) {
+            if(input_file) {
+                std::fclose(input_file);
+            }
+            if(output_file) {
+                std::fclose(output_file);
+            }
+            throw;
+        }
+    }
+
+    std::size_t decompress_map_file(const char *input, std::byte *output, std::size_t output_size) {
+        std::FILE *input_file = std::fopen(input, "rb");
+        if(!input_file) {
+            eprintf_error("Failed to open %s for reading", input);
+            throw FailedToOpenFileException();
+        }
+
+        try {
+            std::size_t offset = 0;
+            auto decompressed_size = decompress_map_stream(
+                [&input_file](std::byte *buffer, std::size_t buffer_size) {
+                    return std::fread(buffer, 1, buffer_size, input_file);
+                },
+                [&output, &output_size, &offset](const std::byte *data, std::size_t data_size) {
+                    if(data_size > output_size - offset) {
+                        eprintf_error("Decompressed map is larger than the buffer (%zu bytes)", output_size);
+                        throw DecompressionFailureException();
+                    }
+                    std::memcpy(output + offset, data, data_size);
+                    offset += data_size;
+                }
+            );
+            std::fclose(input_file);
+            return decompressed_size;
+        }
+        catch(std::exception &) {
+            std::fclose(input_file);
+            throw;
+        }
+    }
 }
@@ -3,13 +3,18 @@
 #include <filesystem>
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/tag/parser/parser_struct.hpp>
 #include <invader/tag/parser/compile/model.hpp>
 #include <invader/tag/parser/compile/shader.hpp>
 #include <invader/tag/parser/compile/object.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 using namespace Invader;
 
@@ -86,7 +91,7 @@ int main(int argc, const char **argv) {
         
         std::vector<std::string> batch, batch_exclude;
         
-        
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } convert_options;
 
     const CommandLineOption options[] = {
@@ -97,6 +102,7 @@ int main(int argc, const char **argv) {
         CommandLineOption("overwrite", 'O', 0, "Overwrite any output tags if they exist."),
         CommandLineOption("output-tags", 'o', 1, "Set the output tags directory.", "<dir>"),
         CommandLineOption("groups", 'g', 2, "Set the conversion method.", "<from> <to>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
     };
 
     static constexpr char DESCRIPTION[] = "Convert from one tag type to another.\n"
@@ -135,6 +141,10 @@ int main(int argc, const char **argv) {
                 compare_options.tags = args[0];
                 break;
                 
+            case 'j':
+                compare_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
+                
             case 'g':
                 compare_options.conversion = { HEK::tag_extension_to_fourcc(args[0]), HEK::tag_extension_to_fourcc(args[1]) };
                 
@@ -146,6 +156,9 @@ int main(int argc, const char **argv) {
         }
     });
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(convert_options.thread_count);
+    
     // Make sure we have a conversion method specified
     if(!convert_options.conversion.has_value()) {
         eprintf_error("No conversion method specified. Use -h for more information.");
@@ -185,8 +198,9 @@ int main(int argc, const char **argv) {
     tags_vector.emplace_back(convert_options.tags);
     std::vector<File::TagFilePath> paths;
     if(batching) {
+        File::PathMatcher batch_matcher(convert_options.batch, convert_options.batch_exclude);
         for(auto &i : File::load_virtual_tag_folder(tags_vector)) {
-            if(i.tag_fourcc == convert_options.conversion->first && File::path_matches((i.tag_path + "." + HEK::tag_fourcc_to_extension(convert_options.conversion->first)).c_str(), convert_options.batch, convert_options.batch_exclude)) {
+            if(i.tag_fourcc == convert_options.conversion->first && batch_matcher.matches((i.tag_path + "." + HEK::tag_fourcc_to_extension(convert_options.conversion->first)).c_str())) {
                 paths.emplace_back(File::split_tag_class_extension(File::halo_path_to_preferred_path(i.tag_path)).value());
             }
         }
@@ -205,45 +219,68 @@ int main(int argc, const char **argv) {
     }
     
     // Let's begin
-    std::size_t success = 0;
     std::size_t total = paths.size();
-    for(auto &i : paths) {
+    std::atomic<std::size_t> converted = 0;
+    std::mutex print_mutex;
+    
+    ThreadPool::shared().parallel_for(total, [&paths, &converted, &print_mutex, &convert_options, &conversion_fn](std::size_t index) {
+        auto &i = paths[index];
         auto path_from = convert_options.tags / i.join();
         auto path_to = *convert_options.output_tags / File::TagFilePath(i.path, convert_options.conversion->second).join();
         
         try {
-            auto tag_file = File::open_file(path_from);
+            auto tag_file = File::MemoryMappedFile::map_file(path_from);
             if(!tag_file.has_value()) {
+                std::scoped_lock lock(print_mutex);
                 eprintf_error("Failed to read %s", path_from.string().c_str());
+                return;
             }
             
             auto input_struct = Parser::ParserStruct::parse_hek_tag_file(tag_file->data(), tag_file->size());
             
-            if(!convert_options.overwrite && std::filesystem::exists(path_to)) {
+            bool output_exists = std::filesystem::exists(path_to);
+            if(!convert_options.overwrite && output_exists) {
+                std::scoped_lock lock(print_mutex);
                 eprintf_warn("Skipping %s...", i.join().c_str());
-                continue;
+                return;
             }
             
             // Convert it
             auto final_data = (*conversion_fn)(*input_struct)->generate_hek_tag_data(convert_options.conversion->second);
             
+            // Don't write if it matches what's already there
+            if(output_exists) {
+                auto existing_data = File::open_file(path_to);
+                if(existing_data.has_value() && *existing_data == final_data) {
+                    std::scoped_lock lock(print_mutex);
+                    oprintf("Unchanged %s\n", path_to.string().c_str());
+                    converted++;
+                    return;
+                }
+            }
+            
             // Make directories
             std::error_code ec;
             std::filesystem::create_directories(path_to.parent_path(), ec);
 
             // Save
-            if(File::save_file(path_to, final_data)) {
+            bool saved = File::save_file(path_to, final_data);
+            std::scoped_lock lock(print_mutex);
+            if(saved) {
                 oprintf_success("Saved %s", path_to.string().c_str());
-                success++;
+                converted++;
             }
             else {
                 eprintf_error("Failed to write to %s", path_to.string().c_str());
             }
         }
         catch(std::exception &e) {
+            std::scoped_lock lock(print_mutex);
             eprintf_error("Failed to convert %s: %s", i.join().c_str(), e.what());
         }
-    }
+    });
+    
+    std::size_t success = converted;
     
     // Report results
     if(success) {
@@ -11,6 +11,15 @@ extern "C" {
 #include <stdlib.h>
 uint32_t crc32(uint32_t crc, const void *buf, size_t size);
 
+/**
+ * Get the CRC32 of two buffers back to back from the CRC32 of each
+ * @param crc1  CRC32 of the first buffer
+ * @param crc2  CRC32 of the second buffer (starting from 0)
+ * @param size2 size of the second buffer in bytes
+ * @return      CRC32 of both buffers
+ */
+uint32_t invader_crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,8 @@
 // - added GPL version 3 only identifier (the original code to this uses the below license, but my modifications are GPL version 3 only, as is Invader itself)
 // - commented out main function
 // - added a fake file handle data type and functions so this can be done with data in memory
+// - get_crc32_and_length uses crc32() from crc32.c rather than computing the CRC one bit at a time
+// - split computing the patch into crc_spoof_compute_patch so the CRC can be computed elsewhere
 
 /*
  * CRC-32 forcer (C)
@@ -35,11 +37,13 @@
 #include <string.h>
 
 #include "crc_spoof.h"
+#include "crc32.h"
 
 
 /* Forward declarations */
 
 const char *crc_spoof_modify_file_crc32(FakeFileHandle *f, uint64_t offset, uint32_t newcrc, bool printstatus);
+uint32_t crc_spoof_compute_patch(uint32_t crc, uint64_t length, uint64_t offset, uint32_t newcrc);
 
 uint32_t get_crc32_and_length(FakeFileHandle *f, uint64_t *length);
 static void fseek64(FakeFileHandle *f, uint64_t offset);
@@ -112,8 +116,7 @@ const char *crc_spoof_modify_file_crc32(FakeFileHandle *f, uint64_t offset, uint
         fprintf(stdout, "Original CRC-32: %08" PRIX32 "\n", crc_spoof_reverse_bits(crc));
 
     // Compute the change to make
-    uint32_t delta = crc ^ newcrc;
-    delta = (uint32_t)multiply_mod(reciprocal_mod(pow_mod(2, (length - offset) * 8)), delta);
+    uint32_t patch = crc_spoof_compute_patch(crc, length, offset, newcrc);
 
     // Patch 4 bytes in the file
     fseek64(f, offset);
@@ -123,7 +126,7 @@ const char *crc_spoof_modify_file_crc32(FakeFileHandle *f, uint64_t offset, uint
             crc_spoof_fake_fclose(f);
             return "I/O error: fgetc";
         }
-        b ^= (int)((crc_spoof_reverse_bits(delta) >> (i * 8)) & 0xFF);
+        b ^= (int)((patch >> (i * 8)) & 0xFF);
         if (crc_spoof_fake_fseek(f, -1, SEEK_CUR) != 0) {
             crc_spoof_fake_fclose(f);
             return "I/O error: crc_spoof_fake_fseek";
@@ -152,6 +155,15 @@ const char *crc_spoof_modify_file_crc32(FakeFileHandle *f, uint64_t offset, uint
 }
 
 
+// Returns the value to XOR with the 4 bytes (little endian) at the offset to change the CRC from crc to newcrc.
+// Both CRCs are bit-reversed, as returned by get_crc32_and_length.
+uint32_t crc_spoof_compute_patch(uint32_t crc, uint64_t length, uint64_t offset, uint32_t newcrc) {
+    uint32_t delta = crc ^ newcrc;
+    delta = (uint32_t)multiply_mod(reciprocal_mod(pow_mod(2, (length - offset) * 8)), delta);
+    return crc_spoof_reverse_bits(delta);
+}
+
+
 /*---- Utilities ----*/
 
 // Generator polynomial. Do not modify, because there are many dependencies
@@ -160,24 +172,16 @@ static const uint64_t POLYNOMIAL = UINT64_C(0x104C11DB7);
 
 uint32_t get_crc32_and_length(FakeFileHandle *f, uint64_t *length) {
     crc_spoof_fake_rewind(f);
-    uint32_t crc = UINT32_C(0xFFFFFFFF);
+    uint32_t crc = 0;
     *length = 0;
     while (true) {
         char buffer[32 * 1024];
         size_t n = crc_spoof_fake_fread(buffer, sizeof(buffer[0]), sizeof(buffer) / sizeof(buffer[0]), f);
-        for (size_t i = 0; i < n; i++) {
-            for (int j = 0; j < 8; j++) {
-                uint32_t bit = ((uint8_t)buffer[i] >> j) & 1;
-                crc ^= bit << 31;
-                bool xor = (crc >> 31) != 0;
-                crc = (crc & UINT32_C(0x7FFFFFFF)) << 1;
-                if (xor)
-                    crc ^= (uint32_t)POLYNOMIAL;
-            }
-        }
+        crc = crc32(crc, buffer, n);
         *length += n;
+        // This works with the bit-reversed CRC
         if (crc_spoof_fake_feof(f) != 0)
-            return ~crc;
+            return crc_spoof_reverse_bits(crc);
     }
 }
 
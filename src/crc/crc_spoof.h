@@ -27,6 +27,7 @@ int    crc_spoof_fake_feof(FakeFileHandle *f);
 size_t crc_spoof_fake_fread(void *ptr, size_t size, size_t count, FakeFileHandle *f);
 
 const char *crc_spoof_modify_file_crc32(FakeFileHandle *f, uint64_t offset, uint32_t newcrc, bool printstatus);
+uint32_t crc_spoof_compute_patch(uint32_t crc, uint64_t length, uint64_t offset, uint32_t newcrc);
 uint32_t crc_spoof_reverse_bits(uint32_t x);
 
 #ifdef __cplusplus
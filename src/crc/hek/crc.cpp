@@ -1,41 +1,96 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include "../crc32.h"
 #include "../crc_spoof.h"
 #include <invader/tag/hek/definition.hpp>
 #include <invader/crc/hek/crc.hpp>
 #include <invader/map/map.hpp>
+#include <invader/thread_pool.hpp>
 
 namespace Invader {
+    // Below this, splitting the CRC32 across threads costs more than it saves
+    static constexpr std::size_t MIN_CRC_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    struct CRCRegion {
+        const std::byte *data;
+        std::size_t size;
+    };
+
+    // CRC32 the regions back to back, splitting them into chunks that are hashed in parallel and then combined
+    static std::uint32_t crc32_regions(const std::vector<CRCRegion> &regions, std::size_t total_size) {
+        std::size_t thread_count = std::min<std::size_t>(ThreadPool::shared().get_thread_count(), total_size / MIN_CRC_CHUNK_SIZE);
+        if(thread_count <= 1) {
+            std::uint32_t crc = 0;
+            for(auto &r : regions) {
+                crc = crc32(crc, r.data, r.size);
+            }
+            return crc;
+        }
+
+        // Cut the regions into chunks of about the same size
+        std::size_t chunk_size = (total_size + thread_count - 1) / thread_count;
+        std::vector<std::vector<CRCRegion>> chunks(thread_count);
+        std::size_t chunk = 0;
+        std::size_t chunk_remaining = chunk_size;
+        for(auto &r : regions) {
+            std::size_t offset = 0;
+            while(offset < r.size) {
+                std::size_t size = std::min(r.size - offset, chunk_remaining);
+                chunks[chunk].emplace_back(CRCRegion { r.data + offset, size });
+                offset += size;
+                chunk_remaining -= size;
+                if(chunk_remaining == 0 && chunk + 1 < thread_count) {
+                    chunk++;
+                    chunk_remaining = chunk_size;
+                }
+            }
+        }
+
+        std::vector<std::uint32_t> chunk_crcs(thread_count);
+        auto hash_chunk = [&chunks, &chunk_crcs](std::size_t c) {
+            std::uint32_t crc = 0;
+            for(auto &r : chunks[c]) {
+                crc = crc32(crc, r.data, r.size);
+            }
+            chunk_crcs[c] = crc;
+        };
+
+        ThreadPool::shared().parallel_for(thread_count, hash_chunk);
+
+        std::uint32_t crc = chunk_crcs[0];
+        for(std::size_t c = 1; c < thread_count; c++) {
+            std::size_t size = 0;
+            for(auto &r : chunks[c]) {
+                size += r.size;
+            }
+            crc = invader_crc32_combine(crc, chunk_crcs[c], size);
+        }
+        return crc;
+    }
+
     std::uint32_t calculate_map_crc(const Invader::Map &map, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty) {
         // Reassign variables if needed
         auto *data = map.get_data();
         auto size = map.get_data_length();
-        
-        std::vector<std::byte> data_crc;
-        std::uint32_t crc = 0;
+
+        std::vector<CRCRegion> regions;
+        std::size_t crc_size = 0;
 
         if(new_crc && !new_random) {
             std::terminate();
         }
 
-        if(new_crc) {
-            data_crc.reserve(size);
-        }
-        
         auto engine = map.get_cache_version();
         if(engine == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
             return 0;
         }
 
         #define CRC_DATA(data_start, data_end) \
-            if(new_crc) { \
-                data_crc.insert(data_crc.end(), data + data_start, data + data_end); \
-            } \
-            else { \
-                crc = crc32(crc, data + data_start, data_end - data_start); \
-            }
+            regions.emplace_back(CRCRegion { data + data_start, static_cast<std::size_t>(data_end - data_start) }); \
+            crc_size += data_end - data_start;
 
         auto &scenario_tag = map.get_tag(map.get_scenario_tag_id());
         auto &scenario = scenario_tag.get_base_struct<HEK::Scenario>();
@@ -89,22 +144,35 @@ namespace Invader {
         // Find out where we're going to be doing CRC32 stuff
         auto *tag_file_checksums = &reinterpret_cast<const HEK::CacheFileTagDataHeader *>(map.get_tag_data_at_offset(0, sizeof(HEK::CacheFileTagDataHeader)))->tag_file_checksums;
         const std::byte *tag_file_checksums_ptr = reinterpret_cast<const std::byte *>(tag_file_checksums);
-        std::size_t tag_file_checksums_offset_in_memory = tag_file_checksums_ptr - tag_data + data_crc.size();
+        std::size_t tag_file_checksums_offset_in_memory = tag_file_checksums_ptr - tag_data + crc_size;
         CRC_DATA(tag_data_start, tag_data_end);
 
+        std::uint32_t crc = crc32_regions(regions, crc_size);
+
         // Overwrite with new CRC32
         if(new_crc) {
-            FakeFileHandle handle = { reinterpret_cast<std::uint8_t *>(data_crc.data()), data_crc.size(), 0 };
+            // Work out what the checksums field has to be changed to without copying the map to patch it
             std::uint32_t newcrc = ~crc_spoof_reverse_bits(*new_crc);
-            crc_spoof_modify_file_crc32(&handle, tag_file_checksums_offset_in_memory, newcrc, false);
-            *new_random = *reinterpret_cast<std::uint32_t *>(data_crc.data() + tag_file_checksums_offset_in_memory);
+            std::uint32_t patch = crc_spoof_compute_patch(crc_spoof_reverse_bits(crc), crc_size, tag_file_checksums_offset_in_memory, newcrc);
+            std::uint8_t patch_bytes[sizeof(patch)] = {};
+            std::uint8_t patched_random[sizeof(patch)];
+            for(std::size_t i = 0; i < sizeof(patch); i++) {
+                patch_bytes[i] = static_cast<std::uint8_t>(patch >> (i * 8));
+                patched_random[i] = static_cast<std::uint8_t>(tag_file_checksums_ptr[i]) ^ patch_bytes[i];
+            }
+            std::memcpy(new_random, patched_random, sizeof(patched_random));
+
+            // CRC32 is linear, so the patched CRC32 is the old one XOR'd with the CRC32 of only the change
+            static constexpr std::uint8_t ZERO[sizeof(patch)] = {};
+            std::uint32_t patch_crc = crc32(0, patch_bytes, sizeof(patch_bytes)) ^ crc32(0, ZERO, sizeof(ZERO));
+            crc ^= invader_crc32_combine(patch_crc, 0, crc_size - tag_file_checksums_offset_in_memory - sizeof(patch));
 
             // We have no way of knowing if the map was dirty or not because we just forged the CRC
             if(check_dirty) {
                 *check_dirty = false;
             }
 
-            return ~crc32(0, data_crc.data(), data_crc.size());
+            return ~crc;
         }
         else {
             std::uint32_t crc_value = ~crc;
@@ -114,7 +182,7 @@ namespace Invader {
             return crc_value;
         }
     }
-    
+
     std::uint32_t calculate_map_crc(const std::byte *data, std::size_t size, const std::uint32_t *new_crc, std::uint32_t *new_random, bool *check_dirty) {
         return calculate_map_crc(Map::map_with_copy(data, size), new_crc, new_random, check_dirty);
     }
@@ -6,6 +6,7 @@
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/dependency_index.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/map/map.hpp>
 #include "../command_line_option.hpp"
@@ -24,6 +25,7 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
         CommandLineOption("reverse", 'R', 0, "Find all tags that depend on the tag, instead. The tag does not have to exist if not using --fs-path."),
         CommandLineOption("recursive", 'r', 0, "Recursively get all depended tags."),
+        CommandLineOption("index", 'I', 1, "Keep an index of every tag's references in the given file. Only tags that changed since the last run are read, which makes --reverse much faster on large tags directories. The index is created if it doesn't exist.", "<file>"),
     };
 
     static constexpr char DESCRIPTION[] = "Check dependencies for a tag.";
@@ -34,6 +36,7 @@ int main(int argc, char * const *argv) {
         bool recursive = false;
         std::vector<std::filesystem::path> tags;
         bool use_filesystem_path = false;
+        std::optional<std::filesystem::path> index;
     } dependency_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<DependencyOption &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, dependency_options, [](char opt, const auto &arguments, auto &dependency_options) {
@@ -53,6 +56,9 @@ int main(int argc, char * const *argv) {
             case 'P':
                 dependency_options.use_filesystem_path = true;
                 break;
+            case 'I':
+                dependency_options.index = arguments[0];
+                break;
         }
     });
 
@@ -83,11 +89,21 @@ int main(int argc, char * const *argv) {
         return EXIT_FAILURE;
     }
 
+    // Bring the index up to date if we're using one
+    std::optional<DependencyIndex> index;
+    if(dependency_options.index.has_value()) {
+        index = DependencyIndex::load(*dependency_options.index);
+        index->update(dependency_options.tags);
+        if(!index->save(*dependency_options.index)) {
+            eprintf_warn("Warning: Failed to save the index to %s", dependency_options.index->string().c_str());
+        }
+    }
+
     // Here's an array we can use to hold what we got
     std::vector<FoundTagDependency> found_tags;
     try {
         bool success;
-        found_tags = FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success);
+        found_tags = FoundTagDependency::find_dependencies(tag_path_split->path.c_str(), tag_path_split->fourcc, dependency_options.tags, dependency_options.reverse, dependency_options.recursive, success, index.has_value() ? &*index : nullptr);
         if(!success) {
             return EXIT_FAILURE;
         }
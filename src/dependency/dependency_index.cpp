@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+
+#include <invader/dependency/dependency_index.hpp>
+#include <invader/tag/parser/parser_struct.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/printf.hpp>
+
+namespace Invader {
+    // Increment this if the format of the index changes
+    static constexpr std::uint64_t DEPENDENCY_INDEX_VERSION = 1;
+    static constexpr char DEPENDENCY_INDEX_MAGIC[8] = { 'i', 'n', 'v', 'd', 'e', 'p', 'i', 'x' };
+
+    static void write_value(std::vector<std::byte> &data, std::uint64_t value) {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    static void write_string(std::vector<std::byte> &data, const std::string &string) {
+        write_value(data, string.size());
+        data.insert(data.end(), reinterpret_cast<const std::byte *>(string.data()), reinterpret_cast<const std::byte *>(string.data()) + string.size());
+    }
+
+    // Reads the index, failing (rather than throwing) if it's truncated
+    class DependencyIndexReader {
+    public:
+        DependencyIndexReader(const std::vector<std::byte> &data, std::size_t offset) noexcept : data(data), offset(offset) {}
+
+        template <typename T> bool read_value(T &value) noexcept {
+            if(this->data.size() - this->offset < sizeof(std::uint64_t)) {
+                return false;
+            }
+            std::uint64_t value_read = 0;
+            for(std::size_t i = 0; i < sizeof(value_read); i++) {
+                value_read |= static_cast<std::uint64_t>(this->data[this->offset++]) << (i * 8);
+            }
+            value = static_cast<T>(value_read);
+            return true;
+        }
+
+        bool read_string(std::string &string) {
+            std::size_t size;
+            if(!this->read_value(size) || this->data.size() - this->offset < size) {
+                return false;
+            }
+            string.assign(reinterpret_cast<const char *>(this->data.data() + this->offset), size);
+            this->offset += size;
+            return true;
+        }
+
+        bool read_tag_path(File::TagFilePath &path) {
+            return this->read_string(path.path) && this->read_value(path.fourcc);
+        }
+
+        bool done() const noexcept {
+            return this->offset == this->data.size();
+        }
+
+    private:
+        const std::vector<std::byte> &data;
+        std::size_t offset;
+    };
+
+    DependencyIndex DependencyIndex::load(const std::filesystem::path &index_path) {
+        DependencyIndex index;
+
+        auto data = File::open_file(index_path);
+        if(!data.has_value() || data->size() < sizeof(DEPENDENCY_INDEX_MAGIC) || std::memcmp(data->data(), DEPENDENCY_INDEX_MAGIC, sizeof(DEPENDENCY_INDEX_MAGIC)) != 0) {
+            return index;
+        }
+
+        DependencyIndexReader reader(*data, sizeof(DEPENDENCY_INDEX_MAGIC));
+
+        std::uint64_t version;
+        std::size_t tag_count;
+        if(!reader.read_value(version) || version != DEPENDENCY_INDEX_VERSION || !reader.read_value(tag_count)) {
+            return index;
+        }
+
+        for(std::size_t t = 0; t < tag_count; t++) {
+            File::TagFilePath tag_path;
+            Entry entry;
+            std::string full_path;
+            std::size_t dependency_count;
+            if(!reader.read_tag_path(tag_path) || !reader.read_string(full_path) || !reader.read_value(entry.size) || !reader.read_value(entry.modification_time) || !reader.read_value(entry.content_hash) || !reader.read_value(dependency_count)) {
+                return DependencyIndex();
+            }
+            entry.full_path = full_path;
+
+            // Don't trust the count to reserve memory; a bad index should just be thrown away
+            for(std::size_t d = 0; d < dependency_count; d++) {
+                if(!reader.read_tag_path(entry.dependencies.emplace_back())) {
+                    return DependencyIndex();
+                }
+            }
+
+            index.tags.emplace(std::move(tag_path), std::move(entry));
+        }
+
+        if(!reader.done()) {
+            return DependencyIndex();
+        }
+
+        return index;
+    }
+
+    bool DependencyIndex::save(const std::filesystem::path &index_path) const {
+        std::vector<std::byte> data(reinterpret_cast<const std::byte *>(DEPENDENCY_INDEX_MAGIC), reinterpret_cast<const std::byte *>(DEPENDENCY_INDEX_MAGIC) + sizeof(DEPENDENCY_INDEX_MAGIC));
+        write_value(data, DEPENDENCY_INDEX_VERSION);
+        write_value(data, this->tags.size());
+
+        for(auto &[tag_path, entry] : this->tags) {
+            write_string(data, tag_path.path);
+            write_value(data, static_cast<std::uint64_t>(tag_path.fourcc));
+            write_string(data, entry.full_path.string());
+            write_value(data, entry.size);
+            write_value(data, static_cast<std::uint64_t>(entry.modification_time));
+            write_value(data, entry.content_hash);
+            write_value(data, entry.dependencies.size());
+            for(auto &dependency : entry.dependencies) {
+                write_string(data, dependency.path);
+                write_value(data, static_cast<std::uint64_t>(dependency.fourcc));
+            }
+        }
+
+        return File::save_file(index_path, data);
+    }
+
+    std::size_t DependencyIndex::update(const std::vector<std::filesystem::path> &tags) {
+        std::map<File::TagFilePath, Entry> updated_tags;
+        std::size_t tags_read = 0;
+
+        for(auto &tag : File::load_virtual_tag_folder(tags)) {
+            auto tag_path = File::split_tag_class_extension(File::preferred_path_to_halo_path(tag.tag_path));
+            if(!tag_path.has_value()) {
+                continue;
+            }
+
+            std::error_code ec;
+            std::uint64_t size = std::filesystem::file_size(tag.full_path, ec);
+            if(ec) {
+                continue;
+            }
+            std::int64_t modification_time = std::filesystem::last_write_time(tag.full_path, ec).time_since_epoch().count();
+            if(ec) {
+                continue;
+            }
+
+            // If the file looks the same as last time, keep what we had
+            auto existing = this->tags.find(*tag_path);
+            bool same_file = existing != this->tags.end() && existing->second.full_path == tag.full_path;
+            if(same_file && existing->second.size == size && existing->second.modification_time == modification_time) {
+                updated_tags.emplace(std::move(*tag_path), std::move(existing->second));
+                continue;
+            }
+
+            auto tag_data = File::MemoryMappedFile::map_file(tag.full_path);
+            if(!tag_data.has_value()) {
+                eprintf_warn("Warning: Failed to read tag %s", tag.full_path.string().c_str());
+                continue;
+            }
+            tags_read++;
+
+            Entry entry;
+            entry.full_path = tag.full_path;
+            entry.size = size;
+            entry.modification_time = modification_time;
+            entry.content_hash = FNV1AHash::hash_bytes(tag_data->data(), tag_data->size());
+
+            // If only the modification time changed, the references are still the same
+            if(same_file && existing->second.content_hash == entry.content_hash) {
+                entry.dependencies = std::move(existing->second.dependencies);
+            }
+            else {
+                try {
+                    Parser::ParserStruct::scan_hek_tag_file_dependencies(tag_data->data(), tag_data->size(), [&entry](TagFourCC tag_fourcc, const char *path, std::size_t) {
+                        entry.dependencies.emplace_back(File::remove_duplicate_slashes(path), tag_fourcc);
+                    });
+                }
+                catch(std::exception &e) {
+                    // Leave it out so it's read (and reported) again next time
+                    eprintf_warn("Warning: Failed to read tag %s: %s", tag.full_path.string().c_str(), e.what());
+                    continue;
+                }
+            }
+
+            updated_tags.emplace(std::move(*tag_path), std::move(entry));
+        }
+
+        this->tags = std::move(updated_tags);
+        return tags_read;
+    }
+
+    const DependencyIndex::Entry *DependencyIndex::find_tag(const File::TagFilePath &tag) const {
+        auto entry = this->tags.find(tag);
+        return entry == this->tags.end() ? nullptr : &entry->second;
+    }
+
+    std::vector<File::TagFilePath> DependencyIndex::find_referencing_tags(const File::TagFilePath &tag) const {
+        std::vector<File::TagFilePath> referencing_tags;
+        for(auto &[tag_path, entry] : this->tags) {
+            for(auto &dependency : entry.dependencies) {
+                if(dependency == tag) {
+                    referencing_tags.emplace_back(tag_path);
+                    break;
+                }
+            }
+        }
+        return referencing_tags;
+    }
+}
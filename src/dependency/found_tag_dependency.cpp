@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <invader/dependency/found_tag_dependency.hpp>
+#include <invader/dependency/dependency_index.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/tag/parser/parser_struct.hpp>
 
 #include <filesystem>
@@ -11,34 +13,15 @@ namespace Invader {
     static std::vector<File::TagFilePath> get_dependencies(const std::byte *tag_data, std::size_t tag_data_length) {
         std::vector<File::TagFilePath> dependencies;
 
-        auto recursively_get_dependencies = [&dependencies](const Parser::ParserStruct &st, auto &recursively_get_dependencies) -> void {
-            for(auto &v : st.get_values()) {
-                switch(v.get_type()) {
-                    case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE: {
-                        auto count = v.get_array_size();
-                        for(std::size_t i = 0; i < count; i++) {
-                            recursively_get_dependencies(v.get_object_in_array(i), recursively_get_dependencies);
-                        }
-                        break;
-                    }
-                    case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY: {
-                        auto &dep = v.get_dependency();
-                        if(!dep.path.empty()) {
-                            dependencies.emplace_back(File::halo_path_to_preferred_path(dep.path), dep.tag_fourcc);
-                        }
-                        break;
-                    }
-                    default: break;
-                }
-            }
-        };
-
-        recursively_get_dependencies(*Parser::ParserStruct::parse_hek_tag_file(tag_data, tag_data_length), recursively_get_dependencies);
+        // Only the references are needed, so don't bother parsing the whole tag
+        Parser::ParserStruct::scan_hek_tag_file_dependencies(tag_data, tag_data_length, [&dependencies](TagFourCC tag_fourcc, const char *path, std::size_t) {
+            dependencies.emplace_back(File::halo_path_to_preferred_path(File::remove_duplicate_slashes(path)), tag_fourcc);
+        });
 
         return dependencies;
     }
 
-    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success) {
+    std::vector<FoundTagDependency> FoundTagDependency::find_dependencies(const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, std::vector<std::filesystem::path> tags, bool reverse, bool recursive, bool &success, const DependencyIndex *index) {
         std::vector<FoundTagDependency> found_tags;
         success = true;
 
@@ -46,7 +29,7 @@ namespace Invader {
         std::string tag_path_str = File::halo_path_to_preferred_path(tag_path_to_find);
 
         if(!reverse) {
-            auto find_dependencies_in_tag = [&tags, &found_tags, &recursive, &success](const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, auto recursion) -> void {
+            auto find_dependencies_in_tag = [&tags, &found_tags, &recursive, &success, &index](const char *tag_path_to_find, Invader::TagFourCC tag_int_to_find, auto recursion) -> void {
                 auto tag_path_str = File::halo_path_to_preferred_path(tag_path_to_find);
 
                 // See if we can open the tag
@@ -57,15 +40,35 @@ namespace Invader {
                         continue;
                     }
 
-                    auto tag_data = File::open_file(tag_path);
-                    if(!tag_data.has_value()) {
-                        eprintf_error("Failed to read tag %s", tag_path.string().c_str());
-                        success = false;
-                        return;
+                    // Use the index if it has this tag
+                    const DependencyIndex::Entry *index_entry = nullptr;
+                    if(index != nullptr) {
+                        index_entry = index->find_tag(File::TagFilePath(File::preferred_path_to_halo_path(tag_path_str), tag_int_to_find));
+                        if(index_entry != nullptr && index_entry->full_path != tag_path) {
+                            index_entry = nullptr;
+                        }
+                    }
+
+                    std::optional<File::MemoryMappedFile> tag_data;
+                    if(index_entry == nullptr) {
+                        tag_data = File::MemoryMappedFile::map_file(tag_path);
+                        if(!tag_data.has_value()) {
+                            eprintf_error("Failed to read tag %s", tag_path.string().c_str());
+                            success = false;
+                            return;
+                        }
                     }
 
                     try {
-                        auto dependencies = get_dependencies(tag_data->data(), tag_data->size());
+                        std::vector<File::TagFilePath> dependencies;
+                        if(index_entry != nullptr) {
+                            for(auto &dependency : index_entry->dependencies) {
+                                dependencies.emplace_back(File::halo_path_to_preferred_path(dependency.path), dependency.fourcc);
+                            }
+                        }
+                        else {
+                            dependencies = get_dependencies(tag_data->data(), tag_data->size());
+                        }
                         for(auto &dependency : dependencies) {
                             // Make sure it's not in found_tags
                             bool dupe = false;
@@ -117,6 +120,11 @@ namespace Invader {
 
             find_dependencies_in_tag(tag_path_to_find, tag_int_to_find, find_dependencies_in_tag);
         }
+        else if(index != nullptr) {
+            for(auto &tag : index->find_referencing_tags(File::TagFilePath(File::preferred_path_to_halo_path(tag_path_str), tag_int_to_find))) {
+                found_tags.emplace_back(File::halo_path_to_preferred_path(tag.path), tag.fourcc, false, index->find_tag(tag)->full_path);
+            }
+        }
         else {
             // Iterate
             for(auto &tags_directory : tags) {
@@ -157,7 +165,7 @@ namespace Invader {
 
                             // Open it
                             auto fp = file.path();
-                            auto tag_data = File::open_file(fp);
+                            auto tag_data = File::MemoryMappedFile::map_file(fp);
                             if(!tag_data.has_value()) {
                                 eprintf_error("Failed to read tag %s", fp.string().c_str());
                                 continue;
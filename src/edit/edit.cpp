@@ -2,12 +2,17 @@
 
 #include "../command_line_option.hpp"
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/parser/parser_struct.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/tag/hek/header.hpp>
 #include "../crc/crc32.h"
 #include <string>
+#include <map>
+#include <iostream>
+#include <iterator>
 
 #include "expression.hpp"
 
@@ -336,7 +341,38 @@ static std::string get_value(const Parser::ParserStructValue &value, const std::
     }
 }
 
-static void set_value(Parser::ParserStructValue &value, const std::string &new_value, const std::optional<std::string> bitfield = std::nullopt) {
+// Comma-separated expressions for setting numeric values, compiled once for every value they're applied to
+struct NumericExpressions {
+    std::vector<std::string> expressions;
+    std::vector<std::optional<Edit::CompiledExpression<std::int64_t>>> int_expressions;
+    std::vector<std::optional<Edit::CompiledExpression<double>>> float_expressions;
+
+    NumericExpressions(const std::string &new_value) {
+        const char *start = new_value.c_str();
+        const char *cursor;
+        for(cursor = start; *cursor != 0; cursor++) {
+            if(*cursor == ',') {
+                expressions.emplace_back(start, cursor);
+                start = ++cursor;
+                continue;
+            }
+        }
+        expressions.emplace_back(start, cursor);
+
+        int_expressions.resize(expressions.size());
+        float_expressions.resize(expressions.size());
+    }
+
+    template <typename Number> Number evaluate(std::size_t index, std::vector<std::optional<Edit::CompiledExpression<Number>>> &compiled, Number input) {
+        auto &expression = compiled[index];
+        if(!expression.has_value()) {
+            expression.emplace(this->expressions[index].c_str());
+        }
+        return expression->evaluate(input);
+    }
+};
+
+static void set_value(Parser::ParserStructValue &value, const std::string &new_value, NumericExpressions &numeric_expressions, const std::optional<std::string> bitfield = std::nullopt) {
     auto format = value.get_number_format();
     auto type = value.get_type();
     
@@ -422,20 +458,7 @@ static void set_value(Parser::ParserStructValue &value, const std::string &new_v
     // Numeric value?
     else {
         auto expected_value_count = value.get_value_count();
-        
-        std::vector<std::string> expressions;
-        expressions.reserve(expected_value_count);
-        
-        const char *start = new_value.c_str();
-        const char *cursor;
-        for(cursor = start; *cursor != 0; cursor++) {
-            if(*cursor == ',') {
-                expressions.emplace_back(start, cursor);
-                start = ++cursor;
-                continue;
-            }
-        }
-        expressions.emplace_back(start, cursor);
+        auto &expressions = numeric_expressions.expressions;
         
         if(expressions.size() != expected_value_count) {
             eprintf_error("Expected %zu comma-separated value%s but only got %zu", expected_value_count, expected_value_count == 1 ? "" : "s", expressions.size());
@@ -445,13 +468,12 @@ static void set_value(Parser::ParserStructValue &value, const std::string &new_v
         auto all_values = value.get_values();
         for(std::size_t i = 0; i < expected_value_count; i++) {
             auto &v = all_values[i];
-            auto *e = expressions[i].c_str();
             switch(value.get_number_format()) {
                 case Parser::ParserStructValue::NumberFormat::NUMBER_FORMAT_INT:
-                    v = Edit::evaluate_expression(e, std::get<std::int64_t>(v));
+                    v = numeric_expressions.evaluate(i, numeric_expressions.int_expressions, std::get<std::int64_t>(v));
                     break;
                 case Parser::ParserStructValue::NumberFormat::NUMBER_FORMAT_FLOAT:
-                    v = Edit::evaluate_expression(e, std::get<double>(v));
+                    v = numeric_expressions.evaluate(i, numeric_expressions.float_expressions, std::get<double>(v));
                     break;
                 default:
                     std::terminate();
@@ -756,6 +778,260 @@ static void list_everything(Parser::ParserStruct &ps, std::vector<std::string> &
     }
 }
 
+static bool parse_action(char opt, const std::vector<const char *> &arguments, std::vector<Actions> &actions) {
+    auto parse_position = [](const char *position) -> std::size_t {
+        return std::strcmp(position, "end") == 0 ? SIZE_MAX : std::stoul(position);
+    };
+
+    switch(opt) {
+        case 'C':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_COUNT, arguments[0], {}, 0, 0 });
+            return true;
+        case 'G':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_GET, arguments[0], {}, 0, 0 });
+            return true;
+        case 'L':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_LIST_ALL_VALUES, {}, {}, 0, 0 });
+            return true;
+        case 'l':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_LIST, {}, {}, 0, 0 });
+            return true;
+        case 'S':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_SET, arguments[0], arguments[1], 0, 0 });
+            return true;
+        case 'I':
+            try {
+                actions.emplace_back(Actions { ActionType::ACTION_TYPE_INSERT, arguments[0], {}, std::stoul(arguments[1]), parse_position(arguments[2]) });
+            }
+            catch(std::exception &) {
+                eprintf_error("Expected a valid count/position");
+                throw;
+            }
+            return true;
+        case 'M':
+            try {
+                actions.emplace_back(Actions { ActionType::ACTION_TYPE_MOVE, arguments[0], {}, 0, parse_position(arguments[1]) });
+            }
+            catch(std::exception &) {
+                eprintf_error("Expected a valid position");
+                throw;
+            }
+            return true;
+        case 'E':
+            actions.emplace_back(Actions { ActionType::ACTION_TYPE_DELETE, arguments[0], {}, 0, 0 });
+            return true;
+        case 'c':
+            try {
+                actions.emplace_back(Actions { ActionType::ACTION_TYPE_COPY, arguments[0], {}, 0, parse_position(arguments[1]) });
+            }
+            catch(std::exception &) {
+                eprintf_error("Expected a valid position");
+                throw;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Check if a key only refers to a field stored in the main struct, in which case the tag doesn't need to be fully parsed
+static bool is_base_struct_key(const Parser::ParserStruct &base_struct, const std::string &key) {
+    if(key.find('[') != std::string::npos) {
+        return false;
+    }
+    
+    std::string after_member;
+    std::string member;
+    try {
+        member = get_top_member_name(key, after_member);
+    }
+    catch(std::exception &) {
+        return false;
+    }
+    
+    for(auto &v : base_struct.get_values()) {
+        auto *member_name = v.get_member_name();
+        if(member_name && member_name == member) {
+            switch(v.get_type()) {
+                case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE:
+                case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY:
+                case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGDATAOFFSET:
+                    return false;
+                default:
+                    return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+static std::string escape_csv(const std::string &value) {
+    if(value.find_first_of(",\"\r\n") == std::string::npos) {
+        return value;
+    }
+    
+    std::string escaped = "\"";
+    for(auto c : value) {
+        if(c == '"') {
+            escaped += '"';
+        }
+        escaped += c;
+    }
+    escaped += '"';
+    return escaped;
+}
+
+static std::string escape_json(const std::string &value) {
+    std::string escaped = "\"";
+    for(auto c : value) {
+        switch(c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20) {
+                    char control[7];
+                    std::snprintf(control, sizeof(control), "\\u%04X", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+                    escaped += control;
+                }
+                else {
+                    escaped += c;
+                }
+                break;
+        }
+    }
+    escaped += '"';
+    return escaped;
+}
+
+enum QueryFormat {
+    QUERY_FORMAT_CSV,
+    QUERY_FORMAT_JSON
+};
+
+struct ScriptTag {
+    std::string tag_path;
+    std::vector<Actions> actions;
+};
+
+// Split a script line into words. Words containing spaces can be put in double quotes. Backslashes are left alone, since
+// tag paths use them.
+static std::vector<std::string> split_script_line(const std::string &line, std::size_t line_number) {
+    std::vector<std::string> words;
+    auto *c = line.c_str();
+    while(true) {
+        for(; *c == ' ' || *c == '\t' || *c == '\r'; c++);
+        if(*c == 0) {
+            break;
+        }
+
+        auto &word = words.emplace_back();
+        if(*c == '"') {
+            for(c++; *c != '"'; c++) {
+                if(*c == 0) {
+                    eprintf_error("Line %zu: Unterminated quote", line_number);
+                    throw std::exception();
+                }
+                word += *c;
+            }
+            c++;
+        }
+        else {
+            for(; *c != 0 && *c != ' ' && *c != '\t' && *c != '\r'; c++) {
+                word += *c;
+            }
+        }
+    }
+    return words;
+}
+
+// Read a script where each line is a tag path followed by the actions to do on it, using the same options as the
+// command line (e.g. "weapons\pistol\pistol.weapon --set "triggers[0].rounds per second" 8 -G zoom levels"). Blank
+// lines and lines starting with # are skipped. If a tag is listed more than once, its actions are run in order.
+template <typename Array>
+static std::vector<ScriptTag> parse_script(const std::string &script, const Array &options) {
+    std::vector<ScriptTag> tags;
+    std::map<std::string, std::size_t> tag_indices;
+
+    std::size_t line_start = 0;
+    std::size_t line_number = 0;
+    while(line_start < script.size()) {
+        auto line_end = script.find('\n', line_start);
+        if(line_end == std::string::npos) {
+            line_end = script.size();
+        }
+        auto line = script.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        line_number++;
+
+        auto words = split_script_line(line, line_number);
+        if(words.empty() || words[0][0] == '#') {
+            continue;
+        }
+
+        auto tag_path = File::halo_path_to_preferred_path(words[0]);
+        auto [tag_index, inserted] = tag_indices.try_emplace(tag_path, tags.size());
+        if(inserted) {
+            tags.emplace_back(ScriptTag { tag_path, {} });
+        }
+        auto &actions = tags[tag_index->second].actions;
+
+        for(std::size_t w = 1; w < words.size(); w++) {
+            auto &word = words[w];
+            const CommandLineOption *option = nullptr;
+            for(auto &o : options) {
+                if((word.size() > 2 && word[0] == '-' && word[1] == '-' && o.get_full_name() == word.c_str() + 2) || (word.size() == 2 && word[0] == '-' && o.get_char_name() == word[1])) {
+                    option = &o;
+                    break;
+                }
+            }
+            if(option == nullptr) {
+                eprintf_error("Line %zu: Unknown option %s", line_number, word.c_str());
+                throw std::exception();
+            }
+
+            std::size_t argument_count = static_cast<std::size_t>(option->get_argument_count());
+            if(words.size() - w - 1 < argument_count) {
+                eprintf_error("Line %zu: %s expects %zu argument%s", line_number, word.c_str(), argument_count, argument_count == 1 ? "" : "s");
+                throw std::exception();
+            }
+
+            std::vector<const char *> arguments;
+            for(std::size_t a = 0; a < argument_count; a++) {
+                arguments.emplace_back(words[++w].c_str());
+            }
+
+            bool is_action;
+            try {
+                is_action = parse_action(option->get_char_name(), arguments, actions);
+            }
+            catch(std::exception &) {
+                eprintf_error("Line %zu: Invalid arguments for %s", line_number, word.c_str());
+                throw;
+            }
+            if(!is_action) {
+                eprintf_error("Line %zu: %s can't be used in a script", line_number, word.c_str());
+                throw std::exception();
+            }
+        }
+    }
+
+    return tags;
+}
+
 int main(int argc, char * const *argv) {
     set_up_color_term();
     
@@ -769,7 +1045,7 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
         CommandLineOption("get", 'G', 1, "Get the value with the given key.", "<key>"),
-        CommandLineOption("verify-checksum", 'V', 0, "Verify that the checksum in the header is correct and print the result."),
+        CommandLineOption("verify-checksum", 'V', 0, "Verify that the checksum in the header is correct and print the result. With --batch and no other actions, tags are checked in parallel without being parsed and only mismatches are printed."),
         CommandLineOption("checksum", 'H', 0, "Output the calculated checksum of the tag."),
         CommandLineOption("set", 'S', 2, "Set the value at the given key to the given value.", "<key> <val>"),
         CommandLineOption("count", 'C', 1, "Get the number of elements in the array at the given key.", "<key>"),
@@ -782,11 +1058,14 @@ int main(int argc, char * const *argv) {
         CommandLineOption("move", 'M', 2, "Swap the selected structs with the structs at the given index or \"end\" if the end of the array. The regions must not intersect.", "<key> <pos>"),
         CommandLineOption("erase", 'E', 1, "Delete the selected struct(s).", "<key>"),
         CommandLineOption("copy", 'c', 2, "Copy the selected struct(s) to the given index or \"end\" if the end of the array.", "<key> <pos>"),
-        CommandLineOption("no-safeguards", 'n', 0, "Allow all tag data to be edited (proceed at your own risk)")
+        CommandLineOption("no-safeguards", 'n', 0, "Allow all tag data to be edited (proceed at your own risk)"),
+        CommandLineOption("script", 's', 1, "Read tags and the actions to do on them from a file, or \"-\" for stdin. Each line is a tag path followed by actions using the same options as the command line. Tags are edited in parallel, and only tags that changed are saved.", "<file>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("query", 'q', 1, "Print the value of each --get key for each tag as a table instead of editing. Tags matched by --batch are read in parallel. Can be: csv, json", "<format>")
     };
 
     static constexpr char DESCRIPTION[] = "Edit tags via command-line.";
-    static constexpr char USAGE[] = "[options] <-b <expr>|tag.class>";
+    static constexpr char USAGE[] = "[options] <-b <expr>|-s <file>|tag.class>";
 
     struct EditOptions {
         std::filesystem::path tags = "tags";
@@ -798,6 +1077,9 @@ int main(int argc, char * const *argv) {
         bool view_checksum = false;
         std::vector<std::string> batch, batch_exclude;
         std::optional<std::variant<std::string, std::filesystem::path>> overwrite_path;
+        std::optional<std::string> script;
+        std::optional<QueryFormat> query_format;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } edit_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<EditOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, edit_options, [](char opt, const std::vector<const char *> &arguments, auto &edit_options) {
@@ -814,48 +1096,12 @@ int main(int argc, char * const *argv) {
             case 'e':
                 edit_options.batch_exclude.emplace_back(arguments[0]);
                 break;
-            case 'C':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_COUNT, arguments[0], {}, 0, 0 });
-                break;
-            case 'G':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_GET, arguments[0], {}, 0, 0 });
-                break;
             case 'V':
                 edit_options.verify_checksum = true;
                 break;
             case 'H':
                 edit_options.view_checksum = true;
                 break;
-            case 'L':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_LIST_ALL_VALUES, {}, {}, 0, 0 });
-                break;
-            case 'l':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_LIST, {}, {}, 0, 0 });
-                break;
-            case 'S':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_SET, arguments[0], arguments[1], 0, 0 });
-                break;
-            case 'I':
-                try {
-                    edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_INSERT, arguments[0], {}, std::stoul(arguments[1]), std::strcmp(arguments[2], "end") == 0 ? SIZE_MAX : std::stoul(arguments[2]) });
-                }
-                catch(std::exception &) {
-                    eprintf_error("Expected a valid count/position");
-                    std::exit(EXIT_FAILURE);
-                }
-                break;
-            case 'M':
-                try {
-                    edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_MOVE, arguments[0], {}, 0, std::strcmp(arguments[1], "end") == 0 ? SIZE_MAX : std::stoul(arguments[1]) });
-                }
-                catch(std::exception &) {
-                    eprintf_error("Expected a valid position");
-                    std::exit(EXIT_FAILURE);
-                }
-                break;
-            case 'E':
-                edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_DELETE, arguments[0], {}, 0, 0 });
-                break;
             case 'N':
                 edit_options.new_tag = true;
                 break;
@@ -868,27 +1114,65 @@ int main(int argc, char * const *argv) {
             case 'O':
                 edit_options.overwrite_path = std::string(arguments[0]);
                 break;
-            case 'c':
+            case 's':
+                edit_options.script = arguments[0];
+                break;
+            case 'q':
+                if(std::strcmp(arguments[0], "csv") == 0) {
+                    edit_options.query_format = QueryFormat::QUERY_FORMAT_CSV;
+                }
+                else if(std::strcmp(arguments[0], "json") == 0) {
+                    edit_options.query_format = QueryFormat::QUERY_FORMAT_JSON;
+                }
+                else {
+                    eprintf_error("Unknown query format %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                edit_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
+            default:
                 try {
-                    edit_options.actions.emplace_back(Actions { ActionType::ACTION_TYPE_COPY, arguments[0], {}, 0, std::strcmp(arguments[1], "end") == 0 ? SIZE_MAX : std::stoul(arguments[1]) });
+                    parse_action(opt, arguments, edit_options.actions);
                 }
                 catch(std::exception &) {
-                    eprintf_error("Expected a valid position");
                     std::exit(EXIT_FAILURE);
                 }
                 break;
         }
     });
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(edit_options.thread_count);
+    
     auto use_batching = !(edit_options.batch.empty() && edit_options.batch_exclude.empty());
-    if(use_batching != remaining_arguments.empty()) {
-        eprintf_error("Expected batching or a tag path but not both.");
+    auto use_script = edit_options.script.has_value();
+    if(static_cast<int>(use_batching) + static_cast<int>(use_script) + static_cast<int>(!remaining_arguments.empty()) != 1) {
+        eprintf_error("Expected batching, a script, or a tag path but only one of them.");
+        return EXIT_FAILURE;
+    }
+    
+    if(use_script && (edit_options.overwrite_path.has_value() || !edit_options.actions.empty())) {
+        eprintf_error("Output paths and actions can't be given on the command line with --script.");
         return EXIT_FAILURE;
     }
 
-    auto do_it_do_it_do_it_do_it = [&edit_options](const std::string &tag_path) -> bool {
+    if(edit_options.query_format.has_value()) {
+        bool only_get = !edit_options.actions.empty();
+        for(auto &a : edit_options.actions) {
+            only_get = only_get && a.type == ActionType::ACTION_TYPE_GET;
+        }
+        if(!only_get || use_script || edit_options.new_tag || edit_options.overwrite_path.has_value() || edit_options.verify_checksum || edit_options.view_checksum) {
+            eprintf_error("Only --get can be used with --query.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto do_it_do_it_do_it_do_it = [&edit_options](const std::string &tag_path, const std::vector<Actions> &actions, std::vector<std::string> &output) -> bool {
         std::filesystem::path file_path = std::filesystem::path(edit_options.tags) / tag_path;
         std::unique_ptr<Parser::ParserStruct> tag_struct;
+        std::optional<std::vector<std::byte>> original_data;
         
         // Make a new tag... or don't
         HEK::TagFourCC tag_class;
@@ -905,12 +1189,14 @@ int main(int argc, char * const *argv) {
             // If we're verifying the checksum or viewing the checksum of a new tag, well... okay I guess
             if(edit_options.verify_checksum || edit_options.view_checksum) {
                 if(edit_options.view_checksum) {
-                    std::printf("0x%08X\n", reinterpret_cast<HEK::TagFileHeader *>(tag_struct->generate_hek_tag_data().data())->crc32.read());
+                    char checksum[11];
+                    std::snprintf(checksum, sizeof(checksum), "0x%08X", reinterpret_cast<HEK::TagFileHeader *>(tag_struct->generate_hek_tag_data().data())->crc32.read());
+                    output.emplace_back(checksum);
                 }
                 
                 // Can't really verify a tag that never existed
                 if(edit_options.verify_checksum) {
-                    std::printf("matched\n");
+                    output.emplace_back("matched");
                 }
             }
         }
@@ -936,27 +1222,24 @@ int main(int argc, char * const *argv) {
                 
                 // Print the checksum
                 if(edit_options.view_checksum) {
-                    std::printf("0x%08X\n", checksum);
+                    char checksum_string[11];
+                    std::snprintf(checksum_string, sizeof(checksum_string), "0x%08X", checksum);
+                    output.emplace_back(checksum_string);
                 }
                 
                 // Verify it's correct
                 if(edit_options.verify_checksum) {
-                    if(header->crc32 == ~crc32(0, value->data() + sizeof(*header), value->size() - sizeof(*header))) {
-                        std::printf("matched\n");
-                    }
-                    else {
-                        std::printf("mismatched\n");
-                    }
+                    output.emplace_back(header->crc32 == ~checksum ? "matched" : "mismatched");
                 }
             }
             
             tag_class = reinterpret_cast<const HEK::TagFileHeader *>(value->data())->tag_fourcc;
+            original_data = std::move(*value);
         }
         
-        std::vector<std::string> output;
         bool should_save = edit_options.new_tag; // by default only save if making a new tag. this will be set to true if --set, --insert, --copy, --move, or --delete are used too
         
-        for(auto &i : edit_options.actions) {
+        for(auto &i : actions) {
             switch(i.type) {
                 case ActionType::ACTION_TYPE_LIST: {
                     list_everything(populate_struct(*Parser::ParserStruct::generate_base_struct(tag_class)), output, false);
@@ -978,8 +1261,9 @@ int main(int argc, char * const *argv) {
                     std::string bitfield;
                     should_save = true;
                     auto arr = get_values_for_key(tag_struct.get(), i.key == "" ? "" : (std::string(".") + i.key), bitfield, edit_options.check_read_only);
+                    NumericExpressions numeric_expressions(i.value);
                     for(auto &k : arr) {
-                        set_value(k, i.value, bitfield);
+                        set_value(k, i.value, numeric_expressions, bitfield);
                     }
                     break;
                 }
@@ -1079,10 +1363,6 @@ int main(int argc, char * const *argv) {
             }
         }
         
-        for(auto &i : output) {
-            std::puts(i.c_str());
-        }
-        
         // If we're overwriting a file that isn't the main one, let's find out what
         bool create_directories_if_possible = false;
         
@@ -1121,7 +1401,13 @@ int main(int argc, char * const *argv) {
                 std::filesystem::create_directories(file_path.parent_path(), ec);
             }
             
-            if(!File::save_file(file_path, tag_struct->generate_hek_tag_data(tag_class))) {
+            // Don't bother writing the tag if nothing actually changed
+            auto tag_data = tag_struct->generate_hek_tag_data(tag_class);
+            if(!edit_options.overwrite_path.has_value() && original_data.has_value() && *original_data == tag_data) {
+                return true;
+            }
+            
+            if(!File::save_file(file_path, tag_data)) {
                 eprintf_error("Unable to write to %s", file_path.string().c_str());
                 return false;
             }
@@ -1132,14 +1418,275 @@ int main(int argc, char * const *argv) {
         }
     };
     
-    if(use_batching) {
+    auto print_output = [](const std::vector<std::string> &output) {
+        for(auto &i : output) {
+            std::puts(i.c_str());
+        }
+    };
+    
+    if(edit_options.query_format.has_value()) {
+        std::vector<std::string> tag_paths;
+        if(use_batching) {
+            File::PathMatcher batch_matcher(edit_options.batch, edit_options.batch_exclude);
+            for(auto &t : File::load_virtual_tag_folder({edit_options.tags})) {
+                if(batch_matcher.matches(t.tag_path.c_str())) {
+                    tag_paths.emplace_back(t.tag_path);
+                }
+            }
+        }
+        else {
+            tag_paths.emplace_back(remaining_arguments[0]);
+        }
+        
+        // If every key is in the main struct for a tag class, tags of that class only need their main struct parsed
+        std::map<HEK::TagFourCC, bool> base_struct_only;
+        for(auto &t : tag_paths) {
+            auto tag_path = File::split_tag_class_extension(t);
+            if(!tag_path.has_value() || base_struct_only.find(tag_path->fourcc) != base_struct_only.end()) {
+                continue;
+            }
+            
+            bool all_base_struct = false;
+            auto base_struct = Parser::ParserStruct::generate_base_struct(tag_path->fourcc);
+            if(base_struct) {
+                all_base_struct = true;
+                for(auto &a : edit_options.actions) {
+                    all_base_struct = all_base_struct && is_base_struct_key(*base_struct, a.key);
+                }
+            }
+            base_struct_only.emplace(tag_path->fourcc, all_base_struct);
+        }
+        
+        struct QueryResult {
+            std::vector<std::vector<std::string>> values;
+            bool success = false;
+        };
+        std::vector<QueryResult> results(tag_paths.size());
+        auto query_tag = [&tag_paths, &results, &base_struct_only, &edit_options](std::size_t t) {
+            auto file_path = edit_options.tags / File::halo_path_to_preferred_path(tag_paths[t]);
+            auto tag_data = File::MemoryMappedFile::map_file(file_path);
+            if(!tag_data.has_value()) {
+                eprintf_error("Failed to read %s", file_path.string().c_str());
+                return;
+            }
+            
+            try {
+                // Only use the fast path if the header agrees with the extension
+                auto tag_path = File::split_tag_class_extension(tag_paths[t]);
+                bool fast = tag_path.has_value() && base_struct_only.find(tag_path->fourcc)->second && tag_data->size() >= sizeof(HEK::TagFileHeader) && reinterpret_cast<const HEK::TagFileHeader *>(tag_data->data())->tag_fourcc == tag_path->fourcc;
+                auto tag_struct = fast ? Parser::ParserStruct::parse_hek_tag_file_base_struct(tag_data->data(), tag_data->size()) : Parser::ParserStruct::parse_hek_tag_file(tag_data->data(), tag_data->size());
+                
+                for(auto &a : edit_options.actions) {
+                    std::string bitfield;
+                    auto &key_values = results[t].values.emplace_back();
+                    for(auto &v : get_values_for_key(tag_struct.get(), a.key == "" ? "" : (std::string(".") + a.key), bitfield, false)) {
+                        key_values.emplace_back(get_value(v, bitfield));
+                    }
+                }
+                results[t].success = true;
+            }
+            catch(std::exception &) {
+                eprintf_error("Failed to query %s", file_path.string().c_str());
+            }
+        };
+        
+        ThreadPool::shared().parallel_for(tag_paths.size(), query_tag, edit_options.thread_count);
+        
+        bool success = true;
+        if(*edit_options.query_format == QueryFormat::QUERY_FORMAT_CSV) {
+            std::string line = "tag";
+            for(auto &a : edit_options.actions) {
+                line += "," + escape_csv(a.key);
+            }
+            std::puts(line.c_str());
+            
+            for(std::size_t t = 0; t < tag_paths.size(); t++) {
+                success = success && results[t].success;
+                if(!results[t].success) {
+                    continue;
+                }
+                line = escape_csv(tag_paths[t]);
+                for(auto &key_values : results[t].values) {
+                    std::string joined;
+                    for(auto &v : key_values) {
+                        joined += (joined.empty() ? "" : ";") + v;
+                    }
+                    line += "," + escape_csv(joined);
+                }
+                std::puts(line.c_str());
+            }
+        }
+        else {
+            std::puts("[");
+            bool first = true;
+            for(std::size_t t = 0; t < tag_paths.size(); t++) {
+                success = success && results[t].success;
+                if(!results[t].success) {
+                    continue;
+                }
+                std::string line = std::string(first ? "" : ",\n") + "    {\"tag\": " + escape_json(tag_paths[t]);
+                first = false;
+                for(std::size_t k = 0; k < edit_options.actions.size(); k++) {
+                    auto &key = edit_options.actions[k].key;
+                    auto &key_values = results[t].values[k];
+                    line += ", " + escape_json(key) + ": ";
+                    
+                    // Keys that select a range always give a list so the output has the same shape for every tag
+                    if(key.find('[') != std::string::npos) {
+                        line += "[";
+                        for(std::size_t v = 0; v < key_values.size(); v++) {
+                            line += (v == 0 ? "" : ", ") + escape_json(key_values[v]);
+                        }
+                        line += "]";
+                    }
+                    else {
+                        line += key_values.empty() ? "null" : escape_json(key_values[0]);
+                    }
+                }
+                line += "}";
+                std::fputs(line.c_str(), stdout);
+            }
+            std::puts(first ? "]" : "\n]");
+        }
+        
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else if(use_script) {
+        std::string script;
+        if(*edit_options.script == "-") {
+            script.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        }
+        else {
+            auto script_data = File::open_file(*edit_options.script);
+            if(!script_data.has_value()) {
+                eprintf_error("Failed to read %s", edit_options.script->c_str());
+                return EXIT_FAILURE;
+            }
+            script.assign(reinterpret_cast<const char *>(script_data->data()), script_data->size());
+        }
+        
+        std::vector<ScriptTag> script_tags;
+        try {
+            script_tags = parse_script(script, options);
+        }
+        catch(std::exception &) {
+            return EXIT_FAILURE;
+        }
+        
+        // Edit the tags on multiple threads, holding onto the output so it can be printed in the same order as the script
+        struct ScriptResult {
+            std::vector<std::string> output;
+            bool success = false;
+        };
+        std::vector<ScriptResult> results(script_tags.size());
+        auto edit_tag = [&script_tags, &results, &do_it_do_it_do_it_do_it](std::size_t t) {
+            try {
+                results[t].success = do_it_do_it_do_it_do_it(script_tags[t].tag_path, script_tags[t].actions, results[t].output);
+            }
+            catch(std::exception &) {
+                results[t].success = false;
+            }
+            if(!results[t].success) {
+                eprintf_error("Failed to edit %s", script_tags[t].tag_path.c_str());
+            }
+        };
+        
+        ThreadPool::shared().parallel_for(script_tags.size(), edit_tag, edit_options.thread_count);
+        
+        std::size_t count = 0;
+        for(auto &r : results) {
+            print_output(r.output);
+            count += r.success;
+        }
+        
+        std::size_t total = results.size();
+        auto error_count = total - count;
+        if(error_count > 0) {
+            oprintf_success_warn("Edited %zu out of %zu tag%s (%zu error%s)", count, total, total == 1 ? "" : "s", error_count, error_count == 1 ? "" : "s");
+            return EXIT_FAILURE;
+        }
+        else {
+            oprintf_success("Edited %zu out of %zu tag%s", count, total, total == 1 ? "" : "s");
+            return EXIT_SUCCESS;
+        }
+    }
+    else if(use_batching && edit_options.actions.empty() && !edit_options.new_tag && !edit_options.overwrite_path.has_value() && (edit_options.verify_checksum || edit_options.view_checksum)) {
+        // Only checksums are needed, so the tags don't have to be parsed
+        std::vector<std::string> tag_paths;
+        File::PathMatcher batch_matcher(edit_options.batch, edit_options.batch_exclude);
+        for(auto &t : File::load_virtual_tag_folder({edit_options.tags})) {
+            if(batch_matcher.matches(t.tag_path.c_str())) {
+                tag_paths.emplace_back(t.tag_path);
+            }
+        }
+
+        struct ChecksumResult {
+            std::uint32_t checksum = 0;
+            bool matched = false;
+            bool success = false;
+        };
+        std::vector<ChecksumResult> results(tag_paths.size());
+        auto checksum_tag = [&tag_paths, &results, &edit_options](std::size_t t) {
+            auto file_path = edit_options.tags / File::halo_path_to_preferred_path(tag_paths[t]);
+            auto tag_data = File::MemoryMappedFile::map_file(file_path);
+            if(!tag_data.has_value() || tag_data->size() < sizeof(HEK::TagFileHeader)) {
+                eprintf_error("Failed to read %s", file_path.string().c_str());
+                return;
+            }
+
+            auto *header = reinterpret_cast<const HEK::TagFileHeader *>(tag_data->data());
+            auto &result = results[t];
+            result.checksum = crc32(0, tag_data->data() + sizeof(*header), tag_data->size() - sizeof(*header));
+            result.matched = header->crc32 == ~result.checksum;
+            result.success = true;
+        };
+
+        ThreadPool::shared().parallel_for(tag_paths.size(), checksum_tag, edit_options.thread_count);
+
+        // Only print mismatches unless the checksums themselves were asked for
+        std::size_t total = tag_paths.size();
+        std::size_t error_count = 0;
+        std::size_t mismatch_count = 0;
+        for(std::size_t t = 0; t < total; t++) {
+            auto &result = results[t];
+            if(!result.success) {
+                error_count++;
+                continue;
+            }
+            mismatch_count += !result.matched;
+
+            if(edit_options.view_checksum && edit_options.verify_checksum) {
+                oprintf("%s: 0x%08X %s\n", tag_paths[t].c_str(), result.checksum, result.matched ? "matched" : "mismatched");
+            }
+            else if(edit_options.view_checksum) {
+                oprintf("%s: 0x%08X\n", tag_paths[t].c_str(), result.checksum);
+            }
+            else if(!result.matched) {
+                oprintf("%s: mismatched\n", tag_paths[t].c_str());
+            }
+        }
+
+        if(error_count > 0 || (edit_options.verify_checksum && mismatch_count > 0)) {
+            oprintf_success_warn("Checked %zu out of %zu tag%s (%zu mismatched, %zu error%s)", total - error_count, total, total == 1 ? "" : "s", mismatch_count, error_count, error_count == 1 ? "" : "s");
+            return EXIT_FAILURE;
+        }
+        else {
+            oprintf_success("Checked %zu out of %zu tag%s", total, total, total == 1 ? "" : "s");
+            return EXIT_SUCCESS;
+        }
+    }
+    else if(use_batching) {
         auto v = File::load_virtual_tag_folder({edit_options.tags});
         std::size_t count = 0;
         std::size_t total = 0;
+        File::PathMatcher batch_matcher(edit_options.batch, edit_options.batch_exclude);
         for(auto &t : v) {
-            if(File::path_matches(t.tag_path.c_str(), edit_options.batch, edit_options.batch_exclude)) {
+            if(batch_matcher.matches(t.tag_path.c_str())) {
                 try {
-                    if(do_it_do_it_do_it_do_it(File::halo_path_to_preferred_path(t.tag_path))) {
+                    std::vector<std::string> output;
+                    bool success = do_it_do_it_do_it_do_it(File::halo_path_to_preferred_path(t.tag_path), edit_options.actions, output);
+                    print_output(output);
+                    if(success) {
                         count++;
                         oprintf_success("Successfully edited %s", t.tag_path.c_str());
                     }
@@ -1160,6 +1707,9 @@ int main(int argc, char * const *argv) {
         }
     }
     else {
-        return do_it_do_it_do_it_do_it(File::halo_path_to_preferred_path(remaining_arguments[0])) ? EXIT_SUCCESS : EXIT_FAILURE;
+        std::vector<std::string> output;
+        bool success = do_it_do_it_do_it_do_it(File::halo_path_to_preferred_path(remaining_arguments[0]), edit_options.actions, output);
+        print_output(output);
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 }
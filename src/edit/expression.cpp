@@ -8,8 +8,19 @@
 #include <cassert>
 #include <optional>
 #include <cmath>
+#include <algorithm>
 
-template <typename Number, Number number_from_value(const std::string &what)> static Number evaluate_expression_of_type(const char *expression, Number input) {
+template <typename Number> static Number number_from_string(const std::string &what);
+
+template <> double number_from_string<double>(const std::string &what) {
+    return std::stod(what);
+}
+
+template <> std::int64_t number_from_string<std::int64_t>(const std::string &what) {
+    return std::stoll(what);
+}
+
+template <typename Number> Invader::Edit::CompiledExpression<Number>::CompiledExpression(const char *expression) {
     struct ParsedToken {
         enum Type {
             GROUP,
@@ -153,7 +164,7 @@ template <typename Number, Number number_from_value(const std::string &what)> st
         }
         else {
             new_token.type = ParsedToken::Type::NUMBER;
-            new_token.number = number_from_value(main_token);
+            new_token.number = number_from_string<Number>(main_token);
         }
         token_index++;
         return new_token;
@@ -291,39 +302,49 @@ template <typename Number, Number number_from_value(const std::string &what)> st
 
     recursively_sort_group(main_group, recursively_sort_group);
 
-    // Now we can evaluate it!
-    auto recursively_evaluate_token = [](const ParsedToken &token, Number input, auto &recursively_evaluate_token) -> Number {
+    // Now flatten it into a postfix program so evaluating it is just a loop
+    std::size_t stack_size = 0;
+    auto emit = [this, &stack_size](typename Instruction::Type type, Number number = 0) {
+        this->program.emplace_back(Instruction { type, number });
+        if(type == Instruction::Type::PUSH_NUMBER || type == Instruction::Type::PUSH_INPUT) {
+            this->max_stack_size = std::max(this->max_stack_size, ++stack_size);
+        }
+        else {
+            stack_size--;
+        }
+    };
+
+    auto recursively_compile_token = [&emit](const ParsedToken &token, auto &recursively_compile_token) -> void {
         switch(token.type) {
             case ParsedToken::Type::INPUT:
-                return input * token.number;
+                emit(Instruction::Type::PUSH_INPUT, token.number);
+                break;
             case ParsedToken::Type::NUMBER:
-                return token.number;
+                emit(Instruction::Type::PUSH_NUMBER, token.number);
+                break;
             case ParsedToken::Type::GROUP: {
-                Number value = 0.0;
+                // Groups are evaluated left to right, starting from 0
+                emit(Instruction::Type::PUSH_NUMBER, 0);
                 auto op = ParsedToken::Type::ADD;
                 auto length = token.group.size();
                 for(std::size_t i = 0; i < length; i+=2) {
                     auto last = i + 1 == length;
-                    auto next_value = recursively_evaluate_token(token.group[i], input, recursively_evaluate_token);
+                    recursively_compile_token(token.group[i], recursively_compile_token);
                     switch(op) {
                         case ParsedToken::Type::ADD:
-                            value += next_value;
+                            emit(Instruction::Type::ADD);
                             break;
                         case ParsedToken::Type::SUBTRACT:
-                            value -= next_value;
+                            emit(Instruction::Type::SUBTRACT);
                             break;
                         case ParsedToken::Type::MULTIPLY:
-                            value *= next_value;
+                            emit(Instruction::Type::MULTIPLY);
                             break;
                         case ParsedToken::Type::DIVIDE:
-                            if(next_value == 0) {
-                                std::fputs("Division by zero!\n", stderr);
-                                throw std::exception();
-                            }
-                            value /= next_value;
+                            emit(Instruction::Type::DIVIDE);
                             break;
                         case ParsedToken::Type::POWER:
-                            value = std::pow(value, next_value);
+                            emit(Instruction::Type::POWER);
                             break;
                         default:
                             assert(false);
@@ -332,7 +353,7 @@ template <typename Number, Number number_from_value(const std::string &what)> st
                         op = token.group[i+1].type;
                     }
                 }
-                return value;
+                break;
             }
             default:
                 assert(false);
@@ -340,22 +361,61 @@ template <typename Number, Number number_from_value(const std::string &what)> st
         }
     };
 
-    return recursively_evaluate_token(main_group, input, recursively_evaluate_token);
+    recursively_compile_token(main_group, recursively_compile_token);
 }
 
-static double string_to_double(const std::string &what) {
-    return std::stod(what);
-}
-
-static std::int64_t string_to_int(const std::string &what) {
-    return std::stoll(what);
-}
-
-namespace Invader::Edit {
-    double evaluate_expression(const char *expression, double input) {
-        return evaluate_expression_of_type<double, string_to_double>(expression, input);
+template <typename Number> Number Invader::Edit::CompiledExpression<Number>::evaluate(Number input) const {
+    // Only very deeply nested expressions need more than this, so this usually doesn't allocate
+    Number small_stack[32];
+    std::vector<Number> large_stack;
+    Number *stack = small_stack;
+    if(this->max_stack_size > sizeof(small_stack) / sizeof(small_stack[0])) {
+        large_stack.resize(this->max_stack_size);
+        stack = large_stack.data();
     }
-    std::int64_t evaluate_expression(const char *expression, std::int64_t input) {
-        return evaluate_expression_of_type<std::int64_t, string_to_int>(expression, input);
+
+    std::size_t top = 0;
+    for(auto &instruction : this->program) {
+        switch(instruction.type) {
+            case Instruction::Type::PUSH_NUMBER:
+                stack[top++] = instruction.number;
+                break;
+            case Instruction::Type::PUSH_INPUT:
+                stack[top++] = input * instruction.number;
+                break;
+            default: {
+                Number next_value = stack[--top];
+                Number &value = stack[top - 1];
+                switch(instruction.type) {
+                    case Instruction::Type::ADD:
+                        value += next_value;
+                        break;
+                    case Instruction::Type::SUBTRACT:
+                        value -= next_value;
+                        break;
+                    case Instruction::Type::MULTIPLY:
+                        value *= next_value;
+                        break;
+                    case Instruction::Type::DIVIDE:
+                        if(next_value == 0) {
+                            std::fputs("Division by zero!\n", stderr);
+                            throw std::exception();
+                        }
+                        value /= next_value;
+                        break;
+                    case Instruction::Type::POWER:
+                        value = std::pow(value, next_value);
+                        break;
+                    default:
+                        assert(false);
+                }
+                break;
+            }
+        }
     }
+
+    return stack[0];
 }
+
+template class Invader::Edit::CompiledExpression<double>;
+template class Invader::Edit::CompiledExpression<std::int64_t>;
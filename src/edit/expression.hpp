@@ -4,10 +4,49 @@
 #define INVADER__EDIT__EXPRESSION_HPP
 
 #include <cstdint>
+#include <vector>
 
 namespace Invader::Edit {
-    double evaluate_expression(const char *expression, double input);
-    std::int64_t evaluate_expression(const char *expression, std::int64_t input);
+    /**
+     * Expression that is parsed once so it can be evaluated for any number of inputs (n)
+     */
+    template <typename Number> class CompiledExpression {
+    public:
+        /**
+         * Compile the expression
+         * @param expression expression to compile
+         * @throws std::exception if the expression is invalid
+         */
+        CompiledExpression(const char *expression);
+
+        /**
+         * Evaluate the expression
+         * @param input value of n
+         * @return      result
+         * @throws std::exception if dividing by zero
+         */
+        Number evaluate(Number input) const;
+
+    private:
+        struct Instruction {
+            enum Type {
+                PUSH_NUMBER,
+                PUSH_INPUT, // pushes the input multiplied by the number
+                ADD,
+                SUBTRACT,
+                MULTIPLY,
+                DIVIDE,
+                POWER
+            } type;
+            Number number;
+        };
+
+        std::vector<Instruction> program;
+        std::size_t max_stack_size = 0;
+    };
+
+    extern template class CompiledExpression<double>;
+    extern template class CompiledExpression<std::int64_t>;
 }
 
 #endif
@@ -11,6 +11,8 @@
 #include <QMessageBox>
 #include <QScreen>
 #include <QGuiApplication>
+#include <QThread>
+#include <memory>
 #include "../tag_editor_window.hpp"
 #include "tag_editor_bitmap_subwindow.hpp"
 #include "tag_editor_subwindow.hpp"
@@ -18,6 +20,7 @@
 #include <invader/tag/parser/parser.hpp>
 #include <invader/bitmap/swizzle.hpp>
 #include <invader/bitmap/bitmap_encode.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/hek/class/bitmap.hpp>
 
 #define GET_PIXEL(x,y) (x + y * real_width)
@@ -166,6 +169,11 @@ namespace Invader::EditQt {
     }
 
     void TagEditorBitmapSubwindow::TagEditorBitmapSubwindow::update() {
+        // The tag may have changed, so anything we decoded is out of date
+        this->decoded_images.clear();
+        this->decoded_bitmap = std::nullopt;
+        this->decode_generation++;
+
         auto *parent_window = this->get_parent_window();
         auto *data = parent_window->get_parser_data();
         switch(parent_window->get_file().tag_fourcc) {
@@ -201,6 +209,12 @@ namespace Invader::EditQt {
         this->center_window();
     }
 
+    TagEditorBitmapSubwindow::~TagEditorBitmapSubwindow() {
+        if(this->decoder_thread) {
+            this->decoder_thread->wait();
+        }
+    }
+
     void TagEditorBitmapSubwindow::refresh_data() {
         this->mipmaps->blockSignals(true);
         this->mipmaps->setUpdatesEnabled(false);
@@ -346,39 +360,138 @@ namespace Invader::EditQt {
         return view;
     }
     
-    QGraphicsView *TagEditorBitmapSubwindow::draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::vector<std::byte> *pixel_data) {
-        // Get the dimensions of the mipmap
-        std::size_t width = static_cast<std::size_t>(bitmap_data->width);
-        std::size_t height = static_cast<std::size_t>(bitmap_data->height);
-        std::size_t depth = static_cast<std::size_t>(bitmap_data->depth);
-        std::size_t offset = bitmap_data->pixel_data_offset;
-
-        // Find the offset
-        if(mipmap > 0) {
-            offset += BitmapEncode::bitmap_data_size(width, height, depth, mipmap - 1, bitmap_data->format, bitmap_data->type);
-        }
-
-        // Recalculate pixels required with 1 depth since we're doing 1 bitmap at a time
-        static constexpr const std::size_t one = 1;
-        width = std::max(width >> mipmap, one);
-        height = std::max(height >> mipmap, one);
-        
-        auto pixels_required = BitmapEncode::bitmap_data_size(width, height, 1, 0, bitmap_data->format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
-        offset += index * pixels_required;
+    static std::size_t element_count(const Parser::BitmapData *bitmap_data, std::size_t mipmap) {
+        switch(bitmap_data->type) {
+            case HEK::BitmapDataType::BITMAP_DATA_TYPE_3D_TEXTURE:
+                return std::max(static_cast<std::size_t>(bitmap_data->depth >> mipmap), static_cast<std::size_t>(1));
+            case HEK::BitmapDataType::BITMAP_DATA_TYPE_CUBE_MAP:
+                return 6;
+            default:
+                return 1;
+        }
+    }
 
-        std::size_t pixel_count = width * height;
-        std::size_t data_remaining = pixel_data->size();
-        if(offset >= data_remaining || data_remaining - offset < pixels_required) {
-            eprintf_warn("Not enough data left for bitmap preview (%zu < %zu)", data_remaining, pixels_required);
+    bool TagEditorBitmapSubwindow::decode_images(std::size_t bitmap_index, const Parser::BitmapData *bitmap_data, const std::vector<std::byte> *pixel_data, std::size_t first_mipmap, std::size_t last_mipmap) {
+        // Only keep the selected bitmap's images around
+        if(this->decoded_bitmap != bitmap_index) {
+            this->decoded_images.clear();
+            this->decoded_bitmap = bitmap_index;
+        }
+
+        // If we're already decoding, the view is reloaded once that's done
+        if(this->decoder_thread) {
+            return false;
+        }
+
+        // Copy the data of everything we still need to decode, since the tag can change while we're decoding
+        struct DecodeJob {
+            std::pair<std::size_t, std::size_t> key;
+            HEK::BitmapDataFormat format;
+            std::vector<std::byte> data;
+            DecodedImage image;
+        };
+        auto jobs = std::make_shared<std::vector<DecodeJob>>();
+        bool data_missing = false;
+
+        for(std::size_t mipmap = first_mipmap; mipmap <= last_mipmap; mipmap++) {
+            std::size_t elements = element_count(bitmap_data, mipmap);
+            for(std::size_t index = 0; index < elements; index++) {
+                std::pair<std::size_t, std::size_t> key(mipmap, index);
+                if(this->decoded_images.find(key) != this->decoded_images.end()) {
+                    continue;
+                }
+
+                // Get the dimensions of the mipmap
+                std::size_t width = static_cast<std::size_t>(bitmap_data->width);
+                std::size_t height = static_cast<std::size_t>(bitmap_data->height);
+                std::size_t depth = static_cast<std::size_t>(bitmap_data->depth);
+                std::size_t offset = bitmap_data->pixel_data_offset;
+
+                // Find the offset
+                if(mipmap > 0) {
+                    offset += BitmapEncode::bitmap_data_size(width, height, depth, mipmap - 1, bitmap_data->format, bitmap_data->type);
+                }
+
+                // Recalculate pixels required with 1 depth since we're doing 1 bitmap at a time
+                static constexpr const std::size_t one = 1;
+                width = std::max(width >> mipmap, one);
+                height = std::max(height >> mipmap, one);
+
+                auto pixels_required = BitmapEncode::bitmap_data_size(width, height, 1, 0, bitmap_data->format, HEK::BitmapDataType::BITMAP_DATA_TYPE_2D_TEXTURE);
+                offset += index * pixels_required;
+
+                std::size_t data_remaining = pixel_data->size();
+                if(offset >= data_remaining || data_remaining - offset < pixels_required) {
+                    eprintf_warn("Not enough data left for bitmap preview (%zu < %zu)", data_remaining, pixels_required);
+                    this->decoded_images[key] = DecodedImage {};
+                    data_missing = true;
+                    continue;
+                }
+
+                const auto *bytes = pixel_data->data() + offset;
+                jobs->emplace_back(DecodeJob { key, bitmap_data->format, std::vector<std::byte>(bytes, bytes + pixels_required), DecodedImage { {}, width, height } });
+            }
+        }
+
+        if(data_missing) {
             QMessageBox(QMessageBox::Icon::Critical, "Error", "Failed to load all data.\n\nThe tag may be corrupt.", QMessageBox::Ok).exec();
+        }
+
+        if(jobs->empty()) {
+            return true;
+        }
+
+        // Show that we're working on it
+        auto *decoding_label = new QLabel("Decoding...");
+        decoding_label->setAlignment(Qt::AlignCenter);
+        this->set_images_widget(decoding_label);
+
+        this->decoder_thread = QThread::create([jobs]() {
+            // Cube maps and 3D textures have a few images per mipmap, so decode them in parallel
+            ThreadPool::shared().parallel_for(jobs->size(), [&jobs](std::size_t j) {
+                auto &job = (*jobs)[j];
+                auto &image = job.image;
+                try {
+                    image.pixels.resize(image.width * image.height, 0xFFFF00FF);
+                    BitmapEncode::encode_bitmap(job.data.data(), job.format, reinterpret_cast<std::byte *>(image.pixels.data()), HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, image.width, image.height);
+                }
+                catch(std::exception &e) {
+                    eprintf_warn("Failed to decode bitmap preview: %s", e.what());
+                    image.pixels.clear();
+                }
+                job.data = std::vector<std::byte>();
+            });
+        });
+
+        auto generation = this->decode_generation;
+        connect(this->decoder_thread, &QThread::finished, this, [this, jobs, generation, bitmap_index]() {
+            this->decoder_thread->deleteLater();
+            this->decoder_thread = nullptr;
+
+            // Keep these only if the tag and the selected bitmap are still the same
+            if(generation == this->decode_generation && this->decoded_bitmap == bitmap_index) {
+                for(auto &job : *jobs) {
+                    this->decoded_images[job.key] = std::move(job.image);
+                }
+            }
+
+            this->reload_view();
+        });
+        this->decoder_thread->start();
+
+        return false;
+    }
+
+    QGraphicsView *TagEditorBitmapSubwindow::draw_bitmap_to_widget(const DecodedImage &image, Colors mode, int scale) {
+        if(image.pixels.empty()) {
             return nullptr;
         }
 
-        // Decode bitmap
-        const auto *bytes = pixel_data->data() + offset;
-        std::vector<std::uint32_t> data(width * height);
-        std::fill(data.begin(), data.end(), 0xFFFF00FF);
-        BitmapEncode::encode_bitmap(bytes, bitmap_data->format, reinterpret_cast<std::byte *>(data.data()), HEK::BitmapDataFormat::BITMAP_DATA_FORMAT_A8R8G8B8, width, height);
+        // Copy it since the channel and scale change it
+        std::size_t width = image.width;
+        std::size_t height = image.height;
+        std::size_t pixel_count = width * height;
+        std::vector<std::uint32_t> data = image.pixels;
 
         // Scale if needed
         if(scale != 0) {
@@ -415,10 +528,13 @@ namespace Invader::EditQt {
         // Get the number of pixels we'll be dealing with
         std::size_t pixel_count = static_cast<std::size_t>(real_width) * real_height;
 
-        // Only show one channel
-        auto set_to_channel = [](std::size_t channel, std::uint32_t &input) {
-            std::uint32_t value = (input >> (24 - (channel * 8))) & 0xFF;
-            input = (value) | (value << 8) | (value << 16) | (value << 24);
+        // Only show one channel as an opaque grayscale; this is branchless so it can be vectorized
+        auto show_single_channel = [&data, &pixel_count](std::size_t channel) {
+            unsigned int shift = 24 - static_cast<unsigned int>(channel * 8);
+            for(std::size_t p = 0; p < pixel_count; p++) {
+                std::uint32_t value = (data[p] >> shift) & 0xFF;
+                data[p] = (value * 0x010101) | 0xFF000000;
+            }
         };
 
         switch(mode) {
@@ -439,28 +555,16 @@ namespace Invader::EditQt {
                 }
                 break;
             case COLOR_ALPHA:
-                for(std::size_t p = 0; p < pixel_count; p++) {
-                    set_to_channel(0, data[p]);
-                    data[p] |= 0xFF000000;
-                }
+                show_single_channel(0);
                 break;
             case COLOR_RED:
-                for(std::size_t p = 0; p < pixel_count; p++) {
-                    set_to_channel(1, data[p]);
-                    data[p] |= 0xFF000000;
-                }
+                show_single_channel(1);
                 break;
             case COLOR_GREEN:
-                for(std::size_t p = 0; p < pixel_count; p++) {
-                    set_to_channel(2, data[p]);
-                    data[p] |= 0xFF000000;
-                }
+                show_single_channel(2);
                 break;
             case COLOR_BLUE:
-                for(std::size_t p = 0; p < pixel_count; p++) {
-                    set_to_channel(3, data[p]);
-                    data[p] |= 0xFF000000;
-                }
+                show_single_channel(3);
                 break;
         }
     }
@@ -710,18 +814,28 @@ namespace Invader::EditQt {
             }
         }
 
+        // Make sure everything we're about to show is decoded first
+        if(!color_plate) {
+            std::size_t first_mipmap = mip_index_unsigned == 0 ? 0 : mip_index_unsigned - 1;
+            std::size_t last_mipmap = mip_index_unsigned == 0 ? static_cast<std::size_t>(bitmap_data->mipmap_count) : first_mipmap;
+            if(!this->decode_images(index_unsigned, bitmap_data, pixel_data, first_mipmap, last_mipmap)) {
+                return;
+            }
+        }
+
         auto *scroll_widget = new QWidget();
         auto *layout = new QVBoxLayout();
         auto color = static_cast<Colors>(this->colors->currentIndex());
         int scale = this->scale->currentIndex() - 3;
         auto *what = this;
 
-        auto make_widget = [&bitmap, &bitmap_data, &color, &scale, &pixel_data, &what, &color_plate](std::size_t mip, std::size_t index) {
+        auto make_widget = [&bitmap, &color, &scale, &what, &color_plate](std::size_t mip, std::size_t index) -> QGraphicsView * {
             if(color_plate) {
                 return what->draw_color_plate(bitmap, color, scale);
             }
             else {
-                return what->draw_bitmap_to_widget(bitmap_data, mip, index, color, scale, pixel_data);
+                auto image = what->decoded_images.find(std::pair<std::size_t, std::size_t>(mip, index));
+                return image == what->decoded_images.end() ? nullptr : what->draw_bitmap_to_widget(image->second, color, scale);
             }
         };
 
@@ -735,19 +849,7 @@ namespace Invader::EditQt {
             
             // For each mipmap?
             else {
-                switch(bitmap_data->type) {
-                    case HEK::BitmapDataType::BITMAP_DATA_TYPE_3D_TEXTURE:
-                        elements = bitmap_data->depth >> mip;
-                        if(elements == 0) {
-                            elements = 1;
-                        }
-                        break;
-                    case HEK::BitmapDataType::BITMAP_DATA_TYPE_CUBE_MAP:
-                        elements = 6;
-                        break;
-                    default:
-                        elements = 1;
-                }
+                elements = element_count(bitmap_data, mip);
             }
 
             QWidget *row = new QWidget();
@@ -782,11 +884,15 @@ namespace Invader::EditQt {
         scroll_widget->setLayout(layout);
 
         // Replace it!
+        this->set_images_widget(scroll_widget);
+    }
+
+    void TagEditorBitmapSubwindow::set_images_widget(QWidget *widget) {
         auto *old_widget = this->images->takeWidget();
         if(old_widget) {
             old_widget->deleteLater();
         }
-        this->images->setWidget(scroll_widget);
+        this->images->setWidget(widget);
     }
 
     void TagEditorBitmapSubwindow::refresh_sprite_list() {
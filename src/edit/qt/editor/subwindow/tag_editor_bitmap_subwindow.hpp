@@ -3,11 +3,17 @@
 #ifndef INVADER__EDIT__QT__TAG_EDITOR_BITMAP_SUBWINDOW_HPP
 #define INVADER__EDIT__QT__TAG_EDITOR_BITMAP_SUBWINDOW_HPP
 
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <vector>
 #include "tag_editor_subwindow.hpp"
 
 class QComboBox;
 class QScrollArea;
 class QGraphicsView;
+class QThread;
 
 namespace Invader::Parser {
     struct BitmapGroupSequence;
@@ -33,7 +39,7 @@ namespace Invader::EditQt {
          */
         TagEditorBitmapSubwindow(TagEditorWindow *parent_window);
 
-        ~TagEditorBitmapSubwindow() = default;
+        ~TagEditorBitmapSubwindow();
 
     private:
         QComboBox *mipmaps = nullptr;
@@ -58,6 +64,25 @@ namespace Invader::EditQt {
 
         std::vector<Parser::BitmapGroupSequence> *all_sequences;
 
+        // Image decoded to A8R8G8B8 (no pixels if it couldn't be decoded)
+        struct DecodedImage {
+            std::vector<std::uint32_t> pixels;
+            std::size_t width = 0;
+            std::size_t height = 0;
+        };
+
+        // Decoded images of the selected bitmap by mipmap and element (cube map face or 3D texture slice) so changing
+        // the channels, scale, or sprite doesn't need to decode anything again
+        std::map<std::pair<std::size_t, std::size_t>, DecodedImage> decoded_images;
+        std::optional<std::size_t> decoded_bitmap;
+
+        // Decoding is done on this thread; anything it decodes is discarded if the tag was updated in the meantime
+        QThread *decoder_thread = nullptr;
+        std::size_t decode_generation = 0;
+
+        bool decode_images(std::size_t bitmap_index, const Parser::BitmapData *bitmap_data, const std::vector<std::byte> *pixel_data, std::size_t first_mipmap, std::size_t last_mipmap);
+        void set_images_widget(QWidget *widget);
+
         static void set_values(TagEditorBitmapSubwindow *what, QComboBox *bitmaps, QComboBox *mipmaps, QComboBox *colors, QComboBox *scale, QComboBox *sequence, QComboBox *sprite, QScrollArea *images, std::vector<Parser::BitmapGroupSequence> *all_sequences);
         void refresh_data();
         void reload_view();
@@ -65,7 +90,7 @@ namespace Invader::EditQt {
         void generate_colors_array(bool monochrome);
 
         QGraphicsView *draw_color_plate(Parser::Bitmap *bitmap_data, Colors colors, int scale);
-        QGraphicsView *draw_bitmap_to_widget(Parser::BitmapData *bitmap_data, std::size_t mipmap, std::size_t index, Colors mode, int scale, const std::vector<std::byte> *pixel_data);
+        QGraphicsView *draw_bitmap_to_widget(const DecodedImage &image, Colors mode, int scale);
         void highlight_sprite(std::uint32_t *data, std::size_t real_width, std::size_t real_height);
         void show_channel(std::uint32_t *data, std::size_t real_width, std::size_t real_height, Colors mode);
         void scale_bitmap(int scale, std::size_t &real_width, std::size_t &real_height, std::size_t &pixel_count, std::vector<std::uint32_t> &data);
@@ -292,55 +292,120 @@ namespace Invader::EditQt {
             permutations_to_play.emplace_back(all_permutations.value()[permutation_unsigned - 1]);
         }
 
-        auto &permutations = this->get_pitch_range()->permutations;
-        std::vector<std::byte> pcm;
-
-        auto add_to_pcm = [&pcm](const SoundReader::Sound &what) {
-            std::vector<std::byte> new_pcm;
-            const auto *pcm_data = &what.pcm;
-            if(what.bits_per_sample != CONVERSION_BITS_PER_SAMPLE) {
-                new_pcm = SoundEncoder::convert_int_to_int(what.pcm, what.bits_per_sample, CONVERSION_BITS_PER_SAMPLE);
-                pcm_data = &new_pcm;
-            }
-            pcm.insert(pcm.end(), pcm_data->begin(), pcm_data->end());
+        // Copy what we're decoding, since the tag can change while we're decoding it
+        struct PermutationToDecode {
+            HEK::SoundFormat format;
+            std::vector<std::byte> samples;
         };
-
-        // Do it!
+        std::vector<PermutationToDecode> to_decode;
+        auto &permutations = this->get_pitch_range()->permutations;
         for(auto p : permutations_to_play) {
             auto &permutation = permutations[p];
-            auto *sound_data = permutation.samples.data();
-            auto sound_size = permutation.samples.size();
-            try {
-                switch(permutation.format) {
-                    case HEK::SoundFormat::SOUND_FORMAT_16_BIT_PCM:
-                        add_to_pcm(SoundReader::sound_from_16_bit_pcm_big_endian(sound_data, sound_size, this->channel_count, this->sample_rate));
-                        break;
-                    case HEK::SoundFormat::SOUND_FORMAT_OGG_VORBIS:
-                        add_to_pcm(SoundReader::sound_from_ogg(sound_data, sound_size));
-                        break;
-                    case HEK::SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
-                        add_to_pcm(SoundReader::sound_from_xbox_adpcm(sound_data, sound_size, this->channel_count, this->sample_rate));
-                        break;
-                    default:
-                        return;
-                }
-            }
-            catch(Invader::InvalidInputSoundException &) {
-                pcm.clear();
-                QMessageBox(QMessageBox::Icon::Critical, "Error", "Failed to load all data.\n\nThe tag may be corrupt.", QMessageBox::Ok).exec();
-            }
+            to_decode.emplace_back(PermutationToDecode { permutation.format, permutation.samples });
         }
-        
-        this->all_pcm = pcm;
+
+        // Stop whatever we were decoding before
+        this->stop_decoding();
+        this->pcm_mutex.lock();
+        this->all_pcm.clear();
+        this->pcm_mutex.unlock();
+
         this->sample = 0;
         this->slider->blockSignals(true);
         this->slider->setValue(0);
         this->sample_granularity = this->channel_count * (CONVERSION_BITS_PER_SAMPLE / 8);
-        this->slider->setMaximum(this->all_pcm.size() / this->sample_granularity);
         this->slider->blockSignals(false);
-        this->update_time_label();
+        this->update_length();
 
         this->stop_sound();
+
+        // Decode each permutation in the background so we can start playing once the first one is decoded
+        this->decoding = true;
+        this->cancel_decoding = false;
+        auto generation = ++this->decode_generation;
+        this->decoder_thread = std::thread([this, to_decode = std::move(to_decode), generation, channel_count = this->channel_count, sample_rate = this->sample_rate]() {
+            for(auto &permutation : to_decode) {
+                if(this->cancel_decoding) {
+                    break;
+                }
+
+                auto *sound_data = permutation.samples.data();
+                auto sound_size = permutation.samples.size();
+                SoundReader::Sound sound;
+                try {
+                    switch(permutation.format) {
+                        case HEK::SoundFormat::SOUND_FORMAT_16_BIT_PCM:
+                            sound = SoundReader::sound_from_16_bit_pcm_big_endian(sound_data, sound_size, channel_count, sample_rate);
+                            break;
+                        case HEK::SoundFormat::SOUND_FORMAT_OGG_VORBIS:
+                            sound = SoundReader::sound_from_ogg(sound_data, sound_size);
+                            break;
+                        case HEK::SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
+                            // Add each piece as it's decoded so it can start playing sooner (this is already 16-bit)
+                            SoundReader::stream_from_xbox_adpcm(sound_data, sound_size, channel_count, [this](const std::byte *pcm, std::size_t pcm_size) {
+                                this->pcm_mutex.lock();
+                                this->all_pcm.insert(this->all_pcm.end(), pcm, pcm + pcm_size);
+                                this->pcm_mutex.unlock();
+                                QMetaObject::invokeMethod(this, &TagEditorSoundSubwindow::update_length, Qt::QueuedConnection);
+                                return !this->cancel_decoding;
+                            });
+                            continue;
+                        default:
+                            this->decoding = false;
+                            return;
+                    }
+                }
+                catch(Invader::InvalidInputSoundException &) {
+                    // Throw out everything (on the UI thread, since it may be playing)
+                    QMetaObject::invokeMethod(this, [this, generation]() {
+                        if(generation != this->decode_generation) {
+                            return;
+                        }
+                        this->pcm_mutex.lock();
+                        this->all_pcm.clear();
+                        this->pcm_mutex.unlock();
+                        this->sample = 0;
+                        this->stop_sound();
+                        this->update_length();
+                        QMessageBox(QMessageBox::Icon::Critical, "Error", "Failed to load all data.\n\nThe tag may be corrupt.", QMessageBox::Ok).exec();
+                    }, Qt::QueuedConnection);
+                    break;
+                }
+
+                std::vector<std::byte> new_pcm;
+                const auto *pcm_data = &sound.pcm;
+                if(sound.bits_per_sample != CONVERSION_BITS_PER_SAMPLE) {
+                    new_pcm = SoundEncoder::convert_int_to_int(sound.pcm, sound.bits_per_sample, CONVERSION_BITS_PER_SAMPLE);
+                    pcm_data = &new_pcm;
+                }
+
+                this->pcm_mutex.lock();
+                this->all_pcm.insert(this->all_pcm.end(), pcm_data->begin(), pcm_data->end());
+                this->pcm_mutex.unlock();
+                QMetaObject::invokeMethod(this, &TagEditorSoundSubwindow::update_length, Qt::QueuedConnection);
+            }
+
+            this->decoding = false;
+        });
+    }
+
+    void TagEditorSoundSubwindow::stop_decoding() {
+        this->cancel_decoding = true;
+        if(this->decoder_thread.joinable()) {
+            this->decoder_thread.join();
+        }
+        this->decoding = false;
+    }
+
+    void TagEditorSoundSubwindow::update_length() {
+        this->pcm_mutex.lock();
+        std::size_t size = this->all_pcm.size();
+        this->pcm_mutex.unlock();
+
+        this->slider->blockSignals(true);
+        this->slider->setMaximum(size / this->sample_granularity);
+        this->slider->blockSignals(false);
+        this->update_time_label();
     }
 
     Parser::SoundPitchRange *TagEditorSoundSubwindow::get_pitch_range() noexcept {
@@ -371,9 +436,11 @@ namespace Invader::EditQt {
     void TagEditorSoundSubwindow::play_sound() {
         this->stop_button->setEnabled(true);
         this->play_button->setEnabled(false);
-        if(this->sample >= this->all_pcm.size()) {
+        this->pcm_mutex.lock();
+        if(this->sample >= this->all_pcm.size() && !this->decoding) {
             this->sample = 0;
         }
+        this->pcm_mutex.unlock();
         this->update_time_label();
         SDL_PauseAudioDevice(this->sdl_audio_device_id, 0);
         this->sample_timer.start(1);
@@ -386,11 +453,12 @@ namespace Invader::EditQt {
     }
 
     void TagEditorSoundSubwindow::play_sample() {
-        const auto *data = this->all_pcm.data();
+        this->pcm_mutex.lock();
         auto end = this->all_pcm.size();
+        this->pcm_mutex.unlock();
         
         // If we're done, stop
-        if(end == 0) {
+        if(end == 0 && !this->decoding) {
             this->stop_sound();
             return;
         }
@@ -414,7 +482,21 @@ namespace Invader::EditQt {
             }
             
             // Have we reached the end?
-            if(this->sample == end) {
+            if(this->sample >= end) {
+                // See if more was decoded (check if we're decoding first so we don't miss anything decoded after)
+                bool still_decoding = this->decoding;
+                this->pcm_mutex.lock();
+                end = this->all_pcm.size();
+                this->pcm_mutex.unlock();
+                if(this->sample < end) {
+                    continue;
+                }
+
+                // Wait for it
+                if(still_decoding) {
+                    break;
+                }
+
                 // Loop!
                 if(play_in_loop) {
                     this->sample = 0;
@@ -457,10 +539,11 @@ namespace Invader::EditQt {
             
             // No audio left. We have to get more
             else {
-                auto *cursor = data + this->sample;
                 auto remainder = std::min(end - this->sample, static_cast<std::size_t>(512));
-                
-                int result = SDL_AudioStreamPut(this->stream, cursor, remainder);
+
+                this->pcm_mutex.lock();
+                int result = SDL_AudioStreamPut(this->stream, this->all_pcm.data() + this->sample, remainder);
+                this->pcm_mutex.unlock();
                 if(result != 0) {
                     std::printf("%zu %zu\n", this->sample, remainder);
                     
@@ -500,7 +583,9 @@ namespace Invader::EditQt {
         std::size_t seconds = centiseconds / 100;
         std::size_t minutes = seconds / 60;
 
+        this->pcm_mutex.lock();
         std::size_t total_centiseconds = (this->all_pcm.size() / this->sample_granularity * 100) / this->sample_rate;
+        this->pcm_mutex.unlock();
         std::size_t total_seconds = total_centiseconds / 100;
         std::size_t total_minutes = total_seconds / 60;
 
@@ -509,6 +594,8 @@ namespace Invader::EditQt {
     }
     
     TagEditorSoundSubwindow::~TagEditorSoundSubwindow() {
+        this->stop_decoding();
+
         if(this->stream) {
             SDL_FreeAudioStream(this->stream);
             this->stream = nullptr;
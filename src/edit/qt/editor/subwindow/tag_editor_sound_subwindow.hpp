@@ -3,7 +3,11 @@
 #ifndef INVADER__EDIT__QT__TAG_EDITOR_SOUND_SUBWINDOW_HPP
 #define INVADER__EDIT__QT__TAG_EDITOR_SOUND_SUBWINDOW_HPP
 
+#include <atomic>
+#include <mutex>
 #include <optional>
+#include <thread>
+#include <vector>
 #include <QTimer>
 
 #include <SDL2/SDL.h>
@@ -65,7 +69,13 @@ namespace Invader::EditQt {
         std::uint32_t channel_count;
         std::vector<std::byte> silence;
 
+        // Permutations are decoded into all_pcm on decoder_thread while it plays, so it's guarded by pcm_mutex
         std::vector<std::byte> all_pcm;
+        std::mutex pcm_mutex;
+        std::thread decoder_thread;
+        std::atomic<bool> decoding = false;
+        std::atomic<bool> cancel_decoding = false;
+        std::size_t decode_generation = 0;
         std::size_t sample = 0;
         std::uint32_t sample_granularity = 0;
 
@@ -88,6 +98,8 @@ namespace Invader::EditQt {
         void play_sample();
         void change_sample();
         void update_time_label();
+        void update_length();
+        void stop_decoding();
         void update_pitch_range_permutations();
 
         void closeEvent(QCloseEvent *) override;
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include "tag_editor_cache.hpp"
+
+namespace Invader::EditQt {
+    std::optional<TagEditorCache::Tag> TagEditorCache::open(const std::filesystem::path &path) {
+        std::error_code ec;
+        auto modified = std::filesystem::last_write_time(path, ec);
+
+        // Use what we have if the file wasn't touched since
+        auto cached = this->entries.find(path);
+        if(cached != this->entries.end()) {
+            if(!ec && cached->second.modified == modified) {
+                cached->second.last_used = ++this->use_counter;
+                return cached->second.tag;
+            }
+            this->entries.erase(cached);
+        }
+
+        auto file_data = File::MemoryMappedFile::map_file(path);
+        if(!file_data.has_value()) {
+            return std::nullopt;
+        }
+
+        Tag tag;
+        tag.data = std::shared_ptr<Parser::ParserStruct>(Parser::ParserStruct::parse_hek_tag_file(file_data->data(), file_data->size(), false));
+        tag.hash = FNV1AHash::hash_bytes(file_data->data(), file_data->size());
+
+        // If we couldn't get the modified time, we can't tell if it's stale later, so don't keep it
+        if(!ec) {
+            this->entries.emplace(path, Entry { tag, modified, ++this->use_counter });
+            this->evict_unused();
+        }
+
+        return tag;
+    }
+
+    void TagEditorCache::saved(const std::filesystem::path &path, const std::shared_ptr<Parser::ParserStruct> &data, std::uint64_t hash) {
+        // It may have been saved somewhere else, so the old path no longer matches what's on disk
+        for(auto e = this->entries.begin(); e != this->entries.end();) {
+            if(e->second.tag.data == data) {
+                e = this->entries.erase(e);
+            }
+            else {
+                e++;
+            }
+        }
+
+        std::error_code ec;
+        auto modified = std::filesystem::last_write_time(path, ec);
+        if(ec) {
+            this->entries.erase(path);
+            return;
+        }
+        this->entries.insert_or_assign(path, Entry { Tag { data, hash }, modified, ++this->use_counter });
+    }
+
+    void TagEditorCache::invalidate(const std::filesystem::path &path) {
+        this->entries.erase(path);
+    }
+
+    void TagEditorCache::invalidate_directory(const std::filesystem::path &directory) {
+        for(auto e = this->entries.begin(); e != this->entries.end();) {
+            std::error_code ec;
+            if(e->first.parent_path() == directory && (std::filesystem::last_write_time(e->first, ec) != e->second.modified || ec)) {
+                e = this->entries.erase(e);
+            }
+            else {
+                e++;
+            }
+        }
+    }
+
+    void TagEditorCache::evict_unused() {
+        std::vector<decltype(this->entries)::iterator> unused;
+        for(auto e = this->entries.begin(); e != this->entries.end(); e++) {
+            if(e->second.tag.data.use_count() == 1) {
+                unused.emplace_back(e);
+            }
+        }
+
+        if(unused.size() <= MAX_UNUSED_ENTRIES) {
+            return;
+        }
+
+        std::sort(unused.begin(), unused.end(), [](auto &a, auto &b) { return a->second.last_used < b->second.last_used; });
+        for(std::size_t i = 0; i < unused.size() - MAX_UNUSED_ENTRIES; i++) {
+            this->entries.erase(unused[i]);
+        }
+    }
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__EDIT__QT__TAG_EDITOR_CACHE_HPP
+#define INVADER__EDIT__QT__TAG_EDITOR_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <invader/tag/parser/parser_struct.hpp>
+
+namespace Invader::EditQt {
+    /**
+     * Parsed tags shared by every editor window.
+     *
+     * A tag is parsed once and handed out to whoever opens it. Tags nobody is using anymore are kept around for a bit
+     * so that going back to them (such as when following dependencies back and forth) doesn't parse them again.
+     */
+    class TagEditorCache {
+    public:
+        struct Tag {
+            /** Parsed tag; this is shared, so changes to it are seen by everyone holding it */
+            std::shared_ptr<Parser::ParserStruct> data;
+
+            /** Hash of the tag file as it was last read or saved */
+            std::uint64_t hash;
+        };
+
+        /**
+         * Get the parsed tag at the given path, parsing it if it isn't cached or was modified since it was cached
+         * @param path path to the tag file
+         * @return     tag, or std::nullopt if the file could not be read
+         * @throws     if the tag could not be parsed
+         */
+        std::optional<Tag> open(const std::filesystem::path &path);
+
+        /**
+         * Record that the given tag was saved to the path, replacing anything else cached there
+         * @param path path the tag was saved to
+         * @param data parsed tag
+         * @param hash hash of the saved file
+         */
+        void saved(const std::filesystem::path &path, const std::shared_ptr<Parser::ParserStruct> &data, std::uint64_t hash);
+
+        /**
+         * Stop caching the tag at the given path. Anyone still holding it keeps their copy.
+         * @param path path to the tag file
+         */
+        void invalidate(const std::filesystem::path &path);
+
+        /**
+         * Stop caching tags directly in the given directory that were removed or modified since they were cached
+         * @param directory directory that changed
+         */
+        void invalidate_directory(const std::filesystem::path &directory);
+
+    private:
+        struct Entry {
+            Tag tag;
+            std::filesystem::file_time_type modified;
+            std::uint64_t last_used;
+        };
+
+        // Tags only held by the cache are thrown away past this, least recently used first
+        static constexpr std::size_t MAX_UNUSED_ENTRIES = 32;
+
+        std::map<std::filesystem::path, Entry> entries;
+        std::uint64_t use_counter = 0;
+
+        void evict_unused();
+    };
+}
+
+#endif
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "tag_editor_history.hpp"
+
+namespace Invader::EditQt {
+    TagEditorHistory::ValueState TagEditorHistory::capture(const Parser::ParserStructValue &value) {
+        ValueState state;
+
+        switch(value.get_type()) {
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGSTRING:
+                state.string = value.get_string();
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_ENUM:
+                state.string = value.read_enum();
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_BITMASK:
+                for(auto *flag : value.list_enum()) {
+                    state.flags.emplace_back(value.read_bitfield(flag));
+                }
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY: {
+                auto &dependency = value.get_dependency();
+                state.fourcc = dependency.tag_fourcc;
+                state.string = dependency.path;
+                break;
+            }
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGDATAOFFSET:
+                state.data = value.get_data();
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE: {
+                auto &array = const_cast<Parser::ParserStructValue &>(value);
+                std::size_t count = array.get_array_size();
+                state.elements.reserve(count);
+                for(std::size_t i = 0; i < count; i++) {
+                    state.elements.emplace_back(capture(array.get_object_in_array(i)));
+                }
+                break;
+            }
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGID:
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_GROUP_START:
+                break;
+            default:
+                state.numbers = value.get_values();
+                break;
+        }
+
+        return state;
+    }
+
+    std::vector<TagEditorHistory::ValueState> TagEditorHistory::capture(Parser::ParserStruct &parser_struct) {
+        std::vector<ValueState> state;
+        for(auto &value : parser_struct.get_values()) {
+            state.emplace_back(capture(value));
+        }
+        return state;
+    }
+
+    void TagEditorHistory::restore(Parser::ParserStructValue &value, const ValueState &state) {
+        switch(value.get_type()) {
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGSTRING:
+                value.set_string(state.string.c_str());
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_ENUM:
+                value.write_enum(state.string.c_str());
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_BITMASK: {
+                auto flags = value.list_enum();
+                for(std::size_t i = 0; i < flags.size() && i < state.flags.size(); i++) {
+                    value.write_bitfield(flags[i], state.flags[i]);
+                }
+                break;
+            }
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_DEPENDENCY: {
+                auto &dependency = value.get_dependency();
+                dependency.tag_fourcc = state.fourcc;
+                dependency.path = state.string;
+                break;
+            }
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGDATAOFFSET:
+                value.get_data() = state.data;
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE:
+                value.delete_objects_in_array(0, value.get_array_size());
+                value.insert_objects_in_array(0, state.elements.size());
+                for(std::size_t i = 0; i < state.elements.size(); i++) {
+                    restore(value.get_object_in_array(i), state.elements[i]);
+                }
+                break;
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGID:
+            case Parser::ParserStructValue::ValueType::VALUE_TYPE_GROUP_START:
+                break;
+            default:
+                value.set_values(state.numbers);
+                break;
+        }
+    }
+
+    void TagEditorHistory::restore(Parser::ParserStruct &parser_struct, const std::vector<ValueState> &state) {
+        auto values = parser_struct.get_values();
+        for(std::size_t i = 0; i < values.size() && i < state.size(); i++) {
+            restore(values[i], state[i]);
+        }
+    }
+
+    std::optional<Parser::ParserStructValue> TagEditorHistory::resolve(Parser::ParserStruct &root, const ValuePath &path) {
+        auto find_member = [](Parser::ParserStruct &parser_struct, const std::string &member_name) -> std::optional<Parser::ParserStructValue> {
+            for(auto &value : parser_struct.get_values()) {
+                auto *value_member_name = value.get_member_name();
+                if(value_member_name && member_name == value_member_name) {
+                    return value;
+                }
+            }
+            return std::nullopt;
+        };
+
+        auto *parser_struct = &root;
+        for(auto &[member_name, index] : path.elements) {
+            auto array = find_member(*parser_struct, member_name);
+            if(!array.has_value() || array->get_type() != Parser::ParserStructValue::ValueType::VALUE_TYPE_REFLEXIVE || index >= array->get_array_size()) {
+                return std::nullopt;
+            }
+            parser_struct = &array->get_object_in_array(index);
+        }
+
+        return find_member(*parser_struct, path.member_name);
+    }
+
+    TagEditorHistory::Change TagEditorHistory::set_change(const ValuePath &path, ValueState before, ValueState after) {
+        Change change = {};
+        change.type = Change::Type::CHANGE_TYPE_SET;
+        change.path = path;
+        change.before = std::move(before);
+        change.after = std::move(after);
+        return change;
+    }
+
+    TagEditorHistory::Change TagEditorHistory::array_change(Change::Type type, const ValuePath &path, Parser::ParserStructValue &value, std::size_t index, std::size_t count, std::size_t index_to) {
+        Change change = {};
+        change.type = type;
+        change.path = path;
+        change.index = index;
+        change.index_to = index_to;
+        change.count = count;
+        if(type == Change::Type::CHANGE_TYPE_DELETE) {
+            change.removed.reserve(count);
+            for(std::size_t i = index; i < index + count; i++) {
+                change.removed.emplace_back(capture(value.get_object_in_array(i)));
+            }
+        }
+        return change;
+    }
+
+    void TagEditorHistory::push(std::vector<Change> step) {
+        if(step.empty()) {
+            return;
+        }
+        this->redo_steps.clear();
+
+        // Typing into a field changes it once per keystroke; keep that as one step
+        if(step.size() == 1 && step[0].type == Change::Type::CHANGE_TYPE_SET && !this->undo_steps.empty()) {
+            auto &last = this->undo_steps.back();
+            if(last.changes.size() == 1 && last.changes[0].type == Change::Type::CHANGE_TYPE_SET && last.changes[0].path == step[0].path) {
+                last.changes[0].after = std::move(step[0].after);
+                last.id = this->next_id++;
+                return;
+            }
+        }
+
+        this->undo_steps.emplace_back(Step { std::move(step), this->next_id++ });
+        if(this->undo_steps.size() > MAX_STEPS) {
+            this->undo_steps.pop_front();
+        }
+    }
+
+    bool TagEditorHistory::undo(Parser::ParserStruct &root) {
+        if(this->undo_steps.empty()) {
+            return false;
+        }
+
+        auto step = std::move(this->undo_steps.back());
+        this->undo_steps.pop_back();
+        for(auto c = step.changes.rbegin(); c != step.changes.rend(); c++) {
+            apply(root, *c, false);
+        }
+        this->redo_steps.emplace_back(std::move(step));
+        return true;
+    }
+
+    bool TagEditorHistory::redo(Parser::ParserStruct &root) {
+        if(this->redo_steps.empty()) {
+            return false;
+        }
+
+        auto step = std::move(this->redo_steps.back());
+        this->redo_steps.pop_back();
+        for(auto &c : step.changes) {
+            apply(root, c, true);
+        }
+        this->undo_steps.emplace_back(std::move(step));
+        return true;
+    }
+
+    void TagEditorHistory::apply(Parser::ParserStruct &root, const Change &change, bool forward) {
+        auto value = resolve(root, change.path);
+        if(!value.has_value()) {
+            return;
+        }
+
+        switch(change.type) {
+            case Change::Type::CHANGE_TYPE_SET:
+                restore(*value, forward ? change.after : change.before);
+                break;
+            case Change::Type::CHANGE_TYPE_INSERT:
+                if(forward) {
+                    value->insert_objects_in_array(change.index, change.count);
+                }
+                else {
+                    value->delete_objects_in_array(change.index, change.count);
+                }
+                break;
+            case Change::Type::CHANGE_TYPE_DELETE:
+                if(forward) {
+                    value->delete_objects_in_array(change.index, change.count);
+                }
+                else {
+                    value->insert_objects_in_array(change.index, change.count);
+                    for(std::size_t i = 0; i < change.count; i++) {
+                        restore(value->get_object_in_array(change.index + i), change.removed[i]);
+                    }
+                }
+                break;
+            case Change::Type::CHANGE_TYPE_DUPLICATE:
+                if(forward) {
+                    value->duplicate_objects_in_array(change.index, change.index_to, change.count);
+                }
+                else {
+                    value->delete_objects_in_array(change.index_to, change.count);
+                }
+                break;
+            case Change::Type::CHANGE_TYPE_SWAP:
+                value->swap_objects_in_array(change.index, change.index_to, change.count);
+                break;
+        }
+    }
+}
@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__EDIT__QT__TAG_EDITOR_HISTORY_HPP
+#define INVADER__EDIT__QT__TAG_EDITOR_HISTORY_HPP
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+#include <invader/tag/parser/parser_struct.hpp>
+
+namespace Invader::EditQt {
+    /**
+     * Undo/redo history of a tag.
+     *
+     * Each step only holds the values that were changed and the array elements that were removed, so editing a large
+     * tag never copies the whole tag.
+     */
+    class TagEditorHistory {
+    public:
+        /** Contents of a value. For arrays, this includes the contents of every element. */
+        struct ValueState {
+            std::vector<Parser::ParserStructValue::Number> numbers;
+            std::string string; // tag string, enum, or dependency path
+            TagFourCC fourcc = TagFourCC::TAG_FOURCC_NULL;
+            std::vector<bool> flags;
+            std::vector<std::byte> data;
+            std::vector<std::vector<ValueState>> elements;
+
+            bool operator==(const ValueState &other) const = default;
+        };
+
+        /** Location of a value: the arrays and element indices leading to it, followed by its member name */
+        struct ValuePath {
+            std::vector<std::pair<std::string, std::size_t>> elements;
+            std::string member_name;
+
+            bool operator==(const ValuePath &other) const = default;
+        };
+
+        struct Change {
+            enum Type {
+                CHANGE_TYPE_SET,
+                CHANGE_TYPE_INSERT,
+                CHANGE_TYPE_DELETE,
+                CHANGE_TYPE_DUPLICATE,
+                CHANGE_TYPE_SWAP
+            } type;
+
+            /** Value that was changed */
+            ValuePath path;
+
+            /** Contents before and after a CHANGE_TYPE_SET */
+            ValueState before, after;
+
+            /** Array range that was changed; index_to is used for CHANGE_TYPE_DUPLICATE and CHANGE_TYPE_SWAP */
+            std::size_t index = 0, index_to = 0, count = 0;
+
+            /** Elements removed by a CHANGE_TYPE_DELETE */
+            std::vector<std::vector<ValueState>> removed;
+        };
+
+        /**
+         * Copy the contents of a value
+         * @param value value to copy
+         * @return      contents
+         */
+        static ValueState capture(const Parser::ParserStructValue &value);
+
+        /**
+         * Copy the contents of every value in a struct
+         * @param parser_struct struct to copy
+         * @return              contents
+         */
+        static std::vector<ValueState> capture(Parser::ParserStruct &parser_struct);
+
+        /**
+         * Find a value in a tag
+         * @param root tag
+         * @param path path to the value
+         * @return     value, or std::nullopt if it doesn't exist
+         */
+        static std::optional<Parser::ParserStructValue> resolve(Parser::ParserStruct &root, const ValuePath &path);
+
+        /**
+         * Make a change to change the value at the given path from before to after
+         */
+        static Change set_change(const ValuePath &path, ValueState before, ValueState after);
+
+        /**
+         * Make a change to insert, delete, duplicate, or swap array elements. For deletions, the elements are copied
+         * from value, so this must be called before deleting them.
+         */
+        static Change array_change(Change::Type type, const ValuePath &path, Parser::ParserStructValue &value, std::size_t index, std::size_t count, std::size_t index_to = 0);
+
+        /**
+         * Add a step that was just done. Consecutive changes to the same value are merged into one step.
+         * @param step changes done, in order
+         */
+        void push(std::vector<Change> step);
+
+        /**
+         * Undo the last step
+         * @param root tag to undo on
+         * @return     true if something was undone
+         */
+        bool undo(Parser::ParserStruct &root);
+
+        /**
+         * Redo the last undone step
+         * @param root tag to redo on
+         * @return     true if something was redone
+         */
+        bool redo(Parser::ParserStruct &root);
+
+        bool can_undo() const noexcept {
+            return !this->undo_steps.empty();
+        }
+
+        bool can_redo() const noexcept {
+            return !this->redo_steps.empty();
+        }
+
+        /**
+         * Get an ID for the current state. This changes whenever a step is pushed, undone, or redone, and returns to
+         * the same value if the tag is brought back to the same state.
+         * @return state ID
+         */
+        std::uint64_t state_id() const noexcept {
+            return this->undo_steps.empty() ? 0 : this->undo_steps.back().id;
+        }
+
+    private:
+        struct Step {
+            std::vector<Change> changes;
+            std::uint64_t id;
+        };
+
+        // Oldest steps are thrown away past this
+        static constexpr std::size_t MAX_STEPS = 1000;
+
+        std::deque<Step> undo_steps;
+        std::vector<Step> redo_steps;
+        std::uint64_t next_id = 1;
+
+        static void restore(Parser::ParserStructValue &value, const ValueState &state);
+        static void restore(Parser::ParserStruct &parser_struct, const std::vector<ValueState> &state);
+        static void apply(Parser::ParserStruct &root, const Change &change, bool forward);
+    };
+}
+
+#endif
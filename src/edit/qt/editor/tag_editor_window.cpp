@@ -12,8 +12,12 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFrame>
+#include <QTimer>
+#include <algorithm>
 #include <filesystem>
+#include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include "../tree/tag_tree_window.hpp"
 #include "widget/tag_editor_widget.hpp"
@@ -43,36 +47,40 @@ namespace Invader::EditQt {
         // If we're loading an existing tag, open it and parse it
         if(tag_file.tag_path.size() != 0) {
             this->make_dirty(false);
-            auto open_file = File::open_file(tag_file.full_path);
-            if(!open_file.has_value()) {
+            std::optional<TagEditorCache::Tag> open_file;
+            try {
+                open_file = parent_window->get_tag_cache().open(tag_file.full_path);
+            }
+            catch(std::exception &e) {
                 char formatted_error[1024];
-                std::snprintf(formatted_error, sizeof(formatted_error), "Failed to open %s.\n\nMake sure it exists and you have permission to open it.", tag_file.full_path.string().c_str());
+                std::snprintf(formatted_error, sizeof(formatted_error), "Failed to open %s due to an exception error:\n\n%s", tag_file.full_path.string().c_str(), e.what());
                 QMessageBox(QMessageBox::Icon::Critical, "Error", formatted_error, QMessageBox::Ok).exec();
                 this->close();
                 return;
             }
-            try {
-                this->parser_data = Parser::ParserStruct::parse_hek_tag_file(open_file->data(), open_file->size(), false).release();
-            }
-            catch(std::exception &e) {
+            if(!open_file.has_value()) {
                 char formatted_error[1024];
-                std::snprintf(formatted_error, sizeof(formatted_error), "Failed to open %s due to an exception error:\n\n%s", tag_file.full_path.string().c_str(), e.what());
+                std::snprintf(formatted_error, sizeof(formatted_error), "Failed to open %s.\n\nMake sure it exists and you have permission to open it.", tag_file.full_path.string().c_str());
                 QMessageBox(QMessageBox::Icon::Critical, "Error", formatted_error, QMessageBox::Ok).exec();
                 this->close();
                 return;
             }
+            this->parser_data = std::move(open_file->data);
 
             if(this->parser_data->check_for_broken_enums(false)) {
+                parent_window->get_tag_cache().invalidate(tag_file.full_path);
                 char formatted_error[1024];
                 std::snprintf(formatted_error, sizeof(formatted_error), "Failed to parse %s due to enumerators being out-of-bounds.\n\nThe tag appears to be corrupt.", tag_file.full_path.string().c_str());
                 QMessageBox(QMessageBox::Icon::Critical, "Error", formatted_error, QMessageBox::Ok).exec();
                 this->close();
                 return;
             }
+
+            this->saved_hash = open_file->hash;
         }
         else {
             this->make_dirty(true);
-            this->parser_data = Parser::ParserStruct::generate_base_struct(tag_file.tag_fourcc).release();
+            this->parser_data = Parser::ParserStruct::generate_base_struct(tag_file.tag_fourcc);
             if(!this->parser_data) {
                 char formatted_error[1024];
                 std::snprintf(formatted_error, sizeof(formatted_error), "Failed to create a %s.", tag_fourcc_to_extension(tag_file.tag_fourcc));
@@ -107,10 +115,24 @@ namespace Invader::EditQt {
         close->setIcon(QIcon::fromTheme(QStringLiteral("document-close")));
         connect(close, &QAction::triggered, this, &TagEditorWindow::close);
 
+        // Edit menu
+        auto *edit_menu = bar->addMenu("Edit");
+
+        this->undo_action = edit_menu->addAction("Undo");
+        this->undo_action->setIcon(QIcon::fromTheme(QStringLiteral("edit-undo")));
+        this->undo_action->setShortcut(QKeySequence::Undo);
+        this->undo_action->setEnabled(false);
+        connect(this->undo_action, &QAction::triggered, this, &TagEditorWindow::perform_undo);
+
+        this->redo_action = edit_menu->addAction("Redo");
+        this->redo_action->setIcon(QIcon::fromTheme(QStringLiteral("edit-redo")));
+        this->redo_action->setShortcut(QKeySequence::Redo);
+        this->redo_action->setEnabled(false);
+        connect(this->redo_action, &QAction::triggered, this, &TagEditorWindow::perform_redo);
+
         int min_height = this->minimumSizeHint().height();
 
         // Add another widget to our view?
-        QFrame *extra_widget_panel = nullptr;
         QPushButton *extra_widget;
         switch(tag_file.tag_fourcc) {
             case TagFourCC::TAG_FOURCC_BITMAP:
@@ -156,9 +178,9 @@ namespace Invader::EditQt {
                 break;
         }
         if(extra_widget) {
-            extra_widget_panel = new QFrame();
+            this->extra_widget_panel = new QFrame();
             QHBoxLayout *extra_layout = new QHBoxLayout();
-            extra_widget_panel->setLayout(extra_layout);
+            this->extra_widget_panel->setLayout(extra_layout);
             extra_layout->addWidget(extra_widget);
             extra_layout->setContentsMargins(4, 4, 4, 4);
             connect(extra_widget, &QPushButton::clicked, this, &TagEditorWindow::show_subwindow);
@@ -168,7 +190,7 @@ namespace Invader::EditQt {
         auto values = std::vector<Parser::ParserStructValue>(this->parser_data->get_values());
         this->scroll_widget = new QScrollArea();
         this->setCentralWidget(this->scroll_widget);
-        this->main_widget = new TagEditorEditWidgetView(nullptr, values, this, true, extra_widget_panel);
+        this->main_widget = new TagEditorEditWidgetView(nullptr, values, this, true, this->extra_widget_panel);
         this->scroll_widget->setWidget(this->main_widget);
 
         // Goto menu (goto top level reflexives)
@@ -213,9 +235,92 @@ namespace Invader::EditQt {
             )
         );
 
+        // Save modified tags periodically if asked to
+        if(auto interval = parent_window->autosave_interval(); interval > 0) {
+            this->autosave_timer = new QTimer(this);
+            this->autosave_timer->setInterval(static_cast<int>(std::min(interval, 2000000U)) * 1000);
+            connect(this->autosave_timer, &QTimer::timeout, this, &TagEditorWindow::perform_autosave);
+            this->autosave_timer->start();
+        }
+
         // We did it!
         this->successfully_opened = true;
     }
+
+    void TagEditorWindow::value_changed(std::vector<TagEditorHistory::Change> changes) {
+        if(changes.empty()) {
+            return;
+        }
+        this->history.push(std::move(changes));
+        this->update_dirty();
+    }
+
+    void TagEditorWindow::update_dirty() {
+        // Undoing back to the saved state means there is nothing left to save
+        this->make_dirty(this->file.tag_path.empty() || this->history.state_id() != this->saved_state_id);
+        this->undo_action->setEnabled(this->history.can_undo());
+        this->redo_action->setEnabled(this->history.can_redo());
+    }
+
+    void TagEditorWindow::perform_undo() {
+        if(this->history.undo(*this->parser_data)) {
+            this->refresh_view();
+            this->update_dirty();
+        }
+    }
+
+    void TagEditorWindow::perform_redo() {
+        if(this->history.redo(*this->parser_data)) {
+            this->refresh_view();
+            this->update_dirty();
+        }
+    }
+
+    void TagEditorWindow::refresh_view() {
+        // Widgets only read their values when made, so remake them
+        auto scroll_position = this->scroll_widget->verticalScrollBar()->value();
+        if(this->extra_widget_panel) {
+            this->extra_widget_panel->setParent(nullptr);
+        }
+        delete this->scroll_widget->takeWidget();
+
+        auto values = std::vector<Parser::ParserStructValue>(this->parser_data->get_values());
+        this->main_widget = new TagEditorEditWidgetView(nullptr, values, this, true, this->extra_widget_panel);
+        this->scroll_widget->setWidget(this->main_widget);
+        this->scroll_widget->verticalScrollBar()->setValue(scroll_position);
+
+        if(this->subwindow) {
+            this->subwindow->update();
+        }
+    }
+
+    void TagEditorWindow::perform_autosave() {
+        if(!this->dirty || this->file.tag_path.empty()) {
+            return;
+        }
+
+        // If it was changed back to what is on disk, don't write it again
+        auto tag_data = this->parser_data->generate_hek_tag_data(this->file.tag_fourcc);
+        auto hash = FNV1AHash::hash_bytes(tag_data.data(), tag_data.size());
+        if(hash == this->saved_hash) {
+            this->saved_state_id = this->history.state_id();
+            this->update_dirty();
+            return;
+        }
+
+        auto str = this->file.full_path.string();
+        if(Invader::File::save_file(str.c_str(), tag_data)) {
+            this->saved_state_id = this->history.state_id();
+            this->saved_hash = hash;
+            this->parent_window->get_tag_cache().saved(this->file.full_path, this->parser_data, hash);
+            this->update_dirty();
+            std::printf("Autosaved %s\n", str.c_str());
+        }
+        else {
+            eprintf_warn("Failed to autosave %s", str.c_str());
+        }
+    }
+
     
     void TagEditorWindow::scroll_to(const char *item) {
         int offset = this->main_widget->y_for_item(item);
@@ -244,6 +349,11 @@ namespace Invader::EditQt {
                     break;
                 case QMessageBox::Discard:
                     accept = true;
+
+                    // Other windows shouldn't get the changes we're throwing away
+                    if(!this->file.tag_path.empty()) {
+                        this->parent_window->get_tag_cache().invalidate(this->file.full_path);
+                    }
                     break;
                 default:
                     std::terminate();
@@ -288,7 +398,10 @@ namespace Invader::EditQt {
             this->close();
         }
         else {
-            this->make_dirty(false);
+            this->saved_state_id = this->history.state_id();
+            this->saved_hash = FNV1AHash::hash_bytes(tag_data.data(), tag_data.size());
+            this->parent_window->get_tag_cache().saved(this->file.full_path, this->parser_data, this->saved_hash);
+            this->update_dirty();
             auto end = std::chrono::steady_clock::now();
             std::printf("Saved %s in %zu ms\n", this->get_file().full_path.string().c_str(), std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
         }
@@ -360,7 +473,6 @@ namespace Invader::EditQt {
             this->subwindow->deleteLater();
             this->subwindow = nullptr;
         }
-        delete this->parser_data;
     }
 
     void TagEditorWindow::show_subwindow() {
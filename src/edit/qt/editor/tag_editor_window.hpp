@@ -7,8 +7,11 @@
 #include <memory>
 #include <invader/file/file.hpp>
 #include "../tree/tag_tree_widget.hpp"
+#include "tag_editor_history.hpp"
 
 class QScrollArea;
+class QFrame;
+class QTimer;
 
 namespace Invader::Parser {
     struct ParserStruct;
@@ -67,7 +70,7 @@ namespace Invader::EditQt {
          * @return parser data
          */
         Parser::ParserStruct *get_parser_data() noexcept {
-            return this->parser_data;
+            return this->parser_data.get();
         }
         
         /**
@@ -84,11 +87,25 @@ namespace Invader::EditQt {
 
         void make_dirty(bool dirty);
 
+        TagEditorHistory history;
+        std::uint64_t saved_state_id = 0;
+        std::uint64_t saved_hash = 0;
+        QAction *undo_action;
+        QAction *redo_action;
+        QTimer *autosave_timer = nullptr;
+
+        void value_changed(std::vector<TagEditorHistory::Change> changes);
+        void update_dirty();
+        void perform_undo();
+        void perform_redo();
+        void perform_autosave();
+        void refresh_view();
+
         bool perform_save();
         bool perform_save_as();
         File::TagFile file;
 
-        Parser::ParserStruct *parser_data = nullptr;
+        std::shared_ptr<Parser::ParserStruct> parser_data; // may be shared with other windows through the tag cache
         std::vector<std::unique_ptr<QWidget>> widgets_to_remove;
         TagEditorSubwindow *subwindow = nullptr;
 
@@ -96,6 +113,7 @@ namespace Invader::EditQt {
         
         QScrollArea *scroll_widget;
         TagEditorEditWidgetView *main_widget;
+        QFrame *extra_widget_panel = nullptr;
 
         void toggle_fullscreen();
         void show_subwindow();
@@ -13,8 +13,8 @@
 #include <QComboBox>
 #include <QPushButton>
 #include <QLabel>
-#include <QStandardItemModel>
-#include <QStandardItem>
+#include <QAbstractListModel>
+#include <QListView>
 #include <QApplication>
 #include <QSpinBox>
 #include <QMouseEvent>
@@ -34,6 +34,49 @@ namespace Invader::EditQt {
         }
     };
     
+    // Show each element's index and title, only looking up titles the combo box actually shows
+    class TagEditorArrayWidget::ArrayIndexModel : public QAbstractListModel {
+    public:
+        ArrayIndexModel(QObject *parent, Parser::ParserStructValue *value) : QAbstractListModel(parent), value(value) {}
+
+        void reset() {
+            this->beginResetModel();
+            this->count = this->value->get_array_size();
+            this->has_title = this->count > 0 && this->value->get_object_in_array(0).has_title();
+            this->endResetModel();
+        }
+
+        void refresh_row(int row) {
+            auto index = this->index(row);
+            emit dataChanged(index, index, { Qt::DisplayRole });
+        }
+
+        int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+            return parent.isValid() ? 0 : static_cast<int>(this->count);
+        }
+
+        QVariant data(const QModelIndex &index, int role) const override {
+            if(role != Qt::DisplayRole || !index.isValid() || static_cast<std::size_t>(index.row()) >= this->count) {
+                return QVariant();
+            }
+
+            std::size_t i = static_cast<std::size_t>(index.row());
+            const char *title_value = this->has_title ? this->value->get_object_in_array(i).title() : nullptr;
+            if(title_value == nullptr || title_value[0] == 0) {
+                return QString::number(i);
+            }
+
+            char title[256];
+            std::snprintf(title, sizeof(title), "%zu (%s)", i, title_value);
+            return QString(title);
+        }
+
+    private:
+        Parser::ParserStructValue *value;
+        std::size_t count = 0;
+        bool has_title = false;
+    };
+
     TagEditorArrayWidget::TagEditorArrayWidget(QWidget *parent, Parser::ParserStructValue *value, TagEditorWindow *editor_window) : TagEditorWidget(parent, value, editor_window) {
         this->vbox_layout = new QVBoxLayout();
         this->vbox_layout->setContentsMargins(8, 8, 8, 8);
@@ -42,7 +85,11 @@ namespace Invader::EditQt {
         this->spin_box = new QSpinBox(this);
         this->reflexive_index->setContextMenuPolicy(Qt::ContextMenuPolicy::NoContextMenu);
         this->spin_box->setContextMenuPolicy(Qt::ContextMenuPolicy::NoContextMenu);
-        this->item_model = nullptr;
+        this->item_model = new ArrayIndexModel(this->reflexive_index, value);
+        this->reflexive_index->setModel(this->item_model);
+        if(auto *list_view = qobject_cast<QListView *>(this->reflexive_index->view())) {
+            list_view->setUniformItemSizes(true); // don't measure every element when the list is opened
+        }
         this->read_only = value->is_read_only() && editor_window->get_parent_window()->safeguards();
 
         // Set our header stuff
@@ -164,9 +211,10 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_add() {
         int index = this->get_struct_value()->get_array_size();
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_INSERT, this->get_value_path(), *this->get_struct_value(), index, 1);
         this->get_struct_value()->insert_objects_in_array(index, 1);
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index);
@@ -177,9 +225,10 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_insert() {
         int index = this->current_index();
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_INSERT, this->get_value_path(), *this->get_struct_value(), index, 1);
         this->get_struct_value()->insert_objects_in_array(index, 1);
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index);
@@ -191,6 +240,7 @@ namespace Invader::EditQt {
     void TagEditorArrayWidget::perform_delete() {
         // Delete the object at the current index
         int index = this->current_index();
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_DELETE, this->get_value_path(), *this->get_struct_value(), index, 1);
         this->get_struct_value()->delete_objects_in_array(static_cast<std::size_t>(index), 1);
 
         // Decrement if possible
@@ -199,7 +249,7 @@ namespace Invader::EditQt {
         }
 
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index);
@@ -210,10 +260,11 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_duplicate() {
         auto index = static_cast<std::size_t>(this->current_index());
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_DUPLICATE, this->get_value_path(), *this->get_struct_value(), index, 1, index);
         this->get_struct_value()->duplicate_objects_in_array(index, index, 1);
 
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index + 1);
@@ -224,11 +275,15 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_clear() {
         auto index = static_cast<std::size_t>(this->current_index());
+        auto path = this->get_value_path();
+        std::vector<TagEditorHistory::Change> changes;
+        changes.emplace_back(TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_DELETE, path, *this->get_struct_value(), index, 1));
+        changes.emplace_back(TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_INSERT, path, *this->get_struct_value(), index, 1));
         this->get_struct_value()->delete_objects_in_array(index, 1);
         this->get_struct_value()->insert_objects_in_array(index, 1);
 
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed(std::move(changes));
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index);
@@ -238,9 +293,10 @@ namespace Invader::EditQt {
     }
 
     void TagEditorArrayWidget::perform_delete_all() {
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_DELETE, this->get_value_path(), *this->get_struct_value(), 0, this->get_struct_value()->get_array_size());
         this->get_struct_value()->delete_objects_in_array(0, this->get_struct_value()->get_array_size());
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(-1);
@@ -251,10 +307,11 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_shift_up() {
         auto index = static_cast<std::size_t>(this->current_index());
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_SWAP, this->get_value_path(), *this->get_struct_value(), index, 1, index + 1);
         this->get_struct_value()->swap_objects_in_array(index, index + 1, 1);
 
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index + 1);
@@ -265,10 +322,11 @@ namespace Invader::EditQt {
 
     void TagEditorArrayWidget::perform_shift_down() {
         auto index = static_cast<std::size_t>(this->current_index());
+        auto change = TagEditorHistory::array_change(TagEditorHistory::Change::Type::CHANGE_TYPE_SWAP, this->get_value_path(), *this->get_struct_value(), index, 1, index - 1);
         this->get_struct_value()->swap_objects_in_array(index, index - 1, 1);
 
         this->regenerate_enum();
-        this->value_changed();
+        this->value_changed({ std::move(change) });
 
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setCurrentIndex(index - 1);
@@ -291,9 +349,9 @@ namespace Invader::EditQt {
         this->spin_box->blockSignals(false);
         
         // Update this
+        this->tag_view_widget = nullptr;
         std::size_t count = this->get_struct_value()->get_array_size();
-        if(index < 0 || static_cast<std::size_t>(index) > count) {
-            this->tag_view_widget = nullptr;
+        if(index < 0 || static_cast<std::size_t>(index) >= count || !this->painted) {
             return;
         }
 
@@ -308,34 +366,11 @@ namespace Invader::EditQt {
         this->reflexive_index->blockSignals(true);
         this->reflexive_index->setUpdatesEnabled(false);
 
-        // Use a QStandardItemModel - it's a bit faster than adding directly, especially on Windows for whatever reason
-        delete this->item_model;
-        this->item_model = new QStandardItemModel(this->reflexive_index);
-
-        auto *struct_value = this->get_struct_value();
-        std::size_t count = struct_value->get_array_size();
-        bool has_title = false;
-        for(std::size_t i = 0; i < count; i++) {
-            // See if we have a title
-            if(i == 0) {
-                has_title = struct_value->get_object_in_array(i).has_title();
-            }
-            // If so, show that alongside the index
-            if(has_title) {
-                const char *title_value = struct_value->get_object_in_array(i).title();
-                if(title_value == nullptr || title_value[0] == 0) {
-                    this->item_model->appendRow(new QStandardItem(QString::number(i)));
-                }
-                else {
-                    char title[256];
-                    std::snprintf(title, sizeof(title), "%zu (%s)", i, title_value);
-                    this->item_model->appendRow(new QStandardItem(title));
-                }
-            }
-            // If not, well... darn
-            else {
-                this->item_model->appendRow(new QStandardItem(QString::number(i)));
-            }
+        // Titles are looked up by the model when shown, so this doesn't depend on how many elements there are
+        this->item_model->reset();
+        std::size_t count = this->get_struct_value()->get_array_size();
+        if(count > 0 && this->reflexive_index->currentIndex() < 0) {
+            this->reflexive_index->setCurrentIndex(0);
         }
         
         // Update our spinner
@@ -350,7 +385,6 @@ namespace Invader::EditQt {
             this->spin_box->setEnabled(false);
         }
         
-        this->reflexive_index->setModel(this->item_model);
         this->reflexive_index->setEnabled(count > 0);
 
         this->reflexive_index->setUpdatesEnabled(true);
@@ -387,21 +421,20 @@ namespace Invader::EditQt {
         this->reflexive_index->blockSignals(true);
 
         // We've changed a value that changes some reflexive bullshit
-        QString new_title;
-        std::size_t i = this->reflexive_index->currentIndex();
-        const char *title_value = this->get_struct_value()->get_object_in_array(i).title();
-        if(title_value == nullptr || title_value[0] == 0) {
-            new_title = QString::number(i);
-        }
-        else {
-            char title[256];
-            std::snprintf(title, sizeof(title), "%zu (%s)", i, title_value);
-            new_title = title;
-        }
-        this->reflexive_index->setItemText(this->reflexive_index->currentIndex(), new_title);
+        this->item_model->refresh_row(this->reflexive_index->currentIndex());
 
         this->reflexive_index->blockSignals(false);
     }
+
+    void TagEditorArrayWidget::paintEvent(QPaintEvent *event) {
+        TagEditorWidget::paintEvent(event);
+
+        // Now that we can be seen, build the selected element. Do it after painting since it changes our size.
+        if(!this->painted) {
+            this->painted = true;
+            QMetaObject::invokeMethod(this, &TagEditorArrayWidget::regenerate_widget, Qt::QueuedConnection);
+        }
+    }
     
     void TagEditorArrayWidget::toggle_spin_box() {
         this->spin_box->setVisible(!this->spin_box->isVisible());
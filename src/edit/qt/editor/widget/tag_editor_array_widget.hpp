@@ -9,7 +9,6 @@ class QLineEdit;
 class QComboBox;
 class QPushButton;
 class QVBoxLayout;
-class QStandardItemModel;
 class QSpinBox;
 
 namespace Invader::EditQt {
@@ -27,6 +26,12 @@ namespace Invader::EditQt {
          */
         TagEditorArrayWidget(QWidget *parent, Parser::ParserStructValue *value, TagEditorWindow *editor_window);
 
+        /**
+         * Get the index of the selected element
+         * @return selected index, or -1 if none is selected
+         */
+        int current_index() const noexcept;
+
         ~TagEditorArrayWidget() = default;
 
     public slots:
@@ -43,19 +48,24 @@ namespace Invader::EditQt {
         void perform_shift_down();
         void spinbox_update();
 
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+
     private:
         class ToggleSpinBoxLabel;
+        class ArrayIndexModel;
         
         void regenerate_widget();
         void regenerate_enum();
         void set_buttons_enabled();
         void toggle_spin_box();
 
-        int current_index() const noexcept;
-
         TagEditorEditWidgetView *tag_view_widget = nullptr;
         bool read_only = false;
 
+        // The selected element isn't built until we're first drawn, so sections scrolled out of view cost nothing
+        bool painted = false;
+
         QComboBox *reflexive_index;
         QVBoxLayout *vbox_layout;
 
@@ -69,7 +79,7 @@ namespace Invader::EditQt {
         QPushButton *shift_down_button;
         QSpinBox *spin_box;
 
-        QStandardItemModel *item_model;
+        ArrayIndexModel *item_model;
     };
 }
 
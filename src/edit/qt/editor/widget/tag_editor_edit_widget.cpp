@@ -683,6 +683,9 @@ namespace Invader::EditQt {
             return;
         }
 
+        // Only this value is kept for undoing, not the whole tag
+        auto before = TagEditorHistory::capture(*value);
+
         switch(value_type) {
             case Parser::ParserStructValue::ValueType::VALUE_TYPE_TAGSTRING:
                 value->set_string(this->textbox_widgets[0]->text().toLatin1().data());
@@ -853,7 +856,13 @@ namespace Invader::EditQt {
             this->array_widget->update_text();
         }
 
-        this->value_changed();
+        auto after = TagEditorHistory::capture(*value);
+        if(after == before) {
+            this->value_changed({});
+        }
+        else {
+            this->value_changed({ TagEditorHistory::set_change(this->get_value_path(), std::move(before), std::move(after)) });
+        }
     }
 
     void TagEditorEditWidget::verify_dependency_path() {
@@ -57,7 +57,22 @@ namespace Invader::EditQt {
         return nullptr;
     }
 
-    void TagEditorWidget::value_changed() {
-        this->get_editor_window()->make_dirty(true);
+    void TagEditorWidget::value_changed(std::vector<TagEditorHistory::Change> changes) {
+        this->get_editor_window()->value_changed(std::move(changes));
+    }
+
+    TagEditorHistory::ValuePath TagEditorWidget::get_value_path() {
+        TagEditorHistory::ValuePath path;
+        auto *member_name = this->struct_value->get_member_name();
+        path.member_name = member_name ? member_name : "";
+
+        // Elements are shown inside the array widget they belong to
+        for(auto *widget = this->parentWidget(); widget; widget = widget->parentWidget()) {
+            if(auto *array_widget = qobject_cast<TagEditorArrayWidget *>(widget)) {
+                path.elements.emplace(path.elements.begin(), array_widget->get_struct_value()->get_member_name(), static_cast<std::size_t>(array_widget->current_index()));
+            }
+        }
+
+        return path;
     }
 }
@@ -4,6 +4,7 @@
 #define INVADER__EDIT__QT__TAG_EDITOR_WIDGET_HPP
 
 #include <QFrame>
+#include "../tag_editor_history.hpp"
 
 namespace Invader::Parser {
     class ParserStructValue;
@@ -56,8 +57,15 @@ namespace Invader::EditQt {
 
         /**
          * The value has been changed. Signal the window that this is the case.
+         * @param changes changes made, in order, for undoing them; if empty, nothing actually changed
          */
-        void value_changed();
+        void value_changed(std::vector<TagEditorHistory::Change> changes);
+
+        /**
+         * Get the location of the value in the tag, using the selected element of each array it's in
+         * @return path to the value
+         */
+        TagEditorHistory::ValuePath get_value_path();
 
     private:
         Parser::ParserStructValue *struct_value;
@@ -20,6 +20,8 @@ if(${INVADER_EDIT_QT})
         src/edit/qt/editor/widget/tag_editor_edit_widget.cpp
         src/edit/qt/editor/widget/tag_editor_group_widget.cpp
         src/edit/qt/editor/widget/tag_editor_widget.cpp
+        src/edit/qt/editor/tag_editor_cache.cpp
+        src/edit/qt/editor/tag_editor_history.cpp
         src/edit/qt/editor/tag_editor_window.cpp
         src/edit/qt/tree/tag_tree_dialog.cpp
         src/edit/qt/tree/tag_tree_widget.cpp
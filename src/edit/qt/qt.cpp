@@ -32,7 +32,8 @@ int main(int argc, char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
         CommandLineOption("no-safeguards", 'n', 0, "Allow all tag data to be edited (proceed at your own risk)"),
-        CommandLineOption("listing-mode", 'L', 1, "Set the listing behavior. Can be: fast, recursive (default: fast)")
+        CommandLineOption("listing-mode", 'L', 1, "Set the listing behavior. Can be: fast, recursive (default: fast)"),
+        CommandLineOption("autosave", 'a', 1, "Automatically save modified tags every given number of seconds. Untitled tags are not saved. Default: 0 (disabled)", "<sec>")
     };
 
     static constexpr char DESCRIPTION[] = "Edit tag files.";
@@ -44,6 +45,7 @@ int main(int argc, char **argv) {
         bool disable_safeguards = false;
         bool fs_path = false;
         bool fast_listing = true;
+        unsigned int autosave_seconds = 0;
     } edit_qt_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<EditQtOption &>(argc, argv, options, USAGE, DESCRIPTION, 0, 65535, edit_qt_options, [](char opt, const std::vector<const char *> &arguments, auto &edit_qt_options) {
@@ -76,6 +78,16 @@ int main(int argc, char **argv) {
                     std::exit(EXIT_FAILURE);
                 }
                 break;
+
+            case 'a':
+                try {
+                    edit_qt_options.autosave_seconds = static_cast<unsigned int>(std::stoul(arguments[0]));
+                }
+                catch(std::exception &) {
+                    eprintf_error("Invalid autosave interval %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
+                break;
         }
     });
 
@@ -136,6 +148,8 @@ int main(int argc, char **argv) {
         w.set_fast_listing_mode(true);
     }
 
+    w.set_autosave_interval(edit_qt_options.autosave_seconds);
+
     // Give a spiel
     if(edit_qt_options.disable_safeguards) {
         QMessageBox message(QMessageBox::Warning, "You think you want this, but you actually don't.", "WARNING: Safeguards have been disabled.\n\nManually editing data that is normally read-only will likely break your tags.\n\nRemember: If something is normally read-only, then there is a much better program for modifying it than a tag editor.", QMessageBox::Cancel);
@@ -203,6 +203,11 @@ namespace Invader::EditQt {
 
         QTreeWidgetItem *new_item;
         if(dialog_ask.exec() == QInputDialog::Accepted) {
+            // Directories only get their contents once they're expanded, so do that before adding anything to it
+            if(item) {
+                item->setExpanded(true);
+            }
+
             new_item = new QTreeWidgetItem();
             QString dialog_lower = dialog_ask.textValue().toLower();
             new_item->setIcon(0, dir_icon);
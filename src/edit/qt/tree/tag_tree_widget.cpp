@@ -3,6 +3,9 @@
 #include "tag_tree_widget.hpp"
 #include "tag_tree_window.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
 #include <invader/file/file.hpp>
 #include <QFileIconProvider>
 #include <invader/printf.hpp>
@@ -10,224 +13,311 @@
 #include <QMessageBox>
 
 namespace Invader::EditQt {
+    // Directory items whose children haven't been added yet hold the range of sorted tags that go in them
+    static constexpr int RANGE_START_ROLE = Qt::UserRole + 1;
+    static constexpr int RANGE_END_ROLE = Qt::UserRole + 2;
+
+    // Tag items only look up the file size for their tooltip when it's shown
+    class TagTreeWidgetTagItem : public QTreeWidgetItem {
+    public:
+        TagTreeWidgetTagItem(const File::TagFile &tag, const std::string &name) : QTreeWidgetItem(QStringList(name.c_str())), tag(tag) {
+            this->setData(0, Qt::UserRole, QVariant::fromValue(reinterpret_cast<std::uintptr_t>(&tag)));
+        }
+
+        QVariant data(int column, int role) const override {
+            if(role != Qt::ToolTipRole) {
+                return QTreeWidgetItem::data(column, role);
+            }
+
+            // Make size text
+            char size[12];
+            std::uint64_t file_size;
+            try {
+                file_size = std::filesystem::file_size(this->tag.full_path);
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to get file size for %s: %s", this->tag.full_path.string().c_str(), e.what());
+                file_size = 0;
+            }
+            if(file_size > 1024 * 1024) {
+                std::snprintf(size, sizeof(size), "%.02f MiB", file_size / 1024.0 / 1024.0);
+            }
+            else if(file_size > 1024) {
+                std::snprintf(size, sizeof(size), "%.02f KiB", file_size / 1024.0);
+            }
+            else if(file_size > 0) {
+                std::snprintf(size, sizeof(size), "%zu byte%s", static_cast<std::size_t>(file_size), file_size == 1 ? "" : "s");
+            }
+            else {
+                std::strcpy(size, "Unknown");
+            }
+
+            // Make hover text
+            char text[1024];
+            std::snprintf(text, sizeof(text),
+                "Virtual path: %s\n"
+                "File path: %s\n"
+                "File size: %s"
+            , this->tag.tag_path.c_str(), this->tag.full_path.string().c_str(), size);
+            return QString(text);
+        }
+
+    private:
+        const File::TagFile &tag;
+    };
+
+    // Compare path elements case-insensitively, falling back to case-sensitively so identical names stay together
+    static int compare_path_elements(const std::string &a, const std::string &b) noexcept {
+        std::size_t length = std::min(a.size(), b.size());
+        for(std::size_t i = 0; i < length; i++) {
+            int a_lower = std::tolower(static_cast<unsigned char>(a[i]));
+            int b_lower = std::tolower(static_cast<unsigned char>(b[i]));
+            if(a_lower != b_lower) {
+                return a_lower < b_lower ? -1 : 1;
+            }
+        }
+        if(a.size() != b.size()) {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        return a.compare(b);
+    }
+
     TagTreeWidget::TagTreeWidget(QWidget *parent, TagTreeWindow *parent_window, const std::optional<std::vector<HEK::TagFourCC>> &classes, const std::optional<std::vector<std::size_t>> &tags_directories, bool show_directories) : QTreeWidget(parent), filter(classes), tag_arrays_to_show(tags_directories), show_directories(show_directories) {
         this->setColumnCount(1);
         this->setAlternatingRowColors(true);
         this->setHeaderHidden(true);
         this->setAnimated(false);
+        this->setUniformRowHeights(true);
         this->refresh_view(parent_window);
         connect(parent_window, &TagTreeWindow::tags_reloaded, this, &TagTreeWidget::refresh_view);
+        connect(this, &TagTreeWidget::itemExpanded, this, &TagTreeWidget::on_item_expanded);
+    }
+
+    TagTreeWidget::~TagTreeWidget() {
+        if(this->path_index_thread.joinable()) {
+            this->path_index_thread.join();
+        }
     }
 
     void TagTreeWidget::refresh_view(TagTreeWindow *window) {
-        this->clear();
         this->last_window = window;
+        this->sorted_tags.clear();
+        this->path_index.reset();
+        this->path_index_generation++;
         
-        QIcon dir_icon = QFileIconProvider().icon(QFileIconProvider::Folder);
-        QIcon file_icon = QFileIconProvider().icon(QFileIconProvider::File);
-        
-        // If fast listing mode is enabled
-        if(!window->fast_listing_mode()) {
-            // Get the tags we have
-            const auto &all_tags = window->get_all_tags();
-            std::size_t all_tags_size = all_tags.size();
-            std::vector<bool> all_tags_ignored(all_tags_size, false);
-
-            // Next, go through each tag and filter out anything we don't need (i.e. lower-priority tags, non-matching extensions)
-            for(std::size_t i = 0; i < all_tags_size; i++) {
-                bool remove = false;
-                auto &tag = all_tags[i];
-
-                // First, can we drop it simply because it's out of our current scope?
-                if(this->tag_arrays_to_show.has_value()) {
-                    remove = true;
-                    for(auto t : *this->tag_arrays_to_show) {
-                        if(tag.tag_directory == t) {
-                            remove = false;
-                            break;
-                        }
-                    }
+        // If fast listing mode is enabled, show the top level first, and we'll worry about the rest later
+        if(window->fast_listing_mode()) {
+            this->load_directories(nullptr);
+            return;
+        }
+
+        // Get the tags we have
+        const auto &all_tags = window->get_all_tags();
+        this->total_tags = all_tags.size();
+
+        // Find the highest priority tags directory each tag path is in so we can drop anything it supersedes
+        std::unordered_map<std::string, std::size_t> highest_priority_directory;
+        highest_priority_directory.reserve(all_tags.size());
+        for(auto &tag : all_tags) {
+            auto [directory, inserted] = highest_priority_directory.try_emplace(tag.tag_path, tag.tag_directory);
+            if(!inserted && tag.tag_directory < directory->second) {
+                directory->second = tag.tag_directory;
+            }
+        }
+
+        this->sorted_tags.reserve(all_tags.size());
+        for(auto &tag : all_tags) {
+            if(tag.tag_directory > highest_priority_directory[tag.tag_path]) {
+                continue;
+            }
+
+            auto &sorted_tag = this->sorted_tags.emplace_back();
+            sorted_tag.tag = &tag;
+
+            auto prep = File::preferred_path_to_halo_path(tag.tag_path);
+            std::size_t last_separator = 0;
+            std::size_t length = prep.size();
+            for(std::size_t i = 0; i < length; i++) {
+                if(prep[i] == '\\') {
+                    sorted_tag.path_elements.emplace_back(prep.c_str() + last_separator, (i - last_separator));
+                    last_separator = i + 1;
                 }
+            }
+            sorted_tag.path_elements.emplace_back(prep.c_str() + last_separator, (length - last_separator));
+        }
 
-                // Next, can we filter it out based on tag class alone?
-                if(!remove && this->filter.has_value() && this->filter->size() > 0) {
-                    remove = true;
-                    for(auto f : *this->filter) {
-                        if(tag.tag_fourcc == f) {
-                            remove = false;
-                            break;
-                        }
-                    }
+        // Sort once here so every directory's contents are a contiguous range (directories first, then tags)
+        std::sort(this->sorted_tags.begin(), this->sorted_tags.end(), [](const SortedTag &a, const SortedTag &b) {
+            std::size_t a_count = a.path_elements.size();
+            std::size_t b_count = b.path_elements.size();
+            for(std::size_t e = 0; e < a_count && e < b_count; e++) {
+                bool a_is_directory = e + 1 < a_count;
+                bool b_is_directory = e + 1 < b_count;
+                if(a_is_directory != b_is_directory) {
+                    return a_is_directory;
                 }
-                
-                // Also, do we have this in our filters list?
-                if(!remove && this->expressions.has_value()) {
-                    remove = true;
-                    for(auto &f : *this->expressions) {
-                        if(File::path_matches(tag.tag_path.c_str(), f.c_str())) {
-                            remove = false;
-                            break;
-                        }
-                    }
+
+                int difference = compare_path_elements(a.path_elements[e], b.path_elements[e]);
+                if(difference != 0) {
+                    return difference < 0;
                 }
+            }
+            return false;
+        });
 
-                // Lastly, is this superceded by anything?
-                if(!remove && tag.tag_directory > 0) {
-                    for(std::size_t j = 0; j < all_tags_size; j++) {
-                        // If we're the same, continue
-                        if(j == i) {
-                            continue;
-                        }
+        this->index_paths();
+        this->apply_filter();
+    }
 
-                        // If we're a lower priority, or the class isn't the same, continue too
-                        auto &other_tag = all_tags[j];
-                        if(other_tag.tag_directory > tag.tag_directory || other_tag.tag_fourcc != tag.tag_fourcc) {
-                            continue;
-                        }
+    void TagTreeWidget::index_paths() {
+        if(this->path_index_thread.joinable()) {
+            this->path_index_thread.join();
+        }
 
-                        // It all comes down to this. Do we have the same tag path?
-                        if(other_tag.tag_path == tag.tag_path) {
-                            remove = true;
-                            break;
-                        }
-                    }
+        std::vector<std::string> paths;
+        paths.reserve(this->sorted_tags.size());
+        for(auto &sorted_tag : this->sorted_tags) {
+            paths.emplace_back(sorted_tag.tag->tag_path);
+        }
+
+        // Until it's done, filtering checks every tag instead
+        this->path_index_thread = std::thread([this, paths = std::move(paths), generation = this->path_index_generation]() mutable {
+            auto index = std::make_shared<const File::PathIndex>(std::move(paths));
+            QMetaObject::invokeMethod(this, [this, index, generation]() {
+                if(generation == this->path_index_generation) {
+                    this->path_index = index;
                 }
+            }, Qt::QueuedConnection);
+        });
+    }
 
-                if(remove) {
-                    all_tags_ignored[i] = true;
+    void TagTreeWidget::apply_filter() {
+        // If the paths are indexed, only the paths with the same text as an expression need to be checked
+        std::vector<bool> expression_matched;
+        bool use_path_index = this->expressions.has_value() && this->path_index != nullptr;
+        if(use_path_index) {
+            expression_matched.resize(this->sorted_tags.size());
+            for(auto &f : *this->expressions) {
+                for(auto t : this->path_index->find(f.c_str())) {
+                    expression_matched[t] = true;
                 }
             }
+        }
 
-            // Add the tags to the view
-            this->total_tags = all_tags.size();
-
-            for(std::size_t i = 0; i < all_tags_size; i++) {
-                bool hide = all_tags_ignored[i];
-                if(hide && !show_directories) {
-                    continue;
-                }
+        // Go through each tag and filter out anything we don't need (i.e. non-matching directories or extensions)
+        for(std::size_t t = 0; t < this->sorted_tags.size(); t++) {
+            auto &sorted_tag = this->sorted_tags[t];
+            auto &tag = *sorted_tag.tag;
+            bool remove = false;
 
-                auto &t = all_tags[i];
-                QTreeWidgetItem *dir_item = nullptr;
+            // First, can we drop it simply because it's out of our current scope?
+            if(this->tag_arrays_to_show.has_value()) {
+                remove = std::find(this->tag_arrays_to_show->begin(), this->tag_arrays_to_show->end(), tag.tag_directory) == this->tag_arrays_to_show->end();
+            }
 
-                std::vector<std::string> separate_tag_path;
-                auto prep = File::preferred_path_to_halo_path(t.tag_path);
-                std::size_t last_separator = 0;
-                std::size_t length = prep.size();
+            // Next, can we filter it out based on tag class alone?
+            if(!remove && this->filter.has_value() && this->filter->size() > 0) {
+                remove = std::find(this->filter->begin(), this->filter->end(), tag.tag_fourcc) == this->filter->end();
+            }
 
-                for(std::size_t i = 0; i < length; i++) {
-                    if(prep[i] == '\\') {
-                        separate_tag_path.emplace_back(prep.c_str() + last_separator, (i - last_separator));
-                        last_separator = ++i;
+            // Also, do we have this in our filters list?
+            if(!remove && use_path_index) {
+                remove = !expression_matched[t];
+            }
+            else if(!remove && this->expressions.has_value()) {
+                remove = true;
+                for(auto &f : *this->expressions) {
+                    if(File::path_matches(tag.tag_path.c_str(), f.c_str())) {
+                        remove = false;
+                        break;
                     }
                 }
-                separate_tag_path.emplace_back(prep.c_str() + last_separator, (length - last_separator));
-
-                std::size_t element_count = separate_tag_path.size();
-                for(std::size_t e = 0; e < element_count; e++) {
-                    auto &element = separate_tag_path[e];
-                    bool found = false;
-
-                    // See if we have it
-                    if(dir_item == nullptr) {
-                        int count = this->topLevelItemCount();
-                        for(int i = 0; i < count; i++) {
-                            auto *item = this->topLevelItem(i);
-                            if(item->text(0) == element.c_str()) {
-                                found = true;
-                                dir_item = item;
-                                break;
-                            }
-                        }
-                    }
-                    else {
-                        int count = dir_item->childCount();
-                        for(int i = 0; i < count; i++) {
-                            auto *item = dir_item->child(i);
-                            if(item->text(0) == element.c_str()) {
-                                found = true;
-                                dir_item = item;
-                                break;
-                            }
-                        }
-                    }
+            }
 
-                    // Bail early if we're hiding this
-                    if(e + 1 == element_count && hide) {
-                        break;
-                    }
+            sorted_tag.shown = !remove;
+        }
 
-                    // If we don't have it, make it
-                    if(!found) {
-                        auto *new_dir_item = new QTreeWidgetItem(QStringList(element.c_str()));
-                        this->setContentsMargins(0, 0, 0, 0);
-                        if(dir_item == nullptr) {
-                            this->addTopLevelItem(new_dir_item);
-                        }
-                        else {
-                            dir_item->addChild(new_dir_item);
-                        }
-                        dir_item = new_dir_item;
-                    }
+        // Only the top level is made here; everything else is made when it's expanded
+        this->setUpdatesEnabled(false);
+        this->clear();
+        this->add_items(nullptr, 0, this->sorted_tags.size(), 0);
+        this->setUpdatesEnabled(true);
+    }
 
-                    // If it's the last one, all is well then
-                    if(e + 1 == element_count) {
-                        dir_item->setData(0, Qt::UserRole, QVariant::fromValue(reinterpret_cast<std::uintptr_t>(&t)));
-                        if(!found) {
-                            dir_item->setIcon(0, file_icon);
-                        }
-                        
-                        // Make size text
-                        char size[12];
-                        std::uint64_t file_size;
-                        try {
-                            file_size = std::filesystem::file_size(t.full_path);
-                        }
-                        catch(std::exception &e) {
-                            eprintf_error("Failed to get file size for %s: %s", t.full_path.string().c_str(), e.what());
-                            file_size = 0;
-                        }
-                        if(file_size > 1024 * 1024) {
-                            std::snprintf(size, sizeof(size), "%.02f MiB", file_size / 1024.0 / 1024.0);
-                        }
-                        else if(file_size > 1024) {
-                            std::snprintf(size, sizeof(size), "%.02f KiB", file_size / 1024.0);
-                        }
-                        else if(file_size > 0) {
-                            std::snprintf(size, sizeof(size), "%zu byte%s", file_size, file_size == 1 ? "" : "s");
-                        }
-                        else {
-                            std::strcpy(size, "Unknown");
-                        }
-                        
-                        // Make hover text
-                        char text[1024];
-                        std::snprintf(text, sizeof(text),
-                            "Virtual path: %s\n"
-                            "File path: %s\n"
-                            "File size: %s"
-                        , t.tag_path.c_str(),  t.full_path.string().c_str(), size);
-                        dir_item->setToolTip(0, text);
-                        dir_item->setToolTip(1, text);
-                        dir_item->setText(1, size);
-                    }
-                    else if(!found) {
-                        dir_item->setIcon(0, dir_icon);
-                    }
+    void TagTreeWidget::add_items(QTreeWidgetItem *item, std::size_t start, std::size_t end, std::size_t depth) {
+        QIcon dir_icon = QFileIconProvider().icon(QFileIconProvider::Folder);
+        QIcon file_icon = QFileIconProvider().icon(QFileIconProvider::File);
+
+        QList<QTreeWidgetItem *> new_items;
+        for(std::size_t i = start; i < end;) {
+            auto &sorted_tag = this->sorted_tags[i];
+            auto &element = sorted_tag.path_elements[depth];
+
+            // Tag
+            if(depth + 1 == sorted_tag.path_elements.size()) {
+                if(sorted_tag.shown) {
+                    auto *new_item = new TagTreeWidgetTagItem(*sorted_tag.tag, element);
+                    new_item->setIcon(0, file_icon);
+                    new_items.append(new_item);
+                }
+                i++;
+                continue;
+            }
+
+            // Directory; everything in it is right after this
+            std::size_t directory_end = i + 1;
+            bool shown = sorted_tag.shown;
+            for(; directory_end < end; directory_end++) {
+                auto &next_tag = this->sorted_tags[directory_end];
+                if(next_tag.path_elements.size() <= depth + 1 || next_tag.path_elements[depth] != element) {
+                    break;
                 }
+                shown = shown || next_tag.shown;
             }
+
+            if(shown || this->show_directories) {
+                auto *new_item = new QTreeWidgetItem(QStringList(element.c_str()));
+                new_item->setIcon(0, dir_icon);
+                new_item->setData(0, RANGE_START_ROLE, QVariant::fromValue(static_cast<qulonglong>(i)));
+                new_item->setData(0, RANGE_END_ROLE, QVariant::fromValue(static_cast<qulonglong>(directory_end)));
+                new_item->addChild(new QTreeWidgetItem());
+                new_items.append(new_item);
+            }
+
+            i = directory_end;
+        }
+
+        if(item) {
+            item->addChildren(new_items);
         }
-        
-        // Otherwise, show the top level first, and we'll worry about the rest later
         else {
-            this->load_directories(nullptr);
+            this->addTopLevelItems(new_items);
         }
+    }
 
-        // Connect this in case we expand any items while in fast mode
-        connect(this, &TagTreeWidget::itemExpanded, this, &TagTreeWidget::load_directories);
-        
-        // Done!
-        this->resort_elements();
+    void TagTreeWidget::on_item_expanded(QTreeWidgetItem *item) {
+        if(this->last_window->fast_listing_mode()) {
+            this->load_directories(item);
+            return;
+        }
+
+        // Make the children if we haven't yet
+        auto start = item->data(0, RANGE_START_ROLE);
+        if(!start.isValid()) {
+            return;
+        }
+        auto end = item->data(0, RANGE_END_ROLE);
+        item->setData(0, RANGE_START_ROLE, QVariant());
+        item->setData(0, RANGE_END_ROLE, QVariant());
+
+        std::size_t depth = 0;
+        for(auto *parent = item->parent(); parent; parent = parent->parent()) {
+            depth++;
+        }
+
+        // Replace the placeholder with what's in the directory
+        qDeleteAll(item->takeChildren());
+        this->add_items(item, start.value<qulonglong>(), end.value<qulonglong>(), depth + 1);
     }
     
     void TagTreeWidget::load_directories(QTreeWidgetItem *item) {
@@ -344,52 +434,49 @@ namespace Invader::EditQt {
             return !(j_is_dir && !i_is_dir) && ((i_is_dir && !j_is_dir) || (item_i->text(0).compare(item_j->text(0), Qt::CaseInsensitive) < 0));
         };
 
+        // Only move things around if they're out of order, since taking an item out collapses it
+        auto sort_items = [&less_than](int count, auto get_item, auto take_items, auto insert_items) {
+            QList<QTreeWidgetItem *> items;
+            for(int i = 0; i < count; i++) {
+                items.append(get_item(i));
+            }
+            if(!std::is_sorted(items.begin(), items.end(), less_than)) {
+                items = take_items();
+                std::stable_sort(items.begin(), items.end(), less_than);
+                insert_items(items);
+            }
+        };
+
         // First, sort the top level
-        int top_level_count = this->topLevelItemCount();
-        bool sorted;
-        do {
-            sorted = true;
-            for(int i = 1; i < top_level_count; i++) {
-                auto *item_i = this->topLevelItem(i);
-                for(int j = 0; j < i; j++) {
-                    auto *item_j = this->topLevelItem(j);
-                    if(less_than(item_i, item_j)) {
-                        sorted = false;
-                        this->insertTopLevelItem(j, this->takeTopLevelItem(i));
-                        break;
-                    }
+        sort_items(
+            this->topLevelItemCount(),
+            [this](int i) { return this->topLevelItem(i); },
+            [this]() {
+                QList<QTreeWidgetItem *> items;
+                while(this->topLevelItemCount() > 0) {
+                    items.prepend(this->takeTopLevelItem(this->topLevelItemCount() - 1));
                 }
-            }
-        }
-        while(!sorted);
+                return items;
+            },
+            [this](const QList<QTreeWidgetItem *> &items) { this->addTopLevelItems(items); }
+        );
 
         // Lastly, sort all elements in element
-        auto sort_elements = [&less_than](QTreeWidgetItem *item, auto &sort_elements) -> void {
-            int children_count = item->childCount();
-
-            // Sort this
-            bool sorted;
-            do {
-                sorted = true;
-                for(int i = 1; i < children_count; i++) {
-                    auto *item_i = item->child(i);
-                    for(int j = 0; j < i; j++) {
-                        auto *item_j = item->child(j);
-                        if(less_than(item_i, item_j)) {
-                            sorted = false;
-                            item->insertChild(j, item->takeChild(i));
-                            break;
-                        }
-                    }
-                }
-            }
-            while(!sorted);
+        auto sort_elements = [&sort_items](QTreeWidgetItem *item, auto &sort_elements) -> void {
+            sort_items(
+                item->childCount(),
+                [item](int i) { return item->child(i); },
+                [item]() { return item->takeChildren(); },
+                [item](const QList<QTreeWidgetItem *> &items) { item->addChildren(items); }
+            );
 
             // Then sort the elements of this
+            int children_count = item->childCount();
             for(int i = 0; i < children_count; i++) {
                 sort_elements(item->child(i), sort_elements);
             }
         };
+        int top_level_count = this->topLevelItemCount();
         for(int i = 0; i < top_level_count; i++) {
             sort_elements(this->topLevelItem(i), sort_elements);
         }
@@ -438,9 +525,14 @@ namespace Invader::EditQt {
             }
         }
         
-        // It's yours, my friend, as long as you have enough rubies.
+        // It's yours, my friend, as long as you have enough rubies. The tags are already sorted, so only filter them again.
         if(change_made) {
-            this->refresh_view(this->last_window);
+            if(this->last_window->fast_listing_mode()) {
+                this->refresh_view(this->last_window);
+            }
+            else {
+                this->apply_filter();
+            }
         }
     }
 
@@ -5,7 +5,10 @@
 
 #include <QTreeWidget>
 #include <filesystem>
+#include <memory>
+#include <thread>
 #include <invader/file/file.hpp>
+#include <invader/file/path_index.hpp>
 
 #include <invader/hek/fourcc.hpp>
 
@@ -23,6 +26,11 @@ namespace Invader::EditQt {
          */
         TagTreeWidget(QWidget *widget, TagTreeWindow *parent_window, const std::optional<std::vector<HEK::TagFourCC>> &classes = std::nullopt, const std::optional<std::vector<std::size_t>> &tags_directories = std::nullopt, bool show_directories = false);
 
+        /**
+         * Wait for the tag paths to finish being indexed, if they're still being indexed
+         */
+        ~TagTreeWidget();
+
         /**
          * Set the filter, limiting the view to those classes and directories that contain the given classes
          * @param classes            an optional array of classes; if none is given, then the filter is cleared
@@ -54,13 +62,37 @@ namespace Invader::EditQt {
          */
         void resort_elements();
     private:
+        struct SortedTag {
+            /** tag this refers to */
+            const File::TagFile *tag;
+
+            /** directories and file name of the tag path */
+            std::vector<std::string> path_elements;
+
+            /** whether the tag passes the current filter */
+            bool shown;
+        };
+
         std::size_t total_tags = 0;
         std::optional<std::vector<HEK::TagFourCC>> filter;
         std::optional<std::vector<std::size_t>> tag_arrays_to_show;
         std::optional<std::vector<std::string>> expressions;
         TagTreeWindow *last_window;
         bool show_directories;
+
+        /** all tags that aren't overridden by a higher priority tags directory, in the order they're shown in */
+        std::vector<SortedTag> sorted_tags;
+
+        /** paths of sorted_tags, once they're done being indexed on path_index_thread */
+        std::shared_ptr<const File::PathIndex> path_index;
+        std::thread path_index_thread;
+        std::size_t path_index_generation = 0;
+
         void refresh_view(TagTreeWindow *window);
+        void apply_filter();
+        void index_paths();
+        void add_items(QTreeWidgetItem *item, std::size_t start, std::size_t end, std::size_t depth);
+        void on_item_expanded(QTreeWidgetItem *item);
         
         void load_directories(QTreeWidgetItem *item);
     };
@@ -15,11 +15,15 @@
 #include <QInputDialog>
 #include <SDL2/SDL.h>
 #include <QThread>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <algorithm>
 #include "tag_tree_window.hpp"
 #include "tag_tree_widget.hpp"
 #include "tag_tree_dialog.hpp"
 #include <invader/version.hpp>
 #include <invader/file/file.hpp>
+#include <invader/printf.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <QScreen>
 
@@ -137,6 +141,15 @@ namespace Invader::EditQt {
         status_bar->addWidget(this->tag_opening_label, 1);
         status_bar->addWidget(this->tag_count_label, 2);
         this->setStatusBar(status_bar);
+
+        // Watch for tags being added or removed so we don't have to list everything again. Changes tend to come in
+        // bursts, so wait for them to settle down first.
+        this->tag_watcher = new QFileSystemWatcher(this);
+        this->tag_watcher_timer = new QTimer(this);
+        this->tag_watcher_timer->setSingleShot(true);
+        this->tag_watcher_timer->setInterval(250);
+        connect(this->tag_watcher, &QFileSystemWatcher::directoryChanged, this, &TagTreeWindow::directory_changed);
+        connect(this->tag_watcher_timer, &QTimer::timeout, this, &TagTreeWindow::apply_directory_changes);
         
         // Figure out how big we want to make this window. Guarantee 4:3
         auto screen_geometry = QGuiApplication::primaryScreen()->geometry();
@@ -290,16 +303,16 @@ namespace Invader::EditQt {
 
     void TagFetcherThread::run() {
         // Function for loading it
-        std::size_t error_count;
-        auto load_it = [&error_count](std::vector<File::TagFile> *to, std::vector<std::filesystem::path> *all_paths, std::pair<std::mutex, std::size_t> *statuser) {
-            *to = Invader::File::load_virtual_tag_folder(*all_paths, false, statuser, &error_count);
+        std::size_t error_count = 0;
+        auto load_it = [&error_count](std::vector<File::TagFile> *to, std::vector<std::filesystem::path> *all_paths, std::pair<std::mutex, std::size_t> *statuser, const std::atomic<bool> *cancelled) {
+            *to = Invader::File::load_virtual_tag_folder(*all_paths, false, statuser, &error_count, cancelled);
         };
 
-        // Run this in parallel
-        QThread *t = QThread::create(load_it, &this->all_tags, &this->all_paths, &this->statuser);
+        // Run this in parallel, checking the count every so often rather than spinning on it
+        QThread *t = QThread::create(load_it, &this->all_tags, &this->all_paths, &this->statuser, &this->cancelled);
         t->start();
         std::size_t last_tag_count = 0;
-        while(!t->isFinished()) {
+        while(!t->wait(50)) {
             this->statuser.first.lock();
             std::size_t new_count = this->statuser.second;
             this->statuser.first.unlock();
@@ -317,14 +330,20 @@ namespace Invader::EditQt {
     TagFetcherThread::TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths) : QThread(parent), all_paths(all_paths) {}
 
     void TagTreeWindow::reload_tags(bool reiterate_directories) {
-        // Ensure we only reload once
+        // Ensure we only reload once. If we're in the middle of listing, start over once the current listing stops so
+        // we don't miss anything that changed.
         if(this->tags_reloading_queued) {
+            if(reiterate_directories && this->fetcher_thread) {
+                this->fetcher_thread->cancel();
+                this->reload_after_cancel = true;
+            }
             return;
         }
         
         // If we have fast listing mode, we don't need to do much
         if(this->fast_listing) {
             this->tags_reloaded_finished(nullptr, 0);
+            this->watch_tag_directories();
             return;
         }
         
@@ -336,11 +355,27 @@ namespace Invader::EditQt {
         // Clear all tags
         if(reiterate_directories) {
             // Now... let's do this
-            this->fetcher_thread = new TagFetcherThread(this, this->paths);
-            connect(this->fetcher_thread, &TagFetcherThread::tag_count_changed, this, &TagTreeWindow::tag_count_changed);
-            connect(this->fetcher_thread, &TagFetcherThread::fetch_finished, this, &TagTreeWindow::tags_reloaded_finished);
-            connect(this->fetcher_thread, &TagFetcherThread::finished, this->fetcher_thread, &TagFetcherThread::deleteLater);
-            this->fetcher_thread->start();
+            auto *fetcher = new TagFetcherThread(this, this->paths);
+            this->fetcher_thread = fetcher;
+            connect(fetcher, &TagFetcherThread::tag_count_changed, this, &TagTreeWindow::tag_count_changed);
+            connect(fetcher, &TagFetcherThread::fetch_finished, this, [this, fetcher](const std::vector<File::TagFile> *result, int error_count) {
+                this->fetcher_thread = nullptr;
+
+                // If it was cancelled, the result is incomplete
+                if(fetcher->is_cancelled()) {
+                    this->tags_reloading_queued = false;
+                    if(this->reload_after_cancel) {
+                        this->reload_after_cancel = false;
+                        this->reload_tags(true);
+                    }
+                    return;
+                }
+
+                this->tags_reloaded_finished(result, error_count);
+                this->watch_tag_directories();
+            });
+            connect(fetcher, &TagFetcherThread::finished, fetcher, &TagFetcherThread::deleteLater);
+            fetcher->start();
         }
         
         // Just a simple refresh
@@ -390,12 +425,209 @@ namespace Invader::EditQt {
     }
 
     void TagTreeWindow::closeEvent(QCloseEvent *event) {
-        if(this->tags_reloading_queued) {
+        this->close_all_open_tags();
+        bool closing = this->open_documents.size() == 0;
+
+        // Nobody needs the tags anymore, so stop listing them
+        if(closing && this->fetcher_thread) {
+            this->reload_after_cancel = false;
+            this->fetcher_thread->cancel();
             this->fetcher_thread->wait();
         }
 
-        this->close_all_open_tags();
-        event->setAccepted(this->open_documents.size() == 0);
+        event->setAccepted(closing);
+    }
+
+    void TagTreeWindow::watch_tag_directories() {
+        // Stop watching everything from the last listing
+        auto old_directories = this->tag_watcher->directories();
+        if(!old_directories.isEmpty()) {
+            this->tag_watcher->removePaths(old_directories);
+        }
+        this->watched_directories.clear();
+        this->changed_directories.clear();
+        this->tag_watcher_timer->stop();
+
+        // Fast listing mode lists directories as they're opened, so there's nothing to keep up to date
+        if(this->fast_listing) {
+            return;
+        }
+
+        QStringList directories;
+        for(std::size_t i = 0; i < this->paths.size(); i++) {
+            auto directory = File::remove_trailing_slashes(this->paths[i].string());
+            if(this->watched_directories.emplace(directory, i).second) {
+                directories.append(QString::fromStdString(directory));
+            }
+        }
+        if(!directories.isEmpty()) {
+            this->tag_watcher->addPaths(directories);
+        }
+
+        this->watch_tag_parent_directories(0);
+    }
+
+    void TagTreeWindow::watch_tag_parent_directories(std::size_t first_tag) {
+        // Walk up from each tag until we hit a directory we're already watching (at worst, the tags directory itself)
+        QStringList directories;
+        for(std::size_t t = first_tag; t < this->all_tags.size(); t++) {
+            auto &tag = this->all_tags[t];
+            auto root_length = File::remove_trailing_slashes(this->paths[tag.tag_directory].string()).size();
+            for(auto directory = tag.full_path.parent_path(); directory.string().size() > root_length; directory = directory.parent_path()) {
+                auto directory_str = directory.string();
+                if(!this->watched_directories.emplace(directory_str, tag.tag_directory).second) {
+                    break;
+                }
+                directories.append(QString::fromStdString(directory_str));
+            }
+        }
+        if(!directories.isEmpty()) {
+            this->tag_watcher->addPaths(directories);
+        }
+    }
+
+    void TagTreeWindow::directory_changed(const QString &directory) {
+        this->changed_directories.emplace(directory.toStdString());
+        this->tag_watcher_timer->start();
+    }
+
+    void TagTreeWindow::apply_directory_changes() {
+        auto changed_directories = std::move(this->changed_directories);
+        this->changed_directories.clear();
+
+        // Tags in here may have been modified or removed, so they need to be parsed again
+        for(auto &directory : changed_directories) {
+            this->tag_cache.invalidate_directory(directory);
+        }
+
+        // If we're still listing, the listing may have already gone past these directories, so start it over
+        if(this->tags_reloading_queued) {
+            this->reload_tags(true);
+            return;
+        }
+
+        if(this->fast_listing) {
+            return;
+        }
+
+        bool tags_changed = false;
+        for(auto &directory : changed_directories) {
+            tags_changed = this->apply_directory_change(directory) || tags_changed;
+        }
+
+        // Only rebuild the view if a tag was actually added or removed (not if one was just saved)
+        if(tags_changed) {
+            this->set_count_label(this->all_tags.size());
+            emit tags_reloaded(this);
+        }
+    }
+
+    bool TagTreeWindow::apply_directory_change(const std::string &directory) {
+        auto watched = this->watched_directories.find(directory);
+        if(watched == this->watched_directories.end()) {
+            return false;
+        }
+        std::size_t tag_directory = watched->second;
+        std::filesystem::path directory_path(directory);
+
+        // See what's in the directory now
+        std::set<std::filesystem::path> files;
+        std::set<std::filesystem::path> subdirectories;
+        std::error_code ec;
+        if(std::filesystem::is_directory(directory_path, ec)) {
+            try {
+                for(auto &d : std::filesystem::directory_iterator(directory_path)) {
+                    if(d.is_directory()) {
+                        subdirectories.emplace(d.path());
+                    }
+                    else if(d.path().has_extension() && d.is_regular_file()) {
+                        files.emplace(d.path());
+                    }
+                }
+            }
+            catch(std::exception &e) {
+                eprintf_error("Error listing %s: %s", directory.c_str(), e.what());
+                return false;
+            }
+        }
+
+        // Remove tags that are gone, either directly in here or in a subdirectory that's gone. Anything left in files
+        // afterwards is new.
+        auto old_tag_count = this->all_tags.size();
+        this->all_tags.erase(std::remove_if(this->all_tags.begin(), this->all_tags.end(), [&tag_directory, &directory_path, &files, &subdirectories](const File::TagFile &tag) {
+            if(tag.tag_directory != tag_directory) {
+                return false;
+            }
+            auto relative = tag.full_path.lexically_relative(directory_path);
+            if(relative.empty() || *relative.begin() == "..") {
+                return false;
+            }
+            if(std::next(relative.begin()) == relative.end()) {
+                return files.erase(tag.full_path) == 0;
+            }
+            return subdirectories.find(directory_path / *relative.begin()) == subdirectories.end();
+        }), this->all_tags.end());
+        bool tags_changed = this->all_tags.size() != old_tag_count;
+
+        // Stop watching subdirectories that are gone
+        QStringList removed_directories;
+        auto directory_prefix = (directory_path / "").string();
+        for(auto w = this->watched_directories.lower_bound(directory_prefix); w != this->watched_directories.end() && w->first.compare(0, directory_prefix.size(), directory_prefix) == 0;) {
+            auto relative = std::filesystem::path(w->first).lexically_relative(directory_path);
+            if(w->second == tag_directory && subdirectories.find(directory_path / *relative.begin()) == subdirectories.end()) {
+                removed_directories.append(QString::fromStdString(w->first));
+                w = this->watched_directories.erase(w);
+            }
+            else {
+                w++;
+            }
+        }
+        if(!removed_directories.isEmpty()) {
+            this->tag_watcher->removePaths(removed_directories);
+        }
+
+        // Add the new tags
+        auto first_new_tag = this->all_tags.size();
+        auto &tags_directory = this->paths[tag_directory];
+        auto add_tag = [this, &tag_directory, &tags_directory](const std::filesystem::path &file_path) {
+            auto extension = file_path.extension().string();
+            auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
+            if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
+                return;
+            }
+            auto tag_path = File::file_path_to_tag_path(file_path, tags_directory);
+            if(!tag_path.has_value()) {
+                return;
+            }
+
+            auto &tag = this->all_tags.emplace_back();
+            tag.full_path = file_path;
+            tag.tag_path = std::move(*tag_path);
+            tag.tag_directory = tag_directory;
+            tag.tag_fourcc = tag_fourcc;
+        };
+        for(auto &file : files) {
+            add_tag(file);
+        }
+
+        // New subdirectories need to be listed (they may have been moved here with tags already in them)
+        QStringList new_directories;
+        for(auto &subdirectory : subdirectories) {
+            auto subdirectory_str = subdirectory.string();
+            if(!this->watched_directories.emplace(subdirectory_str, tag_directory).second) {
+                continue;
+            }
+            new_directories.append(QString::fromStdString(subdirectory_str));
+            for(auto &tag : File::load_virtual_tag_folder({ subdirectory }, false)) {
+                add_tag(tag.full_path);
+            }
+        }
+        if(!new_directories.isEmpty()) {
+            this->tag_watcher->addPaths(new_directories);
+        }
+        this->watch_tag_parent_directories(first_new_tag);
+
+        return tags_changed || this->all_tags.size() != first_new_tag;
     }
 
     void TagTreeWindow::on_double_click(QTreeWidgetItem *, int) {
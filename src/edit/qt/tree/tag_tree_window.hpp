@@ -7,15 +7,21 @@
 #include <QTreeWidgetItem>
 #include <vector>
 #include <filesystem>
+#include <atomic>
+#include <map>
+#include <set>
 #include <QObject>
 #include <QThread>
 #include <invader/file/file.hpp>
 
 #include "../editor/tag_editor_window.hpp"
+#include "../editor/tag_editor_cache.hpp"
 
 class QTreeWidget;
 class QMenu;
 class QLabel;
+class QFileSystemWatcher;
+class QTimer;
 
 namespace Invader::EditQt {
     class TagTreeWidget;
@@ -25,6 +31,21 @@ namespace Invader::EditQt {
     public:
         TagFetcherThread(QObject *parent, const std::vector<std::filesystem::path> &all_paths);
 
+        /**
+         * Stop listing as soon as possible. fetch_finished is still emitted, but with no tags.
+         */
+        void cancel() noexcept {
+            this->cancelled = true;
+        }
+
+        /**
+         * Get whether or not the listing was cancelled
+         * @return true if cancelled
+         */
+        bool is_cancelled() const noexcept {
+            return this->cancelled;
+        }
+
     signals:
         void tag_count_changed(std::pair<std::mutex, std::size_t> *new_count);
         void fetch_finished(const std::vector<File::TagFile> *tags, int errors);
@@ -34,7 +55,7 @@ namespace Invader::EditQt {
         std::vector<std::filesystem::path> all_paths;
         std::vector<File::TagFile> all_tags;
         std::pair<std::mutex, std::size_t> statuser;
-        std::size_t last_tag_count;
+        std::atomic<bool> cancelled = false;
     };
 
     class TagTreeWindow : public QMainWindow {
@@ -115,6 +136,30 @@ namespace Invader::EditQt {
             return this->fast_listing;
         }
 
+        /**
+         * Set how often modified tags are automatically saved
+         * @param seconds interval in seconds, or 0 to disable
+         */
+        void set_autosave_interval(unsigned int seconds) noexcept {
+            this->autosave_seconds = seconds;
+        }
+
+        /**
+         * Get how often modified tags are automatically saved
+         * @return interval in seconds, or 0 if disabled
+         */
+        unsigned int autosave_interval() const noexcept {
+            return this->autosave_seconds;
+        }
+
+        /**
+         * Get the parsed tags shared by all open editor windows
+         * @return tag cache
+         */
+        TagEditorCache &get_tag_cache() noexcept {
+            return this->tag_cache;
+        }
+
         virtual void closeEvent(QCloseEvent *event);
         virtual void paintEvent(QPaintEvent *event);
 
@@ -173,6 +218,21 @@ namespace Invader::EditQt {
         /** Set count label */
         void set_count_label(std::size_t count);
 
+        /** Watch the tags directories and every directory tags were found in */
+        void watch_tag_directories();
+
+        /** Watch the directories leading to the tags starting at the given index */
+        void watch_tag_parent_directories(std::size_t first_tag);
+
+        /** A watched directory changed; apply it once things settle down */
+        void directory_changed(const QString &directory);
+
+        /** Update the tags for every directory that changed */
+        void apply_directory_changes();
+
+        /** Update the tags directly in the given directory (and in any subdirectories added or removed); return true if anything changed */
+        bool apply_directory_change(const std::string &directory);
+
         #ifdef SHOW_NIGHTLY_LINK
         /** Nightly build? */
         void show_nightly_build();
@@ -199,16 +259,24 @@ namespace Invader::EditQt {
         QLabel *tag_opening_label;
 
         std::vector<std::unique_ptr<TagEditorWindow>> open_documents;
+        TagEditorCache tag_cache;
         void on_double_click(QTreeWidgetItem *item, int column);
 
         bool initial_load = false;
         bool tags_reloading_queued = false;
+        bool reload_after_cancel = false;
 
         bool safeguards_set = true;
+        unsigned int autosave_seconds = 0;
 
         bool opening_tag = false;
 
-        TagFetcherThread *fetcher_thread;
+        TagFetcherThread *fetcher_thread = nullptr;
+
+        QFileSystemWatcher *tag_watcher;
+        QTimer *tag_watcher_timer;
+        std::map<std::string, std::size_t> watched_directories; // directory -> tags directory index
+        std::set<std::string> changed_directories;
         QWidget *filter_widget;
         QLineEdit *filter_textbox;
         
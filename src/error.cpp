@@ -2,6 +2,8 @@
 
 #include <invader/error.hpp>
 #include <invader/printf.hpp>
+#include <cstdarg>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -52,3 +54,40 @@ void set_up_color_term() noexcept {
 bool is_on_color_term() noexcept {
     return on_color_term;
 }
+
+void print_colored_line(std::FILE *file, const char *color, const char *format, ...) noexcept {
+    // Format it into one buffer with the color and newline so it can be written in one call
+    char stack_buffer[1024];
+    std::vector<char> heap_buffer;
+    char *buffer = stack_buffer;
+    std::size_t buffer_size = sizeof(stack_buffer);
+
+    auto *prefix = on_color_term ? color : "";
+    auto *suffix = on_color_term ? "\x1B[m\n" : "\n";
+    std::size_t prefix_length = std::strlen(prefix);
+    std::size_t suffix_length = std::strlen(suffix);
+
+    std::va_list args;
+    va_start(args, format);
+    std::va_list args_copy;
+    va_copy(args_copy, args);
+    int message_length = std::vsnprintf(buffer + prefix_length, buffer_size - prefix_length, format, args);
+    va_end(args);
+    if(message_length < 0) {
+        va_end(args_copy);
+        return;
+    }
+
+    std::size_t total_length = prefix_length + static_cast<std::size_t>(message_length) + suffix_length;
+    if(total_length + 1 > buffer_size) {
+        heap_buffer.resize(total_length + 1);
+        buffer = heap_buffer.data();
+        buffer_size = heap_buffer.size();
+        std::vsnprintf(buffer + prefix_length, buffer_size - prefix_length, format, args_copy);
+    }
+    va_end(args_copy);
+
+    std::memcpy(buffer, prefix, prefix_length);
+    std::memcpy(buffer + prefix_length + message_length, suffix, suffix_length);
+    std::fwrite(buffer, 1, total_length, file);
+}
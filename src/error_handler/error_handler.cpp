@@ -1,6 +1,7 @@
 #include <invader/error_handler/error_handler.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <string>
 
 #ifdef USES_NIX_COLORS
 #include <sys/ioctl.h>
@@ -15,6 +16,10 @@
 
 namespace Invader {
     void ErrorHandler::report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index) {
+        if(!this->is_reported(type)) {
+            return;
+        }
+
         // Print the right column (description)
         std::size_t terminal_width = 80;
         
@@ -102,33 +107,40 @@ namespace Invader {
             } \
         }
         
+        // Put the whole report together first and write it all at once so reports from different threads don't get mixed together
+        std::string report;
+        const char *color = nullptr;
+        auto append_line = [&report, &color](const char *, const char *line) {
+            if(is_on_color_term()) {
+                report += color;
+                report += line;
+                report += "\x1B[m\n";
+            }
+            else {
+                report += line;
+                report += "\n";
+            }
+        };
+
         switch(type) {
             case ErrorType::ERROR_TYPE_WARNING_PEDANTIC:
-                if(this->reporting_level <= ReportingLevel::REPORTING_LEVEL_HIDE_ALL_PEDANTIC_WARNINGS) {
-                    return;
-                }
-                WRITE_ERROR_MESSAGE_WRAPPED(eprintf_warn_lesser, "WARNING (minor): %s", error);
+                color = "\x1B[1;35m";
+                WRITE_ERROR_MESSAGE_WRAPPED(append_line, "WARNING (minor): %s", error);
                 this->warnings++;
                 break;
             case ErrorType::ERROR_TYPE_WARNING:
-                if(this->reporting_level <= ReportingLevel::REPORTING_LEVEL_HIDE_ALL_WARNINGS) {
-                    return;
-                }
-                WRITE_ERROR_MESSAGE_WRAPPED(eprintf_warn, "WARNING: %s", error);
+                color = "\x1B[1;33m";
+                WRITE_ERROR_MESSAGE_WRAPPED(append_line, "WARNING: %s", error);
                 this->warnings++;
                 break;
             case ErrorType::ERROR_TYPE_ERROR:
-                if(this->reporting_level <= ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING) {
-                    return;
-                }
-                WRITE_ERROR_MESSAGE_WRAPPED(eprintf_error, "ERROR: %s", error);
+                color = "\x1B[1;31m";
+                WRITE_ERROR_MESSAGE_WRAPPED(append_line, "ERROR: %s", error);
                 this->errors++;
                 break;
             case ErrorType::ERROR_TYPE_FATAL_ERROR:
-                if(this->reporting_level <= ReportingLevel::REPORTING_LEVEL_HIDE_EVERYTHING) {
-                    return;
-                }
-                WRITE_ERROR_MESSAGE_WRAPPED(eprintf_error, "FATAL ERROR: %s", error);
+                color = "\x1B[1;31m";
+                WRITE_ERROR_MESSAGE_WRAPPED(append_line, "FATAL ERROR: %s", error);
                 this->errors++;
                 break;
         }
@@ -141,8 +153,14 @@ namespace Invader {
                 std::terminate();
             }
             auto &tag = this->tag_paths[index];
-            eprintf("...in %s.%s\n", File::halo_path_to_preferred_path(tag.path).c_str(), tag_fourcc_to_extension(tag.fourcc));
+            report += "...in ";
+            report += File::halo_path_to_preferred_path(tag.path);
+            report += ".";
+            report += tag_fourcc_to_extension(tag.fourcc);
+            report += "\n";
         }
+
+        std::fwrite(report.data(), 1, report.size(), stderr);
     }
     
     ErrorHandler::ErrorHandler(ReportingLevel reporting_level) noexcept : reporting_level(reporting_level) {}
@@ -10,6 +10,7 @@
 #include <invader/extract/extraction.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/thread_pool.hpp>
 #include <regex>
 
 int main(int argc, const char **argv) {
@@ -30,6 +31,7 @@ int main(int argc, const char **argv) {
         bool overwrite = false;
         bool non_mp_globals = false;
         bool ignore_resource_maps = false;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } extract_options;
 
     // Command line options
@@ -42,7 +44,8 @@ int main(int argc, const char **argv) {
         CommandLineOption("ignore-resources", 'G', 0, "Ignore resource maps."),
         CommandLineOption("search", 's', 1, "Search for tags (* and ? are wildcards) and extract these. Use multiple times for multiple queries. If unspecified, all tags will be extracted.", "<expr>"),
         CommandLineOption("search-exclude", 'e', 1, "Search for tags (* and ? are wildcards) and ignore these. Use multiple times for multiple queries. This takes precedence over --search.", "<expr>"),
-        CommandLineOption("non-mp-globals", 'n', 0, "Enable extraction of non-multiplayer .globals")
+        CommandLineOption("non-mp-globals", 'n', 0, "Enable extraction of non-multiplayer .globals"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Extract data from cache files.";
@@ -79,6 +82,9 @@ int main(int argc, const char **argv) {
             case 'e':
                 extract_options.search_queries_exclude.emplace_back(File::preferred_path_to_halo_path(args[0]));
                 break;
+            case 'j':
+                extract_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
             case 'i':
                 Invader::show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -102,7 +108,7 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    std::vector<std::byte> loc, bitmaps, sounds;
+    std::optional<ResourceMapView> loc, bitmaps, sounds;
 
     // Find the asset data
     if(!extract_options.maps_directory.has_value()) {
@@ -116,17 +122,20 @@ int main(int argc, const char **argv) {
     // Load resource maps
     if(extract_options.maps_directory.has_value() && !extract_options.ignore_resource_maps) {
         std::filesystem::path maps_directory(*extract_options.maps_directory);
-        auto open_map_possibly = [&maps_directory](const char *map) -> std::vector<std::byte> {
+        auto open_map_possibly = [&maps_directory](const char *map) -> std::optional<ResourceMapView> {
             auto path = maps_directory / map;
             if(!std::filesystem::exists(path)) {
-                return std::vector<std::byte>();
+                return std::nullopt;
+            }
+            try {
+                return ResourceMapView::map_file(path);
             }
-            auto potential_map = Invader::File::open_file(maps_directory / map);
-            if(potential_map.has_value()) {
-                return *potential_map;
+            catch(FailedToOpenFileException &) {
+                return std::nullopt;
             }
-            else {
-                return std::vector<std::byte>();
+            catch(std::exception &e) {
+                eprintf_warn("Failed to read %s: %s", path.string().c_str(), e.what());
+                return std::nullopt;
             }
         };
 
@@ -163,16 +172,18 @@ int main(int argc, const char **argv) {
         }
     }
 
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(extract_options.thread_count);
+
     // Load map
     std::unique_ptr<Map> map;
     try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file), std::move(bitmaps), std::move(loc), std::move(sounds)));
+        map = std::make_unique<Map>(Map::map_with_mmap(std::filesystem::path(remaining_arguments[0]), std::move(bitmaps), std::move(loc), std::move(sounds)));
     }
     catch (std::exception &e) {
         eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
         return EXIT_FAILURE;
     }
 
-    ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.search_queries_exclude, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals);
+    ExtractionWorkload::extract_map(*map, *extract_options.tags_directory, extract_options.search_queries, extract_options.search_queries_exclude, extract_options.recursive, extract_options.overwrite, extract_options.non_mp_globals, ErrorHandler::ReportingLevel::REPORTING_LEVEL_ALL, extract_options.thread_count);
 }
@@ -1,13 +1,17 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <regex>
-#include <invader/build/build_workload.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <invader/thread_pool.hpp>
+#include <invader/file/file.hpp>
+#include <invader/file/file_writer.hpp>
 #include <invader/extract/extraction.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/parser/parser.hpp>
 
 namespace Invader {
-    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level) {
+    void ExtractionWorkload::extract_map(const Map &map, const std::string &tags, const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, bool recursive, bool overwrite, bool non_mp_globals, ReportingLevel reporting_level, std::size_t thread_count) {
         // There's no need to extract recursively if we're extracting all tags
         if(queries.size() == 0) {
             recursive = false;
@@ -15,7 +19,7 @@ namespace Invader {
 
         ExtractionWorkload workload(map, reporting_level);
         auto start = std::chrono::steady_clock::now();
-        auto success = workload.perform_extraction(queries, queries_exclude, tags, recursive, overwrite, non_mp_globals);
+        auto success = workload.perform_extraction(queries, queries_exclude, tags, recursive, overwrite, non_mp_globals, thread_count);
         auto matched = workload.matched_tags.size();
         auto warnings = workload.get_warnings();
         auto errors = workload.get_errors();
@@ -47,7 +51,7 @@ namespace Invader {
         }
     }
 
-    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals) {
+    std::size_t ExtractionWorkload::perform_extraction(const std::vector<std::string> &queries, const std::vector<std::string> &queries_exclude, const std::filesystem::path &tags, bool recursive, bool overwrite, bool non_mp_globals, std::size_t thread_count) {
         // Set these variables up
         auto *map = &this->map;
         auto type = map->get_type();
@@ -55,6 +59,21 @@ namespace Invader {
         std::vector<bool> extracted_tags(tag_count);
         std::deque<std::size_t> all_tags_to_extract;
         auto &workload = *this;
+
+        // Tags are extracted on multiple threads, so anything that touches the queue, the error handler, or the
+        // terminal needs to hold this
+        std::mutex extraction_mutex;
+        struct LockedReporter {
+            ExtractionWorkload &workload;
+            std::mutex &mutex;
+            bool is_reported(ErrorType type) const noexcept {
+                return this->workload.is_reported(type);
+            }
+            void report_error(ErrorType type, const char *error, std::optional<std::size_t> tag_index = std::nullopt) {
+                std::scoped_lock lock(this->mutex);
+                this->workload.report_error(type, error, tag_index);
+            }
+        } reporter = { workload, extraction_mutex };
         auto engine = map->get_cache_version();
 
         auto &scenario_tag = map->get_tag(map->get_scenario_tag_id()).get_base_struct<HEK::Scenario>();
@@ -77,9 +96,9 @@ namespace Invader {
             }
         }
         
-        auto extract_tag = [&extracted_tags, &map, &tags, &all_tags_to_extract, &type, &recursive, &overwrite, &non_mp_globals, &workload, &engine, &jason_jones, &detail_object_modifiers](std::size_t tag_index) -> bool {
-            // Do it
-            extracted_tags[tag_index] = true;
+        // Extract a tag into new_tag, adding its dependencies to the queue if we're recursive (extraction_mutex must not be locked)
+        auto extract_tag = [&extracted_tags, &map, &tags, &all_tags_to_extract, &type, &recursive, &overwrite, &non_mp_globals, &reporter, &extraction_mutex, &engine, &jason_jones, &detail_object_modifiers](std::size_t tag_index, std::vector<std::byte> &new_tag, std::filesystem::path &tag_path_to_write_to) -> bool {
+            auto &workload = reporter;
 
             // Get the tag path
             const auto &tag = map->get_tag(tag_index);
@@ -100,7 +119,7 @@ namespace Invader {
             auto tfp = File::TagFilePath(Invader::File::halo_path_to_preferred_path(tag_path), tag.get_tag_fourcc());
 
             // Figure out the path we're writing to
-            auto tag_path_to_write_to = Invader::File::tag_path_to_file_path(tfp, tags);
+            tag_path_to_write_to = Invader::File::tag_path_to_file_path(tfp, tags);
 
             if(!overwrite && std::filesystem::exists(tag_path_to_write_to)) {
                 return false;
@@ -113,22 +132,19 @@ namespace Invader {
             }
 
             // Get the tag data
-            std::vector<std::byte> new_tag;
             try {
                 new_tag = Invader::ExtractionWorkload::extract_single_tag(tag);
 
-                // If we're recursive, we want to also get that stuff, too
+                // If we're recursive, we want to also get that stuff, too (only the references are needed, so don't bother
+                // compiling the tag to find them)
                 if(recursive) {
-                    auto tag_compiled = BuildWorkload::compile_single_tag(new_tag.data(), new_tag.size(), std::vector<std::filesystem::path>(), false);
-                    std::vector<std::pair<const std::string *, Invader::TagFourCC>> dependencies;
-                    for(auto &s : tag_compiled.structs) {
-                        for(auto &d : s.dependencies) {
-                            auto &tag = tag_compiled.tags[d.tag_index];
-                            dependencies.emplace_back(&tag.path, tag.tag_fourcc);
-                        }
-                    }
+                    std::vector<std::pair<std::string, Invader::TagFourCC>> dependencies;
+                    Parser::ParserStruct::scan_hek_tag_file_dependencies(new_tag.data(), new_tag.size(), [&dependencies](TagFourCC tag_fourcc, const char *path, std::size_t) {
+                        dependencies.emplace_back(File::remove_duplicate_slashes(path), tag_fourcc);
+                    });
+                    std::scoped_lock lock(extraction_mutex);
                     for(auto &d : dependencies) {
-                        auto tag_index = map->find_tag(d.first->c_str(), d.second);
+                        auto tag_index = map->find_tag(d.first.c_str(), d.second);
                         if(tag_index.has_value() && extracted_tags[*tag_index] == false) {
                             all_tags_to_extract.push_back(*tag_index);
                         }
@@ -244,17 +260,6 @@ namespace Invader {
                 }
             }
 
-            // Create directories along the way
-            std::error_code ec;
-            std::filesystem::create_directories(tag_path_to_write_to.parent_path(), ec);
-
-            // Save it
-            auto tag_path_str = tag_path_to_write_to.string();
-            if(!Invader::File::save_file(tag_path_str.c_str(), new_tag)) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_ERROR, tag_index, "Failed to save %s", tag_path_str.c_str());
-                return false;
-            }
-
             return true;
         };
 
@@ -266,13 +271,14 @@ namespace Invader {
         }
 
         else {
+            File::PathMatcher query_matcher(queries, queries_exclude);
             for(std::size_t t = 0; t < tag_count; t++) {
                 // Get the full path
                 const auto &tag = map->get_tag(t);
                 auto full_tag_path = tag.get_path() + "." + HEK::tag_fourcc_to_extension(tag.get_tag_fourcc());
 
                 // Match it
-                if(File::path_matches(full_tag_path.c_str(), queries, queries_exclude)) {
+                if(query_matcher.matches(full_tag_path.c_str())) {
                     all_tags_to_extract.emplace_back(t);
                 }
             }
@@ -283,36 +289,79 @@ namespace Invader {
             }
         }
 
-        // Extract tags
-        std::size_t total = 0;
+        // Extracted tags are written on their own threads so the workers can keep extracting, and tags that are already
+        // extracted with the same data aren't written again
         std::size_t extracted = 0;
-        while(all_tags_to_extract.size() > 0) {
-            std::size_t tag = all_tags_to_extract[0];
-            all_tags_to_extract.erase(all_tags_to_extract.begin());
-            if(extracted_tags[tag]) {
-                continue;
-            }
-            const auto &tag_map = map->get_tag(tag);
-            auto path_dot = File::TagFilePath(File::halo_path_to_preferred_path(tag_map.get_path()), tag_map.get_tag_fourcc());
+        auto path_dot_of = [&map](std::size_t tag_index) {
+            const auto &tag_map = map->get_tag(tag_index);
+            return File::TagFilePath(File::halo_path_to_preferred_path(tag_map.get_path()), tag_map.get_tag_fourcc()).join();
+        };
+        thread_count = std::max(thread_count, static_cast<std::size_t>(1));
+        File::FileWriter writer(thread_count, thread_count * 2, true);
+
+        // Extract tags; tags found while extracting (if recursive) are added to the queue, so we're only done when the
+        // queue is empty and no worker is still extracting something
+        std::condition_variable extract_queue_changed;
+        std::size_t workers_extracting = 0;
+        auto extract_worker = [&]() {
+            std::unique_lock lock(extraction_mutex);
+            while(true) {
+                extract_queue_changed.wait(lock, [&all_tags_to_extract, &workers_extracting]() { return !all_tags_to_extract.empty() || workers_extracting == 0; });
+                if(all_tags_to_extract.empty()) {
+                    return;
+                }
 
-            // Do it!
-            bool result;
-            try {
-                result = extract_tag(tag);
-            }
-            catch(std::exception &e) {
-                eprintf_error("Error while extracting %s: %s", path_dot.join().c_str(), e.what());
-                result = false;
-            }
-            if(result) {
-                oprintf_success("Extracted %s", path_dot.join().c_str());
-                extracted++;
-            }
-            else {
-                oprintf("Skipped %s\n", path_dot.join().c_str());
+                std::size_t tag = all_tags_to_extract.front();
+                all_tags_to_extract.pop_front();
+                if(extracted_tags[tag]) {
+                    continue;
+                }
+                extracted_tags[tag] = true;
+                workers_extracting++;
+                lock.unlock();
+
+                // Do it!
+                bool result;
+                std::vector<std::byte> data;
+                std::filesystem::path path;
+                try {
+                    result = extract_tag(tag, data, path);
+                }
+                catch(std::exception &e) {
+                    std::scoped_lock lock_print(extraction_mutex);
+                    eprintf_error("Error while extracting %s: %s", path_dot_of(tag).c_str(), e.what());
+                    result = false;
+                }
+
+                // Don't hold the lock while queueing it, since the writer needs it to report the tag once it's written
+                if(result) {
+                    writer.write(std::move(path), std::move(data), [&extraction_mutex, &extracted, &reporter, &path_dot_of, tag](const std::filesystem::path &path, bool saved) {
+                        if(!saved) {
+                            REPORT_ERROR_PRINTF(reporter, ERROR_TYPE_ERROR, tag, "Failed to save %s", path.string().c_str());
+                            std::scoped_lock lock_print(extraction_mutex);
+                            oprintf("Skipped %s\n", path_dot_of(tag).c_str());
+                            return;
+                        }
+                        std::scoped_lock lock_print(extraction_mutex);
+                        oprintf_success("Extracted %s", path_dot_of(tag).c_str());
+                        extracted++;
+                    });
+                }
+
+                lock.lock();
+                if(!result) {
+                    oprintf("Skipped %s\n", path_dot_of(tag).c_str());
+                }
+                workers_extracting--;
+                extract_queue_changed.notify_all();
             }
-        }
+        };
 
+        ThreadPool::shared().parallel_for(thread_count, [&extract_worker](std::size_t) { extract_worker(); }, thread_count);
+
+        writer.finish();
+
+        std::size_t total = 0;
         this->matched_tags.reserve(total);
         for(std::size_t i = 0; i < tag_count; i++) {
             if(extracted_tags[i]) {
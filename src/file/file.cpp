@@ -5,13 +5,21 @@
 #endif
 
 #include <invader/file/file.hpp>
+#include <invader/file/tag_bundle.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/error.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 
 #include <cstdio>
 #include <filesystem>
 #include <cstring>
 #include <climits>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <unordered_set>
+#include <variant>
 
 namespace Invader::File {
     std::optional<std::vector<std::byte>> open_file(const std::filesystem::path &path) {
@@ -19,6 +27,12 @@ namespace Invader::File {
         auto path_string = path.string();
         std::FILE *file = std::fopen(path.string().c_str(), "rb");
         if(!file) {
+            // It might be in a tag bundle instead
+            auto bundled = TagBundle::open_bundled_file(path);
+            if(bundled.has_value()) {
+                return bundled;
+            }
+
             eprintf("Error: Failed to open %s for reading.\n", path_string.c_str());
             return std::nullopt;
         }
@@ -92,11 +106,32 @@ namespace Invader::File {
         std::fclose(f);
         return true;
     }
+
+    std::optional<std::uint64_t> stamp_file(const std::filesystem::path &path) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if(ec) {
+            return std::nullopt;
+        }
+        auto time = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        if(ec) {
+            return std::nullopt;
+        }
+
+        return FNV1AHash().add_value(size).add_value(time).get();
+    }
     
     std::optional<std::filesystem::path> tag_path_to_file_path(const std::string &tag_path, const std::vector<std::filesystem::path> &tags) {
         for(auto &i : tags) {
             auto path = tag_path_to_file_path(tag_path, i);
-            if(std::filesystem::exists(path)) {
+
+            // Tags in a bundle are found in its index rather than on the filesystem
+            if(auto bundle = TagBundle::get_bundle(i)) {
+                if(bundle->contains(tag_path)) {
+                    return path;
+                }
+            }
+            else if(std::filesystem::exists(path)) {
                 return path;
             }
         }
@@ -182,6 +217,11 @@ namespace Invader::File {
     constexpr char SYSTEM_PATH_SEPARATOR = INVADER_PREFERRED_PATH_SEPARATOR;
     constexpr char HALO_PATH_SEPARATOR = '\\';
     constexpr char PORTABLE_PATH_SEPARATOR = '/';
+    constexpr char PATH_SEPARATORS[] = { HALO_PATH_SEPARATOR, PORTABLE_PATH_SEPARATOR, SYSTEM_PATH_SEPARATOR, 0 };
+
+    static bool is_path_separator(char c) noexcept {
+        return c == '/' || c == '\\' || c == INVADER_PREFERRED_PATH_SEPARATOR;
+    }
 
     void halo_path_to_preferred_path_chars(char *tag_path) noexcept {
         for(char *c = tag_path; *c != 0; c++) {
@@ -200,17 +240,15 @@ namespace Invader::File {
     }
 
     std::string halo_path_to_preferred_path(const std::string &tag_path) {
-        const char *tag_path_c = tag_path.c_str();
-        std::vector<char> tag_path_cv(tag_path_c, tag_path_c + tag_path.size() + 1);
-        halo_path_to_preferred_path_chars(tag_path_cv.data());
-        return tag_path_cv.data();
+        std::string preferred_path(tag_path.c_str());
+        halo_path_to_preferred_path_chars(preferred_path.data());
+        return preferred_path;
     }
 
     std::string preferred_path_to_halo_path(const std::string &tag_path) {
-        const char *tag_path_c = tag_path.c_str();
-        std::vector<char> tag_path_cv(tag_path_c, tag_path_c + tag_path.size() + 1);
-        preferred_path_to_halo_path_chars(tag_path_cv.data());
-        return tag_path_cv.data();
+        std::string halo_path(tag_path.c_str());
+        preferred_path_to_halo_path_chars(halo_path.data());
+        return halo_path;
     }
 
     const char *base_name_chars(const char *tag_path) noexcept {
@@ -228,21 +266,23 @@ namespace Invader::File {
         return const_cast<char *>(base_name_chars(const_cast<const char *>(tag_path)));
     }
 
-    std::string base_name(const std::string &tag_path, bool drop_extension) {
-        const char *base_name = base_name_chars(tag_path.c_str());
+    std::string_view base_name_view(std::string_view tag_path, bool drop_extension) noexcept {
+        auto separator = tag_path.find_last_of(PATH_SEPARATORS);
+        if(separator != std::string_view::npos) {
+            tag_path.remove_prefix(separator + 1);
+        }
 
         if(drop_extension) {
-            const char *base_name_end = nullptr;
-            for(const char *c = base_name; *c; c++) {
-                if(*c == '.') {
-                    base_name_end = c;
-                }
-            }
-            if(base_name_end) {
-                return std::string(base_name, base_name_end);
+            auto extension = tag_path.rfind('.');
+            if(extension != std::string_view::npos) {
+                tag_path = tag_path.substr(0, extension);
             }
         }
-        return std::string(base_name);
+        return tag_path;
+    }
+
+    std::string base_name(const std::string &tag_path, bool drop_extension) {
+        return std::string(base_name_view(tag_path.c_str(), drop_extension));
     }
 
     std::string remove_trailing_slashes(const std::string &path) {
@@ -289,11 +329,7 @@ namespace Invader::File {
         }
     }
 
-    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates, std::pair<std::mutex, std::size_t> *status, std::size_t *errors) {
-        std::vector<TagFile> all_tags;
-        
-        std::size_t new_errors = 0;
-
+    std::vector<TagFile> load_virtual_tag_folder(const std::vector<std::filesystem::path> &tags, bool filter_duplicates, std::pair<std::mutex, std::size_t> *status, std::size_t *errors, const std::atomic<bool> *cancel) {
         std::pair<std::mutex, std::size_t> status_r;
         if(status == nullptr) {
             status = &status_r;
@@ -301,138 +337,221 @@ namespace Invader::File {
         status->first.lock();
         status->second = 0;
         status->first.unlock();
-        
-        #define maybe_iterate_directories(file_path, ...) try { \
-            iterate_directories(__VA_ARGS__); \
-        } \
-        catch(std::exception &e) { \
-            eprintf_error("Error listing %s: %s", file_path.string().c_str(), e.what()); \
-            new_errors++; \
-        }
-        
-        // win32 implementation because Windows I/O is AWFUL
-        #ifdef _WIN32
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
-            if(++depth == 256) {
+
+        // Each directory is listed on its own so directories can be listed on multiple threads. Subdirectories are
+        // recorded where they were found so the results can be put back in the same order as a recursive walk.
+        struct DirectoryJob {
+            std::filesystem::path path;
+            int depth;
+            std::size_t priority;
+            std::vector<std::variant<TagFile, std::size_t>> entries;
+        };
+
+        std::deque<DirectoryJob> jobs;
+        std::size_t next_job = 0;
+        std::size_t jobs_running = 0;
+        std::size_t new_errors = 0;
+        std::mutex job_mutex;
+        std::condition_variable job_cv;
+
+        std::vector<std::filesystem::path> main_dirs;
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            auto &d = main_dirs.emplace_back(remove_trailing_slashes(tags[i].string()));
+            jobs.emplace_back(DirectoryJob { d, 1, i, {} });
+        }
+
+        // Queue a subdirectory and return its job index
+        auto add_directory = [&jobs, &job_mutex, &job_cv](const std::filesystem::path &path, const DirectoryJob &parent) -> std::size_t {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            std::size_t index = jobs.size();
+            jobs.emplace_back(DirectoryJob { path, parent.depth + 1, parent.priority, {} });
+            job_cv.notify_one();
+            return index;
+        };
+
+        auto add_tag = [&main_dirs](const std::filesystem::path &file_path, DirectoryJob &job, std::size_t &tags_found) {
+            auto extension = file_path.extension().string();
+            auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
+
+            // First, make sure it's valid
+            if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
                 return;
             }
-            
-            WIN32_FIND_DATA find_data;
-            HANDLE file = FindFirstFileA((dir / "*").string().c_str(), &find_data);
-            bool found = file != nullptr;
-            
+
+            // Next, add it
+            TagFile file;
+            file.full_path = file_path;
+            file.tag_fourcc = tag_fourcc;
+            file.tag_directory = job.priority;
+            file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), std::vector<std::filesystem::path>(&main_dirs[job.priority], &main_dirs[job.priority] + 1)).value();
+            job.entries.emplace_back(std::move(file));
+            tags_found++;
+        };
+
+        // win32 implementation because Windows I/O is AWFUL
+        #ifdef _WIN32
+        auto list_directory = [&add_directory, &add_tag](DirectoryJob &job) -> std::size_t {
             std::size_t tags_found = 0;
-            
+
+            WIN32_FIND_DATA find_data;
+            HANDLE file = FindFirstFileA((job.path / "*").string().c_str(), &find_data);
+            bool found = file != INVALID_HANDLE_VALUE;
+
             while(found) {
                 if(std::strcmp(find_data.cFileName, ".") != 0 && std::strcmp(find_data.cFileName, "..") != 0) {
-                    auto file_path = dir / find_data.cFileName;
+                    auto file_path = job.path / find_data.cFileName;
                     if(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-                        maybe_iterate_directories(file_path, file_path, iterate_directories, depth, priority, main_dir);
+                        if(job.depth + 1 < 256) {
+                            job.entries.emplace_back(add_directory(file_path, job));
+                        }
                     }
                     else {
-                        auto extension = file_path.extension().string();
-                        auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
-
-                        // First, make sure it's valid
-                        if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                            goto spaghetti_next_tag;
-                        }
-
-                        // Next, add it
-                        TagFile file;
-                        file.full_path = file_path;
-                        file.tag_fourcc = tag_fourcc;
-                        file.tag_directory = priority;
-                        file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                        all_tags.emplace_back(std::move(file));
-                        
-                        tags_found++;
+                        add_tag(file_path, job, tags_found);
                     }
                 }
-                
-                spaghetti_next_tag:
                 found = FindNextFileA(file, &find_data);
             }
-            
-            // Update the find count
-            if(tags_found) {
-                status->first.lock();
-                status->second += tags_found;
-                status->first.unlock();
+
+            if(file != INVALID_HANDLE_VALUE) {
+                FindClose(file);
             }
+
+            return tags_found;
         };
         #else
-        auto iterate_directories = [&all_tags, &status, &new_errors](const std::filesystem::path &dir, auto &iterate_directories, int depth, std::size_t priority, const std::vector<std::filesystem::path> &main_dir) -> void {
-            if(++depth == 256) {
-                return;
-            }
-            
+        auto list_directory = [&add_directory, &add_tag](DirectoryJob &job) -> std::size_t {
             std::size_t tags_found = 0;
 
-            for(auto &d : std::filesystem::directory_iterator(dir)) {
-                auto file_path = d.path();
-                
+            for(auto &d : std::filesystem::directory_iterator(job.path)) {
+                auto &file_path = d.path();
+
+                // directory_entry caches the file type from listing the directory, so this doesn't need to stat every file
                 if(d.is_directory()) {
-                    maybe_iterate_directories(file_path, d, iterate_directories, depth, priority, main_dir);
+                    if(job.depth + 1 < 256) {
+                        job.entries.emplace_back(add_directory(file_path, job));
+                    }
                 }
-                else if(file_path.has_extension() && std::filesystem::is_regular_file(file_path)) {
-                    auto extension = file_path.extension().string();
-                    auto tag_fourcc = HEK::tag_extension_to_fourcc(extension.c_str() + 1);
+                else if(file_path.has_extension() && d.is_regular_file()) {
+                    add_tag(file_path, job, tags_found);
+                }
+            }
 
-                    // First, make sure it's valid
-                    if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
-                        continue;
-                    }
+            return tags_found;
+        };
+        #endif
 
-                    // Next, add it
-                    TagFile file;
-                    file.full_path = file_path;
-                    file.tag_fourcc = tag_fourcc;
-                    file.tag_directory = priority;
-                    file.tag_path = Invader::File::file_path_to_tag_path(file_path.string(), main_dir).value();
-                    all_tags.emplace_back(std::move(file));
-                    tags_found++;
+        // Tag bundles are listed from their index
+        auto list_bundle = [](DirectoryJob &job, const TagBundle &bundle) -> std::size_t {
+            std::size_t tags_found = 0;
+            for(auto &tag_path : bundle.get_tag_paths()) {
+                auto preferred_path = halo_path_to_preferred_path(tag_path);
+                auto extension = std::filesystem::path(preferred_path).extension().string();
+                auto tag_fourcc = extension.empty() ? HEK::TagFourCC::TAG_FOURCC_NULL : HEK::tag_extension_to_fourcc(extension.c_str() + 1);
+                if(tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL || tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NONE) {
+                    continue;
                 }
+
+                TagFile file;
+                file.full_path = job.path / preferred_path;
+                file.tag_fourcc = tag_fourcc;
+                file.tag_directory = job.priority;
+                file.tag_path = std::move(preferred_path);
+                job.entries.emplace_back(std::move(file));
+                tags_found++;
             }
-            
-            // Update the find count
-            if(tags_found) {
-                status->first.lock();
-                status->second += tags_found;
-                status->first.unlock();
+            return tags_found;
+        };
+
+        auto work = [&]() {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            while(true) {
+                // Wait until there's a directory to list, or until everything is listed
+                job_cv.wait(lock, [&]() { return next_job < jobs.size() || jobs_running == 0; });
+
+                // If cancelled, stop taking jobs; anything still being listed finishes on its own
+                if(cancel && cancel->load()) {
+                    next_job = jobs.size();
+                }
+
+                if(next_job == jobs.size()) {
+                    job_cv.notify_all();
+                    return;
+                }
+
+                auto &job = jobs[next_job++];
+                jobs_running++;
+                lock.unlock();
+
+                std::size_t tags_found = 0;
+                bool failed = false;
+                try {
+                    auto bundle = job.depth == 1 ? TagBundle::get_bundle(job.path) : nullptr;
+                    tags_found = bundle ? list_bundle(job, *bundle) : list_directory(job);
+                }
+                catch(std::exception &e) {
+                    eprintf_error("Error listing %s: %s", job.path.string().c_str(), e.what());
+                    failed = true;
+                }
+
+                // Update the find count
+                if(tags_found) {
+                    status->first.lock();
+                    status->second += tags_found;
+                    status->first.unlock();
+                }
+
+                lock.lock();
+                jobs_running--;
+                new_errors += failed;
+                if(jobs_running == 0) {
+                    job_cv.notify_all();
+                }
             }
         };
-        #endif
 
-        // Go through each directory
-        std::size_t dir_count = tags.size();
-        for(std::size_t i = 0; i < dir_count; i++) {
-            auto d = std::filesystem::path(remove_trailing_slashes(tags[i].string()));
-            maybe_iterate_directories(d, d, iterate_directories, 0, i, std::vector<std::filesystem::path>(&d, &d + 1));
+        auto &pool = ThreadPool::shared();
+        auto thread_count = pool.get_thread_count();
+        pool.parallel_for(thread_count, [&work](std::size_t) { work(); }, thread_count);
+
+        if(cancel && cancel->load()) {
+            if(errors) {
+                *errors = 0;
+            }
+            return {};
         }
-        
-        // Remove duplicates
+
+        // Put everything back together in the order it was found
+        std::vector<TagFile> all_tags;
+        auto gather = [&jobs, &all_tags](std::size_t job_index, auto &gather) -> void {
+            for(auto &entry : jobs[job_index].entries) {
+                if(auto *tag = std::get_if<TagFile>(&entry)) {
+                    all_tags.emplace_back(std::move(*tag));
+                }
+                else {
+                    gather(std::get<std::size_t>(entry), gather);
+                }
+            }
+        };
+        for(std::size_t i = 0; i < tags.size(); i++) {
+            gather(i, gather);
+        }
+
+        // Remove duplicates, keeping the one in the tags directory with the highest precedence (which comes first)
         if(filter_duplicates) {
+            std::unordered_set<std::string> found;
+            std::size_t kept = 0;
             for(std::size_t i = 0; i < all_tags.size(); i++) {
-                for(std::size_t j = 0; j < i; j++) {
-                    auto &tagi = all_tags[i];
-                    auto &tagj = all_tags[j];
-                    
-                    if(tagi.tag_fourcc == tagj.tag_fourcc && tagi.tag_path == tagj.tag_path) {
-                        if(tagi.tag_directory > tagj.tag_directory) {
-                            all_tags.erase(all_tags.begin() + i);
-                        }
-                        else {
-                            all_tags.erase(all_tags.begin() + j);
-                        }
-                        
-                        i--;
-                        break;
+                auto &tag = all_tags[i];
+                if(found.emplace(tag.tag_path + "." + HEK::tag_fourcc_to_extension(tag.tag_fourcc)).second) {
+                    if(kept != i) {
+                        all_tags[kept] = std::move(tag);
                     }
+                    kept++;
                 }
             }
+            all_tags.resize(kept);
         }
-        
+
         // Change error count if errors was specified
         if(errors) {
             *errors = new_errors;
@@ -468,23 +587,36 @@ namespace Invader::File {
     }
 
 
+    bool has_duplicate_slashes(std::string_view path) noexcept {
+        for(std::size_t i = 1; i < path.size(); i++) {
+            if(is_path_separator(path[i - 1]) && is_path_separator(path[i])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::string remove_duplicate_slashes(const std::string &path) {
-        const char *tag_path_c = path.c_str();
-        std::vector<char> tag_path_cv(tag_path_c, tag_path_c + path.size() + 1);
-        remove_duplicate_slashes_chars(tag_path_cv.data());
-        return tag_path_cv.data();
+        std::string tag_path = path;
+        if(has_duplicate_slashes(tag_path)) {
+            remove_duplicate_slashes_chars(tag_path.data());
+        }
+        tag_path.resize(std::strlen(tag_path.c_str()));
+        return tag_path;
     }
 
     void remove_duplicate_slashes_chars(char *path) {
-        for(char *i = path; *i; i++) {
-            char this_i = i[0];
-            char next_i = i[1];
-            if((this_i == '\\' || this_i == '/' || this_i == INVADER_PREFERRED_PATH_SEPARATOR) && (next_i == '\\' || next_i == '/' || next_i == INVADER_PREFERRED_PATH_SEPARATOR)) {
-                for(char *j = i + 1; *j; j++) {
-                    j[0] = j[1];
-                }
+        auto is_separator = [](char c) { return c == '\\' || c == '/' || c == INVADER_PREFERRED_PATH_SEPARATOR; };
+
+        // Drop the second of each pair of separators in one pass rather than shifting the rest of the string each time
+        char *write = path;
+        for(const char *read = path; *read; read++) {
+            *(write++) = *read;
+            if(is_separator(read[0]) && is_separator(read[1])) {
+                read++;
             }
         }
+        *write = 0;
     }
     
     void check_working_directory(const char *file) {
@@ -503,39 +635,44 @@ namespace Invader::File {
         }
     }
     
+    static bool path_character_matches(char pattern_character, char path_character) noexcept {
+        return pattern_character == '?' || pattern_character == path_character || (is_path_separator(pattern_character) && is_path_separator(path_character));
+    }
+
     bool path_matches(const char *path, const char *pattern) noexcept {
-        for(const char *p = pattern;; p++) {
-            // End of string
-            if(*p == *path && *p == 0) {
-                return true;
-            }
-            else if(
-                (*p == '?' || *p == *path) || 
-                ((*p == '/' || *p == '\\' || *p == INVADER_PREFERRED_PATH_SEPARATOR) && (*path == '\\' || *path == '/' || *path == INVADER_PREFERRED_PATH_SEPARATOR))
-            ) {
-                path++;
-                continue;
-            }
-            else if(*p == '*') {
-                // Skip duplicates
+        // Only the last '*' ever needs to be retried, since anything an earlier one could have matched, the last one can match too
+        const char *p = pattern;
+        const char *star = nullptr;
+        const char *star_path = nullptr;
+
+        while(*path) {
+            if(*p == '*') {
                 while(*p == '*') {
                     p++;
                 }
                 if(*p == 0) {
                     return true;
                 }
-                for(const char *s = path; *s; s++) {
-                    if(path_matches(s, p)) {
-                        return true;
-                    }
-                }
-                return false;
+                star = p;
+                star_path = path;
+            }
+            else if(*p && path_character_matches(*p, *path)) {
+                p++;
+                path++;
+            }
+            else if(star) {
+                p = star;
+                path = ++star_path;
             }
             else {
                 return false;
             }
         }
-        return true;
+
+        while(*p == '*') {
+            p++;
+        }
+        return *p == 0;
     }
     
     bool path_matches(const char *path, const std::vector<std::string> &include, const std::vector<std::string> &exclude) noexcept {
@@ -556,4 +693,107 @@ namespace Invader::File {
         // If include is empty, we're good
         return include.empty();
     }
+
+    // A '*' can also match nothing, so anything at one is also past it
+    static void skip_stars(std::uint64_t *states, const std::uint64_t *star_states, std::size_t word_count) noexcept {
+        std::uint64_t carry = 0;
+        for(std::size_t w = 0; w < word_count; w++) {
+            auto starred = states[w] & star_states[w];
+            states[w] |= (starred << 1) | carry;
+            carry = starred >> 63;
+        }
+    }
+
+    static bool any_states(const std::vector<std::uint64_t> &a, const std::vector<std::uint64_t> &b) noexcept {
+        for(std::size_t w = 0; w < a.size(); w++) {
+            if(a[w] & b[w]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PathMatcher::PathMatcher(const std::vector<std::string> &include, const std::vector<std::string> &exclude) : include_all(include.empty()) {
+        // Each pattern gets one state per character (with runs of '*' collapsed into one) plus one for having matched all of it
+        std::size_t state_count = 0;
+        auto count_states = [&state_count](const std::vector<std::string> &patterns) {
+            for(auto &pattern : patterns) {
+                for(std::size_t c = 0; c < pattern.size(); c++) {
+                    state_count += !(pattern[c] == '*' && c > 0 && pattern[c - 1] == '*');
+                }
+                state_count++;
+            }
+        };
+        count_states(include);
+        count_states(exclude);
+
+        this->word_count = (state_count + 63) / 64;
+        this->start_states.resize(this->word_count);
+        this->star_states.resize(this->word_count);
+        this->advancing_states.resize(this->word_count * 256);
+        this->include_states.resize(this->word_count);
+        this->exclude_states.resize(this->word_count);
+
+        std::size_t state = 0;
+        auto set_state = [](std::vector<std::uint64_t> &states, std::size_t state, std::size_t word_offset = 0) {
+            states[word_offset + state / 64] |= static_cast<std::uint64_t>(1) << (state % 64);
+        };
+        auto add_patterns = [&](const std::vector<std::string> &patterns, std::vector<std::uint64_t> &end_states) {
+            for(auto &pattern : patterns) {
+                set_state(this->start_states, state);
+                for(std::size_t c = 0; c < pattern.size(); c++) {
+                    char pattern_character = pattern[c];
+                    if(pattern_character == '*') {
+                        if(c > 0 && pattern[c - 1] == '*') {
+                            continue;
+                        }
+                        set_state(this->star_states, state);
+                    }
+                    else {
+                        for(unsigned int b = 1; b < 256; b++) {
+                            if(path_character_matches(pattern_character, static_cast<char>(b))) {
+                                set_state(this->advancing_states, state, b * this->word_count);
+                            }
+                        }
+                    }
+                    state++;
+                }
+                set_state(end_states, state);
+                state++;
+            }
+        };
+        add_patterns(include, this->include_states);
+        add_patterns(exclude, this->exclude_states);
+
+        skip_stars(this->start_states.data(), this->star_states.data(), this->word_count);
+    }
+
+    bool PathMatcher::matches(const char *path) const noexcept {
+        auto current = this->start_states;
+        std::vector<std::uint64_t> next(this->word_count);
+
+        for(const char *c = path; *c; c++) {
+            const auto *advancing = this->advancing_states.data() + static_cast<std::uint8_t>(*c) * this->word_count;
+            std::uint64_t carry = 0;
+            std::uint64_t any = 0;
+            for(std::size_t w = 0; w < this->word_count; w++) {
+                auto advanced = current[w] & advancing[w];
+                next[w] = (advanced << 1) | carry | (current[w] & this->star_states[w]);
+                carry = advanced >> 63;
+                any |= next[w];
+            }
+            skip_stars(next.data(), this->star_states.data(), this->word_count);
+            current.swap(next);
+
+            // Nothing can match anymore, so nothing can be excluded either
+            if(!any) {
+                return this->include_all;
+            }
+        }
+
+        if(any_states(current, this->exclude_states)) {
+            return false;
+        }
+        return this->include_all || any_states(current, this->include_states);
+    }
 }
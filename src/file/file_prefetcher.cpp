@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/file/file_prefetcher.hpp>
+#include <invader/file/file.hpp>
+
+namespace Invader::File {
+    FilePrefetcher::FilePrefetcher(Resolver resolver, std::size_t thread_count) : resolver(std::move(resolver)) {
+        this->threads.reserve(thread_count);
+        for(std::size_t i = 0; i < thread_count; i++) {
+            this->threads.emplace_back(&FilePrefetcher::read_files, this);
+        }
+    }
+
+    FilePrefetcher::~FilePrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->queue_condition.notify_all();
+        for(auto &t : this->threads) {
+            t.join();
+        }
+    }
+
+    void FilePrefetcher::prefetch(const std::string &key) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if(!this->queued_keys.insert(key).second) {
+                return;
+            }
+            this->requests.emplace(key, Request {});
+            this->queue.emplace_back(key);
+        }
+        this->queue_condition.notify_one();
+    }
+
+    std::optional<std::vector<std::byte>> FilePrefetcher::take(const std::string &key) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto request = this->requests.find(key);
+        if(request == this->requests.end()) {
+            return std::nullopt;
+        }
+
+        // If nobody's reading it yet, it's faster for the caller to read it than to wait for it to come up in the queue
+        if(!request->second.started) {
+            this->requests.erase(request);
+            return std::nullopt;
+        }
+
+        // Rehashing doesn't invalidate references to elements, so this stays valid while waiting
+        auto &found = request->second;
+        this->done_condition.wait(lock, [&found]() { return found.done; });
+        auto data = std::move(found.data);
+        this->requests.erase(key);
+        return data;
+    }
+
+    void FilePrefetcher::read_files() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true) {
+            this->queue_condition.wait(lock, [this]() { return this->stopping || !this->queue.empty(); });
+            if(this->stopping) {
+                return;
+            }
+
+            auto key = std::move(this->queue.front());
+            this->queue.pop_front();
+
+            // Skip it if it was taken before we got to it
+            auto request = this->requests.find(key);
+            if(request == this->requests.end()) {
+                continue;
+            }
+            request->second.started = true;
+            lock.unlock();
+
+            // If anything fails, leave it to the caller to read it again and report it
+            std::optional<std::vector<std::byte>> data;
+            auto path = this->resolver(key);
+            if(path.has_value()) {
+                data = open_file(*path);
+            }
+
+            lock.lock();
+            auto &finished = this->requests[key];
+            finished.data = std::move(data);
+            finished.done = true;
+            this->done_condition.notify_all();
+        }
+    }
+}
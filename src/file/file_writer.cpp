@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <invader/file/file_writer.hpp>
+#include <invader/file/file.hpp>
+
+namespace Invader::File {
+    FileWriter::FileWriter(std::size_t thread_count, std::size_t max_queued_files, bool skip_unchanged) : max_queued_files(std::max(max_queued_files, static_cast<std::size_t>(1))), skip_unchanged(skip_unchanged) {
+        thread_count = std::max(thread_count, static_cast<std::size_t>(1));
+        this->threads.reserve(thread_count);
+        for(std::size_t i = 0; i < thread_count; i++) {
+            this->threads.emplace_back(&FileWriter::write_files, this);
+        }
+    }
+
+    FileWriter::~FileWriter() {
+        this->finish();
+    }
+
+    void FileWriter::write(std::filesystem::path path, std::vector<std::byte> data, Callback callback) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->space_condition.wait(lock, [this]() { return this->queue.size() < this->max_queued_files; });
+            this->queue.emplace_back(Write { std::move(path), std::move(data), std::move(callback) });
+        }
+        this->queue_condition.notify_one();
+    }
+
+    std::vector<std::filesystem::path> FileWriter::finish() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->queue_condition.notify_all();
+        for(auto &t : this->threads) {
+            t.join();
+        }
+        this->threads.clear();
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->failed;
+    }
+
+    void FileWriter::write_files() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true) {
+            this->queue_condition.wait(lock, [this]() { return this->stopping || !this->queue.empty(); });
+            if(this->queue.empty()) {
+                return;
+            }
+
+            auto write = std::move(this->queue.front());
+            this->queue.pop_front();
+            this->space_condition.notify_one();
+            lock.unlock();
+
+            bool saved = this->save(write);
+            if(write.callback) {
+                write.callback(write.path, saved);
+            }
+
+            lock.lock();
+            if(!saved) {
+                this->failed.emplace_back(std::move(write.path));
+            }
+        }
+    }
+
+    bool FileWriter::save(const Write &write) {
+        std::error_code ec;
+
+        // Many files go in the same directory, so don't ask the filesystem to create it again for each of them
+        auto directory = write.path.parent_path();
+        if(!directory.empty()) {
+            bool created;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                created = this->created_directories.contains(directory.native());
+            }
+            if(!created) {
+                std::filesystem::create_directories(directory, ec);
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->created_directories.emplace(directory.native());
+            }
+        }
+
+        // Check the size before reading it so files that changed size don't have to be read
+        if(this->skip_unchanged) {
+            auto size = std::filesystem::file_size(write.path, ec);
+            if(!ec && size == write.data.size()) {
+                auto existing = open_file(write.path);
+                if(existing.has_value() && *existing == write.data) {
+                    return true;
+                }
+            }
+        }
+
+        return save_file(write.path, write.data);
+    }
+}
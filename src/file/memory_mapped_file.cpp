@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/printf.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Invader::File {
+    std::optional<MemoryMappedFile> MemoryMappedFile::map_file(const std::filesystem::path &path) {
+        auto path_string = path.string();
+        MemoryMappedFile file;
+
+        #ifdef _WIN32
+        HANDLE handle = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(handle == INVALID_HANDLE_VALUE) {
+            eprintf("Error: Failed to open %s for reading.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(handle, &size)) {
+            CloseHandle(handle);
+            eprintf("Error: Failed to query the size of %s for reading.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        // Empty files can't be mapped, but there's nothing to map anyway
+        if(size.QuadPart == 0) {
+            CloseHandle(handle);
+            return file;
+        }
+
+        HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        CloseHandle(handle);
+        if(mapping == nullptr) {
+            eprintf("Error: Failed to map %s into memory.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        CloseHandle(mapping);
+        if(view == nullptr) {
+            eprintf("Error: Failed to map %s into memory.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        file.file_data = reinterpret_cast<std::byte *>(view);
+        file.file_size = static_cast<std::size_t>(size.QuadPart);
+        #else
+        int fd = open(path_string.c_str(), O_RDONLY);
+        if(fd == -1) {
+            eprintf("Error: Failed to open %s for reading.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        struct stat file_stat;
+        if(fstat(fd, &file_stat) != 0) {
+            close(fd);
+            eprintf("Error: Failed to query the size of %s for reading.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        // Empty files can't be mapped, but there's nothing to map anyway
+        if(file_stat.st_size == 0) {
+            close(fd);
+            return file;
+        }
+
+        void *view = mmap(nullptr, static_cast<std::size_t>(file_stat.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(view == MAP_FAILED) {
+            eprintf("Error: Failed to map %s into memory.\n", path_string.c_str());
+            return std::nullopt;
+        }
+
+        file.file_data = reinterpret_cast<std::byte *>(view);
+        file.file_size = static_cast<std::size_t>(file_stat.st_size);
+        #endif
+
+        return file;
+    }
+
+    void MemoryMappedFile::unmap() noexcept {
+        if(this->file_data == nullptr) {
+            return;
+        }
+
+        #ifdef _WIN32
+        UnmapViewOfFile(this->file_data);
+        #else
+        munmap(this->file_data, this->file_size);
+        #endif
+
+        this->file_data = nullptr;
+        this->file_size = 0;
+    }
+
+    MemoryMappedFile::MemoryMappedFile(MemoryMappedFile &&move) noexcept : file_data(move.file_data), file_size(move.file_size) {
+        move.file_data = nullptr;
+        move.file_size = 0;
+    }
+
+    MemoryMappedFile &MemoryMappedFile::operator=(MemoryMappedFile &&move) noexcept {
+        if(this != &move) {
+            this->unmap();
+            this->file_data = move.file_data;
+            this->file_size = move.file_size;
+            move.file_data = nullptr;
+            move.file_size = 0;
+        }
+        return *this;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile() {
+        this->unmap();
+    }
+}
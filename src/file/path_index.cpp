@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <iterator>
+#include <invader/file/path_index.hpp>
+#include <invader/file/file.hpp>
+
+namespace Invader::File {
+    // Path separators match each other in patterns, so they're all indexed as the same character
+    static std::uint8_t trigram_character(char c) noexcept {
+        return c == '/' ? static_cast<std::uint8_t>('\\') : static_cast<std::uint8_t>(c);
+    }
+
+    static std::uint32_t make_trigram(const char *text) noexcept {
+        return (static_cast<std::uint32_t>(trigram_character(text[0])) << 16) | (static_cast<std::uint32_t>(trigram_character(text[1])) << 8) | trigram_character(text[2]);
+    }
+
+    PathIndex::PathIndex(std::vector<std::string> paths) : paths(std::move(paths)) {
+        // Pair each sequence with each path it's in, then sort it so each sequence's paths are together and in order
+        std::vector<std::uint64_t> pairs;
+        std::vector<std::uint32_t> path_trigrams;
+        for(std::size_t p = 0; p < this->paths.size(); p++) {
+            auto &path = this->paths[p];
+            path_trigrams.clear();
+            for(std::size_t c = 0; c + 3 <= path.size(); c++) {
+                path_trigrams.emplace_back(make_trigram(path.data() + c));
+            }
+            std::sort(path_trigrams.begin(), path_trigrams.end());
+            path_trigrams.erase(std::unique(path_trigrams.begin(), path_trigrams.end()), path_trigrams.end());
+            for(auto t : path_trigrams) {
+                pairs.emplace_back((static_cast<std::uint64_t>(t) << 32) | p);
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        this->trigram_paths.reserve(pairs.size());
+        for(auto pair : pairs) {
+            auto trigram = static_cast<std::uint32_t>(pair >> 32);
+            if(this->trigrams.empty() || this->trigrams.back() != trigram) {
+                this->trigrams.emplace_back(trigram);
+                this->trigram_offsets.emplace_back(static_cast<std::uint32_t>(this->trigram_paths.size()));
+            }
+            this->trigram_paths.emplace_back(static_cast<std::uint32_t>(pair));
+        }
+        this->trigram_offsets.emplace_back(static_cast<std::uint32_t>(this->trigram_paths.size()));
+    }
+
+    std::vector<std::size_t> PathIndex::find(const char *pattern) const {
+        // Get the sequences in each run of text in the pattern ('*' and '?' can be anything, so those can't be used)
+        std::vector<std::uint32_t> pattern_trigrams;
+        std::size_t run = 0;
+        for(const char *c = pattern; *c; c++) {
+            if(*c == '*' || *c == '?') {
+                run = 0;
+                continue;
+            }
+            if(++run >= 3) {
+                pattern_trigrams.emplace_back(make_trigram(c - 2));
+            }
+        }
+        std::sort(pattern_trigrams.begin(), pattern_trigrams.end());
+        pattern_trigrams.erase(std::unique(pattern_trigrams.begin(), pattern_trigrams.end()), pattern_trigrams.end());
+
+        // Find the paths for each sequence; if any sequence isn't in any path, nothing can match
+        struct PathRange {
+            const std::uint32_t *begin;
+            const std::uint32_t *end;
+        };
+        std::vector<PathRange> ranges;
+        for(auto t : pattern_trigrams) {
+            auto found = std::lower_bound(this->trigrams.begin(), this->trigrams.end(), t);
+            if(found == this->trigrams.end() || *found != t) {
+                return {};
+            }
+            auto i = found - this->trigrams.begin();
+            ranges.push_back({ this->trigram_paths.data() + this->trigram_offsets[i], this->trigram_paths.data() + this->trigram_offsets[i + 1] });
+        }
+
+        // Start with the sequence in the fewest paths and narrow it down from there
+        std::vector<std::uint32_t> candidates;
+        if(ranges.empty()) {
+            candidates.resize(this->paths.size());
+            for(std::size_t p = 0; p < candidates.size(); p++) {
+                candidates[p] = static_cast<std::uint32_t>(p);
+            }
+        }
+        else {
+            std::sort(ranges.begin(), ranges.end(), [](const PathRange &a, const PathRange &b) { return (a.end - a.begin) < (b.end - b.begin); });
+            candidates.assign(ranges[0].begin, ranges[0].end);
+            std::vector<std::uint32_t> narrowed;
+            for(std::size_t r = 1; r < ranges.size() && !candidates.empty(); r++) {
+                narrowed.clear();
+                std::set_intersection(candidates.begin(), candidates.end(), ranges[r].begin, ranges[r].end, std::back_inserter(narrowed));
+                candidates.swap(narrowed);
+            }
+        }
+
+        // Having every sequence doesn't mean they're in the right places, so check each one
+        std::vector<std::size_t> matches;
+        for(auto p : candidates) {
+            if(path_matches(this->paths[p].c_str(), pattern)) {
+                matches.emplace_back(p);
+            }
+        }
+        return matches;
+    }
+}
@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include <invader/file/tag_bundle.hpp>
+#include <invader/file/file.hpp>
+#include <invader/error.hpp>
+#include <invader/printf.hpp>
+
+#ifndef DISABLE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace Invader::File {
+    // Increment this if the format of bundles changes
+    static constexpr std::uint32_t TAG_BUNDLE_VERSION = 1;
+    static constexpr char TAG_BUNDLE_MAGIC[8] = { 'i', 'n', 'v', 't', 'b', 'n', 'd', 'l' };
+
+    // Magic, version, tag count
+    static constexpr std::size_t TAG_BUNDLE_HEADER_SIZE = sizeof(TAG_BUNDLE_MAGIC) + sizeof(std::uint32_t) * 2;
+
+    // Path offset, path size, compression, data offset, stored size, size
+    static constexpr std::size_t TAG_BUNDLE_ENTRY_SIZE = sizeof(std::uint64_t) + sizeof(std::uint32_t) * 2 + sizeof(std::uint64_t) * 3;
+
+    // Tags at least a page big start on a page so reading one touches as few pages as possible; smaller tags are packed
+    static constexpr std::size_t TAG_BUNDLE_PAGE_SIZE = 4096;
+    static constexpr std::size_t TAG_BUNDLE_SMALL_ALIGNMENT = 16;
+
+    // Paths are matched like Halo does: case-insensitively, with any path separator treated the same
+    static char fold(char c) noexcept {
+        if(c >= 'A' && c <= 'Z') {
+            return static_cast<char>(c - 'A' + 'a');
+        }
+        if(c == '/' || c == INVADER_PREFERRED_PATH_SEPARATOR) {
+            return '\\';
+        }
+        return c;
+    }
+
+    static int compare_paths(std::string_view a, std::string_view b) noexcept {
+        auto length = std::min(a.size(), b.size());
+        for(std::size_t i = 0; i < length; i++) {
+            auto fa = static_cast<unsigned char>(fold(a[i]));
+            auto fb = static_cast<unsigned char>(fold(b[i]));
+            if(fa != fb) {
+                return fa < fb ? -1 : 1;
+            }
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    template <typename T> static void write_value(std::vector<std::byte> &data, std::size_t offset, T value) noexcept {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data[offset + i] = static_cast<std::byte>(static_cast<std::uint64_t>(value) >> (i * 8));
+        }
+    }
+
+    template <typename T> static T read_value(const std::byte *data) noexcept {
+        std::uint64_t value = 0;
+        for(std::size_t i = 0; i < sizeof(T); i++) {
+            value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+        }
+        return static_cast<T>(value);
+    }
+
+    std::optional<TagBundle> TagBundle::open_bundle(const std::filesystem::path &path) {
+        auto file = MemoryMappedFile::map_file(path);
+        if(!file.has_value()) {
+            return std::nullopt;
+        }
+
+        TagBundle bundle(std::move(*file));
+        if(!bundle.read_index(path.string().c_str())) {
+            return std::nullopt;
+        }
+        return bundle;
+    }
+
+    bool TagBundle::read_index(const char *name) {
+        auto *data = this->data();
+        auto size = this->size();
+        if(size < TAG_BUNDLE_HEADER_SIZE || std::memcmp(data, TAG_BUNDLE_MAGIC, sizeof(TAG_BUNDLE_MAGIC)) != 0) {
+            return false;
+        }
+
+        auto version = read_value<std::uint32_t>(data + sizeof(TAG_BUNDLE_MAGIC));
+        if(version != TAG_BUNDLE_VERSION) {
+            eprintf_error("%s is an unsupported tag bundle version (%u != %u)", name, version, TAG_BUNDLE_VERSION);
+            return false;
+        }
+
+        std::size_t tag_count = read_value<std::uint32_t>(data + sizeof(TAG_BUNDLE_MAGIC) + sizeof(std::uint32_t));
+        if((size - TAG_BUNDLE_HEADER_SIZE) / TAG_BUNDLE_ENTRY_SIZE < tag_count) {
+            eprintf_error("%s is not a valid tag bundle (index is out of bounds)", name);
+            return false;
+        }
+
+        this->entries.reserve(tag_count);
+        for(std::size_t i = 0; i < tag_count; i++) {
+            auto *e = data + TAG_BUNDLE_HEADER_SIZE + i * TAG_BUNDLE_ENTRY_SIZE;
+            auto path_offset = read_value<std::uint64_t>(e);
+            auto path_size = read_value<std::uint32_t>(e + 8);
+            auto compression = read_value<std::uint32_t>(e + 12);
+            auto data_offset = read_value<std::uint64_t>(e + 16);
+            auto stored_size = read_value<std::uint64_t>(e + 24);
+            auto tag_size = read_value<std::uint64_t>(e + 32);
+
+            if(path_offset > size || path_size > size - path_offset || data_offset > size || stored_size > size - data_offset || compression > COMPRESSION_DEFLATE || (compression == COMPRESSION_NONE && stored_size != tag_size)) {
+                eprintf_error("%s is not a valid tag bundle (tag #%zu is out of bounds)", name, i);
+                return false;
+            }
+
+            auto &entry = this->entries.emplace_back();
+            entry.path = std::string_view(reinterpret_cast<const char *>(data + path_offset), path_size);
+            entry.compression = static_cast<Compression>(compression);
+            entry.data_offset = data_offset;
+            entry.stored_size = stored_size;
+            entry.size = tag_size;
+
+            // Lookups are binary searches, so make sure nobody handed us an unsorted index
+            if(i > 0 && compare_paths(this->entries[i - 1].path, entry.path) >= 0) {
+                eprintf_error("%s is not a valid tag bundle (index is not sorted)", name);
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Bundles that were given as tags directories, along with directories that turned out to not be bundles (nullptr)
+    static std::mutex bundles_mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const TagBundle>> bundles;
+    static bool any_bundles = false;
+
+    std::shared_ptr<const TagBundle> TagBundle::get_bundle(const std::filesystem::path &tags_directory) {
+        std::lock_guard<std::mutex> lock(bundles_mutex);
+        auto key = tags_directory.string();
+        auto found = bundles.find(key);
+        if(found != bundles.end()) {
+            return found->second;
+        }
+
+        std::shared_ptr<const TagBundle> bundle;
+        std::error_code ec;
+        if(std::filesystem::is_regular_file(tags_directory, ec)) {
+            auto opened = TagBundle::open_bundle(tags_directory);
+            if(opened.has_value()) {
+                bundle = std::make_shared<const TagBundle>(std::move(*opened));
+                any_bundles = true;
+            }
+        }
+        bundles.emplace(std::move(key), bundle);
+        return bundle;
+    }
+
+    std::shared_ptr<const TagBundle> TagBundle::add_memory_bundle(const std::filesystem::path &tags_directory, const std::vector<BundledTag> &tags) {
+        // Tags are stored uncompressed since they'd only be decompressed again
+        auto key = tags_directory.string();
+        TagBundle bundle(generate_bundle(tags, false));
+        if(!bundle.read_index(key.c_str())) {
+            throw InvalidTagPathException();
+        }
+        auto shared = std::make_shared<const TagBundle>(std::move(bundle));
+
+        std::lock_guard<std::mutex> lock(bundles_mutex);
+        bundles[std::move(key)] = shared;
+        any_bundles = true;
+        return shared;
+    }
+
+    std::optional<std::vector<std::byte>> TagBundle::open_bundled_file(const std::filesystem::path &path) {
+        std::shared_ptr<const TagBundle> bundle;
+        std::string tag_path;
+        {
+            std::lock_guard<std::mutex> lock(bundles_mutex);
+            if(!any_bundles) {
+                return std::nullopt;
+            }
+
+            auto path_string = path.string();
+            for(auto &b : bundles) {
+                auto &bundle_path = b.first;
+                if(b.second && path_string.size() > bundle_path.size() + 1 && path_string.compare(0, bundle_path.size(), bundle_path) == 0 && path_string[bundle_path.size()] == std::filesystem::path::preferred_separator) {
+                    bundle = b.second;
+                    tag_path = path_string.substr(bundle_path.size() + 1);
+                    break;
+                }
+            }
+        }
+
+        if(!bundle) {
+            return std::nullopt;
+        }
+        return bundle->read_tag(tag_path);
+    }
+
+    std::vector<std::byte> TagBundle::generate_bundle(const std::vector<BundledTag> &tags, bool compress) {
+        // Sort the index so tags can be found with a binary search
+        std::vector<const BundledTag *> sorted_tags;
+        sorted_tags.reserve(tags.size());
+        for(auto &t : tags) {
+            sorted_tags.emplace_back(&t);
+        }
+        std::sort(sorted_tags.begin(), sorted_tags.end(), [](const BundledTag *a, const BundledTag *b) { return compare_paths(a->path, b->path) < 0; });
+        for(std::size_t i = 1; i < sorted_tags.size(); i++) {
+            if(compare_paths(sorted_tags[i - 1]->path, sorted_tags[i]->path) == 0) {
+                eprintf_error("%s was given more than once", sorted_tags[i]->path.c_str());
+                throw InvalidTagPathException();
+            }
+        }
+
+        // Header and index
+        std::vector<std::byte> bundle(TAG_BUNDLE_HEADER_SIZE + TAG_BUNDLE_ENTRY_SIZE * sorted_tags.size());
+        std::memcpy(bundle.data(), TAG_BUNDLE_MAGIC, sizeof(TAG_BUNDLE_MAGIC));
+        write_value(bundle, sizeof(TAG_BUNDLE_MAGIC), TAG_BUNDLE_VERSION);
+        write_value(bundle, sizeof(TAG_BUNDLE_MAGIC) + sizeof(std::uint32_t), static_cast<std::uint32_t>(sorted_tags.size()));
+
+        // Paths, stored with Halo path separators
+        for(std::size_t i = 0; i < sorted_tags.size(); i++) {
+            auto &path = sorted_tags[i]->path;
+            auto e = TAG_BUNDLE_HEADER_SIZE + i * TAG_BUNDLE_ENTRY_SIZE;
+            write_value(bundle, e, static_cast<std::uint64_t>(bundle.size()));
+            write_value(bundle, e + 8, static_cast<std::uint32_t>(path.size()));
+            for(char c : path) {
+                bundle.emplace_back(static_cast<std::byte>(c == '/' || c == INVADER_PREFERRED_PATH_SEPARATOR ? '\\' : c));
+            }
+        }
+
+        // Tag data
+        for(std::size_t i = 0; i < sorted_tags.size(); i++) {
+            auto &data = sorted_tags[i]->data;
+            auto e = TAG_BUNDLE_HEADER_SIZE + i * TAG_BUNDLE_ENTRY_SIZE;
+
+            const std::byte *stored = data.data();
+            std::size_t stored_size = data.size();
+            auto compression = COMPRESSION_NONE;
+
+            #ifndef DISABLE_ZLIB
+            std::vector<std::byte> compressed;
+            if(compress && !data.empty()) {
+                auto compressed_size = compressBound(static_cast<uLong>(data.size()));
+                compressed.resize(compressed_size);
+                if(compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressed_size, reinterpret_cast<const Bytef *>(data.data()), static_cast<uLong>(data.size()), Z_BEST_COMPRESSION) == Z_OK && compressed_size < data.size()) {
+                    stored = compressed.data();
+                    stored_size = compressed_size;
+                    compression = COMPRESSION_DEFLATE;
+                }
+            }
+            #else
+            (void)compress;
+            #endif
+
+            auto alignment = stored_size >= TAG_BUNDLE_PAGE_SIZE ? TAG_BUNDLE_PAGE_SIZE : TAG_BUNDLE_SMALL_ALIGNMENT;
+            bundle.resize(bundle.size() + (alignment - bundle.size() % alignment) % alignment);
+
+            write_value(bundle, e + 12, static_cast<std::uint32_t>(compression));
+            write_value(bundle, e + 16, static_cast<std::uint64_t>(bundle.size()));
+            write_value(bundle, e + 24, static_cast<std::uint64_t>(stored_size));
+            write_value(bundle, e + 32, static_cast<std::uint64_t>(data.size()));
+            bundle.insert(bundle.end(), stored, stored + stored_size);
+        }
+
+        return bundle;
+    }
+
+    const TagBundle::Entry *TagBundle::find(std::string_view tag_path) const noexcept {
+        auto found = std::lower_bound(this->entries.begin(), this->entries.end(), tag_path, [](const Entry &entry, std::string_view tag_path) { return compare_paths(entry.path, tag_path) < 0; });
+        if(found == this->entries.end() || compare_paths(found->path, tag_path) != 0) {
+            return nullptr;
+        }
+        return &*found;
+    }
+
+    bool TagBundle::contains(std::string_view tag_path) const noexcept {
+        return this->find(tag_path) != nullptr;
+    }
+
+    std::optional<std::vector<std::byte>> TagBundle::read_tag(std::string_view tag_path) const {
+        auto *entry = this->find(tag_path);
+        if(entry == nullptr) {
+            return std::nullopt;
+        }
+
+        auto *stored = this->data() + entry->data_offset;
+        if(entry->compression == COMPRESSION_NONE) {
+            return std::vector<std::byte>(stored, stored + entry->stored_size);
+        }
+
+        #ifndef DISABLE_ZLIB
+        std::vector<std::byte> data(entry->size);
+        uLongf data_size = static_cast<uLongf>(data.size());
+        if(uncompress(reinterpret_cast<Bytef *>(data.data()), &data_size, reinterpret_cast<const Bytef *>(stored), static_cast<uLong>(entry->stored_size)) != Z_OK || data_size != data.size()) {
+            eprintf_error("Failed to decompress %s", std::string(tag_path).c_str());
+            return std::nullopt;
+        }
+        return data;
+        #else
+        eprintf_error("Failed to decompress %s (Invader was built without zlib)", std::string(tag_path).c_str());
+        return std::nullopt;
+        #endif
+    }
+
+    std::vector<std::string> TagBundle::get_tag_paths() const {
+        std::vector<std::string> paths;
+        paths.reserve(this->entries.size());
+        for(auto &entry : this->entries) {
+            paths.emplace_back(entry.path);
+        }
+        return paths;
+    }
+}
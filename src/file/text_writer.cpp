@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <charconv>
+#include <invader/file/text_writer.hpp>
+#include <invader/thread_pool.hpp>
+
+namespace Invader::File {
+    TextWriter &TextWriter::write_integer(std::int64_t value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        this->text.append(buffer, result.ptr);
+        return *this;
+    }
+
+    TextWriter &TextWriter::write_unsigned(std::uint64_t value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        this->text.append(buffer, result.ptr);
+        return *this;
+    }
+
+    TextWriter &TextWriter::write_decimal(double value, int decimal_places) {
+        // Enough for the largest double written out in full with a sign, decimal point, and plenty of decimal places
+        char buffer[384];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, decimal_places);
+        if(result.ec != std::errc()) {
+            result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        }
+
+        // Remove trailing zeroes, then the decimal point if that's all that's left (inf and nan don't have one)
+        auto *end = result.ptr;
+        if(std::find(buffer, end, '.') != end) {
+            while(end[-1] == '0') {
+                end--;
+            }
+            if(end[-1] == '.') {
+                end--;
+            }
+        }
+
+        this->text.append(buffer, end);
+        return *this;
+    }
+
+    std::vector<std::byte> TextWriter::take_bytes() {
+        auto *data = reinterpret_cast<const std::byte *>(this->text.data());
+        std::vector<std::byte> bytes(data, data + this->text.size());
+        std::string().swap(this->text);
+        return bytes;
+    }
+
+    void TextWriter::for_each_section(std::size_t count, const std::function<void (std::size_t)> &function) {
+        ThreadPool::shared().parallel_for(count, function);
+    }
+}
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
 #include <cstdio>
 #include <ft2build.h>
 #include <cassert>
@@ -7,10 +8,14 @@
 #include <cstdlib>
 #include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
 #include <vector>
 #include <invader/tag/hek/definition.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
 #include <invader/tag/parser/parser.hpp>
@@ -53,6 +58,7 @@ int main(int argc, char *argv[]) {
         int pixel_size = 14;
         bool use_filesystem_path = false;
         bool use_latin1 = false;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } font_options;
 
     // Command line options
@@ -62,7 +68,8 @@ int main(int argc, char *argv[]) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
         CommandLineOption("font-size", 's', 1, "Set the font size in pixels.", "<px>"),
-        CommandLineOption("latin1", 'l', 0, "Use 256 characters only (smaller)")
+        CommandLineOption("latin1", 'l', 0, "Use 256 characters only (smaller)"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Create font tags from OTF/TTF files.";
@@ -95,6 +102,10 @@ int main(int argc, char *argv[]) {
                 }
                 break;
 
+            case 'j':
+                font_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
+
             case 'i':
                 show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -102,6 +113,9 @@ int main(int argc, char *argv[]) {
         }
     });
 
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(font_options.thread_count);
+
     // Do it!
     std::string font_tag;
     FontExtension found_format = static_cast<FontExtension>(0);
@@ -154,53 +168,74 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    // Load the TTF
-    FT_Library library;
-    FT_Face face;
-    if(FT_Init_FreeType(&library)) {
-        eprintf_error("Failed to initialize freetype.");
-        return EXIT_FAILURE;
-    }
-    if(FT_New_Face(library, final_ttf_path.c_str(), 0, &face)) {
-        eprintf_error("Failed to open %s.", final_ttf_path.c_str());
-        return EXIT_FAILURE;
-    }
-    if(FT_Set_Pixel_Sizes(face, font_options.pixel_size, font_options.pixel_size)) {
-        eprintf_error("Failed to set pixel size %i.", font_options.pixel_size);
-        return EXIT_FAILURE;
-    }
-
-    // Render the characters in a range
-    std::vector<RenderedCharacter> characters;
+    // Render the characters in a range. FreeType faces can't be shared between threads, so each thread opens its own.
     int characters_to_add = font_options.use_latin1 ? 256 : 16384;
-    for(int i = 0; i < characters_to_add; i++) {
-        auto index = FT_Get_Char_Index(face, i);
-        if(FT_Load_Glyph(face, index, FT_LOAD_DEFAULT)) {
-            eprintf_error("Failed to load glyph %i", i);
-            return EXIT_FAILURE;
+    std::vector<RenderedCharacter> characters(characters_to_add);
+    std::size_t thread_count = std::min<std::size_t>(font_options.thread_count, characters_to_add);
+    std::vector<std::optional<std::string>> thread_errors(thread_count);
+
+    auto render_characters = [&characters, &final_ttf_path, &font_options](int first, int last, std::optional<std::string> &error) {
+        char message[512];
+        FT_Library library;
+        FT_Face face;
+        if(FT_Init_FreeType(&library)) {
+            error = "Failed to initialize freetype.";
+            return;
+        }
+        if(FT_New_Face(library, final_ttf_path.c_str(), 0, &face)) {
+            std::snprintf(message, sizeof(message), "Failed to open %s.", final_ttf_path.c_str());
+            error = message;
+            FT_Done_FreeType(library);
+            return;
         }
-        if(FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL)) {
-            eprintf_error("Failed to render glyph %i", i);
+        if(FT_Set_Pixel_Sizes(face, font_options.pixel_size, font_options.pixel_size)) {
+            std::snprintf(message, sizeof(message), "Failed to set pixel size %i.", font_options.pixel_size);
+            error = message;
+        }
+
+        for(int i = first; i < last && !error.has_value(); i++) {
+            auto index = FT_Get_Char_Index(face, i);
+            if(FT_Load_Glyph(face, index, FT_LOAD_DEFAULT)) {
+                std::snprintf(message, sizeof(message), "Failed to load glyph %i", i);
+                error = message;
+                break;
+            }
+            if(FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL)) {
+                std::snprintf(message, sizeof(message), "Failed to render glyph %i", i);
+                error = message;
+                break;
+            }
+            auto &c = characters[i];
+            c.left = face->glyph->bitmap_left;
+            c.top = face->glyph->bitmap_top;
+            c.x = face->glyph->advance.x >> 6;
+            c.y = face->glyph->advance.y >> 6;
+            c.width = face->glyph->bitmap.width;
+            c.height = face->glyph->bitmap.rows;
+            c.hori_advance = face->glyph->metrics.horiAdvance / 64;
+
+            auto *buffer = reinterpret_cast<std::byte *>(face->glyph->bitmap.buffer);
+            c.data.insert(c.data.begin(), buffer, buffer + c.width * c.height);
+        }
+
+        // Done
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+    };
+
+    // Each job gets a contiguous range of characters so they end up in the same order regardless of the thread count
+    ThreadPool::shared().parallel_for(thread_count, [&render_characters, &thread_errors, characters_to_add, thread_count](std::size_t t) {
+        int first = static_cast<int>(characters_to_add * t / thread_count);
+        int last = static_cast<int>(characters_to_add * (t + 1) / thread_count);
+        render_characters(first, last, thread_errors[t]);
+    }, thread_count);
+    for(auto &e : thread_errors) {
+        if(e.has_value()) {
+            eprintf_error("%s", e->c_str());
             return EXIT_FAILURE;
         }
-        RenderedCharacter c;
-        c.left = face->glyph->bitmap_left;
-        c.top = face->glyph->bitmap_top;
-        c.x = face->glyph->advance.x >> 6;
-        c.y = face->glyph->advance.y >> 6;
-        c.width = face->glyph->bitmap.width;
-        c.height = face->glyph->bitmap.rows;
-        c.hori_advance = face->glyph->metrics.horiAdvance / 64;
-
-        auto *buffer = reinterpret_cast<std::byte *>(face->glyph->bitmap.buffer);
-        c.data.insert(c.data.begin(), buffer, buffer + c.width * c.height);
-        characters.emplace_back(c);
     }
 
-    // Done
-    FT_Done_Face(face);
-    FT_Done_FreeType(library);
-
     // Create
     Parser::Font font= {};
     std::vector<HEK::FontCharacter<HEK::BigEndian>> tag_characters;
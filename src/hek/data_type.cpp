@@ -258,27 +258,30 @@ namespace Invader::HEK {
         k = decompress_float<10>(v >> 22);
     }
 
-    ModelVertexCompressed<NativeEndian> compress_model_vertex(const ModelVertexUncompressed<NativeEndian> &vertex) noexcept {
-        ModelVertexCompressed<NativeEndian> r;
+    // Each vertex is converted by one of these so the single-vertex functions and the array kernels share the same math.
+    // The array kernels take the vertices in any endianness so tag data can be converted in place without copying each
+    // vertex to native endian first.
+    ENDIAN_TEMPLATE(EndianType) static inline void compress_model_vertex_into(const ModelVertexUncompressed<EndianType> &vertex, ModelVertexCompressed<EndianType> &r) noexcept {
         r.position = vertex.position;
-        r.node0_index = vertex.node0_index > Invader::Parser::MaxCompressedModelNodeIndex::MAX_COMPRESSED_MODEL_NODE_INDEX ? -3 : vertex.node0_index * 3;
+        std::uint16_t node0_index = vertex.node0_index;
+        std::uint16_t node1_index = vertex.node1_index;
+        r.node0_index = node0_index > Invader::Parser::MaxCompressedModelNodeIndex::MAX_COMPRESSED_MODEL_NODE_INDEX ? -3 : node0_index * 3;
         r.node0_weight = static_cast<std::int16_t>(compress_float<16>(vertex.node0_weight));
-        r.node1_index = vertex.node1_index > Invader::Parser::MaxCompressedModelNodeIndex::MAX_COMPRESSED_MODEL_NODE_INDEX ? -3 : vertex.node1_index * 3;
+        r.node1_index = node1_index > Invader::Parser::MaxCompressedModelNodeIndex::MAX_COMPRESSED_MODEL_NODE_INDEX ? -3 : node1_index * 3;
         r.texture_coordinate_u = static_cast<std::int16_t>(compress_float<16>(vertex.texture_coords.x));
         r.texture_coordinate_v = static_cast<std::int16_t>(compress_float<16>(vertex.texture_coords.y));
         r.normal = compress_vector(vertex.normal.i, vertex.normal.j, vertex.normal.k);
         r.binormal = compress_vector(vertex.binormal.i, vertex.binormal.j, vertex.binormal.k);
         r.tangent = compress_vector(vertex.tangent.i, vertex.tangent.j, vertex.tangent.k);
-        return r;
     }
 
-    ModelVertexUncompressed<NativeEndian> decompress_model_vertex(const ModelVertexCompressed<NativeEndian> &vertex) noexcept {
-        ModelVertexUncompressed<NativeEndian> r;
+    ENDIAN_TEMPLATE(EndianType) static inline void decompress_model_vertex_into(const ModelVertexCompressed<EndianType> &vertex, ModelVertexUncompressed<EndianType> &r) noexcept {
+        float node0_weight = decompress_float<16>(vertex.node0_weight);
         r.position = vertex.position;
         r.node0_index = vertex.node0_index < 0 ? 65535 : vertex.node0_index / 3;
-        r.node0_weight = decompress_float<16>(vertex.node0_weight);
+        r.node0_weight = node0_weight;
         r.node1_index = vertex.node1_index < 0 ? 65535 : vertex.node1_index / 3;
-        r.node1_weight = 1.0F - r.node0_weight; // this is just derived from node0_weight
+        r.node1_weight = 1.0F - node0_weight; // this is just derived from node0_weight
         r.texture_coords.x = decompress_float<16>(vertex.texture_coordinate_u);
         r.texture_coords.y = decompress_float<16>(vertex.texture_coordinate_v);
 
@@ -298,59 +301,49 @@ namespace Invader::HEK {
         r.tangent.i = normal_i;
         r.tangent.j = normal_j;
         r.tangent.k = normal_k;
-        return r;
     }
 
-    ScenarioStructureBSPMaterialCompressedRenderedVertex<NativeEndian> compress_sbsp_rendered_vertex(const ScenarioStructureBSPMaterialUncompressedRenderedVertex<NativeEndian> &vertex) noexcept {
-        ScenarioStructureBSPMaterialCompressedRenderedVertex<NativeEndian> r;
+    ENDIAN_TEMPLATE(EndianType) static inline void compress_sbsp_rendered_vertex_into(const ScenarioStructureBSPMaterialUncompressedRenderedVertex<EndianType> &vertex, ScenarioStructureBSPMaterialCompressedRenderedVertex<EndianType> &r) noexcept {
         r.position = vertex.position;
         r.texture_coords = vertex.texture_coords;
         r.normal = compress_vector(vertex.normal.i, vertex.normal.j, vertex.normal.k);
         r.binormal = compress_vector(vertex.binormal.i, vertex.binormal.j, vertex.binormal.k);
         r.tangent = compress_vector(vertex.tangent.i, vertex.tangent.j, vertex.tangent.k);
-        return r;
     }
 
-    ScenarioStructureBSPMaterialUncompressedRenderedVertex<NativeEndian> decompress_sbsp_rendered_vertex(const ScenarioStructureBSPMaterialCompressedRenderedVertex<NativeEndian> &vertex) noexcept {
-        ScenarioStructureBSPMaterialUncompressedRenderedVertex<NativeEndian> r;
+    ENDIAN_TEMPLATE(EndianType) static inline void decompress_sbsp_rendered_vertex_into(const ScenarioStructureBSPMaterialCompressedRenderedVertex<EndianType> &vertex, ScenarioStructureBSPMaterialUncompressedRenderedVertex<EndianType> &r) noexcept {
         r.position = vertex.position;
         r.texture_coords = vertex.texture_coords;
 
+        Vector3D<NativeEndian> normal;
         float normal_i, normal_j, normal_k;
 
         decompress_vector(vertex.normal, normal_i, normal_j, normal_k);
-        r.normal.i = normal_i;
-        r.normal.j = normal_j;
-        r.normal.k = normal_k;
-        r.normal = r.normal.normalize();
+        normal.i = normal_i;
+        normal.j = normal_j;
+        normal.k = normal_k;
+        r.normal = normal.normalize();
 
         decompress_vector(vertex.binormal, normal_i, normal_j, normal_k);
-        r.binormal.i = normal_i;
-        r.binormal.j = normal_j;
-        r.binormal.k = normal_k;
-        r.binormal = r.binormal.normalize();
+        normal.i = normal_i;
+        normal.j = normal_j;
+        normal.k = normal_k;
+        r.binormal = normal.normalize();
 
         decompress_vector(vertex.tangent, normal_i, normal_j, normal_k);
-        r.tangent.i = normal_i;
-        r.tangent.j = normal_j;
-        r.tangent.k = normal_k;
-        r.tangent = r.tangent.normalize();
-        return r;
+        normal.i = normal_i;
+        normal.j = normal_j;
+        normal.k = normal_k;
+        r.tangent = normal.normalize();
     }
 
-    ScenarioStructureBSPMaterialCompressedLightmapVertex<NativeEndian> compress_sbsp_lightmap_vertex(const ScenarioStructureBSPMaterialUncompressedLightmapVertex<NativeEndian> &vertex) noexcept {
-        ScenarioStructureBSPMaterialCompressedLightmapVertex<NativeEndian> r;
-
+    ENDIAN_TEMPLATE(EndianType) static inline void compress_sbsp_lightmap_vertex_into(const ScenarioStructureBSPMaterialUncompressedLightmapVertex<EndianType> &vertex, ScenarioStructureBSPMaterialCompressedLightmapVertex<EndianType> &r) noexcept {
         r.normal = compress_vector(vertex.normal.i, vertex.normal.j, vertex.normal.k);
         r.texture_coordinate_x = compress_float<16>(vertex.texture_coords.x);
         r.texture_coordinate_y = compress_float<16>(vertex.texture_coords.y);
-
-        return r;
     }
 
-    ScenarioStructureBSPMaterialUncompressedLightmapVertex<NativeEndian> decompress_sbsp_lightmap_vertex(const ScenarioStructureBSPMaterialCompressedLightmapVertex<NativeEndian> &vertex) noexcept {
-        ScenarioStructureBSPMaterialUncompressedLightmapVertex<NativeEndian> r;
-
+    ENDIAN_TEMPLATE(EndianType) static inline void decompress_sbsp_lightmap_vertex_into(const ScenarioStructureBSPMaterialCompressedLightmapVertex<EndianType> &vertex, ScenarioStructureBSPMaterialUncompressedLightmapVertex<EndianType> &r) noexcept {
         float normal_i, normal_j, normal_k;
 
         decompress_vector(vertex.normal, normal_i, normal_j, normal_k);
@@ -361,8 +354,29 @@ namespace Invader::HEK {
 
         r.texture_coords.x = decompress_float<16>(vertex.texture_coordinate_x);
         r.texture_coords.y = decompress_float<16>(vertex.texture_coordinate_y);
-
-        return r;
     }
 
+    #define DEFINE_VERTEX_CONVERSION(function, from_type, to_type) \
+        to_type<NativeEndian> function(const from_type<NativeEndian> &vertex) noexcept { \
+            to_type<NativeEndian> r; \
+            function##_into(vertex, r); \
+            return r; \
+        } \
+        ENDIAN_TEMPLATE(EndianType) void function##_array(const from_type<EndianType> *vertices, to_type<EndianType> *output, std::size_t count) noexcept { \
+            for(std::size_t v = 0; v < count; v++) { \
+                function##_into(vertices[v], output[v]); \
+            } \
+        } \
+        template void function##_array<LittleEndian>(const from_type<LittleEndian> *, to_type<LittleEndian> *, std::size_t) noexcept; \
+        template void function##_array<BigEndian>(const from_type<BigEndian> *, to_type<BigEndian> *, std::size_t) noexcept;
+
+    DEFINE_VERTEX_CONVERSION(compress_model_vertex, ModelVertexUncompressed, ModelVertexCompressed)
+    DEFINE_VERTEX_CONVERSION(decompress_model_vertex, ModelVertexCompressed, ModelVertexUncompressed)
+    DEFINE_VERTEX_CONVERSION(compress_sbsp_rendered_vertex, ScenarioStructureBSPMaterialUncompressedRenderedVertex, ScenarioStructureBSPMaterialCompressedRenderedVertex)
+    DEFINE_VERTEX_CONVERSION(decompress_sbsp_rendered_vertex, ScenarioStructureBSPMaterialCompressedRenderedVertex, ScenarioStructureBSPMaterialUncompressedRenderedVertex)
+    DEFINE_VERTEX_CONVERSION(compress_sbsp_lightmap_vertex, ScenarioStructureBSPMaterialUncompressedLightmapVertex, ScenarioStructureBSPMaterialCompressedLightmapVertex)
+    DEFINE_VERTEX_CONVERSION(decompress_sbsp_lightmap_vertex, ScenarioStructureBSPMaterialCompressedLightmapVertex, ScenarioStructureBSPMaterialUncompressedLightmapVertex)
+
+    #undef DEFINE_VERTEX_CONVERSION
+
 }
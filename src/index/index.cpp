@@ -36,7 +36,8 @@ int main(int argc, const char **argv) {
     const char *output = remaining_arguments[1];
     const char *input = remaining_arguments[0];
 
-    auto input_map_data = File::open_file(input);
+    // Map the input rather than reading it, since only the paths are needed
+    auto input_map_data = File::MemoryMappedFile::map_file(input);
 
     // Open input map
     if(!input_map_data.has_value()) {
@@ -49,7 +50,7 @@ int main(int argc, const char **argv) {
     // If it's a resource map, try parsing that
     if(input_map.size() >= 4 && *reinterpret_cast<std::uint32_t *>(input_map.data()) <= 3) {
         try {
-            auto map = load_resource_map(input_map.data(), input_map.size());
+            auto map = ResourceMapView::map_file(input);
             auto &header = *reinterpret_cast<ResourceMapHeader *>(input_map.data());
             
             // Get our extension
@@ -96,7 +97,7 @@ int main(int argc, const char **argv) {
     // If not, it's probably a cache file
     else {
         try {
-            auto map = Map::map_with_move(std::move(input_map));
+            auto map = Map::map_with_mmap(std::move(input_map));
 
             // Open output
             std::FILE *f = std::fopen(output, "wb");
@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <optional>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
 #include <invader/map/map.hpp>
 #include <invader/file/file.hpp>
 #include "../command_line_option.hpp"
 #include <invader/crc/hek/crc.hpp>
 #include <invader/version.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/hek/map.hpp>
 #include <invader/compress/compression.hpp>
@@ -18,12 +22,21 @@
 struct DisplayValue {
     const char * const name;
     void (* const calculate_value)(const Invader::Map &map);
+    
+    // Prints one item per line rather than a single value
+    const bool list;
+    
+    // Prints a JSON value that is used as-is when processing multiple maps
+    const bool json = false;
 };
 
-#define MAKE_DISPLAY_VALUE(name) {# name, Invader::Info::name }
+#define MAKE_DISPLAY_VALUE(name) {# name, Invader::Info::name, false }
+#define MAKE_DISPLAY_LIST(name) {# name, Invader::Info::name, true }
+#define MAKE_DISPLAY_JSON(name) {# name, Invader::Info::name, false, true }
 
-static std::byte header_cache[sizeof(Invader::HEK::NativeCacheFileHeader)];
-static std::size_t file_size = 0;
+// These are per-thread since several maps are opened at once in batch mode
+static thread_local std::byte header_cache[sizeof(Invader::HEK::NativeCacheFileHeader)];
+static thread_local std::size_t file_size = 0;
 
 // Calculating compression ratio:
 //
@@ -257,63 +270,118 @@ namespace Invader::Info {
 }
 
 static DisplayValue all_values[] = {
-    MAKE_DISPLAY_VALUE(overview),
+    MAKE_DISPLAY_LIST(overview),
     MAKE_DISPLAY_VALUE(build),
     MAKE_DISPLAY_VALUE(compression_ratio),
     MAKE_DISPLAY_VALUE(crc32),
     MAKE_DISPLAY_VALUE(crc32_mismatched),
     MAKE_DISPLAY_VALUE(engine),
     
-    MAKE_DISPLAY_VALUE(external_bitmaps),
+    MAKE_DISPLAY_LIST(external_bitmaps),
     MAKE_DISPLAY_VALUE(external_bitmaps_count),
     
-    MAKE_DISPLAY_VALUE(external_bitmap_indices),
+    MAKE_DISPLAY_LIST(external_bitmap_indices),
     MAKE_DISPLAY_VALUE(external_bitmap_indices_count),
     
-    MAKE_DISPLAY_VALUE(external_bitmap_pointers),
+    MAKE_DISPLAY_LIST(external_bitmap_pointers),
     MAKE_DISPLAY_VALUE(external_bitmap_pointers_count),
     
-    MAKE_DISPLAY_VALUE(external_indices),
+    MAKE_DISPLAY_LIST(external_indices),
     MAKE_DISPLAY_VALUE(external_indices_count),
     
-    MAKE_DISPLAY_VALUE(external_loc_indices),
+    MAKE_DISPLAY_LIST(external_loc_indices),
     MAKE_DISPLAY_VALUE(external_loc_indices_count),
     
-    MAKE_DISPLAY_VALUE(external_sounds),
+    MAKE_DISPLAY_LIST(external_sounds),
     MAKE_DISPLAY_VALUE(external_sounds_count),
     
-    MAKE_DISPLAY_VALUE(external_sound_indices),
+    MAKE_DISPLAY_LIST(external_sound_indices),
     MAKE_DISPLAY_VALUE(external_sound_indices_count),
     
-    MAKE_DISPLAY_VALUE(external_sound_pointers),
+    MAKE_DISPLAY_LIST(external_sound_pointers),
     MAKE_DISPLAY_VALUE(external_sound_pointers_count),
     
-    MAKE_DISPLAY_VALUE(external_tags),
+    MAKE_DISPLAY_LIST(external_tags),
     MAKE_DISPLAY_VALUE(external_tags_count),
     
-    MAKE_DISPLAY_VALUE(internal_bitmaps),
+    MAKE_DISPLAY_LIST(internal_bitmaps),
     MAKE_DISPLAY_VALUE(internal_bitmaps_count),
     
-    MAKE_DISPLAY_VALUE(internal_sounds),
+    MAKE_DISPLAY_LIST(internal_sounds),
     MAKE_DISPLAY_VALUE(internal_sounds_count),
     
     
     MAKE_DISPLAY_VALUE(is_compressed),
     MAKE_DISPLAY_VALUE(is_dirty),
     MAKE_DISPLAY_VALUE(is_protected),
-    MAKE_DISPLAY_VALUE(languages),
+    MAKE_DISPLAY_LIST(languages),
     MAKE_DISPLAY_VALUE(map_type),
-    MAKE_DISPLAY_VALUE(protection_issues),
+    MAKE_DISPLAY_LIST(protection_issues),
     MAKE_DISPLAY_VALUE(scenario),
     MAKE_DISPLAY_VALUE(scenario_path),
     MAKE_DISPLAY_VALUE(stub_count),
     MAKE_DISPLAY_VALUE(tag_order_match),
-    MAKE_DISPLAY_VALUE(tags),
+    MAKE_DISPLAY_LIST(tags),
     MAKE_DISPLAY_VALUE(tags_count),
     MAKE_DISPLAY_VALUE(uncompressed_size),
+    MAKE_DISPLAY_JSON(usage),
     MAKE_DISPLAY_VALUE(uses_external_pointers)
 };
 
+static std::unique_ptr<Invader::Map> open_map(const char *path) {
+    using namespace Invader;
+    
+    auto file = File::MemoryMappedFile::map_file(path).value();
+    file_size = file.size();
+    if(file_size >= sizeof(header_cache)) {
+        std::memcpy(header_cache, file.data(), sizeof(header_cache));
+    }
+    
+    return std::make_unique<Map>(Map::map_with_mmap(std::move(file)));
+}
+
+// Lists become arrays of their lines, numbers are written as-is, and anything else is a string
+static void append_json_value(std::string &json, const DisplayValue &value, const std::string &output) {
+    using Invader::Info::append_json_string;
+    
+    if(value.json) {
+        auto end = output.find_last_not_of('\n');
+        json.append(output, 0, end == std::string::npos ? 0 : end + 1);
+        return;
+    }
+    
+    std::vector<std::string> lines;
+    for(std::size_t start = 0; start < output.size();) {
+        auto end = output.find('\n', start);
+        if(end == std::string::npos) {
+            end = output.size();
+        }
+        lines.emplace_back(output, start, end - start);
+        start = end + 1;
+    }
+    
+    if(value.list) {
+        json += '[';
+        for(std::size_t l = 0; l < lines.size(); l++) {
+            if(l > 0) {
+                json += ',';
+            }
+            append_json_string(json, lines[l]);
+        }
+        json += ']';
+        return;
+    }
+    
+    auto line = lines.empty() ? std::string() : lines[0];
+    bool number = !line.empty() && line.find_first_not_of("0123456789.") == std::string::npos && line.front() != '.' && line.back() != '.' && std::count(line.begin(), line.end(), '.') <= 1;
+    if(number) {
+        json += line;
+    }
+    else {
+        append_json_string(json, line);
+    }
+}
+
 int main(int argc, const char **argv) {
     set_up_color_term();
     
@@ -321,7 +389,8 @@ int main(int argc, const char **argv) {
 
     // Options struct
     struct MapInfoOptions {
-        const DisplayValue *type = &all_values[0];
+        std::vector<const DisplayValue *> types;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } map_info_options;
     
     // Form the options list
@@ -329,7 +398,7 @@ int main(int argc, const char **argv) {
     bool overview_added = false;
     for(auto &i : all_values) {
         if(!overview_added) {
-            options_list += "Set the type of data to show. Can be overview (default)";
+            options_list += "Set the type of data to show. Use multiple times to show more than one. Can be overview (default)";
             overview_added = true;
         }
         else {
@@ -341,21 +410,22 @@ int main(int argc, const char **argv) {
     // Command line options
     const CommandLineOption options[] = {
         CommandLineOption("type", 'T', 1, options_list.c_str(), "<type>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO)
     };
 
-    static constexpr char DESCRIPTION[] = "Display map metadata.";
-    static constexpr char USAGE[] = "[option] <map>";
+    static constexpr char DESCRIPTION[] = "Display map metadata. If more than one map or a directory of maps is given, each map is shown as a line of JSON with the map's path and each type of data requested.";
+    static constexpr char USAGE[] = "[option] <map...|dir>";
 
     // Do it!
-    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<MapInfoOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, map_info_options, [](char opt, const auto &args, auto &map_info_options) {
+    auto remaining_arguments = Invader::CommandLineOption::parse_arguments<MapInfoOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 65535, map_info_options, [](char opt, const auto &args, auto &map_info_options) {
         switch(opt) {
             case 'T': {
                 bool found = false;
                 
                 for(auto &i : all_values) {
                     if(std::strcmp(args[0], i.name) == 0) {
-                        map_info_options.type = &i;
+                        map_info_options.types.push_back(&i);
                         found = true;
                         break;
                     }
@@ -367,30 +437,109 @@ int main(int argc, const char **argv) {
                 }
                 break;
             }
+            case 'j':
+                map_info_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
             case 'i':
                 Invader::show_version_info();
                 std::exit(EXIT_SUCCESS);
         }
     });
-
-    // Load it
-    std::unique_ptr<Map> map;
-    try {
-        auto file = File::open_file(remaining_arguments[0]).value();
-        file_size = file.size();
-        if(file_size >= sizeof(header_cache)) {
-            std::memcpy(header_cache, file.data(), sizeof(header_cache));
+    
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(map_info_options.thread_count);
+    
+    if(map_info_options.types.empty()) {
+        map_info_options.types.push_back(&all_values[0]);
+    }
+    
+    // Find the maps. Directories are searched for .map files (not recursively).
+    std::vector<std::filesystem::path> maps;
+    bool batch = remaining_arguments.size() > 1;
+    for(auto *argument : remaining_arguments) {
+        std::error_code ec;
+        if(std::filesystem::is_directory(argument, ec)) {
+            batch = true;
+            std::vector<std::filesystem::path> directory_maps;
+            for(auto &file : std::filesystem::directory_iterator(argument, ec)) {
+                if(file.is_regular_file() && file.path().extension() == ".map") {
+                    directory_maps.emplace_back(file.path());
+                }
+            }
+            if(ec) {
+                eprintf_error("Failed to list %s: %s", argument, ec.message().c_str());
+                return EXIT_FAILURE;
+            }
+            std::sort(directory_maps.begin(), directory_maps.end());
+            maps.insert(maps.end(), directory_maps.begin(), directory_maps.end());
+        }
+        else {
+            maps.emplace_back(argument);
         }
-        
-        map = std::make_unique<Map>(Map::map_with_move(std::move(file)));
     }
-    catch (std::exception &e) {
-        eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
-        return EXIT_FAILURE;
+    
+    if(!batch) {
+        // Load it
+        std::unique_ptr<Map> map;
+        try {
+            map = open_map(remaining_arguments[0]);
+        }
+        catch (std::exception &e) {
+            eprintf_error("Failed to parse %s: %s", remaining_arguments[0], e.what());
+            return EXIT_FAILURE;
+        }
+        
+        // Do it!
+        for(auto *type : map_info_options.types) {
+            type->calculate_value(*map);
+        }
+        
+        return EXIT_SUCCESS;
     }
     
-    // Do it!
-    map_info_options.type->calculate_value(*map);
+    // Open the maps on multiple threads, printing each line in the order the maps were given
+    std::vector<std::optional<std::string>> lines(maps.size());
+    std::size_t next_line_to_print = 0;
+    std::mutex lines_mutex;
+    std::atomic<bool> any_failed = false;
+    
+    ThreadPool::shared().parallel_for(maps.size(), [&](std::size_t m) {
+        auto path = maps[m].string();
+        std::string line = "{\"map\":";
+        Info::append_json_string(line, path);
+        
+        try {
+            auto map = open_map(path.c_str());
+            for(auto *type : map_info_options.types) {
+                std::string output;
+                Info::collect_values(&output);
+                type->calculate_value(*map);
+                Info::collect_values(nullptr);
+                
+                line += ',';
+                Info::append_json_string(line, type->name);
+                line += ':';
+                append_json_value(line, *type, output);
+            }
+        }
+        catch(std::exception &e) {
+            Info::collect_values(nullptr);
+            any_failed = true;
+            line = "{\"map\":";
+            Info::append_json_string(line, path);
+            line += ",\"error\":";
+            Info::append_json_string(line, e.what());
+        }
+        line += '}';
+        
+        std::scoped_lock lock(lines_mutex);
+        lines[m] = std::move(line);
+        while(next_line_to_print < lines.size() && lines[next_line_to_print].has_value()) {
+            oprintf("%s\n", lines[next_line_to_print]->c_str());
+            lines[next_line_to_print].reset();
+            next_line_to_print++;
+        }
+    }, map_info_options.thread_count);
     
-    return EXIT_SUCCESS;
+    return any_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
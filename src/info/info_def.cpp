@@ -1,8 +1,13 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <unordered_map>
 #include <invader/map/map.hpp>
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/hek/map.hpp>
 #include <invader/resource/list/resource_list.hpp>
 #include <invader/tag/index/index.hpp>
@@ -10,6 +15,90 @@
 #include "info_def.hpp"
 
 namespace Invader::Info {
+    static thread_local std::string *collected_values = nullptr;
+    
+    void print_value(const char *format, ...) {
+        std::va_list args;
+        va_start(args, format);
+        if(collected_values == nullptr) {
+            std::vprintf(format, args);
+        }
+        else {
+            std::va_list args_copy;
+            va_copy(args_copy, args);
+            int length = std::vsnprintf(nullptr, 0, format, args_copy);
+            va_end(args_copy);
+            if(length > 0) {
+                auto offset = collected_values->size();
+                collected_values->resize(offset + length + 1);
+                std::vsnprintf(collected_values->data() + offset, length + 1, format, args);
+                collected_values->resize(offset + length);
+            }
+        }
+        va_end(args);
+    }
+    
+    void print_colored_value(const char *color, const char *format, ...) {
+        std::va_list args;
+        va_start(args, format);
+        std::va_list args_copy;
+        va_copy(args_copy, args);
+        int length = std::vsnprintf(nullptr, 0, format, args_copy);
+        va_end(args_copy);
+        std::string line(length > 0 ? length : 0, '\0');
+        if(length > 0) {
+            std::vsnprintf(line.data(), line.size() + 1, format, args);
+        }
+        va_end(args);
+        
+        if(collected_values == nullptr) {
+            print_colored_line(stdout, color, "%s", line.c_str());
+        }
+        else {
+            *collected_values += line;
+            *collected_values += '\n';
+        }
+    }
+    
+    void collect_values(std::string *output) noexcept {
+        collected_values = output;
+    }
+    
+    bool collecting_values() noexcept {
+        return collected_values != nullptr;
+    }
+    
+    void append_json_string(std::string &json, const std::string &string) {
+        json += '"';
+        for(char c : string) {
+            switch(c) {
+                case '"':
+                    json += "\\\"";
+                    break;
+                case '\\':
+                    json += "\\\\";
+                    break;
+                case '\n':
+                    json += "\\n";
+                    break;
+                case '\t':
+                    json += "\\t";
+                    break;
+                default:
+                    if(static_cast<unsigned char>(c) < 0x20) {
+                        char escape[7];
+                        std::snprintf(escape, sizeof(escape), "\\u%04X", static_cast<unsigned char>(c));
+                        json += escape;
+                    }
+                    else {
+                        json += c;
+                    }
+                    break;
+            }
+        }
+        json += '"';
+    }
+    
     static void print_all_indices(const Invader::Map &map, const std::vector<std::size_t> &indices) {
         for(auto i : indices) {
             auto &tag = map.get_tag(i);
@@ -275,7 +364,6 @@ namespace Invader::Info {
     }
     
     std::vector<std::string> find_languages_for_map(const Invader::Map &map, bool &all) {
-        auto tag_count = map.get_tag_count();
         std::vector<std::string> languages;
         all = false;
         auto engine = map.get_cache_version();
@@ -289,25 +377,16 @@ namespace Invader::Info {
             
             // Now compile a list of offsets
             std::vector<std::size_t> bitmap_offsets, bitmap_sizes, sound_offsets, sound_sizes;
-            for(std::size_t i = 0; i < tag_count; i++) {
-                auto &tag = map.get_tag(i);
-                switch(tag.get_tag_fourcc()) {
-                    case HEK::TagFourCC::TAG_FOURCC_SOUND:
-                        for(auto &i : resource_offsets_for_tag(tag)) {
-                            sound_offsets.push_back(i.first);
-                            sound_sizes.push_back(i.second);
-                        }
-                        break;
-                    
-                    case HEK::TagFourCC::TAG_FOURCC_BITMAP:
-                        for(auto &i : resource_offsets_for_tag(tag)) {
-                            bitmap_offsets.push_back(i.first);
-                            bitmap_sizes.push_back(i.second);
-                        }
-                        break;
-                    
-                    default:
-                        break;
+            for(auto t : map.get_tags_of_class(HEK::TagFourCC::TAG_FOURCC_SOUND)) {
+                for(auto &i : resource_offsets_for_tag(map.get_tag(t))) {
+                    sound_offsets.push_back(i.first);
+                    sound_sizes.push_back(i.second);
+                }
+            }
+            for(auto t : map.get_tags_of_class(HEK::TagFourCC::TAG_FOURCC_BITMAP)) {
+                for(auto &i : resource_offsets_for_tag(map.get_tag(t))) {
+                    bitmap_offsets.push_back(i.first);
+                    bitmap_sizes.push_back(i.second);
                 }
             }
             
@@ -400,7 +479,6 @@ namespace Invader::Info {
     }
     
     void external_bitmap_pointers(const Invader::Map &map) {
-        std::printf("A\n");
         print_all_indices(map, find_external_tags_indices(map, Map::DataMapType::DATA_MAP_BITMAP, false, true));
     }
     void external_bitmap_pointers_count(const Invader::Map &map) {
@@ -477,6 +555,295 @@ namespace Invader::Info {
         oprintf("%zu\n", map.get_data_length());
     }
     
+    void usage(const Invader::Map &map) {
+        struct Usage {
+            std::size_t count = 0;
+            std::size_t indexed = 0;
+            std::size_t tag_data = 0;
+            std::size_t bsp = 0;
+            std::size_t bitmap_data = 0;
+            std::size_t sound_data = 0;
+            std::size_t external_bitmap_data = 0;
+            std::size_t external_sound_data = 0;
+            
+            Usage &operator +=(const Usage &other) noexcept {
+                this->count += other.count;
+                this->indexed += other.indexed;
+                this->tag_data += other.tag_data;
+                this->bsp += other.bsp;
+                this->bitmap_data += other.bitmap_data;
+                this->sound_data += other.sound_data;
+                this->external_bitmap_data += other.external_bitmap_data;
+                this->external_sound_data += other.external_sound_data;
+                return *this;
+            }
+        };
+        
+        auto cache_version = map.get_cache_version();
+        bool native = cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE;
+        auto tag_count = map.get_tag_count();
+        std::vector<Usage> tag_usage(tag_count);
+        
+        // BSPs are outside of tag data (except on native maps), and their size is only given by the scenario tag
+        std::unordered_map<std::size_t, std::size_t> bsp_sizes;
+        if(!native) {
+            auto &scenario_tag = map.get_tag(map.get_scenario_tag_id());
+            auto &scenario = scenario_tag.get_base_struct<HEK::Scenario>();
+            std::size_t bsp_count = scenario.structure_bsps.count;
+            auto *bsps = scenario_tag.resolve_reflexive(scenario.structure_bsps);
+            for(std::size_t b = 0; b < bsp_count; b++) {
+                bsp_sizes.insert_or_assign(bsps[b].structure_bsp.tag_id.read().index, bsps[b].bsp_size.read());
+            }
+        }
+        
+        // Raw data that is referenced more than once is already shared, but raw data that is identical to other raw
+        // data could be
+        Usage total;
+        std::size_t bitmap_data_savings = 0, sound_data_savings = 0;
+        std::unordered_map<const std::byte *, std::size_t> raw_data_seen;
+        std::unordered_map<std::uint64_t, std::vector<std::pair<const std::byte *, std::size_t>>> raw_data_by_hash;
+        auto add_raw_data = [&](const std::byte *data, std::size_t size, std::size_t &usage, std::size_t &total_usage, std::size_t &savings) {
+            if(size == 0 || !raw_data_seen.emplace(data, size).second) {
+                return;
+            }
+            usage += size;
+            total_usage += size;
+            
+            auto &candidates = raw_data_by_hash[FNV1AHash::hash_bytes(data, size)];
+            for(auto &[other, other_size] : candidates) {
+                if(other_size == size && std::memcmp(other, data, size) == 0) {
+                    savings += size;
+                    return;
+                }
+            }
+            candidates.emplace_back(data, size);
+        };
+        
+        // Tag data isn't split up by tag, so each tag's data is assumed to go from its base struct to the next tag's
+        const auto *tag_data_start = map.get_tag_data_at_offset(0);
+        std::vector<std::pair<std::size_t, std::size_t>> tag_data_offsets;
+        tag_data_offsets.reserve(tag_count);
+        
+        for(std::size_t t = 0; t < tag_count; t++) {
+            auto &tag = map.get_tag(t);
+            auto &usage = tag_usage[t];
+            usage.count = 1;
+            if(tag.is_stub()) {
+                continue;
+            }
+            
+            // Indexed tags' data is in a resource map (except for the base struct of sound tags)
+            auto tag_fourcc = tag.get_tag_fourcc();
+            if(tag.is_indexed()) {
+                usage.indexed = 1;
+                if(tag_fourcc != TagFourCC::TAG_FOURCC_SOUND) {
+                    continue;
+                }
+            }
+            
+            auto bsp = bsp_sizes.find(t);
+            if(bsp != bsp_sizes.end()) {
+                usage.bsp = bsp->second;
+                total.bsp += bsp->second;
+            }
+            else {
+                const std::byte *base_struct;
+                try {
+                    base_struct = native ? tag.get_base_struct_data() : map.resolve_tag_data_pointer(tag.get_tag_data_index().tag_data, 1);
+                }
+                catch(std::exception &) {
+                    base_struct = nullptr;
+                }
+                if(base_struct != nullptr) {
+                    tag_data_offsets.emplace_back(base_struct - tag_data_start, t);
+                }
+            }
+            
+            if(tag.is_indexed() || !tag.data_is_available()) {
+                continue;
+            }
+            
+            switch(tag_fourcc) {
+                case TagFourCC::TAG_FOURCC_BITMAP: {
+                    auto &bitmap_header = tag.get_base_struct<HEK::Bitmap>();
+                    std::size_t bitmap_data_count = bitmap_header.bitmap_data.count;
+                    auto *bitmap_data = tag.resolve_reflexive(bitmap_header.bitmap_data);
+                    for(std::size_t b = 0; b < bitmap_data_count; b++) {
+                        auto &bd = bitmap_data[b];
+                        std::size_t size = bd.pixel_data_size.read();
+                        if(bd.flags.read() & HEK::BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL) {
+                            usage.external_bitmap_data += size;
+                            total.external_bitmap_data += size;
+                        }
+                        else {
+                            add_raw_data(map.get_internal_asset(bd.pixel_data_offset.read(), size), size, usage.bitmap_data, total.bitmap_data, bitmap_data_savings);
+                        }
+                    }
+                    break;
+                }
+                    
+                case TagFourCC::TAG_FOURCC_SOUND: {
+                    auto &sound_header = tag.get_base_struct<HEK::Sound>();
+                    std::size_t pitch_range_count = sound_header.pitch_ranges.count;
+                    auto *pitch_ranges = tag.resolve_reflexive(sound_header.pitch_ranges);
+                    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+                        auto &pitch_range = pitch_ranges[pr];
+                        auto *permutations = tag.resolve_reflexive(pitch_range.permutations);
+                        std::size_t permutation_count = pitch_range.permutations.count;
+                        for(std::size_t pe = 0; pe < permutation_count; pe++) {
+                            auto &samples = permutations[pe].samples;
+                            std::size_t size = samples.size.read();
+                            if(samples.external & 1) {
+                                usage.external_sound_data += size;
+                                total.external_sound_data += size;
+                            }
+                            else {
+                                add_raw_data(map.get_internal_asset(samples.file_offset.read(), size), size, usage.sound_data, total.sound_data, sound_data_savings);
+                            }
+                        }
+                    }
+                    break;
+                }
+                    
+                default:
+                    break;
+            }
+        }
+        
+        // Anything before the first tag's base struct is the tag data header and tag array
+        auto tag_data_length = map.get_tag_data_length();
+        std::sort(tag_data_offsets.begin(), tag_data_offsets.end());
+        for(std::size_t i = 0; i < tag_data_offsets.size(); i++) {
+            auto [offset, t] = tag_data_offsets[i];
+            auto next = i + 1 < tag_data_offsets.size() ? tag_data_offsets[i + 1].first : tag_data_length;
+            if(offset < next && next <= tag_data_length) {
+                tag_usage[t].tag_data = next - offset;
+            }
+        }
+        total.tag_data = tag_data_length;
+        
+        // Add everything up by group, in the order each group first appears
+        std::vector<std::pair<TagFourCC, Usage>> group_usage;
+        std::unordered_map<TagFourCC, std::size_t> group_indices;
+        std::size_t largest_bsp = 0;
+        for(std::size_t t = 0; t < tag_count; t++) {
+            auto tag_fourcc = map.get_tag(t).get_tag_fourcc();
+            auto [group, added] = group_indices.emplace(tag_fourcc, group_usage.size());
+            if(added) {
+                group_usage.emplace_back(tag_fourcc, Usage());
+            }
+            group_usage[group->second].second += tag_usage[t];
+            total.count++;
+            total.indexed += tag_usage[t].indexed;
+            largest_bsp = std::max(largest_bsp, tag_usage[t].bsp);
+        }
+        
+        auto &game_engine_info = HEK::GameEngineInfo::get_game_engine_info(map.get_game_engine());
+        auto file_size = map.get_data_length();
+        auto model_data_size = map.get_model_data_size();
+        auto model_vertices_size = std::min(map.get_model_index_offset(), model_data_size);
+        
+        // The largest BSP is loaded into tag space along with the tag data. Indexed tags also take up tag space, but
+        // that can't be known without the resource maps.
+        std::size_t tag_space = tag_data_length + (game_engine_info.bsps_occupy_tag_space ? largest_bsp : 0);
+        
+        std::string json;
+        auto add_number = [&json](const char *name, std::uint64_t value) {
+            json += '"';
+            json += name;
+            json += "\":";
+            json += std::to_string(value);
+        };
+        auto add_usage = [&add_number, &json](const Usage &usage) {
+            add_number("count", usage.count);
+            json += ',';
+            add_number("indexed", usage.indexed);
+            json += ',';
+            add_number("tag_data", usage.tag_data);
+            json += ',';
+            add_number("bsp", usage.bsp);
+            json += ',';
+            add_number("bitmap_data", usage.bitmap_data);
+            json += ',';
+            add_number("sound_data", usage.sound_data);
+            json += ',';
+            add_number("external_bitmap_data", usage.external_bitmap_data);
+            json += ',';
+            add_number("external_sound_data", usage.external_sound_data);
+        };
+        auto add_limit = [&add_number, &json](const char *name, std::uint64_t value) {
+            if(value <= UINT32_MAX) {
+                add_number(name, value);
+            }
+            else {
+                json += '"';
+                json += name;
+                json += "\":null";
+            }
+        };
+        
+        json += '{';
+        add_number("file_size", file_size);
+        json += ',';
+        add_limit("maximum_file_size", game_engine_info.get_maximum_file_size(map.get_type()));
+        json += ',';
+        add_number("tag_space", tag_space);
+        json += ',';
+        add_limit("maximum_tag_space", game_engine_info.tag_space_length);
+        
+        std::size_t accounted = total.tag_data + total.bsp + model_data_size + total.bitmap_data + total.sound_data;
+        json += ",\"sections\":{";
+        add_number("tag_data", total.tag_data);
+        json += ',';
+        add_number("bsp", total.bsp);
+        json += ',';
+        add_number("model_vertices", model_vertices_size);
+        json += ',';
+        add_number("model_indices", model_data_size - model_vertices_size);
+        json += ',';
+        add_number("bitmap_data", total.bitmap_data);
+        json += ',';
+        add_number("sound_data", total.sound_data);
+        json += ',';
+        add_number("other", file_size > accounted ? file_size - accounted : 0);
+        json += ',';
+        add_number("external_bitmap_data", total.external_bitmap_data);
+        json += ',';
+        add_number("external_sound_data", total.external_sound_data);
+        
+        json += "},\"dedupe_savings\":{";
+        add_number("bitmap_data", bitmap_data_savings);
+        json += ',';
+        add_number("sound_data", sound_data_savings);
+        
+        json += "},\"total\":{";
+        add_usage(total);
+        
+        json += "},\"groups\":[";
+        for(std::size_t g = 0; g < group_usage.size(); g++) {
+            json += g == 0 ? "{" : ",{";
+            json += "\"group\":";
+            append_json_string(json, HEK::tag_fourcc_to_extension(group_usage[g].first));
+            json += ',';
+            add_usage(group_usage[g].second);
+            json += '}';
+        }
+        
+        json += "],\"tags\":[";
+        for(std::size_t t = 0; t < tag_count; t++) {
+            auto &tag = map.get_tag(t);
+            json += t == 0 ? "{" : ",{";
+            json += "\"path\":";
+            append_json_string(json, File::halo_path_to_preferred_path(tag.get_path()) + "." + HEK::tag_fourcc_to_extension(tag.get_tag_fourcc()));
+            json += ',';
+            add_usage(tag_usage[t]);
+            json += '}';
+        }
+        json += "]}";
+        
+        oprintf("%s\n", json.c_str());
+    }
+    
     void tag_order_match(const Invader::Map &map) {
         switch(check_tag_order(map)) {
             case CHECK_TAG_ORDER_RESULT_UNKNOWN:
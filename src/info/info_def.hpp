@@ -5,12 +5,46 @@
 
 #include <vector>
 #include <optional>
+#include <string>
+#include <invader/printf.hpp>
 
 namespace Invader {
     class Map;
 }
 
 namespace Invader::Info {
+    /**
+     * Print a value, or add it to the output being collected on this thread
+     * @param format printf format
+     */
+    void print_value(const char *format, ...);
+    
+    /**
+     * Print a line in color, or add it to the output being collected on this thread (without the color)
+     * @param color  terminal color escape code
+     * @param format printf format
+     */
+    void print_colored_value(const char *color, const char *format, ...);
+    
+    /**
+     * Collect values printed on this thread into a string instead of printing them
+     * @param output string to append to, or nullptr to print them again
+     */
+    void collect_values(std::string *output) noexcept;
+    
+    /**
+     * Get whether values printed on this thread are being collected
+     * @return true if being collected
+     */
+    bool collecting_values() noexcept;
+    
+    /**
+     * Append a string to JSON output as a quoted and escaped JSON string
+     * @param json   JSON output to append to
+     * @param string string to append
+     */
+    void append_json_string(std::string &json, const std::string &string);
+    
     /**
      * Check if the indices are valid for stock Halo Custom Edition
      * @param map map to check
@@ -111,7 +145,22 @@ namespace Invader::Info {
     void tags_count(const Invader::Map &);
     void tag_order_match(const Invader::Map &);
     void uncompressed_size(const Invader::Map &);
+    void usage(const Invader::Map &);
     void uses_external_pointers(const Invader::Map &);
 }
 
+// Values are printed with print_value() so they can be collected when processing multiple maps (and without colors)
+#undef oprintf
+#define oprintf(...) Invader::Info::print_value(__VA_ARGS__)
+#undef ON_COLOR_TERM
+#define ON_COLOR_TERM(fd) (!Invader::Info::collecting_values() && is_on_color_term())
+#undef oprintf_success
+#define oprintf_success(...) Invader::Info::print_colored_value("\x1B[32m", __VA_ARGS__)
+#undef oprintf_success_warn
+#define oprintf_success_warn(...) Invader::Info::print_colored_value("\x1B[1;33m", __VA_ARGS__)
+#undef oprintf_success_lesser_warn
+#define oprintf_success_lesser_warn(...) Invader::Info::print_colored_value("\x1B[1;35m", __VA_ARGS__)
+#undef oprintf_fail
+#define oprintf_fail(...) Invader::Info::print_colored_value("\x1B[1;31m", __VA_ARGS__)
+
 #endif
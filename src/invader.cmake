@@ -58,16 +58,31 @@ set(INVADER_SOURCE_FILES
     src/sound/adpcm_xq/adpcm-lib.c
 
     src/error.cpp
+    src/thread_pool.cpp
+    src/memory_usage.cpp
     src/hek/fourcc.cpp
     src/hek/data_type.cpp
     src/hek/map.cpp
     src/resource/resource_map.cpp
+    src/dependency/dependency_index.cpp
     src/dependency/found_tag_dependency.cpp
     src/map/map.cpp
     src/map/tag.cpp
+    src/map/patch.cpp
     src/file/file.cpp
+    src/file/file_prefetcher.cpp
+    src/file/file_writer.cpp
+    src/file/memory_mapped_file.cpp
+    src/file/path_index.cpp
+    src/file/tag_bundle.cpp
+    src/file/text_writer.cpp
     src/build/build_workload.cpp
     src/build/build_workload_dedupe.cpp
+    src/build/build_workload_layout.cpp
+    src/build/build_workload_profile.cpp
+    src/build/build_workload_raw_data_spill.cpp
+    src/build/build_workload_resource_match.cpp
+    src/build/build_workload_tag_cache.cpp
     src/bitmap/bcdec/bcdec.c
     src/bitmap/swizzle.cpp
     src/bitmap/bitmap_encode.cpp
@@ -149,6 +164,12 @@ add_library(invader-bitmap-p8-palette OBJECT
     "${CMAKE_CURRENT_BINARY_DIR}/p8_palette.cpp"
 )
 
+# Counting allocations replaces operator new and operator delete for the whole process, so it's only for profiling
+option(INVADER_MEMORY_USAGE "Count the memory allocated by each part of Invader (shown in invader-build profiles and by invader-bitmap and invader-sound)" OFF)
+if(${INVADER_MEMORY_USAGE})
+    add_definitions(-DINVADER_MEMORY_USAGE)
+endif()
+
 # This is just for memes
 option(INVADER_FORCE_PORTABLE_PREFERRED_PATHS "Use forward slashes for all preferred paths (does nothing if it's already a forward slash)")
 if(${INVADER_FORCE_PORTABLE_PREFERRED_PATHS})
@@ -1,17 +1,34 @@
 #include "actions.hpp"
 
 #include <invader/file/file.hpp>
-#include <invader/build/build_workload.hpp>
-#include <invader/map/map.hpp>
+#include <invader/file/text_writer.hpp>
+#include <invader/tag/parser/parser.hpp>
+#include <invader/tag/hek/class/model_collision_geometry.hpp>
+#include <invader/tag/hek/header.hpp>
+#include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <map>
+#include <memory>
 
 using namespace Invader;
 
 static constexpr const std::size_t MESH_FORMAT_VERSION = 1;
 
+// Below this many surfaces per thread, importing materials in parallel costs more than it saves
+static constexpr const std::size_t MIN_PARALLEL_SURFACE_COUNT = 16384;
+
+// Binary meshes start with this magic followed by a 32-bit version and a 32-bit baked flag (0 = unbaked, 1 = baked).
+// The rest mirrors the text format: unbaked meshes have skies, materials, models, and objects, and baked meshes have
+// the format followed by BSPs with their UVs, triangles, and lightmaps.
+static constexpr const char BINARY_MESH_MAGIC[8] = { 'i', 'n', 'v', 'l', 'm', 'e', 's', 'h' };
+static constexpr const std::uint32_t BINARY_MESH_FORMAT_VERSION = 1;
+
 struct ExportedVertex {
     float x, y, z;
     float i, j, k;
@@ -77,9 +94,149 @@ struct ExportedObject {
     float roll;
 };
 
-static std::size_t add_shader_to_materials(const Tag &tag, std::vector<ExportedMaterial> &materials) {
-    auto fourcc = tag.get_tag_fourcc();
-    auto full_path = tag.get_path() + "." + HEK::tag_fourcc_to_extension(fourcc);
+struct ExportedMesh {
+    std::vector<ExportedSky> skies;
+    std::vector<ExportedMaterial> materials;
+    std::vector<ExportedModel> bsps;
+    std::vector<ExportedModel> models;
+    std::vector<ExportedObject> objects;
+};
+
+// Everything in a binary mesh is little endian, and arrays and strings are prefixed with a 32-bit length
+class BinaryMeshWriter {
+public:
+    void write_u32(std::uint32_t value) {
+        HEK::LittleEndian<std::uint32_t> value_le = value;
+        this->write_bytes(&value_le, sizeof(value_le));
+    }
+    
+    void write_f32(float value) {
+        HEK::LittleEndian<float> value_le = value;
+        this->write_bytes(&value_le, sizeof(value_le));
+    }
+    
+    void write_count(std::size_t count) {
+        if(count > UINT32_MAX) {
+            eprintf_error("Mesh has too many elements to write (%zu)", count);
+            std::exit(EXIT_FAILURE);
+        }
+        this->write_u32(static_cast<std::uint32_t>(count));
+    }
+    
+    void write_string(const std::string &string) {
+        this->write_count(string.size());
+        this->write_bytes(string.data(), string.size());
+    }
+    
+    void write_bytes(const void *bytes, std::size_t size) {
+        auto *bytes_start = reinterpret_cast<const std::byte *>(bytes);
+        this->data.insert(this->data.end(), bytes_start, bytes_start + size);
+    }
+    
+    std::vector<std::byte> data;
+};
+
+class BinaryMeshReader {
+public:
+    BinaryMeshReader(const std::byte *data, std::size_t size) noexcept : data(data), size(size) {}
+    
+    std::uint32_t read_u32() {
+        return this->read<std::uint32_t>();
+    }
+    
+    float read_f32() {
+        return this->read<float>();
+    }
+    
+    std::string read_string() {
+        std::size_t length = this->read_u32();
+        auto *string = reinterpret_cast<const char *>(this->read_bytes(length));
+        return std::string(string, length);
+    }
+    
+    const std::byte *read_bytes(std::size_t length) {
+        if(this->size - this->offset < length) {
+            throw OutOfBoundsException();
+        }
+        auto *bytes = this->data + this->offset;
+        this->offset += length;
+        return bytes;
+    }
+    
+    bool done() const noexcept {
+        return this->offset == this->size;
+    }
+    
+private:
+    template<typename T> T read() {
+        HEK::LittleEndian<T> value;
+        std::memcpy(&value, this->read_bytes(sizeof(value)), sizeof(value));
+        return value.read();
+    }
+    
+    const std::byte *data;
+    std::size_t size;
+    std::size_t offset = 0;
+};
+
+// Tags read while exporting, by path with extension, so each one is only read once
+class ExportTagLoader {
+public:
+    ExportTagLoader(const std::vector<std::filesystem::path> &tags_directories) : tags_directories(tags_directories) {}
+    
+    const std::vector<std::byte> &load_data(const std::string &path) {
+        auto &tag = this->tags[path];
+        if(!tag.data.has_value()) {
+            auto file_path = File::tag_path_to_file_path(path, this->tags_directories);
+            if(!file_path.has_value()) {
+                eprintf_error("Cannot find tag %s", path.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            tag.data = File::open_file(*file_path);
+            if(!tag.data.has_value()) {
+                eprintf_error("Failed to open %s", file_path->string().c_str());
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        return *tag.data;
+    }
+    
+    template<typename T> const T &load(const std::string &path) {
+        auto &data = this->load_data(path);
+        auto &tag = this->tags[path];
+        if(!tag.parsed) {
+            try {
+                tag.parsed = Parser::ParserStruct::parse_hek_tag_file(data.data(), data.size(), true);
+            }
+            catch(std::exception &e) {
+                eprintf_error("Failed to parse %s: %s", path.c_str(), e.what());
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        auto *parsed = dynamic_cast<const T *>(tag.parsed.get());
+        if(!parsed) {
+            eprintf_error("%s is not the expected tag class", path.c_str());
+            std::exit(EXIT_FAILURE);
+        }
+        return *parsed;
+    }
+    
+private:
+    struct LoadedTag {
+        std::optional<std::vector<std::byte>> data;
+        std::unique_ptr<Parser::ParserStruct> parsed;
+    };
+    const std::vector<std::filesystem::path> &tags_directories;
+    std::map<std::string, LoadedTag> tags;
+};
+
+static std::string dependency_path(const Parser::Dependency &dependency) {
+    return dependency.path + "." + HEK::tag_fourcc_to_extension(dependency.tag_fourcc);
+}
+
+static std::size_t add_shader_to_materials(const Parser::Dependency &shader_reference, ExportTagLoader &loader, std::vector<ExportedMaterial> &materials) {
+    auto fourcc = shader_reference.tag_fourcc;
+    auto full_path = dependency_path(shader_reference);
     auto mat_count = materials.size();
     for(std::size_t m = 0; m < mat_count; m++) {
         if(materials[m].path == full_path) {
@@ -87,8 +244,13 @@ static std::size_t add_shader_to_materials(const Tag &tag, std::vector<ExportedM
         }
     }
     
-    // Get the shader of fun
-    auto &shader = tag.get_base_struct<HEK::Shader>();
+    // Every shader class starts with the same base struct, so read it directly rather than parsing each class
+    auto &shader_data = loader.load_data(full_path);
+    if(shader_data.size() < sizeof(HEK::TagFileHeader) + sizeof(HEK::Shader<HEK::BigEndian>)) {
+        eprintf_error("Failed to parse %s: It is truncated", full_path.c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    auto &shader = *reinterpret_cast<const HEK::Shader<HEK::BigEndian> *>(shader_data.data() + sizeof(HEK::TagFileHeader));
     bool opaque = fourcc == HEK::TagFourCC::TAG_FOURCC_SHADER_MODEL || fourcc == HEK::TagFourCC::TAG_FOURCC_SHADER_ENVIRONMENT;
     
     // Add the material
@@ -107,33 +269,26 @@ static std::size_t add_shader_to_materials(const Tag &tag, std::vector<ExportedM
     return mat_count;
 }
 
-static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &materials_arr, std::vector<ExportedSky> &skies_arr) {
+static ExportedModel read_bsp(const Parser::ScenarioStructureBSP &bsp, const std::string &bsp_path, const Parser::Scenario &scenario, ExportTagLoader &loader, std::vector<ExportedMaterial> &materials_arr, std::vector<ExportedSky> &skies_arr) {
     ExportedModel exported_model;
-    exported_model.path = tag.get_path() + "." + HEK::tag_fourcc_to_extension(tag.get_tag_fourcc());
-    
-    auto &base_struct = tag.get_base_struct<HEK::ScenarioStructureBSP>();
-    
-    std::size_t triangle_count = base_struct.surfaces.count;
-    const Parser::ScenarioStructureBSPSurface::struct_little *triangles = reinterpret_cast<const Parser::ScenarioStructureBSPSurface::struct_little *>(tag.data(base_struct.surfaces.pointer, sizeof(*triangles) * triangle_count));
+    exported_model.path = bsp_path;
     
-    std::size_t lightmaps_count = base_struct.lightmaps.count;
-    const Parser::ScenarioStructureBSPLightmap::struct_little *lightmaps = reinterpret_cast<const Parser::ScenarioStructureBSPLightmap::struct_little *>(tag.data(base_struct.lightmaps.pointer, sizeof(*lightmaps) * lightmaps_count));
+    auto triangle_count = bsp.surfaces.size();
     
-    auto &map = tag.get_map();
-    
-    for(std::size_t l = 0; l < lightmaps_count; l++) {
-        auto &lightmap = lightmaps[l];
-        std::size_t materials_count = lightmap.materials.count;
-        const Parser::ScenarioStructureBSPMaterial::struct_little *materials = reinterpret_cast<const Parser::ScenarioStructureBSPMaterial::struct_little *>(tag.data(lightmap.materials.pointer, sizeof(*materials) * materials_count));
+    for(auto &lightmap : bsp.lightmaps) {
         auto first_triangle_index_this_lightmap = exported_model.triangles.size();
         
         // Go through each lightmap
-        for(std::size_t m = 0; m < materials_count; m++) {
-            auto &material = materials[m];
+        for(auto &material : lightmap.materials) {
             std::size_t rendered_vertices_count = material.rendered_vertices_count;
-            const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *uncompressed_vertices = reinterpret_cast<const Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little *>(tag.data(material.uncompressed_vertices.pointer, sizeof(*uncompressed_vertices) * rendered_vertices_count));
+            using UncompressedRenderedVertex = Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little;
+            if(material.uncompressed_vertices.size() < sizeof(UncompressedRenderedVertex) * rendered_vertices_count) {
+                eprintf_error("BSP uncompressed vertices size is wrong");
+                std::exit(EXIT_FAILURE);
+            }
+            auto *uncompressed_vertices = reinterpret_cast<const UncompressedRenderedVertex *>(material.uncompressed_vertices.data());
             
-            std::size_t material_index = add_shader_to_materials(map.get_tag(material.shader.tag_id.read().index), materials_arr);
+            std::size_t material_index = add_shader_to_materials(material.shader, loader, materials_arr);
             std::size_t offset = exported_model.vertices.size();
             for(std::size_t v = 0; v < rendered_vertices_count; v++) {
                 auto &vertex = exported_model.vertices.emplace_back();
@@ -148,10 +303,14 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
             
             std::size_t initial_surface = material.surfaces;
             std::size_t surface_count = material.surface_count;
+            if(initial_surface > triangle_count || triangle_count - initial_surface < surface_count) {
+                eprintf_error("BSP surfaces are out of bounds");
+                std::exit(EXIT_FAILURE);
+            }
             
             for(std::size_t t = 0; t < surface_count; t++) {
                 auto &triangle = exported_model.triangles.emplace_back();
-                auto &surface = triangles[t + initial_surface];
+                auto &surface = bsp.surfaces[t + initial_surface];
                 triangle.material = material_index;
                 
                 triangle.a = offset + surface.vertex0_index;
@@ -168,46 +327,44 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
         }
     }
     
-    // Clusters
-    std::size_t cluster_count = base_struct.clusters.count;
-    const Parser::ScenarioStructureBSPCluster::struct_little *clusters = reinterpret_cast<const Parser::ScenarioStructureBSPCluster::struct_little *>(tag.data(base_struct.clusters.pointer, sizeof(*clusters) * cluster_count));
-    auto &scenario_tag = map.get_tag(map.get_scenario_tag_id());
-    auto &scenario_tag_struct = scenario_tag.get_base_struct<HEK::Scenario>();
-    
     std::map<std::size_t, bool> sky_tag_added;
     
     // Go through each cluster. Add all skyboxes
-    for(std::size_t c = 0; c < cluster_count; c++) {
-        std::size_t sky = clusters[c].sky.read();
+    for(auto &cluster : bsp.clusters) {
+        std::size_t sky = cluster.sky;
         if(sky == NULL_INDEX || sky_tag_added[sky]) {
             continue;
         }
+        if(sky >= scenario.skies.size()) {
+            eprintf_error("BSP cluster references an invalid sky (%zu >= %zu)", sky, scenario.skies.size());
+            std::exit(EXIT_FAILURE);
+        }
         
         sky_tag_added[sky] = true;
+        auto &sky_reference = scenario.skies[sky].sky;
+        if(sky_reference.path.empty()) {
+            continue;
+        }
         auto &sky_in_array = skies_arr.emplace_back();
         
         // Add the sky
-        auto &sky_entry = scenario_tag.get_struct_from_reflexive(scenario_tag_struct.skies, sky);
-        auto &sky_tag = map.get_tag(sky_entry.sky.tag_id.read().index);
-        auto &sky_tag_struct = sky_tag.get_base_struct<HEK::Sky>();
-        sky_in_array.path = sky_tag.get_path() + "." + HEK::tag_fourcc_to_extension(sky_tag.get_tag_fourcc());
+        auto sky_path = dependency_path(sky_reference);
+        auto &sky_tag = loader.load<Parser::Sky>(sky_path);
+        sky_in_array.path = sky_path;
         
-        sky_in_array.outdoor_power = sky_tag_struct.outdoor_ambient_radiosity_power;
-        sky_in_array.outdoor_red = sky_tag_struct.outdoor_ambient_radiosity_color.red;
-        sky_in_array.outdoor_green = sky_tag_struct.outdoor_ambient_radiosity_color.green;
-        sky_in_array.outdoor_blue = sky_tag_struct.outdoor_ambient_radiosity_color.blue;
+        sky_in_array.outdoor_power = sky_tag.outdoor_ambient_radiosity_power;
+        sky_in_array.outdoor_red = sky_tag.outdoor_ambient_radiosity_color.red;
+        sky_in_array.outdoor_green = sky_tag.outdoor_ambient_radiosity_color.green;
+        sky_in_array.outdoor_blue = sky_tag.outdoor_ambient_radiosity_color.blue;
         
-        sky_in_array.indoor_power = sky_tag_struct.indoor_ambient_radiosity_power;
-        sky_in_array.indoor_red = sky_tag_struct.indoor_ambient_radiosity_color.red;
-        sky_in_array.indoor_green = sky_tag_struct.indoor_ambient_radiosity_color.green;
-        sky_in_array.indoor_blue = sky_tag_struct.indoor_ambient_radiosity_color.blue;
+        sky_in_array.indoor_power = sky_tag.indoor_ambient_radiosity_power;
+        sky_in_array.indoor_red = sky_tag.indoor_ambient_radiosity_color.red;
+        sky_in_array.indoor_green = sky_tag.indoor_ambient_radiosity_color.green;
+        sky_in_array.indoor_blue = sky_tag.indoor_ambient_radiosity_color.blue;
         
         // Add these lights
-        std::size_t light_count = sky_tag_struct.lights.count;
-        auto *lights = sky_tag.resolve_reflexive(sky_tag_struct.lights);
-        for(std::size_t l = 0; l < light_count; l++) {
+        for(auto &light_being_added : sky_tag.lights) {
             auto &light_to_add = sky_in_array.lights.emplace_back();
-            auto &light_being_added = lights[l];
             light_to_add.power = light_being_added.power;
             light_to_add.red = light_being_added.color.red;
             light_to_add.green = light_being_added.color.green;
@@ -220,46 +377,29 @@ static ExportedModel read_bsp(const Tag &tag, std::vector<ExportedMaterial> &mat
     return exported_model;
 }
 
-template<typename GeometryStruct, typename PartStruct, typename ModelStruct> static ExportedModel read_model(const Tag &tag, const ModelStruct &base_struct, std::vector<ExportedMaterial> &materials) {
+template<typename ModelTag> static ExportedModel read_model(const ModelTag &model, const std::string &model_path, ExportTagLoader &loader, std::vector<ExportedMaterial> &materials) {
     ExportedModel exported_model;
-    exported_model.path = tag.get_path() + "." + HEK::tag_fourcc_to_extension(tag.get_tag_fourcc());
-    
-    // Are we doing memes?
-    // bool use_local_nodes = tag.get_tag_fourcc() == HEK::TagFourCC::TAG_FOURCC_GBXMODEL && (base_struct.flags & HEK::ModelFlagsFlag::MODEL_FLAGS_FLAG_PARTS_HAVE_LOCAL_NODES);
+    exported_model.path = model_path;
     
     // Add all materials first
-    std::size_t shader_count = base_struct.shaders.count.read();
-    const Parser::ModelShaderReference::struct_little *shaders = reinterpret_cast<decltype(shaders)>(tag.data(base_struct.shaders.pointer, sizeof(*shaders) * shader_count));
-    
     std::map<std::size_t, std::size_t> material_map; // map local shader A to material B
+    std::size_t shader_count = model.shaders.size();
     for(std::size_t s = 0; s < shader_count; s++) {
-        material_map[s] = add_shader_to_materials(tag.get_map().get_tag(shaders[s].shader.tag_id.read().index), materials);
+        material_map[s] = add_shader_to_materials(model.shaders[s].shader, loader, materials);
     }
     
-    // Hold geometry information
-    std::size_t geometry_count = base_struct.geometries.count.read();
-    const GeometryStruct *geometries = reinterpret_cast<decltype(geometries)>(tag.data(base_struct.geometries.pointer, sizeof(*geometries) * geometry_count));
-    
     // Did we add this stuff already? (in case the model was deduped on generation, we don't *need* to add the same geometry over and over then)
     std::map<HEK::Index, bool> added_already;
     added_already[NULL_INDEX] = true;
     
-    auto model_data_offset = tag.get_map().get_model_data_offset();
-    auto model_index_offset = model_data_offset + tag.get_map().get_model_index_offset();
-    
     // Next, add the geometries
-    std::size_t region_count = base_struct.regions.count.read();
-    const Parser::ModelRegion::struct_little *regions = reinterpret_cast<const Parser::ModelRegion::struct_little *>(tag.data(base_struct.regions.pointer, sizeof(*regions) * region_count));
-    for(std::size_t r = 0; r < region_count; r++) {
-        auto &region = regions[r];
-        std::size_t permutation_count = region.permutations.count.read();
-        const Parser::ModelRegionPermutation::struct_little *permutations = reinterpret_cast<decltype(permutations)>(tag.data(region.permutations.pointer, sizeof(*permutations) * permutation_count));
-        if(permutation_count == 0) {
+    for(auto &region : model.regions) {
+        if(region.permutations.empty()) {
             continue;
         }
         
         // First permutation
-        auto &permutation = permutations[0];
+        auto &permutation = region.permutations[0];
         
         // Check if we added this already!
         auto &super_high_added = added_already[permutation.super_high];
@@ -268,24 +408,17 @@ template<typename GeometryStruct, typename PartStruct, typename ModelStruct> sta
         }
         super_high_added = true;
         
-        // Get the geometry
-        auto &geometry = geometries[permutation.super_high];
-        std::size_t part_count = geometry.parts.count.read();
-        const PartStruct *parts = reinterpret_cast<const PartStruct *>(tag.data(geometry.parts.pointer, sizeof(*parts) * part_count));
+        if(permutation.super_high >= model.geometries.size()) {
+            eprintf_error("Model %s has an invalid geometry index (%zu >= %zu)", model_path.c_str(), static_cast<std::size_t>(permutation.super_high), model.geometries.size());
+            std::exit(EXIT_FAILURE);
+        }
         
         // Go through each part. Add it!
-        for(std::size_t a = 0; a < part_count; a++) {
-            const auto &part = parts[a];
-            // const std::uint8_t *local_nodes = use_local_nodes ? reinterpret_cast<const Parser::GBXModelGeometryPart::struct_little *>(&part)->local_node_indices : nullptr;
-            
-            auto vertex_count = static_cast<std::size_t>(part.vertex_count);
-            const Parser::ModelVertexUncompressed::struct_little *vertices = reinterpret_cast<decltype(vertices)>(tag.get_map().get_data_at_offset(model_data_offset + part.vertex_offset, vertex_count * sizeof(*vertices)));
-            
+        for(auto &part : model.geometries[permutation.super_high].parts) {
             std::size_t offset = exported_model.vertices.size();
             
             // Add vertices
-            for(std::size_t v = 0; v < vertex_count; v++) {
-                auto &vertex = vertices[v];
+            for(auto &vertex : part.uncompressed_vertices) {
                 auto &vertex_added = exported_model.vertices.emplace_back();
                 vertex_added.x = vertex.position.x;
                 vertex_added.y = vertex.position.y;
@@ -295,9 +428,24 @@ template<typename GeometryStruct, typename PartStruct, typename ModelStruct> sta
                 vertex_added.k = vertex.normal.k;
             }
             
+            // Triangles in tags are a triangle strip split into threes, padded with NULL_INDEX at the end
+            std::vector<HEK::Index> triangles;
+            triangles.reserve(part.triangles.size() * 3);
+            for(auto &t : part.triangles) {
+                triangles.emplace_back(t.vertex0_index);
+                triangles.emplace_back(t.vertex1_index);
+                triangles.emplace_back(t.vertex2_index);
+            }
+            while(!triangles.empty() && triangles.back() == NULL_INDEX) {
+                triangles.pop_back();
+            }
+            if(triangles.size() < 3) {
+                continue;
+            }
+            
             // Now indices
-            auto triangle_count = static_cast<std::size_t>(part.triangle_count);
-            const HEK::LittleEndian<HEK::Index> *triangles = reinterpret_cast<decltype(triangles)>(tag.get_map().get_data_at_offset(model_index_offset + part.triangle_offset, (triangle_count + 2) * sizeof(*triangles)));
+            auto triangle_count = triangles.size() - 2;
+            auto vertex_count = part.uncompressed_vertices.size();
             bool flipped = false;
             auto material = material_map[part.shader_index];
             
@@ -306,7 +454,7 @@ template<typename GeometryStruct, typename PartStruct, typename ModelStruct> sta
                 if(triangles[t+0] == triangles[t+1] || triangles[t+1] == triangles[t+2] || triangles[t+2] == triangles[t+0]) {
                     continue;
                 }
-                if(triangles[t+0] == NULL_INDEX || triangles[t+1] == NULL_INDEX || triangles[t+2] == NULL_INDEX) {
+                if(triangles[t+0] >= vertex_count || triangles[t+1] >= vertex_count || triangles[t+2] >= vertex_count) {
                     continue;
                 }
                 
@@ -323,205 +471,364 @@ template<typename GeometryStruct, typename PartStruct, typename ModelStruct> sta
     return exported_model;
 }
 
-std::string Invader::Lightmap::export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
-    BuildWorkload::BuildParameters parameters;
-    parameters.verbosity = BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET;
-    parameters.tags_directories = tags_directories;
-    parameters.use_tags_for_script_data = true;
-    parameters.scenario = scenario;
-    parameters.details.build_compress = false;
+// Copy the collision BSP into little endian arrays so it can be checked with BSPData
+struct ExportedCollisionBSP {
+    std::vector<HEK::ModelCollisionGeometryBSP3DNode<HEK::LittleEndian>> bsp3d_nodes;
+    std::vector<HEK::ModelCollisionGeometryBSPPlane<HEK::LittleEndian>> planes;
+    std::vector<HEK::ModelCollisionGeometryBSPLeaf<HEK::LittleEndian>> leaves;
+    std::vector<HEK::ModelCollisionGeometryBSP2DReference<HEK::LittleEndian>> bsp2d_references;
+    std::vector<HEK::ModelCollisionGeometryBSP2DNode<HEK::LittleEndian>> bsp2d_nodes;
+    HEK::BSPData bsp_data;
     
-    std::vector<std::string> lines;
-    std::vector<ExportedMaterial> materials;
-    std::vector<ExportedModel> models;
-    std::vector<ExportedModel> bsps;
-    std::vector<ExportedObject> objects;
-    std::vector<ExportedSky> skies;
-    
-#define ADD_LINE(...) lines.emplace_back(__VA_ARGS__)
-    
-    try {
-        auto map = Map::map_with_move(BuildWorkload::compile_map(parameters));
-        auto &scenario_tag = map.get_tag(map.get_scenario_tag_id());
-        auto &scenario_struct = scenario_tag.get_base_struct<HEK::Scenario>();
-        
-        // Find the BSP
-        std::optional<std::size_t> bsp_index;
-        std::size_t bsp_count = scenario_struct.structure_bsps.count;
-        const Parser::ScenarioBSP::struct_little *scenario_bsps = reinterpret_cast<decltype(scenario_bsps)>(scenario_tag.data(scenario_struct.structure_bsps.pointer, sizeof(*scenario_bsps) * bsp_count));
-        for(std::size_t b = 0; b < bsp_count; b++) {
-            auto tag_id = scenario_bsps[b].structure_bsp.tag_id.read();
-            if(tag_id.is_null()) {
-                continue;
-            }
-            
-            // Find the tag name
-            auto &bsp_tag = map.get_tag(tag_id.index);
-            const char *bsp_tag_name = bsp_tag.get_path().c_str();
-            for(const char *q = bsp_tag_name; *q; q++) {
-                if(*q == '\\') {
-                    bsp_tag_name = q + 1;
-                }
-            }
-            
-            // Do it
-            if(std::strcmp(bsp_tag_name, bsp_name) == 0) {
-                bsp_index = b;
-                bsps.emplace_back(read_bsp(bsp_tag, materials, skies)); // add the BSP
-                break;
-            }
+    ExportedCollisionBSP(const Parser::ModelCollisionGeometryBSP &bsp) {
+        for(auto &n : bsp.bsp3d_nodes) {
+            auto &node = this->bsp3d_nodes.emplace_back();
+            node.plane = n.plane;
+            node.back_child = n.back_child;
+            node.front_child = n.front_child;
         }
-        
-        // Did we get it?
-        if(!bsp_index.has_value()) {
-            eprintf_error("No such BSP %s referenced by the scenario", bsp_name);
-            throw std::exception();
+        for(auto &p : bsp.planes) {
+            this->planes.emplace_back().plane = p.plane;
+        }
+        for(auto &l : bsp.leaves) {
+            auto &leaf = this->leaves.emplace_back();
+            leaf.flags = l.flags;
+            leaf.bsp2d_reference_count = l.bsp2d_reference_count;
+            leaf.first_bsp2d_reference = l.first_bsp2d_reference;
+        }
+        for(auto &r : bsp.bsp2d_references) {
+            auto &reference = this->bsp2d_references.emplace_back();
+            reference.plane = r.plane;
+            reference.bsp2d_node = r.bsp2d_node;
+        }
+        for(auto &n : bsp.bsp2d_nodes) {
+            auto &node = this->bsp2d_nodes.emplace_back();
+            node.plane = n.plane;
+            node.left_child = n.left_child;
+            node.right_child = n.right_child;
         }
         
-        // Now add all the sceneries in the BSP
-        std::uint16_t bsp_bit = 1 << *bsp_index;
-        
-        // Start getting scenery
-        std::size_t scenery_count = scenario_struct.scenery.count;
-        std::size_t scenery_palette_count = scenario_struct.scenery_palette.count;
-        if(scenery_count && scenery_palette_count) {
-            std::map<std::size_t, std::optional<std::size_t>> model_tag_id_to_exported_model_id;
-            
-            const Parser::ScenarioScenery::struct_little *scenery = reinterpret_cast<decltype(scenery)>(scenario_tag.data(scenario_struct.scenery.pointer, sizeof(*scenery) * scenery_count));
-            const Parser::ScenarioSceneryPalette::struct_little *scenery_palette = reinterpret_cast<decltype(scenery_palette)>(scenario_tag.data(scenario_struct.scenery_palette.pointer, sizeof(*scenery_palette) * scenery_palette_count));
-            
-            for(std::size_t s = 0; s < scenery_count; s++) {
-                auto &scenery_entry = scenery[s];
-                if(scenery_entry.bsp_indices & bsp_bit) {
-                    // Is the type set?
-                    auto type = scenery_entry.type.read();
-                    if(type == NULL_INDEX) {
-                        continue;
-                    }
-                    
-                    // Is the palette entry valid? If not... how did the map even compile? We check for that. Anyway, skip if not.
-                    auto scenery_tag_id = scenery_palette[type].name.tag_id.read();
-                    if(scenery_tag_id.is_null()) {
-                        continue;
-                    }
-                    
-                    // Check the model of the scenery
-                    auto &scenery_tag = map.get_tag(scenery_tag_id.index);
-                    auto &scenery_base_struct = scenery_tag.get_base_struct<HEK::Scenery>();
-                    auto model_tag_id = scenery_base_struct.model.tag_id.read();
-                    if(model_tag_id.is_null()) {
-                        continue;
-                    }
-                    
-                    // Add the model if we haven't already
-                    auto &model_id = model_tag_id_to_exported_model_id[model_tag_id.index];
-                    if(!model_id.has_value()) {
-                        model_id = models.size();
-                        auto &model_tag = map.get_tag(model_tag_id.index);
-                        
-                        switch(model_tag.get_tag_fourcc()) {
-                            case HEK::TagFourCC::TAG_FOURCC_GBXMODEL:
-                                models.emplace_back(read_model<Parser::GBXModelGeometry::struct_little, Parser::GBXModelGeometryPart::struct_little>(model_tag, model_tag.get_base_struct<HEK::GBXModel>(), materials));
-                                break;
-                            case HEK::TagFourCC::TAG_FOURCC_MODEL:
-                                models.emplace_back(read_model<Parser::ModelGeometry::struct_little, Parser::ModelGeometryPart::struct_little>(model_tag, model_tag.get_base_struct<HEK::Model>(), materials));
-                                break;
-                            default:
-                                std::fprintf(stderr, "Unknown model fourcc");
-                                throw std::exception();
-                        }
-                    }
-                    
-                    // Add the Add the object now
-                    auto &object = objects.emplace_back();
-                    object.model = *model_id;
-                    object.x = scenery_entry.position.x.read();
-                    object.y = scenery_entry.position.y.read();
-                    object.z = scenery_entry.position.z.read();
-                    object.yaw = scenery_entry.rotation.yaw.read();
-                    object.pitch = scenery_entry.rotation.pitch.read();
-                    object.roll = scenery_entry.rotation.roll.read();
-                }
-            }
+        this->bsp_data.bsp3d_nodes = this->bsp3d_nodes.data();
+        this->bsp_data.bsp3d_node_count = this->bsp3d_nodes.size();
+        this->bsp_data.planes = this->planes.data();
+        this->bsp_data.plane_count = this->planes.size();
+        this->bsp_data.leaves = this->leaves.data();
+        this->bsp_data.leaf_count = this->leaves.size();
+        this->bsp_data.bsp2d_references = this->bsp2d_references.data();
+        this->bsp_data.bsp2d_reference_count = this->bsp2d_references.size();
+        this->bsp_data.bsp2d_nodes = this->bsp2d_nodes.data();
+        this->bsp_data.bsp2d_node_count = this->bsp2d_nodes.size();
+        this->bsp_data.surface_count = bsp.surfaces.size();
+    }
+    
+    ExportedCollisionBSP(const ExportedCollisionBSP &) = delete;
+};
+
+// Number of vertices or triangles formatted in each section when writing on multiple threads
+static constexpr const std::size_t TEXT_MESH_WRITE_CHUNK_SIZE = 8192;
+
+static std::vector<std::byte> write_text_mesh(const ExportedMesh &mesh) {
+    File::TextWriter writer;
+    
+    // Floats are written with up to 6 decimal places
+    auto write_float = [](File::TextWriter &writer, float f) -> File::TextWriter & {
+        return writer.write_decimal(f, 6);
+    };
+    
+    // Put the version in it
+    writer.write("version 1 unbaked\n");
+    
+    // Add skies
+    for(auto &s : mesh.skies) {
+        writer.write("sky \"").write(s.path).write("\" ");
+        write_float(writer, s.outdoor_power).write(' ');
+        write_float(writer, s.outdoor_red).write(' ');
+        write_float(writer, s.outdoor_green).write(' ');
+        write_float(writer, s.outdoor_blue).write(" {\n");
+        for(auto &l : s.lights) {
+            writer.write(" light ");
+            write_float(writer, l.power).write(' ');
+            write_float(writer, l.red).write(' ');
+            write_float(writer, l.green).write(' ');
+            write_float(writer, l.blue).write(' ');
+            write_float(writer, l.yaw).write(' ');
+            write_float(writer, l.pitch).write('\n');
         }
+        writer.write("}\n");
     }
-    catch (std::exception &e) {
-        eprintf_error("Failed to build/parse map: %s", e.what());
-        std::exit(EXIT_FAILURE);
+    
+    // Add materials
+    for(auto &mat : mesh.materials) {
+        // todo: add image sampling (base64 of pixel data maybe - `image <base64>` vs `rgb <red> <green> <blue>`)
+        writer.write("material \"").write(mat.path).write("\" ").write(ExportedMaterialTypeStr[mat.type]).write(' ');
+        write_float(writer, mat.power).write(" rgb ");
+        write_float(writer, mat.emission_red).write(' ');
+        write_float(writer, mat.emission_green).write(' ');
+        write_float(writer, mat.emission_blue).write('\n');
     }
     
-    auto float_to_str = [](const auto &f) -> std::string {
-        std::string fstr = std::to_string(f);
+    // Add models. Their vertices and triangles make up nearly all of the file, so they're formatted on multiple threads.
+    auto write_model = [&writer, &write_float](auto &m) {
+        writer.write(m.lightmaps.size() ? "scenario_structure_bsp" : "model").write(" \"").write(m.path).write("\" {\n");
         
-        while(fstr[fstr.size() - 1] == '0') {
-            fstr.resize(fstr.size() - 1);
-        }
-        if(fstr[fstr.size() - 1] == '.') {
-            fstr.resize(fstr.size() - 1);
-        }
+        auto vertex_count = m.vertices.size();
+        writer.write_sections((vertex_count + TEXT_MESH_WRITE_CHUNK_SIZE - 1) / TEXT_MESH_WRITE_CHUNK_SIZE, [&m, &vertex_count, &write_float](File::TextWriter &section, std::size_t chunk) {
+            auto chunk_end = std::min((chunk + 1) * TEXT_MESH_WRITE_CHUNK_SIZE, vertex_count);
+            for(std::size_t i = chunk * TEXT_MESH_WRITE_CHUNK_SIZE; i < chunk_end; i++) {
+                auto &v = m.vertices[i];
+                section.write(" vertex ");
+                write_float(section, v.x).write(' ');
+                write_float(section, v.y).write(' ');
+                write_float(section, v.z).write('\n');
+            }
+        }, TEXT_MESH_WRITE_CHUNK_SIZE * 48);
+        
+        auto triangle_count = m.triangles.size();
+        writer.write_sections((triangle_count + TEXT_MESH_WRITE_CHUNK_SIZE - 1) / TEXT_MESH_WRITE_CHUNK_SIZE, [&m, &triangle_count](File::TextWriter &section, std::size_t chunk) {
+            auto chunk_end = std::min((chunk + 1) * TEXT_MESH_WRITE_CHUNK_SIZE, triangle_count);
+            for(std::size_t i = chunk * TEXT_MESH_WRITE_CHUNK_SIZE; i < chunk_end; i++) {
+                auto &t = m.triangles[i];
+                section.write(" triangle ").write_unsigned(t.a).write(' ').write_unsigned(t.b).write(' ').write_unsigned(t.c).write(' ').write_unsigned(t.material).write('\n');
+            }
+        }, TEXT_MESH_WRITE_CHUNK_SIZE * 32);
         
-        return fstr;
+        for(auto &l : m.lightmaps) {
+            writer.write(" lightmap ").write_unsigned(l.first_triangle_index).write(' ').write_unsigned(l.triangle_count).write('\n');
+        }
+        writer.write("}\n");
     };
     
-    // Put the version in it
-    ADD_LINE("version 1 unbaked");
+    for(auto &m : mesh.bsps) {
+        write_model(m);
+    }
     
-    // Check skies
-    if(skies.size() > 1) {
-        eprintf_error("Only 1 sky per BSP is currently allowed maximum for this operation");
-        std::exit(EXIT_FAILURE);
+    for(auto &m : mesh.models) {
+        write_model(m);
+    }
+    
+    // Add objects
+    for(auto &o : mesh.objects) {
+        writer.write("object ").write_unsigned(o.model).write(' ');
+        write_float(writer, o.x).write(' ');
+        write_float(writer, o.y).write(' ');
+        write_float(writer, o.z).write(' ');
+        write_float(writer, o.yaw).write(' ');
+        write_float(writer, o.pitch).write(' ');
+        write_float(writer, o.roll).write('\n');
     }
     
+    return writer.take_bytes();
+}
+
+static std::vector<std::byte> write_binary_mesh(const ExportedMesh &mesh) {
+    BinaryMeshWriter writer;
+    writer.write_bytes(BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC));
+    writer.write_u32(BINARY_MESH_FORMAT_VERSION);
+    writer.write_u32(0); // unbaked
+    
     // Add skies
-    for(auto &s : skies) {
-        ADD_LINE(std::string("sky \"") + s.path + "\" " + float_to_str(s.outdoor_power) + " " + float_to_str(s.outdoor_red) + " " + float_to_str(s.outdoor_green) + " " + float_to_str(s.outdoor_blue) + " {");
+    writer.write_count(mesh.skies.size());
+    for(auto &s : mesh.skies) {
+        writer.write_string(s.path);
+        writer.write_f32(s.outdoor_power);
+        writer.write_f32(s.outdoor_red);
+        writer.write_f32(s.outdoor_green);
+        writer.write_f32(s.outdoor_blue);
+        writer.write_count(s.lights.size());
         for(auto &l : s.lights) {
-            ADD_LINE(std::string(" light ") + float_to_str(l.power) + " " + float_to_str(l.red) + " " + float_to_str(l.green) + " " + float_to_str(l.blue) + " " + float_to_str(l.yaw) + " " + float_to_str(l.pitch));
+            writer.write_f32(l.power);
+            writer.write_f32(l.red);
+            writer.write_f32(l.green);
+            writer.write_f32(l.blue);
+            writer.write_f32(l.yaw);
+            writer.write_f32(l.pitch);
         }
-        ADD_LINE("}");
     }
     
     // Add materials
-    for(auto &mat : materials) {
-        ADD_LINE(std::string("material \"") + mat.path + "\" " + ExportedMaterialTypeStr[mat.type] + " " + float_to_str(mat.power) + " rgb " + float_to_str(mat.emission_red) + " " + float_to_str(mat.emission_green) + " " + float_to_str(mat.emission_blue)); // todo: add image sampling (base64 of pixel data maybe - `image <base64>` vs `rgb <red> <green> <blue>`)
+    writer.write_count(mesh.materials.size());
+    for(auto &mat : mesh.materials) {
+        writer.write_string(mat.path);
+        writer.write_u32(mat.type);
+        writer.write_f32(mat.power);
+        writer.write_f32(mat.emission_red);
+        writer.write_f32(mat.emission_green);
+        writer.write_f32(mat.emission_blue);
     }
     
-    // Add models
-    auto write_model = [&lines, &float_to_str](auto &m) {
-        ADD_LINE(std::string(m.lightmaps.size() ? "scenario_structure_bsp" : "model") + " \"" + m.path + "\" {");
+    // Add models (BSPs first, like the text format)
+    writer.write_count(mesh.bsps.size() + mesh.models.size());
+    auto write_model = [&writer](auto &m) {
+        writer.write_u32(m.lightmaps.size() ? 1 : 0); // 1 = scenario_structure_bsp, 0 = model
+        writer.write_string(m.path);
+        writer.write_count(m.vertices.size());
         for(auto &v : m.vertices) {
-            ADD_LINE(std::string(" vertex ") + float_to_str(v.x) + " " + float_to_str(v.y) + " " + float_to_str(v.z));
+            writer.write_f32(v.x);
+            writer.write_f32(v.y);
+            writer.write_f32(v.z);
         }
+        writer.write_count(m.triangles.size());
         for(auto &t : m.triangles) {
-            ADD_LINE(std::string(" triangle ") + std::to_string(t.a) + " " + std::to_string(t.b) + " " + std::to_string(t.c) + " " + std::to_string(t.material));
+            writer.write_count(t.a);
+            writer.write_count(t.b);
+            writer.write_count(t.c);
+            writer.write_count(t.material);
         }
+        writer.write_count(m.lightmaps.size());
         for(auto &l : m.lightmaps) {
-            ADD_LINE(std::string(" lightmap ") + std::to_string(l.first_triangle_index) + " " + std::to_string(l.triangle_count));
+            writer.write_count(l.first_triangle_index);
+            writer.write_count(l.triangle_count);
         }
-        ADD_LINE("}");
     };
     
-    for(auto &m : bsps) {
+    for(auto &m : mesh.bsps) {
         write_model(m);
     }
     
-    for(auto &m : models) {
+    for(auto &m : mesh.models) {
         write_model(m);
     }
     
     // Add objects
-    for(auto &o : objects) {
-        ADD_LINE(std::string("object ") + std::to_string(o.model) + " " + float_to_str(o.x) + " " + float_to_str(o.y) + " " + float_to_str(o.z) + " " + float_to_str(o.yaw) + " " + float_to_str(o.pitch) + " " + float_to_str(o.roll));
+    writer.write_count(mesh.objects.size());
+    for(auto &o : mesh.objects) {
+        writer.write_count(o.model);
+        writer.write_f32(o.x);
+        writer.write_f32(o.y);
+        writer.write_f32(o.z);
+        writer.write_f32(o.yaw);
+        writer.write_f32(o.pitch);
+        writer.write_f32(o.roll);
     }
     
-#undef ADD_LINE
+    return std::move(writer.data);
+}
 
-    // Concatenate into a string
-    std::string str;
-    for(auto &l : lines) {
-        str += std::move(l) + "\n";
+std::vector<std::byte> Invader::Lightmap::export_lightmap_mesh(const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories, bool binary) {
+    ExportTagLoader loader(tags_directories);
+    
+    ExportedMesh mesh;
+    auto &materials = mesh.materials;
+    auto &models = mesh.models;
+    auto &bsps = mesh.bsps;
+    auto &objects = mesh.objects;
+    auto &skies = mesh.skies;
+    
+    // Only the tags that end up in the mesh are read, so there's no need to build the whole map
+    auto &scenario_tag = loader.load<Parser::Scenario>(std::string(scenario) + ".scenario");
+    
+    // Find the BSP
+    const Parser::ScenarioStructureBSP *bsp = nullptr;
+    for(auto &scenario_bsp : scenario_tag.structure_bsps) {
+        auto &bsp_reference = scenario_bsp.structure_bsp;
+        if(bsp_reference.path.empty() || File::base_name(bsp_reference.path.c_str()) != bsp_name) {
+            continue;
+        }
+        
+        auto bsp_path = dependency_path(bsp_reference);
+        bsp = &loader.load<Parser::ScenarioStructureBSP>(bsp_path);
+        bsps.emplace_back(read_bsp(*bsp, bsp_path, scenario_tag, loader, materials, skies)); // add the BSP
+        break;
+    }
+    
+    // Did we get it?
+    if(bsp == nullptr) {
+        eprintf_error("No such BSP %s referenced by the scenario", bsp_name);
+        std::exit(EXIT_FAILURE);
+    }
+    
+    // Now add all the sceneries in the BSP
+    if(!bsp->collision_bsp.empty() && !scenario_tag.scenery.empty()) {
+        ExportedCollisionBSP collision_bsp(bsp->collision_bsp[0]);
+        std::map<std::string, std::optional<std::size_t>> model_path_to_exported_model_id;
+        auto scenery_palette_count = scenario_tag.scenery_palette.size();
+        
+        try {
+            for(auto &scenery_entry : scenario_tag.scenery) {
+                // Is the type set?
+                auto type = scenery_entry.type;
+                if(type == NULL_INDEX || type >= scenery_palette_count) {
+                    continue;
+                }
+                
+                // Is the palette entry set? Skip if not.
+                auto &scenery_reference = scenario_tag.scenery_palette[type].name;
+                if(scenery_reference.path.empty()) {
+                    continue;
+                }
+                
+                // Check the model of the scenery
+                auto &scenery_tag = loader.load<Parser::Scenery>(dependency_path(scenery_reference));
+                auto &model_reference = scenery_tag.model;
+                if(model_reference.path.empty()) {
+                    continue;
+                }
+                auto model_path = dependency_path(model_reference);
+                
+                // Find where the object is checked from, the same way the map is built
+                auto bounding_offset = scenery_tag.bounding_offset;
+                switch(model_reference.tag_fourcc) {
+                    case HEK::TagFourCC::TAG_FOURCC_GBXMODEL: {
+                        auto &model_tag = loader.load<Parser::GBXModel>(model_path);
+                        if(!model_tag.nodes.empty()) {
+                            bounding_offset = bounding_offset + model_tag.nodes[0].default_translation;
+                        }
+                        break;
+                    }
+                    case HEK::TagFourCC::TAG_FOURCC_MODEL: {
+                        auto &model_tag = loader.load<Parser::Model>(model_path);
+                        if(!model_tag.nodes.empty()) {
+                            bounding_offset = bounding_offset + model_tag.nodes[0].default_translation;
+                        }
+                        break;
+                    }
+                    default:
+                        eprintf_error("Unknown model fourcc");
+                        std::exit(EXIT_FAILURE);
+                }
+                auto position_to_check = scenery_entry.position + HEK::rotate_vector(bounding_offset, HEK::euler_to_matrix(scenery_entry.rotation));
+                
+                // Is it in the BSP?
+                if(!collision_bsp.bsp_data.check_if_point_inside_bsp(scenery_entry.position) && !collision_bsp.bsp_data.check_if_point_inside_bsp(position_to_check)) {
+                    continue;
+                }
+                
+                // Add the model if we haven't already
+                auto &model_id = model_path_to_exported_model_id[model_path];
+                if(!model_id.has_value()) {
+                    model_id = models.size();
+                    if(model_reference.tag_fourcc == HEK::TagFourCC::TAG_FOURCC_GBXMODEL) {
+                        models.emplace_back(read_model(loader.load<Parser::GBXModel>(model_path), model_path, loader, materials));
+                    }
+                    else {
+                        models.emplace_back(read_model(loader.load<Parser::Model>(model_path), model_path, loader, materials));
+                    }
+                }
+                
+                // Add the object now
+                auto &object = objects.emplace_back();
+                object.model = *model_id;
+                object.x = scenery_entry.position.x;
+                object.y = scenery_entry.position.y;
+                object.z = scenery_entry.position.z;
+                object.yaw = scenery_entry.rotation.yaw;
+                object.pitch = scenery_entry.rotation.pitch;
+                object.roll = scenery_entry.rotation.roll;
+            }
+        }
+        catch (std::exception &e) {
+            eprintf_error("Failed to check scenery against the BSP: %s", e.what());
+            std::exit(EXIT_FAILURE);
+        }
     }
-    return str;
+    
+    // Check skies
+    if(skies.size() > 1) {
+        eprintf_error("Only 1 sky per BSP is currently allowed maximum for this operation");
+        std::exit(EXIT_FAILURE);
+    }
+    
+    return binary ? write_binary_mesh(mesh) : write_text_mesh(mesh);
 }
 
 struct ImportedBSPVertex {
@@ -543,10 +850,13 @@ struct ImportedBSP {
     std::vector<ImportedBSPTriangle> triangles;
     std::vector<ImportedBSPLightmap> lightmaps;
 };
+
+struct ImportedMesh {
+    std::optional<std::size_t> format_length, format_bpp;
+    std::vector<ImportedBSP> bsps;
+};
     
-void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
-    auto size = mesh_data.size();
-    auto *data = mesh_data.data();
+static ImportedMesh parse_text_mesh(const char *data, std::size_t size, const std::filesystem::path &mesh_path) {
     auto *data_end = data + size;
     
     const char *token_start = nullptr;
@@ -625,9 +935,10 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         std::exit(EXIT_FAILURE);
     }
     
-    // Hold the format here
-    std::optional<std::size_t> format_length, format_bpp;
-    std::vector<ImportedBSP> bsps;
+    ImportedMesh mesh;
+    auto &format_length = mesh.format_length;
+    auto &format_bpp = mesh.format_bpp;
+    auto &bsps = mesh.bsps;
     
     while(true) {
         auto command_maybe = extract_next_token();
@@ -713,6 +1024,82 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         }
     }
     
+    return mesh;
+}
+
+static ImportedMesh parse_binary_mesh(const std::byte *data, std::size_t size, const std::filesystem::path &mesh_path) {
+    ImportedMesh mesh;
+    BinaryMeshReader reader(data, size);
+    
+    try {
+        reader.read_bytes(sizeof(BINARY_MESH_MAGIC));
+        
+        // Version
+        if(reader.read_u32() != BINARY_MESH_FORMAT_VERSION) {
+            eprintf_error("Input mesh does not have a supported version");
+            std::exit(EXIT_FAILURE);
+        }
+        if(reader.read_u32() != 1) {
+            eprintf_error("Input mesh is not baked");
+            std::exit(EXIT_FAILURE);
+        }
+        
+        // Format
+        mesh.format_length = reader.read_u32();
+        mesh.format_bpp = reader.read_u32();
+        
+        // BSPs
+        std::size_t bsp_count = reader.read_u32();
+        for(std::size_t b = 0; b < bsp_count; b++) {
+            auto &bsp = mesh.bsps.emplace_back();
+            bsp.path = reader.read_string();
+            
+            // Don't trust the counts to reserve memory; a truncated file will just run out of data
+            std::size_t vertex_count = reader.read_u32();
+            for(std::size_t v = 0; v < vertex_count; v++) {
+                auto &vertex = bsp.vertices.emplace_back();
+                vertex.u = reader.read_f32();
+                vertex.v = reader.read_f32();
+            }
+            
+            std::size_t triangle_count = reader.read_u32();
+            for(std::size_t t = 0; t < triangle_count; t++) {
+                auto &triangle = bsp.triangles.emplace_back();
+                for(auto &v : triangle.vertices) {
+                    v = reader.read_u32();
+                }
+            }
+            
+            std::size_t lightmap_count = reader.read_u32();
+            for(std::size_t l = 0; l < lightmap_count; l++) {
+                auto &lightmap = bsp.lightmaps.emplace_back();
+                lightmap.first_triangle = reader.read_u32();
+                lightmap.triangle_count = reader.read_u32();
+                lightmap.image_filename = reader.read_string();
+            }
+        }
+    }
+    catch(std::exception &) {
+        eprintf_error("Failed to parse %s: It is truncated", mesh_path.string().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    
+    if(!reader.done()) {
+        eprintf_error("Failed to parse %s: It has extra data at the end", mesh_path.string().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    
+    return mesh;
+}
+    
+void Invader::Lightmap::import_lightmap_mesh(const std::byte *mesh_data, std::size_t mesh_size, const std::filesystem::path &mesh_path, const char *scenario, const char *bsp_name, const std::vector<std::filesystem::path> &tags_directories) {
+    // Binary meshes start with a magic; anything else is read as text
+    bool binary = mesh_size >= sizeof(BINARY_MESH_MAGIC) && std::memcmp(mesh_data, BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC)) == 0;
+    auto mesh = binary ? parse_binary_mesh(mesh_data, mesh_size, mesh_path) : parse_text_mesh(reinterpret_cast<const char *>(mesh_data), mesh_size, mesh_path);
+    auto &format_length = mesh.format_length;
+    auto &format_bpp = mesh.format_bpp;
+    auto &bsps = mesh.bsps;
+    
     // Check the format
     if(!format_length.has_value() || !format_bpp.has_value()) {
         eprintf_error("Input mesh does not specify a format.");
@@ -831,7 +1218,14 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         std::exit(EXIT_FAILURE);
     }
     
-    // Go through each one!
+    // Check everything first so nothing has to bail out while the materials are being converted
+    struct MaterialToImport {
+        Parser::ScenarioStructureBSPMaterial *material;
+        std::size_t first_surface;
+        std::size_t last_surface;
+    };
+    std::vector<MaterialToImport> materials_to_import;
+    std::size_t surfaces_to_import = 0;
     for(auto &lm : scenario_bsp->lightmaps) {
         if(lm.bitmap == NULL_INDEX) {
             continue;
@@ -842,12 +1236,8 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
         }
         
         for(auto &mat : lm.materials) {
-            std::vector<Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little> uncompressed_vertices_duped;
-            std::vector<Parser::ScenarioStructureBSPMaterialUncompressedLightmapVertex::struct_little> uncompressed_lightmap_vertices_duped;
-            
-            auto &rendered_vertices_count = mat.rendered_vertices_count;
-            auto *uncompressed_vertices = reinterpret_cast<decltype(uncompressed_vertices_duped.data())>(mat.uncompressed_vertices.data());
-            auto expected_size = sizeof(uncompressed_vertices_duped[0]) * rendered_vertices_count;
+            std::size_t rendered_vertices_count = mat.rendered_vertices_count;
+            auto expected_size = sizeof(Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little) * rendered_vertices_count;
             if(mat.uncompressed_vertices.size() < expected_size) {
                 eprintf_error("BSP uncompressed vertices size is wrong");
                 std::exit(EXIT_FAILURE);
@@ -860,45 +1250,81 @@ void Invader::Lightmap::import_lightmap_mesh(const std::string &mesh_data, const
                 eprintf_error("BSP surfaces are out of bounds");
                 std::exit(EXIT_FAILURE);
             }
-            
-            auto *triangles = bsp_surfaces + first_surface;
-            auto *triangles_end = bsp_surfaces + last_surface;
-            auto *imported_triangles = tris + first_surface;
-            
-            for(auto *t = triangles; t < triangles_end; t++, imported_triangles++) {
-                // Blow it up
-                auto dupe_it_all_to_hell = [&uncompressed_vertices_duped, &uncompressed_vertices, &rendered_vertices_count, &uncompressed_lightmap_vertices_duped, &uvs](HEK::Index &index, std::size_t vertex_index) {
-                    if(index >= rendered_vertices_count) {
-                        eprintf_error("BSP surface vertices are out of bounds");
-                        std::exit(EXIT_FAILURE);
-                    }
-                    uncompressed_vertices_duped.emplace_back(uncompressed_vertices[index]);
-                    index = uncompressed_vertices_duped.size() - 1;
-                    
-                    auto &lm_vertex = uncompressed_lightmap_vertices_duped.emplace_back();
-                    lm_vertex.normal.i = 1.0F;
-                    lm_vertex.normal.j = 0.0F;
-                    lm_vertex.normal.k = 0.0F;
-                    lm_vertex.texture_coords.x = uvs[vertex_index].u;
-                    lm_vertex.texture_coords.y = uvs[vertex_index].v;
-                };
-                
-                // Do this
-                dupe_it_all_to_hell(t->vertex0_index, imported_triangles->vertices[0]);
-                dupe_it_all_to_hell(t->vertex1_index, imported_triangles->vertices[1]);
-                dupe_it_all_to_hell(t->vertex2_index, imported_triangles->vertices[2]);
+            if(last_surface > bsp.triangles.size()) {
+                eprintf_error("BSP mismatch: Incorrect number of triangles");
+                std::exit(EXIT_FAILURE);
+            }
+            for(std::size_t s = first_surface; s < last_surface; s++) {
+                auto &t = bsp_surfaces[s];
+                if(t.vertex0_index >= rendered_vertices_count || t.vertex1_index >= rendered_vertices_count || t.vertex2_index >= rendered_vertices_count) {
+                    eprintf_error("BSP surface vertices are out of bounds");
+                    std::exit(EXIT_FAILURE);
+                }
             }
             
-            // Insert the stuff
-            mat.rendered_vertices_count = uncompressed_vertices_duped.size();
-            mat.rendered_vertices_offset = 0;
-            mat.uncompressed_vertices = std::vector<std::byte>(reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data()), reinterpret_cast<std::byte *>(uncompressed_vertices_duped.data() + mat.rendered_vertices_count));
+            materials_to_import.emplace_back(MaterialToImport { &mat, first_surface, last_surface });
+            surfaces_to_import += last_surface - first_surface;
+        }
+    }
+    
+    // Each material gets three vertices per surface, with the rendered vertex copied from the one the surface used
+    auto import_material = [&bsp_surfaces, &tris, &uvs](const MaterialToImport &to_import) {
+        using rendered_vertex = Parser::ScenarioStructureBSPMaterialUncompressedRenderedVertex::struct_little;
+        using lightmap_vertex = Parser::ScenarioStructureBSPMaterialUncompressedLightmapVertex::struct_little;
+        
+        auto &mat = *to_import.material;
+        std::size_t vertex_count = (to_import.last_surface - to_import.first_surface) * 3;
+        std::vector<std::byte> new_vertices(vertex_count * (sizeof(rendered_vertex) + sizeof(lightmap_vertex)));
+        const auto *uncompressed_vertices = reinterpret_cast<const rendered_vertex *>(mat.uncompressed_vertices.data());
+        auto *new_rendered_vertices = reinterpret_cast<rendered_vertex *>(new_vertices.data());
+        auto *new_lightmap_vertices = reinterpret_cast<lightmap_vertex *>(new_rendered_vertices + vertex_count);
+        
+        std::size_t new_index = 0;
+        auto dupe_it_all_to_hell = [&uncompressed_vertices, &new_rendered_vertices, &new_lightmap_vertices, &new_index, &uvs](HEK::Index &index, std::size_t vertex_index) {
+            new_rendered_vertices[new_index] = uncompressed_vertices[index];
+            index = static_cast<HEK::Index>(new_index);
             
-            mat.lightmap_vertices_count = uncompressed_lightmap_vertices_duped.size();
-            mat.lightmap_vertices_offset = mat.uncompressed_vertices.size();
-            mat.uncompressed_vertices.insert(mat.uncompressed_vertices.end(), reinterpret_cast<std::byte *>(uncompressed_lightmap_vertices_duped.data()), reinterpret_cast<std::byte *>(uncompressed_lightmap_vertices_duped.data() + mat.lightmap_vertices_count));
+            auto &lm_vertex = new_lightmap_vertices[new_index];
+            lm_vertex.normal.i = 1.0F;
+            lm_vertex.normal.j = 0.0F;
+            lm_vertex.normal.k = 0.0F;
+            lm_vertex.texture_coords.x = uvs[vertex_index].u;
+            lm_vertex.texture_coords.y = uvs[vertex_index].v;
+            new_index++;
+        };
+        
+        for(std::size_t s = to_import.first_surface; s < to_import.last_surface; s++) {
+            auto &t = bsp_surfaces[s];
+            auto &imported_triangle = tris[s];
+            dupe_it_all_to_hell(t.vertex0_index, imported_triangle.vertices[0]);
+            dupe_it_all_to_hell(t.vertex1_index, imported_triangle.vertices[1]);
+            dupe_it_all_to_hell(t.vertex2_index, imported_triangle.vertices[2]);
+        }
+        
+        // Insert the stuff
+        mat.rendered_vertices_count = vertex_count;
+        mat.rendered_vertices_offset = 0;
+        mat.lightmap_vertices_count = vertex_count;
+        mat.lightmap_vertices_offset = vertex_count * sizeof(rendered_vertex);
+        mat.uncompressed_vertices = std::move(new_vertices);
+    };
+    
+    // Materials can be imported in parallel as long as no two of them share surfaces
+    auto sorted_materials = materials_to_import;
+    std::sort(sorted_materials.begin(), sorted_materials.end(), [](const MaterialToImport &a, const MaterialToImport &b) { return a.first_surface < b.first_surface; });
+    bool materials_overlap = false;
+    for(std::size_t m = 1; m < sorted_materials.size(); m++) {
+        if(sorted_materials[m].first_surface < sorted_materials[m - 1].last_surface) {
+            materials_overlap = true;
+            break;
         }
     }
     
+    std::size_t material_count = materials_to_import.size();
+    std::size_t thread_count = materials_overlap ? 1 : std::min(material_count, surfaces_to_import / MIN_PARALLEL_SURFACE_COUNT);
+    ThreadPool::shared().parallel_for(material_count, [&materials_to_import, &import_material](std::size_t m) {
+        import_material(materials_to_import[m]);
+    }, thread_count);
+    
     File::save_file(*bsp_path_file, scenario_bsp->generate_hek_tag_data(HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP));
 }
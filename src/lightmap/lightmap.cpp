@@ -8,6 +8,7 @@
 #include "../command_line_option.hpp"
 #include <invader/printf.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/version.hpp>
 
 #include "actions.hpp"
@@ -28,6 +29,7 @@ int main(int argc, const char **argv) {
         //std::filesystem::path data = "data";
         bool filesystem_path = false;
         std::filesystem::path data = "data";
+        bool binary = false;
         
         std::optional<LightmapMode> mode;
     } shadowmouse_options;
@@ -38,7 +40,8 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
         CommandLineOption("export-mesh", 'E', 0, "Export a lightmap mesh to be imported and baked using an external program."),
-        CommandLineOption("import-mesh", 'I', 0, "Import a lightmap mesh that was baked.")
+        CommandLineOption("import-mesh", 'I', 0, "Import a lightmap mesh that was baked."),
+        CommandLineOption("binary", 'B', 0, "Export the mesh in the binary format instead of text. Either format can be imported.")
     };
 
     static constexpr char DESCRIPTION[] = "Generate meshes to bake lightmaps using Blender's Cycles renderer.";
@@ -61,6 +64,9 @@ int main(int argc, const char **argv) {
             case 'P':
                 shadowmouse_options.filesystem_path = true;
                 break;
+            case 'B':
+                shadowmouse_options.binary = true;
+                break;
             case 'i':
                 show_version_info();
                 std::exit(EXIT_SUCCESS);
@@ -101,10 +107,8 @@ int main(int argc, const char **argv) {
     
     switch(*shadowmouse_options.mode) {
         case LightmapMode::LIGHTMAP_EXPORT: {
-            auto output = export_lightmap_mesh(scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
-            auto *data = reinterpret_cast<const std::byte *>(output.c_str());
-            auto *data_end = data + output.size();
-            if(!File::save_file(mesh_file, std::vector<std::byte>(data, data_end))) {
+            auto output = export_lightmap_mesh(scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags, shadowmouse_options.binary);
+            if(!File::save_file(mesh_file, output)) {
                 eprintf_error("Failed to save %s", mesh_file.string().c_str());
                 return EXIT_FAILURE;
             }
@@ -112,9 +116,12 @@ int main(int argc, const char **argv) {
             break;
         }
         case LightmapMode::LIGHTMAP_IMPORT: {
-            auto input_bytes = Invader::File::open_file(mesh_file).value();
-            auto input = std::string(reinterpret_cast<const char *>(input_bytes.data()), input_bytes.size());
-            import_lightmap_mesh(input, mesh_file, scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
+            auto input = File::MemoryMappedFile::map_file(mesh_file);
+            if(!input.has_value()) {
+                eprintf_error("Failed to open %s", mesh_file.string().c_str());
+                return EXIT_FAILURE;
+            }
+            import_lightmap_mesh(input->data(), input->size(), mesh_file, scenario_tag.c_str(), bsp_name.c_str(), shadowmouse_options.tags);
             break;
         }
     }
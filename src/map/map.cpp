@@ -11,6 +11,11 @@
 #include <invader/file/file.hpp>
 #include <invader/crc/hek/crc.hpp>
 
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
 namespace Invader {
     Map Map::map_with_copy(const std::byte *data, std::size_t data_size,
                            const std::byte *bitmaps_data, std::size_t bitmaps_data_size,
@@ -49,6 +54,68 @@ namespace Invader {
         return map;
     }
 
+    Map Map::map_with_move(std::vector<std::byte> &&data,
+                           std::optional<ResourceMapView> &&bitmaps_data,
+                           std::optional<ResourceMapView> &&loc_data,
+                           std::optional<ResourceMapView> &&sounds_data) {
+        if(data.size() < sizeof(HEK::CacheFileHeader)) {
+            throw InvalidMapException(); // no
+        }
+        
+        Map map;
+        try {
+            if(map.decompress_if_needed(data.data(), data.size())) {
+                data.clear();
+            }
+            else {
+                map.data = std::move(data);
+            }
+            map.mapped_bitmap_data = std::move(bitmaps_data);
+            map.mapped_sound_data = std::move(sounds_data);
+            map.mapped_loc_data = std::move(loc_data);
+            map.load_map();
+        }
+        catch(Exception &) {
+            throw InvalidMapException();
+        }
+        return map;
+    }
+
+    Map Map::map_with_mmap(File::MemoryMappedFile &&file,
+                           std::optional<ResourceMapView> &&bitmaps_data,
+                           std::optional<ResourceMapView> &&loc_data,
+                           std::optional<ResourceMapView> &&sounds_data) {
+        if(file.size() < sizeof(HEK::CacheFileHeader)) {
+            throw InvalidMapException(); // no
+        }
+        
+        Map map;
+        try {
+            if(!map.decompress_if_needed(file.data(), file.size())) {
+                map.mapped_data = std::move(file);
+            }
+            map.mapped_bitmap_data = std::move(bitmaps_data);
+            map.mapped_sound_data = std::move(sounds_data);
+            map.mapped_loc_data = std::move(loc_data);
+            map.load_map();
+        }
+        catch(Exception &) {
+            throw InvalidMapException();
+        }
+        return map;
+    }
+
+    Map Map::map_with_mmap(const std::filesystem::path &path,
+                           std::optional<ResourceMapView> &&bitmaps_data,
+                           std::optional<ResourceMapView> &&loc_data,
+                           std::optional<ResourceMapView> &&sounds_data) {
+        auto file = File::MemoryMappedFile::map_file(path);
+        if(!file.has_value()) {
+            throw FailedToOpenFileException();
+        }
+        return Map::map_with_mmap(std::move(*file), std::move(bitmaps_data), std::move(loc_data), std::move(sounds_data));
+    }
+
     bool Map::decompress_if_needed(const std::byte *data, std::size_t data_size) {
         using namespace Invader::HEK;
         
@@ -60,6 +127,11 @@ namespace Invader {
                 case CacheFileEngine::CACHE_FILE_XBOX:
                     compression_type = CompressionType::COMPRESSION_TYPE_DEFLATE;
                     break;
+                case CacheFileEngine::CACHE_FILE_NATIVE:
+                    if(Compression::is_framed_map_data(data, data_size)) {
+                        compression_type = CompressionType::COMPRESSION_TYPE_DEFLATE;
+                    }
+                    break;
                 default:
                     break;
             }
@@ -119,13 +191,13 @@ namespace Invader {
         
         switch(map_type) {
             case DATA_MAP_CACHE:
-                return this->data.data();
+                return this->mapped_data.has_value() ? this->mapped_data->data() : this->data.data();
             case DATA_MAP_BITMAP:
-                return this->bitmap_data.data();
+                return this->mapped_bitmap_data.has_value() ? this->mapped_bitmap_data->get_data() : this->bitmap_data.data();
             case DATA_MAP_SOUND:
-                return this->sound_data.data();
+                return this->mapped_sound_data.has_value() ? this->mapped_sound_data->get_data() : this->sound_data.data();
             case DATA_MAP_LOC:
-                return this->loc_data.data();
+                return this->mapped_loc_data.has_value() ? this->mapped_loc_data->get_data() : this->loc_data.data();
             default:
                 std::terminate();
         }
@@ -138,17 +210,27 @@ namespace Invader {
     std::size_t Map::get_data_length(DataMapType map_type) const noexcept {
         REDIRECT_XBOX_CACHE_DATA_HACK
         
+        if(map_type == DATA_MAP_CACHE) {
+            return this->mapped_data.has_value() ? this->mapped_data->size() : this->data.size();
+        }
+        return this->get_resource_map_length(map_type);
+    }
+
+    std::vector<std::byte> Map::release_data() noexcept {
+        return std::move(this->data);
+    }
+
+    std::size_t Map::get_resource_map_length(DataMapType map_type) const noexcept {
         switch(map_type) {
-            case DATA_MAP_CACHE:
-                return this->data.size();
             case DATA_MAP_BITMAP:
-                return this->bitmap_data.size();
+                return this->mapped_bitmap_data.has_value() ? this->mapped_bitmap_data->get_data_size() : this->bitmap_data.size();
             case DATA_MAP_SOUND:
-                return this->sound_data.size();
+                return this->mapped_sound_data.has_value() ? this->mapped_sound_data->get_data_size() : this->sound_data.size();
             case DATA_MAP_LOC:
-                return this->loc_data.size();
+                return this->mapped_loc_data.has_value() ? this->mapped_loc_data->get_data_size() : this->loc_data.size();
+            default:
+                std::terminate();
         }
-        std::terminate();
     }
 
     const std::byte *Map::get_data_at_offset(std::size_t offset, std::size_t minimum_size, DataMapType map_type) const {
@@ -185,6 +267,7 @@ namespace Invader {
             throw OutOfBoundsException();
         }
         else {
+            this->read_tag(index);
             return this->tags[index];
         }
     }
@@ -283,7 +366,6 @@ namespace Invader {
         // Preallocate tags
         const auto &header = *reinterpret_cast<const CacheFileTagDataHeader *>(this->get_tag_data_at_offset(0, sizeof(CacheFileTagDataHeader)));
         std::size_t tag_count = header.tag_count;
-        this->tags.reserve(tag_count);
 
         // Determine our scenario tag
         this->scenario_tag_id = header.scenario_tag.read().index;
@@ -306,217 +388,306 @@ namespace Invader {
             set_model_stuff(*reinterpret_cast<const CacheFileTagDataHeaderPC *>(this->get_tag_data_at_offset(0, sizeof(CacheFileTagDataHeaderPC))));
         }
 
-        auto do_populate_the_array = [&map, &tag_count](auto *tags) {
+        // Check the tag array and get the map type; the tags themselves are read when they're first accessed
+        auto check_the_array = [&map, &header, &tag_count](auto *tags) {
+            using TagType = std::remove_const_t<std::remove_pointer_t<decltype(tags)>>;
+            tags = reinterpret_cast<decltype(tags)>(map.resolve_tag_data_pointer(header.tag_array_address, sizeof(TagType) * tag_count));
+            map.tag_array = reinterpret_cast<const std::byte *>(tags);
+            map.type = reinterpret_cast<const Scenario<LittleEndian> *>(map.resolve_tag_data_pointer(tags[map.scenario_tag_id].tag_data, sizeof(Scenario<LittleEndian>)))->type;
+        };
+
+        try {
+            if(this->cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                check_the_array(static_cast<const NativeCacheFileTagDataTag *>(nullptr));
+            }
+            else {
+                check_the_array(static_cast<const CacheFileTagDataTag *>(nullptr));
+            }
+        }
+        catch(std::exception &) {
+            eprintf_error("Failed to populate the tag array");
+            throw;
+        }
+
+        this->tags.clear();
+        this->tags.reserve(tag_count);
+        for(std::size_t i = 0; i < tag_count; i++) {
+            this->tags.push_back(Tag(map));
+        }
+        this->tags_read = std::make_unique<std::atomic<bool>[]>(tag_count);
+        this->all_tags_read = false;
+        this->bsp_locations = std::nullopt;
+        for(auto &path_indices : this->resource_path_indices) {
+            path_indices = std::nullopt;
+        }
+        this->tag_path_index.clear();
+        this->tags_by_class.clear();
+    }
+
+    void Map::read_tag(std::size_t index) {
+        if(this->tags_read[index].load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(this->tag_read_mutex);
+        if(!this->tags_read[index].load(std::memory_order_relaxed)) {
+            this->read_tag_unlocked(index);
+            this->tags_read[index].store(true, std::memory_order_release);
+        }
+    }
+
+    void Map::read_all_tags() {
+        if(this->all_tags_read.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        auto tag_count = this->tags.size();
+        for(std::size_t i = 0; i < tag_count; i++) {
+            this->read_tag(i);
+        }
+
+        // Index the tags by path and by class
+        std::lock_guard<std::mutex> lock(this->tag_read_mutex);
+        if(this->all_tags_read.load(std::memory_order_relaxed)) {
+            return;
+        }
+        this->tag_path_index.clear();
+        this->tag_path_index.reserve(tag_count);
+        this->tags_by_class.clear();
+        for(auto &tag : this->tags) {
+            this->tag_path_index.add(tag.get_path(), tag.get_tag_fourcc(), tag.get_tag_index());
+            this->tags_by_class[tag.get_tag_fourcc()].emplace_back(tag.get_tag_index());
+        }
+        this->all_tags_read.store(true, std::memory_order_release);
+    }
+
+    void Map::read_tag_unlocked(std::size_t index) {
+        using namespace Invader::HEK;
+
+        auto &map = *this;
+
+        auto do_read_the_tag = [&map, &index](auto *tags) {
             // Have a pointer for the end of the tag data so we can check to make sure things aren't null terminated
             const char *tag_data_end = reinterpret_cast<const char *>(map.tag_data) + map.tag_data_length;
 
-            for(std::size_t i = 0; i < tag_count; i++) {
-                map.tags.push_back(Tag(map));
-                auto &tag = map.tags[i];
-                tag.tag_fourcc = tags[i].primary_class;
-                tag.tag_data_index_offset = reinterpret_cast<const std::byte *>(tags + i) - map.tag_data;
-                tag.tag_index = i;
-                
-                // Set the map type
-                if(i == map.scenario_tag_id) {
-                    map.type = reinterpret_cast<Scenario<LittleEndian> *>(map.resolve_tag_data_pointer(tags[i].tag_data, sizeof(Scenario<LittleEndian>)))->type;
-                }
+            auto i = index;
+            auto &tag = map.tags[i];
+            tag.tag_fourcc = tags[i].primary_class;
+            tag.tag_data_index_offset = reinterpret_cast<const std::byte *>(tags + i) - map.tag_data;
+            tag.tag_index = i;
 
-                try {
-                    const auto *path = reinterpret_cast<const char *>(map.resolve_tag_data_pointer(tags[i].tag_path));
-
-                    // Make sure the path is null-terminated and it doesn't contain whitespace that isn't an ASCII space (0x20) or forward slash characters
-                    bool null_terminated = false;
-                    for(auto *path_test = path; path < tag_data_end; path_test++) {
-                        if(*path_test == 0) {
-                            null_terminated = true;
-                            
-                            // Did we even start?
-                            if(path_test == path) {
-                                throw InvalidTagPathException();
-                            }
-                            
-                            break;
-                        }
-                        else if(*path_test == '/') {
+            try {
+                const auto *path = reinterpret_cast<const char *>(map.resolve_tag_data_pointer(tags[i].tag_path));
+
+                // Make sure the path is null-terminated and it doesn't contain whitespace that isn't an ASCII space (0x20) or forward slash characters
+                bool null_terminated = false;
+                for(auto *path_test = path; path < tag_data_end; path_test++) {
+                    if(*path_test == 0) {
+                        null_terminated = true;
+                        
+                        // Did we even start?
+                        if(path_test == path) {
                             throw InvalidTagPathException();
                         }
-                        else {
-                            // Control characters?
-                            auto latin1 = static_cast<std::uint8_t>(*path_test);
-                            if(latin1 < 0x20 || (latin1 > 0x7E && latin1 < 0xA0)) {
-                                throw InvalidTagPathException();
-                            }
-                        }
+                        
+                        break;
                     }
-
-                    // If it was null terminated and it does NOT start with a dot, use it. Otherwise, don't.
-                    if(null_terminated && *path != '.') {
-                        tag.path = Invader::File::remove_duplicate_slashes(path);
-                    }
-                    else {
+                    else if(*path_test == '/') {
                         throw InvalidTagPathException();
                     }
-                    
-                    // Lowercase everything
-                    for(char &c : tag.path) {
-                        c = std::tolower(c);
+                    else {
+                        // Control characters?
+                        auto latin1 = static_cast<std::uint8_t>(*path_test);
+                        if(latin1 < 0x20 || (latin1 > 0x7E && latin1 < 0xA0)) {
+                            throw InvalidTagPathException();
+                        }
                     }
                 }
-                catch (std::exception &) {
-                    char new_path[64];
-                    std::snprintf(new_path, sizeof(new_path), "corrupted\\tag_%zu", i);
-                    map.invalid_paths_detected = true;
-                    tag.path = new_path;
-                }
 
-                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-                    continue;
+                // If it was null terminated and it does NOT start with a dot, use it. Otherwise, don't.
+                if(null_terminated && *path != '.') {
+                    tag.path = Invader::File::remove_duplicate_slashes(path);
                 }
-                else if(sizeof(tags->tag_data) == sizeof(HEK::Pointer) && reinterpret_cast<const CacheFileTagDataTag *>(tags)[i].indexed) {
-                    tag.indexed = true;
+                else {
+                    throw InvalidTagPathException();
+                }
+                
+                // Lowercase everything
+                for(char &c : tag.path) {
+                    c = std::tolower(c);
+                }
+            }
+            catch (std::exception &) {
+                char new_path[64];
+                std::snprintf(new_path, sizeof(new_path), "corrupted\\tag_%zu", i);
+                map.invalid_paths_detected = true;
+                tag.path = new_path;
+            }
 
-                    // Indexed sound tags still use tag data (until you use reflexives)
-                    if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
-                        tag.base_struct_pointer = tags[i].tag_data;
-                    }
-                    else {
-                        tag.base_struct_pointer = 0;
-                        tag.resource_index = tags[i].tag_data;
-                    }
+            if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.cache_version != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                return;
+            }
+            else if(sizeof(tags->tag_data) == sizeof(HEK::Pointer) && reinterpret_cast<const CacheFileTagDataTag *>(tags)[i].indexed) {
+                tag.indexed = true;
 
-                    // Find where it's located
-                    DataMapType type;
-                    bool unavailable = false;
-                    switch(tag.tag_fourcc) {
-                        case TagFourCC::TAG_FOURCC_BITMAP:
-                            type = DataMapType::DATA_MAP_BITMAP;
-                            unavailable = map.bitmap_data.size() == 0;
-                            break;
-                        case TagFourCC::TAG_FOURCC_SOUND:
-                            type = DataMapType::DATA_MAP_SOUND;
-                            unavailable = map.sound_data.size() == 0;
-                            break;
-                        default:
-                            type = DataMapType::DATA_MAP_LOC;
-                            unavailable = map.loc_data.size() == 0;
-                            break;
-                    }
-                    
-                    // If we don't have the corresponding map, continue
-                    if(unavailable) {
-                        continue;
-                    }
+                // Indexed sound tags still use tag data (until you use reflexives)
+                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
+                    tag.base_struct_pointer = tags[i].tag_data;
+                }
+                else {
+                    tag.base_struct_pointer = 0;
+                    tag.resource_index = tags[i].tag_data;
+                }
 
-                    // Let's begin.
-                    auto &header = *reinterpret_cast<ResourceMapHeader *>(map.get_data_at_offset(0, sizeof(ResourceMapHeader), type));
-                    auto count = header.resource_count.read();
-                    auto *indices = reinterpret_cast<ResourceMapResource *>(map.get_data_at_offset(header.resources, count * sizeof(ResourceMapResource), type));
+                // Find where it's located
+                DataMapType type;
+                bool unavailable = false;
+                switch(tag.tag_fourcc) {
+                    case TagFourCC::TAG_FOURCC_BITMAP:
+                        type = DataMapType::DATA_MAP_BITMAP;
+                        unavailable = map.get_resource_map_length(DataMapType::DATA_MAP_BITMAP) == 0;
+                        break;
+                    case TagFourCC::TAG_FOURCC_SOUND:
+                        type = DataMapType::DATA_MAP_SOUND;
+                        unavailable = map.get_resource_map_length(DataMapType::DATA_MAP_SOUND) == 0;
+                        break;
+                    default:
+                        type = DataMapType::DATA_MAP_LOC;
+                        unavailable = map.get_resource_map_length(DataMapType::DATA_MAP_LOC) == 0;
+                        break;
+                }
+                
+                // If we don't have the corresponding map, we're done
+                if(unavailable) {
+                    return;
+                }
 
-                    // Find that index if we're a sounds.map file
-                    if(!tag.resource_index.has_value()) {
+                // Let's begin.
+                auto &header = *reinterpret_cast<ResourceMapHeader *>(map.get_data_at_offset(0, sizeof(ResourceMapHeader), type));
+                auto count = header.resource_count.read();
+                auto *indices = reinterpret_cast<ResourceMapResource *>(map.get_data_at_offset(header.resources, count * sizeof(ResourceMapResource), type));
+
+                // Find that index if we're a sounds.map file
+                if(!tag.resource_index.has_value()) {
+                    auto &path_indices = map.resource_path_indices[type];
+                    if(!path_indices.has_value()) {
+                        auto &new_path_indices = path_indices.emplace();
+                        new_path_indices.reserve(count / 2);
                         auto *paths = reinterpret_cast<const char *>(map.get_data_at_offset(header.paths, 0, type));
                         for(std::uint32_t i = 1; i < count; i+=2) {
-                            auto *path = paths + indices[i].path_offset;
-                            if(tag.path == path) {
-                                tag.resource_index = i;
-                                break;
-                            }
+                            new_path_indices.try_emplace(paths + indices[i].path_offset, i);
                         }
                     }
-                    
-                    // Do we even have an index?
-                    if(!tag.resource_index.has_value()) {
-                        eprintf_error("Tag %s.%s could not be found in the resource map file", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc));
-                        throw OutOfBoundsException();
-                    }
 
-                    // Make sure it's valid
-                    if(*tag.resource_index >= count) {
-                        eprintf_error("Tag %s.%s is out-of-bounds for the resource map(s) provided (%zu >= %zu)", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc), *tag.resource_index, static_cast<std::size_t>(count));
-                        throw OutOfBoundsException();
+                    auto found = path_indices->find(tag.path);
+                    if(found != path_indices->end()) {
+                        tag.resource_index = found->second;
                     }
+                }
+                
+                // Do we even have an index?
+                if(!tag.resource_index.has_value()) {
+                    eprintf_error("Tag %s.%s could not be found in the resource map file", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc));
+                    throw OutOfBoundsException();
+                }
 
-                    // Set it all
-                    auto &index = indices[*tag.resource_index];
-                    tag.tag_data_size = index.size;
-                    if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
-                        tag.base_struct_offset = index.data_offset + sizeof(HEK::Sound<HEK::LittleEndian>);
-                    }
-                    else {
-                        tag.base_struct_offset = index.data_offset;
-                    }
+                // Make sure it's valid
+                if(*tag.resource_index >= count) {
+                    eprintf_error("Tag %s.%s is out-of-bounds for the resource map(s) provided (%zu >= %zu)", File::halo_path_to_preferred_path(tag.path).c_str(), HEK::tag_fourcc_to_extension(tag.tag_fourcc), *tag.resource_index, static_cast<std::size_t>(count));
+                    throw OutOfBoundsException();
+                }
+
+                // Set it all
+                auto &index = indices[*tag.resource_index];
+                tag.tag_data_size = index.size;
+                if(tag.tag_fourcc == TagFourCC::TAG_FOURCC_SOUND) {
+                    tag.base_struct_offset = index.data_offset + sizeof(HEK::Sound<HEK::LittleEndian>);
                 }
                 else {
-                    tag.base_struct_pointer = tags[i].tag_data;
-                    
-                    // Check if there are external pointers
-                    switch(tag.tag_fourcc) {
-                        case TagFourCC::TAG_FOURCC_BITMAP: {
-                            auto &base_struct = tag.get_base_struct<HEK::Bitmap>();
-                            std::size_t bitmap_data_count = base_struct.bitmap_data.count;
-                            if(bitmap_data_count) {
-                                auto *bitmaps = tag.resolve_reflexive(base_struct.bitmap_data);
-                                for(std::size_t b = 0; b < bitmap_data_count; b++) {
-                                    if(bitmaps[b].flags & BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL) {
-                                        tag.external_pointers = true;
-                                        break;
-                                    }
+                    tag.base_struct_offset = index.data_offset;
+                }
+            }
+            else {
+                tag.base_struct_pointer = tags[i].tag_data;
+                
+                // Check if there are external pointers
+                switch(tag.tag_fourcc) {
+                    case TagFourCC::TAG_FOURCC_BITMAP: {
+                        auto &base_struct = tag.get_base_struct<HEK::Bitmap>();
+                        std::size_t bitmap_data_count = base_struct.bitmap_data.count;
+                        if(bitmap_data_count) {
+                            auto *bitmaps = tag.resolve_reflexive(base_struct.bitmap_data);
+                            for(std::size_t b = 0; b < bitmap_data_count; b++) {
+                                if(bitmaps[b].flags & BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL) {
+                                    tag.external_pointers = true;
+                                    break;
                                 }
                             }
-                            break;
                         }
-                        case TagFourCC::TAG_FOURCC_SOUND: {
-                            auto &base_struct = tag.get_base_struct<HEK::Sound>();
-                            std::size_t pitch_range_count = base_struct.pitch_ranges.count;
-                            if(pitch_range_count) {
-                                auto *pitch_ranges = tag.resolve_reflexive(base_struct.pitch_ranges);
-                                for(std::size_t pr = 0; pr < pitch_range_count && !tag.external_pointers; pr++) {
-                                    auto &pitch_range = pitch_ranges[pr];
-                                    std::size_t permutation_count = pitch_range.permutations.count;
-                                    if(permutation_count) {
-                                        auto *permutations = tag.resolve_reflexive(pitch_range.permutations);
-                                        for(std::size_t p = 0; p < permutation_count; p++) {
-                                            if(permutations[p].samples.external & 1) {
-                                                tag.external_pointers = true;
-                                                break; // breaks out of outer loop too due to the check
-                                            }
+                        break;
+                    }
+                    case TagFourCC::TAG_FOURCC_SOUND: {
+                        auto &base_struct = tag.get_base_struct<HEK::Sound>();
+                        std::size_t pitch_range_count = base_struct.pitch_ranges.count;
+                        if(pitch_range_count) {
+                            auto *pitch_ranges = tag.resolve_reflexive(base_struct.pitch_ranges);
+                            for(std::size_t pr = 0; pr < pitch_range_count && !tag.external_pointers; pr++) {
+                                auto &pitch_range = pitch_ranges[pr];
+                                std::size_t permutation_count = pitch_range.permutations.count;
+                                if(permutation_count) {
+                                    auto *permutations = tag.resolve_reflexive(pitch_range.permutations);
+                                    for(std::size_t p = 0; p < permutation_count; p++) {
+                                        if(permutations[p].samples.external & 1) {
+                                            tag.external_pointers = true;
+                                            break; // breaks out of outer loop too due to the check
                                         }
                                     }
                                 }
                             }
-                            break;
                         }
-                        default:
-                            break;
+                        break;
                     }
+                    default:
+                        break;
                 }
             }
         };
 
         if(this->cache_version == HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
             try {
-                do_populate_the_array(reinterpret_cast<const NativeCacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
+                do_read_the_tag(reinterpret_cast<const NativeCacheFileTagDataTag *>(this->tag_array));
             }
             catch(std::exception &) {
-                eprintf_error("Failed to populate the tag array");
+                eprintf_error("Failed to read tag #%zu", index);
                 throw;
             }
         }
         else {
             try {
-                do_populate_the_array(reinterpret_cast<const CacheFileTagDataTag *>(this->resolve_tag_data_pointer(header.tag_array_address, sizeof(CacheFileTagDataTag) * tag_count)));
+                do_read_the_tag(reinterpret_cast<const CacheFileTagDataTag *>(this->tag_array));
             }
             catch(std::exception &) {
-                eprintf_error("Failed to populate the tag array");
+                eprintf_error("Failed to read tag #%zu", index);
                 throw;
             }
-            try {
-                this->get_bsps();
+
+            // BSP data is given by the scenario tag rather than the tag array
+            if(!this->bsp_locations.has_value()) {
+                try {
+                    this->get_bsps();
+                }
+                catch(std::exception &) {
+                    eprintf_error("Failed to read BSPs");
+                    throw;
+                }
             }
-            catch(std::exception &) {
-                eprintf_error("Failed to read BSPs");
-                throw;
+
+            auto bsp = this->bsp_locations->find(index);
+            if(bsp != this->bsp_locations->end()) {
+                auto &bsp_tag = this->tags[index];
+                bsp_tag.tag_data_size = bsp->second.size;
+                bsp_tag.base_struct_offset = bsp->second.offset;
+                bsp_tag.base_struct_pointer = bsp->second.pointer;
             }
         }
     }
@@ -524,11 +695,13 @@ namespace Invader {
     void Map::get_bsps() {
         using namespace Invader::HEK;
 
-        auto &scenario_tag = this->tags[this->scenario_tag_id];
-        auto &tag = scenario_tag.get_base_struct<Scenario>();
+        // Read these straight from the tag array so the scenario tag doesn't need to be read first
+        const auto *tags = reinterpret_cast<const CacheFileTagDataTag *>(this->tag_array);
+        auto &tag = *reinterpret_cast<const Scenario<LittleEndian> *>(this->resolve_tag_data_pointer(tags[this->scenario_tag_id].tag_data, sizeof(Scenario<LittleEndian>)));
         std::size_t bsp_count = tag.structure_bsps.count;
-        auto *bsps = scenario_tag.resolve_reflexive(tag.structure_bsps);
+        auto *bsps = reinterpret_cast<const ScenarioBSP<LittleEndian> *>(bsp_count == 0 ? nullptr : this->resolve_tag_data_pointer(tag.structure_bsps.pointer, sizeof(ScenarioBSP<LittleEndian>) * bsp_count));
 
+        std::unordered_map<std::size_t, BSPLocation> locations;
         for(std::size_t i = 0; i < bsp_count; i++) {
             auto &bsp = bsps[i];
             std::size_t bsp_id = bsp.structure_bsp.tag_id.read().index;
@@ -537,11 +710,9 @@ namespace Invader {
             }
 
             // Add the BSP stuff here
-            auto &bsp_tag = this->tags[bsp_id];
-            bsp_tag.tag_data_size = bsp.bsp_size;
-            bsp_tag.base_struct_offset = bsp.bsp_start;
-            bsp_tag.base_struct_pointer = bsp.bsp_address;
+            locations.insert_or_assign(bsp_id, BSPLocation { bsp.bsp_size, bsp.bsp_start, bsp.bsp_address });
         }
+        this->bsp_locations = std::move(locations);
     }
 
     Map::CompressionType Map::get_compression_algorithm() const noexcept {
@@ -557,6 +728,15 @@ namespace Invader {
         using namespace HEK;
         
         reasons.clear();
+
+        // Every tag needs to be read to check these
+        try {
+            const_cast<Map *>(this)->read_all_tags();
+        }
+        catch(std::exception &) {
+            reasons.emplace_back("tag array could not be read");
+            return true;
+        }
         
         // Invalid paths?
         if(this->invalid_paths_detected) {
@@ -585,11 +765,12 @@ namespace Invader {
                 continue;
             }
 
+            // Only format the path for tags that actually get a reason; most tags don't
+            auto tag_merged = [&tag, &tag_class]() { return File::halo_path_to_preferred_path(tag.get_path()) + "." + tag_fourcc_to_extension(tag_class); };
+
             // If the fourCC is invalid, return true
-            auto tag_merged = File::halo_path_to_preferred_path(tag.get_path()) + "." + tag_fourcc_to_extension(tag_class);
-            
             if(tag_class == TagFourCC::TAG_FOURCC_NULL || tag_class == TagFourCC::TAG_FOURCC_NONE || tag_extension_to_fourcc(tag_fourcc_to_extension(tag_class)) != tag_class) {
-                ADD_PROT_REASON("tag \"%s\" (tag #%zu) FourCC is incorrect", tag_merged.c_str(), t);
+                ADD_PROT_REASON("tag \"%s\" (tag #%zu) FourCC is incorrect", tag_merged().c_str(), t);
             }
 
             // Empty path? Probably protected
@@ -597,41 +778,46 @@ namespace Invader {
                 ADD_PROT_REASON("tag #%zu has an empty path", t);
             }
 
-            // Go through each tag and see if we have any duplicates
-            for(std::size_t t2 = 0; t2 < t; t2++) {
-                auto &tag2 = this->get_tag(t2);
-                if(tag_class != tag2.get_tag_fourcc()) {
-                    continue;
-                }
-                if(tag2.get_path() == tag_path) {
-                    ADD_PROT_REASON("tag \"%s\" (tag #%zu) shares a path and fourCC with tag #%zu", tag_merged.c_str(), t, t2);
-                    break;
-                }
+            // See if an earlier tag has the same path and class (the index holds the first one)
+            auto first_tag = this->tag_path_index.find(tag_path, tag_class);
+            if(first_tag.has_value() && *first_tag < t) {
+                ADD_PROT_REASON("tag \"%s\" (tag #%zu) shares a path and fourCC with tag #%zu", tag_merged().c_str(), t, *first_tag);
             }
         }
         return !reasons.empty();
     }
 
-    std::optional<std::size_t> Map::find_tag(const char *tag_path, TagFourCC tag_fourcc) const noexcept {
-        for(auto &tag : tags) {
-            if(tag.get_tag_fourcc() == tag_fourcc && tag.get_path() == tag_path) {
-                return &tag - tags.data();
-            }
-        }
-        return std::nullopt;
+    std::optional<std::size_t> Map::find_tag(const char *tag_path, TagFourCC tag_fourcc) const {
+        const_cast<Map *>(this)->read_all_tags();
+        return this->tag_path_index.find(tag_path, tag_fourcc);
+    }
+
+    const std::vector<std::size_t> &Map::get_tags_of_class(TagFourCC tag_fourcc) const {
+        static const std::vector<std::size_t> no_tags;
+        const_cast<Map *>(this)->read_all_tags();
+        auto tags = this->tags_by_class.find(tag_fourcc);
+        return tags == this->tags_by_class.end() ? no_tags : tags->second;
     }
 
     Map::Map(Map &&move) {
         this->data = std::move(move.data);
+        this->mapped_data = std::move(move.mapped_data);
         this->bitmap_data = std::move(move.bitmap_data);
         this->loc_data = std::move(move.loc_data);
         this->sound_data = std::move(move.sound_data);
+        this->mapped_bitmap_data = std::move(move.mapped_bitmap_data);
+        this->mapped_loc_data = std::move(move.mapped_loc_data);
+        this->mapped_sound_data = std::move(move.mapped_sound_data);
         this->cache_version = move.cache_version;
         this->load_map();
         this->compressed = move.compressed;
         
         // Clear tags from old version
         move.tags.clear();
+        move.tags_read.reset();
+        move.all_tags_read = false;
+        move.tag_path_index.clear();
+        move.tags_by_class.clear();
     }
 
     std::byte *Map::get_internal_asset(std::size_t offset, std::size_t minimum_size) {
@@ -644,20 +830,23 @@ namespace Invader {
     }
     
     bool Map::is_clean() const noexcept {
-        if(this->get_crc32() != this->get_header_crc32() || this->is_protected() || this->data.size() != this->get_header_decompressed_file_size() || this->get_type() != this->get_header_type()) {
+        if(this->get_crc32() != this->get_header_crc32() || this->is_protected() || this->get_data_length(DataMapType::DATA_MAP_CACHE) != this->get_header_decompressed_file_size() || this->get_type() != this->get_header_type()) {
             return false;
         }
         else if(this->get_cache_version() != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-            auto tag_count = this->get_tag_count();
-            for(std::size_t i = 0; i < tag_count; i++) {
-                auto &tag = this->get_tag(i);
-                auto &index = tag.get_tag_data_index();
-                
-                // BSP tags are NOT supposed to have this set
-                if(tag.get_tag_fourcc() == HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && index.tag_data != 0) {
-                    return false;
+            try {
+                for(auto i : this->get_tags_of_class(HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP)) {
+                    auto &index = this->get_tag(i).get_tag_data_index();
+                    
+                    // BSP tags are NOT supposed to have this set
+                    if(index.tag_data != 0) {
+                        return false;
+                    }
                 }
             }
+            catch(std::exception &) {
+                return false;
+            }
         }
         return true;
     }
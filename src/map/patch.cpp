@@ -0,0 +1,384 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <invader/map/patch.hpp>
+#include <invader/map/map.hpp>
+#include <invader/hek/fourcc.hpp>
+#include <invader/error.hpp>
+#include <invader/printf.hpp>
+
+#ifndef DISABLE_ZLIB
+#include <zlib.h>
+#else
+#include "../crc/crc32.h"
+#endif
+
+namespace Invader::Patch {
+    // Increment this if the format of patches changes
+    static constexpr std::uint32_t PATCH_VERSION = 1;
+    static constexpr char PATCH_MAGIC[8] = { 'i', 'n', 'v', 'p', 'a', 't', 'c', 'h' };
+
+    // Magic, version, flags, source size, source CRC32, target size, target CRC32, command size
+    static constexpr std::size_t PATCH_SOURCE_SIZE_OFFSET = sizeof(PATCH_MAGIC) + sizeof(std::uint32_t) * 2;
+    static constexpr std::size_t PATCH_SOURCE_CRC32_OFFSET = PATCH_SOURCE_SIZE_OFFSET + sizeof(std::uint64_t);
+    static constexpr std::size_t PATCH_TARGET_SIZE_OFFSET = PATCH_SOURCE_CRC32_OFFSET + sizeof(std::uint32_t);
+    static constexpr std::size_t PATCH_TARGET_CRC32_OFFSET = PATCH_TARGET_SIZE_OFFSET + sizeof(std::uint64_t);
+    static constexpr std::size_t PATCH_COMMAND_SIZE_OFFSET = PATCH_TARGET_CRC32_OFFSET + sizeof(std::uint32_t);
+    static constexpr std::size_t PATCH_HEADER_SIZE = PATCH_COMMAND_SIZE_OFFSET + sizeof(std::uint64_t);
+
+    enum PatchFlags : std::uint32_t {
+        PATCH_FLAG_COMPRESSED = 1
+    };
+
+    // Blocks of the old cache file are indexed by their hash so data can be found anywhere in it
+    static constexpr std::size_t PATCH_BLOCK_SIZE = 32;
+
+    // Blocks with the same hash to try before giving up
+    static constexpr std::size_t PATCH_MAX_CANDIDATES = 8;
+
+    // Shortest match to copy from where the last copy left off (these cost about two bytes, so shorter is cheaper stored)
+    static constexpr std::size_t PATCH_MIN_CONTINUATION = 8;
+
+    static constexpr std::uint64_t PATCH_HASH_MULTIPLIER = 0x100000001B3;
+
+    template <typename T> static void write_value(std::byte *data, T value) noexcept {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data[i] = static_cast<std::byte>(static_cast<std::uint64_t>(value) >> (i * 8));
+        }
+    }
+
+    template <typename T> static T read_value(const std::byte *data) noexcept {
+        std::uint64_t value = 0;
+        for(std::size_t i = 0; i < sizeof(T); i++) {
+            value |= static_cast<std::uint64_t>(data[i]) << (i * 8);
+        }
+        return static_cast<T>(value);
+    }
+
+    static void write_varint(std::vector<std::byte> &data, std::uint64_t value) {
+        while(value >= 0x80) {
+            data.emplace_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        data.emplace_back(static_cast<std::byte>(value));
+    }
+
+    static bool read_varint(const std::byte *&data, const std::byte *end, std::uint64_t &value) noexcept {
+        value = 0;
+        for(std::size_t shift = 0; shift < 64; shift += 7) {
+            if(data == end) {
+                return false;
+            }
+            auto byte = static_cast<std::uint64_t>(*(data++));
+            value |= (byte & 0x7F) << shift;
+            if((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copies are usually near where the last one left off, so their offsets are stored relative to that and kept small
+    static std::uint64_t zigzag(std::int64_t value) noexcept {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    static std::int64_t unzigzag(std::uint64_t value) noexcept {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    // zlib's crc32() clashes with ours, but they're the same CRC32
+    static std::uint32_t checksum(const std::byte *data, std::size_t size) noexcept {
+        #ifndef DISABLE_ZLIB
+        return static_cast<std::uint32_t>(crc32_z(0, reinterpret_cast<const Bytef *>(data), size));
+        #else
+        return crc32(0, data, size);
+        #endif
+    }
+
+    static std::uint64_t hash_block(const std::byte *data) noexcept {
+        std::uint64_t hash = 0;
+        for(std::size_t i = 0; i < PATCH_BLOCK_SIZE; i++) {
+            hash = hash * PATCH_HASH_MULTIPLIER + static_cast<std::uint64_t>(data[i]);
+        }
+        return hash;
+    }
+
+    // Get the offset of each tag's base struct in an uncompressed cache file so tags can be matched between files
+    static std::vector<std::pair<std::size_t, std::string>> get_tag_offsets(const std::byte *data, std::size_t size) {
+        std::vector<std::pair<std::size_t, std::string>> offsets;
+        try {
+            auto map = Map::map_with_copy(data, size);
+            if(map.get_compression_algorithm() != Map::CompressionType::COMPRESSION_TYPE_NONE) {
+                return offsets;
+            }
+
+            auto *map_data = map.get_data();
+            auto map_size = map.get_data_length();
+            auto tag_count = map.get_tag_count();
+            for(std::size_t t = 0; t < tag_count; t++) {
+                auto &tag = map.get_tag(t);
+                auto *base_struct = tag.get_base_struct_data();
+                if(base_struct == nullptr || base_struct < map_data || base_struct >= map_data + map_size) {
+                    continue;
+                }
+                offsets.emplace_back(base_struct - map_data, tag.get_path() + "." + HEK::tag_fourcc_to_extension(tag.get_tag_fourcc()));
+            }
+        }
+        catch(std::exception &) {
+            offsets.clear();
+        }
+        std::sort(offsets.begin(), offsets.end());
+        return offsets;
+    }
+
+    bool is_patch(const std::byte *data, std::size_t data_size) noexcept {
+        return data_size >= PATCH_HEADER_SIZE && std::memcmp(data, PATCH_MAGIC, sizeof(PATCH_MAGIC)) == 0;
+    }
+
+    std::vector<std::byte> generate_patch(const std::byte *source, std::size_t source_size, const std::byte *target, std::size_t target_size, bool compress) {
+        // Index every block of the old cache file by its hash
+        std::vector<std::pair<std::uint64_t, std::size_t>> blocks;
+        blocks.reserve(source_size / PATCH_BLOCK_SIZE);
+        for(std::size_t offset = 0; offset + PATCH_BLOCK_SIZE <= source_size; offset += PATCH_BLOCK_SIZE) {
+            blocks.emplace_back(hash_block(source + offset), offset);
+        }
+        std::sort(blocks.begin(), blocks.end());
+
+        // When we reach a tag that's in both files, copy from where that tag is in the old file
+        std::vector<std::pair<std::size_t, std::int64_t>> tag_deltas;
+        auto source_tags = get_tag_offsets(source, source_size);
+        if(!source_tags.empty()) {
+            std::unordered_map<std::string_view, std::size_t> source_tag_offsets;
+            for(auto &t : source_tags) {
+                source_tag_offsets.emplace(t.second, t.first);
+            }
+            for(auto &t : get_tag_offsets(target, target_size)) {
+                auto source_tag = source_tag_offsets.find(t.second);
+                if(source_tag != source_tag_offsets.end()) {
+                    tag_deltas.emplace_back(t.first, static_cast<std::int64_t>(source_tag->second) - static_cast<std::int64_t>(t.first));
+                }
+            }
+        }
+
+        auto match_length = [&source, &source_size, &target, &target_size](std::size_t source_offset, std::size_t target_offset) -> std::size_t {
+            auto max_length = std::min(source_size - source_offset, target_size - target_offset);
+            std::size_t length = 0;
+            while(length < max_length && source[source_offset + length] == target[target_offset + length]) {
+                length++;
+            }
+            return length;
+        };
+
+        // Each command is some bytes stored in the patch followed by some bytes copied from the old file
+        std::vector<std::byte> commands;
+        std::size_t literal_start = 0;
+        std::size_t last_copy_end = 0;
+        auto write_command = [&commands, &literal_start, &last_copy_end, &target](std::size_t target_offset, std::size_t copy_offset, std::size_t copy_length) {
+            auto literal_length = target_offset - literal_start;
+            write_varint(commands, literal_length);
+            commands.insert(commands.end(), target + literal_start, target + target_offset);
+            write_varint(commands, copy_length);
+            write_varint(commands, zigzag(static_cast<std::int64_t>(copy_offset) - static_cast<std::int64_t>(last_copy_end + literal_length)));
+            last_copy_end = copy_offset + copy_length;
+            literal_start = target_offset + copy_length;
+        };
+
+        std::uint64_t hash_high = 1;
+        for(std::size_t i = 1; i < PATCH_BLOCK_SIZE; i++) {
+            hash_high *= PATCH_HASH_MULTIPLIER;
+        }
+
+        std::int64_t delta = 0;
+        std::size_t next_tag = 0;
+        std::uint64_t hash = 0;
+        bool hash_valid = false;
+        std::size_t offset = 0;
+        while(offset < target_size) {
+            while(next_tag < tag_deltas.size() && tag_deltas[next_tag].first <= offset) {
+                delta = tag_deltas[next_tag++].second;
+            }
+
+            // First, try to keep copying from the same place relative to where we are (changed pointers and such are skipped over this way)
+            std::size_t best_length = 0;
+            std::size_t best_offset = 0;
+            auto continuation = static_cast<std::int64_t>(offset) + delta;
+            if(continuation >= 0 && static_cast<std::uint64_t>(continuation) < source_size) {
+                auto length = match_length(static_cast<std::size_t>(continuation), offset);
+                if(length >= PATCH_MIN_CONTINUATION) {
+                    best_length = length;
+                    best_offset = static_cast<std::size_t>(continuation);
+                }
+            }
+
+            // Otherwise, look anywhere
+            if(best_length < PATCH_BLOCK_SIZE && offset + PATCH_BLOCK_SIZE <= target_size) {
+                if(!hash_valid) {
+                    hash = hash_block(target + offset);
+                    hash_valid = true;
+                }
+                auto candidate = std::lower_bound(blocks.begin(), blocks.end(), std::pair<std::uint64_t, std::size_t>(hash, 0));
+                for(std::size_t c = 0; c < PATCH_MAX_CANDIDATES && candidate != blocks.end() && candidate->first == hash; c++, candidate++) {
+                    auto length = match_length(candidate->second, offset);
+                    if(length >= PATCH_BLOCK_SIZE && length > best_length) {
+                        best_length = length;
+                        best_offset = candidate->second;
+                    }
+                }
+            }
+
+            if(best_length > 0) {
+                write_command(offset, best_offset, best_length);
+                delta = static_cast<std::int64_t>(best_offset) - static_cast<std::int64_t>(offset);
+                offset += best_length;
+                hash_valid = false;
+            }
+            else {
+                if(hash_valid && offset + PATCH_BLOCK_SIZE < target_size) {
+                    hash = (hash - static_cast<std::uint64_t>(target[offset]) * hash_high) * PATCH_HASH_MULTIPLIER + static_cast<std::uint64_t>(target[offset + PATCH_BLOCK_SIZE]);
+                }
+                else {
+                    hash_valid = false;
+                }
+                offset++;
+            }
+        }
+
+        // Store whatever is left
+        if(literal_start < target_size) {
+            write_command(target_size, last_copy_end + (target_size - literal_start), 0);
+        }
+
+        std::vector<std::byte> patch(PATCH_HEADER_SIZE);
+        std::uint32_t flags = 0;
+
+        #ifndef DISABLE_ZLIB
+        if(compress) {
+            uLongf compressed_size = compressBound(static_cast<uLong>(commands.size()));
+            patch.resize(PATCH_HEADER_SIZE + compressed_size);
+            if(compress2(reinterpret_cast<Bytef *>(patch.data() + PATCH_HEADER_SIZE), &compressed_size, reinterpret_cast<const Bytef *>(commands.data()), static_cast<uLong>(commands.size()), Z_BEST_COMPRESSION) != Z_OK) {
+                eprintf_error("Failed to compress the patch");
+                throw CompressionFailureException();
+            }
+            patch.resize(PATCH_HEADER_SIZE + compressed_size);
+            flags |= PATCH_FLAG_COMPRESSED;
+        }
+        #else
+        (void)compress;
+        #endif
+
+        if(!(flags & PATCH_FLAG_COMPRESSED)) {
+            patch.insert(patch.end(), commands.begin(), commands.end());
+        }
+
+        std::memcpy(patch.data(), PATCH_MAGIC, sizeof(PATCH_MAGIC));
+        write_value(patch.data() + sizeof(PATCH_MAGIC), PATCH_VERSION);
+        write_value(patch.data() + sizeof(PATCH_MAGIC) + sizeof(std::uint32_t), flags);
+        write_value(patch.data() + PATCH_SOURCE_SIZE_OFFSET, static_cast<std::uint64_t>(source_size));
+        write_value(patch.data() + PATCH_SOURCE_CRC32_OFFSET, checksum(source, source_size));
+        write_value(patch.data() + PATCH_TARGET_SIZE_OFFSET, static_cast<std::uint64_t>(target_size));
+        write_value(patch.data() + PATCH_TARGET_CRC32_OFFSET, checksum(target, target_size));
+        write_value(patch.data() + PATCH_COMMAND_SIZE_OFFSET, static_cast<std::uint64_t>(commands.size()));
+
+        return patch;
+    }
+
+    std::vector<std::byte> apply_patch(const std::byte *source, std::size_t source_size, const std::byte *patch, std::size_t patch_size) {
+        if(!is_patch(patch, patch_size)) {
+            eprintf_error("This is not a patch");
+            throw InvalidPatchException();
+        }
+
+        auto version = read_value<std::uint32_t>(patch + sizeof(PATCH_MAGIC));
+        if(version != PATCH_VERSION) {
+            eprintf_error("Unsupported patch version (%u != %u)", version, PATCH_VERSION);
+            throw InvalidPatchException();
+        }
+
+        auto flags = read_value<std::uint32_t>(patch + sizeof(PATCH_MAGIC) + sizeof(std::uint32_t));
+        auto expected_source_size = read_value<std::uint64_t>(patch + PATCH_SOURCE_SIZE_OFFSET);
+        auto expected_source_crc32 = read_value<std::uint32_t>(patch + PATCH_SOURCE_CRC32_OFFSET);
+        auto target_size = read_value<std::uint64_t>(patch + PATCH_TARGET_SIZE_OFFSET);
+        auto target_crc32 = read_value<std::uint32_t>(patch + PATCH_TARGET_CRC32_OFFSET);
+        auto command_size = read_value<std::uint64_t>(patch + PATCH_COMMAND_SIZE_OFFSET);
+
+        if(expected_source_size != source_size || expected_source_crc32 != checksum(source, source_size)) {
+            eprintf_error("The patch was made for a different cache file");
+            throw InvalidPatchException();
+        }
+
+        // Get the commands
+        const std::byte *stored = patch + PATCH_HEADER_SIZE;
+        std::size_t stored_size = patch_size - PATCH_HEADER_SIZE;
+        std::vector<std::byte> decompressed;
+        if(flags & PATCH_FLAG_COMPRESSED) {
+            #ifndef DISABLE_ZLIB
+            // Commands are never much bigger than the cache file they make, so don't trust anything bigger
+            if(command_size > target_size * 2 + 64) {
+                eprintf_error("The patch is invalid (commands are too large)");
+                throw InvalidPatchException();
+            }
+            decompressed.resize(command_size);
+            uLongf decompressed_size = static_cast<uLongf>(decompressed.size());
+            if(uncompress(reinterpret_cast<Bytef *>(decompressed.data()), &decompressed_size, reinterpret_cast<const Bytef *>(stored), static_cast<uLong>(stored_size)) != Z_OK || decompressed_size != decompressed.size()) {
+                eprintf_error("Failed to decompress the patch");
+                throw DecompressionFailureException();
+            }
+            stored = decompressed.data();
+            stored_size = decompressed.size();
+            #else
+            eprintf_error("Failed to decompress the patch (Invader was built without zlib)");
+            throw DecompressionFailureException();
+            #endif
+        }
+        else if(command_size != stored_size) {
+            eprintf_error("The patch is invalid (commands are truncated)");
+            throw InvalidPatchException();
+        }
+
+        // Run them
+        std::vector<std::byte> target(target_size);
+        auto *command = stored;
+        auto *command_end = stored + stored_size;
+        std::size_t offset = 0;
+        std::size_t last_copy_end = 0;
+        while(offset < target_size) {
+            std::uint64_t literal_length, copy_length, copy_offset_delta;
+            if(!read_varint(command, command_end, literal_length) || literal_length > target_size - offset || literal_length > static_cast<std::size_t>(command_end - command)) {
+                eprintf_error("The patch is invalid (stored data is out of bounds)");
+                throw InvalidPatchException();
+            }
+            std::memcpy(target.data() + offset, command, literal_length);
+            command += literal_length;
+            offset += literal_length;
+
+            if(!read_varint(command, command_end, copy_length) || !read_varint(command, command_end, copy_offset_delta) || copy_length > target_size - offset) {
+                eprintf_error("The patch is invalid (copied data is out of bounds)");
+                throw InvalidPatchException();
+            }
+            auto copy_offset = static_cast<std::int64_t>(last_copy_end + literal_length) + unzigzag(copy_offset_delta);
+            if(copy_length == 0) {
+                continue;
+            }
+            if(copy_offset < 0 || static_cast<std::uint64_t>(copy_offset) > source_size || copy_length > source_size - static_cast<std::size_t>(copy_offset)) {
+                eprintf_error("The patch is invalid (copied data is out of bounds)");
+                throw InvalidPatchException();
+            }
+            std::memcpy(target.data() + offset, source + copy_offset, copy_length);
+            offset += copy_length;
+            last_copy_end = static_cast<std::size_t>(copy_offset) + copy_length;
+        }
+
+        if(command != command_end || checksum(target.data(), target.size()) != target_crc32) {
+            eprintf_error("The patch is invalid (the patched cache file does not match)");
+            throw InvalidPatchException();
+        }
+
+        return target;
+    }
+}
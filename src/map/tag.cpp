@@ -12,11 +12,11 @@ namespace Invader {
         if(this->is_indexed()) {
             switch(this->tag_fourcc) {
                 case TagFourCC::TAG_FOURCC_BITMAP:
-                    return !this->map.bitmap_data.empty();
+                    return this->map.get_resource_map_length(Map::DataMapType::DATA_MAP_BITMAP) != 0;
                 case TagFourCC::TAG_FOURCC_SOUND:
-                    return !this->map.sound_data.empty();
+                    return this->map.get_resource_map_length(Map::DataMapType::DATA_MAP_SOUND) != 0;
                 default:
-                    return !this->map.loc_data.empty();
+                    return this->map.get_resource_map_length(Map::DataMapType::DATA_MAP_LOC) != 0;
             }
         }
 
@@ -47,6 +47,18 @@ namespace Invader {
         }
     }
     
+    const std::byte *Tag::get_base_struct_data() const noexcept {
+        if(!this->data_is_available()) {
+            return nullptr;
+        }
+        try {
+            return this->data(this->base_struct_pointer, 1);
+        }
+        catch(std::exception &) {
+            return nullptr;
+        }
+    }
+
     std::byte *Tag::data(HEK::Pointer64 pointer, std::size_t minimum) {
         using namespace HEK;
         
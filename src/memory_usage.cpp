@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <invader/memory_usage.hpp>
+#include <invader/printf.hpp>
+
+#define BYTES_TO_MiB(bytes) ((bytes) / 1024.0 / 1024.0)
+
+namespace Invader::MemoryUsage {
+    static const char *CATEGORY_NAMES[MEMORY_USAGE_CATEGORY_COUNT] = {
+        "other",
+        "parser",
+        "build_structs",
+        "raw_data",
+        "bitmap_processing",
+        "sound_pcm"
+    };
+
+    // Allocations can happen on any thread at any time (even before main()), so this has to be usable without being
+    // constructed first
+    static thread_local Category current_category = MEMORY_USAGE_CATEGORY_OTHER;
+
+    #ifdef INVADER_MEMORY_USAGE
+    struct AtomicCounters {
+        std::atomic<std::uint64_t> allocation_count;
+        std::atomic<std::uint64_t> allocated_bytes;
+        std::atomic<std::uint64_t> bytes_in_use;
+        std::atomic<std::uint64_t> peak_bytes_in_use;
+
+        void allocated(std::uint64_t size) noexcept {
+            this->allocation_count.fetch_add(1, std::memory_order_relaxed);
+            this->allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+            auto in_use = this->bytes_in_use.fetch_add(size, std::memory_order_relaxed) + size;
+            auto peak = this->peak_bytes_in_use.load(std::memory_order_relaxed);
+            while(in_use > peak && !this->peak_bytes_in_use.compare_exchange_weak(peak, in_use, std::memory_order_relaxed));
+        }
+
+        void freed(std::uint64_t size) noexcept {
+            this->bytes_in_use.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        void reset_peak() noexcept {
+            this->peak_bytes_in_use.store(this->bytes_in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        Counters get() const noexcept {
+            Counters counters;
+            counters.allocation_count = this->allocation_count.load(std::memory_order_relaxed);
+            counters.allocated_bytes = this->allocated_bytes.load(std::memory_order_relaxed);
+            counters.bytes_in_use = this->bytes_in_use.load(std::memory_order_relaxed);
+            counters.peak_bytes_in_use = this->peak_bytes_in_use.load(std::memory_order_relaxed);
+            return counters;
+        }
+    };
+
+    static AtomicCounters category_counters[MEMORY_USAGE_CATEGORY_COUNT];
+    static AtomicCounters total_counters;
+
+    // Stored before each allocation so it can be taken off of the right category when it's freed
+    struct alignas(alignof(std::max_align_t)) AllocationHeader {
+        std::size_t size;
+        Category category;
+    };
+
+    static void *allocate(std::size_t size) noexcept {
+        auto *header = static_cast<AllocationHeader *>(std::malloc(sizeof(AllocationHeader) + size));
+        if(header == nullptr) {
+            return nullptr;
+        }
+        header->size = size;
+        header->category = current_category;
+        category_counters[header->category].allocated(size);
+        total_counters.allocated(size);
+        return header + 1;
+    }
+
+    static void *allocate_or_throw(std::size_t size) {
+        void *data;
+        while((data = allocate(size)) == nullptr) {
+            auto handler = std::get_new_handler();
+            if(handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+        return data;
+    }
+
+    static void deallocate(void *data) noexcept {
+        if(data == nullptr) {
+            return;
+        }
+        auto *header = static_cast<AllocationHeader *>(data) - 1;
+        category_counters[header->category].freed(header->size);
+        total_counters.freed(header->size);
+        std::free(header);
+    }
+    #endif
+
+    bool is_enabled() noexcept {
+        #ifdef INVADER_MEMORY_USAGE
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    const char *category_name(Category category) noexcept {
+        return category < MEMORY_USAGE_CATEGORY_COUNT ? CATEGORY_NAMES[category] : "unknown";
+    }
+
+    Counters get_counters([[maybe_unused]] Category category) noexcept {
+        #ifdef INVADER_MEMORY_USAGE
+        if(category < MEMORY_USAGE_CATEGORY_COUNT) {
+            return category_counters[category].get();
+        }
+        #endif
+        return Counters();
+    }
+
+    Counters get_total_counters() noexcept {
+        #ifdef INVADER_MEMORY_USAGE
+        return total_counters.get();
+        #else
+        return Counters();
+        #endif
+    }
+
+    Category get_current_category() noexcept {
+        return current_category;
+    }
+
+    void reset_peaks() noexcept {
+        #ifdef INVADER_MEMORY_USAGE
+        for(auto &c : category_counters) {
+            c.reset_peak();
+        }
+        total_counters.reset_peak();
+        #endif
+    }
+
+    void print_counters() {
+        if(!is_enabled()) {
+            return;
+        }
+
+        oprintf("Memory usage:\n");
+        for(std::size_t c = 0; c < MEMORY_USAGE_CATEGORY_COUNT; c++) {
+            auto counters = get_counters(static_cast<Category>(c));
+            if(counters.allocation_count == 0) {
+                continue;
+            }
+            oprintf("    %-18s %.02f MiB peak, %.02f MiB in %llu allocations\n", CATEGORY_NAMES[c], BYTES_TO_MiB(counters.peak_bytes_in_use), BYTES_TO_MiB(counters.allocated_bytes), static_cast<unsigned long long>(counters.allocation_count));
+        }
+        auto total = get_total_counters();
+        oprintf("    %-18s %.02f MiB peak, %.02f MiB in %llu allocations\n", "total", BYTES_TO_MiB(total.peak_bytes_in_use), BYTES_TO_MiB(total.allocated_bytes), static_cast<unsigned long long>(total.allocation_count));
+    }
+
+    Scope::Scope(Category category) noexcept : previous(current_category) {
+        current_category = category;
+    }
+
+    Scope::~Scope() noexcept {
+        current_category = this->previous;
+    }
+}
+
+#ifdef INVADER_MEMORY_USAGE
+// Aligned allocations are left to the standard library, so they aren't counted
+void *operator new(std::size_t size) {
+    return Invader::MemoryUsage::allocate_or_throw(size);
+}
+
+void *operator new[](std::size_t size) {
+    return Invader::MemoryUsage::allocate_or_throw(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return Invader::MemoryUsage::allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return Invader::MemoryUsage::allocate(size);
+}
+
+void operator delete(void *data) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+
+void operator delete[](void *data) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+
+void operator delete(void *data, std::size_t) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+
+void operator delete[](void *data, std::size_t) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+
+void operator delete(void *data, const std::nothrow_t &) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+
+void operator delete[](void *data, const std::nothrow_t &) noexcept {
+    Invader::MemoryUsage::deallocate(data);
+}
+#endif
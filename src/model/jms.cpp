@@ -1,365 +1,611 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
+#include <unordered_map>
 #include <invader/model/jms.hpp>
+#include <invader/file/text_writer.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/thread_pool.hpp>
 
 namespace Invader {
-#define SET_CURSOR const char *cursor = next_character(string);
-#define SET_END    if(end != nullptr) { \
-                       *end = cursor; \
-                   }
-                
     static const char CRLF[] = "\r\n";
     static const char TAB[] = "\t";
     static const constexpr std::uint32_t JMS_VERSION = 8200;
     
-    static std::string precise_double_str(const double value) {
-        // Get it to 8 digits
-        std::ostringstream out;
-        auto decimal_point = std::use_facet<std::numpunct<char>>(out.getloc()).decimal_point();
-        out.precision(10);
-        out << std::fixed << value;
-        auto str = out.str();
+    // Number of vertices or triangles each thread parses at a time
+    static const constexpr std::size_t JMS_PARSE_CHUNK_SIZE = 4096;
+    
+    // Number of vertices or triangles formatted in each section when writing on multiple threads
+    static const constexpr std::size_t JMS_WRITE_CHUNK_SIZE = 4096;
+    
+    // Write a number with up to 10 decimal places
+    static void write_number(File::TextWriter &writer, double value) {
+        writer.write_decimal(value, 10);
+    }
+    
+    static void write_vector(File::TextWriter &writer, const HEK::Vector3D<HEK::NativeEndian> &vector) {
+        write_number(writer, vector.i.read());
+        write_number(writer.write(TAB), vector.j.read());
+        write_number(writer.write(TAB), vector.k.read());
+    }
+    
+    static void write_vector(File::TextWriter &writer, const HEK::Point3D<HEK::NativeEndian> &vector) {
+        write_number(writer, vector.x.read());
+        write_number(writer.write(TAB), vector.y.read());
+        write_number(writer.write(TAB), vector.z.read());
+    }
+    
+    static void write_vector(File::TextWriter &writer, const HEK::Point2D<HEK::NativeEndian> &vector) {
+        write_number(writer, vector.x.read());
+        write_number(writer.write(TAB), vector.y.read());
+    }
+    
+    static void write_vector(File::TextWriter &writer, const HEK::Quaternion<HEK::NativeEndian> &vector) {
+        write_number(writer, vector.i.read());
+        write_number(writer.write(TAB), vector.j.read());
+        write_number(writer.write(TAB), vector.k.read());
+        write_number(writer.write(TAB), vector.w.read());
+    }
+    
+    static void write_index(File::TextWriter &writer, std::uint32_t index) {
+        writer.write_integer(static_cast<std::int16_t>(index));
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Node &node) {
+        writer.write(node.name).write(CRLF);
+        write_index(writer, node.first_child);
+        write_index(writer.write(CRLF), node.sibling_node);
+        write_vector(writer.write(CRLF), node.rotation);
+        write_vector(writer.write(CRLF), node.position * 100.0F);
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Material &material) {
+        writer.write(material.name).write(CRLF).write(material.tif_path);
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Marker &marker) {
+        writer.write(marker.name).write(CRLF);
+        write_index(writer, marker.region);
+        write_index(writer.write(CRLF), marker.node);
+        write_vector(writer.write(CRLF), marker.rotation);
+        write_vector(writer.write(CRLF), marker.position * 100.0F);
+        write_number(writer.write(CRLF), marker.radius);
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Region &region) {
+        writer.write(region.name).write(CRLF);
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Vertex &vertex) {
+        auto modified_texture_coordinates = vertex.texture_coordinates;
+        modified_texture_coordinates.y = 1.0F - modified_texture_coordinates.y;
+        
+        write_index(writer, vertex.node0);
+        write_vector(writer.write(CRLF), vertex.position * 100.0F);
+        write_vector(writer.write(CRLF), vertex.normal);
+        write_index(writer.write(CRLF), vertex.node1);
+        write_number(writer.write(CRLF), vertex.node1_weight);
+        write_vector(writer.write(CRLF), modified_texture_coordinates);
+        writer.write(TAB).write('0');
+    }
+    
+    static void write_item(File::TextWriter &writer, const JMS::Triangle &triangle) {
+        write_index(writer, triangle.region);
+        write_index(writer.write(CRLF), triangle.shader);
+        write_index(writer.write(CRLF), triangle.vertices[0]);
+        write_index(writer.write(TAB), triangle.vertices[2]);
+        write_index(writer.write(TAB), triangle.vertices[1]);
+    }
+    
+    // Write the number of items followed by each item, splitting large arrays (i.e. vertices and triangles) into sections formatted on multiple threads
+    template <typename T> static void write_array(File::TextWriter &writer, const std::vector<T> &vector, std::size_t size_per_item) {
+        writer.write_unsigned(vector.size()).write(CRLF);
+        
+        std::size_t count = vector.size();
+        writer.write_sections((count + JMS_WRITE_CHUNK_SIZE - 1) / JMS_WRITE_CHUNK_SIZE, [&vector, &count](File::TextWriter &section, std::size_t chunk) {
+            std::size_t chunk_end = std::min((chunk + 1) * JMS_WRITE_CHUNK_SIZE, count);
+            for(std::size_t i = chunk * JMS_WRITE_CHUNK_SIZE; i < chunk_end; i++) {
+                write_item(section, vector[i]);
+                section.write(CRLF);
+            }
+        }, JMS_WRITE_CHUNK_SIZE * size_per_item);
+    }
+    
+    template <typename T> static std::string item_to_string(const T &item) {
+        File::TextWriter writer;
+        write_item(writer, item);
+        return writer.take_string();
+    }
+    
+    // Reads values from JMS data. Values are on their own lines or separated by tabs, and numbers may have spaces around them.
+    class JMSReader {
+    public:
+        JMSReader(const char *cursor, const char *end) noexcept : cursor(cursor), end(end) {}
+        JMSReader(const char *string) noexcept : JMSReader(string, string + std::strlen(string)) {}
+        
+        const char *position() const noexcept {
+            return this->cursor;
+        }
+        
+        void set_end(const char **end) const noexcept {
+            if(end != nullptr) {
+                *end = this->cursor;
+            }
+        }
         
-        // Remove potential commas to decimals
-        auto decimal_point_location = str.find_first_of(decimal_point);
-        if(decimal_point_location != std::string::npos) {
-            str[decimal_point_location] = '.';
+        std::string read_string(bool limit_31_characters) {
+            this->next_character();
+            const char *end_of_string = this->cursor;
+            while(end_of_string < this->end && *end_of_string && *end_of_string != '\r' && *end_of_string != '\n' && *end_of_string != '\t') {
+                end_of_string++;
+            }
+            
+            if(limit_31_characters && end_of_string - this->cursor > 31) {
+                throw std::out_of_range(std::string("maximum string length (") + std::to_string(end_of_string - this->cursor) + " > 31) exceeded");
+            }
+            
+            // Make a substring out of this
+            std::string value = std::string(this->cursor, end_of_string);
+            
+            // Strings get lowercased
+            for(auto &c : value) {
+                c = std::tolower(c);
+            }
+            
+            // Set pointer to end of this string
+            this->cursor = end_of_string;
+            
+            // Done!
+            return value;
+        }
+        
+        float read_float() {
+            float value;
+            auto *number_end = this->read_number(value);
+            
+            // from_chars leaves the value alone if it's out of range, but strtof doesn't
+            if(number_end == nullptr) {
+                value = std::strtof(std::string(this->cursor, this->number_end()).c_str(), nullptr);
+                number_end = this->number_end();
+            }
+            
+            this->cursor = number_end;
+            return value;
         }
-        else {
-            decimal_point_location = 1;
+        
+        std::int32_t read_int32() {
+            long value;
+            auto *number_end = this->read_number(value);
+            
+            // Same with strtol
+            if(number_end == nullptr) {
+                value = std::strtol(std::string(this->cursor, this->number_end()).c_str(), nullptr, 10);
+                number_end = this->number_end();
+            }
+            
+            this->cursor = number_end;
+            return static_cast<std::int32_t>(value);
         }
         
-        // Remove trailing zeroes
-        std::size_t n = str.size() - 1;
-        while(n > decimal_point_location && str[n] == '0') {
-            n--;
+        std::uint32_t read_uint32() {
+            std::uint32_t value = static_cast<std::uint32_t>(this->read_int32());
+            return value;
         }
         
-        // Only remove decimal if needed. Otherwise, add one so we remove the 0 instead.
-        if(str[n] != '.') {
-            n++;
+        /**
+         * Skip to the next number
+         * @return start of the number
+         */
+        const char *start_number() {
+            this->next_number();
+            return this->cursor;
         }
         
-        // Done
-        str.resize(n);
+        /**
+         * Skip a number without reading it
+         */
+        void skip_number() {
+            this->next_number();
+            this->cursor = this->number_end();
+        }
         
-        return str;
-    }
-    
-    // Skip to the next character that can be read
-    static const char *next_character(const char *string) {
-        if(string) {
-            while(*string == '\r' || *string == '\t' || *string == '\n') {
-                string++;
+        template <typename T> std::vector<T> read_array() {
+            std::vector<T> arr;
+            auto count = this->read_uint32();
+            arr.reserve(count);
+            for(std::size_t i = 0; i < count; i++) {
+                arr.emplace_back(this->read<T>());
             }
-            if(*string == 0) {
+            return arr;
+        }
+        
+        template <typename T> T read();
+        
+    private:
+        const char *cursor;
+        const char *end;
+        
+        // Skip to the next character that can be read
+        void next_character() {
+            while(this->cursor < this->end && (*this->cursor == '\r' || *this->cursor == '\t' || *this->cursor == '\n')) {
+                this->cursor++;
+            }
+            if(this->cursor == this->end || *this->cursor == 0) {
                 throw std::invalid_argument("no character afterwards");
             }
-            return string;
         }
         
-        throw std::invalid_argument("null string given");
-    }
-    
-    static std::string string_from_string(const char *&string, bool limit_31_characters) {
-        string = next_character(string);
-        const char *end_of_string = string;
-        while(*end_of_string && *end_of_string != '\r' && *end_of_string != '\n' && *end_of_string != '\t') {
-            end_of_string++;
+        // Skip to the next number, skipping any whitespace like strtof/strtol do
+        void next_number() {
+            while(this->cursor < this->end && std::isspace(static_cast<unsigned char>(*this->cursor))) {
+                this->cursor++;
+            }
+            if(this->cursor == this->end || *this->cursor == 0) {
+                throw std::invalid_argument("no character afterwards");
+            }
         }
         
-        if(limit_31_characters && end_of_string - string > 31) {
-            throw std::out_of_range(std::string("maximum string length (") + std::to_string(end_of_string - string) + " > 31) exceeded");
+        const char *number_end() const noexcept {
+            const char *number_end = this->cursor;
+            while(number_end < this->end && *number_end && !std::isspace(static_cast<unsigned char>(*number_end))) {
+                number_end++;
+            }
+            return number_end;
         }
         
-        // Make a substring out of this
-        std::string value = std::string(string, end_of_string);
+        // Returns the end of the number, or nullptr if it's out of range
+        template <typename T> const char *read_number(T &value) {
+            this->next_number();
+            
+            // strtof/strtol take a leading plus sign, but from_chars doesn't
+            const char *number_start = this->cursor;
+            if(*number_start == '+' && number_start + 1 < this->end && number_start[1] != '-') {
+                number_start++;
+            }
+            
+            auto result = std::from_chars(number_start, this->end, value);
+            if(result.ec == std::errc::invalid_argument) {
+                auto copy = *this;
+                throw std::invalid_argument("cannot convert string `" + copy.read_string(false) + "` to " + (std::is_integral_v<T> ? "an integer" : "a number"));
+            }
+            else if(result.ec == std::errc::result_out_of_range) {
+                return nullptr;
+            }
+            return result.ptr;
+        }
         
-        // Strings get lowercased
-        for(auto &c : value) {
-            c = std::tolower(c);
+        HEK::Quaternion<HEK::NativeEndian> read_quaternion() {
+            HEK::Quaternion<HEK::NativeEndian> v;
+            v.i = this->read_float();
+            v.j = this->read_float();
+            v.k = this->read_float();
+            v.w = this->read_float();
+            return v;
         }
         
-        // Set pointer to end of this string
-        string = end_of_string;
+        HEK::Vector3D<HEK::NativeEndian> read_vector3d() {
+            HEK::Vector3D<HEK::NativeEndian> v;
+            v.i = this->read_float();
+            v.j = this->read_float();
+            v.k = this->read_float();
+            return v;
+        }
         
-        // Done!
-        return value;
-    }
-    
-    static float read_next_float(const char *&string) {
-        string = next_character(string);
-        auto *old_str = string;
-        float value = std::strtof(string, const_cast<char **>(&string));
-        if(old_str == string) {
-            auto string_copy = string;
-            throw std::invalid_argument("cannot convert string `" + string_from_string(string_copy, false) + "` to a number");
+        HEK::Point2D<HEK::NativeEndian> read_point2d() {
+            HEK::Point2D<HEK::NativeEndian> v;
+            v.x = this->read_float();
+            v.y = this->read_float();
+            return v;
         }
-        return value;
-    }
-    
-    static std::int32_t read_next_int32(const char *&string) {
-        string = next_character(string);
-        auto *old_str = string;
-        std::int32_t value = std::strtol(string, const_cast<char **>(&string), 10);
-        if(old_str == string) {
-            auto string_copy = string;
-            throw std::invalid_argument("cannot convert string `" + string_from_string(string_copy, false) + "` to an integer");
+        
+        HEK::Point3D<HEK::NativeEndian> read_point3d() {
+            HEK::Point3D<HEK::NativeEndian> v;
+            v.x = this->read_float();
+            v.y = this->read_float();
+            v.z = this->read_float();
+            return v;
         }
-        return value;
-    }
-    
-    static std::uint32_t read_next_uint32(const char *&string) {
-        std::uint32_t value = static_cast<std::uint32_t>(read_next_int32(string));
-        return value;
-    }
+    };
     
-    template <typename T> static std::string array_to_string(const std::vector<T> &vector) {
-        std::string rval = std::to_string(vector.size()) + CRLF;
-        for(auto &i : vector) {
-            rval += i.string() + CRLF;
-        }
-        return rval;
+    template <> JMS::Marker JMSReader::read() {
+        JMS::Marker m;
+        m.name = this->read_string(true);
+        m.region = this->read_uint32();
+        m.node = this->read_uint32();
+        m.rotation = this->read_quaternion();
+        m.position = this->read_point3d() / 100.0F;
+        m.radius = this->read_float();
+        return m;
     }
     
-    template <typename T> static std::vector<T> array_from_string(const char *&string) {
-        std::vector<T> arr;
-        auto count = read_next_uint32(string);
-        arr.reserve(count);
-        for(std::size_t i = 0; i < count; i++) {
-            arr.emplace_back(T::from_string(string, &string));
-        }
-        return arr;
+    template <> JMS::Node JMSReader::read() {
+        JMS::Node n;
+        n.name = this->read_string(true);
+        n.first_child = this->read_uint32();
+        n.sibling_node = this->read_uint32();
+        n.rotation = this->read_quaternion();
+        n.position = this->read_point3d() / 100.0F;
+        return n;
     }
     
-    static std::string vector_to_string(const HEK::Vector3D<HEK::NativeEndian> &vector) {
-        return precise_double_str(vector.i.read()) + TAB + precise_double_str(vector.j.read()) + TAB + precise_double_str(vector.k.read());
+    template <> JMS::Material JMSReader::read() {
+        JMS::Material m;
+        m.name = this->read_string(false);
+        m.tif_path = this->read_string(false);
+        return m;
     }
     
-    static std::string vector_to_string(const HEK::Point3D<HEK::NativeEndian> &vector) {
-        return precise_double_str(vector.x.read()) + TAB + precise_double_str(vector.y.read()) + TAB + precise_double_str(vector.z.read());
+    template <> JMS::Region JMSReader::read() {
+        JMS::Region r;
+        r.name = this->read_string(true);
+        return r;
     }
     
-    static std::string vector_to_string(const HEK::Point2D<HEK::NativeEndian> &vector) {
-        return precise_double_str(vector.x.read()) + TAB + precise_double_str(vector.y.read());
+    template <> JMS::Vertex JMSReader::read() {
+        JMS::Vertex v;
+        v.node0 = this->read_uint32();
+        v.position = this->read_point3d() / 100.0F;
+        v.normal = this->read_vector3d().normalize();
+        v.node1 = this->read_uint32();
+        v.node1_weight = this->read_float();
+        v.texture_coordinates = this->read_point2d();
+        v.texture_coordinates.y = 1.0F - v.texture_coordinates.y; // this is flipped for some reason
+        this->read_float();
+        return v;
     }
     
-    static std::string vector_to_string(const HEK::Quaternion<HEK::NativeEndian> &vector) {
-        return precise_double_str(vector.i.read()) + TAB + precise_double_str(vector.j.read())+ TAB + precise_double_str(vector.k.read())+ TAB + precise_double_str(vector.w.read());
+    template <> JMS::Triangle JMSReader::read() {
+        JMS::Triangle t;
+        t.region = this->read_uint32();
+        t.shader = this->read_uint32();
+        t.vertices[0] = this->read_uint32();
+        t.vertices[2] = this->read_uint32();
+        t.vertices[1] = this->read_uint32();
+        return t;
     }
     
-    static HEK::Quaternion<HEK::NativeEndian> quaternion_from_string(const char *&string) {
-        HEK::Quaternion<HEK::NativeEndian> v;
-        v.i = read_next_float(string);
-        v.j = read_next_float(string);
-        v.k = read_next_float(string);
-        v.w = read_next_float(string);
-        return v;
+    // Read an array of vertices or triangles, splitting it into chunks that are parsed on separate threads
+    template <typename T> static std::vector<T> read_array_threaded(JMSReader &reader, std::size_t thread_count) {
+        auto count = reader.read_uint32();
+        auto array_reader = reader;
+        
+        // Find where each chunk starts and ends by counting values, which is much faster than parsing them. If there's
+        // only one thread, don't bother.
+        struct Chunk {
+            const char *start;
+            const char *end;
+            std::size_t first;
+            std::size_t count;
+        };
+        std::vector<Chunk> chunks;
+        std::atomic<bool> parse_sequentially = thread_count <= 1 || count == 0;
+        if(!parse_sequentially) {
+            try {
+                // Count how many values the first one takes up when parsed, so the chunks are split the same way
+                auto first_reader = reader;
+                first_reader.read<T>();
+                std::size_t token_count = 0;
+                for(auto token_reader = reader; token_reader.position() < first_reader.position(); token_count++) {
+                    token_reader.skip_number();
+                }
+                
+                for(std::size_t i = 0; i < count; i += JMS_PARSE_CHUNK_SIZE) {
+                    auto &chunk = chunks.emplace_back();
+                    chunk.first = i;
+                    chunk.count = std::min(JMS_PARSE_CHUNK_SIZE, count - i);
+                    chunk.start = reader.start_number();
+                    for(std::size_t t = 0; t < token_count * chunk.count; t++) {
+                        reader.skip_number();
+                    }
+                    chunk.end = reader.position();
+                }
+            }
+            catch(std::exception &) {
+                parse_sequentially = true;
+            }
+        }
+        
+        std::vector<T> arr;
+        if(!parse_sequentially) {
+            arr.resize(count);
+            ThreadPool::shared().parallel_for(chunks.size(), [&chunks, &arr, &parse_sequentially](std::size_t c) {
+                if(parse_sequentially) {
+                    return;
+                }
+                try {
+                    auto &chunk = chunks[c];
+                    JMSReader chunk_reader(chunk.start, chunk.end);
+                    for(std::size_t i = 0; i < chunk.count; i++) {
+                        arr[chunk.first + i] = chunk_reader.read<T>();
+                    }
+                    
+                    // If the values weren't split the same way they're parsed, the chunks are wrong
+                    if(chunk_reader.position() != chunk.end) {
+                        parse_sequentially = true;
+                    }
+                }
+                catch(std::exception &) {
+                    parse_sequentially = true;
+                }
+            }, thread_count);
+        }
+        
+        // Otherwise, parse it one value at a time, which also reports any error for the right value
+        if(parse_sequentially) {
+            reader = array_reader;
+            arr.clear();
+            arr.reserve(count);
+            for(std::size_t i = 0; i < count; i++) {
+                arr.emplace_back(reader.read<T>());
+            }
+        }
+        
+        return arr;
     }
     
-    static HEK::Vector3D<HEK::NativeEndian> vector3d_from_string(const char *&string) {
-        HEK::Vector3D<HEK::NativeEndian> v;
-        v.i = read_next_float(string);
-        v.j = read_next_float(string);
-        v.k = read_next_float(string);
-        return v;
+    static JMS read_jms(JMSReader &reader, std::size_t thread_count) {
+        auto version = reader.read_int32();
+        if(version != JMS_VERSION) {
+            throw std::invalid_argument("invalid version");
+        }
+        
+        // Build our JMS struct
+        JMS jms;
+        jms.node_list_checksum = reader.read_uint32(); // skip
+        jms.nodes = reader.read_array<JMS::Node>();
+        jms.materials = reader.read_array<JMS::Material>();
+        jms.markers = reader.read_array<JMS::Marker>();
+        jms.regions = reader.read_array<JMS::Region>();
+        jms.vertices = read_array_threaded<JMS::Vertex>(reader, thread_count);
+        jms.triangles = read_array_threaded<JMS::Triangle>(reader, thread_count);
+        return jms;
     }
     
-    static HEK::Point2D<HEK::NativeEndian> point2d_from_string(const char *&string) {
-        HEK::Point2D<HEK::NativeEndian> v;
-        v.x = read_next_float(string);
-        v.y = read_next_float(string);
-        return v;
+    JMS JMS::from_string(const char *string, const char **end) {
+        JMSReader reader(string);
+        auto jms = read_jms(reader, 1);
+        reader.set_end(end);
+        return jms;
     }
     
-    static HEK::Point3D<HEK::NativeEndian> point3d_from_string(const char *&string) {
-        HEK::Point3D<HEK::NativeEndian> v;
-        v.x = read_next_float(string);
-        v.y = read_next_float(string);
-        v.z = read_next_float(string);
-        return v;
+    JMS JMS::from_data(const char *data, std::size_t size, std::size_t thread_count) {
+        JMSReader reader(data, data + size);
+        return read_jms(reader, thread_count);
     }
     
-    JMS JMS::from_string(const char *string, const char **end) {
-        try {
-            SET_CURSOR
-            auto version = read_next_int32(cursor);
-            if(version != JMS_VERSION) {
-                throw std::invalid_argument("invalid version");
-            }
-            
-            // Build our JMS struct
-            JMS jms;
-            jms.node_list_checksum = read_next_uint32(cursor); // skip
-            jms.nodes = array_from_string<Node>(cursor);
-            jms.materials = array_from_string<Material>(cursor);
-            jms.markers = array_from_string<Marker>(cursor);
-            jms.regions = array_from_string<Region>(cursor);
-            jms.vertices = array_from_string<Vertex>(cursor);
-            jms.triangles = array_from_string<Triangle>(cursor);
-            SET_END
-            return jms;
-        }
-        catch (std::exception &) {
-            throw;
-        }
-    }
     std::string JMS::string() const {
-        std::string r;
+        // Vertices take up most of the file, with each one taking roughly 100 bytes
+        File::TextWriter writer;
+        writer.reserve(this->vertices.size() * 100 + this->triangles.size() * 32 + 4096);
         
-        r += std::to_string(JMS_VERSION) + CRLF;
-        r += std::to_string(this->node_list_checksum) + CRLF;
-        r += array_to_string(this->nodes);
-        r += array_to_string(this->materials);
-        r += array_to_string(this->markers);
-        r += array_to_string(this->regions);
-        r += array_to_string(this->vertices);
-        r += array_to_string(this->triangles);
+        writer.write_unsigned(JMS_VERSION).write(CRLF);
+        writer.write_unsigned(this->node_list_checksum).write(CRLF);
+        write_array(writer, this->nodes, 96);
+        write_array(writer, this->materials, 96);
+        write_array(writer, this->markers, 128);
+        write_array(writer, this->regions, 32);
+        write_array(writer, this->vertices, 100);
+        write_array(writer, this->triangles, 32);
         
-        return r;
+        return writer.take_string();
     }
     
     JMS::Marker JMS::Marker::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Marker m;
-        m.name = string_from_string(cursor, true);
-        m.region = read_next_uint32(cursor);
-        m.node = read_next_uint32(cursor);
-        m.rotation = quaternion_from_string(cursor);
-        m.position = point3d_from_string(cursor) / 100.0F;
-        m.radius = read_next_float(cursor);
-        SET_END
-        return m;
+        JMSReader reader(string);
+        auto r = reader.read<Marker>();
+        reader.set_end(end);
+        return r;
     }
     std::string JMS::Marker::string() const {
-        return this->name + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->region)) + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->node)) + CRLF +
-               vector_to_string(this->rotation) + CRLF +
-               vector_to_string(this->position * 100.0F) + CRLF +
-               precise_double_str(this->radius);
+        return item_to_string(*this);
     }
     
     JMS::Node JMS::Node::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Node n;
-        n.name = string_from_string(cursor, true);
-        n.first_child = read_next_uint32(cursor);
-        n.sibling_node = read_next_uint32(cursor);
-        n.rotation = quaternion_from_string(cursor);
-        n.position = point3d_from_string(cursor) / 100.0F;
-        SET_END
-        return n;
+        JMSReader reader(string);
+        auto r = reader.read<Node>();
+        reader.set_end(end);
+        return r;
     }
     std::string JMS::Node::string() const {
-        return this->name + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->first_child)) + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->sibling_node)) + CRLF +
-               vector_to_string(this->rotation) + CRLF +
-               vector_to_string(this->position * 100.0F);
+        return item_to_string(*this);
     }
     
     JMS::Material JMS::Material::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Material m;
-        m.name = string_from_string(cursor, false);
-        m.tif_path = string_from_string(cursor, false);
-        
-        SET_END
-        return m;
+        JMSReader reader(string);
+        auto r = reader.read<Material>();
+        reader.set_end(end);
+        return r;
     }
     std::string JMS::Material::string() const {
-        return this->name + CRLF + this->tif_path;
+        return item_to_string(*this);
     }
     
     JMS::Region JMS::Region::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Region r;
-        r.name = string_from_string(cursor, true);
-        SET_END
+        JMSReader reader(string);
+        auto r = reader.read<Region>();
+        reader.set_end(end);
         return r;
     }
     std::string JMS::Region::string() const {
-        return this->name + CRLF;
+        return item_to_string(*this);
     }
     
     JMS::Vertex JMS::Vertex::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Vertex v;
-        v.node0 = read_next_uint32(cursor);
-        v.position = point3d_from_string(cursor) / 100.0F;
-        v.normal = vector3d_from_string(cursor).normalize();
-        v.node1 = read_next_uint32(cursor);
-        v.node1_weight = read_next_float(cursor);
-        v.texture_coordinates = point2d_from_string(cursor);
-        v.texture_coordinates.y = 1.0F - v.texture_coordinates.y; // this is flipped for some reason
-        read_next_float(cursor);
-        SET_END
-        return v;
+        JMSReader reader(string);
+        auto r = reader.read<Vertex>();
+        reader.set_end(end);
+        return r;
     }
     std::string JMS::Vertex::string() const {
-        auto modified_texture_coordinates = this->texture_coordinates;
-        modified_texture_coordinates.y = 1.0F - modified_texture_coordinates.y;
-        
-        return std::to_string(static_cast<std::int16_t>(this->node0)) + CRLF +
-               vector_to_string(this->position * 100.0F) + CRLF +
-               vector_to_string(this->normal) + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->node1)) + CRLF +
-               precise_double_str(this->node1_weight) + CRLF +
-               vector_to_string(modified_texture_coordinates) + TAB + "0";
+        return item_to_string(*this);
     }
     
     JMS::Triangle JMS::Triangle::from_string(const char *string, const char **end) {
-        SET_CURSOR
-        Triangle t;
-        t.region = read_next_uint32(cursor);
-        t.shader = read_next_uint32(cursor);
-        t.vertices[0] = read_next_uint32(cursor);
-        t.vertices[2] = read_next_uint32(cursor);
-        t.vertices[1] = read_next_uint32(cursor);
-        
-        SET_END
-        return t;
+        JMSReader reader(string);
+        auto r = reader.read<Triangle>();
+        reader.set_end(end);
+        return r;
     }
     std::string JMS::Triangle::string() const {
-        return std::to_string(static_cast<std::int16_t>(this->region)) + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->shader)) + CRLF +
-               std::to_string(static_cast<std::int16_t>(this->vertices[0])) + TAB +
-               std::to_string(static_cast<std::int16_t>(this->vertices[2])) + TAB +
-               std::to_string(static_cast<std::int16_t>(this->vertices[1]));
+        return item_to_string(*this);
     }
     
+    // Hashes exactly what Vertex::operator== compares; 0.0 is added to each float so -0.0 and 0.0 hash the same
+    struct VertexHash {
+        std::size_t operator()(const JMS::Vertex &vertex) const noexcept {
+            FNV1AHash hash;
+            auto add_int = [&hash](std::uint32_t value) {
+                hash.add_value(value);
+            };
+            auto add_float = [&hash](float value) {
+                hash.add_value(value + 0.0F);
+            };
+            add_int(vertex.node0);
+            add_float(vertex.position.x);
+            add_float(vertex.position.y);
+            add_float(vertex.position.z);
+            add_float(vertex.normal.i);
+            add_float(vertex.normal.j);
+            add_float(vertex.normal.k);
+            add_int(vertex.node1);
+            add_float(vertex.node1_weight);
+            add_float(vertex.texture_coordinates.x);
+            add_float(vertex.texture_coordinates.y);
+            return static_cast<std::size_t>(hash.get());
+        }
+    };
+
     void JMS::optimize() {
-        // Here we go
-        auto erase_vertex = [](JMS *jms, std::size_t vertex, std::size_t new_vertex = 0) {
-            jms->vertices.erase(jms->vertices.begin() + vertex);
-                    
-            // Go through each triangle and associate the triangles with the new vertex if they use the old one
-            // Or decrease their index by 1 if they reference a vertex after it
-            for(auto &t : jms->triangles) {
-                for(auto &t2 : t.vertices) {
-                    if(t2 == vertex) {
-                        t2 = new_vertex;
-                    }
-                    else if(t2 > vertex) {
-                        t2--;
-                    }
-                }
+        // Optimize vertices by deduping, keeping the first of each vertex in its original order
+        std::size_t vertex_count = this->vertices.size();
+        std::unordered_map<Vertex, std::uint32_t, VertexHash> unique_vertices;
+        unique_vertices.reserve(vertex_count);
+        std::vector<std::uint32_t> vertex_remap(vertex_count);
+        std::vector<Vertex> optimized_vertices;
+        optimized_vertices.reserve(vertex_count);
+        
+        for(std::size_t v = 0; v < vertex_count; v++) {
+            auto &vertex = this->vertices[v];
+            auto [unique_vertex, added] = unique_vertices.try_emplace(vertex, static_cast<std::uint32_t>(optimized_vertices.size()));
+            if(added) {
+                optimized_vertices.emplace_back(vertex);
             }
-        };
+            vertex_remap[v] = unique_vertex->second;
+        }
         
-        // Optimize vertices by deduping
-        for(std::size_t v = 0; v < this->vertices.size(); v++) {
-            for(std::size_t v2 = v + 1; v2 < this->vertices.size(); v2++) {
-                // If it's the same, we can optimize it
-                if(this->vertices[v] == this->vertices[v2]) {
-                    // Delete vertex if needed
-                    erase_vertex(this, v2, v);
-                    
-                    // Decrement
-                    v2--;
+        this->vertices = std::move(optimized_vertices);
+        
+        // Associate the triangles with the vertices that were kept
+        for(auto &t : this->triangles) {
+            for(auto &t2 : t.vertices) {
+                if(t2 < vertex_count) {
+                    t2 = vertex_remap[t2];
                 }
             }
         }
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+#include "mesh_optimize.hpp"
+
+namespace Invader::Model {
+    // Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+    static constexpr std::size_t VERTEX_CACHE_SIZE = 32;
+    static constexpr float CACHE_DECAY_POWER = 1.5F;
+    static constexpr float LAST_TRIANGLE_SCORE = 0.75F;
+    static constexpr float VALENCE_BOOST_SCALE = 2.0F;
+    static constexpr float VALENCE_BOOST_POWER = 0.5F;
+    
+    static float vertex_score(std::size_t cache_position, std::size_t remaining_triangles) {
+        // Nothing left to draw with this vertex
+        if(remaining_triangles == 0) {
+            return -1.0F;
+        }
+        
+        float score = 0.0F;
+        if(cache_position < VERTEX_CACHE_SIZE) {
+            // The last triangle's vertices get a fixed score so the next triangle doesn't just reuse the same edge
+            if(cache_position < 3) {
+                score = LAST_TRIANGLE_SCORE;
+            }
+            else {
+                float scaler = 1.0F / (VERTEX_CACHE_SIZE - 3);
+                score = std::pow(1.0F - (cache_position - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+        
+        // Favor vertices with few triangles left so they don't get stranded
+        return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining_triangles), -VALENCE_BOOST_POWER);
+    }
+    
+    void optimize_vertex_cache(std::vector<JMS::Triangle> &triangles, std::size_t vertex_count) {
+        std::size_t triangle_count = triangles.size();
+        if(triangle_count < 2) {
+            return;
+        }
+        
+        // Find the triangles each vertex is used by
+        std::vector<std::size_t> vertex_triangle_offset(vertex_count + 1);
+        for(auto &t : triangles) {
+            for(auto v : t.vertices) {
+                vertex_triangle_offset[v + 1]++;
+            }
+        }
+        for(std::size_t v = 0; v < vertex_count; v++) {
+            vertex_triangle_offset[v + 1] += vertex_triangle_offset[v];
+        }
+        std::vector<std::size_t> vertex_triangles(vertex_triangle_offset[vertex_count]);
+        std::vector<std::size_t> remaining_triangles(vertex_count);
+        for(std::size_t t = 0; t < triangle_count; t++) {
+            for(auto v : triangles[t].vertices) {
+                vertex_triangles[vertex_triangle_offset[v] + remaining_triangles[v]++] = t;
+            }
+        }
+        
+        static constexpr std::size_t NOT_CACHED = std::numeric_limits<std::size_t>::max();
+        std::vector<std::size_t> cache_position(vertex_count, NOT_CACHED);
+        std::vector<float> scores(vertex_count);
+        for(std::size_t v = 0; v < vertex_count; v++) {
+            scores[v] = vertex_score(NOT_CACHED, remaining_triangles[v]);
+        }
+        
+        std::vector<float> triangle_scores(triangle_count);
+        std::vector<bool> triangle_added(triangle_count, false);
+        for(std::size_t t = 0; t < triangle_count; t++) {
+            auto &vertices = triangles[t].vertices;
+            triangle_scores[t] = scores[vertices[0]] + scores[vertices[1]] + scores[vertices[2]];
+        }
+        
+        std::vector<JMS::Triangle> optimized_triangles;
+        optimized_triangles.reserve(triangle_count);
+        std::vector<std::uint32_t> cache;
+        cache.reserve(VERTEX_CACHE_SIZE + 3);
+        std::size_t next_unadded_triangle = 0;
+        
+        while(optimized_triangles.size() < triangle_count) {
+            // Pick the best triangle using a vertex in the cache, or if there are none, the next one that wasn't added
+            std::size_t best_triangle = NOT_CACHED;
+            float best_score = -std::numeric_limits<float>::infinity();
+            for(auto v : cache) {
+                for(std::size_t i = vertex_triangle_offset[v]; i < vertex_triangle_offset[v] + remaining_triangles[v]; i++) {
+                    auto t = vertex_triangles[i];
+                    if(triangle_scores[t] > best_score) {
+                        best_score = triangle_scores[t];
+                        best_triangle = t;
+                    }
+                }
+            }
+            if(best_triangle == NOT_CACHED) {
+                while(triangle_added[next_unadded_triangle]) {
+                    next_unadded_triangle++;
+                }
+                best_triangle = next_unadded_triangle;
+            }
+            
+            auto &triangle = triangles[best_triangle];
+            triangle_added[best_triangle] = true;
+            optimized_triangles.emplace_back(triangle);
+            
+            // Remove it from its vertices' lists and move its vertices to the front of the cache
+            std::vector<std::uint32_t> new_cache(std::begin(triangle.vertices), std::end(triangle.vertices));
+            for(auto v : triangle.vertices) {
+                auto first = vertex_triangle_offset[v];
+                auto last = first + remaining_triangles[v];
+                for(auto i = first; i < last; i++) {
+                    if(vertex_triangles[i] == best_triangle) {
+                        vertex_triangles[i] = vertex_triangles[last - 1];
+                        remaining_triangles[v]--;
+                        break;
+                    }
+                }
+            }
+            for(auto v : cache) {
+                if(v != triangle.vertices[0] && v != triangle.vertices[1] && v != triangle.vertices[2]) {
+                    new_cache.emplace_back(v);
+                }
+            }
+            
+            // Rescore everything that was in the cache, including what just fell out of it
+            for(std::size_t c = 0; c < new_cache.size(); c++) {
+                auto v = new_cache[c];
+                cache_position[v] = c < VERTEX_CACHE_SIZE ? c : NOT_CACHED;
+                scores[v] = vertex_score(cache_position[v], remaining_triangles[v]);
+            }
+            for(auto v : new_cache) {
+                for(std::size_t i = vertex_triangle_offset[v]; i < vertex_triangle_offset[v] + remaining_triangles[v]; i++) {
+                    auto &t = triangles[vertex_triangles[i]].vertices;
+                    triangle_scores[vertex_triangles[i]] = scores[t[0]] + scores[t[1]] + scores[t[2]];
+                }
+            }
+            
+            if(new_cache.size() > VERTEX_CACHE_SIZE) {
+                new_cache.resize(VERTEX_CACHE_SIZE);
+            }
+            cache = std::move(new_cache);
+        }
+        
+        triangles = std::move(optimized_triangles);
+    }
+    
+    std::vector<std::uint32_t> make_triangle_strip(const std::vector<JMS::Triangle> &triangles, std::size_t vertex_count) {
+        // Triangles in Halo are stored like this:
+        //
+        // A B C D          A          B          C          D
+        // 0 1 2 3 4 5 6 = (0, 1, 2); (1, 3, 2); (2, 3, 4); (3, 5, 4); (4, 5, 6)
+        //
+        // Every triangle is looked up by its edges in winding order (b follows a) and by its vertices, so any rotation
+        // of a triangle can continue the strip.
+        std::size_t triangle_count = triangles.size();
+        auto edge_key = [](std::uint32_t a, std::uint32_t b) -> std::uint64_t {
+            return (static_cast<std::uint64_t>(a) << 32) | b;
+        };
+        
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> edge_triangles;
+        std::vector<std::vector<std::size_t>> vertex_triangles(vertex_count);
+        for(std::size_t t = 0; t < triangle_count; t++) {
+            auto &v = triangles[t].vertices;
+            for(std::size_t r = 0; r < 3; r++) {
+                edge_triangles[edge_key(v[r], v[(r + 1) % 3])].emplace_back(t);
+                vertex_triangles[v[r]].emplace_back(t);
+            }
+        }
+        
+        std::vector<bool> triangle_added(triangle_count, false);
+        
+        // Get the first triangle that wasn't added yet (they're in cache order), dropping any that were
+        auto first_unadded = [&triangle_added](std::vector<std::size_t> &candidates) -> std::optional<std::size_t> {
+            std::optional<std::size_t> best;
+            std::size_t kept = 0;
+            for(auto t : candidates) {
+                if(!triangle_added[t]) {
+                    candidates[kept++] = t;
+                    if(!best.has_value() || t < *best) {
+                        best = t;
+                    }
+                }
+            }
+            candidates.resize(kept);
+            return best;
+        };
+        
+        // Rotate the triangle so it starts with the given vertex
+        auto rotated = [&triangles](std::size_t t, std::uint32_t first) {
+            auto &v = triangles[t].vertices;
+            std::size_t r = v[0] == first ? 0 : v[1] == first ? 1 : 2;
+            return std::array<std::uint32_t, 3> { v[r], v[(r + 1) % 3], v[(r + 2) % 3] };
+        };
+        
+        // Add the first triangle
+        std::vector<std::uint32_t> strip = { triangles[0].vertices[0], triangles[0].vertices[1], triangles[0].vertices[2] };
+        triangle_added[0] = true;
+        std::size_t next_unadded_triangle = 1;
+        
+        for(std::size_t added = 1; added < triangle_count; added++) {
+            bool normals_flipped = (strip.size() % 2) == 1;
+            auto a = strip[strip.size() - 2];
+            auto b = strip[strip.size() - 1];
+            
+            // Let's try to find a triangle that can simply go next with only one index
+            // Even: ABC ; BDC -> A B C D. Odd triangles are wound the other way, so look for the edge going from b to a.
+            auto edge = edge_triangles.find(normals_flipped ? edge_key(b, a) : edge_key(a, b));
+            if(edge != edge_triangles.end()) {
+                if(auto t = first_unadded(edge->second); t.has_value()) {
+                    auto v = rotated(*t, normals_flipped ? b : a);
+                    strip.emplace_back(v[2]);
+                    triangle_added[*t] = true;
+                    continue;
+                }
+            }
+            
+            // Try a triangle that uses b but requires three indices
+            // ABC ; CDE -> A B C C D E (or A B C C E D if flipped)
+            if(auto t = first_unadded(vertex_triangles[b]); t.has_value()) {
+                auto v = rotated(*t, b);
+                strip.emplace_back(b);
+                strip.emplace_back(v[normals_flipped ? 2 : 1]);
+                strip.emplace_back(v[normals_flipped ? 1 : 2]);
+                triangle_added[*t] = true;
+                continue;
+            }
+            
+            // Last resort - Guarantees we can get the triangle in place but requires five indices
+            // ABC; DEF -> A B C C D D E F (or A B C C D D F E if flipped)
+            while(triangle_added[next_unadded_triangle]) {
+                next_unadded_triangle++;
+            }
+            auto &v = triangles[next_unadded_triangle].vertices;
+            triangle_added[next_unadded_triangle] = true;
+            strip.emplace_back(b);
+            strip.emplace_back(v[0]);
+            strip.emplace_back(v[0]);
+            strip.emplace_back(v[normals_flipped ? 2 : 1]);
+            strip.emplace_back(v[normals_flipped ? 1 : 2]);
+        }
+        
+        return strip;
+    }
+    
+    std::vector<std::uint32_t> optimize_vertex_fetch(std::vector<std::uint32_t> &strip, std::size_t vertex_count) {
+        static constexpr std::uint32_t UNUSED = std::numeric_limits<std::uint32_t>::max();
+        std::vector<std::uint32_t> remap(vertex_count, UNUSED);
+        std::uint32_t next_index = 0;
+        for(auto &i : strip) {
+            if(remap[i] == UNUSED) {
+                remap[i] = next_index++;
+            }
+            i = remap[i];
+        }
+        
+        // Anything the strip doesn't use goes at the end
+        for(auto &r : remap) {
+            if(r == UNUSED) {
+                r = next_index++;
+            }
+        }
+        
+        return remap;
+    }
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef INVADER__MODEL__MESH_OPTIMIZE_HPP
+#define INVADER__MODEL__MESH_OPTIMIZE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <invader/model/jms.hpp>
+
+namespace Invader::Model {
+    /**
+     * Reorder triangles so vertices are reused while they're still in the post-transform vertex cache (Forsyth's
+     * linear-speed vertex cache optimization). Winding is not changed.
+     * @param triangles    triangles to reorder
+     * @param vertex_count number of vertices the triangles index
+     */
+    void optimize_vertex_cache(std::vector<JMS::Triangle> &triangles, std::size_t vertex_count);
+    
+    /**
+     * Make a triangle strip from the triangles, joining separate strips with degenerate triangles.
+     * Triangles are added in order when the strip can't be continued, so optimize_vertex_cache() should be called first.
+     * @param triangles    triangles to strip; there must be at least one
+     * @param vertex_count number of vertices the triangles index
+     * @return             strip indices
+     */
+    std::vector<std::uint32_t> make_triangle_strip(const std::vector<JMS::Triangle> &triangles, std::size_t vertex_count);
+    
+    /**
+     * Renumber vertices in the order the strip first uses them so vertices are fetched sequentially
+     * @param strip        strip to renumber
+     * @param vertex_count number of vertices the strip indexes
+     * @return             new index of each vertex
+     */
+    std::vector<std::uint32_t> optimize_vertex_fetch(std::vector<std::uint32_t> &strip, std::size_t vertex_count);
+    
+    /**
+     * Make a lower detail version of the mesh by collapsing the edges that change its shape the least (Garland and
+     * Heckbert's quadric error metrics). Vertices on UV or normal seams, on the edges of the mesh, and between regions
+     * or shaders are never moved, so it may not be possible to get down to the target.
+     * @param jms                   mesh to simplify
+     * @param target_triangle_count number of triangles to stop at
+     * @return                      simplified mesh
+     */
+    JMS simplify_mesh(const JMS &jms, std::size_t target_triangle_count);
+}
+
+#endif
@@ -0,0 +1,337 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <queue>
+
+#include "mesh_optimize.hpp"
+
+namespace Invader::Model {
+    // Don't collapse an edge if it turns a triangle more than this (as the cosine of the angle), since it folds the mesh
+    static constexpr double MINIMUM_NORMAL_DOT = 0.2;
+
+    using Vector = std::array<double, 3>;
+
+    static Vector subtract(const Vector &a, const Vector &b) noexcept {
+        return { a[0] - b[0], a[1] - b[1], a[2] - b[2] };
+    }
+
+    static Vector cross(const Vector &a, const Vector &b) noexcept {
+        return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    }
+
+    static double dot(const Vector &a, const Vector &b) noexcept {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    // Sum of squared distances from a set of planes, stored as the upper half of a symmetric 4x4 matrix
+    struct Quadric {
+        double m[10] = {};
+
+        void add_plane(const Vector &normal, double distance, double weight) noexcept {
+            double plane[4] = { normal[0], normal[1], normal[2], distance };
+            std::size_t i = 0;
+            for(std::size_t r = 0; r < 4; r++) {
+                for(std::size_t c = r; c < 4; c++) {
+                    this->m[i++] += plane[r] * plane[c] * weight;
+                }
+            }
+        }
+
+        Quadric &operator +=(const Quadric &other) noexcept {
+            for(std::size_t i = 0; i < sizeof(this->m) / sizeof(*this->m); i++) {
+                this->m[i] += other.m[i];
+            }
+            return *this;
+        }
+
+        double error(const Vector &p) const noexcept {
+            double point[4] = { p[0], p[1], p[2], 1.0 };
+            double error = 0.0;
+            std::size_t i = 0;
+            for(std::size_t r = 0; r < 4; r++) {
+                for(std::size_t c = r; c < 4; c++) {
+                    error += this->m[i++] * point[r] * point[c] * (r == c ? 1.0 : 2.0);
+                }
+            }
+            return error;
+        }
+    };
+
+    // Moving every triangle on one position onto a neighboring position
+    struct Collapse {
+        double error;
+        std::uint32_t from;
+        std::uint32_t to;
+        std::uint32_t to_vertex;
+        std::uint32_t version;
+
+        bool operator >(const Collapse &other) const noexcept {
+            return this->error > other.error;
+        }
+    };
+
+    JMS simplify_mesh(const JMS &jms, std::size_t target_triangle_count) {
+        std::size_t triangle_count = jms.triangles.size();
+        if(triangle_count <= target_triangle_count) {
+            return jms;
+        }
+
+        // Vertices that only differ by normal, UV, or weights are at the same position, so weld them by position
+        std::vector<std::uint32_t> vertex_position(jms.vertices.size());
+        std::vector<Vector> positions;
+        std::map<std::array<float, 3>, std::uint32_t> position_lookup;
+        for(std::size_t v = 0; v < jms.vertices.size(); v++) {
+            auto &position = jms.vertices[v].position;
+            std::array<float, 3> key = { position.x, position.y, position.z };
+            auto [iterator, added] = position_lookup.emplace(key, static_cast<std::uint32_t>(positions.size()));
+            if(added) {
+                positions.push_back({ key[0], key[1], key[2] });
+            }
+            vertex_position[v] = iterator->second;
+        }
+        std::size_t position_count = positions.size();
+
+        auto triangles = jms.triangles;
+        std::vector<bool> triangle_alive(triangle_count, true);
+        std::vector<std::vector<std::uint32_t>> position_triangles(position_count);
+        std::vector<Quadric> quadrics(position_count);
+
+        auto corner_position = [&triangles, &vertex_position](std::uint32_t t, std::size_t corner) {
+            return vertex_position[triangles[t].vertices[corner]];
+        };
+        auto triangle_normal = [](const Vector &a, const Vector &b, const Vector &c) {
+            return cross(subtract(b, a), subtract(c, a));
+        };
+
+        // Each position starts with the planes of the triangles around it, weighted by area
+        for(std::uint32_t t = 0; t < triangle_count; t++) {
+            for(std::size_t c = 0; c < 3; c++) {
+                position_triangles[corner_position(t, c)].emplace_back(t);
+            }
+            auto normal = triangle_normal(positions[corner_position(t, 0)], positions[corner_position(t, 1)], positions[corner_position(t, 2)]);
+            double length = std::sqrt(dot(normal, normal));
+            if(length <= 0.0) {
+                continue;
+            }
+            Vector unit = { normal[0] / length, normal[1] / length, normal[2] / length };
+            double distance = -dot(unit, positions[corner_position(t, 0)]);
+            for(std::size_t c = 0; c < 3; c++) {
+                quadrics[corner_position(t, c)].add_plane(unit, distance, length * 0.5);
+            }
+        }
+
+        auto alive_triangles = [&position_triangles, &triangle_alive](std::uint32_t position) -> const std::vector<std::uint32_t> & {
+            auto &list = position_triangles[position];
+            std::erase_if(list, [&triangle_alive](std::uint32_t t) { return !triangle_alive[t]; });
+            return list;
+        };
+        auto find_corner = [&corner_position](std::uint32_t t, std::uint32_t position) -> std::optional<std::size_t> {
+            for(std::size_t c = 0; c < 3; c++) {
+                if(corner_position(t, c) == position) {
+                    return c;
+                }
+            }
+            return std::nullopt;
+        };
+        auto neighbors_of = [&alive_triangles, &corner_position](std::uint32_t position) {
+            std::vector<std::uint32_t> neighbors;
+            for(auto t : alive_triangles(position)) {
+                for(std::size_t c = 0; c < 3; c++) {
+                    auto p = corner_position(t, c);
+                    if(p != position && std::find(neighbors.begin(), neighbors.end(), p) == neighbors.end()) {
+                        neighbors.emplace_back(p);
+                    }
+                }
+            }
+            return neighbors;
+        };
+
+        // Find the cheapest edge to collapse this position along, if it can be moved at all
+        auto find_collapse = [&](std::uint32_t from) -> std::optional<Collapse> {
+            auto &around = alive_triangles(from);
+            if(around.empty()) {
+                return std::nullopt;
+            }
+
+            // Only move positions with one vertex that are inside of one region and shader
+            auto &first = triangles[around[0]];
+            auto from_vertex = first.vertices[*find_corner(around[0], from)];
+            for(auto t : around) {
+                auto &triangle = triangles[t];
+                if(triangle.vertices[*find_corner(t, from)] != from_vertex || triangle.region != first.region || triangle.shader != first.shader) {
+                    return std::nullopt;
+                }
+            }
+
+            // Every edge has to be shared by exactly two triangles, or it's on the edge of the mesh
+            std::vector<std::pair<std::uint32_t, std::size_t>> neighbors;
+            for(auto t : around) {
+                for(std::size_t c = 0; c < 3; c++) {
+                    auto p = corner_position(t, c);
+                    if(p == from) {
+                        continue;
+                    }
+                    auto n = std::find_if(neighbors.begin(), neighbors.end(), [&p](auto &neighbor) { return neighbor.first == p; });
+                    if(n == neighbors.end()) {
+                        neighbors.emplace_back(p, 1);
+                    }
+                    else {
+                        n->second++;
+                    }
+                }
+            }
+            for(auto &n : neighbors) {
+                if(n.second != 2) {
+                    return std::nullopt;
+                }
+            }
+
+            std::optional<Collapse> best;
+            for(auto &[to, count] : neighbors) {
+                // The two triangles on the edge have to use the same vertex for where it's going
+                std::optional<std::uint32_t> to_vertex;
+                bool seam = false;
+                for(auto t : around) {
+                    auto corner = find_corner(t, to);
+                    if(!corner.has_value()) {
+                        continue;
+                    }
+                    auto vertex = triangles[t].vertices[*corner];
+                    if(to_vertex.has_value() && *to_vertex != vertex) {
+                        seam = true;
+                    }
+                    to_vertex = vertex;
+                }
+                if(seam) {
+                    continue;
+                }
+
+                // Only the two positions across the edge can be next to both, or the collapse pinches the mesh
+                std::size_t shared_neighbors = 0;
+                for(auto p : neighbors_of(to)) {
+                    if(std::find_if(neighbors.begin(), neighbors.end(), [&p](auto &neighbor) { return neighbor.first == p; }) != neighbors.end()) {
+                        shared_neighbors++;
+                    }
+                }
+                if(shared_neighbors != 2) {
+                    continue;
+                }
+
+                // Don't fold any triangles over
+                bool folds = false;
+                for(auto t : around) {
+                    if(find_corner(t, to).has_value()) {
+                        continue;
+                    }
+                    Vector before[3], after[3];
+                    for(std::size_t c = 0; c < 3; c++) {
+                        auto p = corner_position(t, c);
+                        before[c] = positions[p];
+                        after[c] = positions[p == from ? to : p];
+                    }
+                    auto normal_before = triangle_normal(before[0], before[1], before[2]);
+                    auto normal_after = triangle_normal(after[0], after[1], after[2]);
+                    double length = std::sqrt(dot(normal_before, normal_before) * dot(normal_after, normal_after));
+                    if(length <= 0.0 || dot(normal_before, normal_after) < length * MINIMUM_NORMAL_DOT) {
+                        folds = true;
+                        break;
+                    }
+                }
+                if(folds) {
+                    continue;
+                }
+
+                auto quadric = quadrics[from];
+                quadric += quadrics[to];
+                double error = quadric.error(positions[to]);
+                if(!best.has_value() || error < best->error) {
+                    best = Collapse { error, from, to, *to_vertex, 0 };
+                }
+            }
+
+            return best;
+        };
+
+        // Collapse the cheapest edges first
+        std::vector<std::uint32_t> versions(position_count, 0);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        for(std::uint32_t p = 0; p < position_count; p++) {
+            if(auto collapse = find_collapse(p)) {
+                queue.push(*collapse);
+            }
+        }
+
+        std::size_t remaining_triangles = triangle_count;
+        while(remaining_triangles > target_triangle_count && !queue.empty()) {
+            auto queued = queue.top();
+            queue.pop();
+            if(queued.version != versions[queued.from]) {
+                continue;
+            }
+
+            // Anything around it may have changed, so if it got more expensive, try again later
+            auto collapse = find_collapse(queued.from);
+            if(!collapse.has_value()) {
+                continue;
+            }
+            if(collapse->error > queued.error) {
+                collapse->version = versions[queued.from];
+                queue.push(*collapse);
+                continue;
+            }
+
+            auto from = collapse->from;
+            auto to = collapse->to;
+            for(auto t : alive_triangles(from)) {
+                if(find_corner(t, to).has_value()) {
+                    triangle_alive[t] = false;
+                    remaining_triangles--;
+                }
+                else {
+                    triangles[t].vertices[*find_corner(t, from)] = collapse->to_vertex;
+                    position_triangles[to].emplace_back(t);
+                }
+            }
+            position_triangles[from].clear();
+            quadrics[to] += quadrics[from];
+            versions[from]++;
+
+            // Everything around it can now collapse differently
+            auto affected = neighbors_of(to);
+            affected.emplace_back(to);
+            for(auto p : affected) {
+                versions[p]++;
+                if(auto next = find_collapse(p)) {
+                    next->version = versions[p];
+                    queue.push(*next);
+                }
+            }
+        }
+
+        // Keep only the vertices that are still used
+        JMS simplified = jms;
+        simplified.vertices.clear();
+        simplified.triangles.clear();
+        std::vector<std::uint32_t> vertex_remap(jms.vertices.size(), UINT32_MAX);
+        for(std::size_t t = 0; t < triangle_count; t++) {
+            if(!triangle_alive[t]) {
+                continue;
+            }
+            auto &triangle = simplified.triangles.emplace_back(triangles[t]);
+            for(auto &v : triangle.vertices) {
+                if(vertex_remap[v] == UINT32_MAX) {
+                    vertex_remap[v] = static_cast<std::uint32_t>(simplified.vertices.size());
+                    simplified.vertices.emplace_back(jms.vertices[v]);
+                }
+                v = vertex_remap[v];
+            }
+        }
+
+        return simplified;
+    }
+}
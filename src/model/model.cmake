@@ -7,6 +7,8 @@ endif()
 if(${INVADER_MODEL})
     add_executable(invader-model
         src/model/model.cpp
+        src/model/mesh_optimize.cpp
+        src/model/mesh_simplify.cpp
     )
 
     target_link_libraries(invader-model invader ${INVADER_CRT_NOGLOB})
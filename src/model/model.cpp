@@ -1,18 +1,22 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <array>
 #include <vector>
 #include <cstring>
+#include <set>
 #include <regex>
-#include <list>
 #include <cmath>
 
 #include <invader/version.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include "../command_line_option.hpp"
 #include <invader/model/jms.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/tag/parser/compile/model.hpp>
+#include "mesh_optimize.hpp"
 
 enum ModelType {
     MODEL_TYPE_MODEL = 0,
@@ -24,7 +28,10 @@ const char *MODEL_EXTENSIONS[] = {
     ".gbxmodel"
 };
 
-template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> make_model_tag(const std::filesystem::path &path, const std::vector<std::filesystem::path> &tags, const Invader::JMSMap &map) {
+// Fraction of the highest LoD's triangles to keep for each lower LoD (high, medium, low, super low) when generating them
+using LoDBudgets = std::array<float, 4>;
+
+template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> make_model_tag(const std::filesystem::path &path, const std::vector<std::filesystem::path> &tags, const Invader::JMSMap &map, const std::optional<LoDBudgets> &lod_budgets) {
     using namespace Invader;
     
     // Load the tag if possible
@@ -379,6 +386,42 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
         }
     }
     
+    // Generate any LoDs that weren't made by simplifying the next higher one
+    std::set<std::pair<std::string, LoD>> generated_lods;
+    if(lod_budgets.has_value()) {
+        for(auto &p : permutations) {
+            auto &lod_map = p.second;
+            auto top_lod = lod_map.begin()->first;
+            auto top_triangle_count = lod_map.begin()->second.triangles.size();
+            for(auto lod = static_cast<LoD>(top_lod + 1); lod < LoD::LOD_END; lod = static_cast<LoD>(lod + 1)) {
+                if(lod_map.find(lod) != lod_map.end()) {
+                    continue;
+                }
+                
+                auto &higher = std::prev(lod_map.lower_bound(lod))->second;
+                auto target = static_cast<std::size_t>(top_triangle_count * (*lod_budgets)[lod - 1]);
+                if(target >= higher.triangles.size()) {
+                    continue;
+                }
+                
+                auto simplified = Model::simplify_mesh(higher, target);
+                if(simplified.triangles.size() < higher.triangles.size()) {
+                    lod_map.emplace(lod, std::move(simplified));
+                    generated_lods.emplace(p.first, lod);
+                }
+            }
+        }
+        
+        // The LoDs won't be used without cutoffs, so set some if there aren't any
+        if(!generated_lods.empty() && model_tag->super_low_detail_cutoff == 0.0F && model_tag->low_detail_cutoff == 0.0F && model_tag->medium_detail_cutoff == 0.0F && model_tag->high_detail_cutoff == 0.0F && model_tag->super_high_detail_cutoff == 0.0F) {
+            model_tag->super_high_detail_cutoff = 300.0F;
+            model_tag->high_detail_cutoff = 150.0F;
+            model_tag->medium_detail_cutoff = 80.0F;
+            model_tag->low_detail_cutoff = 40.0F;
+            model_tag->super_low_detail_cutoff = 15.0F;
+            oprintf("Set default LoD cutoffs for the generated LoDs\n");
+        }
+    }
     
     // List permutations
     auto permutation_count = permutations.size();
@@ -394,7 +437,7 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
             if(add_comma) {
                 oprintf(", ");
             }
-            oprintf("%s", lods[i.first]);
+            oprintf("%s%s", lods[i.first], generated_lods.find(std::pair(p.first, i.first)) != generated_lods.end() ? " (generated)" : "");
             add_comma = true;
             
             verts += i.second.vertices.size();
@@ -676,99 +719,17 @@ template <typename T, Invader::HEK::TagFourCC fourcc> std::vector<std::byte> mak
                         v.tangent = v.tangent.normalize();
                     }
                     
-                    // Now let's... do this horrible monstrosity, triangle strips!
-                    //
-                    // Basically, triangles in Halo are stored like this:
-                    //
-                    // A B C D          A          B          C          D
-                    // 0 1 2 3 4 5 6 = (0, 1, 2); (1, 3, 2); (2, 3, 4); (3, 5, 4); (4, 5, 6)
-                    //
-                    // It can save lots of space, but only if everything is nicely sequenced like this.
-                    // If not, you can lose space by having to add degenerate triangles.
-                    // On average, it saves a decent amount of space... as far as 16-bit integers go at least.
-                    
-                    // Add the first triangle
-                    std::vector<std::uint32_t> triangle_man = { all_triangles_here[0].vertices[0], all_triangles_here[0].vertices[1], all_triangles_here[0].vertices[2] };
+                    // Reorder the triangles for the vertex cache, then make them into triangle strips
+                    Model::optimize_vertex_cache(all_triangles_here, all_vertices_here.size());
+                    auto triangle_man = Model::make_triangle_strip(all_triangles_here, all_vertices_here.size());
                     
-                    // Our remaining triangles
-                    std::list<JMS::Triangle> remaining_triangles = std::list<JMS::Triangle>(all_triangles_here.begin() + 1, all_triangles_here.end());
-                    
-                    // Add the rest
-                    while(remaining_triangles.size() > 0) {
-                        bool normals_flipped = (triangle_man.size() % 2) == 1;
-                        
-                        HEK::Index current_triangle[3] = {};
-                        auto a_index = 0;
-                        
-                        auto b_index = normals_flipped ? 2 : 1;
-                        auto c_index = normals_flipped ? 1 : 2;
-                        
-                        auto a_index_next = a_index;
-                        auto b_index_next = c_index;
-                        auto c_index_next = b_index;
-                        
-                        auto &a = current_triangle[a_index];
-                        auto &b = current_triangle[b_index];
-                        
-                        a = triangle_man[triangle_man.size() - 2];
-                        b = triangle_man[triangle_man.size() - 1];
-                        
-                        // Let's try to find a triangle that can simply go next with only one index
-                        bool triangle_found = false;
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; BDC -> A B C D
-                            if(rt->vertices[a_index] == a && rt->vertices[b_index] == b) {
-                                triangle_found = true;
-                                triangle_man.emplace_back(rt->vertices[c_index]);
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Try a triangle that can go next but requires two indices
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; CBD -> A B C B D
-                            if(rt->vertices[a_index_next] == b && rt->vertices[b_index_next] == a) {
-                                triangle_man.emplace_back(rt->vertices[b_index_next]);
-                                triangle_man.emplace_back(rt->vertices[c_index_next]);
-                                triangle_found = true;
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Try a triangle that can go next but requires three indices
-                        for(auto rt = remaining_triangles.begin(); rt != remaining_triangles.end(); rt++) {
-                            // ABC ; CDE -> A B C C E D
-                            if(rt->vertices[a_index] == b) {
-                                triangle_man.emplace_back(b);
-                                triangle_man.emplace_back(rt->vertices[b_index]);
-                                triangle_man.emplace_back(rt->vertices[c_index]);
-                                triangle_found = true;
-                                remaining_triangles.erase(rt);
-                                break;
-                            }
-                        }
-                        if(triangle_found) {
-                            continue;
-                        }
-                        
-                        // Last resort - Guarantees we can get the triangle in place but requires five indices
-                        // ABC; DEF -> A B C C D D F E
-                        triangle_man.emplace_back(b);
-                        auto first_triangle = *remaining_triangles.begin();
-                        remaining_triangles.erase(remaining_triangles.begin());
-                        triangle_man.emplace_back(first_triangle.vertices[a_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[a_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[b_index]);
-                        triangle_man.emplace_back(first_triangle.vertices[c_index]);
+                    // Renumber the vertices in the order the strip uses them
+                    auto vertex_remap = Model::optimize_vertex_fetch(triangle_man, part.uncompressed_vertices.size());
+                    auto reordered_vertices = part.uncompressed_vertices;
+                    for(std::size_t v = 0; v < vertex_remap.size(); v++) {
+                        reordered_vertices[vertex_remap[v]] = std::move(part.uncompressed_vertices[v]);
                     }
+                    part.uncompressed_vertices = std::move(reordered_vertices);
                     
                     // Add triangle count
                     if(triangle_man.size() > 2) {
@@ -1017,6 +978,8 @@ int main(int argc, const char **argv) {
         std::vector<std::filesystem::path> tags;
         std::filesystem::path data = "data";
         bool filesystem_path = false;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
+        std::optional<LoDBudgets> lod_budgets;
     } model_options;
 
     const CommandLineOption options[] {
@@ -1025,6 +988,8 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS_MULTIPLE),
         CommandLineOption("type", 'T', 1, "Specify the type of model. Can be: model, gbxmodel", "<type>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("generate-lods", 'l', 1, "Generate each permutation's missing LoDs by simplifying the next higher LoD. Give the fraction of the highest LoD's triangles to keep for the high, medium, low, and super low LoDs, separated by commas (e.g. 0.5,0.25,0.12,0.06). Default LoD cutoffs are set if the tag doesn't have any.", "<list>"),
     };
 
     static constexpr char DESCRIPTION[] = "Compile a model tag.";
@@ -1056,6 +1021,25 @@ int main(int argc, const char **argv) {
             case 't':
                 model_options.tags.emplace_back(args[0]);
                 break;
+            case 'l': {
+                LoDBudgets budgets;
+                const char *budget = args[0];
+                for(std::size_t b = 0; b < budgets.size(); b++) {
+                    char *end = nullptr;
+                    budgets[b] = std::strtof(budget, &end);
+                    bool last = b + 1 == budgets.size();
+                    if(end == budget || *end != (last ? '\0' : ',') || !(budgets[b] > 0.0F && budgets[b] <= 1.0F)) {
+                        eprintf_error("Invalid LoD fractions %s", args[0]);
+                        std::exit(EXIT_FAILURE);
+                    }
+                    budget = end + 1;
+                }
+                model_options.lod_budgets = budgets;
+                break;
+            }
+            case 'j':
+                model_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
         }
     });
     
@@ -1063,6 +1047,9 @@ int main(int argc, const char **argv) {
         model_options.tags.emplace_back("tags");
     }
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(model_options.thread_count);
+    
     // Do this
     if(!model_options.type.has_value()) {
         eprintf_error("No type specified. Use -h for more information.");
@@ -1126,7 +1113,7 @@ int main(int argc, const char **argv) {
             }
             if(extension == ".jms" && i.is_regular_file()) {
                 try {
-                    auto file = File::open_file(path);
+                    auto file = File::MemoryMappedFile::map_file(path);
                     if(!file.has_value()) {
                         eprintf_error("Failed to read %s", path.string().c_str());
                         return EXIT_FAILURE;
@@ -1139,7 +1126,7 @@ int main(int argc, const char **argv) {
                     }
                     
                     // Add it
-                    jms_files.emplace(model_name, JMS::from_string(std::string(reinterpret_cast<const char *>(file->data()), file->size()).c_str()));
+                    jms_files.emplace(model_name, JMS::from_data(reinterpret_cast<const char *>(file->data()), file->size(), model_options.thread_count));
                 }
                 catch(std::exception &e) {
                     eprintf_error("Failed to parse %s: %s", path.string().c_str(), e.what());
@@ -1165,10 +1152,10 @@ int main(int argc, const char **argv) {
     
     switch(*model_options.type) {
         case ModelType::MODEL_TYPE_MODEL:
-            tag_data = make_model_tag<Parser::Model, TagFourCC::TAG_FOURCC_MODEL>(file_path, model_options.tags, jms_files);
+            tag_data = make_model_tag<Parser::Model, TagFourCC::TAG_FOURCC_MODEL>(file_path, model_options.tags, jms_files, model_options.lod_budgets);
             break;
         case ModelType::MODEL_TYPE_GBXMODEL:
-            tag_data = make_model_tag<Parser::GBXModel, TagFourCC::TAG_FOURCC_GBXMODEL>(file_path, model_options.tags, jms_files);
+            tag_data = make_model_tag<Parser::GBXModel, TagFourCC::TAG_FOURCC_GBXMODEL>(file_path, model_options.tags, jms_files, model_options.lod_budgets);
             break;
         default:
             std::terminate();
@@ -0,0 +1,17 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+if(NOT DEFINED ${INVADER_PATCH})
+    set(INVADER_PATCH true CACHE BOOL "Build invader-patch (makes and applies patches between builds of a map)")
+endif()
+
+if(${INVADER_PATCH})
+    add_executable(invader-patch
+        src/patch/patch.cpp
+    )
+
+    target_link_libraries(invader-patch invader ${INVADER_CRT_NOGLOB})
+
+    set(TARGETS_LIST ${TARGETS_LIST} invader-patch)
+
+    do_windows_rc(invader-patch invader-patch.exe "Invader map patching tool")
+endif()
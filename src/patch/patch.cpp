@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <filesystem>
+#include <optional>
+#include "../command_line_option.hpp"
+#include <invader/file/file.hpp>
+#include <invader/map/patch.hpp>
+#include <invader/printf.hpp>
+#include <invader/version.hpp>
+
+#define BYTES_TO_MiB(bytes) (bytes / 1024.0 / 1024.0)
+
+int main(int argc, const char **argv) {
+    set_up_color_term();
+
+    using namespace Invader;
+
+    struct PatchOptions {
+        bool apply = false;
+        std::optional<std::filesystem::path> output;
+    } patch_options;
+
+    const CommandLineOption options[] = {
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO),
+        CommandLineOption("apply", 'a', 0, "Apply a patch to the old map instead of making one."),
+        CommandLineOption("output", 'o', 1, "Output to a specific file. This is required when applying a patch. Default when making a patch: the new map's path with .patch appended", "<file>")
+    };
+
+    static constexpr char DESCRIPTION[] = "Make a patch that updates a map to a newer build of it, or apply one.";
+    static constexpr char USAGE[] = "[options] <old map> <new map | patch>";
+
+    auto remaining_arguments = CommandLineOption::parse_arguments<PatchOptions &>(argc, argv, options, USAGE, DESCRIPTION, 2, 2, patch_options, [](char opt, const auto &arguments, PatchOptions &patch_options) {
+        switch(opt) {
+            case 'i':
+                show_version_info();
+                std::exit(EXIT_SUCCESS);
+            case 'a':
+                patch_options.apply = true;
+                break;
+            case 'o':
+                patch_options.output = arguments[0];
+                break;
+        }
+    });
+
+    std::filesystem::path old_map_path = remaining_arguments[0];
+    std::filesystem::path input_path = remaining_arguments[1];
+
+    if(patch_options.apply && !patch_options.output.has_value()) {
+        eprintf_error("An output path is required when applying a patch. Use -h for more information.");
+        return EXIT_FAILURE;
+    }
+
+    auto old_map = File::open_file(old_map_path);
+    if(!old_map.has_value()) {
+        eprintf_error("Failed to read %s", old_map_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+    auto input = File::open_file(input_path);
+    if(!input.has_value()) {
+        eprintf_error("Failed to read %s", input_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Apply it
+    if(patch_options.apply) {
+        std::vector<std::byte> new_map;
+        try {
+            new_map = Patch::apply_patch(old_map->data(), old_map->size(), input->data(), input->size());
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to apply %s: %s", input_path.string().c_str(), e.what());
+            return EXIT_FAILURE;
+        }
+        if(!File::save_file(*patch_options.output, new_map)) {
+            eprintf_error("Failed to write to %s", patch_options.output->string().c_str());
+            return EXIT_FAILURE;
+        }
+        oprintf_success("Patched %s (%.02f MiB)", patch_options.output->string().c_str(), BYTES_TO_MiB(new_map.size()));
+        return EXIT_SUCCESS;
+    }
+
+    // Or make it
+    if(Patch::is_patch(input->data(), input->size())) {
+        eprintf_error("%s is already a patch. Use -a to apply it.", input_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    auto output = patch_options.output.value_or(std::filesystem::path(input_path.string() + ".patch"));
+    auto patch = Patch::generate_patch(old_map->data(), old_map->size(), input->data(), input->size());
+    if(!File::save_file(output, patch)) {
+        eprintf_error("Failed to write to %s", output.string().c_str());
+        return EXIT_FAILURE;
+    }
+    oprintf_success("Made %s (%.02f MiB, %.02f %% of the new map)", output.string().c_str(), BYTES_TO_MiB(patch.size()), input->empty() ? 0.0 : 100.0 * patch.size() / input->size());
+    return EXIT_SUCCESS;
+}
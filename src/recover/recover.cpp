@@ -1,9 +1,13 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <atomic>
+#include <mutex>
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/version.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/tag/hek/header.hpp>
 #include "recover_method.hpp"
 
@@ -18,6 +22,7 @@ int main(int argc, const char **argv) {
         std::filesystem::path data = "data";
         bool overwrite = false;
         std::vector<std::string> batch, batch_exclude;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } recover_options;
 
     const CommandLineOption options[] = {
@@ -27,6 +32,7 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
         CommandLineOption("overwrite", 'O', 0, "Overwrite data if it already exists"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
     };
 
     static constexpr char DESCRIPTION[] = "Recover source data from tags.";
@@ -52,9 +58,15 @@ int main(int argc, const char **argv) {
             case 'e':
                 recover_options.batch_exclude.emplace_back(args[0]);
                 break;
+            case 'j':
+                recover_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
         }
     });
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(recover_options.thread_count);
+    
     if(!std::filesystem::is_directory(recover_options.data)) {
         eprintf_error("Data folder %s does not exist or is not a valid directory", recover_options.data.string().c_str());
         return EXIT_FAILURE;
@@ -66,42 +78,62 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
     
-    bool result = false;
+    std::atomic<bool> result = false;
     
     auto do_on_tag = [&recover_options, &result](const auto &tag) -> bool {
         // read it
         auto file_path = File::tag_path_to_file_path(tag, recover_options.tags);
-        auto file = File::open_file(file_path);
+        auto file = File::MemoryMappedFile::map_file(file_path);
         if(!file.has_value()) {
             eprintf_error("Failed to read %s", file_path.string().c_str());
             return false;
         }
         
         // Load it
-        auto tag_data = Parser::ParserStruct::parse_hek_tag_file(file->data(), file->size());
-        auto r = Recover::recover(*tag_data, std::filesystem::path(tag).replace_extension().string(), recover_options.data, reinterpret_cast<const HEK::TagFileHeader *>(file->data())->tag_fourcc, recover_options.overwrite);
-        result = r || result;
+        bool r;
+        try {
+            auto tag_data = Parser::ParserStruct::parse_hek_tag_file(file->data(), file->size());
+            r = Recover::recover(*tag_data, std::filesystem::path(tag).replace_extension().string(), recover_options.data, reinterpret_cast<const HEK::TagFileHeader *>(file->data())->tag_fourcc, recover_options.overwrite);
+        }
+        catch(std::exception &e) {
+            eprintf_error("Failed to parse %s: %s", file_path.string().c_str(), e.what());
+            return false;
+        }
+        if(r) {
+            result = true;
+        }
         return r;
     };
     
     // Let's do this
     if(uses_batching) {
-        auto virtual_tags = File::load_virtual_tag_folder({recover_options.tags});
-        std::size_t total = 0;
-        std::size_t recovered = 0;
-        for(auto &t : virtual_tags) {
-            if(File::path_matches(t.tag_path.c_str(), recover_options.batch, recover_options.batch_exclude)) {
-                total++;
-                if(!do_on_tag(t.tag_path)) {
-                    eprintf("Skipped %s\n", t.tag_path.c_str());
-                }
-                else {
-                    oprintf_success("Recovered %s", t.tag_path.c_str());
-                    recovered++;
-                }
+        std::vector<File::TagFile> batch_tags;
+        File::PathMatcher batch_matcher(recover_options.batch, recover_options.batch_exclude);
+        for(auto &t : File::load_virtual_tag_folder({recover_options.tags})) {
+            if(batch_matcher.matches(t.tag_path.c_str())) {
+                batch_tags.emplace_back(std::move(t));
             }
         }
-        oprintf("Recovered %zu of %zu tag%s\n", recovered, total, total == 1 ? "" : "s");
+        
+        // Recover the tags on multiple threads
+        std::size_t total = batch_tags.size();
+        std::atomic<std::size_t> recovered = 0;
+        std::mutex print_mutex;
+        ThreadPool::shared().parallel_for(total, [&batch_tags, &recovered, &print_mutex, &do_on_tag](std::size_t i) {
+            auto &t = batch_tags[i];
+            bool r = do_on_tag(t.tag_path);
+            std::scoped_lock lock(print_mutex);
+            if(!r) {
+                eprintf("Skipped %s\n", t.tag_path.c_str());
+            }
+            else {
+                oprintf_success("Recovered %s", t.tag_path.c_str());
+                recovered++;
+            }
+        }, recover_options.thread_count);
+        
+        std::size_t recovered_count = recovered;
+        oprintf("Recovered %zu of %zu tag%s\n", recovered_count, total, total == 1 ? "" : "s");
     }
     else {
         do_on_tag(File::halo_path_to_preferred_path(remaining_arguments[0]));
@@ -13,7 +13,7 @@
 namespace Invader::Recover {
     static void create_directories_for_path(const std::filesystem::path &path) {
         std::error_code ec;
-        std::filesystem::create_directories(path.parent_path());
+        std::filesystem::create_directories(path.parent_path(), ec);
     }
 
     static bool create_directories_save_and_quit(const std::filesystem::path &path, const std::vector<std::byte> &data) {
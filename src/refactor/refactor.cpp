@@ -4,22 +4,60 @@
 #include <string>
 #include <filesystem>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
 #include "../command_line_option.hpp"
 #include <invader/tag/parser/parser.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <invader/dependency/dependency_index.hpp>
+#include <algorithm>
+#include <atomic>
 
 using namespace Invader;
 using namespace Invader::File;
 
-std::size_t refactor_tags(const std::filesystem::path &file_path, const std::vector<std::pair<TagFilePath, TagFilePath>> &replacements, bool check_only, bool dry_run) {
+// Returns true if the tag references anything being replaced, reading only its references
+static bool tag_references_replacements(const std::filesystem::path &file_path, const std::vector<std::pair<TagFilePath, TagFilePath>> &replacements) {
+    auto tag = MemoryMappedFile::map_file(file_path);
+    if(!tag.has_value()) {
+        eprintf_error("Failed to open %s", file_path.string().c_str());
+        throw std::exception();
+    }
+
+    bool referenced = false;
+    try {
+        HEK::TagFileHeader::validate_header(reinterpret_cast<const HEK::TagFileHeader *>(tag->data()), tag->size());
+        Parser::ParserStruct::scan_hek_tag_file_dependencies(tag->data(), tag->size(), [&referenced, &replacements](TagFourCC tag_fourcc, const char *path, std::size_t) {
+            if(referenced) {
+                return;
+            }
+            auto path_str = remove_duplicate_slashes(path);
+            for(auto &r : replacements) {
+                if(r.first.fourcc == tag_fourcc && r.first.path == path_str) {
+                    referenced = true;
+                    return;
+                }
+            }
+        });
+    }
+    catch(std::exception &e) {
+        eprintf_error("Error: Failed to refactor in %s", file_path.string().c_str());
+        throw;
+    }
+
+    return referenced;
+}
+
+// Replace the references in the tag, returning the number of references replaced (if check_only, nothing is written)
+static std::size_t refactor_tag(const std::filesystem::path &file_path, const std::vector<std::pair<TagFilePath, TagFilePath>> &replacements, bool check_only, bool dry_run) {
     // Open the tag
-    auto tag = open_file(file_path);
+    auto tag = MemoryMappedFile::map_file(file_path);
     if(!tag.has_value()) {
         eprintf_error("Failed to open %s", file_path.string().c_str());
-        std::exit(EXIT_FAILURE);
+        throw std::exception();
     }
 
     // Get the header
@@ -41,9 +79,12 @@ std::size_t refactor_tags(const std::filesystem::path &file_path, const std::vec
     }
     catch(std::exception &e) {
         eprintf_error("Error: Failed to refactor in %s", file_path.string().c_str());
-        std::exit(EXIT_FAILURE);
+        throw;
     }
 
+    // Unmap it first, since it can't be overwritten while it's mapped on Windows
+    tag.reset();
+
     if(!check_only) {
         if(!dry_run && !save_file(file_path, file_data)) {
             eprintf_error("Error: Failed to write to %s. This tag will need to be manually edited.", file_path.string().c_str());
@@ -55,6 +96,17 @@ std::size_t refactor_tags(const std::filesystem::path &file_path, const std::vec
     return count;
 }
 
+// Call function(i) for i in [0, count) on up to thread_count threads, returning false if any call threw
+template <typename F> static bool for_each_tag(std::size_t count, std::size_t thread_count, F function) {
+    try {
+        ThreadPool::shared().parallel_for(count, function, thread_count);
+    }
+    catch(std::exception &) {
+        return false;
+    }
+    return true;
+}
+
 enum RefactorMode {
     REFACTOR_MODE_COPY,
     REFACTOR_MODE_MOVE,
@@ -76,7 +128,9 @@ int main(int argc, char * const *argv) {
         CommandLineOption("tag", 'T', 2, "Refactor an individual tag. This can be specified multiple times but cannot be used with --recursive.", "<f> <t>"),
         CommandLineOption("groups", 'g', 2, "Refactor all tags of a given group to another group. All tags in the destination group must exist. This can be specified multiple times but cannot be used with --recursive or -M move.", "<f> <t>"),
         CommandLineOption("single-tag", 's', 1, "Make changes to a single tag, only, rather than the whole tags directory.", "<path>"),
-        CommandLineOption("replace-string", 'R', 2, "Replaces all instances in a path of <a> with <b>. This can be used multiple times for multiple replacements. If --groups or --recursive are used, this applies to the output of those. Otherwise, it applies to all tags.", "<a> <b>")
+        CommandLineOption("replace-string", 'R', 2, "Replaces all instances in a path of <a> with <b>. This can be used multiple times for multiple replacements. If --groups or --recursive are used, this applies to the output of those. Otherwise, it applies to all tags.", "<a> <b>"),
+        CommandLineOption("index", 'I', 1, "Use (and update) an index of every tag's references in the given file, as kept by invader-dependency --index, so tags that don't reference anything being replaced don't need to be read.", "<file>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Find and replace tag references.";
@@ -88,6 +142,8 @@ int main(int argc, char * const *argv) {
         std::optional<RefactorMode> mode;
         const char *single_tag = nullptr;
         bool unsafe = false;
+        std::optional<std::filesystem::path> index;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
 
         std::vector<std::pair<std::string, std::string>> string_replacements;
         std::vector<std::pair<TagFilePath, TagFilePath>> replacements;
@@ -153,12 +209,21 @@ int main(int argc, char * const *argv) {
             case 's':
                 refactor_options.single_tag = arguments[0];
                 return;
+            case 'I':
+                refactor_options.index = arguments[0];
+                return;
+            case 'j':
+                refactor_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                return;
             case 'R':
                 refactor_options.string_replacements.emplace_back(File::preferred_path_to_halo_path(arguments[0]), File::preferred_path_to_halo_path(arguments[1]));
                 return;
         }
     });
 
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(refactor_options.thread_count);
+
     auto &replacements = refactor_options.replacements;
     auto &group_replacements = refactor_options.group_replacements;
     
@@ -476,10 +541,46 @@ int main(int argc, char * const *argv) {
         all_tags = load_virtual_tag_folder(refactor_options.tags);
     }
 
-    // Go through all the tags and see what needs edited
-    std::size_t total_tags = 0;
-    std::size_t total_replaced = 0;
-    std::vector<TagFile *> tags_to_do;
+    // Bring the index up to date if we're using one
+    std::optional<DependencyIndex> dependency_index;
+    if(refactor_options.index.has_value()) {
+        dependency_index = DependencyIndex::load(*refactor_options.index);
+        dependency_index->update(refactor_options.tags);
+        if(!dependency_index->save(*refactor_options.index)) {
+            eprintf_warn("Warning: Failed to save the index to %s", refactor_options.index->string().c_str());
+        }
+    }
+
+    // Check if the index knows the tag doesn't reference anything being replaced
+    auto index_rules_out = [&dependency_index, &replacements](const TagFile &tag) -> bool {
+        if(!dependency_index.has_value()) {
+            return false;
+        }
+
+        auto tag_path = File::split_tag_class_extension(File::preferred_path_to_halo_path(tag.tag_path));
+        const auto *entry = tag_path.has_value() ? dependency_index->find_tag(*tag_path) : nullptr;
+        if(entry == nullptr || entry->full_path != tag.full_path) {
+            return false;
+        }
+
+        // Make sure it wasn't changed (e.g. copied over) since the index was updated
+        std::error_code ec;
+        if(std::filesystem::file_size(tag.full_path, ec) != entry->size || ec || std::filesystem::last_write_time(tag.full_path, ec).time_since_epoch().count() != entry->modification_time || ec) {
+            return false;
+        }
+
+        for(auto &dependency : entry->dependencies) {
+            for(auto &r : replacements) {
+                if(r.first == dependency) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // Go through all the tags and see what could need edited
+    std::vector<TagFile *> candidate_tags;
 
     for(auto &tag : *tag_to_modify) {
         bool skip = false;
@@ -519,21 +620,47 @@ int main(int argc, char * const *argv) {
                 break;
         }
         
-        if(!skip && refactor_tags(tag.full_path.string().c_str(), replacements, true, refactor_options.dry_run)) {
-            tags_to_do.emplace_back(&tag);
+        if(!skip && !index_rules_out(tag)) {
+            candidate_tags.emplace_back(&tag);
+        }
+    }
+
+    // Scan the references of each tag (without parsing) to find the ones that reference anything being replaced
+    std::vector<char> referenced(candidate_tags.size());
+    if(!for_each_tag(candidate_tags.size(), refactor_options.thread_count, [&candidate_tags, &referenced, &replacements](std::size_t i) {
+        referenced[i] = tag_references_replacements(candidate_tags[i]->full_path, replacements);
+    })) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TagFile *> tags_to_do;
+    for(std::size_t i = 0; i < candidate_tags.size(); i++) {
+        if(referenced[i]) {
+            tags_to_do.emplace_back(candidate_tags[i]);
         }
     }
 
-    // Now actually do it
-    for(auto *tag : tags_to_do) {
-        std::size_t count = refactor_tags(tag->full_path.string().c_str(), replacements, false, refactor_options.dry_run);
+    // Make sure all of them can be refactored before we write anything
+    if(!for_each_tag(tags_to_do.size(), refactor_options.thread_count, [&tags_to_do, &replacements, &refactor_options](std::size_t i) {
+        refactor_tag(tags_to_do[i]->full_path, replacements, true, refactor_options.dry_run);
+    })) {
+        return EXIT_FAILURE;
+    }
+
+    // Now actually do it; each thread only holds the tag it's working on
+    std::atomic<std::size_t> total_tags = 0;
+    std::atomic<std::size_t> total_replaced = 0;
+    if(!for_each_tag(tags_to_do.size(), refactor_options.thread_count, [&tags_to_do, &replacements, &refactor_options, &total_tags, &total_replaced](std::size_t i) {
+        std::size_t count = refactor_tag(tags_to_do[i]->full_path, replacements, false, refactor_options.dry_run);
         if(count) {
             total_replaced += count;
             total_tags++;
         }
+    })) {
+        return EXIT_FAILURE;
     }
 
-    oprintf("Replaced %zu reference%s in %zu tag%s\n", total_replaced, total_replaced == 1 ? "" : "s", total_tags, total_tags == 1 ? "" : "s");
+    oprintf("Replaced %zu reference%s in %zu tag%s\n", total_replaced.load(), total_replaced == 1 ? "" : "s", total_tags.load(), total_tags == 1 ? "" : "s");
     
     if(refactor_options.dry_run) {
         oprintf("Dry run complete\n");
@@ -3,8 +3,12 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cassert>
+#include <cstring>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <memory>
+#include <unordered_map>
 #include <invader/version.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/tag/hek/definition.hpp>
@@ -13,7 +17,76 @@
 #include <invader/resource/list/resource_list.hpp>
 #include "../command_line_option.hpp"
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
+
+// Writes a resource map to a file next to the final one as it's built, only replacing the final one once it's complete
+class ResourceMapWriter {
+public:
+    ResourceMapWriter(const std::filesystem::path &path) : path(path), partial_path(path.string() + ".part") {
+        this->file = std::fopen(this->partial_path.string().c_str(), "wb");
+    }
+
+    ~ResourceMapWriter() {
+        if(this->file) {
+            std::fclose(this->file);
+            std::error_code ec;
+            std::filesystem::remove(this->partial_path, ec);
+        }
+    }
+
+    bool is_open() const noexcept {
+        return this->file != nullptr;
+    }
+
+    std::size_t size() const noexcept {
+        return this->written;
+    }
+
+    void write(const std::byte *data, std::size_t size) noexcept {
+        std::fwrite(data, size, 1, this->file);
+        this->written += size;
+    }
+
+    void write(const std::vector<std::byte> &data) noexcept {
+        this->write(data.data(), data.size());
+    }
+
+    void pad_32_bit() noexcept {
+        static constexpr std::byte padding[4] = {};
+        this->write(padding, REQUIRED_PADDING_32_BIT(this->written));
+    }
+
+    /**
+     * Write the header over the start of the file and move it to its final path
+     * @param header header to write
+     * @return       true if successful
+     */
+    bool finish(const Invader::HEK::ResourceMapHeader &header) {
+        std::fseek(this->file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, this->file);
+        bool written_successfully = !std::ferror(this->file);
+        written_successfully = std::fclose(this->file) == 0 && written_successfully;
+        this->file = nullptr;
+
+        std::error_code ec;
+        if(written_successfully) {
+            std::filesystem::rename(this->partial_path, this->path, ec);
+        }
+        if(!written_successfully || ec) {
+            std::filesystem::remove(this->partial_path, ec);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::filesystem::path path;
+    std::filesystem::path partial_path;
+    std::FILE *file = nullptr;
+    std::size_t written = 0;
+};
 
 int main(int argc, const char **argv) {
     using namespace Invader::HEK;
@@ -28,7 +101,8 @@ int main(int argc, const char **argv) {
         CommandLineOption("with-index", 'w', 1, "Use an index file for the tags, ensuring tags are ordered in the same way (barring duplicates).", "<file>"),
         CommandLineOption("with-map", 'M', 1, "Use a map file for the tags. This can be specified multiple times.", "<file>"),
         CommandLineOption("concatenate", 'c', 1, "Concatenate against the resource map at a path. This cannot be used with -T loc", "<file>"),
-        CommandLineOption("show-matched", 'S', 0, "Print the paths of any matched tags found when using --concatenate.")
+        CommandLineOption("show-matched", 'S', 0, "Print the paths of any matched tags found when using --concatenate."),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Create resource maps.";
@@ -54,6 +128,9 @@ int main(int argc, const char **argv) {
 
         // Spam console?
         bool show_matched = false;
+
+        // Threads to compile tags with
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } resource_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<ResourceOption &>(argc, argv, options, USAGE, DESCRIPTION, 0, 0, resource_options, [](char opt, const std::vector<const char *> &arguments, auto &resource_options) {
@@ -74,6 +151,10 @@ int main(int argc, const char **argv) {
                 resource_options.show_matched = true;
                 break;
 
+            case 'j':
+                resource_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
+
             case 'm':
                 resource_options.maps = arguments[0];
                 break;
@@ -120,6 +201,9 @@ int main(int argc, const char **argv) {
         }
     });
 
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(resource_options.thread_count);
+
     if(!resource_options.type.has_value()) {
         eprintf_error("No resource map type was given. Use -h for more information.");
         return EXIT_FAILURE;
@@ -214,15 +298,14 @@ int main(int argc, const char **argv) {
     header.resource_count = tags_list.size();
 
     // Read the amazing fun happy stuff
-    std::vector<std::byte> resource_data(sizeof(ResourceMapHeader));
-
+    std::vector<std::byte> concatenate_data;
     std::vector<Resource> concatenate_resource;
     if(resource_options.concatenate_against.has_value()) {
         try {
-            resource_data = File::open_file(*resource_options.concatenate_against).value();
-            concatenate_resource = load_resource_map(resource_data.data(), resource_data.size());
+            concatenate_data = File::open_file(*resource_options.concatenate_against).value();
+            concatenate_resource = load_resource_map(concatenate_data.data(), concatenate_data.size());
 
-            if(reinterpret_cast<ResourceMapHeader *>(resource_data.data())->type != header.type) {
+            if(reinterpret_cast<ResourceMapHeader *>(concatenate_data.data())->type != header.type) {
                 eprintf_error("Cannot concatenate against a different resource map type than what is being made");
                 return EXIT_FAILURE;
             }
@@ -238,11 +321,36 @@ int main(int argc, const char **argv) {
         }
     }
 
+    // Index the resources being concatenated against by their data
+    std::unordered_map<std::uint64_t, std::vector<const Resource *>> concatenate_resource_index;
+    for(auto &i : concatenate_resource) {
+        concatenate_resource_index[FNV1AHash::hash_words(i.data.data(), i.data.size())].emplace_back(&i);
+    }
+    auto find_concatenated_resource = [&concatenate_resource_index](const std::vector<std::byte> &data) -> const Resource * {
+        auto bucket = concatenate_resource_index.find(FNV1AHash::hash_words(data.data(), data.size()));
+        if(bucket != concatenate_resource_index.end()) {
+            for(auto *i : bucket->second) {
+                if(i->data == data) {
+                    return i;
+                }
+            }
+        }
+        return nullptr;
+    };
+
     std::vector<std::size_t> offsets;
     std::vector<std::size_t> sizes;
     std::vector<std::string> paths;
     std::vector<std::string> added_tags;
 
+    struct ListedResourceTag {
+        File::TagFilePath listed_tag;
+        TagFourCC tag_fourcc;
+        std::string tag_path;
+        std::string halo_tag_path;
+    };
+    std::vector<ListedResourceTag> resource_tags;
+
     for(auto &listed_tag : tags_list) {
         // First let's open it
         TagFourCC tag_fourcc = TagFourCC::TAG_FOURCC_NONE;
@@ -314,267 +422,303 @@ int main(int argc, const char **argv) {
             eprintf_error("Expected %s. Got %s instead.", tag_fourcc_to_extension(tag_fourcc), tag_fourcc_to_extension(listed_tag.fourcc));
         }
 
-        // This may be needed
-        #define PAD_RESOURCES_32_BIT resource_data.insert(resource_data.end(), REQUIRED_PADDING_32_BIT(resource_data.size()), std::byte());
+        resource_tags.push_back(ListedResourceTag { listed_tag, tag_fourcc, tag_path, halo_tag_path });
+    }
 
-        // Compile the tags
-        try {
-            auto compiled_tag = Invader::BuildWorkload::compile_single_tag(listed_tag.path.c_str(), tag_fourcc, resource_options.tags);
-            auto &compiled_tag_tag = compiled_tag.tags[0];
-            auto &compiled_tag_struct = compiled_tag.structs[*compiled_tag_tag.base_struct];
-            auto *compiled_tag_data = compiled_tag_struct.data.data();
-            char path_temp[256];
-
-            std::vector<std::byte> data;
-            std::vector<std::size_t> structs;
-
-            // Pointers are stored as offsets here
-            auto write_pointers = [&data, &structs, &compiled_tag, &resource_options]() {
-                for(auto &s : compiled_tag.structs) {
-                    structs.push_back(data.size());
-                    data.insert(data.end(), s.data.begin(), s.data.end());
-                }
+    // Get the final path of the map
+    const char *map;
+    switch(*resource_options.type) {
+        case ResourceMapType::RESOURCE_MAP_BITMAP:
+            map = "bitmaps.map";
+            break;
+        case ResourceMapType::RESOURCE_MAP_SOUND:
+            map = "sounds.map";
+            break;
+        case ResourceMapType::RESOURCE_MAP_LOC:
+            map = "loc.map";
+            break;
+        default:
+            std::terminate();
+    }
+    auto map_path = std::filesystem::path(resource_options.maps) / map;
 
-                std::size_t offset = resource_options.type == ResourceMapType::RESOURCE_MAP_SOUND ? sizeof(Invader::Parser::Sound::struct_little) : 0;
-                for(auto &s : compiled_tag.structs) {
-                    for(auto &ptr : s.pointers) {
-                        *reinterpret_cast<LittleEndian<Pointer> *>(data.data() + structs[&s - compiled_tag.structs.data()] + ptr.offset) = structs[ptr.struct_index] - offset;
-                    }
+    // Resources are written as they're added, so only the resources being concatenated against and one batch of tags are in memory at once
+    ResourceMapWriter resource_data(map_path);
+    if(!resource_data.is_open()) {
+        eprintf_error("Failed to open %s for writing.", map_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Either start with the resource map being concatenated against or leave room for the header
+    if(concatenate_data.empty()) {
+        concatenate_data.resize(sizeof(ResourceMapHeader));
+    }
+    resource_data.write(concatenate_data);
+    concatenate_data = std::vector<std::byte>();
+
+    // Compile a batch of tags at a time (one per thread), then add them in order so the output doesn't depend on the thread count
+    std::size_t thread_count = resource_options.thread_count;
+    for(std::size_t batch_start = 0; batch_start < resource_tags.size(); batch_start += thread_count) {
+        std::size_t batch_size = std::min(thread_count, resource_tags.size() - batch_start);
+        std::vector<std::unique_ptr<BuildWorkload>> compiled_tags(batch_size);
+        std::vector<std::exception_ptr> compile_exceptions(batch_size);
+
+        auto compile_tag = [&resource_tags, &resource_options, &compiled_tags, &compile_exceptions, &batch_start](std::size_t i) {
+            auto &resource_tag = resource_tags[batch_start + i];
+            try {
+                compiled_tags[i].reset(new BuildWorkload(BuildWorkload::compile_single_tag(resource_tag.listed_tag.path.c_str(), resource_tag.tag_fourcc, resource_options.tags)));
+            }
+            catch(...) {
+                compile_exceptions[i] = std::current_exception();
+            }
+        };
+
+        ThreadPool::shared().parallel_for(batch_size, compile_tag);
+
+        for(std::size_t c = 0; c < batch_size; c++) {
+            auto &[listed_tag, tag_fourcc, tag_path, halo_tag_path] = resource_tags[batch_start + c];
+
+            // This may be needed
+            #define PAD_RESOURCES_32_BIT resource_data.pad_32_bit();
+
+            // Compile the tags
+            try {
+                if(compile_exceptions[c]) {
+                    std::rethrow_exception(compile_exceptions[c]);
                 }
-            };
-
-            // Now, adjust stuff for pointers
-            switch(*resource_options.type) {
-                case ResourceMapType::RESOURCE_MAP_BITMAP: {
-                    // Do stuff to the tag data
-                    auto &bitmap = *reinterpret_cast<Bitmap<LittleEndian> *>(compiled_tag_data);
-                    std::size_t bitmap_count = bitmap.bitmap_data.count;
-
-                    // Combine all data into one blob if custom edition
-                    auto bitmap_data_offset_custom = resource_data.size();
-                    if(resource_options.engine_target == HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION) {
-                        bool append = true;
-                        std::vector<std::byte> data_custom;
-
-                        for(auto &r : compiled_tag.raw_data) {
-                            data_custom.insert(data_custom.end(), r.begin(), r.end());
+                auto &compiled_tag = *compiled_tags[c];
+                auto &compiled_tag_tag = compiled_tag.tags[0];
+                auto &compiled_tag_struct = compiled_tag.structs[*compiled_tag_tag.base_struct];
+                auto *compiled_tag_data = compiled_tag_struct.data.data();
+                char path_temp[256];
+
+                std::vector<std::byte> data;
+                std::vector<std::size_t> structs;
+
+                // Pointers are stored as offsets here
+                auto write_pointers = [&data, &structs, &compiled_tag, &resource_options]() {
+                    for(auto &s : compiled_tag.structs) {
+                        structs.push_back(data.size());
+                        data.insert(data.end(), s.data.begin(), s.data.end());
+                    }
+
+                    std::size_t offset = resource_options.type == ResourceMapType::RESOURCE_MAP_SOUND ? sizeof(Invader::Parser::Sound::struct_little) : 0;
+                    for(auto &s : compiled_tag.structs) {
+                        for(auto &ptr : s.pointers) {
+                            *reinterpret_cast<LittleEndian<Pointer> *>(data.data() + structs[&s - compiled_tag.structs.data()] + ptr.offset) = structs[ptr.struct_index] - offset;
                         }
+                    }
+                };
+
+                // Now, adjust stuff for pointers
+                switch(*resource_options.type) {
+                    case ResourceMapType::RESOURCE_MAP_BITMAP: {
+                        // Do stuff to the tag data
+                        auto &bitmap = *reinterpret_cast<Bitmap<LittleEndian> *>(compiled_tag_data);
+                        std::size_t bitmap_count = bitmap.bitmap_data.count;
+
+                        // Combine all data into one blob if custom edition
+                        auto bitmap_data_offset_custom = resource_data.size();
+                        if(resource_options.engine_target == HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION) {
+                            bool append = true;
+                            std::vector<std::byte> data_custom;
+
+                            for(auto &r : compiled_tag.raw_data) {
+                                data_custom.insert(data_custom.end(), r.begin(), r.end());
+                            }
 
-                        for(auto &i : concatenate_resource) {
-                            if(i.data == data_custom) {
-                                bitmap_data_offset_custom = i.data_offset;
+                            if(auto *i = find_concatenated_resource(data_custom)) {
+                                bitmap_data_offset_custom = i->data_offset;
                                 append = false;
                                 if(resource_options.show_matched) {
                                     std::printf("Matched %s\n", File::halo_path_to_preferred_path(halo_tag_path).c_str());
                                 }
-                                break;
                             }
-                        }
 
-                        offsets.push_back(bitmap_data_offset_custom);
-                        paths.push_back(halo_tag_path + "__pixels");
-                        sizes.push_back(data_custom.size());
+                            offsets.push_back(bitmap_data_offset_custom);
+                            paths.push_back(halo_tag_path + "__pixels");
+                            sizes.push_back(data_custom.size());
 
-                        if(append) {
-                            resource_data.insert(resource_data.end(), data_custom.begin(), data_custom.end());
-                            PAD_RESOURCES_32_BIT
+                            if(append) {
+                                resource_data.write(data_custom);
+                                PAD_RESOURCES_32_BIT
+                            }
                         }
-                    }
 
-                    if(bitmap_count) {
-                        auto *bitmaps = reinterpret_cast<BitmapData<LittleEndian> *>(compiled_tag.structs[*compiled_tag_struct.resolve_pointer(&bitmap.bitmap_data.pointer)].data.data());
-                        for(std::size_t b = 0; b < bitmap_count; b++) {
-                            auto *bitmap_data = bitmaps + b;
+                        if(bitmap_count) {
+                            auto *bitmaps = reinterpret_cast<BitmapData<LittleEndian> *>(compiled_tag.structs[*compiled_tag_struct.resolve_pointer(&bitmap.bitmap_data.pointer)].data.data());
+                            for(std::size_t b = 0; b < bitmap_count; b++) {
+                                auto *bitmap_data = bitmaps + b;
 
-                            // If we're on retail, push the pixel data
-                            if(retail) {
-                                // Generate the path to add
-                                std::snprintf(path_temp, sizeof(path_temp), "%s_%zu", halo_tag_path.c_str(), b);
+                                // If we're on retail, push the pixel data
+                                if(retail) {
+                                    // Generate the path to add
+                                    std::snprintf(path_temp, sizeof(path_temp), "%s_%zu", halo_tag_path.c_str(), b);
 
-                                // We already have it
-                                for(auto &i : concatenate_resource) {
-                                    if(i.data == compiled_tag.raw_data[b]) {
+                                    // We already have it
+                                    if(auto *i = find_concatenated_resource(compiled_tag.raw_data[b])) {
                                         paths.push_back(path_temp);
-                                        sizes.push_back(i.data.size());
-                                        offsets.push_back(i.data_offset);
+                                        sizes.push_back(i->data.size());
+                                        offsets.push_back(i->data_offset);
                                         if(resource_options.show_matched) {
                                             std::printf("Matched %s\n", File::halo_path_to_preferred_path(path_temp).c_str());
                                         }
                                         goto next_bitmap_data;
                                     }
-                                }
 
-                                // Push it good
-                                paths.push_back(path_temp);
-                                std::size_t size = bitmap_data->pixel_data_size.read();
-                                sizes.push_back(size);
-                                offsets.push_back(resource_data.size());
-                                resource_data.insert(resource_data.end(), compiled_tag.raw_data[b].begin(), compiled_tag.raw_data[b].end());
+                                    // Push it good
+                                    paths.push_back(path_temp);
+                                    std::size_t size = bitmap_data->pixel_data_size.read();
+                                    sizes.push_back(size);
+                                    offsets.push_back(resource_data.size());
+                                    resource_data.write(compiled_tag.raw_data[b]);
 
-                                PAD_RESOURCES_32_BIT
-                            }
-                            // Otherwise set the sizes
-                            else {
-                                bitmap_data->pixel_data_offset = bitmap_data_offset_custom + bitmap_data->pixel_data_offset;
-                                bitmap_data->flags = bitmap_data->flags.read() | BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL;
-                            }
+                                    PAD_RESOURCES_32_BIT
+                                }
+                                // Otherwise set the sizes
+                                else {
+                                    bitmap_data->pixel_data_offset = bitmap_data_offset_custom + bitmap_data->pixel_data_offset;
+                                    bitmap_data->flags = bitmap_data->flags.read() | BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_EXTERNAL;
+                                }
 
-                            next_bitmap_data: continue;
+                                next_bitmap_data: continue;
+                            }
                         }
-                    }
 
-                    // Push the asset data and tag data if we aren't on retail
-                    if(!retail) {
-                        write_pointers();
+                        // Push the asset data and tag data if we aren't on retail
+                        if(!retail) {
+                            write_pointers();
 
-                        // Push the tag data
-                        offsets.push_back(resource_data.size());
-                        resource_data.insert(resource_data.end(), data.begin(), data.end());
-                        paths.push_back(halo_tag_path);
-                        sizes.push_back(data.size());
+                            // Push the tag data
+                            offsets.push_back(resource_data.size());
+                            resource_data.write(data);
+                            paths.push_back(halo_tag_path);
+                            sizes.push_back(data.size());
 
-                        PAD_RESOURCES_32_BIT
-                    }
-
-                    break;
-                }
-                case ResourceMapType::RESOURCE_MAP_SOUND: {
-                    // Do stuff to the tag data
-                    auto &sound = *reinterpret_cast<Sound<LittleEndian> *>(compiled_tag_struct.data.data());
-                    std::size_t pitch_range_count = sound.pitch_ranges.count;
-                    std::size_t b = 0;
-                    std::size_t expected_offset = 0;
-
-                    // Combine all data into one blob if custom edition
-                    auto sound_data_offset_custom = resource_data.size();
-                    if(resource_options.engine_target == HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION) {
-                        bool append = true;
-                        std::vector<std::byte> data_custom;
-
-                        for(auto &r : compiled_tag.raw_data) {
-                            data_custom.insert(data_custom.end(), r.begin(), r.end());
+                            PAD_RESOURCES_32_BIT
                         }
 
-                        for(auto &i : concatenate_resource) {
-                            if(i.data == data_custom) {
-                                sound_data_offset_custom = i.data_offset;
+                        break;
+                    }
+                    case ResourceMapType::RESOURCE_MAP_SOUND: {
+                        // Do stuff to the tag data
+                        auto &sound = *reinterpret_cast<Sound<LittleEndian> *>(compiled_tag_struct.data.data());
+                        std::size_t pitch_range_count = sound.pitch_ranges.count;
+                        std::size_t b = 0;
+                        std::size_t expected_offset = 0;
+
+                        // Combine all data into one blob if custom edition
+                        auto sound_data_offset_custom = resource_data.size();
+                        if(resource_options.engine_target == HEK::CacheFileEngine::CACHE_FILE_CUSTOM_EDITION) {
+                            bool append = true;
+                            std::vector<std::byte> data_custom;
+
+                            for(auto &r : compiled_tag.raw_data) {
+                                data_custom.insert(data_custom.end(), r.begin(), r.end());
+                            }
+
+                            if(auto *i = find_concatenated_resource(data_custom)) {
+                                sound_data_offset_custom = i->data_offset;
                                 append = false;
                                 if(resource_options.show_matched) {
                                     std::printf("Matched %s\n", File::halo_path_to_preferred_path(halo_tag_path).c_str());
                                 }
-                                break;
                             }
-                        }
 
-                        offsets.push_back(sound_data_offset_custom);
-                        paths.push_back(halo_tag_path + "__samples");
-                        sizes.push_back(data_custom.size());
+                            offsets.push_back(sound_data_offset_custom);
+                            paths.push_back(halo_tag_path + "__samples");
+                            sizes.push_back(data_custom.size());
 
-                        if(append) {
-                            resource_data.insert(resource_data.end(), data_custom.begin(), data_custom.end());
-                            PAD_RESOURCES_32_BIT
+                            if(append) {
+                                resource_data.write(data_custom);
+                                PAD_RESOURCES_32_BIT
+                            }
                         }
-                    }
 
-                    if(pitch_range_count) {
-                        auto &pitch_range_struct = compiled_tag.structs[*compiled_tag_struct.resolve_pointer(&sound.pitch_ranges.pointer)];
-                        auto *pitch_ranges = reinterpret_cast<SoundPitchRange<LittleEndian> *>(pitch_range_struct.data.data());
-                        for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-                            auto &pitch_range = pitch_ranges[pr];
-                            std::size_t permutation_count = pitch_range.permutations.count;
-                            if(permutation_count) {
-                                auto *permutations = reinterpret_cast<SoundPermutation<LittleEndian> *>(compiled_tag.structs[*pitch_range_struct.resolve_pointer(&pitch_range.permutations.pointer)].data.data());
-                                for(std::size_t p = 0; p < permutation_count; p++) {
-                                    auto &permutation = permutations[p];
-                                    if(retail) {
-                                        // Generate the path to add
-                                        std::snprintf(path_temp, sizeof(path_temp), "%s__%zu__%zu", halo_tag_path.c_str(), pr, p);
-
-                                        // We already have it
-                                        for(auto &i : concatenate_resource) {
-                                            if(i.data == compiled_tag.raw_data[b]) {
+                        if(pitch_range_count) {
+                            auto &pitch_range_struct = compiled_tag.structs[*compiled_tag_struct.resolve_pointer(&sound.pitch_ranges.pointer)];
+                            auto *pitch_ranges = reinterpret_cast<SoundPitchRange<LittleEndian> *>(pitch_range_struct.data.data());
+                            for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+                                auto &pitch_range = pitch_ranges[pr];
+                                std::size_t permutation_count = pitch_range.permutations.count;
+                                if(permutation_count) {
+                                    auto *permutations = reinterpret_cast<SoundPermutation<LittleEndian> *>(compiled_tag.structs[*pitch_range_struct.resolve_pointer(&pitch_range.permutations.pointer)].data.data());
+                                    for(std::size_t p = 0; p < permutation_count; p++) {
+                                        auto &permutation = permutations[p];
+                                        if(retail) {
+                                            // Generate the path to add
+                                            std::snprintf(path_temp, sizeof(path_temp), "%s__%zu__%zu", halo_tag_path.c_str(), pr, p);
+
+                                            // We already have it
+                                            if(auto *i = find_concatenated_resource(compiled_tag.raw_data[b])) {
                                                 paths.push_back(path_temp);
-                                                sizes.push_back(i.data.size());
-                                                offsets.push_back(i.data_offset);
+                                                sizes.push_back(i->data.size());
+                                                offsets.push_back(i->data_offset);
                                                 if(resource_options.show_matched) {
                                                     std::printf("Matched %s\n", File::halo_path_to_preferred_path(path_temp).c_str());
                                                 }
                                                 goto next_sound_data;
                                             }
-                                        }
 
-                                        // Push it REAL good
-                                        paths.push_back(path_temp);
-                                        sizes.push_back(permutation.samples.size.read());
-                                        offsets.push_back(resource_data.size());
-                                        resource_data.insert(resource_data.end(), compiled_tag.raw_data[b].begin(), compiled_tag.raw_data[b].end());
+                                            // Push it REAL good
+                                            paths.push_back(path_temp);
+                                            sizes.push_back(permutation.samples.size.read());
+                                            offsets.push_back(resource_data.size());
+                                            resource_data.write(compiled_tag.raw_data[b]);
 
-                                        PAD_RESOURCES_32_BIT
+                                            PAD_RESOURCES_32_BIT
 
-                                        next_sound_data: b++;
-                                    }
-                                    else {
-                                        permutation.samples.external = 1;
-                                        permutation.samples.file_offset = sound_data_offset_custom + expected_offset;
-                                        expected_offset += permutation.samples.size;
+                                            next_sound_data: b++;
+                                        }
+                                        else {
+                                            permutation.samples.external = 1;
+                                            permutation.samples.file_offset = sound_data_offset_custom + expected_offset;
+                                            expected_offset += permutation.samples.size;
+                                        }
                                     }
                                 }
                             }
                         }
-                    }
 
-                    // If we're not on retail, push asset and tag data
-                    if(!retail) {
-                        write_pointers();
+                        // If we're not on retail, push asset and tag data
+                        if(!retail) {
+                            write_pointers();
+
+                            // Push the tag data
+                            offsets.push_back(resource_data.size());
+                            resource_data.write(data);
+                            paths.push_back(halo_tag_path);
+                            sizes.push_back(data.size());
+
+                            PAD_RESOURCES_32_BIT
+                        }
 
-                        // Push the tag data
+                        break;
+                    }
+                    case ResourceMapType::RESOURCE_MAP_LOC: {
+                        write_pointers();
                         offsets.push_back(resource_data.size());
-                        resource_data.insert(resource_data.end(), data.begin(), data.end());
+                        resource_data.write(data);
                         paths.push_back(halo_tag_path);
                         sizes.push_back(data.size());
 
                         PAD_RESOURCES_32_BIT
-                    }
 
-                    break;
-                }
-                case ResourceMapType::RESOURCE_MAP_LOC: {
-                    write_pointers();
-                    offsets.push_back(resource_data.size());
-                    resource_data.insert(resource_data.end(), data.begin(), data.end());
-                    paths.push_back(halo_tag_path);
-                    sizes.push_back(data.size());
-
-                    PAD_RESOURCES_32_BIT
-
-                    break;
+                        break;
+                    }
                 }
             }
-        }
-        catch(std::exception &e) {
-            eprintf_error("Failed to compile %s due to an exception: %s", tag_path.c_str(), e.what());
-            return EXIT_FAILURE;
-        }
+            catch(std::exception &e) {
+                eprintf_error("Failed to compile %s due to an exception: %s", tag_path.c_str(), e.what());
+                return EXIT_FAILURE;
+            }
 
-        #undef PAD_RESOURCES_32_BIT
-    }
+            #undef PAD_RESOURCES_32_BIT
 
-    // Get the final path of the map
-    const char *map;
-    switch(*resource_options.type) {
-        case ResourceMapType::RESOURCE_MAP_BITMAP:
-            map = "bitmaps.map";
-            break;
-        case ResourceMapType::RESOURCE_MAP_SOUND:
-            map = "sounds.map";
-            break;
-        case ResourceMapType::RESOURCE_MAP_LOC:
-            map = "loc.map";
-            break;
-        default:
-            std::terminate();
+            // Done with it, so don't hold onto it for the rest of the batch
+            compiled_tags[c].reset();
+        }
     }
-    auto map_path = std::filesystem::path(resource_options.maps) / map;
 
     // Finish up building up the map
     std::size_t resource_count = paths.size();
@@ -592,27 +736,19 @@ int main(int argc, const char **argv) {
     header.resource_count = resource_count;
     header.paths = resource_data.size();
     header.resources = resource_names_arr.size() + resource_data.size();
-    *reinterpret_cast<ResourceMapHeader *>(resource_data.data()) = header;
 
     if(resource_data.size() >= 0xFFFFFFFF) {
         eprintf_error("Resource map exceeds 4 GiB.");
         return EXIT_FAILURE;
     }
 
-    // Open the file
-    std::FILE *f = std::fopen(map_path.string().c_str(), "wb");
-    if(!f) {
-        eprintf_error("Failed to open %s for writing.", map_path.string().c_str());
+    // Write the paths and indices after the data, then the header
+    resource_data.write(resource_names_arr);
+    resource_data.write(reinterpret_cast<const std::byte *>(resource_indices.data()), resource_indices.size() * sizeof(*resource_indices.data()));
+    if(!resource_data.finish(header)) {
+        eprintf_error("Failed to write to %s.", map_path.string().c_str());
         return EXIT_FAILURE;
     }
 
-    // Write everything
-    std::fwrite(resource_data.data(), resource_data.size(), 1, f);
-    std::fwrite(resource_names_arr.data(), resource_names_arr.size(), 1, f);
-    std::fwrite(resource_indices.data(), resource_indices.size() * sizeof(*resource_indices.data()), 1, f);
-
-    // Done!
-    std::fclose(f);
-
     oprintf("Created a resource map file at %s\n", map_path.string().c_str());
 }
@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <cstring>
+#include <string_view>
+
 #include <invader/resource/resource_map.hpp>
 #include <invader/resource/hek/resource_map.hpp>
 #include <invader/file/file.hpp>
 
 namespace Invader {
-    std::vector<Resource> load_resource_map(const std::byte *data, std::size_t size) {
+    // Read each resource in the resource map, passing the path, data, and offsets to the callback
+    template <typename Callback> static void read_resource_map(const std::byte *data, std::size_t size, Callback callback) {
         using namespace HEK;
         if(size < sizeof(ResourceMapHeader)) {
             throw OutOfBoundsException();
@@ -30,8 +34,6 @@ namespace Invader {
         }
         const auto *resources = reinterpret_cast<const ResourceMapResource *>(data + resource_offset);
 
-        std::vector<Resource> returned_resources;
-
         for(std::size_t r = 0; r < resource_count; r++) {
             std::size_t resource_data_offset = resources[r].data_offset;
             std::size_t resource_path_offset = resources[r].path_offset + path_offset;
@@ -56,15 +58,104 @@ namespace Invader {
                 }
             }
 
+            callback(Invader::File::remove_duplicate_slashes(resource_path), resource_data, resource_data_size, resource_path_offset, resource_data_offset);
+        }
+    }
+
+    std::vector<Resource> load_resource_map(const std::byte *data, std::size_t size) {
+        std::vector<Resource> returned_resources;
+
+        read_resource_map(data, size, [&returned_resources](std::string &&path, const std::byte *resource_data, std::size_t resource_data_size, std::size_t path_offset, std::size_t data_offset) {
             Resource resource;
-            resource.path = Invader::File::remove_duplicate_slashes(resource_path);
+            resource.path = std::move(path);
             resource.data = std::vector<std::byte>(resource_data, resource_data + resource_data_size);
-            resource.path_offset = resource_path_offset;
-            resource.data_offset = resource_data_offset;
+            resource.path_offset = path_offset;
+            resource.data_offset = data_offset;
 
             returned_resources.push_back(resource);
-        }
+        });
 
         return returned_resources;
     }
+
+    ResourceMapView ResourceMapView::map_file(const std::filesystem::path &path) {
+        auto file = File::MemoryMappedFile::map_file(path);
+        if(!file.has_value()) {
+            throw FailedToOpenFileException();
+        }
+        return ResourceMapView(std::move(*file));
+    }
+
+    ResourceMapView::ResourceMapView(File::MemoryMappedFile &&file) : file(std::make_shared<File::MemoryMappedFile>(std::move(file))) {
+        read_resource_map(this->file->data(), this->file->size(), [this](std::string &&path, const std::byte *resource_data, std::size_t resource_data_size, std::size_t path_offset, std::size_t data_offset) {
+            auto &resource = this->resources.emplace_back();
+            resource.path = std::move(path);
+            resource.data = std::span<const std::byte>(resource_data, resource_data_size);
+            resource.path_offset = path_offset;
+            resource.data_offset = data_offset;
+        });
+    }
+
+    // Resources are found by hashing this many bytes from the start of the data. Data that starts with the data being looked for can only be found this way if it's at least this long.
+    static constexpr std::size_t RESOURCE_DATA_PREFIX_SIZE = 64;
+
+    static std::size_t hash_resource_data_prefix(const std::byte *data) noexcept {
+        return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(data), RESOURCE_DATA_PREFIX_SIZE));
+    }
+
+    ResourceMapIndex::ResourceMapIndex(const ResourceMapView &resources) : resources(resources) {
+        std::size_t resource_count = resources.size();
+        this->paths.reserve(resource_count);
+        this->paths_every_other.reserve(resource_count / 2);
+
+        // Keep the first of each so we find the same resource a linear search would
+        for(std::size_t r = 0; r < resource_count; r++) {
+            auto &resource = resources[r];
+            this->paths.try_emplace(resource.path, r);
+            if(r % 2 == 1) {
+                this->paths_every_other.try_emplace(resource.path, r);
+            }
+            if(resource.data.size() >= RESOURCE_DATA_PREFIX_SIZE) {
+                this->data_prefixes[hash_resource_data_prefix(resource.data.data())].emplace_back(r);
+            }
+        }
+    }
+
+    std::optional<std::size_t> ResourceMapIndex::find_path(const std::string &path, bool every_other) const noexcept {
+        auto &paths = every_other ? this->paths_every_other : this->paths;
+        auto iterator = paths.find(path);
+        if(iterator == paths.end()) {
+            return std::nullopt;
+        }
+        return iterator->second;
+    }
+
+    std::optional<std::size_t> ResourceMapIndex::find_data(const std::byte *data, std::size_t size) const noexcept {
+        auto matches = [this, &data, &size](std::size_t r) {
+            auto &resource_data = this->resources[r].data;
+            return resource_data.size() >= size && std::memcmp(resource_data.data(), data, size) == 0;
+        };
+
+        // If it's too small to hash, we have to check everything
+        if(size < RESOURCE_DATA_PREFIX_SIZE) {
+            std::size_t resource_count = this->resources.size();
+            for(std::size_t r = 0; r < resource_count; r++) {
+                if(matches(r)) {
+                    return r;
+                }
+            }
+            return std::nullopt;
+        }
+
+        // Otherwise, only check resources that start the same way (these are in order, so the first match is the first resource that matches)
+        auto iterator = this->data_prefixes.find(hash_resource_data_prefix(data));
+        if(iterator != this->data_prefixes.end()) {
+            for(auto r : iterator->second) {
+                if(matches(r)) {
+                    return r;
+                }
+            }
+        }
+        return std::nullopt;
+    }
 }
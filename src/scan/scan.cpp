@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <filesystem>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
@@ -14,51 +16,95 @@
 
 int main(int argc, char * const *argv) {
     set_up_color_term();
-    
+
     using namespace Invader;
-    
+
     const CommandLineOption options[] {
-        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO)
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_INFO),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Scans for unknown hidden data in tags";
-    static constexpr char USAGE[] = "[options] <map>";
+    static constexpr char USAGE[] = "[options] <map...>";
 
     struct ScanOptions {
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } scan_options;
 
-    auto remaining_arguments = CommandLineOption::parse_arguments<ScanOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, scan_options, [](char opt, const std::vector<const char *> &, ScanOptions &) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<ScanOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 65535, scan_options, [](char opt, const std::vector<const char *> &args, ScanOptions &scan_options) {
         switch(opt) {
             case 'i':
                 show_version_info();
                 std::exit(EXIT_SUCCESS);
+            case 'j':
+                scan_options.thread_count = CommandLineOption::parse_thread_count(args[0]);
+                break;
         }
     });
-    
-    auto map_data = File::open_file(remaining_arguments[0]).value();
-    auto map = Map::map_with_copy(map_data.data(), map_data.size());
-    auto tag_count = map.get_tag_count();
-    
-    for(std::size_t t = 0; t < tag_count; t++) {
-        auto &tag = map.get_tag(t);
-        if(!tag.data_is_available()) {
-            continue;
-        }
-        
-        #define DO_TAG_CLASS(c, v) case HEK::v: {\
-            Parser::c::scan_padding(tag);\
-            break;\
+
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(scan_options.thread_count);
+
+    bool failed = false;
+    bool multiple_maps = remaining_arguments.size() > 1;
+
+    for(auto *map_path : remaining_arguments) {
+        std::optional<Map> map_maybe;
+        try {
+            map_maybe.emplace(Map::map_with_mmap(map_path));
         }
-        
-        auto tci = tag.get_tag_fourcc();
-        if(tci == HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.get_cache_version() != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
-            Parser::ScenarioStructureBSP::scan_padding(tag, tag.get_base_struct<HEK::ScenarioStructureBSPCompiledHeader>().pointer);
+        catch(std::exception &e) {
+            eprintf_error("Failed to parse %s: %s", map_path, e.what());
+            failed = true;
             continue;
         }
-        
-        switch(tci) {
-            DO_BASED_ON_TAG_CLASS
-            default: break;
+        auto &map = *map_maybe;
+        auto tag_count = map.get_tag_count();
+
+        // Tags are independent, so scan them at once, but print what was found in tag order
+        std::vector<std::string> findings(tag_count);
+        std::vector<std::string> errors(tag_count);
+        ThreadPool::shared().parallel_for(tag_count, [&map, &findings, &errors](std::size_t t) {
+            try {
+                auto &tag = map.get_tag(t);
+                if(!tag.data_is_available()) {
+                    return;
+                }
+
+                #define DO_TAG_CLASS(c, v) case HEK::v: {\
+                    Parser::c::scan_padding(tag, std::nullopt, &findings[t]);\
+                    break;\
+                }
+
+                auto tci = tag.get_tag_fourcc();
+                if(tci == HEK::TagFourCC::TAG_FOURCC_SCENARIO_STRUCTURE_BSP && map.get_cache_version() != HEK::CacheFileEngine::CACHE_FILE_NATIVE) {
+                    Parser::ScenarioStructureBSP::scan_padding(tag, tag.get_base_struct<HEK::ScenarioStructureBSPCompiledHeader>().pointer, &findings[t]);
+                    return;
+                }
+
+                switch(tci) {
+                    DO_BASED_ON_TAG_CLASS
+                    default: break;
+                }
+
+                #undef DO_TAG_CLASS
+            }
+            catch(std::exception &e) {
+                errors[t] = e.what();
+            }
+        }, scan_options.thread_count);
+
+        if(multiple_maps) {
+            oprintf("%s:\n", map_path);
+        }
+        for(std::size_t t = 0; t < tag_count; t++) {
+            oprintf("%s", findings[t].c_str());
+            if(!errors[t].empty()) {
+                eprintf_error("Failed to scan tag #%zu: %s", t, errors[t].c_str());
+                failed = true;
+            }
         }
     }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -3,15 +3,24 @@
 #include <filesystem>
 #include "../command_line_option.hpp"
 #include <invader/printf.hpp>
+#include <invader/error.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/sound/sound_reader.hpp>
 #include <invader/version.hpp>
+#include <invader/thread_pool.hpp>
+#include <invader/memory_usage.hpp>
 #include <vorbis/vorbisenc.h>
 #include <samplerate.h>
 #include <atomic>
-#include <thread>
+#include <functional>
+#include <exception>
+#include <utility>
+#include <map>
+#include <algorithm>
+#include <cstring>
 
 using namespace Invader;
 using namespace Invader::HEK;
@@ -27,13 +36,143 @@ struct SoundOptions {
     std::optional<SoundClass> sound_class;
     std::optional<std::uint32_t> sample_rate;
     std::optional<std::uint16_t> bitrate;
-    std::size_t max_threads = std::thread::hardware_concurrency() < 1 ? 1 : std::thread::hardware_concurrency();
+    SoundEncoder::ResampleQuality resample_quality = SoundEncoder::ResampleQuality::RESAMPLE_QUALITY_BEST;
+    std::size_t adpcm_lookahead = 3;
+
+    // Directory to store fingerprints in for reusing unchanged permutations
+    std::optional<std::filesystem::path> cache;
+
+    // Batch expressions
+    std::vector<std::string> batch;
+    std::vector<std::string> batch_exclude;
+    std::size_t max_threads = ThreadPool::get_shared_thread_count();
+};
+
+// Output of encoding a permutation (or a piece of a split permutation)
+struct EncodedSoundPermutation {
+    std::vector<std::byte> samples;
+    std::vector<std::byte> mouth_data;
+    std::size_t buffer_size = 0;
+};
+
+// Increment this if what goes into a fingerprint changes
+static constexpr char SOUND_FINGERPRINT_MAGIC[8] = { 'i', 'n', 'v', 's', 'n', 'f', 'p', '1' };
+
+struct SoundFingerprintFileHeader {
+    char magic[sizeof(SOUND_FINGERPRINT_MAGIC)];
+
+    // Hash of the size and modification time of the tag that was made
+    std::uint64_t tag_stamp;
+
+    // Number of permutation fingerprints that follow
+    std::uint64_t permutation_count;
+};
+
+struct SoundPermutationFingerprint {
+    char pitch_range[sizeof(HEK::TagString)];
+    char permutation[sizeof(HEK::TagString)];
+
+    // Hash of the permutation's source samples and options
+    std::uint64_t fingerprint;
 };
 
+// Load the fingerprints of the permutations we made last time, but only if the tag hasn't been touched since
+static std::map<std::pair<std::string, std::string>, std::uint64_t> load_sound_fingerprints(const std::filesystem::path &fingerprint_path, const std::filesystem::path &tag_path) {
+    std::map<std::pair<std::string, std::string>, std::uint64_t> fingerprints;
+
+    auto fingerprint_file = File::open_file(fingerprint_path);
+    auto tag_stamp = File::stamp_file(tag_path);
+    if(!fingerprint_file.has_value() || !tag_stamp.has_value() || fingerprint_file->size() < sizeof(SoundFingerprintFileHeader)) {
+        return fingerprints;
+    }
+
+    SoundFingerprintFileHeader header;
+    std::memcpy(&header, fingerprint_file->data(), sizeof(header));
+    if(std::memcmp(header.magic, SOUND_FINGERPRINT_MAGIC, sizeof(SOUND_FINGERPRINT_MAGIC)) != 0 || header.tag_stamp != *tag_stamp || fingerprint_file->size() != sizeof(header) + header.permutation_count * sizeof(SoundPermutationFingerprint)) {
+        return fingerprints;
+    }
+
+    for(std::size_t i = 0; i < header.permutation_count; i++) {
+        SoundPermutationFingerprint fingerprint;
+        std::memcpy(&fingerprint, fingerprint_file->data() + sizeof(header) + i * sizeof(fingerprint), sizeof(fingerprint));
+        fingerprint.pitch_range[sizeof(fingerprint.pitch_range) - 1] = 0;
+        fingerprint.permutation[sizeof(fingerprint.permutation) - 1] = 0;
+        fingerprints[{ fingerprint.pitch_range, fingerprint.permutation }] = fingerprint.fingerprint;
+    }
+
+    return fingerprints;
+}
+
+static void save_sound_fingerprints(const std::filesystem::path &fingerprint_path, const std::filesystem::path &tag_path, const std::vector<SoundPermutationFingerprint> &fingerprints) {
+    auto tag_stamp = File::stamp_file(tag_path);
+    if(!tag_stamp.has_value()) {
+        return;
+    }
+
+    SoundFingerprintFileHeader header = {};
+    std::memcpy(header.magic, SOUND_FINGERPRINT_MAGIC, sizeof(SOUND_FINGERPRINT_MAGIC));
+    header.tag_stamp = *tag_stamp;
+    header.permutation_count = fingerprints.size();
+
+    std::vector<std::byte> fingerprint_data(sizeof(header) + fingerprints.size() * sizeof(SoundPermutationFingerprint));
+    std::memcpy(fingerprint_data.data(), &header, sizeof(header));
+    if(!fingerprints.empty()) {
+        std::memcpy(fingerprint_data.data() + sizeof(header), fingerprints.data(), fingerprints.size() * sizeof(SoundPermutationFingerprint));
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(fingerprint_path.parent_path(), ec);
+    if(!File::save_file(fingerprint_path, fingerprint_data)) {
+        eprintf_warn("Failed to write to %s", fingerprint_path.string().c_str());
+    }
+}
+
+// Get the encoded pieces of a permutation (following its chain if it was split) from a sound tag
+template<typename PitchRange> static bool find_encoded_permutation(const std::vector<PitchRange> &pitch_ranges, const char *pitch_range_name, const char *permutation_name, SoundFormat format, std::vector<EncodedSoundPermutation> &pieces) {
+    for(auto &pitch_range : pitch_ranges) {
+        if(std::strcmp(pitch_range.name.string, pitch_range_name) != 0) {
+            continue;
+        }
+
+        std::size_t permutation_count = pitch_range.permutations.size();
+        std::size_t actual_permutation_count = std::min(static_cast<std::size_t>(pitch_range.actual_permutation_count), permutation_count);
+        for(std::size_t i = 0; i < actual_permutation_count; i++) {
+            if(std::strcmp(pitch_range.permutations[i].name.string, permutation_name) != 0) {
+                continue;
+            }
+
+            // Anything other than Ogg Vorbis is split losslessly after it's encoded, so put it back together
+            std::size_t piece_count = 0;
+            for(std::size_t index = i; index != NULL_INDEX; index = pitch_range.permutations[index].next_permutation_index) {
+                // Don't loop forever on a broken chain
+                if(index >= permutation_count || piece_count++ >= permutation_count) {
+                    pieces.clear();
+                    return false;
+                }
+
+                auto &permutation = pitch_range.permutations[index];
+                if(format != SoundFormat::SOUND_FORMAT_OGG_VORBIS && !pieces.empty()) {
+                    pieces[0].samples.insert(pieces[0].samples.end(), permutation.samples.begin(), permutation.samples.end());
+                }
+                else {
+                    auto &piece = pieces.emplace_back();
+                    piece.samples = permutation.samples;
+                    piece.mouth_data = permutation.mouth_data;
+                    piece.buffer_size = permutation.buffer_size;
+                }
+            }
+
+            return !pieces.empty();
+        }
+    }
+
+    return false;
+}
+
 static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count);
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size);
+static void process_permutation(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, SoundEncoder::ResampleQuality resample_quality);
 
-template<typename T> static std::vector<std::byte> make_sound_tag(const std::filesystem::path &tag_path, const std::filesystem::path &data_path, SoundOptions &sound_options) {
+template<typename T> static std::vector<std::byte> make_sound_tag(const std::filesystem::path &tag_path, const std::filesystem::path &data_path, SoundOptions &sound_options, const std::optional<std::filesystem::path> &fingerprint_path, std::vector<SoundPermutationFingerprint> &fingerprints) {
     static constexpr std::size_t XBOX_ADPCM_SPLIT_SIZE = 65520;
     static constexpr std::size_t SPLIT_BUFFER_SIZE = 0x38E00;
     static constexpr std::size_t MAX_PERMUTATIONS = UINT16_MAX - 1;
@@ -44,7 +183,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     if(std::filesystem::exists(tag_path)) {
         if(std::filesystem::is_directory(tag_path)) {
             eprintf_error("A directory exists at %s where a file was expected", tag_path.string().c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidTagPathException();
         }
         auto sound_file = File::open_file(tag_path);
         if(sound_file.has_value()) {
@@ -54,7 +193,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             }
             catch(std::exception &e) {
                 eprintf_error("An error occurred while attempting to read %s", tag_path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidTagDataException();
             }
         }
         if(sound_options.sound_class.has_value()) {
@@ -67,7 +206,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     else {
         if(!sound_options.sound_class.has_value()) {
             eprintf_error("A sound class is required when generating new sound tags");
-            std::exit(EXIT_FAILURE);
+            throw InvalidArgumentException();
         }
         sound_tag.sound_class = *sound_options.sound_class;
     }
@@ -91,10 +230,10 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             break;
         case SoundFormat::SOUND_FORMAT_IMA_ADPCM:
             eprintf_error("IMA ADPCM is unsupported");
-            std::exit(EXIT_FAILURE);
+            throw InvalidArgumentException();
         default:
             eprintf_error("Unsupported audio codec");
-            std::exit(EXIT_FAILURE);
+            throw InvalidArgumentException();
     }
 
     auto &format = sound_tag.format;
@@ -107,7 +246,17 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Error if bullshit compression levels were given
     if(sound_options.compression_level > 1.0F || sound_options.compression_level < 0.0F) {
         eprintf_error("Compression level (%.05f) is outside of the allowed range of 0.0 to 1.0", *sound_options.compression_level);
-        std::exit(EXIT_FAILURE);
+        throw InvalidArgumentException();
+    }
+
+    // If we made this tag last time, we can reuse the permutations that haven't changed from it
+    std::map<std::pair<std::string, std::string>, std::uint64_t> previous_fingerprints;
+    decltype(sound_tag.pitch_ranges) previous_pitch_ranges;
+    if(fingerprint_path.has_value()) {
+        previous_fingerprints = load_sound_fingerprints(*fingerprint_path, tag_path);
+        if(!previous_fingerprints.empty()) {
+            previous_pitch_ranges = sound_tag.pitch_ranges;
+        }
     }
 
     // Clear the old one
@@ -143,11 +292,11 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     // Is it bullshit?
     if(contains_files && contains_directories) {
         eprintf_error("Data directory must have only directories or only files");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
     if(!contains_files && !contains_directories) {
         eprintf_error("Data directory is empty");
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
     std::uint16_t highest_channel_count = 0;
@@ -168,19 +317,19 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             auto &path = f.path();
             if(!f.is_directory()) {
                 eprintf_error("Unexpected file %s", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
             auto &pitch_range = pitch_ranges.emplace_back(std::vector<SoundReader::Sound>(), path.filename().string());
             populate_pitch_range(pitch_range.first, path, highest_sample_rate, highest_channel_count);
             if(i == NULL_INDEX) {
                 eprintf_error("%u or more pitch ranges are present", NULL_INDEX);
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
 
             // Make sure we have stuff
             if(pitch_range.first.size() == 0) {
                 eprintf_error("No permutations found in %s", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
         }
     }
@@ -212,7 +361,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     }
     else {
         eprintf_error("Unsupported sample rate %u", highest_sample_rate);
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
     // Sound tags currently only support single and dual channels
@@ -224,41 +373,87 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     }
     else {
         eprintf_error("Unsupported channel count %u", highest_channel_count);
-        std::exit(EXIT_FAILURE);
+        throw InvalidInputSoundException();
     }
 
-    // Resample permutations when needed
-    oprintf("Processing sounds...\n");
-    oflush();
-    std::size_t total_sound_count = 0;
-    std::atomic<std::size_t> thread_count = 0;
+    bool fit_adpcm_block_size = sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE;
+    auto resample_quality = sound_options.resample_quality;
 
-    // Wait until we have 0 threads working
-    auto wait_until_threads_are_done = [&thread_count]() {
-        while(thread_count > 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
+    // Each permutation (and each piece of a split permutation) is encoded into its own slot, so nothing needs to be locked until everything is merged into the tag afterward
+    std::size_t pitch_range_count = pitch_ranges.size();
+    std::vector<std::vector<std::vector<EncodedSoundPermutation>>> encoded_permutations(pitch_range_count);
+    std::vector<std::vector<bool>> reused_permutations(pitch_range_count);
+    std::size_t reused_permutation_count = 0;
+
+    // Fingerprint everything that goes into encoding each permutation so we can tell which ones haven't changed since last time
+    FNV1AHash options_fingerprint;
+    if(fingerprint_path.has_value()) {
+        const char *version = full_version();
+        options_fingerprint.add_bytes(version, std::strlen(version));
+        options_fingerprint.add_value(format);
+        options_fingerprint.add_value(sound_class);
+        options_fingerprint.add_value(split);
+        options_fingerprint.add_value(fit_adpcm_block_size);
+        options_fingerprint.add_value(highest_sample_rate);
+        options_fingerprint.add_value(highest_channel_count);
+        options_fingerprint.add_value(sound_options.compression_level);
+        options_fingerprint.add_value(sound_options.bitrate);
+        options_fingerprint.add_value(sound_options.resample_quality);
+        options_fingerprint.add_value(sound_options.adpcm_lookahead);
+    }
+
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        auto &permutations = pitch_ranges[pr].first;
+        encoded_permutations[pr].resize(permutations.size());
+        reused_permutations[pr].resize(permutations.size());
+        if(!fingerprint_path.has_value()) {
+            continue;
         }
-    };
 
-    // Wait until we have room for more threads
-    auto wait_until_threads_are_open = [&thread_count, &sound_options]() {
-        while(thread_count >= sound_options.max_threads) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1000));
+        for(std::size_t i = 0; i < permutations.size(); i++) {
+            auto &permutation = permutations[i];
+            auto &fingerprint = fingerprints.emplace_back();
+            std::strncpy(fingerprint.pitch_range, pitch_ranges[pr].second.c_str(), sizeof(fingerprint.pitch_range) - 1);
+            std::strncpy(fingerprint.permutation, permutation.name.c_str(), sizeof(fingerprint.permutation) - 1);
+
+            auto permutation_fingerprint = options_fingerprint;
+            permutation_fingerprint.add_value(permutation.sample_rate);
+            permutation_fingerprint.add_value(permutation.bits_per_sample);
+            permutation_fingerprint.add_value(permutation.channel_count);
+            permutation_fingerprint.add_value(permutation.pcm.size());
+            permutation_fingerprint.add_bytes(permutation.pcm.data(), permutation.pcm.size());
+            fingerprint.fingerprint = permutation_fingerprint.get();
+
+            auto previous_fingerprint = previous_fingerprints.find({ fingerprint.pitch_range, fingerprint.permutation });
+            if(previous_fingerprint != previous_fingerprints.end() && previous_fingerprint->second == fingerprint.fingerprint && find_encoded_permutation(previous_pitch_ranges, fingerprint.pitch_range, fingerprint.permutation, format, encoded_permutations[pr][i])) {
+                reused_permutations[pr][i] = true;
+                reused_permutation_count++;
+            }
         }
-    };
+    }
+    previous_pitch_ranges.clear();
 
-    // Process things!
-    for(auto &pitch_range : pitch_ranges) {
-        for(auto &permutation : pitch_range.first) {
+    // Resample permutations when needed
+    oprintf("Processing sounds...\n");
+    oflush();
+    std::size_t total_sound_count = 0;
+
+    // Process things! (on the shared thread pool, which other sound tags may be using too when batching)
+    std::vector<SoundReader::Sound *> permutations_to_process;
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        auto &permutations = pitch_ranges[pr].first;
+        for(std::size_t i = 0; i < permutations.size(); i++) {
             total_sound_count++;
-            wait_until_threads_are_open();
-            thread_count++;
-            std::thread(process_permutation_thread, &permutation, highest_sample_rate, format, highest_channel_count, &thread_count, sound_tag.flags & SoundFlagsFlag::SOUND_FLAGS_FLAG_FIT_TO_ADPCM_BLOCKSIZE).detach();
+
+            // Permutations we're reusing are already encoded
+            if(!reused_permutations[pr][i]) {
+                permutations_to_process.emplace_back(&permutations[i]);
+            }
         }
     }
-
-    // Wait until done
-    wait_until_threads_are_done();
+    ThreadPool::shared().parallel_for(permutations_to_process.size(), [&permutations_to_process, highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, resample_quality](std::size_t p) {
+        process_permutation(permutations_to_process[p], highest_sample_rate, format, highest_channel_count, fit_adpcm_block_size, resample_quality);
+    });
 
     // Remove pitch ranges that are present in the tag but not in what we found
     while(true) {
@@ -289,7 +484,6 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     }
 
     // Index read pitch ranges to output pitch range
-    std::size_t pitch_range_count = pitch_ranges.size();
     std::vector<std::size_t> pitch_range_index(pitch_range_count);
     for(std::size_t i = 0; i < pitch_range_count; i++) {
         auto &index = pitch_range_index[i];
@@ -355,21 +549,18 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
     if(is_dialogue && split) {
         eprintf_error("Split dialogue is unsupported.");
-        std::exit(EXIT_FAILURE);
+        throw InvalidArgumentException();
     }
 
-    // Make sure we don't completely blow things up
-    std::mutex encoding_mutex;
-
-    // Encode this
+    // Encode this; permutations (and pieces of split permutations) are all encoded at once afterward
+    std::vector<std::function<void ()>> encode_tasks;
     for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
-        encoding_mutex.lock();
         auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[pr]];
         auto &permutations = pitch_ranges[pr].first;
         auto actual_permutation_count = permutations.size();
         pitch_range.actual_permutation_count = actual_permutation_count;
         pitch_range.permutations.resize(actual_permutation_count);
-        encoding_mutex.unlock();
+        std::size_t total_permutation_count = actual_permutation_count;
 
         for(auto &p : pitch_range.permutations) {
             p.format = sound_tag.format;
@@ -386,7 +577,7 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
             std::size_t bytes_per_sample_all_channels = bytes_per_sample_one_channel * permutation.channel_count;
 
             // Encode a permutation
-            auto encode_permutation = [](auto *sound_tag, std::size_t pitch_range, std::size_t pitch_range_permutation, std::mutex *mutex, std::vector<std::byte> pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, SoundOptions *sound_options, std::atomic<std::size_t> *thread_count) {
+            auto encode_permutation = [](EncodedSoundPermutation *output, std::vector<std::byte> pcm, const SoundReader::Sound *permutation, bool is_dialogue, SoundFormat format, const SoundOptions *sound_options) {
                 auto generate_mouth_data = [&permutation](const std::vector<std::uint8_t> &pcm_8_bit) -> std::vector<std::byte> {
                     // Basically, take the sample rate, multiply by channel count, divide by tick rate (30 Hz), and round the result
                     std::size_t samples_per_tick = static_cast<std::size_t>((permutation->sample_rate * permutation->channel_count) / TICK_RATE + 0.5);
@@ -491,12 +682,6 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
 
                     // Encode to Vorbis in an Ogg container
                     case SoundFormat::SOUND_FORMAT_OGG_VORBIS: {
-                        if(sound_options->compression_level > 1.0F) {
-                            sound_options->compression_level = 1.0F;
-                        }
-                        else if(sound_options->compression_level < 0.0F) {
-                            sound_options->compression_level = 0.0F;
-                        }
                         if(sound_options->bitrate.has_value()) {
                             samples = Invader::SoundEncoder::encode_to_ogg_vorbis_cbr(pcm, permutation->bits_per_sample, permutation->channel_count, permutation->sample_rate, *sound_options->bitrate);
                         }
@@ -507,92 +692,123 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
                         break;
                     }
 
-                    // Encode to Xbox ADPCMeme
-                    case SoundFormat::SOUND_FORMAT_XBOX_ADPCM:
-                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count);
+                    // Encode to Xbox ADPCMeme (the chunks go on the same thread pool, so this doesn't start any more threads)
+                    case SoundFormat::SOUND_FORMAT_XBOX_ADPCM: {
+                        samples = Invader::SoundEncoder::encode_to_xbox_adpcm(pcm, permutation->bits_per_sample, permutation->channel_count, sound_options->adpcm_lookahead, sound_options->max_threads);
                         break;
+                    }
 
                     default:
                         eprintf_error("Invalid format. What?");
                         std::terminate();
                 }
 
-                // Set the default stuff
-                mutex->lock();
-                auto &p = sound_tag->pitch_ranges[pitch_range].permutations[pitch_range_permutation];
-                p.gain = 1.0F;
-                p.samples = samples;
-                p.buffer_size = buffer_size;
-                p.samples.shrink_to_fit();
-                p.mouth_data = mouth_data;
-                mutex->unlock();
-
-                // Finish up
-                (*thread_count)--;
+                output->samples = std::move(samples);
+                output->samples.shrink_to_fit();
+                output->buffer_size = buffer_size;
+                output->mouth_data = std::move(mouth_data);
             };
 
             // Split things we can't trivially split losslessly
-            if(split && enable_threading_split_permutation_encoding) {
-                std::size_t max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
-
-                std::size_t digested = 0;
-                while(permutation.pcm.size() > 0) {
-                    // Basically, if we haven't encoded anything, use the i-th permutation, otherwise make a new one as a copy
-                    encoding_mutex.lock();
-                    auto &p = digested == 0 ? pitch_range.permutations[i] : pitch_range.permutations.emplace_back(pitch_range.permutations[i]);
-                    encoding_mutex.unlock();
-                    std::size_t remaining_size = permutation.pcm.size();
-                    std::size_t permutation_size = remaining_size > max_split_size ? max_split_size : remaining_size;
-
-                    // Encode it
-                    auto *sample_data_start = permutation.pcm.data();
-                    auto sample_data = std::vector<std::byte>(sample_data_start, sample_data_start + permutation_size);
-                    permutation.pcm = std::vector<std::byte>(permutation.pcm.begin() + permutation_size, permutation.pcm.end());
-                    permutation.pcm.shrink_to_fit();
-                    digested += permutation_size;
-
-                    if(permutation.pcm.size() == 0) {
-                        p.next_permutation_index = NULL_INDEX;
-                    }
-                    else {
-                        std::size_t next_permutation = pitch_range.permutations.size();
-                        if(next_permutation > MAX_PERMUTATIONS) {
-                            encoding_mutex.lock();
-                            eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", next_permutation, MAX_PERMUTATIONS);
-                            std::exit(EXIT_FAILURE);
-                        }
-                        p.next_permutation_index = static_cast<Index>(next_permutation);
-                    }
-
-                    // Wait until we have threads cleared up
-                    wait_until_threads_are_open();
+            // Permutations we're reusing are already encoded, so they're left alone
+            auto &encoded_permutation = encoded_permutations[pr][i];
+            bool reused = reused_permutations[pr][i];
+            bool split_before_encoding = !reused && split && enable_threading_split_permutation_encoding;
+            std::size_t max_split_size = SPLIT_BUFFER_SIZE - (SPLIT_BUFFER_SIZE % bytes_per_sample_all_channels);
+            std::size_t pcm_size = permutation.pcm.size();
+            if(split_before_encoding) {
+                encoded_permutation.resize((pcm_size + max_split_size - 1) / max_split_size);
+            }
+            else if(!reused) {
+                encoded_permutation.resize(1);
+            }
 
-                    // Punch it
-                    thread_count++;
-                    std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(sample_data), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+            // The first piece goes in the i-th permutation, and the rest get appended to the end of the pitch range's permutations
+            if(encoded_permutation.size() > 1) {
+                total_permutation_count += encoded_permutation.size() - 1;
+                if(total_permutation_count > MAX_PERMUTATIONS + 1) {
+                    eprintf_error("Maximum number of total permutations (%zu > %zu) exceeded", total_permutation_count - 1, MAX_PERMUTATIONS);
+                    throw InvalidInputSoundException();
                 }
             }
-            else {
-                // Wait until we have threads cleared up
-                wait_until_threads_are_open();
 
-                // Punch it
-                thread_count++;
-                auto &p = pitch_range.permutations[i];
-                p.next_permutation_index = NULL_INDEX;
-                std::thread(encode_permutation, &sound_tag, pr, &p - pitch_range.permutations.data(), &encoding_mutex, std::move(permutation.pcm), &permutation, is_dialogue, format, &sound_options, &thread_count).detach();
+            if(split_before_encoding) {
+                for(std::size_t split_index = 0; split_index < encoded_permutation.size(); split_index++) {
+                    std::size_t digested = split_index * max_split_size;
+                    std::size_t permutation_size = std::min(pcm_size - digested, max_split_size);
+
+                    // Copy the piece when it's encoded so only the pieces being encoded are held twice
+                    auto *output = &encoded_permutation[split_index];
+                    encode_tasks.emplace_back([encode_permutation, output, digested, permutation_size, &permutation, is_dialogue, format, &sound_options]() {
+                        auto *sample_data_start = permutation.pcm.data() + digested;
+                        encode_permutation(output, std::vector<std::byte>(sample_data_start, sample_data_start + permutation_size), &permutation, is_dialogue, format, &sound_options);
+                    });
+                }
+            }
+            else if(!reused) {
+                auto *output = &encoded_permutation[0];
+                encode_tasks.emplace_back([encode_permutation, output, &permutation, is_dialogue, format, &sound_options]() {
+                    encode_permutation(output, std::move(permutation.pcm), &permutation, is_dialogue, format, &sound_options);
+                });
             }
 
             // Print sound info
-            encoding_mutex.lock();
             oprintf("    %-32s%2zu:%06.3f (%2zu-bit %6s %5zu Hz)\n", permutation.name.c_str(), static_cast<std::size_t>(seconds) / 60, std::fmod(seconds, 60.0), static_cast<std::size_t>(permutation.input_bits_per_sample), permutation.input_channel_count == 1 ? "mono" : "stereo", static_cast<std::size_t>(permutation.input_sample_rate));
+        }
+    }
+
+    // Punch it
+    ThreadPool::shared().parallel_for(encode_tasks.size(), [&encode_tasks](std::size_t t) {
+        encode_tasks[t]();
+    });
+    encode_tasks.clear();
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        for(auto &permutation : pitch_ranges[pr].first) {
             permutation.pcm = std::vector<std::byte>();
-            encoding_mutex.unlock();
         }
     }
 
-    // Wait until we have 0 threads left
-    wait_until_threads_are_done();
+    if(reused_permutation_count > 0) {
+        oprintf("Reused %zu unchanged permutation%s\n", reused_permutation_count, reused_permutation_count == 1 ? "" : "s");
+    }
+
+    // Put everything in the tag, chaining the pieces of split permutations together
+    for(std::size_t pr = 0; pr < pitch_range_count; pr++) {
+        auto &pitch_range = sound_tag.pitch_ranges[pitch_range_index[pr]];
+        auto &encoded_pitch_range = encoded_permutations[pr];
+        auto actual_permutation_count = encoded_pitch_range.size();
+
+        for(std::size_t i = 0; i < actual_permutation_count; i++) {
+            auto &encoded_permutation = encoded_pitch_range[i];
+            if(encoded_permutation.empty()) {
+                continue;
+            }
+
+            // The first piece goes in the i-th permutation, and the rest are copies of it
+            auto permutation_template = pitch_range.permutations[i];
+            permutation_template.samples.clear();
+            permutation_template.mouth_data.clear();
+            std::size_t previous_index = i;
+
+            for(std::size_t split_index = 0; split_index < encoded_permutation.size(); split_index++) {
+                std::size_t index = split_index == 0 ? i : pitch_range.permutations.size();
+                if(split_index != 0) {
+                    pitch_range.permutations.emplace_back(permutation_template);
+                    pitch_range.permutations[previous_index].next_permutation_index = static_cast<Index>(index);
+                }
+
+                auto &encoded = encoded_permutation[split_index];
+                auto &p = pitch_range.permutations[index];
+                p.gain = 1.0F;
+                p.samples = std::move(encoded.samples);
+                p.buffer_size = encoded.buffer_size;
+                p.mouth_data = std::move(encoded.mouth_data);
+                p.next_permutation_index = NULL_INDEX;
+                previous_index = index;
+            }
+        }
+    }
+    encoded_permutations.clear();
 
     // Next, if we can split losslessly, do it
     if(split && !enable_threading_split_permutation_encoding) {
@@ -642,6 +858,98 @@ template<typename T> static std::vector<std::byte> make_sound_tag(const std::fil
     return sound_tag_data;
 }
 
+static int make_sound(std::string halo_tag_path, SoundOptions sound_options) {
+    MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_SOUND_PCM);
+    
+    // Remove trailing slashes and make sure a data directory exists
+    halo_tag_path = Invader::File::remove_trailing_slashes(halo_tag_path);
+    auto data_path = std::filesystem::path(sound_options.data) / halo_tag_path;
+    if(!std::filesystem::is_directory(data_path)) {
+        eprintf_error("No directory exists at %s", data_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Generate sound tag
+    std::vector<std::byte> sound_tag_data;
+    auto tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".sound");
+
+    std::optional<std::filesystem::path> fingerprint_path;
+    std::vector<SoundPermutationFingerprint> fingerprints;
+    if(sound_options.cache.has_value()) {
+        fingerprint_path = std::filesystem::path(*sound_options.cache / halo_tag_path) += ".fingerprint";
+    }
+
+    try {
+        sound_tag_data = make_sound_tag<Parser::Sound>(tag_path, data_path, sound_options, fingerprint_path, fingerprints);
+    }
+    catch(std::exception &e) {
+        eprintf_error("Failed to create sound tag due to an exception error: %s", e.what());
+        return EXIT_FAILURE;
+    }
+
+    // Create missing directories if needed
+    std::error_code ec;
+    std::filesystem::create_directories(tag_path.parent_path(), ec);
+
+    // Save
+    if(!Invader::File::save_file(tag_path.string().c_str(), sound_tag_data)) {
+        eprintf_error("Failed to save %s", tag_path.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Remember what we made it from
+    if(fingerprint_path.has_value()) {
+        save_sound_fingerprints(*fingerprint_path, tag_path, fingerprints);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int make_batch(const SoundOptions &sound_options) {
+    // Find every sound tag we're remaking along with how much audio is in its data directory
+    std::vector<std::pair<std::string, std::uintmax_t>> sounds;
+    std::error_code ec;
+    File::PathMatcher batch_matcher(sound_options.batch, sound_options.batch_exclude);
+    for(auto &t : File::load_virtual_tag_folder({ sound_options.tags })) {
+        if(t.tag_fourcc != TagFourCC::TAG_FOURCC_SOUND || !batch_matcher.matches(t.tag_path.c_str())) {
+            continue;
+        }
+
+        auto sound_tag = std::filesystem::path(File::halo_path_to_preferred_path(t.tag_path)).replace_extension().string();
+        auto data_path = sound_options.data / sound_tag;
+        if(!std::filesystem::is_directory(data_path)) {
+            continue;
+        }
+
+        std::uintmax_t data_size = 0;
+        for(auto &i : std::filesystem::recursive_directory_iterator(data_path, ec)) {
+            if(i.is_regular_file()) {
+                data_size += i.file_size(ec);
+            }
+        }
+        sounds.emplace_back(sound_tag, data_size);
+    }
+
+    // Start the longest sounds first so the shorter ones fill in around them rather than one long sound holding up everything at the end
+    std::stable_sort(sounds.begin(), sounds.end(), [](auto &a, auto &b) { return a.second > b.second; });
+
+    // Every sound is resampled and encoded on the shared thread pool, so there are only ever --threads threads doing the heavy lifting no matter how many sounds are being made at once
+    std::atomic<std::size_t> made = 0;
+    ThreadPool::shared().parallel_for(sounds.size(), [&sounds, &sound_options, &made](std::size_t s) {
+        auto &sound_tag = sounds[s].first;
+        if(make_sound(sound_tag, sound_options) != EXIT_SUCCESS) {
+            eprintf_error("Failed to make %s", sound_tag.c_str());
+        }
+        else {
+            oprintf_success("Made %s", sound_tag.c_str());
+            made++;
+        }
+    });
+
+    oprintf("Made %zu of %zu sound%s\n", made.load(), sounds.size(), sounds.size() == 1 ? "" : "s");
+    return made == sounds.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, const char **argv) {
     set_up_color_term();
     
@@ -652,6 +960,8 @@ int main(int argc, const char **argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
         CommandLineOption("split", 's', 0, "Split permutations into 227.5 KiB chunks. This is necessary for longer sounds (e.g. music) when being played in the original Halo engine."),
         CommandLineOption("no-split", 'S', 0, "Do not split permutations."),
         CommandLineOption("format", 'F', 1, "Set the format. Can be: 16-bit_pcm, ogg_vorbis, or xbox_adpcm. Default: 16-bit_pcm", "<fmt>"),
@@ -660,13 +970,16 @@ int main(int argc, const char **argv) {
         CommandLineOption("compress-level", 'l', 1, "Set the compression level. This can be between 0.0 and 1.0. For Ogg Vorbis, higher levels result in better quality but worse sizes. Default: 0.8", "<lvl>"),
         CommandLineOption("bitrate", 'R', 1, "Set the bitrate in kilobits per second. This only applies to vorbis.", "<br>"),
         CommandLineOption("class", 'c', 1, "Set the class. This is required when generating new sounds. Can be: ambient_computers, ambient_machinery, ambient_nature, device_computers, device_door, device_force_field, device_machinery, device_nature, first_person_damage, game_event, music, object_impacts, particle_impacts, projectile_impact, projectile_detonation, scripted_dialog_force_unspatialized, scripted_dialog_other, scripted_dialog_player, scripted_effect, slow_particle_impacts, unit_dialog, unit_footsteps, vehicle_collision, vehicle_engine, weapon_charge, weapon_empty, weapon_fire, weapon_idle, weapon_overheat, weapon_ready, weapon_reload", "<class>"),
-        CommandLineOption("threads", 'j', 1, "Set the number of threads to use for parallel resampling and encoding. Default: CPU thread count")
+        CommandLineOption("adpcm-lookahead", 'L', 1, "Set how many samples to look ahead when encoding Xbox ADPCM. Higher values are slower but may result in better quality. This does not save in .sound tags. This can be between 0 and 8. Default: 3", "<#>"),
+        CommandLineOption("resampler", 'q', 1, "Set the quality of resampling. Lower qualities are faster. This does not save in .sound tags. Can be: linear, fast, medium, best. Default: best", "<quality>"),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
+        CommandLineOption("cache", 'k', 1, "Store a fingerprint of each permutation's source audio and options in this directory. Permutations that haven't changed since the tag was last made are reused from the tag instead of being encoded again.", "<dir>")
     };
 
     static constexpr char DESCRIPTION[] = "Create or modify a sound tag.";
-    static constexpr char USAGE[] = "[options] <sound-tag>";
+    static constexpr char USAGE[] = "[options] <-b <expr> | <sound-tag>>";
 
-    auto remaining_arguments = CommandLineOption::parse_arguments<SoundOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, sound_options, [](char opt, const std::vector<const char *> &arguments, auto &sound_options) {
+    auto remaining_arguments = CommandLineOption::parse_arguments<SoundOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, sound_options, [](char opt, const std::vector<const char *> &arguments, auto &sound_options) {
         switch(opt) {
             case 'd':
                 sound_options.data = arguments[0];
@@ -685,17 +998,55 @@ int main(int argc, const char **argv) {
                 break;
 
             case 'j':
+                sound_options.max_threads = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
+
+            case 'S':
+                sound_options.split = false;
+                break;
+
+            case 'k':
+                sound_options.cache = arguments[0];
+                break;
+
+            case 'b':
+                sound_options.batch.emplace_back(arguments[0]);
+                break;
+
+            case 'e':
+                sound_options.batch_exclude.emplace_back(arguments[0]);
+                break;
+
+            case 'L':
                 try {
-                    sound_options.max_threads = std::stoul(arguments[0]);
+                    sound_options.adpcm_lookahead = std::stoul(arguments[0]);
+                    if(sound_options.adpcm_lookahead > 8) {
+                        throw std::exception();
+                    }
                 }
                 catch(std::exception &) {
-                    eprintf_error("Invalid number of threads %s\n", arguments[0]);
+                    eprintf_error("Invalid ADPCM lookahead %s (should be between 0 and 8)", arguments[0]);
                     std::exit(EXIT_FAILURE);
                 }
                 break;
 
-            case 'S':
-                sound_options.split = false;
+            case 'q':
+                if(std::strcmp(arguments[0], "linear") == 0) {
+                    sound_options.resample_quality = SoundEncoder::ResampleQuality::RESAMPLE_QUALITY_LINEAR;
+                }
+                else if(std::strcmp(arguments[0], "fast") == 0) {
+                    sound_options.resample_quality = SoundEncoder::ResampleQuality::RESAMPLE_QUALITY_FAST;
+                }
+                else if(std::strcmp(arguments[0], "medium") == 0) {
+                    sound_options.resample_quality = SoundEncoder::ResampleQuality::RESAMPLE_QUALITY_MEDIUM;
+                }
+                else if(std::strcmp(arguments[0], "best") == 0) {
+                    sound_options.resample_quality = SoundEncoder::ResampleQuality::RESAMPLE_QUALITY_BEST;
+                }
+                else {
+                    eprintf_error("Unknown resample quality %s", arguments[0]);
+                    std::exit(EXIT_FAILURE);
+                }
                 break;
 
             case 'R':
@@ -767,7 +1118,22 @@ int main(int argc, const char **argv) {
         return EXIT_FAILURE;
     }
 
-    // Get our paths and make sure a data directory exists
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(sound_options.max_threads);
+
+    auto uses_batching = !(sound_options.batch.empty() && sound_options.batch_exclude.empty());
+    if(uses_batching != remaining_arguments.empty()) {
+        eprintf_error("Expected a sound tag path OR batching (not both)");
+        return EXIT_FAILURE;
+    }
+
+    if(uses_batching) {
+        auto result = make_batch(sound_options);
+        MemoryUsage::print_counters();
+        return result;
+    }
+
+    // Get our paths
     std::string halo_tag_path;
     if(sound_options.fs_path) {
         auto tag_path_maybe = Invader::File::file_path_to_tag_path(remaining_arguments[0], sound_options.tags);
@@ -775,80 +1141,70 @@ int main(int argc, const char **argv) {
             eprintf_error("Cannot find %s in %s", remaining_arguments[0], sound_options.tags.string().c_str());
             return EXIT_FAILURE;
         }
+        halo_tag_path = std::filesystem::path(*tag_path_maybe).replace_extension().string();
     }
     else {
         halo_tag_path = remaining_arguments[0];
     }
 
-    // Remove trailing slashes
-    halo_tag_path = Invader::File::remove_trailing_slashes(halo_tag_path);
-    auto data_path = std::filesystem::path(sound_options.data) / halo_tag_path;
-    if(!std::filesystem::is_directory(data_path)) {
-        eprintf_error("No directory exists at %s", data_path.string().c_str());
-        return EXIT_FAILURE;
-    }
-
-    // Generate sound tag
-    std::vector<std::byte> sound_tag_data;
-    auto tag_path = std::filesystem::path(sound_options.tags) / (halo_tag_path + ".sound");
-
-    try {
-        sound_tag_data = make_sound_tag<Parser::Sound>(tag_path, data_path, sound_options);
-    }
-    catch(std::exception &e) {
-        eprintf_error("Failed to create sound tag due to an exception error: %s", e.what());
-        return EXIT_FAILURE;
-    }
-
-    // Create missing directories if needed
-    std::error_code ec;
-    std::filesystem::create_directories(tag_path.parent_path(), ec);
-
-    // Save
-    if(!Invader::File::save_file(tag_path.string().c_str(), sound_tag_data)) {
-        eprintf_error("Failed to save %s", tag_path.string().c_str());
-        return EXIT_FAILURE;
-    }
+    auto result = make_sound(halo_tag_path, sound_options);
+    MemoryUsage::print_counters();
+    return result;
 }
 
 static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations, const std::filesystem::path &directory, std::uint32_t &highest_sample_rate, std::uint16_t &highest_channel_count) {
+    // Find everything to load first so it can all be decoded at once
+    std::vector<std::pair<std::filesystem::path, std::string>> files;
     for(auto &wav : std::filesystem::directory_iterator(directory)) {
         // Skip directories
         auto path = wav.path();
         if(wav.is_directory()) {
             eprintf_error("Unexpected directory %s", path.string().c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         auto extension = path.extension().string();
         for(auto &c : extension) {
             c = std::tolower(c);
         }
+        if(extension != ".wav" && extension != ".wave" && extension != ".flac") {
+            eprintf_error("Unsupported input file %s.\nSupported input formats are Free Lossless Audio Codec (.flac) or Waveform Audio (.wav, .wave).", path.string().c_str());
+            throw InvalidInputSoundException();
+        }
+        files.emplace_back(std::move(path), std::move(extension));
+    }
 
-        // Get the sound
-        SoundReader::Sound sound = {};
+    // Get the sounds; decoding (especially FLAC) is slow, so do it on the thread pool
+    std::vector<SoundReader::Sound> sounds(files.size());
+    ThreadPool::shared().parallel_for(files.size(), [&files, &sounds](std::size_t f) {
+        auto &[path, extension] = files[f];
+        auto &sound = sounds[f];
         try {
-            if(extension == ".wav" || extension == ".wave") {
-                sound = SoundReader::sound_from_wav_file(path);
-            }
-            else if(extension == ".flac") {
+            if(extension == ".flac") {
                 sound = SoundReader::sound_from_flac_file(path);
             }
             else {
-                eprintf_error("Unsupported input file %s.\nSupported input formats are Free Lossless Audio Codec (.flac) or Waveform Audio (.wav, .wave).", path.string().c_str());
-                std::exit(EXIT_FAILURE);
+                sound = SoundReader::sound_from_wav_file(path);
             }
         }
         catch(std::exception &e) {
             eprintf_error("Failed to load %s: %s", path.string().c_str(), e.what());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
+        // Make it small
+        sound.pcm.shrink_to_fit();
+    });
+
+    for(std::size_t f = 0; f < files.size(); f++) {
+        auto &[path, extension] = files[f];
+        auto &sound = sounds[f];
+
         // Get the permutation name
         auto filename = path.filename().string();
         sound.name = filename.substr(0, filename.size() - extension.size());
         if(sound.name.size() >= sizeof(HEK::TagString)) {
             eprintf_error("Permutation name %s exceeds the maximum permutation name size (%zu >= %zu)", sound.name.c_str(), sound.name.size(), sizeof(HEK::TagString));
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
         // Lowercase it
@@ -867,16 +1223,13 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
         // Make sure we can actually work with this
         if(sound.channel_count > 2 || sound.channel_count < 1) {
             eprintf_error("Unsupported channel count %u in %s", static_cast<unsigned int>(sound.channel_count), path.string().c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
         if(sound.bits_per_sample % 8 != 0 || sound.bits_per_sample < 8 || sound.bits_per_sample > 24) {
             eprintf_error("Bits per sample (%u) is not divisible by 8 in %s (or is too small or too big)", static_cast<unsigned int>(sound.bits_per_sample), path.string().c_str());
-            std::exit(EXIT_FAILURE);
+            throw InvalidInputSoundException();
         }
 
-        // Make it small
-        sound.pcm.shrink_to_fit();
-
         // Add it
         std::size_t i;
         for(i = 0; i < permutations.size(); i++) {
@@ -885,21 +1238,18 @@ static void populate_pitch_range(std::vector<SoundReader::Sound> &permutations,
             }
             else if(sound.name == permutations[i].name) {
                 eprintf_error("Multiple permutations with the same name (%s) cannot be added", permutations[i].name.c_str());
-                std::exit(EXIT_FAILURE);
+                throw InvalidInputSoundException();
             }
         }
         permutations.insert(permutations.begin() + i, std::move(sound));
     }
 }
 
-static void process_permutation_thread(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, std::atomic<std::size_t> *thread_count, bool fit_adpcm_block_size) {
+static void process_permutation(SoundReader::Sound *permutation, std::uint16_t highest_sample_rate, SoundFormat format, std::uint16_t highest_channel_count, bool fit_adpcm_block_size, SoundEncoder::ResampleQuality resample_quality) {
     // Calculate some stuff
     std::size_t bytes_per_sample = permutation->bits_per_sample / 8;
     std::size_t sample_count = permutation->pcm.size() / bytes_per_sample;
 
-    // Mutex for errors
-    static std::mutex error_mutex;
-
     // Bits per sample doesn't match; we can fix that though
     if(bytes_per_sample != sizeof(std::uint16_t) && (format == SoundFormat::SOUND_FORMAT_16_BIT_PCM || format == SoundFormat::SOUND_FORMAT_XBOX_ADPCM)) {
         std::size_t new_bytes_per_sample = sizeof(std::uint16_t);
@@ -929,47 +1279,18 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
 
     // Stereo -> Mono (mixdown)
     else if(permutation->channel_count == 2 && highest_channel_count == 1) {
-        std::vector<std::byte> new_samples(sample_count * bytes_per_sample / 2);
-        std::byte *new_sample = new_samples.data();
-        const std::byte *old_sample = permutation->pcm.data();
-        const std::byte *old_sample_end = permutation->pcm.data() + permutation->pcm.size();
-
-        while(old_sample < old_sample_end) {
-            std::int32_t a = Invader::SoundEncoder::read_sample(old_sample, permutation->bits_per_sample);
-            std::int32_t b = Invader::SoundEncoder::read_sample(old_sample + bytes_per_sample, permutation->bits_per_sample);
-            std::int64_t ab = a + b;
-            Invader::SoundEncoder::write_sample(static_cast<std::int32_t>(ab / 2), new_sample, permutation->bits_per_sample);
-
-            old_sample += bytes_per_sample * 2;
-            new_sample += bytes_per_sample;
-        }
-
-        permutation->pcm = std::move(new_samples);
+        permutation->pcm = SoundEncoder::convert_stereo_to_mono(permutation->pcm, permutation->bits_per_sample);
         permutation->pcm.shrink_to_fit();
         permutation->channel_count = 1;
     }
 
+    // The channel count may have changed
+    sample_count = permutation->pcm.size() / bytes_per_sample;
+
     // Sample rate doesn't match; this can be fixed with resampling
     if(static_cast<double>(highest_sample_rate) != permutation->sample_rate) {
         double ratio = static_cast<double>(highest_sample_rate) / permutation->sample_rate;
-        std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-        std::vector<float> new_samples(float_samples.size() * ratio);
-        permutation->sample_rate = highest_sample_rate;
-
-        // Resample it
-        SRC_DATA data = {};
-        data.data_in = float_samples.data();
-        data.data_out = new_samples.data();
-        data.input_frames = float_samples.size() / permutation->channel_count;
-        data.output_frames = new_samples.size() / permutation->channel_count;
-        data.src_ratio = ratio;
-        int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-        if(res) {
-            error_mutex.lock();
-            eprintf_error("Failed to resample: %s", src_strerror(res));
-            std::exit(EXIT_FAILURE);
-        }
-        new_samples.resize(data.output_frames_gen * permutation->channel_count);
+        auto input_bits_per_sample = permutation->bits_per_sample;
 
         // Set stuff
         if(format == SoundFormat::SOUND_FORMAT_16_BIT_PCM) {
@@ -977,8 +1298,10 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
         }
         permutation->sample_rate = highest_sample_rate;
         permutation->bits_per_sample = bytes_per_sample * 8;
-        sample_count = new_samples.size();
-        permutation->pcm = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
+
+        // Resample it
+        permutation->pcm = SoundEncoder::resample(permutation->pcm.data(), sample_count, input_bits_per_sample, permutation->channel_count, ratio, permutation->bits_per_sample, SIZE_MAX, resample_quality);
+        sample_count = permutation->pcm.size() / bytes_per_sample;
     }
 
 
@@ -991,34 +1314,19 @@ static void process_permutation_thread(SoundReader::Sound *permutation, std::uin
         std::size_t delta = trip_adpcm_block_size + (adpcm_block_size - (sample_count % adpcm_block_size));
         if(delta > 0) {
             double ratio = delta / static_cast<double>(quad_adpcm_block_size);
-            std::vector<float> float_samples = SoundEncoder::convert_int_to_float(permutation->pcm, permutation->bits_per_sample);
-            std::vector<float> new_samples(float_samples.size() * ratio);
             auto new_quad = static_cast<std::size_t>(quad_adpcm_block_size * ratio);
 
-            // Resample it
-            SRC_DATA data = {};
-            data.data_in = float_samples.data();
-            data.data_out = new_samples.data();
-            data.input_frames = float_samples.size() / permutation->channel_count;
-            data.output_frames = new_samples.size() / permutation->channel_count;
-            data.src_ratio = ratio;
-            int res = src_simple(&data, SRC_SINC_BEST_QUALITY, permutation->channel_count);
-            if(res) {
-                error_mutex.lock();
-                eprintf_error("Failed to resample: %s", src_strerror(res));
-                std::exit(EXIT_FAILURE);
-            }
-
-            new_samples.resize(data.output_frames_gen * permutation->channel_count);
-            auto new_int_samples = SoundEncoder::convert_float_to_int(new_samples, permutation->bits_per_sample);
+            // Resample it, stopping once we have the samples we're replacing the first blocks with
+            auto new_int_samples = SoundEncoder::resample(permutation->pcm.data(), sample_count, permutation->bits_per_sample, permutation->channel_count, ratio, permutation->bits_per_sample, new_quad, resample_quality);
 
-            permutation->pcm.erase(permutation->pcm.begin(), permutation->pcm.begin() + quad_adpcm_block_size * bytes_per_sample);
-            permutation->pcm.insert(permutation->pcm.begin(), new_int_samples.begin(), new_int_samples.begin() + new_quad * bytes_per_sample);
+            std::vector<std::byte> new_pcm;
+            new_pcm.reserve(new_quad * bytes_per_sample + permutation->pcm.size() - quad_adpcm_block_size * bytes_per_sample);
+            new_pcm.insert(new_pcm.end(), new_int_samples.begin(), new_int_samples.begin() + new_quad * bytes_per_sample);
+            new_pcm.insert(new_pcm.end(), permutation->pcm.begin() + quad_adpcm_block_size * bytes_per_sample, permutation->pcm.end());
+            permutation->pcm = std::move(new_pcm);
 
             sample_count -= quad_adpcm_block_size;
             sample_count += new_quad;
         }
     }
-
-    (*thread_count)--;
 }
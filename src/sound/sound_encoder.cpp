@@ -7,6 +7,7 @@
 #include <vorbis/vorbisenc.h>
 #include <memory>
 #include <cstdint>
+#include <algorithm>
 #include <samplerate.h>
 
 extern "C" {
@@ -32,28 +33,71 @@ namespace Invader::SoundEncoder {
         return sample_value;
     }
 
-    std::vector<std::byte> convert_to_16_bit_pcm_big_endian(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
-        // Convert to 16 bits per sample if needed
-        std::vector<std::byte> pcm_to_use;
-        if(bits_per_sample != 16) {
-            pcm_to_use = convert_int_to_int(pcm, bits_per_sample, 16);
+    // Read and write samples with a fixed number of bytes so the loops around them can be unrolled and vectorized (0 = use bits_per_sample instead)
+    template<std::size_t BYTES> static inline std::int32_t read_fixed_sample(const std::byte *pcm, std::size_t bits_per_sample) noexcept {
+        if constexpr(BYTES == 0) {
+            return read_sample(pcm, bits_per_sample);
         }
         else {
-            pcm_to_use = pcm;
+            std::int32_t sample_value = static_cast<std::int8_t>(pcm[BYTES - 1]);
+            for(std::size_t b = BYTES - 1; b > 0; b--) {
+                sample_value = static_cast<std::int32_t>(static_cast<std::uint32_t>(sample_value) << 8) | static_cast<std::uint8_t>(pcm[b - 1]);
+            }
+            return sample_value;
+        }
+    }
+
+    template<std::size_t BYTES> static inline void write_fixed_sample(std::int32_t sample, std::byte *pcm, std::size_t bits_per_sample) noexcept {
+        if constexpr(BYTES == 0) {
+            write_sample(sample, pcm, bits_per_sample);
         }
+        else {
+            for(std::size_t b = 0; b < BYTES; b++) {
+                pcm[b] = static_cast<std::byte>((sample >> b * 8) & 0xFF);
+            }
+        }
+    }
 
-        // Swap endianness
-        std::uint16_t *samples = reinterpret_cast<std::uint16_t *>(pcm_to_use.data());
-        std::size_t sample_count = pcm_to_use.size() / sizeof(*samples);
-        for(std::size_t i = 0; i < sample_count; i++) {
-            auto sample = samples[i];
-            auto *sample_bytes = reinterpret_cast<std::byte *>(samples + i);
-            sample_bytes[1] = static_cast<std::byte>(sample & 0xFF);
-            sample_bytes[0] = static_cast<std::byte>((sample >> 8) & 0xFF);
+    // Call the function with the number of bytes per sample as a std::integral_constant so each conversion gets its own loop, picking it once per buffer instead of once per sample
+    template<typename Function> static inline void with_bytes_per_sample(std::size_t bytes_per_sample, Function &&function) {
+        switch(bytes_per_sample) {
+            case 1:
+                return function(std::integral_constant<std::size_t, 1>());
+            case 2:
+                return function(std::integral_constant<std::size_t, 2>());
+            case 3:
+                return function(std::integral_constant<std::size_t, 3>());
+            case 4:
+                return function(std::integral_constant<std::size_t, 4>());
+            default:
+                return function(std::integral_constant<std::size_t, 0>());
         }
+    }
+
+    std::vector<std::byte> convert_to_16_bit_pcm_big_endian(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
+        std::size_t bytes_per_sample = bits_per_sample / 8;
+        std::size_t sample_count = pcm.size() / bytes_per_sample;
+        std::vector<std::byte> samples(sample_count * sizeof(std::uint16_t));
+
+        auto *pcm_data = pcm.data();
+        auto *output_pcm_data = samples.data();
+
+        // Convert to 16 bits per sample and swap endianness in one go
+        with_bytes_per_sample(bytes_per_sample, [&]<std::size_t BYTES>(std::integral_constant<std::size_t, BYTES>) {
+            const std::size_t stride = BYTES == 0 ? bytes_per_sample : BYTES;
+            const std::int64_t divide_by = static_cast<std::int64_t>(1) << (stride * 8);
+            const std::int64_t multiply_by = static_cast<std::int64_t>(1) << 16;
+
+            for(std::size_t i = 0; i < sample_count; i++) {
+                std::int64_t sample = read_fixed_sample<BYTES>(pcm_data + i * stride, bits_per_sample);
+                auto new_sample = static_cast<std::uint16_t>(sample * multiply_by / divide_by);
+                output_pcm_data[i * 2] = static_cast<std::byte>((new_sample >> 8) & 0xFF);
+                output_pcm_data[i * 2 + 1] = static_cast<std::byte>(new_sample & 0xFF);
+            }
+        });
 
         // Done!
-        return pcm_to_use;
+        return samples;
     }
 
     std::vector<std::byte> convert_int_to_int(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t new_bits_per_sample) {
@@ -62,78 +106,191 @@ namespace Invader::SoundEncoder {
         std::size_t sample_count = pcm.size() / bytes_per_sample;
         std::vector<std::byte> samples(sample_count * new_bytes_per_sample);
 
-        // Calculate what we divide by
-        std::int64_t divide_by = 1 << bits_per_sample;
+        auto *pcm_data = pcm.data();
+        auto *output_pcm_data = samples.data();
+
+        with_bytes_per_sample(bytes_per_sample, [&]<std::size_t BYTES>(std::integral_constant<std::size_t, BYTES>) {
+            with_bytes_per_sample(new_bytes_per_sample, [&]<std::size_t NEW_BYTES>(std::integral_constant<std::size_t, NEW_BYTES>) {
+                const std::size_t stride = BYTES == 0 ? bytes_per_sample : BYTES;
+                const std::size_t new_stride = NEW_BYTES == 0 ? new_bytes_per_sample : NEW_BYTES;
+
+                // Calculate what we divide by
+                const std::int64_t divide_by = static_cast<std::int64_t>(1) << (stride * 8);
 
-        // Calculate what we multiply by
-        std::int64_t multiply_by = 1 << new_bits_per_sample;
+                // Calculate what we multiply by
+                const std::int64_t multiply_by = static_cast<std::int64_t>(1) << (new_stride * 8);
+
+                for(std::size_t i = 0; i < sample_count; i++) {
+                    // Get the new sample value
+                    std::int64_t sample = read_fixed_sample<BYTES>(pcm_data + i * stride, bits_per_sample);
+                    std::int64_t new_sample = sample * multiply_by / divide_by;
+                    write_fixed_sample<NEW_BYTES>(static_cast<std::int32_t>(new_sample), output_pcm_data + i * new_stride, new_bits_per_sample);
+                }
+            });
+        });
+
+        return samples;
+    }
+
+    std::vector<std::byte> convert_stereo_to_mono(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
+        std::size_t bytes_per_sample = bits_per_sample / 8;
+        std::size_t frame_count = pcm.size() / bytes_per_sample / 2;
+        std::vector<std::byte> samples(frame_count * bytes_per_sample);
 
         auto *pcm_data = pcm.data();
         auto *output_pcm_data = samples.data();
 
-        for(std::size_t i = 0; i < sample_count; i++) {
-            // Get the new sample value
-            std::int64_t sample = read_sample(pcm_data, bits_per_sample);
-            std::int64_t new_sample = sample * multiply_by / divide_by;
-            write_sample(static_cast<std::int32_t>(new_sample), output_pcm_data, new_bits_per_sample);
+        with_bytes_per_sample(bytes_per_sample, [&]<std::size_t BYTES>(std::integral_constant<std::size_t, BYTES>) {
+            const std::size_t stride = BYTES == 0 ? bytes_per_sample : BYTES;
 
-            // Add it
-            pcm_data += bytes_per_sample;
-            output_pcm_data += new_bytes_per_sample;
-        }
+            for(std::size_t i = 0; i < frame_count; i++) {
+                std::int64_t a = read_fixed_sample<BYTES>(pcm_data + i * stride * 2, bits_per_sample);
+                std::int64_t b = read_fixed_sample<BYTES>(pcm_data + i * stride * 2 + stride, bits_per_sample);
+                write_fixed_sample<BYTES>(static_cast<std::int32_t>((a + b) / 2), output_pcm_data + i * stride, bits_per_sample);
+            }
+        });
 
         return samples;
     }
 
     std::vector<float> convert_int_to_float(const std::vector<std::byte> &pcm, std::size_t bits_per_sample) {
-        std::vector<float> samples;
+        std::size_t sample_count = pcm.size() / (bits_per_sample / 8);
+        std::vector<float> samples(sample_count);
+        convert_int_to_float(pcm.data(), sample_count, bits_per_sample, samples.data());
+        return samples;
+    }
+
+    void convert_int_to_float(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, float *output) noexcept {
         std::size_t bytes_per_sample = bits_per_sample / 8;
-        std::size_t sample_count = pcm.size() / bytes_per_sample;
-        samples.reserve(sample_count);
 
-        // Calculate what we divide by
-        float divide_by = (1 << bits_per_sample) / 2.0F;
-        float divide_by_minus_one = divide_by - 1;
-        float divide_by_arr[2] = { divide_by_minus_one, divide_by };
+        with_bytes_per_sample(bytes_per_sample, [&]<std::size_t BYTES>(std::integral_constant<std::size_t, BYTES>) {
+            const std::size_t stride = BYTES == 0 ? bytes_per_sample : BYTES;
 
-        auto *pcm_data = pcm.data();
+            // Calculate what we divide by
+            const float divide_by = static_cast<float>(static_cast<std::int64_t>(1) << (stride * 8)) / 2.0F;
+            const float divide_by_minus_one = divide_by - 1;
 
-        for(std::size_t i = 0; i < sample_count; i++) {
-            std::int64_t sample = read_sample(pcm_data, bits_per_sample);
-            samples.emplace_back(sample / divide_by_arr[sample < 0]);
-            pcm_data += bytes_per_sample;
-        }
+            for(std::size_t i = 0; i < sample_count; i++) {
+                std::int64_t sample = read_fixed_sample<BYTES>(pcm + i * stride, bits_per_sample);
+                output[i] = sample / (sample < 0 ? divide_by : divide_by_minus_one);
+            }
+        });
+    }
 
+    std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample) {
+        std::vector<std::byte> samples(pcm.size() * (new_bits_per_sample / 8));
+        convert_float_to_int(pcm.data(), pcm.size(), new_bits_per_sample, samples.data());
         return samples;
     }
 
-    std::vector<std::byte> convert_float_to_int(const std::vector<float> &pcm, std::size_t new_bits_per_sample) {
-        std::size_t sample_count = pcm.size();
+    void convert_float_to_int(const float *pcm, std::size_t sample_count, std::size_t new_bits_per_sample, std::byte *output) noexcept {
         std::size_t bytes_per_sample = new_bits_per_sample / 8;
-        std::vector<std::byte> samples(sample_count * bytes_per_sample);
-        auto *sample_data = samples.data();
 
-        // Calculate what we multiply by
-        std::int64_t multiply_by = (1 << new_bits_per_sample) / 2.0;
-        std::int64_t multiply_by_minus_one = multiply_by - 1;
-        std::int64_t multiply_by_arr[2] = { multiply_by_minus_one, multiply_by };
+        with_bytes_per_sample(bytes_per_sample, [&]<std::size_t BYTES>(std::integral_constant<std::size_t, BYTES>) {
+            const std::size_t stride = BYTES == 0 ? bytes_per_sample : BYTES;
+
+            // Calculate what we multiply by
+            const std::int64_t multiply_by = (static_cast<std::int64_t>(1) << (stride * 8)) / 2;
+            const std::int64_t multiply_by_minus_one = multiply_by - 1;
+
+            for(std::size_t i = 0; i < sample_count; i++) {
+                std::int64_t sample = pcm[i] * (pcm[i] < 0 ? multiply_by : multiply_by_minus_one);
+
+                // Clamp
+                if(sample >= multiply_by_minus_one) {
+                    sample = multiply_by_minus_one;
+                }
+                else if(sample <= -multiply_by) {
+                    sample = -multiply_by;
+                }
+
+                write_fixed_sample<BYTES>(static_cast<std::int32_t>(sample), output + i * stride, new_bits_per_sample);
+            }
+        });
+    }
+
+    std::vector<std::byte> resample(const std::byte *pcm, std::size_t sample_count, std::size_t bits_per_sample, std::size_t channel_count, double ratio, std::size_t new_bits_per_sample, std::size_t max_sample_count, ResampleQuality quality) {
+        // Number of frames to convert to float and back at a time
+        static constexpr std::size_t RESAMPLE_BLOCK_FRAMES = 4096;
+
+        std::size_t bytes_per_sample = bits_per_sample / 8;
+        std::size_t new_bytes_per_sample = new_bits_per_sample / 8;
+        std::size_t frame_count = sample_count / channel_count;
+        std::size_t max_frame_count = std::min(static_cast<std::size_t>(sample_count * ratio), max_sample_count) / channel_count;
+
+        int converter_type;
+        switch(quality) {
+            case ResampleQuality::RESAMPLE_QUALITY_LINEAR:
+                converter_type = SRC_LINEAR;
+                break;
+            case ResampleQuality::RESAMPLE_QUALITY_FAST:
+                converter_type = SRC_SINC_FASTEST;
+                break;
+            case ResampleQuality::RESAMPLE_QUALITY_MEDIUM:
+                converter_type = SRC_SINC_MEDIUM_QUALITY;
+                break;
+            default:
+                converter_type = SRC_SINC_BEST_QUALITY;
+                break;
+        }
+
+        int error = 0;
+        std::unique_ptr<SRC_STATE, SRC_STATE *(*)(SRC_STATE *)> state(src_new(converter_type, static_cast<int>(channel_count), &error), src_delete);
+        if(!state) {
+            eprintf_error("Failed to resample: %s", src_strerror(error));
+            throw SoundEncodeFailureException();
+        }
+
+        std::vector<float> input_block(RESAMPLE_BLOCK_FRAMES * channel_count);
+        std::vector<float> output_block(static_cast<std::size_t>(RESAMPLE_BLOCK_FRAMES * ratio + 1) * channel_count);
+        std::vector<std::byte> output;
+        output.reserve(max_frame_count * channel_count * new_bytes_per_sample);
+
+        std::size_t frames_read = 0;
+        std::size_t output_frame_count = 0;
 
-        for(std::size_t i = 0; i < sample_count; i++) {
-            std::int64_t sample = pcm[i] * multiply_by_arr[pcm[i] < 0];
+        SRC_DATA data = {};
+        data.src_ratio = ratio;
+        data.data_in = input_block.data();
+        data.input_frames = 0;
 
-            // Clamp
-            if(sample >= multiply_by_minus_one) {
-                sample = multiply_by_minus_one;
+        while(output_frame_count < max_frame_count) {
+            // Refill the input once it's all been used
+            if(data.input_frames == 0 && frames_read < frame_count) {
+                std::size_t frames_to_read = std::min(RESAMPLE_BLOCK_FRAMES, frame_count - frames_read);
+                convert_int_to_float(pcm + frames_read * channel_count * bytes_per_sample, frames_to_read * channel_count, bits_per_sample, input_block.data());
+                frames_read += frames_to_read;
+                data.data_in = input_block.data();
+                data.input_frames = static_cast<long>(frames_to_read);
             }
-            else if(sample <= -multiply_by) {
-                sample = -multiply_by;
+            data.end_of_input = frames_read == frame_count;
+
+            data.data_out = output_block.data();
+            data.output_frames = static_cast<long>(std::min(output_block.size() / channel_count, max_frame_count - output_frame_count));
+
+            int res = src_process(state.get(), &data);
+            if(res) {
+                eprintf_error("Failed to resample: %s", src_strerror(res));
+                throw SoundEncodeFailureException();
             }
 
-            write_sample(static_cast<std::int32_t>(sample), sample_data, new_bits_per_sample);
-            sample_data += bytes_per_sample;
+            // Write what we got
+            std::size_t frames_generated = static_cast<std::size_t>(data.output_frames_gen);
+            std::size_t old_size = output.size();
+            output.resize(old_size + frames_generated * channel_count * new_bytes_per_sample);
+            convert_float_to_int(output_block.data(), frames_generated * channel_count, new_bits_per_sample, output.data() + old_size);
+            output_frame_count += frames_generated;
+
+            data.data_in += data.input_frames_used * channel_count;
+            data.input_frames -= data.input_frames_used;
+
+            // Nothing left to get out of it
+            if(data.end_of_input && data.input_frames == 0 && frames_generated == 0) {
+                break;
+            }
         }
 
-        return samples;
+        return output;
     }
 
     void write_sample(std::int32_t sample, std::byte *pcm, std::size_t bits_per_sample) noexcept {
@@ -6,6 +6,8 @@
 #include <FLAC/stream_encoder.h>
 #include <memory>
 #include <cstdint>
+#include <algorithm>
+#include <thread>
 
 namespace Invader::SoundEncoder {
     struct FLACHolder {
@@ -34,7 +36,15 @@ namespace Invader::SoundEncoder {
         return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
     }
 
-    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level) {
+    #if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+    // Below this many samples per channel for each thread, encoding on more threads costs more than it saves
+    static constexpr std::size_t MIN_SAMPLES_PER_FLAC_THREAD = 65536;
+
+    // libFLAC refuses any more threads than this
+    static constexpr std::uint32_t MAX_FLAC_THREADS = 128;
+    #endif
+
+    std::vector<std::byte> encode_to_flac(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::uint32_t channel_count, std::uint32_t sample_rate, std::uint32_t compression_level, std::uint32_t thread_count) {
         // First make our buffer
         std::vector<FLAC__int32> buffer;
         const auto *pcm_data = pcm.data();
@@ -61,6 +71,23 @@ namespace Invader::SoundEncoder {
         FLAC__stream_encoder_set_sample_rate(encoder, sample_rate);
         FLAC__stream_encoder_set_compression_level(encoder, compression_level);
 
+        // libFLAC 1.5 and later can encode frames on multiple threads, but only if it was built to; otherwise this fails and
+        // it just uses one thread
+        #if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+        if(thread_count == 0) {
+            thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+        }
+
+        // Short sounds don't have enough frames to keep more than one thread busy
+        std::size_t frame_count = sample_count / channel_count / MIN_SAMPLES_PER_FLAC_THREAD;
+        thread_count = static_cast<std::uint32_t>(std::min({static_cast<std::size_t>(thread_count), static_cast<std::size_t>(MAX_FLAC_THREADS), std::max(frame_count, static_cast<std::size_t>(1))}));
+        if(thread_count > 1) {
+            FLAC__stream_encoder_set_num_threads(encoder, thread_count);
+        }
+        #else
+        (void)thread_count;
+        #endif
+
         try {
             if(FLAC__stream_encoder_init_stream(encoder, write_flac_data, seek_flac_data, tell_flac_data, NULL, &holder) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
                 eprintf_error("Failed to init FLAC stream");
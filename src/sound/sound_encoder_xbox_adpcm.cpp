@@ -3,8 +3,10 @@
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
+#include <invader/thread_pool.hpp>
 #include <memory>
 #include <cstdint>
+#include <algorithm>
 
 extern "C" {
 #include "adpcm_xq/adpcm-lib.h"
@@ -21,29 +23,12 @@ namespace Invader::SoundEncoder {
         return calculate_samples_per_block() * channel_count;
     }
 
-    // From the MEK - I have no clue how to do this
-    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count) {
-        // Set some parameters
-        std::unique_ptr<std::vector<std::byte>> pcm_16_bit_data_ptr;
-        const std::int16_t *pcm_stream;
-        std::size_t bytes_per_sample = bits_per_sample / 8;
-        std::size_t sample_count = pcm.size() / bytes_per_sample / channel_count;
-        if(bits_per_sample != 16) {
-            pcm_16_bit_data_ptr = std::make_unique<std::vector<std::byte>>(convert_int_to_int(pcm, bits_per_sample, 16));
-            bytes_per_sample = 2;
-            bits_per_sample = 16;
-            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm_16_bit_data_ptr->data());
-        }
-        else {
-            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm.data());
-        }
-
-        // Set our output
-        std::vector<std::byte> adpcm_stream_buffer(sample_count * bytes_per_sample);
-        std::uint8_t *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
+    // Number of blocks encoded with each encoder context. Each chunk starts with its own estimated step index, so this doesn't depend on the thread count to keep the output the same regardless of how many threads are used.
+    static constexpr std::size_t blocks_per_chunk = 512;
 
-        std::size_t samples_per_block = code_chunks_count * 8;
-        std::size_t block_count = sample_count / samples_per_block;
+    // From the MEK - I have no clue how to do this
+    static void encode_xbox_adpcm_chunk(const std::int16_t *pcm_stream, std::uint8_t *adpcm_stream, std::size_t block_count, std::size_t channel_count, std::size_t lookahead) {
+        std::size_t samples_per_block = calculate_samples_per_block();
         std::size_t num_bytes_decoded = 0;
 
         std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);  // number of pcm sint16 per block
@@ -62,16 +47,48 @@ namespace Invader::SoundEncoder {
         }
 
         // Encode!
-        adpcm_context = adpcm_create_context(channel_count, 3, 0, average_deltas);
+        adpcm_context = adpcm_create_context(channel_count, lookahead, 0, average_deltas);
         for (std::size_t b = 0; b < block_count; b++) {
             adpcm_encode_block(adpcm_context, adpcm_stream, &num_bytes_decoded, pcm_stream, samples_per_block);
             adpcm_stream += adpcm_block_size;
             pcm_stream += pcm_block_size;
         }
         adpcm_free_context(adpcm_context);
+    }
+
+    std::vector<std::byte> encode_to_xbox_adpcm(const std::vector<std::byte> &pcm, std::size_t bits_per_sample, std::size_t channel_count, std::size_t lookahead, std::size_t thread_count) {
+        // Set some parameters
+        std::unique_ptr<std::vector<std::byte>> pcm_16_bit_data_ptr;
+        const std::int16_t *pcm_stream;
+        std::size_t bytes_per_sample = bits_per_sample / 8;
+        std::size_t sample_count = pcm.size() / bytes_per_sample / channel_count;
+        if(bits_per_sample != 16) {
+            pcm_16_bit_data_ptr = std::make_unique<std::vector<std::byte>>(convert_int_to_int(pcm, bits_per_sample, 16));
+            bytes_per_sample = 2;
+            bits_per_sample = 16;
+            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm_16_bit_data_ptr->data());
+        }
+        else {
+            pcm_stream = reinterpret_cast<const std::int16_t *>(pcm.data());
+        }
+
+        std::size_t block_count = sample_count / calculate_samples_per_block();
+        std::size_t pcm_block_size   = calculate_adpcm_pcm_block_size(channel_count);
+        std::size_t adpcm_block_size = (code_chunks_count * 4 + 4) * channel_count;
+
+        // Set our output
+        std::vector<std::byte> adpcm_stream_buffer(block_count * adpcm_block_size);
+        std::uint8_t *adpcm_stream = reinterpret_cast<std::uint8_t *>(adpcm_stream_buffer.data());
+
+        // Since every block is decoded on its own, we can encode chunks of blocks separately
+        std::size_t chunk_count = (block_count + blocks_per_chunk - 1) / blocks_per_chunk;
+        auto encode_chunk = [&pcm_stream, &adpcm_stream, &block_count, &pcm_block_size, &adpcm_block_size, &channel_count, &lookahead](std::size_t chunk) {
+            std::size_t first_block = chunk * blocks_per_chunk;
+            encode_xbox_adpcm_chunk(pcm_stream + first_block * pcm_block_size, adpcm_stream + first_block * adpcm_block_size, std::min(blocks_per_chunk, block_count - first_block), channel_count, lookahead);
+        };
+
+        ThreadPool::shared().parallel_for(chunk_count, encode_chunk, thread_count);
 
-        // Resize to fit the buffer
-        adpcm_stream_buffer.resize(reinterpret_cast<std::byte *>(adpcm_stream) - adpcm_stream_buffer.data());
         return adpcm_stream_buffer;
     }
 }
@@ -2,7 +2,7 @@
 
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
-#include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <invader/sound/sound_reader.hpp>
 #include <FLAC/stream_decoder.h>
@@ -14,7 +14,8 @@
 
 namespace Invader::SoundReader {
     Sound sound_from_ogg_file(const std::filesystem::path &path) {
-        auto sound_data = Invader::File::open_file(path);
+        // Map it rather than reading it so the file's data doesn't need to be held in memory alongside the sound's
+        auto sound_data = Invader::File::MemoryMappedFile::map_file(path);
         if(sound_data.has_value()) {
             auto &sound_data_v = *sound_data;
             return sound_from_ogg(sound_data_v.data(), sound_data_v.size());
@@ -109,12 +110,12 @@ namespace Invader::SoundReader {
                                     break;
                                 }
                                 if(result < 0) {
-                                    eprintf_error("Secondary header is invalid")
+                                    eprintf_error("Secondary header is invalid");
                                     throw InvalidInputSoundException();
                                 }
                                 result = vorbis_synthesis_headerin(&vi, &vc, &op);
                                 if(result < 0) {
-                                    eprintf_error("Secondary header is invalid")
+                                    eprintf_error("Secondary header is invalid");
                                     throw InvalidInputSoundException();
                                 }
                                 i++;
@@ -245,18 +246,16 @@ namespace Invader::SoundReader {
         static std::size_t ov_read(void *ptr, std::size_t size, std::size_t nmemb, void *datasource) {
             auto *byte_ptr = reinterpret_cast<std::byte *>(ptr);
             auto &container = *reinterpret_cast<OggVorbisContainer *>(datasource);
-            std::size_t rv = 0;
             
-            for(std::size_t i = 0; i < nmemb; i++) {
-                if(container.length - container.position < size) {
-                    break;
-                }
-                std::memcpy(byte_ptr, container.data + container.position, size);
-                byte_ptr += size;
-                container.position += size;
-                rv++;
+            if(size == 0) {
+                return 0;
             }
             
+            // Copy every whole element that's left in one go (libvorbisfile reads in large chunks of 1-byte elements)
+            std::size_t rv = std::min(nmemb, (container.length - container.position) / size);
+            std::memcpy(byte_ptr, container.data + container.position, rv * size);
+            container.position += rv * size;
+            
             return rv;
         }
         
@@ -308,6 +307,79 @@ namespace Invader::SoundReader {
         }
     };
     
+    std::optional<std::size_t> ogg_vorbis_sample_count_from_pages(const std::byte *data, std::size_t data_size) noexcept {
+        static constexpr std::size_t PAGE_HEADER_SIZE = 27;
+        static constexpr std::uint8_t PAGE_FLAG_BOS = 0x02;
+        static constexpr std::uint8_t PAGE_FLAG_EOS = 0x04;
+        
+        auto read_le = [&data](std::size_t offset, std::size_t size) -> std::uint64_t {
+            std::uint64_t value = 0;
+            for(std::size_t b = 0; b < size; b++) {
+                value |= static_cast<std::uint64_t>(data[offset + b]) << (b * 8);
+            }
+            return value;
+        };
+        
+        std::size_t offset = 0;
+        std::uint64_t serial = 0;
+        std::size_t channel_count = 0;
+        std::optional<std::uint64_t> last_granule;
+        bool end_of_stream = false;
+        
+        while(offset < data_size) {
+            // Only one unchained logical stream ending on its last page can be counted this way
+            if(end_of_stream || data_size - offset < PAGE_HEADER_SIZE || std::memcmp(data + offset, "OggS", 4) != 0 || data[offset + 4] != std::byte()) {
+                return std::nullopt;
+            }
+            
+            auto header_type = static_cast<std::uint8_t>(data[offset + 5]);
+            auto granule = read_le(offset + 6, sizeof(std::uint64_t));
+            auto page_serial = read_le(offset + 14, sizeof(std::uint32_t));
+            auto segment_count = static_cast<std::size_t>(data[offset + 26]);
+            
+            bool first_page = offset == 0;
+            if(first_page != ((header_type & PAGE_FLAG_BOS) != 0) || (!first_page && page_serial != serial)) {
+                return std::nullopt;
+            }
+            serial = page_serial;
+            end_of_stream = (header_type & PAGE_FLAG_EOS) != 0;
+            
+            // Add up the segment table to get the size of the page body
+            auto body_offset = offset + PAGE_HEADER_SIZE + segment_count;
+            if(body_offset > data_size) {
+                return std::nullopt;
+            }
+            std::size_t body_size = 0;
+            for(std::size_t s = 0; s < segment_count; s++) {
+                body_size += static_cast<std::size_t>(data[offset + PAGE_HEADER_SIZE + s]);
+            }
+            if(body_size > data_size - body_offset) {
+                return std::nullopt;
+            }
+            
+            // The identification header is alone on the first page and has the channel count
+            if(first_page) {
+                if(body_size < 30 || data[body_offset] != std::byte { 0x01 } || std::memcmp(data + body_offset + 1, "vorbis", 6) != 0 || read_le(body_offset + 7, sizeof(std::uint32_t)) != 0) {
+                    return std::nullopt;
+                }
+                channel_count = static_cast<std::size_t>(data[body_offset + 11]);
+            }
+            
+            // Pages where no packet ends have a granule position of -1
+            if(granule != UINT64_MAX) {
+                last_granule = granule;
+            }
+            
+            offset = body_offset + body_size;
+        }
+        
+        if(!end_of_stream || !last_granule.has_value() || channel_count == 0 || *last_granule > SIZE_MAX / channel_count) {
+            return std::nullopt;
+        }
+        
+        return static_cast<std::size_t>(*last_granule) * channel_count;
+    }
+    
     std::size_t ogg_vorbis_sample_count(const std::byte *data, std::size_t data_size) {
         OggVorbis_File vf;
         ov_callbacks cb;
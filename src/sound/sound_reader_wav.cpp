@@ -5,7 +5,9 @@
 #include <invader/sound/sound_reader.hpp>
 #include <invader/sound/sound_encoder.hpp>
 #include <memory>
-#include <invader/file/file.hpp>
+#include <algorithm>
+#include <cstring>
+#include <invader/file/memory_mapped_file.hpp>
 #include "wav.hpp"
 
 namespace Invader::SoundReader {
@@ -15,7 +17,7 @@ namespace Invader::SoundReader {
         Sound result = {};
         std::size_t offset = 0;
 
-        #define READ_OR_BAIL(to_what) if(sizeof(to_what) > data_length - offset) { \
+        #define READ_OR_BAIL(to_what) if(offset > data_length || sizeof(to_what) > data_length - offset) { \
             eprintf_error("Failed to read " # to_what); \
             throw InvalidInputSoundException(); \
         } std::memcpy(reinterpret_cast<std::uint8_t *>(&to_what), data + offset, sizeof(to_what)); offset += sizeof(to_what);
@@ -95,24 +97,39 @@ namespace Invader::SoundReader {
 
         // Convert PCM to integer
         std::size_t data_size = subchunk.subchunk_size.read();
-        if(data_size > data_length) {
+        if(offset > data_length || data_size > data_length - offset) {
             eprintf_error("Data is out of bounds");
+            throw InvalidInputSoundException();
         }
+        const auto *pcm_data = data + offset;
 
         if(fmt_subchunk.audio_format == 1) {
-            result.pcm = std::vector<std::byte>(data_size);
-            std::memcpy(result.pcm.data(), data + offset, data_size);
+            // Signed PCM can be copied as-is, so the only copy we make is the one going into the sound
             if(result.bits_per_sample == 8) {
-                for(auto &i : result.pcm) {
-                i = static_cast<std::byte>(static_cast<std::uint8_t>(i) ^ 0x80);
+                result.pcm = std::vector<std::byte>(data_size);
+                for(std::size_t i = 0; i < data_size; i++) {
+                    result.pcm[i] = static_cast<std::byte>(static_cast<std::uint8_t>(pcm_data[i]) ^ 0x80);
                 }
             }
+            else {
+                result.pcm = std::vector<std::byte>(pcm_data, pcm_data + data_size);
+            }
         }
         else if(fmt_subchunk.audio_format == 3) {
-            std::vector<float> pcm_float(data_size / sizeof(*pcm_float.data()));
-            std::memcpy(result.pcm.data(), data + offset, data_size);
+            // Convert a block at a time so we don't need to hold a copy of the whole thing as float (and so the floats are aligned)
+            static constexpr std::size_t FLOAT_BLOCK_SIZE = 4096;
+            std::size_t sample_count = data_size / sizeof(float);
+            float pcm_float[FLOAT_BLOCK_SIZE];
+
             result.bits_per_sample = 24;
-            result.pcm = SoundEncoder::convert_float_to_int(pcm_float, 24);
+            std::size_t new_bytes_per_sample = result.bits_per_sample / 8;
+            result.pcm = std::vector<std::byte>(sample_count * new_bytes_per_sample);
+
+            for(std::size_t s = 0; s < sample_count; s += FLOAT_BLOCK_SIZE) {
+                std::size_t block_sample_count = std::min(FLOAT_BLOCK_SIZE, sample_count - s);
+                std::memcpy(pcm_float, pcm_data + s * sizeof(float), block_sample_count * sizeof(float));
+                SoundEncoder::convert_float_to_int(pcm_float, block_sample_count, result.bits_per_sample, result.pcm.data() + s * new_bytes_per_sample);
+            }
         }
         else {
             std::terminate();
@@ -122,7 +139,8 @@ namespace Invader::SoundReader {
     }
 
     Sound sound_from_wav_file(const std::filesystem::path &path) {
-        auto sound_data = Invader::File::open_file(path);
+        // Map it rather than reading it so the file's data doesn't need to be held in memory alongside the sound's
+        auto sound_data = Invader::File::MemoryMappedFile::map_file(path);
         if(sound_data.has_value()) {
             auto &sound_data_v = *sound_data;
             return sound_from_wav(sound_data_v.data(), sound_data_v.size());
@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
 #include <invader/printf.hpp>
 #include <invader/error.hpp>
 #include <invader/sound/sound_reader.hpp>
+#include <invader/thread_pool.hpp>
 
 extern "C" {
 #include "adpcm_xq/adpcm-lib.h"
@@ -11,41 +13,13 @@ extern "C" {
 const static int ADPCM_STEP_TABLE_MAX_INDEX = sizeof(step_table) / sizeof(step_table[0]) - 1;
 const static int XBOX_ADPCM_ENCODED_BLOCKSIZE = 36;
 const static int XBOX_ADPCM_DECODED_BLOCKSIZE = 128;
+const static std::size_t XBOX_ADPCM_CODE_CHUNKS_COUNT = 8;
+const static std::size_t XBOX_ADPCM_SAMPLES_PER_BLOCK = 64;
 
-namespace Invader::SoundReader {
-    static void decode_xbadpcm_stream(std::byte *pcm_stream_buf, const std::byte *adpcm_stream_buf, std::size_t adpcm_stream_buf_len, std::uint8_t channel_count, std::uint32_t code_chunks_count);
-
-    Sound sound_from_xbox_adpcm(const std::byte *data, std::size_t data_length, std::size_t channel_count, std::size_t sample_rate) {
-        Sound result = {};
-
-        if(channel_count > 2 || channel_count < 1) {
-            eprintf_error("Only mono or stereo streams are supported");
-            throw InvalidInputSoundException();
-        }
-
-        // Set parameters
-        result.input_bits_per_sample = 16;
-        result.bits_per_sample = 16;
-        result.channel_count = channel_count;
-        result.input_channel_count = result.channel_count;
-        result.sample_rate = sample_rate;
-        result.input_sample_rate = result.sample_rate;
-
-        // Make sure it's all complete blocks
-        if(data_length % XBOX_ADPCM_ENCODED_BLOCKSIZE != 0) {
-            eprintf_error("Data length is not divisible by Xbox ADPCM block size");
-            throw InvalidInputSoundException();
-        }
-
-        // Do it!
-        std::size_t block_count = static_cast<std::size_t>(data_length / (channel_count * XBOX_ADPCM_ENCODED_BLOCKSIZE));
-        result.pcm = std::vector<std::byte>(block_count * XBOX_ADPCM_DECODED_BLOCKSIZE * channel_count);
-        decode_xbadpcm_stream(result.pcm.data(), data, data_length, static_cast<std::uint8_t>(channel_count), 8);
-
-        // Return the result
-        return result;
-    }
+// Blocks decoded at once on one thread; this is small enough to spread short sounds over a few threads
+const static std::size_t XBOX_ADPCM_BLOCKS_PER_PIECE = 256;
 
+namespace Invader::SoundReader {
     // From Refinery (by MosesofEgypt)
 
     // Description of ADPCM stream block:
@@ -64,122 +38,137 @@ namespace Invader::SoundReader {
     //     channel 0: (left)   b8   b9   b10  b11
     //     channel 1: (right)  b12  b13  b14  b15
     //     cont...
-
-    typedef struct {
-        std::int16_t pcm_sample;  /* the current decoded adpcm sample. When calling
-        **                     decode_adpcm_sample this is supposed to be the
-        **                     predictor for decoding the next sample. Contains
-        **                     the decoded sample when the function returns.*/
-        std::int8_t index;  /* An index into step_table.
-        **               Used for calculating the current differential step.
-        **               Contains the next step index when the function returns.*/
-        std::uint8_t code;  /* An index into index_table.
-        **              The 4bit adpcm code for calculating the next differential index.
-        **              Update this before calling decode_adpcm_sample.*/
-    } AdpcmState;
-
-
-    /* This function will decode the next adpcm sample given as an AdpcmState struct.
-    This function accepts and returns the whole struct since it can easily fit in a
-    single 32bit register, and should be more efficient than passing a pointer to a struct.
-    */
-    static AdpcmState decode_adpcm_sample(AdpcmState state) {
-        if(static_cast<std::size_t>(state.index) > sizeof(step_table) / sizeof(*step_table)) {
-            throw InvalidInputSoundException();
+    //
+    //   Each block decodes to 64 samples per channel: the initial sample followed by the first 63 codes (the last code
+    //   of each block is unused).
+
+    // What each code does at each step index, so decoding a sample is two loads instead of a handful of branches
+    struct AdpcmStep {
+        std::int32_t delta;
+        std::uint32_t next_step; // index of the next step's first code in the table (i.e. step index * 16)
+    };
+
+    struct AdpcmStepTable {
+        AdpcmStep steps[(ADPCM_STEP_TABLE_MAX_INDEX + 1) * 16];
+
+        AdpcmStepTable() noexcept {
+            for(int index = 0; index <= ADPCM_STEP_TABLE_MAX_INDEX; index++) {
+                for(int code = 0; code < 16; code++) {
+                    int step_size = step_table[index];
+                    int delta = step_size >> 3;
+                    if(code & 4) delta += step_size;
+                    if(code & 2) delta += step_size >> 1;
+                    if(code & 1) delta += step_size >> 2;
+                    if(code & 8) delta = -delta;
+
+                    int next_index = std::clamp(index + index_table[code], 0, ADPCM_STEP_TABLE_MAX_INDEX);
+                    this->steps[index * 16 + code] = { delta, static_cast<std::uint32_t>(next_index * 16) };
+                }
+            }
         }
+    };
 
-        int delta, step_size = step_table[state.index];
-        int result = state.pcm_sample;  /* pcm_sample could over/underflow in the code below,
-        **                                 so we keep the result as an int for clamping.*/
+    static const AdpcmStepTable &get_step_table() noexcept {
+        static const AdpcmStepTable table;
+        return table;
+    }
 
-        delta = step_size >> 3;
-        if (state.code & 4) delta += step_size;
-        if (state.code & 2) delta += step_size >> 1;
-        if (state.code & 1) delta += step_size >> 2;
-        if (state.code & 8) delta = -delta;
+    static void decode_xbox_adpcm_blocks(std::int16_t *pcm_stream, const std::uint8_t *adpcm_stream, std::size_t block_count, std::size_t channel_count) {
+        const auto *steps = get_step_table().steps;
+        std::size_t adpcm_block_size = XBOX_ADPCM_ENCODED_BLOCKSIZE * channel_count;
+        std::size_t pcm_block_size = XBOX_ADPCM_SAMPLES_PER_BLOCK * channel_count;
+
+        for(std::size_t b = 0; b < block_count; b++) {
+            const auto *block = adpcm_stream + b * adpcm_block_size;
+            auto *pcm = pcm_stream + b * pcm_block_size;
+
+            // Each channel only depends on its own header and codes, so decode one channel at a time
+            for(std::size_t c = 0; c < channel_count; c++) {
+                const auto *header = block + c * 4;
+                int sample = static_cast<std::int16_t>(header[0] | (header[1] << 8));
+
+                // The index was stored as a signed byte, so anything above 127 is negative and clamps to 0
+                std::uint32_t step = static_cast<std::uint32_t>(std::clamp(static_cast<int>(static_cast<std::int8_t>(header[2])), 0, ADPCM_STEP_TABLE_MAX_INDEX) * 16);
+
+                auto *channel_pcm = pcm + c;
+                channel_pcm[0] = static_cast<std::int16_t>(sample);
+
+                const auto *chunk = block + channel_count * 4 + c * 4;
+                std::size_t frame = 1;
+                for(std::size_t k = 0; k < XBOX_ADPCM_CODE_CHUNKS_COUNT; k++, chunk += channel_count * 4) {
+                    // Expand all eight codes of the chunk first so the sample loop only depends on the previous sample
+                    std::uint8_t codes[8];
+                    for(std::size_t i = 0; i < 4; i++) {
+                        codes[i * 2] = chunk[i] & 0xF;
+                        codes[i * 2 + 1] = chunk[i] >> 4;
+                    }
 
-        result += delta;
+                    std::size_t code_count = k + 1 == XBOX_ADPCM_CODE_CHUNKS_COUNT ? 7 : 8;
+                    for(std::size_t i = 0; i < code_count; i++) {
+                        const auto &s = steps[step + codes[i]];
+                        sample = std::clamp(sample + s.delta, -32768, 32767);
+                        step = s.next_step;
+                        channel_pcm[(frame++) * channel_count] = static_cast<std::int16_t>(sample);
+                    }
+                }
+            }
+        }
+    }
 
-        if (result >= 32767)
-            state.pcm_sample = 32767;
-        else if (result <= -32768)
-            state.pcm_sample = -32768;
-        else
-            state.pcm_sample = static_cast<std::int16_t>(result);
+    static std::size_t get_xbox_adpcm_block_count(std::size_t data_length, std::size_t channel_count) {
+        if(channel_count > 2 || channel_count < 1) {
+            eprintf_error("Only mono or stereo streams are supported");
+            throw InvalidInputSoundException();
+        }
 
-        if(static_cast<std::size_t>(state.code) > sizeof(step_table) / sizeof(*step_table)) {
+        // Make sure it's all complete blocks
+        if(data_length % XBOX_ADPCM_ENCODED_BLOCKSIZE != 0) {
+            eprintf_error("Data length is not divisible by Xbox ADPCM block size");
             throw InvalidInputSoundException();
         }
 
-        state.index += index_table[state.code];
-        if (state.index < 0)
-            state.index = 0;
-        else if (state.index > ADPCM_STEP_TABLE_MAX_INDEX)
-            state.index = ADPCM_STEP_TABLE_MAX_INDEX;
+        return data_length / (channel_count * XBOX_ADPCM_ENCODED_BLOCKSIZE);
+    }
+
+    Sound sound_from_xbox_adpcm(const std::byte *data, std::size_t data_length, std::size_t channel_count, std::size_t sample_rate) {
+        Sound result = {};
+        std::size_t block_count = get_xbox_adpcm_block_count(data_length, channel_count);
 
-        return state;
+        // Set parameters
+        result.input_bits_per_sample = 16;
+        result.bits_per_sample = 16;
+        result.channel_count = channel_count;
+        result.input_channel_count = result.channel_count;
+        result.sample_rate = sample_rate;
+        result.input_sample_rate = result.sample_rate;
+
+        // Do it! Every block starts over from its own header, so pieces of the stream can be decoded on separate threads.
+        result.pcm = std::vector<std::byte>(block_count * XBOX_ADPCM_DECODED_BLOCKSIZE * channel_count);
+        auto *pcm_stream = reinterpret_cast<std::int16_t *>(result.pcm.data());
+        const auto *adpcm_stream = reinterpret_cast<const std::uint8_t *>(data);
+        std::size_t piece_count = (block_count + XBOX_ADPCM_BLOCKS_PER_PIECE - 1) / XBOX_ADPCM_BLOCKS_PER_PIECE;
+        ThreadPool::shared().parallel_for(piece_count, [&pcm_stream, &adpcm_stream, &block_count, &channel_count](std::size_t piece) {
+            std::size_t first_block = piece * XBOX_ADPCM_BLOCKS_PER_PIECE;
+            decode_xbox_adpcm_blocks(pcm_stream + first_block * XBOX_ADPCM_SAMPLES_PER_BLOCK * channel_count,
+                                     adpcm_stream + first_block * XBOX_ADPCM_ENCODED_BLOCKSIZE * channel_count,
+                                     std::min(XBOX_ADPCM_BLOCKS_PER_PIECE, block_count - first_block),
+                                     channel_count);
+        });
+
+        // Return the result
+        return result;
     }
 
-    static void decode_xbadpcm_stream(std::byte *pcm_stream_buf, const std::byte *adpcm_stream_buf, std::size_t adpcm_stream_buf_len, std::uint8_t channel_count, std::uint32_t code_chunks_count) {
-        AdpcmState adpcm_states[MAX_AUDIO_CHANNEL_COUNT];
-        int block_count = static_cast<int>(
-            adpcm_stream_buf_len /
-            (channel_count * (4 + 4 * code_chunks_count)));
-        const std::uint8_t *adpcm_stream = reinterpret_cast<const std::uint8_t *>(adpcm_stream_buf);
-        std::int16_t *pcm_stream = reinterpret_cast<std::int16_t *>(pcm_stream_buf);
-        std::uint32_t codes;
-        std::uint32_t samples_per_chunk = 8 * channel_count;
-        std::uint32_t samples_this_chunk = 0, samples_remaining_this_block = 0;
-        std::uint32_t samples_per_block = samples_per_chunk * code_chunks_count;
-
-        for (int b = 0; b < block_count; b++) {
-            samples_remaining_this_block = samples_per_block;
-            // initialize the adpcm state structs
-            for (int c = 0; c < channel_count; c++) {
-                adpcm_states[c].pcm_sample = adpcm_stream[0] | (adpcm_stream[1] << 8);
-                adpcm_states[c].index = adpcm_stream[2];
-                adpcm_stream += 4;
-
-                pcm_stream[0] = adpcm_states[c].pcm_sample;
-                pcm_stream++;
-                samples_remaining_this_block--;
-
-                if (adpcm_states[c].index < 0)
-                    adpcm_states[c].index = 0;
-                else if (adpcm_states[c].index > ADPCM_STEP_TABLE_MAX_INDEX)
-                    adpcm_states[c].index = ADPCM_STEP_TABLE_MAX_INDEX;
-            }
+    void stream_from_xbox_adpcm(const std::byte *data, std::size_t data_length, std::size_t channel_count, const std::function<bool (const std::byte *pcm, std::size_t pcm_size)> &callback) {
+        std::size_t block_count = get_xbox_adpcm_block_count(data_length, channel_count);
+        const auto *adpcm_stream = reinterpret_cast<const std::uint8_t *>(data);
 
-            while (samples_remaining_this_block) {
-                // loop over each channel in each chunk
-                if (samples_remaining_this_block < samples_per_chunk)
-                    samples_this_chunk = samples_remaining_this_block;
-                else
-                    samples_this_chunk = samples_per_chunk;
-
-                for (std::size_t c = 0; c < channel_count; c++) {
-                    // OR the codes together for easy access
-                    codes = (
-                         adpcm_stream[0] |
-                        (adpcm_stream[1] << 8) |
-                        (adpcm_stream[2] << 16) |
-                        (adpcm_stream[3] << 24));
-                    adpcm_stream += 4;
-
-                    // loop over the 8 codes in this channels chunk.
-                    // loop is structured like this to properly interleave the pcm data.
-                    // otherwise we would have to store the decoded samples to several temp
-                    // buffers and then interleave those temp buffers into the pcm stream.
-                    for (std::size_t i = c; i < samples_this_chunk; i += channel_count) {
-                        adpcm_states[c].code = codes & 0xF;
-                        codes >>= 4;
-                        adpcm_states[c] = decode_adpcm_sample(adpcm_states[c]);
-                        pcm_stream[i] = adpcm_states[c].pcm_sample;
-                    }
-                }
-                // skip over the chunk of samples we just decoded
-                pcm_stream += samples_this_chunk;
-                samples_remaining_this_block -= samples_this_chunk;
+        std::vector<std::int16_t> pcm(XBOX_ADPCM_BLOCKS_PER_PIECE * XBOX_ADPCM_SAMPLES_PER_BLOCK * channel_count);
+        for(std::size_t first_block = 0; first_block < block_count; first_block += XBOX_ADPCM_BLOCKS_PER_PIECE) {
+            std::size_t blocks = std::min(XBOX_ADPCM_BLOCKS_PER_PIECE, block_count - first_block);
+            decode_xbox_adpcm_blocks(pcm.data(), adpcm_stream + first_block * XBOX_ADPCM_ENCODED_BLOCKSIZE * channel_count, blocks, channel_count);
+            if(!callback(reinterpret_cast<const std::byte *>(pcm.data()), blocks * XBOX_ADPCM_DECODED_BLOCKSIZE * channel_count)) {
+                return;
             }
         }
     }
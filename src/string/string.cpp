@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <invader/error.hpp>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
@@ -21,7 +24,7 @@ enum Format {
     STRING_LIST_FORMAT_1252
 };
 
-template <typename OUTPUT_TYPE, typename TAG_STRUCT, TagFourCC FOURCC> static std::vector<std::byte> generate_string_list_tag(const std::u16string &input_string) {
+template <typename OUTPUT_TYPE, typename TAG_STRUCT, TagFourCC FOURCC> static std::vector<std::byte> generate_string_list_tag(const std::u16string &input_string, std::size_t &string_count) {
     using namespace HEK;
 
     // Make the file header
@@ -40,14 +43,14 @@ template <typename OUTPUT_TYPE, typename TAG_STRUCT, TagFourCC FOURCC> static st
     for(std::size_t i = 0; i < string_length; i++) {
         if(c[i] == 0) {
             eprintf_error("Error: Null character is present in the file.");
-            std::exit(EXIT_FAILURE);
+            throw InvalidTagDataException();
         }
         if(c[i] == '\r' || c[i] == '\n') {
             unsigned int increment;
             if(c[i] == '\r') {
                 if(c[i + 1] != '\n') {
                     eprintf_error("Error: CR with unaccompanied LF character.");
-                    std::exit(EXIT_FAILURE);
+                    throw InvalidTagDataException();
                 }
                 
                 increment = 1;
@@ -78,7 +81,7 @@ template <typename OUTPUT_TYPE, typename TAG_STRUCT, TagFourCC FOURCC> static st
     // Did we have any text left?
     if(middle_of_string) {
         eprintf_error("Error: Missing ###END-STRING### after string.");
-        std::exit(EXIT_FAILURE);
+        throw InvalidTagDataException();
     }
 
     // Add each string
@@ -104,12 +107,12 @@ template <typename OUTPUT_TYPE, typename TAG_STRUCT, TagFourCC FOURCC> static st
         }
     }
     
-    oprintf_success("Generated a string list with %zu string%s.", strings.size(), strings.size() == 1 ? "" : "s");
+    string_count = strings.size();
 
     return tag_data.generate_hek_tag_data(FOURCC, true);
 }
 
-static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string &str) {
+static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string &str, std::size_t &string_count) {
     std::vector<std::pair<std::string, std::u16string>> strings;
     
     std::size_t line_start = 0;
@@ -122,7 +125,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
         
         if(c[i] == 0 && !last_char) {
             eprintf_error("Null character is present in the file.");
-            std::exit(EXIT_FAILURE);
+            throw InvalidTagDataException();
         }
         
         // End of line?
@@ -131,7 +134,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
             if(c[i] == '\r') {
                 if(c[i + 1] != '\n') {
                     eprintf_error("CR with unaccompanied LF character.");
-                    std::exit(EXIT_FAILURE);
+                    throw InvalidTagDataException();
                 }
                 increment = 2;
             }
@@ -158,7 +161,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
                         for(auto &s : strings) {
                             if(s.first == key) {
                                 eprintf_error("Error: Duplicate %s keys.", key.c_str());
-                                std::exit(EXIT_FAILURE);
+                                throw InvalidTagDataException();
                             }
                         }
                         strings.emplace_back(key, value);
@@ -168,7 +171,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
                 }
                 if(!found_equals) {
                     eprintf_error("Line %zu needs to be formatted as key=value be valid.", strings.size() + 1);
-                    std::exit(EXIT_FAILURE);
+                    throw InvalidTagDataException();
                 }
             }
                 
@@ -203,7 +206,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
         auto key_length = k.size();
         if(key_length >= sizeof(m.name)) {
             eprintf_error("Key '%s' exceeds %zu characters", key_str, sizeof(m.name));
-            std::exit(EXIT_FAILURE);
+            throw InvalidTagDataException();
         }
         std::strncpy(m.name.string, key_str, key_length);
         
@@ -234,7 +237,7 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
                     if(!found && *c == 0) {
                         std::string c(thing.begin(), thing.end());
                         eprintf_error("Unknown button type \"%s\"", c.c_str());
-                        std::exit(EXIT_FAILURE);
+                        throw InvalidTagDataException();
                     }
                 }
                 
@@ -262,11 +265,150 @@ static std::vector<std::byte> generate_hud_message_text_tag(const std::u16string
     
     tag_data.text_data = { reinterpret_cast<std::byte *>(text_data_bytes_start), reinterpret_cast<std::byte *>(text_data_bytes_end) };
     
-    oprintf_success("Generated a HUD message text list with %zu string%s.", strings.size(), strings.size() == 1 ? "" : "s");
+    string_count = strings.size();
     
     return tag_data.generate_hek_tag_data(HEK::TagFourCC::TAG_FOURCC_HUD_MESSAGE_TEXT, true);
 }
 
+static std::vector<std::byte> generate_string_tag(const std::filesystem::path &input_path, Format format, std::size_t &string_count) {
+    auto file_data = Invader::File::open_file(input_path);
+    if(!file_data.has_value()) {
+        eprintf_error("Failed to read %s", input_path.string().c_str());
+        throw FailedToOpenFileException();
+    }
+
+    // Determine the encoding of it
+    auto *input_data = file_data->data();
+    auto bom = reinterpret_cast<std::uint16_t *>(input_data);
+    auto input_size = file_data->size();
+    std::u16string chars_16bit;
+    
+    bool is_16_bit = false;
+    bool is_host_endian = false;
+    
+    auto *start16 = reinterpret_cast<char16_t *>(bom + 1);
+    auto *end16 = reinterpret_cast<char16_t *>(input_data + input_size);
+    
+    auto *start8 = reinterpret_cast<char8_t *>(input_data);
+    auto *end8 = reinterpret_cast<char8_t *>(input_data + input_size);
+    
+    // Is it big enough to hold a BOM? If so, read it.
+    if(input_size >= sizeof(*bom)) {
+        if(*bom == 0xFEFF) {
+            is_host_endian = true;
+            is_16_bit = true;
+        }
+        else if(*bom == 0xFFFE) {
+            is_host_endian = false;
+            is_16_bit = true;
+        }
+    }
+    
+    // If it's 16-bit, parse it as such.
+    if(is_16_bit) {
+        if(((reinterpret_cast<std::uintptr_t>(end16) - reinterpret_cast<std::uintptr_t>(start16)) % sizeof(*start16)) != 0) {
+            eprintf_error("File %s has a 16-bit BOM but is not actually 16-bit", input_path.string().c_str());
+            throw InvalidTagDataException();
+        }
+        chars_16bit = { start16, end16 };
+        if(!is_host_endian) {
+            for(auto &c : chars_16bit) {
+                auto u16 = static_cast<std::uint16_t>(c);
+                c = static_cast<char16_t>((u16 << 8) | (u16 >> 8));
+            }
+        }
+    }
+    else {
+        if(format == Format::STRING_LIST_FORMAT_HMT) {
+            eprintf_error("File %s is not 16-bit, but .hmt files must be 16-bit", input_path.string().c_str());
+            throw InvalidTagDataException();
+        }
+
+        // Each byte is one character, so widen them all at once
+        chars_16bit.assign(start8, end8);
+    }
+
+    // Generate the data
+    switch(format) {
+        case STRING_LIST_FORMAT_UNICODE:
+            return generate_string_list_tag<char16_t, Parser::UnicodeStringList, TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST>(chars_16bit, string_count);
+        case STRING_LIST_FORMAT_1252:
+            return generate_string_list_tag<char8_t, Parser::StringList, TagFourCC::TAG_FOURCC_STRING_LIST>(chars_16bit, string_count);
+        case STRING_LIST_FORMAT_HMT:
+            return generate_hud_message_text_tag(chars_16bit, string_count);
+    }
+
+    std::terminate();
+}
+
+
+static int generate_string_tags(const std::filesystem::path &input_directory, const std::filesystem::path &output_directory, const char *input_extension, const char *output_extension, Format format, std::size_t thread_count) {
+    std::error_code ec;
+    if(!std::filesystem::is_directory(input_directory, ec)) {
+        eprintf_error("Directory %s was not found or is not a directory", input_directory.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Sort them so the output is in the same order every time
+    std::vector<std::filesystem::path> input_files;
+    for(auto &i : std::filesystem::recursive_directory_iterator(input_directory)) {
+        if(i.is_regular_file() && i.path().extension() == input_extension) {
+            input_files.emplace_back(std::filesystem::relative(i.path(), input_directory).replace_extension());
+        }
+    }
+    std::sort(input_files.begin(), input_files.end());
+
+    enum StringTagResult {
+        STRING_TAG_RESULT_FAILED,
+        STRING_TAG_RESULT_UNCHANGED,
+        STRING_TAG_RESULT_GENERATED
+    };
+    std::vector<StringTagResult> results(input_files.size(), STRING_TAG_RESULT_FAILED);
+    ThreadPool::shared().parallel_for(input_files.size(), [&](std::size_t f) {
+        auto input_path = input_directory / (input_files[f].string() + input_extension);
+        auto output_path = output_directory / (input_files[f].string() + output_extension);
+
+        try {
+            std::size_t string_count;
+            auto final_data = generate_string_tag(input_path, format, string_count);
+
+            // Leave tags that are already up-to-date alone so they aren't seen as modified
+            auto existing_data = File::open_file(output_path);
+            if(existing_data.has_value() && *existing_data == final_data) {
+                results[f] = STRING_TAG_RESULT_UNCHANGED;
+                return;
+            }
+
+            std::error_code ec;
+            std::filesystem::create_directories(output_path.parent_path(), ec);
+            if(!File::save_file(output_path, final_data)) {
+                eprintf_error("Error: Failed to write to %s.", output_path.string().c_str());
+                return;
+            }
+            results[f] = STRING_TAG_RESULT_GENERATED;
+        }
+        catch(std::exception &) {
+            eprintf_error("Failed to generate a tag from %s", input_path.string().c_str());
+        }
+    }, thread_count);
+
+    std::size_t generated = std::count(results.begin(), results.end(), STRING_TAG_RESULT_GENERATED);
+    std::size_t unchanged = std::count(results.begin(), results.end(), STRING_TAG_RESULT_UNCHANGED);
+    std::size_t failed = results.size() - generated - unchanged;
+    for(std::size_t f = 0; f < input_files.size(); f++) {
+        if(results[f] == STRING_TAG_RESULT_GENERATED) {
+            oprintf("Generated %s%s\n", (output_directory / input_files[f]).string().c_str(), output_extension);
+        }
+    }
+
+    if(failed > 0) {
+        eprintf_error("Generated %zu tag%s (%zu unchanged); %zu failed", generated, generated == 1 ? "" : "s", unchanged, failed);
+        return EXIT_FAILURE;
+    }
+    oprintf_success("Generated %zu tag%s (%zu unchanged)", generated, generated == 1 ? "" : "s", unchanged);
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char * const *argv) {
     set_up_color_term();
     
@@ -276,6 +418,8 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_DATA),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
         CommandLineOption("type", 'T', 1, "Specify the type of string tag. Can be: hud_message_text, string_list, unicode_string_list", "<type>"),
+        CommandLineOption("batch", 'b', 0, "Treat the tag as a directory and generate a tag for every file in it and its subdirectories. Tags that would not change are not rewritten."),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS),
     };
 
     static constexpr char DESCRIPTION[] = "Generate string list tags.";
@@ -286,6 +430,8 @@ int main(int argc, char * const *argv) {
         std::filesystem::path tags = "tags";
         std::optional<Format> format;
         bool use_filesystem_path = false;
+        bool batch = false;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } string_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<StringOptions &>(argc, argv, options, USAGE, DESCRIPTION, 1, 1, string_options, [](char opt, const std::vector<const char *> &arguments, auto &string_options) {
@@ -302,6 +448,12 @@ int main(int argc, char * const *argv) {
             case 'P':
                 string_options.use_filesystem_path = true;
                 break;
+            case 'b':
+                string_options.batch = true;
+                break;
+            case 'j':
+                string_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
             case 'T':
                 if(std::strcmp(arguments[0], "unicode_string_list") == 0) {
                     string_options.format = Format::STRING_LIST_FORMAT_UNICODE;
@@ -320,6 +472,9 @@ int main(int argc, char * const *argv) {
         }
     });
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(string_options.thread_count);
+    
     if(!string_options.format.has_value()) {
         eprintf_error("No type specified. Use -h for more information.");
         return EXIT_FAILURE;
@@ -358,79 +513,28 @@ int main(int argc, char * const *argv) {
             break;
     }
 
+    if(string_options.batch) {
+        return generate_string_tags(string_options.data / string_tag, string_options.tags / string_tag, valid_extension, output_extension, *string_options.format, string_options.thread_count);
+    }
+
     auto input_path = string_options.data / (string_tag + valid_extension);
     auto output_path = string_options.tags / (string_tag + output_extension);
-    
-    auto file_data = Invader::File::open_file(input_path);
-    if(!file_data.has_value()) {
-        eprintf_error("Failed to read %s", input_path.string().c_str());
+
+    // Generate the data
+    std::vector<std::byte> final_data;
+    std::size_t string_count;
+    try {
+        final_data = generate_string_tag(input_path, *string_options.format, string_count);
+    }
+    catch(std::exception &) {
         return EXIT_FAILURE;
     }
 
-    // Determine the encoding of it
-    auto *input_data = file_data->data();
-    auto bom = reinterpret_cast<std::uint16_t *>(input_data);
-    auto input_size = file_data->size();
-    std::u16string chars_16bit;
-    
-    bool is_16_bit = false;
-    bool is_host_endian = false;
-    
-    auto *start16 = reinterpret_cast<char16_t *>(bom + 1);
-    auto *end16 = reinterpret_cast<char16_t *>(input_data + input_size);
-    
-    auto *start8 = reinterpret_cast<char8_t *>(input_data);
-    auto *end8 = reinterpret_cast<char8_t *>(input_data + input_size);
-    
-    // Is it big enough to hold a BOM? If so, read it.
-    if(input_size >= sizeof(*bom)) {
-        if(*bom == 0xFEFF) {
-            is_host_endian = true;
-            is_16_bit = true;
-        }
-        else if(*bom == 0xFFFE) {
-            is_host_endian = false;
-            is_16_bit = true;
-        }
-    }
-    
-    // If it's 16-bit, parse it as such.
-    if(is_16_bit) {
-        if(((reinterpret_cast<std::uintptr_t>(end16) - reinterpret_cast<std::uintptr_t>(start16)) % sizeof(*start16)) != 0) {
-            eprintf_error("File %s has a 16-bit BOM but is not actually 16-bit", input_path.string().c_str());
-            return EXIT_FAILURE;
-        }
-        chars_16bit = { start16, end16 };
-        if(!is_host_endian) {
-            for(auto &c : chars_16bit) {
-                auto u16 = static_cast<std::uint16_t>(c);
-                c = static_cast<char16_t>((u16 << 8) | (u16 >> 8));
-            }
-        }
+    if(*string_options.format == Format::STRING_LIST_FORMAT_HMT) {
+        oprintf_success("Generated a HUD message text list with %zu string%s.", string_count, string_count == 1 ? "" : "s");
     }
     else {
-        if(*string_options.format == Format::STRING_LIST_FORMAT_HMT) {
-            eprintf_error("File %s is not 16-bit, but .hmt files must be 16-bit", input_path.string().c_str());
-            return EXIT_FAILURE;
-        }
-        chars_16bit.reserve(input_size);
-        for(auto *i = start8; i < end8; i++) {
-            chars_16bit.push_back(*i);
-        }
-    }
-
-    // Generate the data
-    std::vector<std::byte> final_data;
-    switch(*string_options.format) {
-        case STRING_LIST_FORMAT_UNICODE:
-            final_data = generate_string_list_tag<char16_t, Parser::UnicodeStringList, TagFourCC::TAG_FOURCC_UNICODE_STRING_LIST>(chars_16bit);
-            break;
-        case STRING_LIST_FORMAT_1252:
-            final_data = generate_string_list_tag<char8_t, Parser::StringList, TagFourCC::TAG_FOURCC_STRING_LIST>(chars_16bit);
-            break;
-        case STRING_LIST_FORMAT_HMT:
-            final_data = generate_hud_message_text_tag(chars_16bit);
-            break;
+        oprintf_success("Generated a string list with %zu string%s.", string_count, string_count == 1 ? "" : "s");
     }
 
     // Write it all
@@ -4,19 +4,28 @@
 #include <string>
 #include <filesystem>
 #include <invader/printf.hpp>
+#include <invader/thread_pool.hpp>
 #include <invader/version.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/tag/hek/definition.hpp>
 #include "../command_line_option.hpp"
 #include <invader/tag/parser/parser.hpp>
 #include <invader/file/file.hpp>
+#include <invader/file/memory_mapped_file.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 using namespace Invader;
 
+// Keep output from different threads from being interleaved
+static std::mutex print_mutex;
+
 bool strip_tag(const std::filesystem::path &file_path, const std::string &tag_path) {
     // Open the tag
-    auto tag = File::open_file(file_path);
+    auto tag = File::MemoryMappedFile::map_file(file_path);
     if(!tag.has_value()) {
+        std::scoped_lock lock(print_mutex);
         eprintf_error("Failed to open %s", file_path.string().c_str());
         return false;
     }
@@ -29,21 +38,28 @@ bool strip_tag(const std::filesystem::path &file_path, const std::string &tag_pa
         file_data = Parser::ParserStruct::parse_hek_tag_file(tag->data(), tag->size())->generate_hek_tag_data(header->tag_fourcc, true);
     }
     catch(std::exception &e) {
+        std::scoped_lock lock(print_mutex);
         eprintf_error("Error: Failed to strip %s: %s", tag_path.c_str(), e.what());
         return false;
     }
 
     // Don't write if it matches
-    if(file_data == *tag) {
+    if(file_data.size() == tag->size() && std::equal(file_data.begin(), file_data.end(), tag->data())) {
+        std::scoped_lock lock(print_mutex);
         oprintf("Skipped %s\n", tag_path.c_str());
         return false;
     }
-    
+
+    // Unmap it first, since it can't be overwritten while it's mapped on Windows
+    tag.reset();
+
     if(!File::save_file(file_path, file_data)) {
+        std::scoped_lock lock(print_mutex);
         eprintf_error("Error: Failed to write to %s.", file_path.string().c_str());
         return false;
     }
 
+    std::scoped_lock lock(print_mutex);
     oprintf_success("Stripped %s", tag_path.c_str());
 
     return true;
@@ -57,7 +73,8 @@ int main(int argc, char * const *argv) {
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_TAGS),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH),
         CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_BATCH_EXCLUDE),
-        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH)
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_FS_PATH),
+        CommandLineOption::from_preset(CommandLineOption::PRESET_COMMAND_LINE_OPTION_THREADS)
     };
 
     static constexpr char DESCRIPTION[] = "Strips extra hidden data from tags.";
@@ -68,6 +85,7 @@ int main(int argc, char * const *argv) {
         bool fs_path = false;
         std::vector<std::string> search;
         std::vector<std::string> search_exclude;
+        std::size_t thread_count = ThreadPool::get_shared_thread_count();
     } strip_options;
 
     auto remaining_arguments = CommandLineOption::parse_arguments<StripOptions &>(argc, argv, options, USAGE, DESCRIPTION, 0, 1, strip_options, [](char opt, const std::vector<const char *> &arguments, auto &strip_options) {
@@ -87,9 +105,15 @@ int main(int argc, char * const *argv) {
             case 'P':
                 strip_options.fs_path = true;
                 break;
+            case 'j':
+                strip_options.thread_count = CommandLineOption::parse_thread_count(arguments[0]);
+                break;
         }
     });
     
+    // Anything in libinvader that uses multiple threads should use the same number of threads
+    ThreadPool::set_shared_thread_count(strip_options.thread_count);
+    
     std::optional<File::TagFilePath> single_tag;
     if(strip_options.search.empty() && strip_options.search_exclude.empty()) {
         if(remaining_arguments.size() == 1) {
@@ -111,20 +135,27 @@ int main(int argc, char * const *argv) {
         return EXIT_FAILURE;
     }
 
-    std::size_t success = 0;
-    std::size_t total = 0;
-    
     if(single_tag.has_value()) {
         return strip_tag(File::tag_path_to_file_path(*single_tag, strip_options.tags).string().c_str(), File::halo_path_to_preferred_path(single_tag->join())) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
     
+    std::vector<File::TagFile> all_tags;
+    File::PathMatcher search_matcher(strip_options.search, strip_options.search_exclude);
     for(auto &i : File::load_virtual_tag_folder( { strip_options.tags } )) {
-        if(File::path_matches(i.tag_path.c_str(), strip_options.search, strip_options.search_exclude)) {
-            total++;
-            success += strip_tag(i.full_path.c_str(), i.tag_path) ? 1 : 0;
+        if(search_matcher.matches(i.tag_path.c_str())) {
+            all_tags.emplace_back(std::move(i));
         }
     }
 
+    // Strip the tags on multiple threads
+    std::size_t total = all_tags.size();
+    std::atomic<std::size_t> stripped = 0;
+    ThreadPool::shared().parallel_for(total, [&all_tags, &stripped](std::size_t i) {
+        stripped += strip_tag(all_tags[i].full_path, all_tags[i].tag_path) ? 1 : 0;
+    });
+
+    std::size_t success = stripped;
+
     oprintf("Stripped %zu out of %zu tag%s\n", success, total, total == 1 ? "" : "s");
 
     return EXIT_SUCCESS;
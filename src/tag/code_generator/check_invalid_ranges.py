@@ -1,14 +1,44 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
-def make_check_invalid_ranges(all_used_structs, struct_name, hpp, cpp_check_invalid_ranges):
+# Return True if the struct (or anything it inherits or has in its reflexives) has ranged fields to check
+def struct_has_ranged_fields(struct_name, all_structs, visited = None):
+    if visited is None:
+        visited = set()
+    if struct_name in visited:
+        return False
+    visited.add(struct_name)
+    for t in all_structs:
+        if t["name"] == struct_name:
+            if "inherits" in t and struct_has_ranged_fields(t["inherits"], all_structs, visited):
+                return True
+            for f in t["fields"]:
+                if f["type"] == "TagReflexive":
+                    if struct_has_ranged_fields(f["struct"], all_structs, visited):
+                        return True
+                elif f["type"] != "TagDataOffset" and f["type"] != "pad" and ("minimum" in f or "maximum" in f):
+                    return True
+            return False
+    return True
+
+def make_check_invalid_ranges(all_used_structs, struct_name, hpp, cpp_check_invalid_ranges, all_structs):
     hpp.write("        bool check_for_invalid_ranges(bool clamp) override;\n")
     cpp_check_invalid_ranges.write("    bool {}::check_for_invalid_ranges([[maybe_unused]] bool clamp) {{\n".format(struct_name))
     cpp_check_invalid_ranges.write("        bool return_value = false;\n")
     for struct in all_used_structs:
         name = struct["member_name"]
         if struct["type"] == "TagReflexive":
+            # Skip blocks that have nothing to check rather than visiting every element of them
+            if not struct_has_ranged_fields(struct["struct"], all_structs):
+                continue
+
+            # Call the element's function directly (the elements can't be a subclass) and stop early if only checking
             cpp_check_invalid_ranges.write("        for(auto &r : this->{}) {{\n".format(name))
-            cpp_check_invalid_ranges.write("            return_value = r.check_for_invalid_ranges(clamp) || return_value;\n")
+            cpp_check_invalid_ranges.write("            if(r.{}::check_for_invalid_ranges(clamp)) {{\n".format(struct["struct"]))
+            cpp_check_invalid_ranges.write("                if(!clamp) {\n")
+            cpp_check_invalid_ranges.write("                    return true;\n")
+            cpp_check_invalid_ranges.write("                }\n")
+            cpp_check_invalid_ranges.write("                return_value = true;\n")
+            cpp_check_invalid_ranges.write("            }\n")
             cpp_check_invalid_ranges.write("        }\n")
         elif struct["type"] == "TagDataOffset":
             pass
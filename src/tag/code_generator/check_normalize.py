@@ -1,6 +1,28 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
-def make_normalize(all_used_structs, struct_name, hpp, cpp_normalize, normalize):
+# Return True if the struct (or anything it inherits or has in its reflexives) has vectors to check
+def struct_has_normalizable_fields(struct_name, all_structs, visited = None):
+    if visited is None:
+        visited = set()
+    if struct_name in visited:
+        return False
+    visited.add(struct_name)
+    for t in all_structs:
+        if t["name"] == struct_name:
+            if "normalize" in t and t["normalize"]:
+                return True
+            if "inherits" in t and struct_has_normalizable_fields(t["inherits"], all_structs, visited):
+                return True
+            for f in t["fields"]:
+                if f["type"] == "TagReflexive":
+                    if struct_has_normalizable_fields(f["struct"], all_structs, visited):
+                        return True
+                elif "normalize" in f and f["normalize"]:
+                    return True
+            return False
+    return True
+
+def make_normalize(all_used_structs, struct_name, hpp, cpp_normalize, normalize, all_structs):
     hpp.write("        bool check_for_nonnormal_vectors(bool normalize) override;\n")
     cpp_normalize.write("    bool {}::check_for_nonnormal_vectors([[maybe_unused]] bool normalize) {{\n".format(struct_name))
     cpp_normalize.write("        bool return_value = false;\n")
@@ -10,8 +32,18 @@ def make_normalize(all_used_structs, struct_name, hpp, cpp_normalize, normalize)
             continue
         
         if struct["type"] == "TagReflexive":
+            # Skip blocks that have nothing to check rather than visiting every element of them
+            if not struct_has_normalizable_fields(struct["struct"], all_structs):
+                continue
+
+            # Call the element's function directly (the elements can't be a subclass) and stop early if only checking
             cpp_normalize.write("        for(auto &r : this->{}) {{\n".format(name))
-            cpp_normalize.write("            return_value = r.check_for_nonnormal_vectors(normalize) || return_value;\n")
+            cpp_normalize.write("            if(r.{}::check_for_nonnormal_vectors(normalize)) {{\n".format(struct["struct"]))
+            cpp_normalize.write("                if(!normalize) {\n")
+            cpp_normalize.write("                    return true;\n")
+            cpp_normalize.write("                }\n")
+            cpp_normalize.write("                return_value = true;\n")
+            cpp_normalize.write("            }\n")
             cpp_normalize.write("        }\n")
         elif (struct["type"] == "Vector2D" or struct["type"] == "Vector3D" or struct["type"] == "Quaternion"):
             cpp_normalize.write("        if(!this->{}.is_normalized()) {{\n".format(name))
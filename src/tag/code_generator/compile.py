@@ -1,10 +1,33 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
 import sys
+from scan_hek_dependencies import struct_has_tail_data
+
+# Return True if the struct has nothing to compile but its own fields (no dependencies, reflexives, data, or
+# pre/post compile steps), in which case reflexives of it can be compiled with compile_fields() directly
+def struct_is_plain(struct_name, all_structs_arranged):
+    for t in all_structs_arranged:
+        if t["name"] == struct_name:
+            if ("pre_compile" in t and t["pre_compile"]) or ("post_compile" in t and t["post_compile"]):
+                return False
+            return not struct_has_tail_data(struct_name, all_structs_arranged)
+    return False
 
 def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_structs, hpp, cpp_cache_format_data, all_enums, all_structs_arranged):
+    plain = struct_is_plain(struct_name, all_structs_arranged)
+
     # compile()
     hpp.write("        void compile(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::optional<std::size_t> bsp = std::nullopt, std::size_t offset = 0, std::deque<const ParserStruct *> *stack = nullptr) override;\n")
+    if plain:
+        hpp.write("\n        /**\n")
+        hpp.write("         * Compile the struct's fields into an already-allocated struct. This does not need to be called on its own struct\n")
+        hpp.write("         * (unlike compile()), so whole arrays of this struct can be compiled without the per-struct bookkeeping.\n")
+        hpp.write("         * @param workload  workload to report errors to\n")
+        hpp.write("         * @param tag_index index of the tag being compiled\n")
+        hpp.write("         * @param r         struct to write to\n")
+        hpp.write("         * @param stack     stack of structs containing this struct\n")
+        hpp.write("         */\n")
+        hpp.write("        void compile_fields(BuildWorkload &workload, std::size_t tag_index, struct_little &r, std::deque<const ParserStruct *> *stack);\n")
     cpp_cache_format_data.write("    void {}::compile(BuildWorkload &workload, [[maybe_unused]] std::size_t tag_index, std::size_t struct_index, std::optional<std::size_t> bsp, std::size_t offset, std::deque<const ParserStruct *> *stack) {{\n".format(struct_name))
 
     # Make the stack if we need it
@@ -17,21 +40,26 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
     ## Add our struct to the stack
     cpp_cache_format_data.write("        stack->push_front(this);\n")
 
-    # Check if we're on the native engine. if not, check against stock limits (but don't strictly error)
-    cpp_cache_format_data.write("        [[maybe_unused]] auto check_stock_limits = workload.get_build_parameters()->details.build_cache_file_engine != HEK::CacheFileEngine::CACHE_FILE_NATIVE;\n")
-
     # Zero out the base struct
     cpp_cache_format_data.write("        auto *start = workload.structs[struct_index].data.data();\n")
     cpp_cache_format_data.write("        workload.structs[struct_index].bsp = bsp;\n")
     cpp_cache_format_data.write("        workload.structs[struct_index].unsafe_to_dedupe = {};\n".format("true" if ("unsafe_to_dedupe" in s and s["unsafe_to_dedupe"]) else "false"))
     if pre_compile:
         cpp_cache_format_data.write("        if(!this->cache_formatted) {\n")
+        cpp_cache_format_data.write("            BuildWorkload::ProfileScope profile_scope(workload, tag_index, BuildWorkload::PROFILE_STEP_PRE_COMPILE);\n")
         cpp_cache_format_data.write("            this->pre_compile(workload, tag_index, struct_index, offset);\n")
         cpp_cache_format_data.write("        }\n")
         cpp_cache_format_data.write("        this->cache_formatted = true;\n")
     cpp_cache_format_data.write("        auto &r = *reinterpret_cast<struct_little *>(start + offset);\n")
     cpp_cache_format_data.write("        std::fill(reinterpret_cast<std::byte *>(&r), reinterpret_cast<std::byte *>(&r), std::byte());\n")
 
+    # Plain structs do all of their work in compile_fields()
+    if plain:
+        cpp_cache_format_data.write("        this->compile_fields(workload, tag_index, r, stack);\n")
+        cpp_cache_format_data.write("        stack->erase(stack->begin());\n")
+        cpp_cache_format_data.write("    }\n")
+        cpp_cache_format_data.write("    void {}::compile_fields([[maybe_unused]] BuildWorkload &workload, [[maybe_unused]] std::size_t tag_index, [[maybe_unused]] struct_little &r, [[maybe_unused]] std::deque<const ParserStruct *> *stack) {{\n".format(struct_name))
+
     # Go through each field
     for struct in all_used_structs:
         if ("non_cached" in struct and struct["non_cached"]) or ("compile_ignore" in struct and struct["compile_ignore"]):
@@ -81,9 +109,7 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
             cpp_cache_format_data.write("            std::size_t index = workload.compile_tag_recursively(this->{}.path.c_str(), this->{}.tag_fourcc);\n".format(name, name))
             cpp_cache_format_data.write("            this->{}.tag_id.index = static_cast<std::uint16_t>(index);\n".format(name))
             cpp_cache_format_data.write("            r.{}.tag_id = this->{}.tag_id;\n".format(name, name))
-            cpp_cache_format_data.write("            auto &d = workload.structs[struct_index].dependencies.emplace_back();\n")
-            cpp_cache_format_data.write("            d.offset = reinterpret_cast<std::byte *>(&r.{}) - start;\n".format(name))
-            cpp_cache_format_data.write("            d.tag_index = index;\n".format(name))
+            cpp_cache_format_data.write("            workload.structs[struct_index].add_dependency(reinterpret_cast<std::byte *>(&r.{}) - start, index);\n".format(name))
             cpp_cache_format_data.write("        }\n")
             cpp_cache_format_data.write("        else {\n")
             if "non_null" in struct and struct["non_null"]:
@@ -107,14 +133,14 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
                 cpp_cache_format_data.write("            throw InvalidTagDataException();\n")
                 cpp_cache_format_data.write("        }\n")
 
-            # If there's a limit defined by the HEK that is exceeded, warn
+            # If there's a limit defined by the HEK that is exceeded, warn (unless we're on an engine without it)
             if "legacy_maximum" in struct:
-                cpp_cache_format_data.write("        if(check_stock_limits && t_{}_count > {} && workload.get_build_parameters()->details.build_game_engine != HEK::GameEngine::GAME_ENGINE_MCC_COMBAT_EVOLVED_ANNIVERSARY && workload.get_build_parameters()->details.build_game_engine != HEK::GameEngine::GAME_ENGINE_NATIVE) {{\n".format(name, struct["legacy_maximum"]))
+                cpp_cache_format_data.write("        if(workload.check_legacy_stock_limits && t_{}_count > {}) {{\n".format(name, struct["legacy_maximum"]))
                 cpp_cache_format_data.write("            workload.report_error(BuildWorkload::ErrorType::ERROR_TYPE_WARNING, \"{}::{} exceeds the legacy stock limit of {} block{} and may not work as intended on the target engine\", tag_index);\n".format(struct_name, name, struct["legacy_maximum"], "" if struct["legacy_maximum"] == 1 else "s"))
                 cpp_cache_format_data.write("        }\n")
 
             if "maximum" in struct and not "extended_maximum" in struct:
-                cpp_cache_format_data.write("        if(check_stock_limits && t_{}_count > {}) {{\n".format(name, struct["maximum"]))
+                cpp_cache_format_data.write("        if(workload.check_stock_limits && t_{}_count > {}) {{\n".format(name, struct["maximum"]))
                 cpp_cache_format_data.write("            workload.report_error(BuildWorkload::ErrorType::ERROR_TYPE_WARNING, \"{}::{} exceeds the stock limit of {} block{} and may not work as intended on the target engine\", tag_index);\n".format(struct_name, name, struct["maximum"], "" if struct["maximum"] == 1 else "s"))
                 cpp_cache_format_data.write("        }\n")
 
@@ -124,13 +150,28 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
             cpp_cache_format_data.write("            auto &n = workload.structs.emplace_back();\n")
             cpp_cache_format_data.write("            static constexpr std::size_t STRUCT_SIZE = sizeof({}::struct_little);\n".format(struct["struct"]))
             cpp_cache_format_data.write("            n.data.resize(t_{}_count * STRUCT_SIZE);\n".format(name))
-            cpp_cache_format_data.write("            auto &p = workload.structs[struct_index].pointers.emplace_back();\n")
-            cpp_cache_format_data.write("            p.struct_index = &n - workload.structs.data();\n")
-            cpp_cache_format_data.write("            p.offset = reinterpret_cast<std::byte *>(&r.{}.pointer) - start;\n".format(name))
-            cpp_cache_format_data.write("            for(std::size_t i = 0; i < t_{}_count; i++) {{\n".format(name))
-            cpp_cache_format_data.write("                try {\n")
-            cpp_cache_format_data.write("                    this->{}[i].compile(workload, tag_index, p.struct_index, bsp, i * STRUCT_SIZE, stack);\n".format(name))
-            cpp_cache_format_data.write("                }\n")
+            cpp_cache_format_data.write("            std::size_t n_index = &n - workload.structs.data();\n")
+            cpp_cache_format_data.write("            workload.structs[struct_index].add_pointer(reinterpret_cast<std::byte *>(&r.{}.pointer) - start, n_index);\n".format(name))
+            cpp_cache_format_data.write("            BuildWorkload::ReflexiveProfileScope profile_scope(workload, \"{}::{}\", t_{}_count);\n".format(struct_name, name, name))
+            if struct_is_plain(struct["struct"], all_structs_arranged):
+                # Compile the fields of each element straight into the array rather than going through compile() for each one
+                element_unsafe_to_dedupe = False
+                for t in all_structs_arranged:
+                    if t["name"] == struct["struct"]:
+                        element_unsafe_to_dedupe = "unsafe_to_dedupe" in t and t["unsafe_to_dedupe"]
+                        break
+                cpp_cache_format_data.write("            n.bsp = bsp;\n")
+                cpp_cache_format_data.write("            n.unsafe_to_dedupe = {};\n".format("true" if element_unsafe_to_dedupe else "false"))
+                cpp_cache_format_data.write("            auto *elements = reinterpret_cast<{}::struct_little *>(n.data.data());\n".format(struct["struct"]))
+                cpp_cache_format_data.write("            for(std::size_t i = 0; i < t_{}_count; i++) {{\n".format(name))
+                cpp_cache_format_data.write("                try {\n")
+                cpp_cache_format_data.write("                    this->{}[i].compile_fields(workload, tag_index, elements[i], stack);\n".format(name))
+                cpp_cache_format_data.write("                }\n")
+            else:
+                cpp_cache_format_data.write("            for(std::size_t i = 0; i < t_{}_count; i++) {{\n".format(name))
+                cpp_cache_format_data.write("                try {\n")
+                cpp_cache_format_data.write("                    this->{}[i].compile(workload, tag_index, n_index, bsp, i * STRUCT_SIZE, stack);\n".format(name))
+                cpp_cache_format_data.write("                }\n")
             cpp_cache_format_data.write("                catch(std::exception &) {\n")
             cpp_cache_format_data.write("                    eprintf(\"Failed to compile {}::{} #%zu\\n\", i);\n".format(struct_name, name))
             cpp_cache_format_data.write("                    throw;\n")
@@ -143,9 +184,7 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
             cpp_cache_format_data.write("            auto &n = workload.structs.emplace_back();\n")
             cpp_cache_format_data.write("            n.bsp = bsp;\n")
             cpp_cache_format_data.write("            n.data.insert(n.data.begin(), this->{}.begin(), this->{}.end());\n".format(name, name))
-            cpp_cache_format_data.write("            auto &p = workload.structs[struct_index].pointers.emplace_back();\n")
-            cpp_cache_format_data.write("            p.struct_index = &n - workload.structs.data();\n")
-            cpp_cache_format_data.write("            p.offset = reinterpret_cast<std::byte *>(&r.{}.pointer) - start;\n".format(name))
+            cpp_cache_format_data.write("            workload.structs[struct_index].add_pointer(reinterpret_cast<std::byte *>(&r.{}.pointer) - start, &n - workload.structs.data());\n".format(name))
             cpp_cache_format_data.write("            r.{}.size = t_{}_size;\n".format(name, name))
             cpp_cache_format_data.write("        }\n")
         elif "bounds" in struct and struct["bounds"]:
@@ -259,8 +298,12 @@ def make_cache_format_data(struct_name, s, pre_compile, post_compile, all_used_s
                 cpp_cache_format_data.write("        }\n")
             cpp_cache_format_data.write("        r.{} = this->{};\n".format(name, name))
     if post_compile:
-        cpp_cache_format_data.write("        this->post_compile(workload, tag_index, struct_index, offset);\n".format(name, name))
+        cpp_cache_format_data.write("        {\n")
+        cpp_cache_format_data.write("            BuildWorkload::ProfileScope profile_scope(workload, tag_index, BuildWorkload::PROFILE_STEP_POST_COMPILE);\n")
+        cpp_cache_format_data.write("            this->post_compile(workload, tag_index, struct_index, offset);\n")
+        cpp_cache_format_data.write("        }\n")
 
-    ## Remove our struct from the top of the stack
-    cpp_cache_format_data.write("        stack->erase(stack->begin());\n")
+    ## Remove our struct from the top of the stack (plain structs already did this in compile())
+    if not plain:
+        cpp_cache_format_data.write("        stack->erase(stack->begin());\n")
     cpp_cache_format_data.write("    }\n")
@@ -1,34 +1,73 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
 def make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cpp_save_hek_data):
-    hpp.write("        std::vector<std::byte> generate_hek_tag_data(std::optional<TagFourCC> generate_header_class = std::nullopt, bool clear_on_save = false) override;\n")
-    cpp_save_hek_data.write("    std::vector<std::byte> {}::generate_hek_tag_data(std::optional<TagFourCC> generate_header_class, bool clear_on_save) {{\n".format(struct_name))
+    saved_structs = []
+    for struct in all_used_structs:
+        if (("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])):
+            continue
+        saved_structs.append(struct)
+
+    writes_data = False
+    for struct in saved_structs:
+        if struct["type"] in ["TagDependency", "TagReflexive", "TagDataOffset"] and not ("drop_on_extract_hidden" in struct and struct["drop_on_extract_hidden"]):
+            writes_data = True
+
+    hpp.write("        std::size_t calculate_hek_tag_data_size() override;\n")
+    hpp.write("        std::size_t write_hek_tag_data(std::byte *output, std::size_t output_size, bool clear_on_save = false) override;\n")
+    hpp.write("        void write_hek_tag_data(std::byte *struct_data, std::byte *&data, const std::byte *data_end, bool clear_on_save);\n")
+
+    # Calculate the size first so the whole tag can be written into one buffer
+    cpp_save_hek_data.write("    std::size_t {}::calculate_hek_tag_data_size() {{\n".format(struct_name))
+    cpp_save_hek_data.write("        this->cache_deformat();\n")
+    cpp_save_hek_data.write("        std::size_t size = sizeof(struct_big);\n")
+    for struct in saved_structs:
+        name = struct["member_name"]
+        if "drop_on_extract_hidden" in struct and struct["drop_on_extract_hidden"]:
+            continue
+        if struct["type"] == "TagDependency":
+            cpp_save_hek_data.write("        if(this->{}.path.size() > 0) {{\n".format(name))
+            cpp_save_hek_data.write("            size += this->{}.path.size() + 1;\n".format(name))
+            cpp_save_hek_data.write("        }\n")
+        elif struct["type"] == "TagReflexive":
+            cpp_save_hek_data.write("        for(auto &i : this->{}) {{\n".format(name))
+            cpp_save_hek_data.write("            size += i.calculate_hek_tag_data_size();\n")
+            cpp_save_hek_data.write("        }\n")
+        elif struct["type"] == "TagDataOffset":
+            cpp_save_hek_data.write("        size += this->{}.size();\n".format(name))
+    cpp_save_hek_data.write("        return size;\n")
+    cpp_save_hek_data.write("    }\n")
+
+    cpp_save_hek_data.write("    std::size_t {}::write_hek_tag_data(std::byte *output, std::size_t output_size, bool clear_on_save) {{\n".format(struct_name))
     cpp_save_hek_data.write("        this->cache_deformat();\n")
-    cpp_save_hek_data.write("        std::vector<std::byte> converted_data(sizeof(struct_big));\n")
-    cpp_save_hek_data.write("        std::size_t tag_header_offset = 0;\n")
-    cpp_save_hek_data.write("        if(generate_header_class.has_value()) {\n")
-    cpp_save_hek_data.write("            HEK::TagFileHeader header(*generate_header_class);\n")
-    cpp_save_hek_data.write("            tag_header_offset = sizeof(header);\n")
-    cpp_save_hek_data.write("            converted_data.insert(converted_data.begin(), reinterpret_cast<std::byte *>(&header), reinterpret_cast<std::byte *>(&header + 1));\n")
-    cpp_save_hek_data.write("        }\n")
+    cpp_save_hek_data.write("        std::byte *data = output;\n")
+    cpp_save_hek_data.write("        const std::byte *data_end = output + output_size;\n")
+    cpp_save_hek_data.write("        auto *struct_data = reserve_hek_tag_data(data, data_end, sizeof(struct_big));\n")
+    cpp_save_hek_data.write("        this->write_hek_tag_data(struct_data, data, data_end, clear_on_save);\n")
+    cpp_save_hek_data.write("        return static_cast<std::size_t>(data - output);\n")
+    cpp_save_hek_data.write("    }\n")
+
+    # Write the struct into struct_data and anything it points to at data, with everything a reflexive points to coming after all of its structs
+    if writes_data:
+        cpp_save_hek_data.write("    void {}::write_hek_tag_data(std::byte *struct_data, std::byte *&data, const std::byte *data_end, bool clear_on_save) {{\n".format(struct_name))
+    else:
+        cpp_save_hek_data.write("    void {}::write_hek_tag_data(std::byte *struct_data, std::byte *&, const std::byte *, bool) {{\n".format(struct_name))
     if len(all_used_structs) > 0:
+        cpp_save_hek_data.write("        this->cache_deformat();\n")
         cpp_save_hek_data.write("        struct_big b = {};\n")
-        for struct in all_used_structs:
-            if (("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])):
-                continue
+        for struct in saved_structs:
             name = struct["member_name"]
             if "drop_on_extract_hidden" in struct and struct["drop_on_extract_hidden"]:
                 cpp_save_hek_data.write("        b.{} = {{}};\n".format(name))
                 continue
             if struct["type"] == "TagDependency":
                 cpp_save_hek_data.write("        std::size_t {}_size = static_cast<std::uint32_t>(this->{}.path.size());\n".format(name,name))
-                
+
                 cpp_save_hek_data.write("        b.{}.tag_id = HEK::TagID::null_tag_id();\n".format(name))
                 cpp_save_hek_data.write("        b.{}.tag_fourcc = this->{}.tag_fourcc;\n".format(name, name))
                 cpp_save_hek_data.write("        if({}_size > 0) {{\n".format(name))
                 cpp_save_hek_data.write("            b.{}.path_size = static_cast<std::uint32_t>({}_size);\n".format(name, name))
                 cpp_save_hek_data.write("            const auto *path_str = reinterpret_cast<const std::byte *>(this->{}.path.c_str());\n".format(name))
-                cpp_save_hek_data.write("            converted_data.insert(converted_data.end(), path_str, path_str + {}_size + 1);\n".format(name))
+                cpp_save_hek_data.write("            std::copy(path_str, path_str + {}_size + 1, reserve_hek_tag_data(data, data_end, {}_size + 1));\n".format(name, name))
                 cpp_save_hek_data.write("            if(clear_on_save) {\n")
                 cpp_save_hek_data.write("                this->{}.path = std::string();\n".format(name))
                 cpp_save_hek_data.write("            }\n")
@@ -37,20 +76,15 @@ def make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cp
                     cpp_save_hek_data.write("        else if(this->{}.tag_fourcc == HEK::TagFourCC::TAG_FOURCC_NULL) {{\n".format(name))
                     cpp_save_hek_data.write("            b.{}.tag_fourcc = HEK::TagFourCC::TAG_FOURCC_{};\n".format(name, struct["classes"][0].upper()))
                     cpp_save_hek_data.write("        }\n")
-                    
+
             elif struct["type"] == "TagReflexive":
                 cpp_save_hek_data.write("        auto ref_{}_size = this->{}.size();\n".format(name, name))
                 cpp_save_hek_data.write("        if(ref_{}_size > 0) {{\n".format(name))
                 cpp_save_hek_data.write("            b.{}.count = static_cast<std::uint32_t>(ref_{}_size);\n".format(name, name))
                 cpp_save_hek_data.write("            constexpr std::size_t STRUCT_SIZE = sizeof({}::struct_big);\n".format(struct["struct"]))
-                cpp_save_hek_data.write("            auto total_size = STRUCT_SIZE * ref_{}_size;\n".format(name))
-                cpp_save_hek_data.write("            const std::size_t FIRST_STRUCT_OFFSET = converted_data.size();\n")
-                cpp_save_hek_data.write("            converted_data.insert(converted_data.end(), total_size, std::byte());\n")
+                cpp_save_hek_data.write("            auto *first_struct = reserve_hek_tag_data(data, data_end, STRUCT_SIZE * ref_{}_size);\n".format(name))
                 cpp_save_hek_data.write("            for(std::size_t i = 0; i < ref_{}_size; i++) {{\n".format(name))
-                cpp_save_hek_data.write("                const auto converted_struct = this->{}[i].generate_hek_tag_data(std::nullopt, clear_on_save);\n".format(name))
-                cpp_save_hek_data.write("                const auto *struct_data = converted_struct.data();\n")
-                cpp_save_hek_data.write("                std::copy(struct_data, struct_data + STRUCT_SIZE, converted_data.data() + FIRST_STRUCT_OFFSET + STRUCT_SIZE * i);\n")
-                cpp_save_hek_data.write("                converted_data.insert(converted_data.end(), struct_data + STRUCT_SIZE, struct_data + converted_struct.size());\n")
+                cpp_save_hek_data.write("                this->{}[i].write_hek_tag_data(first_struct + STRUCT_SIZE * i, data, data_end, clear_on_save);\n".format(name))
                 cpp_save_hek_data.write("            }\n")
                 cpp_save_hek_data.write("            if(clear_on_save) {\n")
                 cpp_save_hek_data.write("                this->{} = std::vector<{}>();\n".format(name, struct["struct"]))
@@ -58,7 +92,7 @@ def make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cp
                 cpp_save_hek_data.write("        }\n")
             elif struct["type"] == "TagDataOffset":
                 cpp_save_hek_data.write("        b.{}.size = static_cast<std::uint32_t>(this->{}.size());\n".format(name, name))
-                cpp_save_hek_data.write("        converted_data.insert(converted_data.end(), this->{}.begin(), this->{}.end());\n".format(name, name, name))
+                cpp_save_hek_data.write("        std::copy(this->{}.begin(), this->{}.end(), reserve_hek_tag_data(data, data_end, this->{}.size()));\n".format(name, name, name))
                 cpp_save_hek_data.write("        if(clear_on_save) {\n")
                 cpp_save_hek_data.write("            this->{} = std::vector<std::byte>();\n".format(name))
                 cpp_save_hek_data.write("        }\n")
@@ -81,9 +115,7 @@ def make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cp
                         if "__excluded" in struct and struct["__excluded"] is not None:
                             negate = "{} & ~static_cast<std::uint{}_t>(0x{:X})".format(negate, b["width"], struct["__excluded"])
                 cpp_save_hek_data.write("        b.{} = this->{}{};\n".format(name, name, negate))
-        cpp_save_hek_data.write("        *reinterpret_cast<struct_big *>(converted_data.data() + tag_header_offset) = b;\n")
-    cpp_save_hek_data.write("        if(generate_header_class.has_value()) {\n")
-    cpp_save_hek_data.write("            reinterpret_cast<HEK::TagFileHeader *>(converted_data.data())->crc32 = ~crc32(clear_on_save ^ clear_on_save, reinterpret_cast<const void *>(converted_data.data() + tag_header_offset), converted_data.size() - tag_header_offset);\n")
-    cpp_save_hek_data.write("        }\n")
-    cpp_save_hek_data.write("        return converted_data;\n")
+        cpp_save_hek_data.write("        std::memcpy(struct_data, &b, sizeof(b));\n")
+    else:
+        cpp_save_hek_data.write("        std::fill(struct_data, struct_data + sizeof(struct_big), std::byte());\n")
     cpp_save_hek_data.write("    }\n")
@@ -4,8 +4,9 @@ from copy import deepcopy
 from compile import make_cache_format_data
 from generate_hek_tag_data import make_cpp_save_hek_data
 from read_cache_file_data import make_parse_cache_file_data
-from read_hek_data import make_parse_hek_tag_data
+from read_hek_data import make_parse_hek_tag_data, make_parse_hek_tag_base_struct
 from read_hek_file import make_parse_hek_tag_file
+from scan_hek_dependencies import make_scan_hek_tag_dependencies
 from cache_deformat_data import make_cache_deformat
 from refactor_reference import make_refactor_reference
 from parser_struct import make_parser_struct
@@ -51,8 +52,21 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
     cpp_cache_format_data.write("#include <invader/build/build_workload.hpp>\n")
     cpp_read_cache_file_data.write("#include <invader/file/file.hpp>\n")
     cpp_read_hek_data.write("#include <invader/file/file.hpp>\n")
-    cpp_save_hek_data.write("extern \"C\" std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size) noexcept;\n")
+    cpp_read_hek_data.write("#include <cstring>\n")
+    cpp_read_hek_file.write("#include <cstring>\n")
+    cpp_save_hek_data.write("#include <invader/error.hpp>\n")
+    cpp_save_hek_data.write("#include <cstring>\n")
+    cpp_scan_padding.write("#include <cstdio>\n")
+    cpp_scan_padding.write("#include <cstring>\n")
     write_for_all_cpps("namespace Invader::Parser {\n")
+    cpp_save_hek_data.write("    static std::byte *reserve_hek_tag_data(std::byte *&data, const std::byte *data_end, std::size_t size) {\n")
+    cpp_save_hek_data.write("        if(static_cast<std::size_t>(data_end - data) < size) {\n")
+    cpp_save_hek_data.write("            throw OutOfBoundsException();\n")
+    cpp_save_hek_data.write("        }\n")
+    cpp_save_hek_data.write("        auto *reserved = data;\n")
+    cpp_save_hek_data.write("        data += size;\n")
+    cpp_save_hek_data.write("        return reserved;\n")
+    cpp_save_hek_data.write("    }\n")
 
     for struct in all_structs_arranged:
         struct_name = struct["name"]
@@ -186,12 +200,14 @@ def make_parser(all_enums, all_bitfields, all_structs_arranged, all_structs, hpp
         make_cpp_save_hek_data(all_bitfields, all_used_structs, struct_name, hpp, cpp_save_hek_data)
         make_parse_cache_file_data(post_cache_parse, all_bitfields, all_used_structs, struct_name, hpp, cpp_read_cache_file_data)
         make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data)
+        make_parse_hek_tag_base_struct(all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data)
         make_parse_hek_tag_file(struct_name, hpp, cpp_read_hek_file)
+        make_scan_hek_tag_dependencies(struct_name, all_used_structs, all_structs, hpp, cpp_read_hek_file)
         make_refactor_reference(all_used_structs, struct_name, hpp, cpp_refactor_reference)
         make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_structs, all_used_groups, hpp, struct_name, read_only, title)
-        make_check_invalid_ranges(all_used_structs, struct_name, hpp, cpp_check_invalid_ranges)
+        make_check_invalid_ranges(all_used_structs, struct_name, hpp, cpp_check_invalid_ranges, all_structs)
         make_check_invalid_indices(all_used_structs, struct_name, hpp, cpp_check_invalid_indices, all_structs_arranged)
-        make_normalize(all_used_structs, struct_name, hpp, cpp_normalize, normalize)
+        make_normalize(all_used_structs, struct_name, hpp, cpp_normalize, normalize, all_structs)
 
         hpp.write("        ~{}() override = default;\n".format(struct_name))
 
@@ -5,8 +5,11 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
     hpp.write("        std::vector<ParserStructValue> get_values_internal() override;\n".format(struct_name))
     hpp.write("    public:\n".format(struct_name))
     cpp_struct_value.write("std::vector<ParserStructValue> {}::get_values_internal() {{\n".format(struct_name))
-    cpp_struct_value.write("    std::vector<ParserStructValue> values;\n")
-    cpp_struct_value.write("    values.reserve({});\n".format(len(all_used_structs)))
+
+    # Everything but the addresses is the same for every instance, so only make the descriptors once
+    cpp_struct_value.write("    static const std::vector<ParserStructValue::Descriptor> descriptors = [this]() {\n")
+    cpp_struct_value.write("        std::vector<ParserStructValue::Descriptor> descriptors;\n")
+    cpp_struct_value.write("        descriptors.reserve({});\n".format(len(all_used_structs)))
 
     for struct in all_used_structs:
         if "hidden" in struct and struct["hidden"]:
@@ -28,10 +31,10 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
         # If this is the start of a group, add a group
         for i in all_used_groups:
             if i["first"] == struct["name"]:
-                cpp_struct_value.write("    values.emplace_back(\"{}\", {});\n".format(i["name"], make_cpp_string(i["description"])))
+                cpp_struct_value.write("        descriptors.emplace_back(\"{}\", {});\n".format(i["name"], make_cpp_string(i["description"])))
                 break
 
-        first_arguments = "{},{},{},&this->{}".format(name, member_name_q, comment, struct["member_name"])
+        first_arguments = "this,{},{},{},&this->{}".format(name, member_name_q, comment, struct["member_name"])
         type = struct["type"]
 
         if type == "TagDependency":
@@ -39,15 +42,15 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
             classes_len = len(classes)
 
             if classes[0] == "*":
-                cpp_struct_value.write("    values.emplace_back({}, nullptr, 0, {});\n".format(first_arguments, struct_read_only))
+                cpp_struct_value.write("        descriptors.emplace_back({}, nullptr, 0, {});\n".format(first_arguments, struct_read_only))
             else:
-                cpp_struct_value.write("    TagFourCC {}_types[] = {{".format(member_name));
+                cpp_struct_value.write("        static constexpr TagFourCC {}_types[] = {{".format(member_name));
                 for c in range(0, classes_len):
                     if c != 0:
                         cpp_struct_value.write(", ")
                     cpp_struct_value.write("TagFourCC::TAG_FOURCC_{}".format(classes[c].upper()))
                 cpp_struct_value.write("};\n");
-                cpp_struct_value.write("    values.emplace_back({}, {}_types, {}, {});\n".format(first_arguments, member_name, classes_len, struct_read_only))
+                cpp_struct_value.write("        descriptors.emplace_back({}, {}_types, {}, {});\n".format(first_arguments, member_name, classes_len, struct_read_only))
         elif type == "TagReflexive":
             minimum = 0 if not ("minimum" in struct) else struct["minimum"]
             maximum = 0xFFFFFFFF
@@ -58,9 +61,9 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
                 maximum = struct["maximum"]
 
             vstruct = "std::vector<{}>".format(struct["struct"])
-            cpp_struct_value.write("    values.emplace_back({}, ParserStructValue::get_object_in_array_template<{}>, ParserStructValue::get_array_size_template<{}>, ParserStructValue::delete_objects_in_array_template<{}>, ParserStructValue::insert_object_in_array_template<{}>, ParserStructValue::duplicate_object_in_array_template<{}>, ParserStructValue::swap_object_in_array_template<{}>, static_cast<std::size_t>({}), static_cast<std::size_t>({}), {});\n".format(first_arguments, vstruct, vstruct, vstruct, vstruct, vstruct, vstruct, minimum, maximum, struct_read_only))
+            cpp_struct_value.write("        descriptors.emplace_back({}, ParserStructValue::get_object_in_array_template<{}>, ParserStructValue::get_array_size_template<{}>, ParserStructValue::delete_objects_in_array_template<{}>, ParserStructValue::insert_object_in_array_template<{}>, ParserStructValue::duplicate_object_in_array_template<{}>, ParserStructValue::swap_object_in_array_template<{}>, static_cast<std::size_t>({}), static_cast<std::size_t>({}), {});\n".format(first_arguments, vstruct, vstruct, vstruct, vstruct, vstruct, vstruct, minimum, maximum, struct_read_only))
         elif type == "TagDataOffset" or type == "TagString":
-            cpp_struct_value.write("    values.emplace_back({}, {});\n".format(first_arguments, struct_read_only))
+            cpp_struct_value.write("        descriptors.emplace_back({}, {});\n".format(first_arguments, struct_read_only))
         elif type == "ScenarioScriptNodeValue" or type == "ScenarioStructureBSPArrayVertex":
             pass
         else:
@@ -92,29 +95,29 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
                     if mask == 0:
                         break
 
-                    cpp_struct_value.write("    values.emplace_back({}, ParserStructValue::list_bitmask_template<HEK::{}, HEK::{}_to_string, {}, 0x{:X}>, ParserStructValue::list_bitmask_template<HEK::{}, HEK::{}_to_string_pretty, {}, 0x{:X}>, ParserStructValue::read_bitfield_template<HEK::{}, HEK::{}_from_string>, ParserStructValue::write_bitfield_template<HEK::{}, HEK::{}_from_string>, {});\n".format(first_arguments, type, type, len(b["fields_formatted"]), mask, type, type, len(b["fields_formatted"]), mask, type, type, type, type, struct_read_only))
+                    cpp_struct_value.write("        descriptors.emplace_back({}, ParserStructValue::list_bitmask_template<HEK::{}, HEK::{}_to_string, {}, 0x{:X}>, ParserStructValue::list_bitmask_template<HEK::{}, HEK::{}_to_string_pretty, {}, 0x{:X}>, ParserStructValue::read_bitfield_template<HEK::{}, HEK::{}_from_string>, ParserStructValue::write_bitfield_template<HEK::{}, HEK::{}_from_string>, {});\n".format(first_arguments, type, type, len(b["fields_formatted"]), mask, type, type, len(b["fields_formatted"]), mask, type, type, type, type, struct_read_only))
                     break
             if found:
                 continue
             for e in all_enums:
                 if type == e["name"]:
                     found = True
-                    cpp_struct_value.write("    {\n")
+                    cpp_struct_value.write("        {\n")
                     ignorelist_params = ""
 
                     # Make an ignorelist to hold stuff we don't want to list
                     if "__excluded" in struct and struct["__excluded"] is not None:
-                        cpp_struct_value.write("    static HEK::{} ignorelist[] = {{\n".format(e["name"]))
+                        cpp_struct_value.write("            static HEK::{} ignorelist[] = {{\n".format(e["name"]))
                         for x in struct["__excluded"]:
-                            cpp_struct_value.write("        static_cast<HEK::{}>({}),\n".format(e["name"], x))
-                        cpp_struct_value.write("    };\n")
+                            cpp_struct_value.write("                static_cast<HEK::{}>({}),\n".format(e["name"], x))
+                        cpp_struct_value.write("            };\n")
                         ignorelist_params = ", ignorelist, {}".format(len(struct["__excluded"]))
 
                     # Do it!
                     list_enum_invocation = "ParserStructValue::list_enum_template<HEK::{}, HEK::{}_to_string{{}}, {}{}>".format(type, type, len(e["options_formatted"]), ignorelist_params)
 
-                    cpp_struct_value.write("        values.emplace_back({}, {}, {}, ParserStructValue::read_enum_template<HEK::{}, HEK::{}_to_string>, ParserStructValue::write_enum_template<HEK::{}, HEK::{}_from_string>, {});\n".format(first_arguments, list_enum_invocation.format(""), list_enum_invocation.format("_pretty"), type, type, type, type, struct_read_only))
-                    cpp_struct_value.write("    }\n")
+                    cpp_struct_value.write("            descriptors.emplace_back({}, {}, {}, ParserStructValue::read_enum_template<HEK::{}, HEK::{}_to_string>, ParserStructValue::write_enum_template<HEK::{}, HEK::{}_from_string>, {});\n".format(first_arguments, list_enum_invocation.format(""), list_enum_invocation.format("_pretty"), type, type, type, type, struct_read_only))
+                    cpp_struct_value.write("        }\n")
                     break
             if found:
                 continue
@@ -126,9 +129,11 @@ def make_parser_struct(cpp_struct_value, all_enums, all_bitfields, all_used_stru
             maximum = "static_cast<ParserStructValue::Number>({})".format(struct["maximum"]) if "maximum" in struct else "std::nullopt"
             volatile = "true" if ("volatile" in struct and struct["volatile"]) else "false"
 
-            cpp_struct_value.write("    values.emplace_back({}, ParserStructValue::ValueType::VALUE_TYPE_{}, {}, {}, {}, {}, {}, {}, {});\n".format(first_arguments, type.upper(), unit, count, bounds, volatile, struct_read_only, minimum, maximum))
+            cpp_struct_value.write("        descriptors.emplace_back({}, ParserStructValue::ValueType::VALUE_TYPE_{}, {}, {}, {}, {}, {}, {}, {});\n".format(first_arguments, type.upper(), unit, count, bounds, volatile, struct_read_only, minimum, maximum))
 
-    cpp_struct_value.write("    return values;\n")
+    cpp_struct_value.write("        return descriptors;\n")
+    cpp_struct_value.write("    }();\n")
+    cpp_struct_value.write("    return ParserStructValue::from_descriptors(descriptors, this);\n")
     cpp_struct_value.write("}\n")
 
     hpp.write("        const char *struct_name() const override;\n")
@@ -1,29 +1,8 @@
 # SPDX-License-Identifier: GPL-3.0-only
 
-def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data):
-    hpp.write("\n        /**\n")
-    hpp.write("         * Parse the HEK tag data.\n")
-    hpp.write("         * @param data        Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
-    hpp.write("         * @param data_size   Size of the buffer\n")
-    hpp.write("         * @param data_read   This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
-    hpp.write("         * @param postprocess Do post-processing on data, such as default values\n")
-    hpp.write("         * @param data_this   Pointer to the struct; if this is null, then data will be used instead\n")
-    hpp.write("         * @return parsed tag data\n")
-    hpp.write("         */\n")
-    hpp.write("        static {} parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, bool postprocess = false, const std::byte *data_this = nullptr);\n".format(struct_name))
-    cpp_read_hek_data.write("    {} {}::parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] bool postprocess, const std::byte *data_this) {{\n".format(struct_name, struct_name))
-    cpp_read_hek_data.write("        {} r = {{}};\n".format(struct_name))
-    cpp_read_hek_data.write("        data_read = 0;\n")
-    cpp_read_hek_data.write("        if(data_this == nullptr) {\n")
-    cpp_read_hek_data.write("            if(sizeof(struct_big) > data_size) {\n")
-    cpp_read_hek_data.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
-    cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
-    cpp_read_hek_data.write("            }\n")
-    cpp_read_hek_data.write("            data_this = data;\n")
-    cpp_read_hek_data.write("            data_size -= sizeof(struct_big);\n")
-    cpp_read_hek_data.write("            data_read += sizeof(struct_big);\n")
-    cpp_read_hek_data.write("            data += sizeof(struct_big);\n")
-    cpp_read_hek_data.write("        }\n")
+# Write the code that reads each field from h into r. If base_struct_only is set, anything stored after the struct
+# (dependency paths, reflexives, and data) is left empty.
+def write_read_hek_fields(all_bitfields, struct_name, all_used_structs, cpp_read_hek_data, base_struct_only):
     if len(all_used_structs) > 0:
         cpp_read_hek_data.write("        [[maybe_unused]] const auto &h = *reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data_this);\n".format(struct_name))
         for struct in all_used_structs:
@@ -32,7 +11,11 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
             if unread and struct["type"] != "TagReflexive" and struct["type"] != "TagDependency" and struct["type"] != "TagDataOffset":
                 continue
             default_sign = "<=" if "default_sign" in struct and struct["default_sign"] else "=="
-            if struct["type"] == "TagDependency":
+            if struct["type"] == "TagDependency" and base_struct_only:
+                cpp_read_hek_data.write("        r.{}.tag_fourcc = h.{}.tag_fourcc;\n".format(name, name))
+            elif (struct["type"] == "TagReflexive" or struct["type"] == "TagDataOffset") and base_struct_only:
+                continue
+            elif struct["type"] == "TagDependency":
                 cpp_read_hek_data.write("        std::size_t h_{}_expected_length = h.{}.path_size;\n".format(name,name))
                 
                 cpp_read_hek_data.write("        r.{}.tag_fourcc = h.{}.tag_fourcc;\n".format(name, name))
@@ -53,7 +36,9 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
                 cpp_read_hek_data.write("                throw InvalidTagDataException();\n")
                 cpp_read_hek_data.write("            }\n")
                 if not unread:
-                    cpp_read_hek_data.write("            r.{}.path = Invader::File::remove_duplicate_slashes(std::string(reinterpret_cast<const char *>(data)));\n".format(name))
+                    cpp_read_hek_data.write("            r.{}.path.assign(h_{}_char, h_{}_expected_length);\n".format(name, name, name))
+                    cpp_read_hek_data.write("            Invader::File::remove_duplicate_slashes_chars(r.{}.path.data());\n".format(name))
+                    cpp_read_hek_data.write("            r.{}.path.resize(std::strlen(r.{}.path.c_str()));\n".format(name, name))
                 cpp_read_hek_data.write("            data_size -= h_{}_expected_length + 1;\n".format(name))
                 cpp_read_hek_data.write("            data_read += h_{}_expected_length + 1;\n".format(name))
                 cpp_read_hek_data.write("            data += h_{}_expected_length + 1;\n".format(name))
@@ -95,7 +80,7 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
                 cpp_read_hek_data.write("            throw OutOfBoundsException();\n")
                 cpp_read_hek_data.write("        }\n")
                 if not unread:
-                    cpp_read_hek_data.write("        r.{} = std::vector<std::byte>(data, data + h_{}_size);\n".format(name, name))
+                    cpp_read_hek_data.write("        r.{}.assign(data, data + h_{}_size);\n".format(name, name))
                 cpp_read_hek_data.write("        data_size -= h_{}_size;\n".format(name))
                 cpp_read_hek_data.write("        data_read += h_{}_size;\n".format(name))
                 cpp_read_hek_data.write("        data += h_{}_size;\n".format(name))
@@ -169,9 +154,50 @@ def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, al
                         cpp_read_hek_data.write("        if(postprocess && r.{} {} 0) {{\n".format(name, default_sign))
                         cpp_read_hek_data.write("            r.{} = {}{};\n".format(name, default, suffix))
                         cpp_read_hek_data.write("        }\n")
+
+def make_parse_hek_tag_data(postprocess_hek_data, all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data):
+    hpp.write("\n        /**\n")
+    hpp.write("         * Parse the HEK tag data.\n")
+    hpp.write("         * @param data        Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
+    hpp.write("         * @param data_size   Size of the buffer\n")
+    hpp.write("         * @param data_read   This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
+    hpp.write("         * @param postprocess Do post-processing on data, such as default values\n")
+    hpp.write("         * @param data_this   Pointer to the struct; if this is null, then data will be used instead\n")
+    hpp.write("         * @return parsed tag data\n")
+    hpp.write("         */\n")
+    hpp.write("        static {} parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, bool postprocess = false, const std::byte *data_this = nullptr);\n".format(struct_name))
+    cpp_read_hek_data.write("    {} {}::parse_hek_tag_data(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] bool postprocess, const std::byte *data_this) {{\n".format(struct_name, struct_name))
+    cpp_read_hek_data.write("        {} r = {{}};\n".format(struct_name))
+    cpp_read_hek_data.write("        data_read = 0;\n")
+    cpp_read_hek_data.write("        if(data_this == nullptr) {\n")
+    cpp_read_hek_data.write("            if(sizeof(struct_big) > data_size) {\n")
+    cpp_read_hek_data.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
+    cpp_read_hek_data.write("                throw OutOfBoundsException();\n")
+    cpp_read_hek_data.write("            }\n")
+    cpp_read_hek_data.write("            data_this = data;\n")
+    cpp_read_hek_data.write("            data_size -= sizeof(struct_big);\n")
+    cpp_read_hek_data.write("            data_read += sizeof(struct_big);\n")
+    cpp_read_hek_data.write("            data += sizeof(struct_big);\n")
+    cpp_read_hek_data.write("        }\n")
+    write_read_hek_fields(all_bitfields, struct_name, all_used_structs, cpp_read_hek_data, False)
     if postprocess_hek_data:
         cpp_read_hek_data.write("        if(postprocess) {\n")
         cpp_read_hek_data.write("            r.postprocess_hek_data();\n")
         cpp_read_hek_data.write("        }\n")
     cpp_read_hek_data.write("        return r;\n")
     cpp_read_hek_data.write("    }\n")
+
+def make_parse_hek_tag_base_struct(all_bitfields, struct_name, all_used_structs, hpp, cpp_read_hek_data):
+    hpp.write("\n        /**\n")
+    hpp.write("         * Parse only the fields stored in the HEK struct itself. Dependency paths, reflexives, and data are left\n")
+    hpp.write("         * empty, so this is much faster than parse_hek_tag_data() when only those fields are needed.\n")
+    hpp.write("         * @param data_this   Pointer to the struct; this must be at least sizeof(struct_big) bytes\n")
+    hpp.write("         * @param postprocess Set default values\n")
+    hpp.write("         * @return parsed tag data\n")
+    hpp.write("         */\n")
+    hpp.write("        static {} parse_hek_tag_base_struct(const std::byte *data_this, bool postprocess = false);\n".format(struct_name))
+    cpp_read_hek_data.write("    {} {}::parse_hek_tag_base_struct([[maybe_unused]] const std::byte *data_this, [[maybe_unused]] bool postprocess) {{\n".format(struct_name, struct_name))
+    cpp_read_hek_data.write("        {} r = {{}};\n".format(struct_name))
+    write_read_hek_fields(all_bitfields, struct_name, all_used_structs, cpp_read_hek_data, True)
+    cpp_read_hek_data.write("        return r;\n")
+    cpp_read_hek_data.write("    }\n")
@@ -0,0 +1,96 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+TAIL_DATA_TYPES = ["TagDependency", "TagReflexive", "TagDataOffset"]
+
+# Return True if the struct (or anything it inherits) has data stored after the struct in a tag file
+def struct_has_tail_data(struct_name, all_structs):
+    for t in all_structs:
+        if t["name"] == struct_name:
+            if "inherits" in t and struct_has_tail_data(t["inherits"], all_structs):
+                return True
+            for f in t["fields"]:
+                if f["type"] in TAIL_DATA_TYPES:
+                    return True
+            return False
+    return True
+
+def make_scan_hek_tag_dependencies(struct_name, all_used_structs, all_structs, hpp, cpp_read_hek_file):
+    hpp.write("\n        /**\n")
+    hpp.write("         * Find all dependencies in the HEK tag data without parsing it.\n")
+    hpp.write("         * @param data      Data to read from for structs, tag references, and reflexives; if data_this is nullptr, this must point to the struct\n")
+    hpp.write("         * @param data_size Size of the buffer\n")
+    hpp.write("         * @param data_read This will be set to the amount of data read. If data_this is null, then the initial struct will also be added\n")
+    hpp.write("         * @param callback  Function to call for each non-empty dependency\n")
+    hpp.write("         * @param data_this Pointer to the struct; if this is null, then data will be used instead\n")
+    hpp.write("         */\n")
+    hpp.write("        static void scan_hek_tag_dependencies(const std::byte *data, std::size_t data_size, std::size_t &data_read, const DependencyScanFunction &callback, const std::byte *data_this = nullptr);\n")
+    cpp_read_hek_file.write("    void {}::scan_hek_tag_dependencies(const std::byte *data, std::size_t data_size, std::size_t &data_read, [[maybe_unused]] const DependencyScanFunction &callback, const std::byte *data_this) {{\n".format(struct_name))
+    cpp_read_hek_file.write("        data_read = 0;\n")
+    cpp_read_hek_file.write("        if(data_this == nullptr) {\n")
+    cpp_read_hek_file.write("            if(sizeof(struct_big) > data_size) {\n")
+    cpp_read_hek_file.write("                eprintf_error(\"Failed to read {} base struct: %zu bytes needed > %zu bytes available\", sizeof(struct_big), data_size);\n".format(struct_name))
+    cpp_read_hek_file.write("                throw OutOfBoundsException();\n")
+    cpp_read_hek_file.write("            }\n")
+    cpp_read_hek_file.write("            data_this = data;\n")
+    cpp_read_hek_file.write("            data_size -= sizeof(struct_big);\n")
+    cpp_read_hek_file.write("            data_read += sizeof(struct_big);\n")
+    cpp_read_hek_file.write("            data += sizeof(struct_big);\n")
+    cpp_read_hek_file.write("        }\n")
+
+    tail_structs = [s for s in all_used_structs if s["type"] in TAIL_DATA_TYPES]
+    if len(tail_structs) > 0:
+        cpp_read_hek_file.write("        const auto &h = *reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data_this);\n".format(struct_name))
+    for struct in tail_structs:
+        name = struct["member_name"]
+        unread = ("cache_only" in struct and struct["cache_only"]) or ("unused" in struct and struct["unused"])
+        if struct["type"] == "TagDependency":
+            cpp_read_hek_file.write("        std::size_t h_{}_length = h.{}.path_size;\n".format(name, name))
+            cpp_read_hek_file.write("        if(h_{}_length > 0) {{\n".format(name))
+            cpp_read_hek_file.write("            if(h_{}_length + 1 > data_size) {{\n".format(name))
+            cpp_read_hek_file.write("                eprintf_error(\"Failed to read dependency {}::{}: %zu bytes needed > %zu bytes available\", h_{}_length, data_size);\n".format(struct_name, name, name))
+            cpp_read_hek_file.write("                throw OutOfBoundsException();\n")
+            cpp_read_hek_file.write("            }\n")
+            cpp_read_hek_file.write("            const char *h_{}_char = reinterpret_cast<const char *>(data);\n".format(name))
+            cpp_read_hek_file.write("            if(h_{}_char[h_{}_length] != 0 || std::strlen(h_{}_char) != h_{}_length) {{\n".format(name, name, name, name))
+            cpp_read_hek_file.write("                eprintf_error(\"Failed to read dependency {}::{}: size does not match the path\");\n".format(struct_name, name))
+            cpp_read_hek_file.write("                throw InvalidTagDataException();\n")
+            cpp_read_hek_file.write("            }\n")
+            if not unread:
+                cpp_read_hek_file.write("            callback(h.{}.tag_fourcc, h_{}_char, h_{}_length);\n".format(name, name, name))
+            cpp_read_hek_file.write("            data_size -= h_{}_length + 1;\n".format(name))
+            cpp_read_hek_file.write("            data_read += h_{}_length + 1;\n".format(name))
+            cpp_read_hek_file.write("            data += h_{}_length + 1;\n".format(name))
+            cpp_read_hek_file.write("        }\n")
+        elif struct["type"] == "TagReflexive":
+            cpp_read_hek_file.write("        std::size_t h_{}_count = h.{}.count;\n".format(name, name))
+            cpp_read_hek_file.write("        if(h_{}_count > 0) {{\n".format(name))
+            cpp_read_hek_file.write("            const auto *array = reinterpret_cast<const HEK::{}<HEK::BigEndian> *>(data);\n".format(struct["struct"]))
+            cpp_read_hek_file.write("            std::size_t total_size = sizeof(*array) * h_{}_count;\n".format(name))
+            cpp_read_hek_file.write("            if(total_size > data_size) {\n")
+            cpp_read_hek_file.write("                eprintf_error(\"Failed to read reflexive {}::{}: %zu bytes needed > %zu bytes available\", total_size, data_size);\n".format(struct_name, name))
+            cpp_read_hek_file.write("                throw OutOfBoundsException();\n")
+            cpp_read_hek_file.write("            }\n")
+            cpp_read_hek_file.write("            data_size -= total_size;\n")
+            cpp_read_hek_file.write("            data_read += total_size;\n")
+            cpp_read_hek_file.write("            data += total_size;\n")
+
+            # If the elements have nothing after them, the whole array can be skipped at once
+            if struct_has_tail_data(struct["struct"], all_structs):
+                cpp_read_hek_file.write("            for(std::size_t ref = 0; ref < h_{}_count; ref++) {{\n".format(name))
+                cpp_read_hek_file.write("                std::size_t ref_data_read = 0;\n")
+                cpp_read_hek_file.write("                {}::scan_hek_tag_dependencies(data, data_size, ref_data_read, callback, reinterpret_cast<const std::byte *>(array + ref));\n".format(struct["struct"]))
+                cpp_read_hek_file.write("                data += ref_data_read;\n")
+                cpp_read_hek_file.write("                data_read += ref_data_read;\n")
+                cpp_read_hek_file.write("                data_size -= ref_data_read;\n")
+                cpp_read_hek_file.write("            }\n")
+            cpp_read_hek_file.write("        }\n")
+        elif struct["type"] == "TagDataOffset":
+            cpp_read_hek_file.write("        std::size_t h_{}_size = h.{}.size;\n".format(name, name))
+            cpp_read_hek_file.write("        if(h_{}_size > data_size) {{\n".format(name))
+            cpp_read_hek_file.write("            eprintf_error(\"Failed to read tag data block {}::{}: %zu bytes needed > %zu bytes available\", h_{}_size, data_size);\n".format(struct_name, name, name))
+            cpp_read_hek_file.write("            throw OutOfBoundsException();\n")
+            cpp_read_hek_file.write("        }\n")
+            cpp_read_hek_file.write("        data_size -= h_{}_size;\n".format(name))
+            cpp_read_hek_file.write("        data_read += h_{}_size;\n".format(name))
+            cpp_read_hek_file.write("        data += h_{}_size;\n".format(name))
+    cpp_read_hek_file.write("    }\n")
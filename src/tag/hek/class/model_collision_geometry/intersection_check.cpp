@@ -3,247 +3,243 @@
 #include "intersection_check.hpp"
 
 namespace Invader::HEK {
-    static inline bool point_in_front_of_plane(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count, std::uint32_t plane_index) {
-        if(plane_index >= plane_count) {
-            eprintf_error("Invalid plane index %u / %u in BSP.\n", plane_index, plane_count);
-            throw OutOfBoundsException();
+    CompiledCollisionBSP::CompiledCollisionBSP(const BSPData &bsp) {
+        // Check every index once here so nothing needs to be checked while walking the tree
+        auto check_bsp3d_child = [&bsp](FlaggedInt<std::uint32_t> child) {
+            if(child.is_null()) {
+                return;
+            }
+            else if(child.flag_value()) {
+                if(child.int_value() >= bsp.leaf_count) {
+                    eprintf_error("invalid leaf index #%u / %u\n", child.int_value(), bsp.leaf_count);
+                    throw OutOfBoundsException();
+                }
+            }
+            else if(child.int_value() >= bsp.bsp3d_node_count) {
+                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", child.int_value(), bsp.bsp3d_node_count);
+                throw OutOfBoundsException();
+            }
+        };
+
+        auto check_bsp2d_child = [&bsp](FlaggedInt<std::uint32_t> child) {
+            if(child.is_null()) {
+                return;
+            }
+            else if(child.flag_value()) {
+                if(child.int_value() >= bsp.surface_count) {
+                    eprintf_error("Invalid surface %u / %u in BSP.\n", child.int_value(), bsp.surface_count);
+                    throw OutOfBoundsException();
+                }
+            }
+            else if(child.int_value() >= bsp.bsp2d_node_count) {
+                eprintf_error("Invalid BSP2D node %u / %u in BSP.\n", child.int_value(), bsp.bsp2d_node_count);
+                throw OutOfBoundsException();
+            }
+        };
+
+        this->planes.reserve(bsp.plane_count);
+        for(std::uint32_t p = 0; p < bsp.plane_count; p++) {
+            this->planes.emplace_back(bsp.planes[p].plane);
         }
-        return point.distance_from_plane(planes[plane_index].plane) >= 0;
-    }
 
-    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count) {
-        // Start with an initial index of 0
-        FlaggedInt<std::uint32_t> node_index = {0};
+        this->bsp3d_nodes.reserve(bsp.bsp3d_node_count);
+        for(std::uint32_t n = 0; n < bsp.bsp3d_node_count; n++) {
+            auto &node = bsp.bsp3d_nodes[n];
+            std::uint32_t plane = node.plane.read();
+            if(plane >= bsp.plane_count) {
+                eprintf_error("Invalid plane index %u / %u in BSP.\n", plane, bsp.plane_count);
+                throw OutOfBoundsException();
+            }
+            auto back_child = node.back_child.read();
+            auto front_child = node.front_child.read();
+            check_bsp3d_child(back_child);
+            check_bsp3d_child(front_child);
+            this->bsp3d_nodes.emplace_back(BSP3DNode { plane, back_child.value, front_child.value });
+        }
 
-        // Loop until we have a leaf or nothing
-        while(!node_index.flag_value() && !node_index.is_null()) {
-            // Make sure it's a valid index
-            if(node_index >= bsp3d_node_count) {
-                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), bsp3d_node_count);
+        this->leaves.reserve(bsp.leaf_count);
+        for(std::uint32_t l = 0; l < bsp.leaf_count; l++) {
+            auto &leaf = bsp.leaves[l];
+            std::uint32_t leaf_bsp2d_reference_count = leaf.bsp2d_reference_count.read();
+            std::uint32_t leaf_bsp2d_reference_index = leaf.first_bsp2d_reference.read();
+            std::uint64_t bsp2d_end = static_cast<std::uint64_t>(leaf_bsp2d_reference_index) + leaf_bsp2d_reference_count;
+            if(leaf_bsp2d_reference_count != 0 && bsp2d_end > bsp.bsp2d_reference_count) {
+                eprintf_error("invalid bsp2d reference range #%u - %zu / %u\n", leaf_bsp2d_reference_count, static_cast<std::size_t>(bsp2d_end), bsp.bsp2d_reference_count);
                 throw OutOfBoundsException();
             }
+            this->leaves.emplace_back(Leaf { leaf_bsp2d_reference_index, leaf_bsp2d_reference_count });
+        }
 
-            // Get the node as well as front/back child info
-            auto &node = bsp3d_nodes[node_index];
-            node_index = point_in_front_of_plane(point, planes, plane_count, node.plane) ? node.front_child : node.back_child;
-        };
+        this->bsp2d_references.reserve(bsp.bsp2d_reference_count);
+        for(std::uint32_t r = 0; r < bsp.bsp2d_reference_count; r++) {
+            auto &reference = bsp.bsp2d_references[r];
+            auto plane = reference.plane.read();
+            if(plane.int_value() >= bsp.plane_count) {
+                eprintf_error("invalid plane range for BSP #%u / %u\n", plane.int_value(), bsp.plane_count);
+                throw OutOfBoundsException();
+            }
+            auto bsp2d_node = reference.bsp2d_node.read();
+            check_bsp2d_child(bsp2d_node);
+            this->bsp2d_references.emplace_back(BSP2DReference { plane.int_value(), bsp2d_node.value });
+        }
 
-        return node_index;
+        this->bsp2d_nodes.reserve(bsp.bsp2d_node_count);
+        for(std::uint32_t n = 0; n < bsp.bsp2d_node_count; n++) {
+            auto &node = bsp.bsp2d_nodes[n];
+            auto left_child = node.left_child.read();
+            auto right_child = node.right_child.read();
+            check_bsp2d_child(left_child);
+            check_bsp2d_child(right_child);
+            this->bsp2d_nodes.emplace_back(BSP2DNode { node.plane, left_child.value, right_child.value });
+        }
     }
 
-    bool IntersectionCheck::check_for_intersection(
-        const Point3D<LittleEndian> &point_a,
-        const Point3D<LittleEndian> &point_b,
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-        std::uint32_t bsp3d_node_count,
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-        std::uint32_t plane_count,
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-        std::uint32_t leaf_count,
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-        std::uint32_t bsp2d_node_count,
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-        std::uint32_t bsp2d_reference_count,
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-        std::uint32_t surface_count,
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-        std::uint32_t edge_count,
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-        std::uint32_t vertex_count,
-        Point3D<LittleEndian> &intersection_point,
-        std::uint32_t &surface_index,
-        std::uint32_t &leaf_index
-    ) {
-        IntersectionCheck check(point_a, point_b, bsp3d_nodes, bsp3d_node_count, planes, plane_count, leaves, leaf_count, bsp2d_nodes, bsp2d_node_count, bsp2d_references, bsp2d_reference_count, surfaces, surface_count, edges, edge_count, vertices, vertex_count);
-        return check.check_for_intersection_recursion(point_a, point_b, surface_index, leaf_index, intersection_point, {0});
+    void CompiledCollisionBSP::check_root() const {
+        // Everything starts at node 0, so there has to be one
+        if(this->bsp3d_nodes.empty()) {
+            eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", 0U, 0U);
+            throw OutOfBoundsException();
+        }
     }
 
-    bool IntersectionCheck::check_for_intersection_bsp2d_node (
-        FlaggedInt<std::uint32_t> node_index,
-        const Point2D<LittleEndian> &point,
-        std::uint32_t &surface_index
-    ) {
-        // If we fall out, fail
-        if(node_index.is_null()) {
+    std::optional<std::uint32_t> CompiledCollisionBSP::leaf_for_point(const Point3D<NativeEndian> &point) const {
+        this->check_root();
+
+        // Loop until we have a leaf or nothing
+        std::uint32_t node_index = 0;
+        while(!(node_index & FLAG_BIT)) {
+            auto &node = this->bsp3d_nodes[node_index];
+            node_index = point.distance_from_plane(this->planes[node.plane]) >= 0 ? node.front_child : node.back_child;
+        }
+
+        if(node_index == NULL_CHILD) {
+            return std::nullopt;
+        }
+        return node_index & ~FLAG_BIT;
+    }
+
+    bool CompiledCollisionBSP::check_for_intersection(const Point3D<NativeEndian> &point_a, const Point3D<NativeEndian> &point_b, Point3D<NativeEndian> &intersection_point, std::uint32_t &surface_index, std::uint32_t &leaf_index) const {
+        // Check if they're equal. If so, there's no intersection
+        if(point_a == point_b) {
             return false;
         }
 
-        // Until it's a surface, search
-        while(!node_index.flag_value() && !node_index.is_null()) {
-            if(node_index.int_value() >= this->bsp2d_node_count) {
-                eprintf_error("Invalid BSP2D node %u / %u in BSP.\n", node_index.int_value(), this->bsp2d_node_count);
-                throw OutOfBoundsException();
-            }
+        this->check_root();
+        return this->check_for_intersection_recursion(point_a, point_b, point_a, point_b, surface_index, leaf_index, intersection_point, 0);
+    }
 
-            auto &bsp2d_node = this->bsp2d_nodes[node_index.int_value()];
-            if(point.distance_from_plane(bsp2d_node.plane) > 0.0F) {
-                node_index = bsp2d_node.right_child.read();
-            }
-            else {
-                node_index = bsp2d_node.left_child.read();
-            }
+    bool CompiledCollisionBSP::check_for_intersection_bsp2d_node(std::uint32_t node_index, const Point2D<NativeEndian> &point, std::uint32_t &surface_index) const noexcept {
+        // Until it's a surface, search
+        while(!(node_index & FLAG_BIT)) {
+            auto &bsp2d_node = this->bsp2d_nodes[node_index];
+            node_index = point.distance_from_plane(bsp2d_node.plane) > 0.0F ? bsp2d_node.right_child : bsp2d_node.left_child;
         }
 
         // If we fell out, return false
-        if(node_index.is_null()) {
+        if(node_index == NULL_CHILD) {
             return false;
         }
 
-        if(node_index.int_value() >= this->surface_count) {
-            eprintf_error("Invalid surface %u / %u in BSP.\n", node_index.int_value(), this->surface_count);
-            throw OutOfBoundsException();
-        }
-
-        //auto &surface = this->surfaces[node_index.int_value()];
-        surface_index = node_index.int_value();
+        surface_index = node_index & ~FLAG_BIT;
         return true;
     }
 
-    bool IntersectionCheck::check_for_intersection_recursion (
-        const Point3D<LittleEndian> &point_a,
-        const Point3D<LittleEndian> &point_b,
+    bool CompiledCollisionBSP::check_for_intersection_recursion(
+        const Point3D<NativeEndian> &original_point_a,
+        const Point3D<NativeEndian> &original_point_b,
+        const Point3D<NativeEndian> &point_a,
+        const Point3D<NativeEndian> &point_b,
         std::uint32_t &surface_index,
         std::uint32_t &leaf_index,
-        Point3D<LittleEndian> &intersection_point,
-        FlaggedInt<std::uint32_t> node_index)
-    {
+        Point3D<NativeEndian> &intersection_point,
+        std::uint32_t node_index
+    ) const noexcept {
         // Check if they're equal. If so, there's no intersection
         if(point_a == point_b) {
             return false;
         }
 
-        while(!node_index.flag_value() && !node_index.is_null()) {
-            // Make sure it's a valid index
-            if(node_index >= bsp3d_node_count) {
-                eprintf_error("Invalid BSP3D node %u / %u in BSP.\n", node_index.int_value(), this->bsp3d_node_count);
-                throw OutOfBoundsException();
-            }
-
-            // Get the node as well as front/back child info for each point
-            auto &node = bsp3d_nodes[node_index];
-            bool a_in_front_of_plane = point_in_front_of_plane(point_a, this->planes, plane_count, node.plane);
-            bool b_in_front_of_plane = point_in_front_of_plane(point_b, this->planes, plane_count, node.plane);
-
-            FlaggedInt<std::uint32_t> node_index_a = a_in_front_of_plane ? node.front_child : node.back_child;
-            FlaggedInt<std::uint32_t> node_index_b = b_in_front_of_plane ? node.front_child : node.back_child;
+        // Walk down while both points are on the same side; only recurse where the line crosses a plane
+        while(!(node_index & FLAG_BIT)) {
+            auto &node = this->bsp3d_nodes[node_index];
+            auto &plane = this->planes[node.plane];
+            std::uint32_t node_index_a = point_a.distance_from_plane(plane) >= 0 ? node.front_child : node.back_child;
+            std::uint32_t node_index_b = point_b.distance_from_plane(plane) >= 0 ? node.front_child : node.back_child;
 
             // If they're the same, set node_index to one of them and keep going
             if(node_index_a == node_index_b) {
                 node_index = node_index_a;
+                continue;
             }
-            else {
-                // Calculate a point that's almost on the plane
-                auto &plane = planes[node.plane.read()].plane;
-                Point3D<LittleEndian> intersection_front;
-                bool p = intersect_plane_with_points(plane, point_a, point_b, &intersection_front);
-                if(!p) {
-                    return false;
-                }
 
-                Point3D<LittleEndian> point_a_intersection;
-                Point3D<LittleEndian> point_b_intersection;
-
-                std::uint32_t leaf_a_intersection, leaf_b_intersection, surface_a_intersection, surface_b_intersection;
-
-                // Can we get anything closer?
-                bool point_a_intersected = check_for_intersection_recursion(
-                    point_a,
-                    intersection_front,
-                    surface_a_intersection,
-                    leaf_a_intersection,
-                    point_a_intersection,
-                    node_index_a
-                );
-
-                bool point_b_intersected = check_for_intersection_recursion(
-                    intersection_front,
-                    point_b,
-                    surface_b_intersection,
-                    leaf_b_intersection,
-                    point_b_intersection,
-                    node_index_b
-                );
-
-                // If neither intersected, we don't have an intersection.
-                if(!point_a_intersected && !point_b_intersected) {
-                    return false;
-                }
+            // Calculate a point that's almost on the plane
+            Point3D<NativeEndian> intersection_front;
+            if(!intersect_plane_with_points(plane, point_a, point_b, &intersection_front)) {
+                return false;
+            }
 
-                // If both intersected, invalidate the furthest one
-                if(point_a_intersected && point_b_intersected) {
-                    float a_distance_squared = point_a_intersection.distance_from_point_squared(point_a);
-                    float b_distance_squared = point_b_intersection.distance_from_point_squared(point_a);
-
-                    if(a_distance_squared > b_distance_squared) {
-                        point_a_intersected = false;
-                    }
-                    else {
-                        point_b_intersected = false;
-                    }
-                }
+            Point3D<NativeEndian> point_a_intersection;
+            Point3D<NativeEndian> point_b_intersection;
+
+            std::uint32_t leaf_a_intersection, leaf_b_intersection, surface_a_intersection, surface_b_intersection;
+
+            // Can we get anything closer?
+            bool point_a_intersected = this->check_for_intersection_recursion(original_point_a, original_point_b, point_a, intersection_front, surface_a_intersection, leaf_a_intersection, point_a_intersection, node_index_a);
+            bool point_b_intersected = this->check_for_intersection_recursion(original_point_a, original_point_b, intersection_front, point_b, surface_b_intersection, leaf_b_intersection, point_b_intersection, node_index_b);
+
+            // If neither intersected, we don't have an intersection.
+            if(!point_a_intersected && !point_b_intersected) {
+                return false;
+            }
 
-                // Now that we have one, return it
-                if(point_a_intersected) {
-                    intersection_point = point_a_intersection;
-                    leaf_index = leaf_a_intersection;
-                    surface_index = surface_a_intersection;
+            // If both intersected, invalidate the furthest one
+            if(point_a_intersected && point_b_intersected) {
+                float a_distance_squared = point_a_intersection.distance_from_point_squared(point_a);
+                float b_distance_squared = point_b_intersection.distance_from_point_squared(point_a);
+
+                if(a_distance_squared > b_distance_squared) {
+                    point_a_intersected = false;
                 }
                 else {
-                    intersection_point = point_b_intersection;
-                    leaf_index = leaf_b_intersection;
-                    surface_index = surface_b_intersection;
+                    point_b_intersected = false;
                 }
+            }
 
-                return true;
+            // Now that we have one, return it
+            if(point_a_intersected) {
+                intersection_point = point_a_intersection;
+                leaf_index = leaf_a_intersection;
+                surface_index = surface_a_intersection;
+            }
+            else {
+                intersection_point = point_b_intersection;
+                leaf_index = leaf_b_intersection;
+                surface_index = surface_b_intersection;
             }
-        };
 
-        // Fell out of the BSP; null
-        if(node_index.is_null()) {
-            return false;
+            return true;
         }
 
-        // Make sure the leaf is valid
-        std::uint32_t leaf_index_t = node_index.int_value();
-        if(leaf_index_t >= leaf_count) {
-            eprintf_error("invalid leaf index #%u / %u\n", leaf_index_t, leaf_count);
-            throw OutOfBoundsException();
+        // Fell out of the BSP; null
+        if(node_index == NULL_CHILD) {
+            return false;
         }
 
         // Get the leaf
+        std::uint32_t leaf_index_t = node_index & ~FLAG_BIT;
         auto &leaf = this->leaves[leaf_index_t];
 
-        // Check if we have nil BSP2D references
-        std::uint32_t leaf_bsp2d_reference_count = leaf.bsp2d_reference_count.read();
-        std::uint32_t leaf_bsp2d_reference_index = leaf.first_bsp2d_reference.read();
-        if(leaf_bsp2d_reference_count == 0) {
-            return false;
-        }
-
-        // Make sure the BSP2D references are valid
-        std::uint64_t bsp2d_end = static_cast<std::uint64_t>(leaf_bsp2d_reference_index + leaf_bsp2d_reference_count);
-        if(bsp2d_end > this->bsp2d_reference_count) {
-            eprintf_error("invalid bsp2d reference range #%u - %zu / %u\n", leaf_bsp2d_reference_count, static_cast<std::size_t>(leaf_bsp2d_reference_index + leaf_bsp2d_reference_count), this->bsp2d_reference_count);
-            throw OutOfBoundsException();
-        }
-
         // Go through each BSP2D reference
         bool ever_intersected = false;
         float closest_intersection_distance = 0.0F;
-        for(std::uint32_t b = leaf_bsp2d_reference_index; b < bsp2d_end; b++) {
+        std::uint32_t bsp2d_end = leaf.first_bsp2d_reference + leaf.bsp2d_reference_count;
+        for(std::uint32_t b = leaf.first_bsp2d_reference; b < bsp2d_end; b++) {
             auto &reference = this->bsp2d_references[b];
-            auto node_index = reference.bsp2d_node.read();
-
-            // Make sure the plane is valid
-            auto plane = reference.plane.read();
-            if(plane >= this->plane_count) {
-                eprintf_error("invalid plane range for BSP #%u / %u\n", plane.int_value(), this->plane_count);
-                throw OutOfBoundsException();
-            }
+            auto &plane = this->planes[reference.plane];
 
             // Make sure point a is in front and point b is behind
-            Point3D<LittleEndian> intersection;
-            if(!intersect_plane_with_points(this->planes[plane].plane, this->original_point_a, this->original_point_b, &intersection)) {
+            Point3D<NativeEndian> intersection;
+            if(!intersect_plane_with_points(plane, original_point_a, original_point_b, &intersection)) {
                 continue;
             }
 
@@ -254,10 +250,9 @@ namespace Invader::HEK {
             }
 
             // Okay, now let's see if we can get this going
-            auto plane_ref = this->planes[plane].plane;
-            float x = std::fabs(plane_ref.vector.i);
-            float y = std::fabs(plane_ref.vector.j);
-            float z = std::fabs(plane_ref.vector.k);
+            float x = std::fabs(plane.vector.i);
+            float y = std::fabs(plane.vector.j);
+            float z = std::fabs(plane.vector.k);
             int axis = 0;
             int sign = 0;
 
@@ -297,11 +292,11 @@ namespace Invader::HEK {
                 }
             };
 
-            Point2D<LittleEndian> point;
+            Point2D<NativeEndian> point;
             point.x = (&intersection.x)[PLANE_INDICES[sign][axis][0]];
             point.y = (&intersection.x)[PLANE_INDICES[sign][axis][1]];
 
-            if(check_for_intersection_bsp2d_node(node_index, point, surface_index)) {
+            if(check_for_intersection_bsp2d_node(reference.bsp2d_node, point, surface_index)) {
                 ever_intersected = true;
                 intersection_point = intersection;
                 leaf_index = leaf_index_t;
@@ -311,43 +306,4 @@ namespace Invader::HEK {
 
         return ever_intersected;
     }
-
-    IntersectionCheck::IntersectionCheck(
-        const Point3D<LittleEndian> &original_point_a,
-        const Point3D<LittleEndian> &original_point_b,
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-        std::uint32_t bsp3d_node_count,
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-        std::uint32_t plane_count,
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-        std::uint32_t leaf_count,
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-        std::uint32_t bsp2d_node_count,
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-        std::uint32_t bsp2d_reference_count,
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-        std::uint32_t surface_count,
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-        std::uint32_t edge_count,
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-        std::uint32_t vertex_count
-    ) :
-    original_point_a(original_point_a),
-    original_point_b(original_point_b),
-    bsp3d_nodes(bsp3d_nodes),
-    bsp3d_node_count(bsp3d_node_count),
-    planes(planes),
-    plane_count(plane_count),
-    leaves(leaves),
-    leaf_count(leaf_count),
-    bsp2d_nodes(bsp2d_nodes),
-    bsp2d_node_count(bsp2d_node_count),
-    bsp2d_references(bsp2d_references),
-    bsp2d_reference_count(bsp2d_reference_count),
-    surfaces(surfaces),
-    surface_count(surface_count),
-    edges(edges),
-    edge_count(edge_count),
-    vertices(vertices),
-    vertex_count(vertex_count) {}
 }
@@ -3,93 +3,89 @@
 #ifndef INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY__INTERSECTION_CHECK_HPP
 #define INVADER__TAG__HEK__CLASS__MODEL_COLLISION_GEOMETRY__INTERSECTION_CHECK_HPP
 
+#include <optional>
+#include <vector>
 #include <invader/tag/hek/class/model_collision_geometry.hpp>
 
 namespace Invader::HEK {
-    class IntersectionCheck {
+    /**
+     * Collision BSP that was validated once and copied into packed native-endian arrays, so walking it does not need
+     * to byteswap or bounds check anything
+     */
+    class CompiledCollisionBSP {
     public:
-        static bool check_for_intersection(
-            const Point3D<LittleEndian> &point_a,
-            const Point3D<LittleEndian> &point_b,
-            const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-            std::uint32_t bsp3d_node_count,
-            const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-            std::uint32_t plane_count,
-            const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-            std::uint32_t leaf_count,
-            const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-            std::uint32_t bsp2d_node_count,
-            const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-            std::uint32_t bsp2d_reference_count,
-            const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-            std::uint32_t surface_count,
-            const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-            std::uint32_t edge_count,
-            const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-            std::uint32_t vertex_count,
-            Point3D<LittleEndian> &intersection_point,
-            std::uint32_t &surface_index,
-            std::uint32_t &leaf_index
-        );
+        /**
+         * Validate and copy the BSP
+         * @param bsp BSP to copy
+         * @throws    OutOfBoundsException if any index in the BSP is out of bounds
+         */
+        CompiledCollisionBSP(const BSPData &bsp);
+
+        /**
+         * Find the leaf that a point lays in
+         * @param point point to check
+         * @return      leaf index, or std::nullopt if the point is outside of the BSP
+         */
+        std::optional<std::uint32_t> leaf_for_point(const Point3D<NativeEndian> &point) const;
+
+        /**
+         * Find the closest intersection to point_a between point_a and point_b
+         * @param point_a            one point in the line to check
+         * @param point_b            the other point in the line to check
+         * @param intersection_point set to the point where an intersection was found
+         * @param surface_index      set to the surface index where the intersection was found
+         * @param leaf_index         set to the leaf index where the intersection was found
+         * @return                   true if an intersection was found
+         */
+        bool check_for_intersection(const Point3D<NativeEndian> &point_a, const Point3D<NativeEndian> &point_b, Point3D<NativeEndian> &intersection_point, std::uint32_t &surface_index, std::uint32_t &leaf_index) const;
 
     private:
-        const Point3D<LittleEndian> &original_point_a;
-        const Point3D<LittleEndian> &original_point_b;
-        const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes;
-        std::uint32_t bsp3d_node_count;
-        const ModelCollisionGeometryBSPPlane<LittleEndian> *planes;
-        std::uint32_t plane_count;
-        const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves;
-        std::uint32_t leaf_count;
-        const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes;
-        std::uint32_t bsp2d_node_count;
-        const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references;
-        std::uint32_t bsp2d_reference_count;
-        const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces;
-        std::uint32_t surface_count;
-        const ModelCollisionGeometryBSPEdge<LittleEndian> *edges;
-        std::uint32_t edge_count;
-        const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices;
-        std::uint32_t vertex_count;
+        static constexpr std::uint32_t FLAG_BIT = FlaggedInt<std::uint32_t>::FLAG_BIT;
+        static constexpr std::uint32_t NULL_CHILD = FlaggedInt<std::uint32_t>::FLAG_BIT | FlaggedInt<std::uint32_t>::MAX_VALUE;
+
+        struct BSP3DNode {
+            std::uint32_t plane;
+            std::uint32_t back_child;
+            std::uint32_t front_child;
+        };
+
+        struct Leaf {
+            std::uint32_t first_bsp2d_reference;
+            std::uint32_t bsp2d_reference_count;
+        };
 
-        bool check_for_intersection_bsp2d_node (
-            FlaggedInt<std::uint32_t> node_index,
-            const Point2D<LittleEndian> &point,
-            std::uint32_t &surface_index
-        );
+        struct BSP2DReference {
+            std::uint32_t plane;
+            std::uint32_t bsp2d_node;
+        };
 
-        bool check_for_intersection_recursion (
-            const Point3D<LittleEndian> &point_a,
-            const Point3D<LittleEndian> &point_b,
+        struct BSP2DNode {
+            Plane2D<NativeEndian> plane;
+            std::uint32_t left_child;
+            std::uint32_t right_child;
+        };
+
+        std::vector<BSP3DNode> bsp3d_nodes;
+        std::vector<Plane3D<NativeEndian>> planes;
+        std::vector<Leaf> leaves;
+        std::vector<BSP2DReference> bsp2d_references;
+        std::vector<BSP2DNode> bsp2d_nodes;
+
+        void check_root() const;
+
+        bool check_for_intersection_bsp2d_node(std::uint32_t node_index, const Point2D<NativeEndian> &point, std::uint32_t &surface_index) const noexcept;
+
+        bool check_for_intersection_recursion(
+            const Point3D<NativeEndian> &original_point_a,
+            const Point3D<NativeEndian> &original_point_b,
+            const Point3D<NativeEndian> &point_a,
+            const Point3D<NativeEndian> &point_b,
             std::uint32_t &surface_index,
             std::uint32_t &leaf_index,
-            Point3D<LittleEndian> &intersection_point,
-            FlaggedInt<std::uint32_t> node_index
-        );
-
-        IntersectionCheck(
-            const Point3D<LittleEndian> &original_point_a,
-            const Point3D<LittleEndian> &original_point_b,
-            const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes,
-            std::uint32_t bsp3d_node_count,
-            const ModelCollisionGeometryBSPPlane<LittleEndian> *planes,
-            std::uint32_t plane_count,
-            const ModelCollisionGeometryBSPLeaf<LittleEndian> *leaves,
-            std::uint32_t leaf_count,
-            const ModelCollisionGeometryBSP2DNode<LittleEndian> *bsp2d_nodes,
-            std::uint32_t bsp2d_node_count,
-            const ModelCollisionGeometryBSP2DReference<LittleEndian> *bsp2d_references,
-            std::uint32_t bsp2d_reference_count,
-            const ModelCollisionGeometryBSPSurface<LittleEndian> *surfaces,
-            std::uint32_t surface_count,
-            const ModelCollisionGeometryBSPEdge<LittleEndian> *edges,
-            std::uint32_t edge_count,
-            const ModelCollisionGeometryBSPVertex<LittleEndian> *vertices,
-            std::uint32_t vertex_count
-        );
+            Point3D<NativeEndian> &intersection_point,
+            std::uint32_t node_index
+        ) const noexcept;
     };
-    
-    FlaggedInt<std::uint32_t> leaf_for_point_of_bsp_tree(const Point3D<LittleEndian> &point, const ModelCollisionGeometryBSP3DNode<LittleEndian> *bsp3d_nodes, std::uint32_t bsp3d_node_count, const ModelCollisionGeometryBSPPlane<LittleEndian> *planes, std::uint32_t plane_count);
 }
 
 #endif
@@ -1,27 +1,26 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <numeric>
 #include <invader/tag/hek/class/model_collision_geometry.hpp>
+#include <invader/thread_pool.hpp>
 #include "intersection_check.hpp"
 
 namespace Invader::HEK {
+    void BSPData::compile() const {
+        if(!this->compiled) {
+            this->compiled = std::make_shared<const CompiledCollisionBSP>(*this);
+        }
+    }
+
     bool BSPData::check_for_intersection(const Point3D<LittleEndian> &point_a, const Point3D<LittleEndian> &point_b, Point3D<LittleEndian> *intersection_point, std::uint32_t *surface_index, std::uint32_t *leaf_index) const {
+        this->compile();
+
         // Set our variables up
-        Point3D<LittleEndian> new_intersection_point;
+        Point3D<NativeEndian> new_intersection_point;
         std::uint32_t new_surface_index, new_leaf_index;
         
-        if(IntersectionCheck::check_for_intersection(
-            point_a,
-            point_b,
-            this->bsp3d_nodes, this->bsp3d_node_count,
-            this->planes, this->plane_count,
-            this->leaves, this->leaf_count,
-            this->bsp2d_nodes, this->bsp2d_node_count,
-            this->bsp2d_references, this->bsp2d_reference_count,
-            this->surfaces, this->surface_count,
-            this->edges, this->edge_count, 
-            this->vertices, this->vertex_count,
-            new_intersection_point, new_surface_index, new_leaf_index
-        )) {
+        if(this->compiled->check_for_intersection(point_a, point_b, new_intersection_point, new_surface_index, new_leaf_index)) {
             if(intersection_point) *intersection_point = new_intersection_point;
             if(surface_index) *surface_index = new_surface_index;
             if(leaf_index) *leaf_index = new_leaf_index;
@@ -105,18 +104,92 @@ namespace Invader::HEK {
     }
     
     bool BSPData::check_if_point_inside_bsp(const Point3D<LittleEndian> &point, std::uint32_t *leaf_index) const {
-        auto result = HEK::leaf_for_point_of_bsp_tree(point, this->bsp3d_nodes, this->bsp3d_node_count, this->planes, this->plane_count);
+        this->compile();
+        auto result = this->compiled->leaf_for_point(point);
         
         // If null, then we don't have anything
-        if(result.is_null()) {
+        if(!result.has_value()) {
             return false;
         }
         
         // Otherwise, yay!
         if(leaf_index) {
-            *leaf_index = result.int_value();
+            *leaf_index = *result;
         }
         
         return true;
     }
+
+    // Interleave the bits of three 10-bit values so points close together get close codes
+    static std::uint32_t morton_code(std::uint32_t x, std::uint32_t y, std::uint32_t z) noexcept {
+        auto spread = [](std::uint32_t v) {
+            v = (v | (v << 16)) & 0x030000FF;
+            v = (v | (v << 8)) & 0x0300F00F;
+            v = (v | (v << 4)) & 0x030C30C3;
+            v = (v | (v << 2)) & 0x09249249;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+    }
+
+    std::vector<BSPData::PointQueryResult> BSPData::query_points(const Point3D<LittleEndian> *points, std::size_t point_count, std::optional<float> range, std::size_t thread_count) const {
+        std::vector<PointQueryResult> results(point_count);
+        if(point_count == 0) {
+            return results;
+        }
+
+        // Sort the points along a Z-order curve inside of their bounding box
+        float min[3] = { points[0].x, points[0].y, points[0].z };
+        float max[3] = { min[0], min[1], min[2] };
+        for(std::size_t i = 1; i < point_count; i++) {
+            float p[3] = { points[i].x, points[i].y, points[i].z };
+            for(std::size_t a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], p[a]);
+                max[a] = std::max(max[a], p[a]);
+            }
+        }
+
+        std::vector<std::uint32_t> codes(point_count);
+        for(std::size_t i = 0; i < point_count; i++) {
+            float p[3] = { points[i].x, points[i].y, points[i].z };
+            std::uint32_t q[3];
+            for(std::size_t a = 0; a < 3; a++) {
+                float extent = max[a] - min[a];
+                q[a] = extent > 0.0F ? static_cast<std::uint32_t>((p[a] - min[a]) / extent * 1023.0F) : 0;
+            }
+            codes[i] = morton_code(q[0], q[1], q[2]);
+        }
+
+        std::vector<std::size_t> order(point_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&codes](std::size_t a, std::size_t b) { return codes[a] < codes[b]; });
+
+        // Compile the BSP now, since it can't be done safely once the threads are running
+        this->compile();
+
+        auto query_point = [this, &points, &range, &results](std::size_t i) {
+            auto &result = results[i];
+            if(range.has_value()) {
+                result.found = this->check_for_intersection(points[i], *range, nullptr, &result.surface_index, &result.leaf_index);
+            }
+            else {
+                result.found = this->check_if_point_inside_bsp(points[i], &result.leaf_index);
+            }
+            if(result.found && this->render_leaves && result.leaf_index < this->render_leaf_count) {
+                result.cluster_index = this->render_leaves[result.leaf_index].cluster;
+            }
+        };
+
+        // Hand out runs of neighboring points so each thread stays in the same part of the tree
+        static constexpr const std::size_t POINTS_PER_RUN = 64;
+        std::size_t run_count = (point_count + POINTS_PER_RUN - 1) / POINTS_PER_RUN;
+        ThreadPool::shared().parallel_for(run_count, [&query_point, &order, &point_count](std::size_t run) {
+            std::size_t end = std::min((run + 1) * POINTS_PER_RUN, point_count);
+            for(std::size_t o = run * POINTS_PER_RUN; o < end; o++) {
+                query_point(order[o]);
+            }
+        }, thread_count);
+
+        return results;
+    }
 }
@@ -34,9 +34,7 @@ namespace Invader::Parser {
         this->flags |= HEK::BitmapDataFlagsFlag::BITMAP_DATA_FLAGS_FLAG_MAKE_IT_ACTUALLY_WORK;
 
         // Add itself as a dependency. I don't know why but apparently we need to remind ourselves that we're still ourselves.
-        auto &d = s.dependencies.emplace_back();
-        d.tag_index = tag_index;
-        d.offset = bitmap_data_offset;
+        auto &d = s.add_dependency(bitmap_data_offset, tag_index);
         d.tag_id_only = true;
     }
 
@@ -309,6 +307,7 @@ namespace Invader::Parser {
                 }
 
                 // First, add our raw data entry
+                MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_RAW_DATA);
                 std::size_t raw_data_index = workload.raw_data.size();
                 auto &raw_data = workload.raw_data.emplace_back();
                 workload.tags[tag_index].asset_data.emplace_back(raw_data_index);
@@ -353,8 +352,9 @@ namespace Invader::Parser {
 
                         // Insert it
                         if(needs_swizzled) {
-                            auto swizzled = Invader::Swizzle::swizzle(input, bits_per_pixel, mipmap_width, mipmap_height, mipmap_depth, false);
-                            raw_data.insert(raw_data.end(), swizzled.begin(), swizzled.end());
+                            auto offset = raw_data.size();
+                            raw_data.resize(offset + mipmap_size);
+                            Invader::Swizzle::swizzle(input, raw_data.data() + offset, bits_per_pixel, mipmap_width, mipmap_height, mipmap_depth, false);
                         }
                         else {
                             raw_data.insert(raw_data.end(), input, input + mipmap_size);
@@ -397,9 +397,15 @@ namespace Invader::Parser {
                 data.pixel_data_size = static_cast<std::uint32_t>(raw_data.size());
             }
             else {
-                // Add it all
+                // Add it all (unless we're only checking, in which case it'd never be used)
+                MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_RAW_DATA);
                 std::size_t raw_data_index = workload.raw_data.size();
-                workload.raw_data.emplace_back(pixel_data + start, pixel_data + end);
+                if(workload.get_build_parameters()->check_only) {
+                    workload.raw_data.emplace_back();
+                }
+                else {
+                    workload.raw_data.emplace_back(pixel_data + start, pixel_data + end);
+                }
                 workload.tags[tag_index].asset_data.emplace_back(raw_data_index);
                 data.pixel_data_size = static_cast<std::uint32_t>(size);
             }
@@ -3,6 +3,7 @@
 #include <invader/build/build_workload.hpp>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/tag/parser/compile/model.hpp>
+#include <invader/hash/fnv1a.hpp>
 
 namespace Invader::Parser {
     template<typename M> static void postprocess_hek_data_model(M &what) {
@@ -145,10 +146,8 @@ namespace Invader::Parser {
 
         if(marker_count > 0) {
             // Make the pointer
-            auto &marker_ptr = workload.structs[struct_index].pointers.emplace_back();
-            marker_ptr.offset = static_cast<std::uint32_t>(reinterpret_cast<std::byte *>(&gbxmodel_data.markers.pointer) - reinterpret_cast<std::byte *>(&gbxmodel_data));
             std::size_t marker_struct_index = workload.structs.size();
-            marker_ptr.struct_index = marker_struct_index;
+            workload.structs[struct_index].add_pointer(static_cast<std::uint32_t>(reinterpret_cast<std::byte *>(&gbxmodel_data.markers.pointer) - reinterpret_cast<std::byte *>(&gbxmodel_data)), marker_struct_index);
 
             // Make the struct
             auto &markers_struct = workload.structs.emplace_back();
@@ -170,9 +169,7 @@ namespace Invader::Parser {
                 marker_l.instances.count = instance_count;
 
                 // Make the pointer
-                auto &marker_ptr = workload.structs[marker_struct_index].pointers.emplace_back();
-                marker_ptr.offset = static_cast<std::uint32_t>(reinterpret_cast<std::byte *>(&marker_l.instances.pointer) - reinterpret_cast<std::byte *>(markers_struct_arr));
-                marker_ptr.struct_index = workload.structs.size();
+                workload.structs[marker_struct_index].add_pointer(static_cast<std::uint32_t>(reinterpret_cast<std::byte *>(&marker_l.instances.pointer) - reinterpret_cast<std::byte *>(markers_struct_arr)), workload.structs.size());
 
                 // Make the instances
                 auto &instance_struct = workload.structs.emplace_back();
@@ -210,20 +207,38 @@ namespace Invader::Parser {
                 return true;
             }
 
-            part.uncompressed_vertices.reserve(part.compressed_vertices.size());
-            for(auto &v : part.compressed_vertices) {
-                auto before_data = v.generate_hek_tag_data();
-                auto after_data = HEK::decompress_model_vertex(*reinterpret_cast<ModelVertexCompressed::struct_big *>(before_data.data()));
+            // Copy straight out of the parsed vertices so the whole part can be decompressed in one go
+            std::size_t vertex_count = part.compressed_vertices.size();
+            std::vector<ModelVertexCompressed::struct_little> before_data(vertex_count);
+            for(std::size_t v = 0; v < vertex_count; v++) {
+                auto &vertex = part.compressed_vertices[v];
+                auto &before_data_write = before_data[v];
+                before_data_write.position = vertex.position;
+                before_data_write.normal = vertex.normal;
+                before_data_write.binormal = vertex.binormal;
+                before_data_write.tangent = vertex.tangent;
+                before_data_write.texture_coordinate_u = vertex.texture_coordinate_u;
+                before_data_write.texture_coordinate_v = vertex.texture_coordinate_v;
+                before_data_write.node0_index = vertex.node0_index;
+                before_data_write.node1_index = vertex.node1_index;
+                before_data_write.node0_weight = vertex.node0_weight;
+            }
+
+            std::vector<ModelVertexUncompressed::struct_little> after_data(vertex_count);
+            HEK::decompress_model_vertex_array(before_data.data(), after_data.data(), vertex_count);
+
+            part.uncompressed_vertices.reserve(vertex_count);
+            for(auto &after_data_read : after_data) {
                 auto &after_data_write = part.uncompressed_vertices.emplace_back();
-                after_data_write.binormal = after_data.binormal;
-                after_data_write.normal = after_data.normal;
-                after_data_write.position = after_data.position;
-                after_data_write.tangent = after_data.tangent;
-                after_data_write.node0_index = after_data.node0_index;
-                after_data_write.node0_weight = after_data.node0_weight;
-                after_data_write.node1_index = after_data.node1_index;
-                after_data_write.node1_weight = after_data.node1_weight;
-                after_data_write.texture_coords = after_data.texture_coords;
+                after_data_write.binormal = after_data_read.binormal;
+                after_data_write.normal = after_data_read.normal;
+                after_data_write.position = after_data_read.position;
+                after_data_write.tangent = after_data_read.tangent;
+                after_data_write.node0_index = after_data_read.node0_index;
+                after_data_write.node0_weight = after_data_read.node0_weight;
+                after_data_write.node1_index = after_data_read.node1_index;
+                after_data_write.node1_weight = after_data_read.node1_weight;
+                after_data_write.texture_coords = after_data_read.texture_coords;
             }
         }
         else if(part.compressed_vertices.size() == 0 && part.uncompressed_vertices.size() > 0) {
@@ -260,26 +275,39 @@ namespace Invader::Parser {
                 return true;
             }
 
-            part.compressed_vertices.reserve(part.uncompressed_vertices.size());
+            // Resolve local nodes before throwing them into the compressor
+            std::size_t vertex_count = part.uncompressed_vertices.size();
+            std::vector<ModelVertexUncompressed::struct_little> before_data(vertex_count);
+            for(std::size_t v = 0; v < vertex_count; v++) {
+                auto &vertex = part.uncompressed_vertices[v];
+                auto &before_data_write = before_data[v];
+                before_data_write.position = vertex.position;
+                before_data_write.normal = vertex.normal;
+                before_data_write.binormal = vertex.binormal;
+                before_data_write.tangent = vertex.tangent;
+                before_data_write.texture_coords = vertex.texture_coords;
+                before_data_write.node0_index = resolve_local_node(vertex.node0_index);
+                before_data_write.node1_index = resolve_local_node(vertex.node1_index);
+                before_data_write.node0_weight = vertex.node0_weight;
+                before_data_write.node1_weight = vertex.node1_weight;
+            }
 
-            for(auto &v : part.uncompressed_vertices) {
-                // Resolve local nodes before throwing them into the compressor
-                auto before_data_copy = *reinterpret_cast<ModelVertexUncompressed::struct_big *>(v.generate_hek_tag_data().data());
-                before_data_copy.node0_index = resolve_local_node(before_data_copy.node0_index);
-                before_data_copy.node1_index = resolve_local_node(before_data_copy.node1_index);
+            // Done
+            std::vector<ModelVertexCompressed::struct_little> after_data(vertex_count);
+            HEK::compress_model_vertex_array(before_data.data(), after_data.data(), vertex_count);
 
-                // Done
-                auto after_data = HEK::compress_model_vertex(before_data_copy);
+            part.compressed_vertices.reserve(vertex_count);
+            for(auto &after_data_read : after_data) {
                 auto &after_data_write = part.compressed_vertices.emplace_back();
-                after_data_write.binormal = after_data.binormal;
-                after_data_write.normal = after_data.normal;
-                after_data_write.position = after_data.position;
-                after_data_write.tangent = after_data.tangent;
-                after_data_write.node0_index = after_data.node0_index;
-                after_data_write.node0_weight = after_data.node0_weight;
-                after_data_write.node1_index = after_data.node1_index;
-                after_data_write.texture_coordinate_u = after_data.texture_coordinate_u;
-                after_data_write.texture_coordinate_v = after_data.texture_coordinate_v;
+                after_data_write.binormal = after_data_read.binormal;
+                after_data_write.normal = after_data_read.normal;
+                after_data_write.position = after_data_read.position;
+                after_data_write.tangent = after_data_read.tangent;
+                after_data_write.node0_index = after_data_read.node0_index;
+                after_data_write.node0_weight = after_data_read.node0_weight;
+                after_data_write.node1_index = after_data_read.node1_index;
+                after_data_write.texture_coordinate_u = after_data_read.texture_coordinate_u;
+                after_data_write.texture_coordinate_v = after_data_read.texture_coordinate_v;
             }
         }
         else if(part.compressed_vertices.size() != part.uncompressed_vertices.size()) {
@@ -335,6 +363,7 @@ namespace Invader::Parser {
             if(tag.get_map().get_cache_version() == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
                 const auto vertex_pointer = reinterpret_cast<const HEK::CacheFileModelPartVerticesXbox *>(tag.data(what.vertex_offset, sizeof(HEK::CacheFileModelPartVerticesXbox)))->vertices;
                 const auto *vertices = reinterpret_cast<const ModelVertexCompressed::struct_little *>(tag.data(vertex_pointer, sizeof(ModelVertexCompressed::struct_little) * vertex_count));
+                what.compressed_vertices.reserve(what.compressed_vertices.size() + vertex_count);
                 for(std::size_t v = 0; v < vertex_count; v++) {
                     std::size_t data_read;
                     ModelVertexCompressed::struct_big vertex_compressed = vertices[v];
@@ -347,6 +376,7 @@ namespace Invader::Parser {
                 auto model_data_offset = map.get_model_data_offset();
                 auto model_index_offset = map.get_model_index_offset() + model_data_offset;
                 const auto *vertices = reinterpret_cast<const ModelVertexUncompressed::struct_little *>(map.get_data_at_offset(model_data_offset + part.vertex_offset.read(), sizeof(ModelVertexUncompressed::struct_little) * vertex_count));
+                what.uncompressed_vertices.reserve(what.uncompressed_vertices.size() + vertex_count);
                 for(std::size_t v = 0; v < vertex_count; v++) {
                     std::size_t data_read;
                     ModelVertexUncompressed::struct_big vertex_uncompressed = vertices[v];
@@ -770,7 +800,38 @@ namespace Invader::Parser {
         pre_compile_model(*this, workload, tag_index);
     }
 
-    template<class P, class PartVertex, class CacheVertex> static void pre_compile_model_geometry_part(P &what, BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t struct_offset, const std::vector<PartVertex> &part_vertices, std::vector<CacheVertex> &workload_vertices) {
+    // Find the first position in the model data that matches the given values, indexing anything added since last time.
+    // Each position is indexed by a hash of the window_size values starting there, so only matching positions are compared.
+    template <std::size_t window_size, typename T> static std::optional<std::size_t> find_model_data(const std::vector<T> &data, BuildWorkload::BuildWorkloadModelDataIndex &index, const T *values, std::size_t count) {
+        auto hash_window = [](const T *window) {
+            return FNV1AHash::hash_bytes(window, sizeof(T) * window_size);
+        };
+
+        std::size_t data_size = data.size();
+        for(; index.indexed_count + window_size <= data_size; index.indexed_count++) {
+            index.positions[hash_window(data.data() + index.indexed_count)].emplace_back(index.indexed_count);
+        }
+
+        if(count < window_size) {
+            return std::nullopt;
+        }
+
+        auto candidates = index.positions.find(hash_window(values));
+        if(candidates == index.positions.end()) {
+            return std::nullopt;
+        }
+
+        // Positions were added in order, so this finds the first match
+        for(auto position : candidates->second) {
+            if(position + count <= data_size && std::memcmp(data.data() + position, values, sizeof(T) * count) == 0) {
+                return position;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    template<class P, class PartVertex, class CacheVertex> static void pre_compile_model_geometry_part(P &what, BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t struct_offset, const std::vector<PartVertex> &part_vertices, std::vector<CacheVertex> &workload_vertices, BuildWorkload::BuildWorkloadModelDataIndex &workload_vertices_index) {
         auto uncompressed_vertices = sizeof(CacheVertex) == sizeof(Parser::ModelVertexUncompressed::struct_little);
 
         std::vector<HEK::Index> triangle_indices;
@@ -816,35 +877,14 @@ namespace Invader::Parser {
         }
 
         // See if we can find a copy of this
-        std::size_t this_indices_count = triangle_indices_size;
-        std::size_t indices_count = workload.model_indices.size();
-        bool found = false;
-
-        if(indices_count >= this_indices_count) {
-            auto &first = triangle_indices[0];
-            auto &last = triangle_indices[triangle_indices_size - 1];
-            std::size_t check_size = this_indices_count - 1;
-
-            for(std::size_t i = 0; i <= indices_count - this_indices_count; i++) {
-                auto *model_data = workload.model_indices.data() + i;
-
-                // Check the last index, first, since it's most likely to be different
-                if(model_data[triangle_indices_size - 1] != last) {
-                    continue;
-                }
-
-                // If triangles match, set the triangle offset to this instead
-                if(std::memcmp(&first, model_data, sizeof(workload.model_indices[0]) * check_size) == 0) {
-                    found = true;
-                    what.triangle_offset = i * sizeof(workload.model_indices[0]);
-                    break;
-                }
-            }
+        std::vector<HEK::LittleEndian<HEK::Index>> triangle_indices_little(triangle_indices.begin(), triangle_indices.end());
+        auto existing_indices = find_model_data<3>(workload.model_indices, workload.model_indices_index, triangle_indices_little.data(), triangle_indices_little.size());
+        if(existing_indices.has_value()) {
+            what.triangle_offset = *existing_indices * sizeof(workload.model_indices[0]);
         }
-
-        if(!found) {
-            what.triangle_offset = indices_count * sizeof(workload.model_indices[0]);
-            workload.model_indices.insert(workload.model_indices.end(), triangle_indices.begin(), triangle_indices.end());
+        else {
+            what.triangle_offset = workload.model_indices.size() * sizeof(workload.model_indices[0]);
+            workload.model_indices.insert(workload.model_indices.end(), triangle_indices_little.begin(), triangle_indices_little.end());
         }
         what.triangle_offset_2 = what.triangle_offset;
 
@@ -886,23 +926,12 @@ namespace Invader::Parser {
         workload.model_parts.emplace_back(BuildWorkload::BuildWorkloadModelPart { struct_index, struct_offset });
 
         // Let's see if we can also dedupe this
-        std::size_t this_vertices_count = vertices_of_fun.size();
-        std::size_t vertices_count = workload_vertices.size();
-        found = false;
-
-        if(vertices_count >= this_vertices_count) {
-            for(std::size_t i = 0; i <= vertices_count - this_vertices_count; i++) {
-                // If vertices match, set the vertices offset to this instead
-                if(std::memcmp(workload_vertices.data() + i, vertices_of_fun.data(), sizeof(CacheVertex) * this_vertices_count) == 0) {
-                    found = true;
-                    what.vertex_offset = i * sizeof(workload_vertices[0]);
-                    break;
-                }
-            }
+        auto existing_vertices = find_model_data<1>(workload_vertices, workload_vertices_index, vertices_of_fun.data(), vertices_of_fun.size());
+        if(existing_vertices.has_value()) {
+            what.vertex_offset = *existing_vertices * sizeof(CacheVertex);
         }
-
-        if(!found) {
-            what.vertex_offset = vertices_count * sizeof(CacheVertex);
+        else {
+            what.vertex_offset = workload_vertices.size() * sizeof(CacheVertex);
             workload_vertices.insert(workload_vertices.end(), vertices_of_fun.begin(), vertices_of_fun.end());
         }
 
@@ -912,15 +941,15 @@ namespace Invader::Parser {
     }
 
     void GBXModelGeometryPart::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t offset) {
-        pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->uncompressed_vertices, workload.uncompressed_model_vertices);
+        pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->uncompressed_vertices, workload.uncompressed_model_vertices, workload.uncompressed_model_vertices_index);
     }
 
     void ModelGeometryPart::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t struct_index, std::size_t offset) {
         if(workload.get_build_parameters()->details.build_cache_file_engine == HEK::CacheFileEngine::CACHE_FILE_XBOX) {
-            pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->compressed_vertices, workload.compressed_model_vertices);
+            pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->compressed_vertices, workload.compressed_model_vertices, workload.compressed_model_vertices_index);
         }
         else {
-            pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->uncompressed_vertices, workload.uncompressed_model_vertices);
+            pre_compile_model_geometry_part(*this, workload, tag_index, struct_index, offset, this->uncompressed_vertices, workload.uncompressed_model_vertices, workload.uncompressed_model_vertices_index);
         }
     }
 
@@ -1,15 +1,21 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <invader/tag/parser/parser.hpp>
+#include <invader/tag/parser/compile/model_animations.hpp>
 #include <invader/build/build_workload.hpp>
+#include <invader/thread_pool.hpp>
+#include <invader/printf.hpp>
 
 namespace Invader::Parser {
-    bool read_bit_from_bitfield(std::size_t offset, std::uint32_t *fields) noexcept {
+    bool read_bit_from_bitfield(std::size_t offset, const std::uint32_t *fields) noexcept {
         std::uint32_t bitfield = static_cast<std::uint32_t>(1) << (offset % 32);
         return (fields[offset / 32] & bitfield) != 0;
     }
 
-    std::size_t expected_uncompressed_frame_size_for_animation(ModelAnimationsAnimation &animation) noexcept {
+    std::size_t expected_uncompressed_frame_size_for_animation(const ModelAnimationsAnimation &animation) noexcept {
         std::size_t total_size = 0;
         for(std::size_t i = 0; i < animation.node_count; i++) {
             total_size += read_bit_from_bitfield(i, animation.node_rotation_flag_data) * sizeof(ModelAnimationsRotation::struct_big);
@@ -19,6 +25,310 @@ namespace Invader::Parser {
         return total_size;
     }
 
+    void swap_animation_frame_data_endianness(const ModelAnimationsAnimation &animation, const std::byte *from, std::byte *to, std::size_t frame_count, bool default_data) {
+        // Every frame has the same layout, so work out where the 16-bit and 32-bit values are once rather than checking
+        // the node flags again for every frame
+        struct WordRun {
+            std::size_t word_size;
+            std::size_t word_count;
+        };
+        std::vector<WordRun> runs;
+        auto add_run = [&runs](std::size_t word_size, std::size_t word_count) {
+            if(!runs.empty() && runs.back().word_size == word_size) {
+                runs.back().word_count += word_count;
+            }
+            else {
+                runs.emplace_back(WordRun { word_size, word_count });
+            }
+        };
+
+        // Default data holds the nodes that are not animated, and frame data holds the nodes that are
+        for(std::size_t node = 0; node < animation.node_count; node++) {
+            if(read_bit_from_bitfield(node, animation.node_rotation_flag_data) != default_data) {
+                add_run(sizeof(std::int16_t), sizeof(ModelAnimationsRotation::struct_big) / sizeof(std::int16_t));
+            }
+            if(read_bit_from_bitfield(node, animation.node_transform_flag_data) != default_data) {
+                add_run(sizeof(float), sizeof(ModelAnimationsTransform::struct_big) / sizeof(float));
+            }
+            if(read_bit_from_bitfield(node, animation.node_scale_flag_data) != default_data) {
+                add_run(sizeof(float), sizeof(ModelAnimationscale::struct_big) / sizeof(float));
+            }
+        }
+
+        // If every value is the same size, the frames can be swapped all at once
+        if(runs.size() == 1) {
+            runs[0].word_count *= frame_count;
+            frame_count = 1;
+        }
+
+        for(std::size_t frame = 0; frame < frame_count; frame++) {
+            for(auto &run : runs) {
+                if(run.word_size == sizeof(std::int16_t)) {
+                    HEK::swap_bytes_array<sizeof(std::int16_t)>(to, from, run.word_count);
+                }
+                else {
+                    HEK::swap_bytes_array<sizeof(float)>(to, from, run.word_count);
+                }
+                from += run.word_size * run.word_count;
+                to += run.word_size * run.word_count;
+            }
+        }
+    }
+
+    // Check that the sizes of everything in the animation add up so it can be converted safely
+    static void check_animation_data(BuildWorkload &workload, std::size_t tag_index, const ModelAnimationsAnimation &animation, std::size_t animation_index) {
+        auto frame_count = static_cast<std::size_t>(animation.frame_count);
+        auto node_count = static_cast<std::size_t>(animation.node_count);
+
+        // The node flags only have room for 64 nodes
+        if(node_count > sizeof(animation.node_rotation_flag_data) * 8) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has too many nodes (%zu > %zu)", animation_index, node_count, sizeof(animation.node_rotation_flag_data) * 8);
+            throw InvalidTagDataException();
+        }
+
+        // Get the required frame size for sanity checking
+        std::size_t required_frame_info_size;
+        switch(animation.frame_info_type) {
+            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_NONE:
+                required_frame_info_size = 0;
+                break;
+            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY:
+                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDy::struct_little);
+                break;
+            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DYAW:
+                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDyDyaw::struct_big);
+                break;
+            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DZ_DYAW:
+                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDyDzDyaw::struct_big);
+                break;
+            default:
+                std::terminate();
+        }
+
+        // If things don't add up, stop
+        std::size_t expected_frame_info_size = required_frame_info_size * frame_count;
+        std::size_t frame_info_size = animation.frame_info.size();
+        if(expected_frame_info_size != frame_info_size) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid frame info size (%zu > %zu)", animation_index, frame_info_size, expected_frame_info_size);
+            throw InvalidTagDataException();
+        }
+
+        // Make sure frame and default size is correct
+        std::size_t total_frame_size = expected_uncompressed_frame_size_for_animation(animation);
+        std::size_t max_frame_size = node_count * (sizeof(ModelAnimationsRotation::struct_big) + sizeof(ModelAnimationscale::struct_big) + sizeof(ModelAnimationsTransform::struct_big));
+        if(animation.frame_size != total_frame_size) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid frame size (%zu > %zu)", animation_index, static_cast<std::size_t>(animation.frame_size), total_frame_size);
+            throw InvalidTagDataException();
+        }
+
+        std::size_t default_data_size = animation.default_data.size();
+        std::size_t expected_default_data_size = max_frame_size - total_frame_size;
+        if(default_data_size != 0 && (default_data_size != expected_default_data_size)) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid default data size (%zu > %zu)", animation_index, default_data_size, expected_default_data_size);
+            throw InvalidTagDataException();
+        }
+
+        std::size_t frame_data_size = animation.frame_data.size();
+        if(animation.flags & HEK::ModelAnimationsAnimationFlagsFlag::MODEL_ANIMATIONS_ANIMATION_FLAGS_FLAG_COMPRESSED_DATA) {
+            std::size_t compressed_data_offset = animation.offset_to_compressed_data;
+            if(compressed_data_offset > frame_data_size) {
+                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid compressed data offset (%zu > %zu)", animation_index, compressed_data_offset, frame_data_size);
+                throw InvalidTagDataException();
+            }
+        }
+        else if(frame_data_size > 0 && frame_data_size < total_frame_size * frame_count) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid frame data size (%zu < %zu)", animation_index, frame_data_size, total_frame_size * frame_count);
+            throw InvalidTagDataException();
+        }
+    }
+
+    // Size of the animation's data and how many of its nodes' rotations, transforms, and scales were made static
+    struct AnimationTrimResult {
+        std::size_t size_before = 0;
+        std::size_t size_after = 0;
+        std::size_t channels_trimmed = 0;
+    };
+
+    // Move each node rotation, transform, and scale that never moves further than the tolerance from its first frame into the default data so it
+    // isn't stored for every frame. This has to run before the data is converted, and only base animations are trimmed since overlay and replacement
+    // animations treat nodes that aren't animated differently.
+    static AnimationTrimResult trim_static_animation_nodes(ModelAnimationsAnimation &animation, float tolerance) {
+        AnimationTrimResult result;
+        auto frame_count = static_cast<std::size_t>(animation.frame_count);
+        auto node_count = static_cast<std::size_t>(animation.node_count);
+        std::size_t frame_size = animation.frame_size;
+        result.size_before = result.size_after = animation.frame_data.size() + animation.default_data.size();
+
+        if((animation.flags & HEK::ModelAnimationsAnimationFlagsFlag::MODEL_ANIMATIONS_ANIMATION_FLAGS_FLAG_COMPRESSED_DATA) || animation.type != HEK::AnimationType::ANIMATION_TYPE_BASE || frame_count == 0 || animation.frame_data.size() < frame_size * frame_count) {
+            return result;
+        }
+
+        // If there are nodes that aren't animated but there's no default data for them, we can't make default data without knowing what they are
+        std::size_t max_frame_size = node_count * (sizeof(ModelAnimationsRotation::struct_big) + sizeof(ModelAnimationsTransform::struct_big) + sizeof(ModelAnimationscale::struct_big));
+        if(animation.default_data.size() != max_frame_size - frame_size) {
+            return result;
+        }
+
+        // Channels are stored in this order for each node, in the frame data if animated or in the default data if not
+        struct Channel {
+            std::uint32_t *flags;
+            std::size_t size;
+        };
+        Channel channels[] = {
+            { animation.node_rotation_flag_data, sizeof(ModelAnimationsRotation::struct_big) },
+            { animation.node_transform_flag_data, sizeof(ModelAnimationsTransform::struct_big) },
+            { animation.node_scale_flag_data, sizeof(ModelAnimationscale::struct_big) }
+        };
+
+        auto *frame_data = animation.frame_data.data();
+        auto channel_is_static = [&](std::size_t channel, std::size_t offset) {
+            if(channel == 0) {
+                // Rotations are quaternions with each component from -32767 to 32767
+                auto rotation_tolerance = static_cast<std::int32_t>(std::min(tolerance, 2.0F) * INT16_MAX);
+                for(std::size_t f = 1; f < frame_count; f++) {
+                    for(std::size_t c = 0; c < 4; c++) {
+                        HEK::BigEndian<std::int16_t> first, value;
+                        std::memcpy(&first, frame_data + offset + c * sizeof(first), sizeof(first));
+                        std::memcpy(&value, frame_data + f * frame_size + offset + c * sizeof(value), sizeof(value));
+                        if(std::abs(static_cast<std::int32_t>(value.read()) - static_cast<std::int32_t>(first.read())) > rotation_tolerance) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            else {
+                for(std::size_t f = 1; f < frame_count; f++) {
+                    for(std::size_t c = 0; c < channels[channel].size / sizeof(float); c++) {
+                        HEK::BigEndian<float> first, value;
+                        std::memcpy(&first, frame_data + offset + c * sizeof(first), sizeof(first));
+                        std::memcpy(&value, frame_data + f * frame_size + offset + c * sizeof(value), sizeof(value));
+                        if(!(std::fabs(value.read() - first.read()) <= tolerance)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        };
+
+        // Find what's static
+        std::vector<bool> trim(node_count * 3, false);
+        std::size_t frame_offset = 0;
+        for(std::size_t node = 0; node < node_count; node++) {
+            for(std::size_t c = 0; c < 3; c++) {
+                if(read_bit_from_bitfield(node, channels[c].flags)) {
+                    if(channel_is_static(c, frame_offset)) {
+                        trim[node * 3 + c] = true;
+                        result.channels_trimmed++;
+                    }
+                    frame_offset += channels[c].size;
+                }
+            }
+        }
+        if(result.channels_trimmed == 0) {
+            return result;
+        }
+
+        // Move the first frame of each static channel into the default data
+        std::size_t new_frame_size = frame_size;
+        for(std::size_t node = 0; node < node_count; node++) {
+            for(std::size_t c = 0; c < 3; c++) {
+                if(trim[node * 3 + c]) {
+                    new_frame_size -= channels[c].size;
+                }
+            }
+        }
+
+        std::vector<std::byte> new_frame_data(new_frame_size * frame_count);
+        std::vector<std::byte> new_default_data;
+        new_default_data.reserve(max_frame_size - new_frame_size);
+        std::size_t old_frame_offset = 0, new_frame_offset = 0, default_offset = 0;
+        for(std::size_t node = 0; node < node_count; node++) {
+            for(std::size_t c = 0; c < 3; c++) {
+                auto size = channels[c].size;
+                if(!read_bit_from_bitfield(node, channels[c].flags)) {
+                    new_default_data.insert(new_default_data.end(), animation.default_data.begin() + default_offset, animation.default_data.begin() + default_offset + size);
+                    default_offset += size;
+                }
+                else if(trim[node * 3 + c]) {
+                    new_default_data.insert(new_default_data.end(), frame_data + old_frame_offset, frame_data + old_frame_offset + size);
+                    channels[c].flags[node / 32] &= ~(static_cast<std::uint32_t>(1) << (node % 32));
+                    old_frame_offset += size;
+                }
+                else {
+                    for(std::size_t f = 0; f < frame_count; f++) {
+                        std::copy(frame_data + f * frame_size + old_frame_offset, frame_data + f * frame_size + old_frame_offset + size, new_frame_data.data() + f * new_frame_size + new_frame_offset);
+                    }
+                    old_frame_offset += size;
+                    new_frame_offset += size;
+                }
+            }
+        }
+
+        animation.frame_size = static_cast<std::uint16_t>(new_frame_size);
+        animation.frame_data = std::move(new_frame_data);
+        animation.default_data = std::move(new_default_data);
+        result.size_after = animation.frame_data.size() + animation.default_data.size();
+        return result;
+    }
+
+    // Convert the animation's data to little endian; this only touches the animation, so it can run on any thread
+    static void convert_animation_data(ModelAnimationsAnimation &animation) {
+        auto frame_count = static_cast<std::size_t>(animation.frame_count);
+
+        // Update frame_info data, updating everything to little endian endian
+        if(animation.frame_info.size() > 0) {
+            auto *frame_info = animation.frame_info.data();
+            switch(animation.frame_info_type) {
+                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_NONE:
+                    break;
+                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY: {
+                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDy::struct_big *>(frame_info);
+                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDy::struct_little *>(frame_info);
+                    std::copy(big, big + frame_count, little);
+                    break;
+                }
+                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DYAW: {
+                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDyDyaw::struct_big *>(frame_info);
+                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDyDyaw::struct_little *>(frame_info);
+                    std::copy(big, big + frame_count, little);
+                    break;
+                }
+                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DZ_DYAW: {
+                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDyDzDyaw::struct_big *>(frame_info);
+                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDyDzDyaw::struct_little *>(frame_info);
+                    std::copy(big, big + frame_count, little);
+                    break;
+                }
+                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_ENUM_COUNT:
+                    std::terminate();
+            }
+        }
+
+        // Get whether or not it's compressed
+        bool compressed = animation.flags & HEK::ModelAnimationsAnimationFlagsFlag::MODEL_ANIMATIONS_ANIMATION_FLAGS_FLAG_COMPRESSED_DATA;
+        std::size_t compressed_data_offset = animation.offset_to_compressed_data;
+        animation.offset_to_compressed_data = 0;
+
+        // Let's do default_data. Basically just add what isn't in frame_data, and only for one frame
+        if(animation.default_data.size() != 0 && !compressed) {
+            swap_animation_frame_data_endianness(animation, animation.default_data.data(), animation.default_data.data(), 1, true);
+        }
+        else {
+            animation.default_data.clear();
+        }
+
+        // Now let's do frame_data. Anything past the last frame is zeroed out.
+        if(compressed) {
+            animation.frame_data.erase(animation.frame_data.begin(), animation.frame_data.begin() + compressed_data_offset);
+        }
+        else if(animation.frame_data.size() > 0) {
+            std::size_t total_frame_data_size = static_cast<std::size_t>(animation.frame_size) * frame_count;
+            swap_animation_frame_data_endianness(animation, animation.frame_data.data(), animation.frame_data.data(), frame_count, false);
+            std::fill(animation.frame_data.begin() + total_frame_data_size, animation.frame_data.end(), std::byte());
+        }
+    }
+
     void ModelAnimations::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t, std::size_t) {
         std::size_t animation_count = this->animations.size();
         std::size_t sound_count = this->sound_references.size();
@@ -120,172 +430,31 @@ namespace Invader::Parser {
                 }
             }
         }
-    }
-
-    void ModelAnimationsAnimation::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t, std::size_t offset) {
-        auto animation_index = offset / sizeof(*this);
-
-        // Get the required frame size for sanity checking
-        auto frame_type = this->frame_info_type;
-        auto frame_count = static_cast<std::size_t>(this->frame_count);
-
-        std::size_t required_frame_info_size;
-        switch(frame_type) {
-            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_NONE:
-                required_frame_info_size = 0;
-                break;
-            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY:
-                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDy::struct_little);
-                break;
-            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DYAW:
-                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDyDyaw::struct_big);
-                break;
-            case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DZ_DYAW:
-                required_frame_info_size = sizeof(ModelAnimationsFrameInfoDxDyDzDyaw::struct_big);
-                break;
-            default:
-                std::terminate();
-        }
-
-        // If things don't add up, stop
-        std::size_t expected_frame_info_size = required_frame_info_size * frame_count;
-        std::size_t frame_info_size = this->frame_info.size();
-        if(expected_frame_info_size != frame_info_size) {
-            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid frame info size (%zu > %zu)", animation_index, frame_info_size, expected_frame_info_size);
-            throw InvalidTagDataException();
-        }
-
-        // Do frame info stuff
-        if(frame_info_size > 0) {
-            const auto *frame_info_big = this->frame_info.data();
-            std::vector<std::byte> frame_info_little_v(frame_info_size);
-            std::byte *frame_info_little = frame_info_little_v.data();
 
-            // Update frame_info data, updating everything to little endian endian
-            switch(frame_type) {
-                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_NONE:
-                    break;
-                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY: {
-                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDy::struct_big *>(frame_info_big);
-                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDy::struct_little *>(frame_info_little);
-                    std::copy(big, big + frame_count, little);
-                    break;
-                }
-                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DYAW: {
-                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDyDyaw::struct_big *>(frame_info_big);
-                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDyDyaw::struct_little *>(frame_info_little);
-                    std::copy(big, big + frame_count, little);
-                    break;
-                }
-                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_DX_DY_DZ_DYAW: {
-                    const auto *big = reinterpret_cast<const ModelAnimationsFrameInfoDxDyDzDyaw::struct_big *>(frame_info_big);
-                    auto *little = reinterpret_cast<ModelAnimationsFrameInfoDxDyDzDyaw::struct_little *>(frame_info_little);
-                    std::copy(big, big + frame_count, little);
-                    break;
-                }
-                case HEK::AnimationFrameInfoType::ANIMATION_FRAME_INFO_TYPE_ENUM_COUNT:
-                    std::terminate();
-            }
-
-            this->frame_info = frame_info_little_v;
-        }
-
-        auto node_count = static_cast<std::size_t>(this->node_count);
-        std::size_t frame_data_size = this->frame_data.size();
-        std::size_t default_data_size = this->default_data.size();
-
-        // Make sure frame and default size is correct
-        std::size_t total_frame_size = expected_uncompressed_frame_size_for_animation(*this);
-        std::size_t max_frame_size = node_count * (sizeof(ModelAnimationsRotation::struct_big) + sizeof(ModelAnimationscale::struct_big) + sizeof(ModelAnimationsTransform::struct_big));
-        if(this->frame_size != total_frame_size) {
-            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid frame size (%zu > %zu)", animation_index, static_cast<std::size_t>(this->frame_size), total_frame_size);
-            throw InvalidTagDataException();
-        }
-
-        std::size_t expected_default_data_size = max_frame_size - total_frame_size;
-        if(default_data_size != 0 && (default_data_size != expected_default_data_size)) {
-            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid default data size (%zu > %zu)", animation_index, default_data_size, expected_default_data_size);
-            throw InvalidTagDataException();
-        }
-
-        // Get whether or not it's compressed
-        bool compressed = this->flags & HEK::ModelAnimationsAnimationFlagsFlag::MODEL_ANIMATIONS_ANIMATION_FLAGS_FLAG_COMPRESSED_DATA;
-        std::size_t compressed_data_offset = this->offset_to_compressed_data;
-        this->offset_to_compressed_data = 0;
-
-        // Let's do default_data. Basically just add what isn't in frame_data, and only for one frame
-        if(default_data_size != 0 && !compressed) {
-            const auto *default_data_big = this->default_data.data();
-            std::vector<std::byte> default_data(default_data_size);
-            auto *default_data_little = default_data.data();
-            for(std::size_t node = 0; node < node_count; node++) {
-                if(!read_bit_from_bitfield(node, this->node_rotation_flag_data)) {
-                    const auto &rotation_big = *reinterpret_cast<const ModelAnimationsRotation::struct_big *>(default_data_big);
-                    auto &rotation_little = *reinterpret_cast<ModelAnimationsRotation::struct_little *>(default_data_little);
-                    rotation_little = rotation_big;
-                    default_data_big += sizeof(rotation_big);
-                    default_data_little += sizeof(rotation_big);
-                }
-                if(!read_bit_from_bitfield(node, this->node_transform_flag_data)) {
-                    const auto &transform_big = *reinterpret_cast<const ModelAnimationsTransform::struct_big *>(default_data_big);
-                    auto &transform_little = *reinterpret_cast<ModelAnimationsTransform::struct_little *>(default_data_little);
-                    transform_little = transform_big;
-                    default_data_big += sizeof(transform_big);
-                    default_data_little += sizeof(transform_big);
-                }
-                if(!read_bit_from_bitfield(node, this->node_scale_flag_data)) {
-                    const auto &scale_big = *reinterpret_cast<const ModelAnimationscale::struct_big *>(default_data_big);
-                    auto &scale_little = *reinterpret_cast<ModelAnimationscale::struct_little *>(default_data_little);
-                    scale_little = scale_big;
-                    default_data_big += sizeof(scale_big);
-                    default_data_little += sizeof(scale_big);
-                }
-            }
-            this->default_data = default_data;
-        }
-        else {
-            this->default_data.clear();
+        // Check everything first so errors are reported from this thread
+        for(std::size_t i = 0; i < animation_count; i++) {
+            check_animation_data(workload, tag_index, this->animations[i], i);
         }
 
-        // Now let's do frame_data.
-        if(compressed) {
-            if(compressed_data_offset > frame_data_size) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Animation #%zu has an invalid compressed data offset (%zu > %zu)", animation_index, compressed_data_offset, frame_data_size);
-                throw InvalidTagDataException();
+        // Character tags can have hundreds of animations, so trim and convert them on multiple threads
+        auto *parameters = workload.get_build_parameters();
+        auto trim_tolerance = parameters->animation_trim_tolerance;
+        std::vector<AnimationTrimResult> trim_results(animation_count);
+        ThreadPool::shared().parallel_for(animation_count, [this, &trim_tolerance, &trim_results](std::size_t i) {
+            if(trim_tolerance.has_value()) {
+                trim_results[i] = trim_static_animation_nodes(this->animations[i], *trim_tolerance);
             }
-            this->frame_data = std::vector<std::byte>(this->frame_data.begin() + compressed_data_offset, this->frame_data.end());
-        }
-        else {
-            const auto *frame_data_big = this->frame_data.data();
-            if(frame_data_size > 0) {
-                std::vector<std::byte> frame_data(frame_data_size, std::byte());
-                auto *frame_data_little = frame_data.data();
-                for(std::size_t frame = 0; frame < frame_count; frame++) {
-                    for(std::size_t node = 0; node < node_count; node++) {
-                        if(read_bit_from_bitfield(node, this->node_rotation_flag_data)) {
-                            const auto &rotation_big = *reinterpret_cast<const ModelAnimationsRotation::struct_big *>(frame_data_big);
-                            auto &rotation_little = *reinterpret_cast<ModelAnimationsRotation::struct_little *>(frame_data_little);
-                            rotation_little = rotation_big;
-                            frame_data_big += sizeof(rotation_big);
-                            frame_data_little += sizeof(rotation_big);
-                        }
-                        if(read_bit_from_bitfield(node, this->node_transform_flag_data)) {
-                            const auto &transform_big = *reinterpret_cast<const ModelAnimationsTransform::struct_big *>(frame_data_big);
-                            auto &transform_little = *reinterpret_cast<ModelAnimationsTransform::struct_little *>(frame_data_little);
-                            transform_little = transform_big;
-                            frame_data_big += sizeof(transform_big);
-                            frame_data_little += sizeof(transform_big);
-                        }
-                        if(read_bit_from_bitfield(node, this->node_scale_flag_data)) {
-                            const auto &scale_big = *reinterpret_cast<const ModelAnimationscale::struct_big *>(frame_data_big);
-                            auto &scale_little = *reinterpret_cast<ModelAnimationscale::struct_little *>(frame_data_little);
-                            scale_little = scale_big;
-                            frame_data_big += sizeof(scale_big);
-                            frame_data_little += sizeof(scale_big);
-                        }
-                    }
+            convert_animation_data(this->animations[i]);
+        }, parameters->thread_count);
+
+        // Say how much was saved
+        if(trim_tolerance.has_value() && parameters->verbosity > BuildWorkload::BuildParameters::BuildVerbosity::BUILD_VERBOSITY_QUIET) {
+            auto &tag_path = workload.tags[tag_index].path;
+            for(std::size_t i = 0; i < animation_count; i++) {
+                auto &result = trim_results[i];
+                if(result.channels_trimmed > 0) {
+                    oprintf("Trimmed %zu static channel%s from %s.model_animations animation #%zu (%s): %zu -> %zu bytes\n", result.channels_trimmed, result.channels_trimmed == 1 ? "" : "s", tag_path.c_str(), i, this->animations[i].name.string, result.size_before, result.size_after);
                 }
-                this->frame_data = frame_data;
             }
         }
     }
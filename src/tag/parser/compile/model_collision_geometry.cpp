@@ -78,6 +78,29 @@ namespace Invader::Parser {
             }
         }
     }
+    // Find the first element that is invalid. Every element is checked first without stopping at the first invalid one, since
+    // valid tags (nearly all of them) don't have any, and a check without branches for each element is cheaper to run.
+    template<typename T, typename F> static const T *find_invalid(const std::vector<T> &elements, const F &is_invalid) {
+        unsigned int any_invalid = 0;
+        for(auto &e : elements) {
+            any_invalid |= is_invalid(e);
+        }
+        if(any_invalid == 0) {
+            return nullptr;
+        }
+        for(auto &e : elements) {
+            if(is_invalid(e)) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    // Check if a BSP child is out of bounds, using the flag to tell which array it points into
+    static bool child_is_invalid(const HEK::FlaggedInt<std::uint32_t> &child, std::size_t flagged_count, std::size_t unflagged_count) noexcept {
+        return !child.is_null() & (child.int_value() >= (child.flag_value() ? flagged_count : unflagged_count));
+    }
+
     void ModelCollisionGeometryBSP::pre_compile(BuildWorkload &workload, std::size_t tag_index, std::size_t, std::size_t) {
         std::size_t bsp3d_count = this->bsp3d_nodes.size();
         std::size_t bsp2d_count = this->bsp2d_nodes.size();
@@ -86,10 +109,13 @@ namespace Invader::Parser {
         std::size_t surface_count = this->surfaces.size();
         std::size_t edge_count = this->edges.size();
         std::size_t vertex_count = this->vertices.size();
+        std::size_t bsp2d_reference_count = this->bsp2d_references.size();
 
         // Make sure each BSP3D node is valid
-        for(std::size_t bsp3d_node_index = 0; bsp3d_node_index < bsp3d_count; bsp3d_node_index++) {
-            auto &bsp3d = this->bsp3d_nodes[bsp3d_node_index];
+        if(auto *bsp3d = find_invalid(this->bsp3d_nodes, [&leaf_count, &bsp3d_count, &plane_count](const ModelCollisionGeometryBSP3DNode &node) {
+            return child_is_invalid(node.front_child, leaf_count, bsp3d_count) | child_is_invalid(node.back_child, leaf_count, bsp3d_count) | (node.plane >= plane_count);
+        })) {
+            std::size_t bsp3d_node_index = bsp3d - this->bsp3d_nodes.data();
 
             // Make sure the front and back children are valid
             auto validate_child = [&workload, &tag_index, &bsp3d_count, &leaf_count, &bsp3d_node_index](auto &child) {
@@ -109,40 +135,38 @@ namespace Invader::Parser {
                     }
                 }
             };
-            validate_child(bsp3d.front_child);
-            validate_child(bsp3d.back_child);
+            validate_child(bsp3d->front_child);
+            validate_child(bsp3d->back_child);
 
-            // Make sure the plane is valid too
-            if(bsp3d.plane >= plane_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP3D node #%zu has an invalid plane index (%zu >= %zu)", bsp3d_node_index, static_cast<std::size_t>(bsp3d.plane), plane_count);
-                throw InvalidTagDataException();
-            }
+            // Otherwise it's the plane
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP3D node #%zu has an invalid plane index (%zu >= %zu)", bsp3d_node_index, static_cast<std::size_t>(bsp3d->plane), plane_count);
+            throw InvalidTagDataException();
         }
 
         // Make sure the leaves are valid
-        std::size_t bsp2d_reference_count = this->bsp2d_references.size();
-        for(auto &leaf : this->leaves) {
+        if(auto *leaf = find_invalid(this->leaves, [&bsp2d_reference_count](const ModelCollisionGeometryBSPLeaf &leaf) {
             std::size_t leaf_first_bsp2d_reference = leaf.first_bsp2d_reference;
             std::size_t leaf_bsp2d_reference_count = leaf.bsp2d_reference_count;
             std::size_t leaf_end_bsp2d_reference = leaf_bsp2d_reference_count + leaf_first_bsp2d_reference;
-
-            if(leaf_bsp2d_reference_count && (leaf_first_bsp2d_reference >= bsp2d_reference_count || leaf_bsp2d_reference_count > bsp2d_reference_count || leaf_end_bsp2d_reference > bsp2d_reference_count)) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP leaf #%zu has an invalid BSP2D reference range (%zu - %zu / %zu)", &leaf - this->leaves.data(), leaf_first_bsp2d_reference, leaf_end_bsp2d_reference, bsp2d_reference_count);
-                throw InvalidTagDataException();
-            }
+            return (leaf_bsp2d_reference_count != 0) & ((leaf_first_bsp2d_reference >= bsp2d_reference_count) | (leaf_bsp2d_reference_count > bsp2d_reference_count) | (leaf_end_bsp2d_reference > bsp2d_reference_count));
+        })) {
+            std::size_t leaf_first_bsp2d_reference = leaf->first_bsp2d_reference;
+            std::size_t leaf_end_bsp2d_reference = leaf->bsp2d_reference_count + leaf_first_bsp2d_reference;
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP leaf #%zu has an invalid BSP2D reference range (%zu - %zu / %zu)", leaf - this->leaves.data(), leaf_first_bsp2d_reference, leaf_end_bsp2d_reference, bsp2d_reference_count);
+            throw InvalidTagDataException();
         }
 
         // Make sure the BSP2D references are valid
-        for(auto &ref : this->bsp2d_references) {
-            if(ref.plane >= plane_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP2D reference #%zu has an invalid plane index (%zu >= %zu)", &ref - this->bsp2d_references.data(), static_cast<std::size_t>(ref.plane), plane_count);
-                throw InvalidTagDataException();
-            }
+        if(auto *ref = find_invalid(this->bsp2d_references, [&plane_count](const ModelCollisionGeometryBSP2DReference &ref) { return ref.plane >= plane_count; })) {
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "BSP2D reference #%zu has an invalid plane index (%zu >= %zu)", ref - this->bsp2d_references.data(), static_cast<std::size_t>(ref->plane), plane_count);
+            throw InvalidTagDataException();
         }
 
         // Make sure the BSP2D nodes are valid
-        for(std::size_t bsp2d_node_index = 0; bsp2d_node_index < bsp2d_count; bsp2d_node_index++) {
-            auto &bsp2d = this->bsp2d_nodes[bsp2d_node_index];
+        if(auto *bsp2d = find_invalid(this->bsp2d_nodes, [&surface_count, &bsp2d_count](const ModelCollisionGeometryBSP2DNode &node) {
+            return child_is_invalid(node.left_child, surface_count, bsp2d_count) | child_is_invalid(node.right_child, surface_count, bsp2d_count);
+        })) {
+            std::size_t bsp2d_node_index = bsp2d - this->bsp2d_nodes.data();
 
             // Make sure the left and right children are valid
             auto validate_child = [&workload, &tag_index, &bsp2d_count, &surface_count, &bsp2d_node_index](auto &child) {
@@ -162,32 +186,32 @@ namespace Invader::Parser {
                     }
                 }
             };
-            validate_child(bsp2d.left_child);
-            validate_child(bsp2d.right_child);
+            validate_child(bsp2d->left_child);
+            validate_child(bsp2d->right_child);
         }
 
         // Make sure the surfaces are valid
-        for(auto &surface : this->surfaces) {
-            if(surface.first_edge >= edge_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Surface #%zu has an invalid edge index (%zu >= %zu)", &surface - this->surfaces.data(), static_cast<std::size_t>(surface.first_edge), edge_count);
-                throw InvalidTagDataException();
-            }
-            if(surface.plane >= plane_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Surface #%zu has an invalid plane index (%zu >= %zu)", &surface - this->surfaces.data(), static_cast<std::size_t>(surface.plane), plane_count);
+        if(auto *surface = find_invalid(this->surfaces, [&edge_count, &plane_count](const ModelCollisionGeometryBSPSurface &surface) {
+            return (surface.first_edge >= edge_count) | (surface.plane >= plane_count);
+        })) {
+            if(surface->first_edge >= edge_count) {
+                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Surface #%zu has an invalid edge index (%zu >= %zu)", surface - this->surfaces.data(), static_cast<std::size_t>(surface->first_edge), edge_count);
                 throw InvalidTagDataException();
             }
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Surface #%zu has an invalid plane index (%zu >= %zu)", surface - this->surfaces.data(), static_cast<std::size_t>(surface->plane), plane_count);
+            throw InvalidTagDataException();
         }
 
         // Make sure the edges are valid
-        for(auto &edge : this->edges) {
-            if(edge.start_vertex >= vertex_count || edge.end_vertex >= vertex_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Edge #%zu has an invalid vertex index (%zu, %zu >= %zu)", &edge - this->edges.data(), static_cast<std::size_t>(edge.start_vertex), static_cast<std::size_t>(edge.end_vertex), vertex_count);
-                throw InvalidTagDataException();
-            }
-            if(edge.left_surface >= surface_count || edge.right_surface >= surface_count) {
-                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Edge #%zu has an invalid surface index (%zu, %zu >= %zu)", &edge - this->edges.data(), static_cast<std::size_t>(edge.left_surface), static_cast<std::size_t>(edge.right_surface), surface_count);
+        if(auto *edge = find_invalid(this->edges, [&vertex_count, &surface_count](const ModelCollisionGeometryBSPEdge &edge) {
+            return (edge.start_vertex >= vertex_count) | (edge.end_vertex >= vertex_count) | (edge.left_surface >= surface_count) | (edge.right_surface >= surface_count);
+        })) {
+            if(edge->start_vertex >= vertex_count || edge->end_vertex >= vertex_count) {
+                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Edge #%zu has an invalid vertex index (%zu, %zu >= %zu)", edge - this->edges.data(), static_cast<std::size_t>(edge->start_vertex), static_cast<std::size_t>(edge->end_vertex), vertex_count);
                 throw InvalidTagDataException();
             }
+            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_FATAL_ERROR, tag_index, "Edge #%zu has an invalid surface index (%zu, %zu >= %zu)", edge - this->edges.data(), static_cast<std::size_t>(edge->left_surface), static_cast<std::size_t>(edge->right_surface), surface_count);
+            throw InvalidTagDataException();
         }
     }
 }
@@ -302,11 +302,13 @@ namespace Invader::Parser {
         }
     }
 
-    void recursively_get_all_predicted_resources_from_struct(const BuildWorkload &workload, std::size_t struct_index, std::vector<std::size_t> &resources, bool ignore_shader_resources) {
-        if(workload.disable_recursion) {
-            return;
+    static void add_predicted_resource(std::vector<std::size_t> &resources, std::size_t tag_index) {
+        if(std::find(resources.begin(), resources.end(), tag_index) == resources.end()) {
+            resources.push_back(tag_index);
         }
+    }
 
+    static void find_predicted_resources_in_struct(BuildWorkload &workload, std::size_t struct_index, std::vector<std::size_t> &resources, bool ignore_shader_resources) {
         auto &s = workload.structs[struct_index];
         for(auto &d : s.dependencies) {
             std::size_t tag_index = d.tag_index;
@@ -315,7 +317,7 @@ namespace Invader::Parser {
                 case TagFourCC::TAG_FOURCC_BITMAP:
                 case TagFourCC::TAG_FOURCC_SOUND:
                     if(!ignore_shader_resources) {
-                        resources.push_back(tag_index);
+                        add_predicted_resource(resources, tag_index);
                     }
                     break;
                 case TagFourCC::TAG_FOURCC_SHADER_ENVIRONMENT:
@@ -343,28 +345,43 @@ namespace Invader::Parser {
         }
     }
 
+    void recursively_get_all_predicted_resources_from_struct(BuildWorkload &workload, std::size_t struct_index, std::vector<std::size_t> &resources, bool ignore_shader_resources) {
+        if(workload.disable_recursion) {
+            return;
+        }
+
+        // Only an object's own structs ignore shader resources, so there's nothing to share there
+        if(ignore_shader_resources) {
+            find_predicted_resources_in_struct(workload, struct_index, resources, true);
+            return;
+        }
+
+        // Shaders and models are shared by many objects (and BSPs), so only search them once
+        auto found = workload.predicted_resources.find(struct_index);
+        if(found == workload.predicted_resources.end()) {
+            // Mark it as searched before searching it so a shader that ends up referencing itself doesn't recurse forever
+            workload.predicted_resources.emplace(struct_index, std::vector<std::size_t>());
+
+            std::vector<std::size_t> struct_resources;
+            find_predicted_resources_in_struct(workload, struct_index, struct_resources, false);
+            found = workload.predicted_resources.insert_or_assign(struct_index, std::move(struct_resources)).first;
+        }
+
+        for(auto r : found->second) {
+            add_predicted_resource(resources, r);
+        }
+    }
+
     // Go through each tag this depends on that can have predicted resources. This is to preload assets when the object spawns to reduce hitching. Using maps in RAM makes this basically pointless, though.
     static void calculate_object_predicted_resources(BuildWorkload &workload, std::size_t struct_index) {
         std::vector<std::size_t> resources;
         recursively_get_all_predicted_resources_from_struct(workload, struct_index, resources, true);
         auto &s = workload.structs[struct_index];
 
-        for(std::size_t a = 0; a < resources.size(); a++) {
-            for(std::size_t b = a + 1; b < resources.size(); b++) {
-                if(resources[a] == resources[b]) {
-                    resources.erase(resources.begin() + b);
-                    b--;
-                }
-            }
-        }
-
         std::size_t resources_count = resources.size();
         if(resources_count > 0) {
-            auto &predicted_resource_pointer = s.pointers.emplace_back();
-            predicted_resource_pointer.struct_index = workload.structs.size();
-
             auto &object = *reinterpret_cast<Parser::Object::struct_little *>(s.data.data());
-            predicted_resource_pointer.offset = reinterpret_cast<const std::byte *>(&object.predicted_resources.pointer) - reinterpret_cast<const std::byte *>(&object);
+            s.add_pointer(reinterpret_cast<const std::byte *>(&object.predicted_resources.pointer) - reinterpret_cast<const std::byte *>(&object), workload.structs.size());
             object.predicted_resources.count = static_cast<std::uint32_t>(resources_count);
             std::vector<HEK::PredictedResource<HEK::LittleEndian>> predicted_resources;
 
@@ -377,10 +394,8 @@ namespace Invader::Parser {
                 resource.type = resource_tag.tag_fourcc == TagFourCC::TAG_FOURCC_BITMAP ? HEK::PredictedResourceType::PREDICTED_RESOURCE_TYPE_BITMAP : HEK::PredictedResourceType::PREDICTED_RESOURCE_TYPE_SOUND;
                 resource.tag = HEK::TagID { static_cast<std::uint32_t>(r) };
                 resource.resource_index = 0;
-                auto &resource_dep = prs.dependencies.emplace_back();
+                auto &resource_dep = prs.add_dependency(reinterpret_cast<const std::byte *>(&resource.tag) - reinterpret_cast<const std::byte *>(predicted_resources.data()), r);
                 resource_dep.tag_id_only = true;
-                resource_dep.tag_index = r;
-                resource_dep.offset = reinterpret_cast<const std::byte *>(&resource.tag) - reinterpret_cast<const std::byte *>(predicted_resources.data());
             }
             prs.data.insert(prs.data.begin(), reinterpret_cast<const std::byte *>(predicted_resources.data()), reinterpret_cast<const std::byte *>(predicted_resources.data() + resources_count));
         }
@@ -520,9 +535,7 @@ namespace Invader::Parser {
         }
 
         // Let's make that pathfinding sphere
-        auto &pathfinding_ptr = collision_struct.pointers.emplace_back();
-        pathfinding_ptr.struct_index = workload.structs.size();
-        pathfinding_ptr.offset = reinterpret_cast<std::byte *>(&collision_data.pathfinding_spheres.pointer) - collision_data_ptr;
+        collision_struct.add_pointer(reinterpret_cast<std::byte *>(&collision_data.pathfinding_spheres.pointer) - collision_data_ptr, workload.structs.size());
         collision_data.pathfinding_spheres.count = 1;
 
         auto &pathfinding_struct = workload.structs.emplace_back();
@@ -1,5 +1,9 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <exception>
+#include <optional>
+#include <string>
+#include <thread>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/file/file.hpp>
@@ -8,6 +12,49 @@
 
 namespace Invader::Parser {
     using BSPData = HEK::BSPData;
+
+    // Errors and notes from a pass that may run alongside other passes, reported once they're done so the output is
+    // in the same order no matter which pass finishes first
+    class BufferedReports {
+    public:
+        BufferedReports(const BuildWorkload &workload) : workload(workload) {}
+
+        bool is_reported(ErrorHandler::ErrorType type) const noexcept {
+            return this->workload.is_reported(type);
+        }
+
+        void report_error(ErrorHandler::ErrorType type, const char *error, std::optional<std::size_t> tag_index = std::nullopt) {
+            this->reports.emplace_back(Report { type, error, tag_index, false });
+        }
+
+        template <typename... Args> void note(const char *format, Args... args) {
+            char text[1024];
+            std::snprintf(text, sizeof(text), format, args...);
+            this->reports.emplace_back(Report { ErrorHandler::ErrorType::ERROR_TYPE_WARNING, text, std::nullopt, true });
+        }
+
+        void flush(BuildWorkload &workload) {
+            for(auto &r : this->reports) {
+                if(r.is_note) {
+                    eprintf_warn_lesser("%s", r.message.c_str());
+                }
+                else {
+                    workload.report_error(r.type, r.message.c_str(), r.tag_index);
+                }
+            }
+            this->reports.clear();
+        }
+
+    private:
+        struct Report {
+            ErrorHandler::ErrorType type;
+            std::string message;
+            std::optional<std::size_t> tag_index;
+            bool is_note;
+        };
+        const BuildWorkload &workload;
+        std::vector<Report> reports;
+    };
     
     void ScenarioNetgameEquipment::post_compile(BuildWorkload &workload, std::size_t, std::size_t struct_index, std::size_t struct_offset) {
         reinterpret_cast<struct_little *>(workload.structs[struct_index].data.data() + struct_offset)->unknown_ffffffff = 0xFFFFFFFF;
@@ -15,8 +62,8 @@ namespace Invader::Parser {
     
     // Functions for finding stuff
     static std::vector<BSPData> get_bsp_data(const Scenario &scenario, BuildWorkload &workload);
-    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
-    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
+    static void find_encounters(Scenario &scenario, BuildWorkload &workload, BufferedReports &reports, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
+    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, BufferedReports &reports, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings);
     static void fix_bsp_referenced_data(Scenario &scenario, BuildWorkload &workload, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data);
     static void find_conversations(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data);
 
@@ -36,7 +83,7 @@ namespace Invader::Parser {
         auto bsp_count = bsp_data.size();
 
         // Determine which BSP light fixtures and scenery are in
-        #define FIND_BSP_INDICES_FOR_OBJECT_ARRAY(array_type, objects, palette_type, palette, type_name, warn_if_partially_outside) { \
+        #define FIND_BSP_INDICES_FOR_OBJECT_ARRAY(array_type, objects, palette_type, palette, type_name, warn_if_partially_outside, reports) { \
             std::size_t object_count = this->objects.size(); \
             if(object_count) { \
                 auto &object_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.objects.pointer)]; \
@@ -72,13 +119,13 @@ namespace Invader::Parser {
                             } \
                         } \
                         if(bsp_indices == 0 && bsp_indices_technically_inside == 0) { \
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu was found in 0 BSPs, so it will not spawn", o); \
+                            REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu was found in 0 BSPs, so it will not spawn", o); \
                         } \
                         else if(warn_if_partially_outside) { \
                             /* If it's technically outside of a BSP due to bounding offset and we have a model, warn */ \
                             auto partially_outside = (bsp_indices ^ bsp_indices_technically_inside) & bsp_indices_technically_inside; \
                             if(partially_outside && model_present) { \
-                                REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu is inside a BSP but offset outside, so it will be fullbright", o); \
+                                REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, type_name " spawn #%zu is inside a BSP but offset outside, so it will be fullbright", o); \
                             } \
                         } \
                     } \
@@ -88,15 +135,62 @@ namespace Invader::Parser {
             } \
         }
 
-        FIND_BSP_INDICES_FOR_OBJECT_ARRAY(ScenarioScenery, scenery, ScenarioSceneryPalette, scenery_palette, "Scenery", true);
-        FIND_BSP_INDICES_FOR_OBJECT_ARRAY(ScenarioLightFixture, light_fixtures, ScenarioLightFixturePalette, light_fixture_palette, "Light fixture", true);
-        
+        // Placing objects and placing AI only read the BSPs and write to their own blocks, so objects can be placed on
+        // another thread while AI is placed on this one
+        BufferedReports object_reports(workload);
+        auto find_object_bsp_indices = [&]() {
+            FIND_BSP_INDICES_FOR_OBJECT_ARRAY(ScenarioScenery, scenery, ScenarioSceneryPalette, scenery_palette, "Scenery", true, object_reports);
+            FIND_BSP_INDICES_FOR_OBJECT_ARRAY(ScenarioLightFixture, light_fixtures, ScenarioLightFixturePalette, light_fixture_palette, "Light fixture", true, object_reports);
+        };
+
         #undef FIND_BSP_INDICES_FOR_OBJECT_ARRAY
 
+        bool has_objects = !this->scenery.empty() || !this->light_fixtures.empty();
+        bool has_ai = !this->encounters.empty() || !this->command_lists.empty();
+        std::optional<std::thread> object_thread;
+        std::exception_ptr object_exception;
+        if(has_objects && has_ai && workload.get_build_parameters()->thread_count > 1) {
+            // Compiling the BSPs for checking isn't thread-safe, so do it first
+            for(auto &bsp : bsp_data) {
+                bsp.compile();
+            }
+            object_thread.emplace([&find_object_bsp_indices, &object_exception]() {
+                try {
+                    find_object_bsp_indices();
+                }
+                catch(...) {
+                    object_exception = std::current_exception();
+                }
+            });
+        }
+        else {
+            find_object_bsp_indices();
+        }
+
         // Find what we need
+        BufferedReports ai_reports(workload);
         std::size_t bsp_find_warnings = 0;
-        find_encounters(*this, workload, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
-        find_command_lists(*this, workload, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
+        try {
+            find_encounters(*this, workload, ai_reports, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
+            find_command_lists(*this, workload, ai_reports, tag_index, bsp_data, scenario_struct, scenario_data, bsp_find_warnings, show_warnings);
+        }
+        catch(...) {
+            if(object_thread.has_value()) {
+                object_thread->join();
+            }
+            object_reports.flush(workload);
+            ai_reports.flush(workload);
+            throw;
+        }
+        if(object_thread.has_value()) {
+            object_thread->join();
+        }
+        object_reports.flush(workload);
+        if(object_exception) {
+            std::rethrow_exception(object_exception);
+        }
+        ai_reports.flush(workload);
+
         fix_bsp_referenced_data(*this, workload, bsp_data, scenario_struct, scenario_data);
         find_conversations(*this, workload, tag_index, scenario_struct, scenario_data);
         
@@ -175,13 +269,14 @@ namespace Invader::Parser {
     
     
     
-    static void find_encounters(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
+    static void find_encounters(Scenario &scenario, BuildWorkload &workload, BufferedReports &reports, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
         // Determine which BSP the encounters fall in
         std::size_t encounter_list_count = scenario.encounters.size();
         if(encounter_list_count != 0) {
             auto &encounter_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.encounters.pointer)];
             auto *encounter_array = reinterpret_cast<ScenarioEncounter::struct_little *>(encounter_struct.data.data());
             auto bsp_count = bsp_data.size();
+            auto thread_count = workload.get_build_parameters()->thread_count;
             
             for(std::size_t i = 0; i < encounter_list_count; i++) {
                 auto &encounter = scenario.encounters[i];
@@ -240,6 +335,16 @@ namespace Invader::Parser {
                 // Also, are we raycasting?
                 bool raycast = !(encounter.flags & HEK::ScenarioEncounterFlagsFlag::SCENARIO_ENCOUNTER_FLAGS_FLAG__3D_FIRING_POSITIONS);
 
+                // Check the squad positions and then the firing positions together in one batch per BSP
+                std::vector<HEK::Point3D<HEK::LittleEndian>> encounter_points;
+                encounter_points.reserve(squad_position_count + firing_position_count);
+                for(auto &sp : best_squad_positions_found) {
+                    encounter_points.emplace_back(encounter.squads[sp.squad].starting_locations[sp.starting_position].position);
+                }
+                for(auto &f : encounter.firing_positions) {
+                    encounter_points.emplace_back(f.position);
+                }
+
                 // Go through each BSP
                 std::vector<FiringPositionIndex> firing_positions_indices = best_firing_positions_indices;
                 std::vector<SquadPositionFound> squad_positions_found = best_squad_positions_found;
@@ -248,68 +353,26 @@ namespace Invader::Parser {
                     squad_positions_found.clear();
                     auto &bsp = bsp_data[b];
 
+                    // If raycasting check for a surface that is 0.5 world units above/below each point
+                    auto results = bsp.query_points(encounter_points.data(), encounter_points.size(), raycast ? std::optional<float>(0.5F) : std::nullopt, thread_count);
+
                     // Go through each squad; add 1 to hits for every squad we find in the BSP
                     std::size_t squad_hits = 0;
-                    for(std::size_t s = 0; s < squad_count; s++) {
-                        auto &squad = encounter.squads[s];
-                        std::size_t location_count = squad.starting_locations.size();
-                        
-                        for(std::size_t l = 0; l < location_count; l++) {
-                            auto &location = squad.starting_locations[l];
-                            
-                            // If raycasting check for a surface that is 0.5 world units above/below it
-                            bool found;
-                            std::optional<std::uint32_t> leaf_index;
-                            
-                            if(raycast) {
-                                std::uint32_t leaf;
-                                if((found = bsp.check_for_intersection(location.position, 0.5F, nullptr, nullptr, &leaf))) {
-                                    leaf_index = leaf;
-                                }
-                            }
-                            else {
-                                std::uint32_t leaf;
-                                if((found = bsp.check_if_point_inside_bsp(location.position, &leaf))) {
-                                    leaf_index = leaf; 
-                                }
-                            }
-                            
-                            // Set the cluster index
-                            HEK::Index cluster_index;
-                            if(leaf_index.has_value()) {
-                                cluster_index = bsp.render_leaves[*leaf_index].cluster;
-                            }
-                            else {
-                                cluster_index = NULL_INDEX;
-                            }
-                            
-                            squad_hits += found;
-                            squad_positions_found.emplace_back(SquadPositionFound { s, l, cluster_index, found });
-                        }
+                    for(std::size_t sp = 0; sp < squad_position_count; sp++) {
+                        auto &result = results[sp];
+                        auto &position = best_squad_positions_found[sp];
+                        squad_hits += result.found;
+                        squad_positions_found.emplace_back(SquadPositionFound { position.squad, position.starting_position, result.cluster_index, result.found });
                     }
                     
                     // Go through each firing position
                     std::size_t firing_position_hits = 0;
-                    for(auto &f : encounter.firing_positions) {
-                        // Here are the indices we'll set
-                        bool in_bsp;
-                        std::uint32_t surface_index = 0;
-                        std::uint32_t leaf_index = 0;
-                        
-                        // Raycast stuff
-                        if(raycast) {
-                            in_bsp = bsp.check_for_intersection(f.position, 0.5F, nullptr, &surface_index, &leaf_index);
-                        }
-                        else {
-                            std::uint32_t leaf;
-                            if((in_bsp = bsp.check_if_point_inside_bsp(f.position, &leaf))) {
-                                leaf_index = leaf;
-                            }
-                        }
+                    for(std::size_t fp = 0; fp < firing_position_count; fp++) {
+                        auto &result = results[squad_position_count + fp];
                         
                         // If we're in the BSP, add it
-                        if(in_bsp) {
-                            firing_positions_indices.emplace_back(FiringPositionIndex {bsp.render_leaves[leaf_index].cluster, surface_index, true});
+                        if(result.found) {
+                            firing_positions_indices.emplace_back(FiringPositionIndex { result.cluster_index, raycast ? result.surface_index : 0, true });
                             firing_position_hits++;
                         }
                         else {
@@ -350,20 +413,20 @@ namespace Invader::Parser {
                 
                 // Ambiguous?
                 if(total_best_bsps > 1) {
-                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in %zu BSPs (will place in BSP #%zu)", i, encounter.name.string, total_best_bsps, best_bsp);
+                    REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in %zu BSPs (will place in BSP #%zu)", i, encounter.name.string, total_best_bsps, best_bsp);
                     bsp_find_warnings++;
                 }
                 
                 // Are we missing stuff?
                 if(total_best_bsps == 0) {
-                    REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in 0 BSPs", i, encounter.name.string);
+                    REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) was found in 0 BSPs", i, encounter.name.string);
                 }
                 else if(best_bsp_total_hits != best_possible_hits) {
                     if(best_bsp_total_hits == 0) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is completely outside of BSP #%zu", i, encounter.name.string, best_bsp);
+                        REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is completely outside of BSP #%zu", i, encounter.name.string, best_bsp);
                     }
                     else {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is partially outside of BSP #%zu", i, encounter.name.string, best_bsp);
+                        REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) is partially outside of BSP #%zu", i, encounter.name.string, best_bsp);
                     }
                     
                     // Show the firing positions and squad positions that are missing
@@ -387,7 +450,7 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu firing position%s fell out: [%s]", missing_firing_positions, missing_firing_positions == 1 ? "" : "s", missing_firing_positions_list);
+                        reports.note("    - %zu firing position%s fell out: [%s]", missing_firing_positions, missing_firing_positions == 1 ? "" : "s", missing_firing_positions_list);
                     }
                     
                     auto missing_squad_positions = squad_position_count - best_bsp_squad_hits;
@@ -411,7 +474,7 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu squad position%s fell out: [%s]", missing_squad_positions, missing_squad_positions == 1 ? "" : "s", missing_squad_positions_list);
+                        reports.note("    - %zu squad position%s fell out: [%s]", missing_squad_positions, missing_squad_positions == 1 ? "" : "s", missing_squad_positions_list);
                     }
                 }
 
@@ -451,49 +514,37 @@ namespace Invader::Parser {
                         std::size_t move_position_count = squad.move_positions.count.read();
                         if(move_position_count) {
                             auto *move_position_data = reinterpret_cast<Parser::ScenarioMovePosition::struct_little *>(workload.structs[*squad_struct.resolve_pointer(&squad.move_positions.pointer)].data.data());
-                            for(std::size_t p = 0; p < move_position_count; p++) {
-                                if(!found_bsp) {
+                            if(!found_bsp) {
+                                for(std::size_t p = 0; p < move_position_count; p++) {
                                     move_position_data[p].cluster_index = NULL_INDEX;
                                     move_position_data[p].surface_index = 0;
-                                    continue;
-                                }
-                                
-                                std::optional<std::uint32_t> leaf_index;
-                                std::uint32_t surface_index = 0;
-                                
-                                if(raycast) {
-                                    std::uint32_t leaf;
-                                    if(found_bsp->check_for_intersection(move_position_data[p].position, 0.5F, nullptr, &surface_index, &leaf)) {
-                                        leaf_index = leaf;
-                                    }
                                 }
-                                else {
-                                    std::uint32_t leaf;
-                                    if(found_bsp->check_if_point_inside_bsp(move_position_data[p].position, &leaf)) {
-                                        leaf_index = leaf; 
-                                    }
+                            }
+                            else {
+                                std::vector<HEK::Point3D<HEK::LittleEndian>> move_points;
+                                move_points.reserve(move_position_count);
+                                for(std::size_t p = 0; p < move_position_count; p++) {
+                                    move_points.emplace_back(move_position_data[p].position);
                                 }
+                                auto results = found_bsp->query_points(move_points.data(), move_points.size(), raycast ? std::optional<float>(0.5F) : std::nullopt, thread_count);
                                 
-                                // Set the cluster index
-                                HEK::Index cluster_index;
-                                if(leaf_index.has_value()) {
-                                    cluster_index = found_bsp->render_leaves[*leaf_index].cluster;
-                                }
-                                else {
-                                    cluster_index = NULL_INDEX;
-                                    missing_squad_positions[s].emplace_back(p);
-                                    out_of_bounds++;
+                                for(std::size_t p = 0; p < move_position_count; p++) {
+                                    auto &result = results[p];
+                                    if(!result.found) {
+                                        missing_squad_positions[s].emplace_back(p);
+                                        out_of_bounds++;
+                                    }
+                                    
+                                    // Set surface and cluster index
+                                    move_position_data[p].surface_index = result.surface_index;
+                                    move_position_data[p].cluster_index = result.cluster_index;
                                 }
-                                
-                                // Set surface and cluster index
-                                move_position_data[p].surface_index = surface_index;
-                                move_position_data[p].cluster_index = cluster_index;
                             }
                         }
                     }
                     
                     if(out_of_bounds && show_warnings) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) has %zu squad move position%s that fall out of BSP #%zu", i, encounter.name.string, out_of_bounds, out_of_bounds == 1 ? "" : "s", best_bsp);
+                        REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Encounter #%zu (%s) has %zu squad move position%s that fall out of BSP #%zu", i, encounter.name.string, out_of_bounds, out_of_bounds == 1 ? "" : "s", best_bsp);
                         
                         int offset = 0;
                         char missing_move_positions_list[256] = {};
@@ -515,19 +566,20 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu move position%s fell out: [%s]", out_of_bounds, out_of_bounds == 1 ? "" : "s", missing_move_positions_list);
+                        reports.note("    - %zu move position%s fell out: [%s]", out_of_bounds, out_of_bounds == 1 ? "" : "s", missing_move_positions_list);
                     }
                 }
             }
         }
     }
     
-    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
+    static void find_command_lists(Scenario &scenario, BuildWorkload &workload, BufferedReports &reports, std::size_t tag_index, const std::vector<BSPData> &bsp_data, BuildWorkload::BuildWorkloadStruct &scenario_struct, const Scenario::struct_little &scenario_data, std::size_t &bsp_find_warnings, bool show_warnings) {
         std::size_t command_list_count = scenario.command_lists.size();
         if(command_list_count != 0) {
             auto &command_list_struct = workload.structs[*scenario_struct.resolve_pointer(&scenario_data.command_lists.pointer)];
             auto *command_list_array = reinterpret_cast<ScenarioCommandList::struct_little *>(command_list_struct.data.data());
             auto bsp_count = bsp_data.size();
+            auto thread_count = workload.get_build_parameters()->thread_count;
             for(std::size_t i = 0; i < command_list_count; i++) {
                 auto &command_list = scenario.command_lists[i];
                 auto &command_list_data = command_list_array[i];
@@ -556,6 +608,11 @@ namespace Invader::Parser {
                 
                 auto point_count = command_list.points.size();
                 std::vector<std::optional<std::uint32_t>> best_surface_indices(point_count);
+                std::vector<HEK::Point3D<HEK::LittleEndian>> command_list_points;
+                command_list_points.reserve(point_count);
+                for(auto &p : command_list.points) {
+                    command_list_points.emplace_back(p.position);
+                }
                 
                 // Go through each BSP (or one BSP for manual) to look for surface indices
                 for(std::size_t b = start; b < bsp_count; b++) {
@@ -567,13 +624,13 @@ namespace Invader::Parser {
 
                     // Basically, add 1 for every time we find it in here
                     // We need to check if there is a surface that is half a world unit or less below the position
-                    for(auto &p : command_list.points) {
+                    auto results = bsp.query_points(command_list_points.data(), command_list_points.size(), 0.5F, thread_count);
+                    for(auto &result : results) {
                         total_hits++;
                         
-                        std::uint32_t surface_index = 0;
-                        if(bsp.check_for_intersection(p.position, 0.5F, nullptr, &surface_index, nullptr)) {
+                        if(result.found) {
                             hits++;
-                            surface_indices.emplace_back(surface_index); // found a surface
+                            surface_indices.emplace_back(result.surface_index); // found a surface
                         }
                         else {
                             surface_indices.emplace_back(std::nullopt); // no surface underneath
@@ -618,14 +675,14 @@ namespace Invader::Parser {
                 // Show warnings if needed (only warn if we have more than 0 points, since 0 point encounters can't technically be in any BSP)
                 if(show_warnings && point_count > 0) {
                     if(total_best_bsps == 0) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in 0 BSPs", i, command_list.name.string);
+                        REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in 0 BSPs", i, command_list.name.string);
                     }
                     else if(best_bsp_hits != point_count) {
                         if(best_bsp_hits == 0) {
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is completely outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
+                            REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is completely outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
                         }
                         else {
-                            REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is partially outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
+                            REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) is partially outside of BSP #%zu (%zu / %zu hit%s)", i, command_list.name.string, best_bsp, best_bsp_hits, point_count, point_count == 1 ? "" : "s");
                         }
                             
                         auto missing_points = point_count - best_bsp_hits;
@@ -647,10 +704,10 @@ namespace Invader::Parser {
                             }
                         }
                         
-                        eprintf_warn_lesser("    - %zu point%s fell out: [%s]", missing_points, missing_points == 1 ? "" : "s", missing_points_list);
+                        reports.note("    - %zu point%s fell out: [%s]", missing_points, missing_points == 1 ? "" : "s", missing_points_list);
                     }
                     else if(total_best_bsps > 1) {
-                        REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in %zu BSP%s (will place in BSP #%zu)", i, command_list.name.string, total_best_bsps, total_best_bsps == 1 ? "" : "s", best_bsp);
+                        REPORT_ERROR_PRINTF(reports, ERROR_TYPE_WARNING, tag_index, "Command list #%zu (%s) was found in %zu BSP%s (will place in BSP #%zu)", i, command_list.name.string, total_best_bsps, total_best_bsps == 1 ? "" : "s", best_bsp);
                         bsp_find_warnings++;
                     }
                 }
@@ -737,9 +794,7 @@ namespace Invader::Parser {
                     bsp_tag_data.runtime_decals.count = static_cast<std::uint32_t>(runtime_decals.size());
 
                     if(runtime_decals.size() != 0) {
-                        auto &new_struct_ptr = bsp_tag_struct.pointers.emplace_back();
-                        new_struct_ptr.offset = reinterpret_cast<const std::byte *>(&bsp_tag_data.runtime_decals.pointer) - reinterpret_cast<const std::byte *>(&bsp_tag_data);
-                        new_struct_ptr.struct_index = workload.structs.size();
+                        bsp_tag_struct.add_pointer(reinterpret_cast<const std::byte *>(&bsp_tag_data.runtime_decals.pointer) - reinterpret_cast<const std::byte *>(&bsp_tag_data), workload.structs.size());
                         auto &new_struct = workload.structs.emplace_back();
                         new_struct.bsp = workload.structs[*workload.tags[bsp_id.index].base_struct].bsp;
                         new_struct.data = std::vector<std::byte>(reinterpret_cast<std::byte *>(runtime_decals.data()), reinterpret_cast<std::byte *>(runtime_decals.data() + runtime_decals.size()));
@@ -1,10 +1,14 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#include <map>
 #include <cassert>
+#include <set>
+#include <string_view>
+#include <unordered_map>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/build/build_workload.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/version.hpp>
 #include <invader/tag/parser/compile/scenario.hpp>
 
 #include <riat/riat.hpp>
@@ -59,77 +63,30 @@ namespace Invader::Parser {
         }
     }
 
-    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &script_source) {
+    // A tag referenced by the scripts. These are resolved against the tags directories on every build, even if the scripts were cached.
+    struct ScriptTagReference {
+        File::TagFilePath path;
+        std::string file;
+        std::size_t line;
+        std::size_t column;
+    };
+
+    // Everything compiling the script source produces (and what gets cached)
+    struct CompiledScriptData {
+        decltype(Scenario::scripts) scripts;
+        decltype(Scenario::globals) globals;
+        std::vector<std::byte> string_data;
+        std::vector<std::byte> syntax_data;
+        std::vector<std::string> warnings;
+        std::vector<ScriptTagReference> references;
+    };
+
+    static CompiledScriptData compile_script_source(Scenario &scenario, const HEK::GameEngineInfo &info, const decltype(Scenario::source_files) &source_files, const HUDMessageText &hmt, bool hmt_exists, const HUDGlobals &hud_globals, bool globals_exists, bool hud_globals_exists) {
         // Instantiate it
         RIAT::Compiler instance(static_cast<RIATCompileTarget>(info.scenario_script_compile_target));
 
-        // Open the hud message text
-        Parser::HUDMessageText hmt;
-        bool hmt_exists = !scenario.hud_messages.path.empty();
-        if(hmt_exists) {
-            auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(scenario.hud_messages.path) + ".hud_message_text", tags_directories);
-            if(file_path.has_value()) {
-                auto hud_message_text_data = File::open_file(*file_path);
-                if(!hud_message_text_data.has_value()) {
-                    eprintf_error("Failed to open %s\n", file_path->string().c_str());
-                    throw std::exception();
-                }
-                hmt = Parser::HUDMessageText::parse_hek_tag_file(hud_message_text_data->data(), hud_message_text_data->size());
-            }
-        }
-
-        // Eventually get the HUD globals tag
-        Parser::HUDGlobals hud_globals;
-        auto globals_file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path("globals\\globals.globals"), tags_directories);
-        bool globals_exists = globals_file_path.has_value();
-        bool hud_globals_exists = false;
-        if(globals_exists) {
-            auto globals_data = File::open_file(*globals_file_path);
-            if(!globals_data.has_value()) {
-                eprintf_error("Failed to open %s\n", globals_file_path->string().c_str());
-                throw std::exception();
-            }
-
-            auto globals = Globals::parse_hek_tag_file(globals_data->data(), globals_data->size());
-            if(!globals.interface_bitmaps.empty()) {
-                auto &interface_bitmaps = globals.interface_bitmaps[0];
-                if(!interface_bitmaps.hud_globals.path.empty()) {
-                    auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(interface_bitmaps.hud_globals.path) + ".hud_globals", tags_directories);
-                    if(file_path.has_value()) {
-                        auto hud_globals_data = File::open_file(*file_path);
-                        if(!hud_globals_data.has_value()) {
-                            eprintf_error("Failed to open %s\n", file_path->string().c_str());
-                            throw std::exception();
-                        }
-                        hud_globals = Parser::HUDGlobals::parse_hek_tag_file(hud_globals_data->data(), hud_globals_data->size());
-                        hud_globals_exists = true;
-                    }
-                }
-            }
-        }
-
-        // Load the input from script_source
-        decltype(scenario.source_files) source_files;
-        if(script_source.has_value()) {
-            for(auto &source : *script_source) {
-                auto &file = source_files.emplace_back();
-
-                // Check if it's too long. If not, copy. Otherwise, error
-                if(source.first.size() > sizeof(file.name.string) - 1) {
-                    eprintf_error("Script file name '%s' is too long", source.first.c_str());
-                    throw std::exception();
-                }
-                std::strncpy(file.name.string, source.first.c_str(), sizeof(file.name.string) - 1);
-
-                // Set it
-                file.source = source.second;
-            };
-        }
-
-        // Use the scenario tag's source data
-        else {
-            source_files = scenario.source_files;
-        }
+        CompiledScriptData compiled;
+        auto &warnings = compiled.warnings;
 
         // Load the scripts
         RIAT::CompilerScriptResult result;
@@ -165,15 +122,34 @@ namespace Invader::Parser {
         }
 
         std::vector<Invader::Parser::ScenarioScriptNode> into_nodes;
+        into_nodes.reserve(node_count);
 
         auto format_index_to_id = [](std::size_t index) -> std::uint32_t {
             auto index_16_bit = static_cast<std::uint16_t>(index);
             return static_cast<std::uint32_t>(((index_16_bit + 0x6373) | 0x8000) << 16) | index_16_bit;
         };
 
-        std::map<std::string, std::size_t> string_index;
+        // The node strings are owned by the compiler result, so they can be hashed in place
+        std::unordered_map<std::string_view, std::size_t> string_index;
         std::vector<std::byte> string_data;
 
+        // Names are matched case-insensitively, so each array is indexed by lowercase name the first time a script looks something up in it
+        struct NameIndexEntry {
+            std::size_t first_instance;
+            bool multiple_instances;
+        };
+        std::unordered_map<const void *, std::unordered_map<std::string, NameIndexEntry>> name_indices;
+        auto lowercase_name = [](const char *name) {
+            std::string lowercase = name;
+            for(char &c : lowercase) {
+                c = static_cast<char>(std::tolower(c));
+            }
+            return lowercase;
+        };
+
+        // Object names that something can be named, found the first time a script uses an object name
+        std::optional<std::vector<bool>> object_names_in_use;
+
         for(std::size_t node_index = 0; node_index < node_count; node_index++) {
             auto &n = nodes[node_index];
             auto &new_node = into_nodes.emplace_back();
@@ -187,14 +163,13 @@ namespace Invader::Parser {
 
             // If we have string data, add it
             if(n.string_data != NULL) {
-                std::string str = n.string_data;
-                if(!string_index.contains(str)) {
-                    string_index[str] = string_data.size();
-                    const auto *cstr = str.c_str();
-                    string_data.insert(string_data.end(), reinterpret_cast<const std::byte *>(cstr), reinterpret_cast<const std::byte *>(cstr) + str.size());
+                std::string_view str = n.string_data;
+                auto [string, added] = string_index.try_emplace(str, string_data.size());
+                if(added) {
+                    string_data.insert(string_data.end(), reinterpret_cast<const std::byte *>(str.data()), reinterpret_cast<const std::byte *>(str.data()) + str.size());
                     string_data.emplace_back(std::byte());
                 }
-                new_node.string_offset = string_index[str];
+                new_node.string_offset = string->second;
             }
 
             // All nodes are marked with this...?
@@ -263,41 +238,28 @@ namespace Invader::Parser {
             }
 
             // Get the index of the thing
-            auto find_thing = [&n, &warnings, &new_node](auto &array, const char *name) -> std::size_t {
+            auto find_thing = [&n, &warnings, &new_node, &name_indices, &lowercase_name](auto &array, const char *name) -> std::size_t {
                 if(std::strcmp(name, "none") == 0) {
                     return SIZE_MAX;
                 }
 
-                auto len = array.size();
-                bool exists = false;
-                bool multiple_instances = false;
-                std::size_t first_instance = 0;
-
-                // See if it exists and then find the first multiple instance if it does
-                for(std::size_t i = 0; i < len && !multiple_instances; i++) {
-                    const char *c = name;
-                    const char *d = array[i].name.string;
-
-                    while(*c != 0 && *d != 0 && std::tolower(*c) == std::tolower(*d)) {
-                        c++;
-                        d++;
-                    }
-
-                    if(std::tolower(*c) == std::tolower(*d)) {
-                        if(exists) {
-                            multiple_instances = true;
-                            break;
+                auto [names, needs_indexing] = name_indices.try_emplace(&array);
+                if(needs_indexing) {
+                    auto len = array.size();
+                    for(std::size_t i = 0; i < len; i++) {
+                        auto [entry, added] = names->second.try_emplace(lowercase_name(array[i].name.string), NameIndexEntry { i, false });
+                        if(!added) {
+                            entry->second.multiple_instances = true;
                         }
-
-                        first_instance = i;
-                        exists = true;
                     }
                 }
 
-                if(!exists) {
+                auto found = names->second.find(lowercase_name(name));
+                if(found == names->second.end()) {
                     throw std::exception();
                 }
 
+                auto [first_instance, multiple_instances] = found->second;
                 if(multiple_instances) {
                     char warning[512];
                     std::snprintf(warning, sizeof(warning), "%s:%zu:%zu: warning: multiple instances of %s '%s' found (first instance is %zu)", n.file, n.line, n.column, HEK::ScenarioScriptValueType_to_string_pretty(new_node.type), name, first_instance);
@@ -423,41 +385,37 @@ namespace Invader::Parser {
                             new_node.data.short_int = index;
 
                             if(index != SIZE_MAX) {
-                                bool something_corresponds_to_this = false;
-
-                                auto check_thing = [&something_corresponds_to_this, &index](auto &what) {
-                                    if(something_corresponds_to_this) {
-                                        return;
-                                    }
-                                    for(auto &i : what) {
-                                        if(i.name == index) {
-                                            something_corresponds_to_this = true;
+                                if(!object_names_in_use.has_value()) {
+                                    auto &in_use = object_names_in_use.emplace(scenario.object_names.size(), false);
+                                    auto mark_in_use = [&in_use](std::size_t name) {
+                                        if(name < in_use.size()) {
+                                            in_use[name] = true;
                                         }
-                                    }
-                                };
-
-                                check_thing(scenario.bipeds);
-                                check_thing(scenario.vehicles);
-                                check_thing(scenario.scenery);
-                                check_thing(scenario.weapons);
-                                check_thing(scenario.equipment);
-                                check_thing(scenario.machines);
-                                check_thing(scenario.controls);
-                                check_thing(scenario.light_fixtures);
-                                check_thing(scenario.sound_scenery);
+                                    };
+                                    auto check_thing = [&mark_in_use](auto &what) {
+                                        for(auto &i : what) {
+                                            mark_in_use(i.name);
+                                        }
+                                    };
+
+                                    check_thing(scenario.bipeds);
+                                    check_thing(scenario.vehicles);
+                                    check_thing(scenario.scenery);
+                                    check_thing(scenario.weapons);
+                                    check_thing(scenario.equipment);
+                                    check_thing(scenario.machines);
+                                    check_thing(scenario.controls);
+                                    check_thing(scenario.light_fixtures);
+                                    check_thing(scenario.sound_scenery);
 
-                                if(!something_corresponds_to_this) {
                                     for(auto &c : scenario.ai_conversations) {
                                         for(auto &p : c.participants) {
-                                            if(p.set_new_name == index) {
-                                                something_corresponds_to_this = true;
-                                                goto do_object_index_check_now;
-                                            }
+                                            mark_in_use(p.set_new_name);
                                         }
                                     }
                                 }
 
-                                do_object_index_check_now:
+                                bool something_corresponds_to_this = (*object_names_in_use)[index];
                                 if(!something_corresponds_to_this) {
                                     eprintf_error("%s:%zu:%zu: error: '%s' is an object name that does not correspond to any object or AI conversation and is thus invalid for use in scripts", n.file, n.line, n.column, n.string_data);
                                     throw InvalidTagDataException();
@@ -525,9 +483,8 @@ namespace Invader::Parser {
             }
         }
 
-
         // Set up references
-        std::list<std::pair<File::TagFilePath, std::size_t>> new_references_array;
+        std::set<File::TagFilePath> references_added;
         for(std::size_t n = 0; n < node_count; n++) {
             auto &node = nodes[n];
 
@@ -544,34 +501,305 @@ namespace Invader::Parser {
 
             // Add it if we don't have it
             auto new_path = File::TagFilePath(File::halo_path_to_preferred_path(node.string_data), *group);
-            bool is_found = false;
-            for(auto &i : new_references_array) {
-                if(i.first == new_path) {
-                    is_found = true;
-                    break;
+            if(references_added.insert(new_path).second) {
+                compiled.references.emplace_back(ScriptTagReference { new_path, node.file, node.line, node.column });
+            }
+        }
+
+        // Set up globals
+        decltype(scenario.globals) new_globals;
+        new_globals.resize(global_count);
+        for(std::size_t g = 0; g < global_count; g++) {
+            auto &new_global = new_globals[g];
+            const auto &cmp_global = globals[g];
+            std::strncpy(new_global.name.string, cmp_global.name, sizeof(new_global.name.string) - 1);
+
+            new_global.type = static_cast<decltype(new_global.type)>(cmp_global.value_type);
+            new_global.initialization_expression_index = format_index_to_id(cmp_global.first_node);
+        }
+
+        string_data.resize(string_data.size() + 1024);
+
+        compiled.scripts = std::move(new_scripts);
+        compiled.globals = std::move(new_globals);
+        compiled.string_data = std::move(string_data);
+        compiled.syntax_data = std::move(syntax_data);
+        return compiled;
+    }
+
+    // Increment this if the format of cached scripts changes
+    static constexpr std::uint32_t SCRIPT_CACHE_VERSION = 1;
+
+    static void write_script_cache_value(std::vector<std::byte> &data, std::uint64_t value) {
+        for(std::size_t i = 0; i < sizeof(value); i++) {
+            data.emplace_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    static void write_script_cache_bytes(std::vector<std::byte> &data, const void *bytes, std::size_t size) {
+        write_script_cache_value(data, size);
+        data.insert(data.end(), reinterpret_cast<const std::byte *>(bytes), reinterpret_cast<const std::byte *>(bytes) + size);
+    }
+
+    static std::vector<std::byte> write_script_cache(CompiledScriptData &compiled) {
+        std::vector<std::byte> data;
+
+        auto write_string = [&data](const std::string &string) {
+            write_script_cache_bytes(data, string.data(), string.size());
+        };
+        auto write_structs = [&data](auto &structs) {
+            write_script_cache_value(data, structs.size());
+            for(auto &s : structs) {
+                auto struct_data = s.generate_hek_tag_data();
+                write_script_cache_bytes(data, struct_data.data(), struct_data.size());
+            }
+        };
+
+        write_structs(compiled.scripts);
+        write_structs(compiled.globals);
+        write_script_cache_bytes(data, compiled.string_data.data(), compiled.string_data.size());
+        write_script_cache_bytes(data, compiled.syntax_data.data(), compiled.syntax_data.size());
+
+        write_script_cache_value(data, compiled.warnings.size());
+        for(auto &w : compiled.warnings) {
+            write_string(w);
+        }
+
+        write_script_cache_value(data, compiled.references.size());
+        for(auto &r : compiled.references) {
+            write_string(r.path.path);
+            write_script_cache_value(data, r.path.fourcc);
+            write_string(r.file);
+            write_script_cache_value(data, r.line);
+            write_script_cache_value(data, r.column);
+        }
+
+        return data;
+    }
+
+    // Returns nothing (rather than throwing) if the cached scripts are truncated or otherwise bad
+    static std::optional<CompiledScriptData> read_script_cache(const std::vector<std::byte> &data) {
+        std::size_t offset = 0;
+
+        auto read_value = [&data, &offset](auto &value) -> bool {
+            if(data.size() - offset < sizeof(std::uint64_t)) {
+                return false;
+            }
+            std::uint64_t value_read = 0;
+            for(std::size_t i = 0; i < sizeof(value_read); i++) {
+                value_read |= static_cast<std::uint64_t>(data[offset++]) << (i * 8);
+            }
+            value = static_cast<std::remove_reference_t<decltype(value)>>(value_read);
+            return true;
+        };
+        auto read_bytes = [&data, &offset, &read_value](const std::byte *&bytes, std::size_t &size) -> bool {
+            if(!read_value(size) || data.size() - offset < size) {
+                return false;
+            }
+            bytes = data.data() + offset;
+            offset += size;
+            return true;
+        };
+        auto read_string = [&read_bytes](std::string &string) -> bool {
+            const std::byte *bytes;
+            std::size_t size;
+            if(!read_bytes(bytes, size)) {
+                return false;
+            }
+            string = std::string(reinterpret_cast<const char *>(bytes), size);
+            return true;
+        };
+        auto read_data = [&read_bytes](std::vector<std::byte> &vector) -> bool {
+            const std::byte *bytes;
+            std::size_t size;
+            if(!read_bytes(bytes, size)) {
+                return false;
+            }
+            vector = std::vector<std::byte>(bytes, bytes + size);
+            return true;
+        };
+        auto read_structs = [&read_value, &read_bytes](auto &structs) -> bool {
+            std::size_t count;
+            if(!read_value(count)) {
+                return false;
+            }
+            for(std::size_t i = 0; i < count; i++) {
+                const std::byte *bytes;
+                std::size_t size, size_read;
+                if(!read_bytes(bytes, size)) {
+                    return false;
                 }
+                structs.emplace_back(std::remove_reference_t<decltype(structs)>::value_type::parse_hek_tag_data(bytes, size, size_read));
             }
-            if(!is_found) {
-                new_references_array.emplace_back(new_path, n);
+            return true;
+        };
+
+        CompiledScriptData compiled;
+        try {
+            std::size_t warning_count, reference_count;
+            if(!read_structs(compiled.scripts) || !read_structs(compiled.globals) || !read_data(compiled.string_data) || !read_data(compiled.syntax_data) || !read_value(warning_count)) {
+                return std::nullopt;
+            }
+            for(std::size_t w = 0; w < warning_count; w++) {
+                if(!read_string(compiled.warnings.emplace_back())) {
+                    return std::nullopt;
+                }
+            }
+            if(!read_value(reference_count)) {
+                return std::nullopt;
+            }
+            for(std::size_t r = 0; r < reference_count; r++) {
+                auto &reference = compiled.references.emplace_back();
+                if(!read_string(reference.path.path) || !read_value(reference.path.fourcc) || !read_string(reference.file) || !read_value(reference.line) || !read_value(reference.column)) {
+                    return std::nullopt;
+                }
+            }
+        }
+        catch(std::exception &) {
+            return std::nullopt;
+        }
+
+        if(offset != data.size()) {
+            return std::nullopt;
+        }
+        return compiled;
+    }
+
+    void compile_scripts(Scenario &scenario, const HEK::GameEngineInfo &info, std::vector<std::string> &warnings, const std::vector<std::filesystem::path> &tags_directories, const std::optional<std::vector<std::pair<std::string, std::vector<std::byte>>>> &script_source, const std::optional<std::filesystem::path> &cache_directory) {
+        // Anything read that changes how the scripts compile goes into the cache key
+        FNV1AHash cache_key;
+        auto hash_dependency = [&cache_key](const std::vector<std::byte> &data) {
+            cache_key.add_uint64_le(data.size());
+            cache_key.add_bytes(data.data(), data.size());
+        };
+
+        // Open the hud message text
+        Parser::HUDMessageText hmt;
+        bool hmt_exists = !scenario.hud_messages.path.empty();
+        if(hmt_exists) {
+            auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(scenario.hud_messages.path) + ".hud_message_text", tags_directories);
+            if(file_path.has_value()) {
+                auto hud_message_text_data = File::open_file(*file_path);
+                if(!hud_message_text_data.has_value()) {
+                    eprintf_error("Failed to open %s\n", file_path->string().c_str());
+                    throw std::exception();
+                }
+                hash_dependency(*hud_message_text_data);
+                hmt = Parser::HUDMessageText::parse_hek_tag_file(hud_message_text_data->data(), hud_message_text_data->size());
             }
         }
 
+        // Eventually get the HUD globals tag
+        Parser::HUDGlobals hud_globals;
+        auto globals_file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path("globals\\globals.globals"), tags_directories);
+        bool globals_exists = globals_file_path.has_value();
+        bool hud_globals_exists = false;
+        if(globals_exists) {
+            auto globals_data = File::open_file(*globals_file_path);
+            if(!globals_data.has_value()) {
+                eprintf_error("Failed to open %s\n", globals_file_path->string().c_str());
+                throw std::exception();
+            }
+
+            hash_dependency(*globals_data);
+            auto globals = Globals::parse_hek_tag_file(globals_data->data(), globals_data->size());
+            if(!globals.interface_bitmaps.empty()) {
+                auto &interface_bitmaps = globals.interface_bitmaps[0];
+                if(!interface_bitmaps.hud_globals.path.empty()) {
+                    auto file_path = File::tag_path_to_file_path(File::halo_path_to_preferred_path(interface_bitmaps.hud_globals.path) + ".hud_globals", tags_directories);
+                    if(file_path.has_value()) {
+                        auto hud_globals_data = File::open_file(*file_path);
+                        if(!hud_globals_data.has_value()) {
+                            eprintf_error("Failed to open %s\n", file_path->string().c_str());
+                            throw std::exception();
+                        }
+                        hash_dependency(*hud_globals_data);
+                        hud_globals = Parser::HUDGlobals::parse_hek_tag_file(hud_globals_data->data(), hud_globals_data->size());
+                        hud_globals_exists = true;
+                    }
+                }
+            }
+        }
+
+        // Load the input from script_source
+        decltype(scenario.source_files) source_files;
+        if(script_source.has_value()) {
+            for(auto &source : *script_source) {
+                auto &file = source_files.emplace_back();
+
+                // Check if it's too long. If not, copy. Otherwise, error
+                if(source.first.size() > sizeof(file.name.string) - 1) {
+                    eprintf_error("Script file name '%s' is too long", source.first.c_str());
+                    throw std::exception();
+                }
+                std::strncpy(file.name.string, source.first.c_str(), sizeof(file.name.string) - 1);
+
+                // Set it
+                file.source = source.second;
+            };
+        }
+
+        // Use the scenario tag's source data
+        else {
+            source_files = scenario.source_files;
+        }
+
+        // Compile the scripts, or load them from the cache if nothing changed since they were last compiled
+        std::optional<CompiledScriptData> compiled;
+        std::optional<std::filesystem::path> cache_path;
+        if(cache_directory.has_value()) {
+            const char *version = full_version();
+            cache_key.add_uint64_le(SCRIPT_CACHE_VERSION);
+            cache_key.add_bytes(version, std::strlen(version));
+            cache_key.add_uint64_le(static_cast<std::uint64_t>(info.scenario_script_compile_target));
+            cache_key.add_uint64_le(info.maximum_scenario_script_nodes);
+            cache_key.add_uint64_le(hmt_exists);
+            cache_key.add_uint64_le(globals_exists);
+            cache_key.add_uint64_le(hud_globals_exists);
+            for(auto &source : source_files) {
+                cache_key.add_bytes(source.name.string, std::strlen(source.name.string));
+                hash_dependency(source.source);
+            }
+
+            // Names of objects, encounters, etc. are looked up by the scripts, so the rest of the scenario goes in, too
+            hash_dependency(scenario.generate_hek_tag_data(TagFourCC::TAG_FOURCC_SCENARIO));
+
+            char file_name[64];
+            std::snprintf(file_name, sizeof(file_name), "%016llx.scriptcache", static_cast<unsigned long long>(cache_key.get()));
+            cache_path = *cache_directory / file_name;
+
+            auto cached_data = File::open_file(*cache_path);
+            if(cached_data.has_value()) {
+                compiled = read_script_cache(*cached_data);
+            }
+        }
+
+        if(!compiled.has_value()) {
+            compiled = compile_script_source(scenario, info, source_files, hmt, hmt_exists, hud_globals, globals_exists, hud_globals_exists);
+            if(cache_path.has_value()) {
+                std::error_code ec;
+                std::filesystem::create_directories(*cache_directory, ec);
+                File::save_file(*cache_path, write_script_cache(*compiled));
+            }
+        }
+
+        warnings.insert(warnings.end(), compiled->warnings.begin(), compiled->warnings.end());
+
         // Resolve object references
         decltype(scenario.references) new_references;
-        new_references.reserve(new_references_array.size());
-        for(auto &r : new_references_array) {
-            auto &[path, node_index] = r;
-            auto &n = nodes[node_index];
+        new_references.reserve(compiled->references.size());
+        for(auto &reference : compiled->references) {
+            auto &path = reference.path;
 
             bool resolved = false;
 
             if(!resolved) {
                 try {
-                    auto resolve_maybe = [&tags_directories, &r]() -> bool {
-                        return File::tag_path_to_file_path(r.first, tags_directories).has_value();
+                    auto resolve_maybe = [&tags_directories, &path]() -> bool {
+                        return File::tag_path_to_file_path(path, tags_directories).has_value();
                     };
-                    auto resolve_with_fourcc_maybe = [&resolve_maybe, &r](HEK::TagFourCC fourcc) -> bool {
-                        r.first.fourcc = fourcc;
+                    auto resolve_with_fourcc_maybe = [&resolve_maybe, &path](HEK::TagFourCC fourcc) -> bool {
+                        path.fourcc = fourcc;
                         return resolve_maybe();
                     };
 
@@ -594,7 +822,7 @@ namespace Invader::Parser {
 
             // See if it has the tag group explicitly mentioned
             if(!resolved) {
-                auto tfp_maybe = File::split_tag_class_extension(r.first.path);
+                auto tfp_maybe = File::split_tag_class_extension(path.path);
                 if(tfp_maybe.has_value()) {
                     auto &tfp = *tfp_maybe;
 
@@ -617,7 +845,7 @@ namespace Invader::Parser {
                     if(fourcc_matches) {
                         if((resolved = File::tag_path_to_file_path(tfp, tags_directories).has_value())) {
                             char w[1024];
-                            std::snprintf(w, sizeof(w), "%s:%zu:%zu: warning: using tag paths with explicit groups is a Halo 2 extension and may not work with stock tools or any future release of Invader", n.file, n.line, n.column);
+                            std::snprintf(w, sizeof(w), "%s:%zu:%zu: warning: using tag paths with explicit groups is a Halo 2 extension and may not work with stock tools or any future release of Invader", reference.file.c_str(), reference.line, reference.column);
                             warnings.emplace_back(w);
                             path = tfp;
                         }
@@ -628,14 +856,13 @@ namespace Invader::Parser {
             // Is it "none"?
             bool skip_adding = false;
 
-            if(!resolved && r.first.path == "none") {
+            if(!resolved && path.path == "none") {
                 resolved = true;
-                path = r.first;
                 skip_adding = true;
             }
 
             if(!resolved) {
-                eprintf_error("%s:%zu:%zu: error: can't find %s tag \"%s\"", n.file, n.line, n.column, HEK::tag_fourcc_to_extension(path.fourcc), path.path.c_str());
+                eprintf_error("%s:%zu:%zu: error: can't find %s tag \"%s\"", reference.file.c_str(), reference.line, reference.column, HEK::tag_fourcc_to_extension(path.fourcc), path.path.c_str());
                 throw InvalidTagDataException();
             }
 
@@ -647,26 +874,12 @@ namespace Invader::Parser {
             }
         }
 
-        // Set up globals
-        decltype(scenario.globals) new_globals;
-        new_globals.resize(global_count);
-        for(std::size_t g = 0; g < global_count; g++) {
-            auto &new_global = new_globals[g];
-            const auto &cmp_global = globals[g];
-            std::strncpy(new_global.name.string, cmp_global.name, sizeof(new_global.name.string) - 1);
-
-            new_global.type = static_cast<decltype(new_global.type)>(cmp_global.value_type);
-            new_global.initialization_expression_index = format_index_to_id(cmp_global.first_node);
-        }
-
-        string_data.resize(string_data.size() + 1024);
-
         // Clear out the script data
-        scenario.scripts = std::move(new_scripts);
-        scenario.globals = std::move(new_globals);
+        scenario.scripts = std::move(compiled->scripts);
+        scenario.globals = std::move(compiled->globals);
         scenario.source_files = std::move(source_files);
-        scenario.script_string_data = std::move(string_data);
-        scenario.script_syntax_data = std::move(syntax_data);
+        scenario.script_string_data = std::move(compiled->string_data);
+        scenario.script_syntax_data = std::move(compiled->syntax_data);
         scenario.references = std::move(new_references);
     }
 
@@ -903,7 +1116,7 @@ namespace Invader::Parser {
         try {
             std::vector<std::string> warnings;
 
-            compile_scripts(scenario, HEK::GameEngineInfo::get_game_engine_info(build_parameters.details.build_game_engine), warnings, build_parameters.tags_directories);
+            compile_scripts(scenario, HEK::GameEngineInfo::get_game_engine_info(build_parameters.details.build_game_engine), warnings, build_parameters.tags_directories, std::nullopt, build_parameters.tag_cache_directory);
             for(auto &w : warnings) {
                 REPORT_ERROR_PRINTF(workload, ERROR_TYPE_WARNING, tag_index, "Script compilation warning: %s", w.c_str());
             }
@@ -1013,10 +1226,8 @@ namespace Invader::Parser {
             if(node_object_index.has_value()) {
                 // If we found it, set it
                 node.data = HEK::TagID { static_cast<std::uint32_t>(*node_object_index) };
-                auto &new_dep = script_data_struct.dependencies.emplace_back();
-                new_dep.offset = reinterpret_cast<std::byte *>(&node.data) - syntax_data;
+                auto &new_dep = script_data_struct.add_dependency(reinterpret_cast<std::byte *>(&node.data) - syntax_data, *node_object_index);
                 new_dep.tag_id_only = true;
-                new_dep.tag_index = *node_object_index;
             }
 
             // None?
@@ -1032,11 +1243,9 @@ namespace Invader::Parser {
         }
 
         // Add the new structs
-        auto &new_ptr = workload.structs[struct_index].pointers.emplace_back();
         auto &scenario_struct = *reinterpret_cast<Scenario::struct_little *>(workload.structs[struct_index].data.data());
         scenario_struct.script_syntax_data.size = static_cast<std::uint32_t>(script_data_struct.data.size());
-        new_ptr.offset = reinterpret_cast<std::byte *>(&scenario_struct.script_syntax_data.pointer) - reinterpret_cast<std::byte *>(&scenario_struct);
-        new_ptr.struct_index = workload.structs.size();
+        workload.structs[struct_index].add_pointer(reinterpret_cast<std::byte *>(&scenario_struct.script_syntax_data.pointer) - reinterpret_cast<std::byte *>(&scenario_struct), workload.structs.size());
         workload.structs.emplace_back(std::move(script_data_struct));
     }
 
@@ -1083,7 +1292,8 @@ namespace Invader::Parser {
                     used[type_index]++; \
                 } \
             } \
-            for(std::size_t i = 0; i < type_count; i++) { \
+            /* Unused palette entries are only worth looking for if someone will see the warnings */ \
+            for(std::size_t i = 0; i < type_count && workload.is_reported(ErrorHandler::ErrorType::ERROR_TYPE_WARNING_PEDANTIC); i++) { \
                 auto &palette = scenario.scenario_palette_type[i].name; \
                 bool is_null = palette.path.size() == 0; \
                 if(!used[i]) { \
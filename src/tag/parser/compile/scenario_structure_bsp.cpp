@@ -6,6 +6,9 @@
 #include <invader/build/build_workload.hpp>
 #include <invader/tag/parser/compile/bitmap.hpp>
 #include <invader/tag/parser/compile/shader.hpp>
+#include <invader/thread_pool.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <map>
 #include <utility>
@@ -397,9 +400,7 @@ namespace Invader::Parser {
                     // We do!
                     if(all_predicted_resource_count > 0) {
                         // Add a new pointer
-                        auto &new_pointer = get_clusters_struct().pointers.emplace_back();
-                        new_pointer.struct_index = workload.structs.size();
-                        new_pointer.offset = reinterpret_cast<std::byte *>(&cluster_struct.predicted_resources.pointer) - reinterpret_cast<std::byte *>(clusters);
+                        get_clusters_struct().add_pointer(reinterpret_cast<std::byte *>(&cluster_struct.predicted_resources.pointer) - reinterpret_cast<std::byte *>(clusters), workload.structs.size());
                         
                         cluster_struct.predicted_resources.count = all_predicted_resource_count;
                         
@@ -415,9 +416,7 @@ namespace Invader::Parser {
                             t.tag = HEK::TagID { static_cast<std::uint32_t>(resource->first) };
                             t.type = HEK::PredictedResourceType::PREDICTED_RESOURCE_TYPE_BITMAP;
                             
-                            auto &reference = new_predicted_resources_struct.dependencies.emplace_back();
-                            reference.offset = reinterpret_cast<std::byte *>(&t.tag) - reinterpret_cast<std::byte *>(new_predicted_resources);
-                            reference.tag_index = resource->first;
+                            auto &reference = new_predicted_resources_struct.add_dependency(reinterpret_cast<std::byte *>(&t.tag) - reinterpret_cast<std::byte *>(new_predicted_resources), resource->first);
                             reference.tag_id_only = true;
                         }
                     }
@@ -464,9 +463,7 @@ namespace Invader::Parser {
                     std::byte() \
                 ).base() \
             ); \
-            for(std::size_t v = 0; v < material.rendered_vertices_count; v++) { \
-                new_bsp_vertices[v] = convert_rendered(bsp_vertices[v]); \
-            } \
+            convert_rendered(bsp_vertices, new_bsp_vertices, material.rendered_vertices_count); \
      \
             /* Add lightmap vertices */ \
             if(material.lightmap_vertices_count == material.rendered_vertices_count) { \
@@ -480,16 +477,14 @@ namespace Invader::Parser {
                         std::byte() \
                     ).base() \
                 ); \
-                for(std::size_t v = 0; v < material.lightmap_vertices_count; v++) { \
-                    new_bsp_lightmap_vertices[v] = convert_lightmap(bsp_lightmap_vertices[v]); \
-                } \
+                convert_lightmap(bsp_lightmap_vertices, new_bsp_lightmap_vertices, material.lightmap_vertices_count); \
             }
 
         if(material.uncompressed_vertices.size() == 0 && material.compressed_vertices.size() != 0) {
-            PROCESS_VERTICES(compressed_vertices,uncompressed_vertices,ScenarioStructureBSPMaterialCompressedRenderedVertex,ScenarioStructureBSPMaterialUncompressedRenderedVertex,ScenarioStructureBSPMaterialCompressedLightmapVertex,ScenarioStructureBSPMaterialUncompressedLightmapVertex,decompress_sbsp_rendered_vertex,decompress_sbsp_lightmap_vertex)
+            PROCESS_VERTICES(compressed_vertices,uncompressed_vertices,ScenarioStructureBSPMaterialCompressedRenderedVertex,ScenarioStructureBSPMaterialUncompressedRenderedVertex,ScenarioStructureBSPMaterialCompressedLightmapVertex,ScenarioStructureBSPMaterialUncompressedLightmapVertex,decompress_sbsp_rendered_vertex_array,decompress_sbsp_lightmap_vertex_array)
         }
         else if(material.uncompressed_vertices.size() != 0 && material.compressed_vertices.size() == 0) {
-            PROCESS_VERTICES(uncompressed_vertices,compressed_vertices,ScenarioStructureBSPMaterialUncompressedRenderedVertex,ScenarioStructureBSPMaterialCompressedRenderedVertex,ScenarioStructureBSPMaterialUncompressedLightmapVertex,ScenarioStructureBSPMaterialCompressedLightmapVertex,compress_sbsp_rendered_vertex,compress_sbsp_lightmap_vertex)
+            PROCESS_VERTICES(uncompressed_vertices,compressed_vertices,ScenarioStructureBSPMaterialUncompressedRenderedVertex,ScenarioStructureBSPMaterialCompressedRenderedVertex,ScenarioStructureBSPMaterialUncompressedLightmapVertex,ScenarioStructureBSPMaterialCompressedLightmapVertex,compress_sbsp_rendered_vertex_array,compress_sbsp_lightmap_vertex_array)
         }
         else {
             return false;
@@ -497,13 +492,29 @@ namespace Invader::Parser {
         return true;
     }
 
+    // Below this many vertices per thread, converting materials in parallel costs more than it saves
+    static constexpr std::size_t MIN_PARALLEL_VERTEX_COUNT = 65536;
+
     bool regenerate_missing_bsp_vertices(ScenarioStructureBSP &bsp, bool fix) {
-        bool return_value = false;
+        std::vector<ScenarioStructureBSPMaterial *> materials;
+        std::size_t vertex_count = 0;
         for(auto &lightmap : bsp.lightmaps) {
             for(auto &material : lightmap.materials) {
-                return_value = regenerate_missing_bsp_vertices(material, fix) || return_value;
+                materials.emplace_back(&material);
+                vertex_count += material.rendered_vertices_count;
             }
         }
+
+        // Materials don't share any vertices, so they can be converted at the same time
+        std::size_t material_count = materials.size();
+        std::size_t thread_count = fix ? vertex_count / MIN_PARALLEL_VERTEX_COUNT : 1;
+        std::atomic<bool> return_value = false;
+        ThreadPool::shared().parallel_for(material_count, [&materials, &return_value, &fix](std::size_t m) {
+            if(regenerate_missing_bsp_vertices(*materials[m], fix)) {
+                return_value = true;
+            }
+        }, thread_count);
+
         return return_value;
     }
 
@@ -641,15 +652,11 @@ namespace Invader::Parser {
         };
         
         // Add vertices/indices pointers
-        auto &rendered_vertices_ptr = bsp_header_struct.pointers.emplace_back();
+        auto &rendered_vertices_ptr = bsp_header_struct.add_pointer(reinterpret_cast<std::byte *>(&bsp_header.rendered_vertices) - reinterpret_cast<std::byte *>(&bsp_header), rendered_vertices_struct_index);
         rendered_vertices_ptr.limit_to_32_bits = true;
-        rendered_vertices_ptr.struct_index = rendered_vertices_struct_index;
-        rendered_vertices_ptr.offset = reinterpret_cast<std::byte *>(&bsp_header.rendered_vertices) - reinterpret_cast<std::byte *>(&bsp_header);
         
-        auto &lightmap_vertices_ptr = bsp_header_struct.pointers.emplace_back();
+        auto &lightmap_vertices_ptr = bsp_header_struct.add_pointer(reinterpret_cast<std::byte *>(&bsp_header.lightmap_vertices) - reinterpret_cast<std::byte *>(&bsp_header), lightmap_vertices_struct_index);
         lightmap_vertices_ptr.limit_to_32_bits = true;
-        lightmap_vertices_ptr.struct_index = lightmap_vertices_struct_index;
-        lightmap_vertices_ptr.offset = reinterpret_cast<std::byte *>(&bsp_header.lightmap_vertices) - reinterpret_cast<std::byte *>(&bsp_header);
         
         auto &rendered_vertices_struct = workload.structs[rendered_vertices_struct_index];
         rendered_vertices_struct.bsp = bsp;
@@ -672,27 +679,19 @@ namespace Invader::Parser {
             auto &mat = lightmap_materials[m];
             auto cv = mat.material_struct->resolve_pointer(&mat.material->compressed_vertices.pointer).value();
             
-            auto &rvp = rendered_vertices_struct.pointers.emplace_back();
+            auto &rvp = rendered_vertices_struct.add_pointer(reinterpret_cast<std::byte *>(&rv.pointer) - reinterpret_cast<std::byte *>(rendered_pointers), cv);
             rvp.limit_to_32_bits = true;
-            rvp.offset = reinterpret_cast<std::byte *>(&rv.pointer) - reinterpret_cast<std::byte *>(rendered_pointers);
-            rvp.struct_index = cv;
             
-            auto &lmp = lightmap_vertices_struct.pointers.emplace_back();
+            auto &lmp = lightmap_vertices_struct.add_pointer(reinterpret_cast<std::byte *>(&lm.pointer) - reinterpret_cast<std::byte *>(lightmap_pointers), cv);
             lmp.limit_to_32_bits = true;
-            lmp.offset = reinterpret_cast<std::byte *>(&lm.pointer) - reinterpret_cast<std::byte *>(lightmap_pointers);
-            lmp.struct_index = cv;
             lmp.struct_data_offset = mat.material->rendered_vertices_offset;
             
-            auto &rvp_from_material = mat.material_struct->pointers.emplace_back();
+            auto &rvp_from_material = mat.material_struct->add_pointer(reinterpret_cast<std::byte *>(&mat.material->rendered_vertices_index_pointer) - mat.material_struct->data.data(), rendered_vertices_struct_index);
             rvp_from_material.limit_to_32_bits = true;
-            rvp_from_material.offset = reinterpret_cast<std::byte *>(&mat.material->rendered_vertices_index_pointer) - mat.material_struct->data.data();
-            rvp_from_material.struct_index = rendered_vertices_struct_index;
             rvp_from_material.struct_data_offset = reinterpret_cast<std::byte *>(&rv) - reinterpret_cast<std::byte *>(rendered_pointers);
             
-            auto &lmp_from_material = mat.material_struct->pointers.emplace_back();
+            auto &lmp_from_material = mat.material_struct->add_pointer(reinterpret_cast<std::byte *>(&mat.material->lightmap_vertices_index_pointer) - mat.material_struct->data.data(), lightmap_vertices_struct_index);
             lmp_from_material.limit_to_32_bits = true;
-            lmp_from_material.offset = reinterpret_cast<std::byte *>(&mat.material->lightmap_vertices_index_pointer) - mat.material_struct->data.data();
-            lmp_from_material.struct_index = lightmap_vertices_struct_index;
             lmp_from_material.struct_data_offset = reinterpret_cast<std::byte *>(&lm) - reinterpret_cast<std::byte *>(lightmap_pointers);
         }
     }
@@ -103,7 +103,12 @@ namespace Invader::Parser {
             
         }
         else if(this->format ==  HEK::SoundFormat::SOUND_FORMAT_OGG_VORBIS) {
-            auto expected_buffer_size = SoundReader::ogg_vorbis_sample_count(this->samples.data(), this->samples.size()) * sizeof(std::uint16_t);
+            // Count from the page headers first, only opening the stream with libvorbisfile if that doesn't match
+            auto sample_count = SoundReader::ogg_vorbis_sample_count_from_pages(this->samples.data(), this->samples.size());
+            if(!sample_count.has_value() || *sample_count * sizeof(std::uint16_t) != this->buffer_size) {
+                sample_count = SoundReader::ogg_vorbis_sample_count(this->samples.data(), this->samples.size());
+            }
+            auto expected_buffer_size = *sample_count * sizeof(std::uint16_t);
             if(this->buffer_size != expected_buffer_size) {
                 incorrect_buffer = true;
             }
@@ -149,19 +154,16 @@ namespace Invader::Parser {
         this_struct.samples.size = static_cast<std::uint32_t>(this->samples.size());
 
         // Who am I??
-        auto &new_id_1 = workload.structs[struct_index].dependencies.emplace_back();
-        new_id_1.tag_index = tag_index;
-        new_id_1.offset = reinterpret_cast<std::byte *>(&this_struct.tag_id_0) - data;
+        auto &new_id_1 = workload.structs[struct_index].add_dependency(reinterpret_cast<std::byte *>(&this_struct.tag_id_0) - data, tag_index);
         new_id_1.tag_id_only = true;
 
         // 24601!!!!!!!
-        auto &new_id_2 = workload.structs[struct_index].dependencies.emplace_back();
-        new_id_2.tag_index = tag_index;
-        new_id_2.offset = reinterpret_cast<std::byte *>(&this_struct.tag_id_1) - data;
+        auto &new_id_2 = workload.structs[struct_index].add_dependency(reinterpret_cast<std::byte *>(&this_struct.tag_id_1) - data, tag_index);
         new_id_2.tag_id_only = true;
 
-        // Add samples
-        auto &r = workload.raw_data.emplace_back(this->samples);
+        // Add samples (unless we're only checking, in which case they'd never be used)
+        MemoryUsage::Scope memory_usage_scope(MemoryUsage::MEMORY_USAGE_CATEGORY_RAW_DATA);
+        auto &r = workload.get_build_parameters()->check_only ? workload.raw_data.emplace_back() : workload.raw_data.emplace_back(this->samples);
         workload.tags[tag_index].asset_data.emplace_back(&r - workload.raw_data.data());
         this->samples_pointer = 0xFFFFFFFF;
     }
@@ -1,14 +1,19 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <invader/tag/parser/parser.hpp>
 #include <invader/tag/parser/parser_struct.hpp>
 #include <invader/tag/hek/header.hpp>
 #include <invader/file/file.hpp>
+#include <invader/hash/fnv1a.hpp>
+#include <invader/error.hpp>
 #include "../../crc/crc32.h"
 
 namespace Invader::Parser {
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
+        const void *       base,
         const char *       name,
         const char *       member_name,
         const char *       comment,
@@ -20,17 +25,17 @@ namespace Invader::Parser {
         member_name(member_name),
         comment(comment),
         type(ValueType::VALUE_TYPE_DEPENDENCY),
-        address(dependency),
         allowed_classes(allowed_classes, allowed_classes + count),
-        read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(dependency) - reinterpret_cast<const std::byte *>(base)) {}
 
-    
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
         const char *name,
         const char *comment
     ) : name(name), comment(comment), type(ValueType::VALUE_TYPE_GROUP_START) {}
-            
-    ParserStructValue::ParserStructValue(
+
+    ParserStructValue::Descriptor::Descriptor(
+        const void *          base,
         const char *          name,
         const char *          member_name,
         const char *          comment,
@@ -47,16 +52,17 @@ namespace Invader::Parser {
         member_name(member_name),
         comment(comment),
         type(type),
-        address(object),
         count(count),
         bounds(bounds),
         unit(unit),
         minimum(minimum),
         maximum(maximum),
         volatile_value(volatile_value),
-        read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(object) - reinterpret_cast<const std::byte *>(base)) {}
 
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
+        const void *                        base,
         const char *                        name,
         const char *                        member_name,
         const char *                        comment,
@@ -74,7 +80,6 @@ namespace Invader::Parser {
         member_name(member_name),
         comment(comment),
         type(ValueType::VALUE_TYPE_REFLEXIVE),
-        address(array),
         get_object_in_array_fn(get_object_in_array_fn),
         get_array_size_fn(get_array_size_fn),
         delete_objects_in_array_fn(delete_objects_in_array_fn),
@@ -83,9 +88,11 @@ namespace Invader::Parser {
         swap_objects_in_array_fn(swap_objects_in_array_fn),
         min_array_size(minimum_array_size),
         max_array_size(maximum_array_size),
-        read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(array) - reinterpret_cast<const std::byte *>(base)) {}
 
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
+        const void *    base,
         const char *    name,
         const char *    member_name,
         const char *    comment,
@@ -95,23 +102,25 @@ namespace Invader::Parser {
         member_name(member_name),
         comment(comment),
         type(ValueType::VALUE_TYPE_TAGSTRING),
-        address(string),
-        read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(string) - reinterpret_cast<const std::byte *>(base)) {}
 
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
+        const void *            base,
         const char *            name,
         const char *            member_name,
         const char *            comment,
-        std::vector<std::byte> *offset,
+        std::vector<std::byte> *data_offset,
         bool                    read_only
     ) : name(name),
         member_name(member_name),
         comment(comment),
         type(ValueType::VALUE_TYPE_TAGDATAOFFSET),
-        address(offset),
-        read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(data_offset) - reinterpret_cast<const std::byte *>(base)) {}
 
-    ParserStructValue::ParserStructValue(
+    ParserStructValue::Descriptor::Descriptor(
+        const void *       base,
         const char *       name,
         const char *       member_name,
         const char *       comment,
@@ -125,39 +134,49 @@ namespace Invader::Parser {
         member_name(member_name),
         comment(comment),
         type(ValueType::VALUE_TYPE_ENUM),
-        address(value),
         list_enum_fn(list_enum_fn),
         list_enum_pretty_fn(list_enum_pretty_fn),
         read_enum_fn(read_enum_fn),
         write_enum_fn(write_enum_fn),
-        read_only(read_only) {}
-
-   ParserStructValue::ParserStructValue(
-       const char *           name,
-       const char *           member_name,
-       const char *           comment,
-       void *                 value,
-       list_enum_fn_type      list_enum_fn,
-       list_enum_fn_type      list_enum_pretty_fn,
-       read_bitfield_fn_type  read_bitfield_fn,
-       write_bitfield_fn_type write_bitfield_fn,
-       bool                   read_only
-   ) : name(name),
-       member_name(member_name),
-       comment(comment),
-       type(ValueType::VALUE_TYPE_BITMASK),
-       address(value),
-       list_enum_fn(list_enum_fn),
-       list_enum_pretty_fn(list_enum_pretty_fn),
-       read_bitfield_fn(read_bitfield_fn),
-       write_bitfield_fn(write_bitfield_fn),
-       read_only(read_only) {}
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(value) - reinterpret_cast<const std::byte *>(base)) {}
+
+    ParserStructValue::Descriptor::Descriptor(
+        const void *           base,
+        const char *           name,
+        const char *           member_name,
+        const char *           comment,
+        void *                 value,
+        list_enum_fn_type      list_enum_fn,
+        list_enum_fn_type      list_enum_pretty_fn,
+        read_bitfield_fn_type  read_bitfield_fn,
+        write_bitfield_fn_type write_bitfield_fn,
+        bool                   read_only
+    ) : name(name),
+        member_name(member_name),
+        comment(comment),
+        type(ValueType::VALUE_TYPE_BITMASK),
+        list_enum_fn(list_enum_fn),
+        list_enum_pretty_fn(list_enum_pretty_fn),
+        read_bitfield_fn(read_bitfield_fn),
+        write_bitfield_fn(write_bitfield_fn),
+        read_only(read_only),
+        offset(reinterpret_cast<const std::byte *>(value) - reinterpret_cast<const std::byte *>(base)) {}
+
+    std::vector<ParserStructValue> ParserStructValue::from_descriptors(const std::vector<Descriptor> &descriptors, void *base) {
+        std::vector<ParserStructValue> values;
+        values.reserve(descriptors.size());
+        for(auto &d : descriptors) {
+            values.emplace_back(d, base);
+        }
+        return values;
+    }
 
     ParserStructValue::NumberFormat ParserStructValue::get_number_format() const noexcept {
-        if(this->type < ValueType::VALUE_TYPE_FLOAT) {
+        if(this->descriptor->type < ValueType::VALUE_TYPE_FLOAT) {
             return NumberFormat::NUMBER_FORMAT_INT;
         }
-        else if(type < ValueType::VALUE_TYPE_REFLEXIVE) {
+        else if(this->descriptor->type < ValueType::VALUE_TYPE_REFLEXIVE) {
             return NumberFormat::NUMBER_FORMAT_FLOAT;
         }
         else {
@@ -166,7 +185,7 @@ namespace Invader::Parser {
     }
 
     std::size_t ParserStructValue::get_value_count() const noexcept {
-        switch(this->type) {
+        switch(this->descriptor->type) {
             case VALUE_TYPE_INT8:
             case VALUE_TYPE_UINT8:
             case VALUE_TYPE_INT16:
@@ -176,49 +195,49 @@ namespace Invader::Parser {
             case VALUE_TYPE_UINT32:
             case VALUE_TYPE_ENUM:
             case VALUE_TYPE_BITMASK:
-                return 1 * this->count;
+                return 1 * this->descriptor->count;
             case VALUE_TYPE_POINT2DINT:
-                return 2 * this->count;
+                return 2 * this->descriptor->count;
             case VALUE_TYPE_RECTANGLE2D:
             case VALUE_TYPE_COLORARGBINT:
-                return 4 * this->count;
+                return 4 * this->descriptor->count;
 
             case VALUE_TYPE_MATRIX:
-                return 9 * this->count;
+                return 9 * this->descriptor->count;
 
             case VALUE_TYPE_FLOAT:
             case VALUE_TYPE_ANGLE:
             case VALUE_TYPE_FRACTION:
-                return 1 * this->count;
+                return 1 * this->descriptor->count;
 
             case VALUE_TYPE_COLORARGB:
-                return 4 * this->count;
+                return 4 * this->descriptor->count;
 
             case VALUE_TYPE_COLORRGB:
-                return 3 * this->count;
+                return 3 * this->descriptor->count;
 
             case VALUE_TYPE_EULER2D:
             case VALUE_TYPE_VECTOR2D:
-                return 2 * this->count;
+                return 2 * this->descriptor->count;
 
             case VALUE_TYPE_EULER3D:
             case VALUE_TYPE_VECTOR3D:
-                return 3 * this->count;
+                return 3 * this->descriptor->count;
 
             case VALUE_TYPE_PLANE2D:
-                return 3 * this->count;
+                return 3 * this->descriptor->count;
 
             case VALUE_TYPE_PLANE3D:
-                return 4 * this->count;
+                return 4 * this->descriptor->count;
 
             case VALUE_TYPE_POINT2D:
-                return 2 * this->count;
+                return 2 * this->descriptor->count;
 
             case VALUE_TYPE_POINT3D:
-                return 3 * this->count;
+                return 3 * this->descriptor->count;
 
             case VALUE_TYPE_QUATERNION:
-                return 4 * this->count;
+                return 4 * this->descriptor->count;
 
             case VALUE_TYPE_REFLEXIVE:
             case VALUE_TYPE_DEPENDENCY:
@@ -240,8 +259,8 @@ namespace Invader::Parser {
 
     void ParserStructValue::get_values(Number *values) const noexcept {
         const auto *addr = reinterpret_cast<const std::byte *>(this->address);
-        for(std::size_t i = 0; i < this->count; i++) {
-            switch(this->type) {
+        for(std::size_t i = 0; i < this->descriptor->count; i++) {
+            switch(this->descriptor->type) {
                 case VALUE_TYPE_INT8:
                     *values = static_cast<std::int64_t>(*reinterpret_cast<const std::int8_t *>(addr));
                     addr += sizeof(std::int8_t);
@@ -459,8 +478,8 @@ namespace Invader::Parser {
 
     void ParserStructValue::set_values(const Number *values) noexcept {
         auto *addr = reinterpret_cast<std::byte *>(this->address);
-        for(std::size_t i = 0; i < this->count; i++) {
-            switch(this->type) {
+        for(std::size_t i = 0; i < this->descriptor->count; i++) {
+            switch(this->descriptor->type) {
                 case VALUE_TYPE_INT8:
                     *reinterpret_cast<std::int8_t *>(addr) = std::get<std::int64_t>(*values);
                     addr += sizeof(std::int8_t);
@@ -704,6 +723,64 @@ namespace Invader::Parser {
         #undef DO_TAG_CLASS
     }
 
+    std::unique_ptr<ParserStruct> ParserStruct::parse_hek_tag_file_base_struct(const std::byte *data, std::size_t data_size, bool postprocess) {
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
+        HEK::TagFileHeader::validate_header(header, data_size);
+
+        #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
+            if(sizeof(Invader::Parser::class_struct::struct_big) > data_size - sizeof(HEK::TagFileHeader)) { \
+                eprintf_error("Failed to read " #class_struct " base struct: %zu bytes needed > %zu bytes available", sizeof(Invader::Parser::class_struct::struct_big), data_size - sizeof(HEK::TagFileHeader)); \
+                throw OutOfBoundsException(); \
+            } \
+            return std::make_unique<Parser::class_struct>(Invader::Parser::class_struct::parse_hek_tag_base_struct(data + sizeof(HEK::TagFileHeader), postprocess)); \
+        }
+
+        switch(header->tag_fourcc) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NONE:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NULL:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_SPHEROID:
+                break;
+        }
+
+        eprintf_error("Unknown tag class %s", tag_fourcc_to_extension(header->tag_fourcc));
+        throw InvalidTagDataException();
+
+        #undef DO_TAG_CLASS
+    }
+
+    void ParserStruct::scan_hek_tag_file_dependencies(const std::byte *data, std::size_t data_size, const DependencyScanFunction &callback) {
+        const auto *header = reinterpret_cast<const HEK::TagFileHeader *>(data);
+        HEK::TagFileHeader::validate_header(header, data_size);
+
+        std::size_t data_read = 0;
+        std::size_t expected_data_read = data_size - sizeof(HEK::TagFileHeader);
+
+        #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
+            Invader::Parser::class_struct::scan_hek_tag_dependencies(data + sizeof(HEK::TagFileHeader), expected_data_read, data_read, callback); \
+            if(data_read != expected_data_read) { \
+                eprintf_error("invalid tag file; tag data was left over"); \
+                throw InvalidTagDataException(); \
+            } \
+            return; \
+        }
+
+        switch(header->tag_fourcc) {
+            DO_BASED_ON_TAG_CLASS
+
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NONE:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_NULL:
+            case Invader::HEK::TagFourCC::TAG_FOURCC_SPHEROID:
+                break;
+        }
+
+        eprintf_error("Unknown tag class %s", tag_fourcc_to_extension(header->tag_fourcc));
+        throw InvalidTagDataException();
+
+        #undef DO_TAG_CLASS
+    }
+
     std::unique_ptr<ParserStruct> ParserStruct::generate_base_struct(TagFourCC tag_class) {
         #define DO_TAG_CLASS(class_struct, fourcc) case TagFourCC::fourcc: { \
             return std::unique_ptr<ParserStruct>(new class_struct()); \
@@ -749,6 +826,30 @@ namespace Invader::Parser {
         return nullptr;
     }
     
+    std::vector<std::byte> ParserStruct::generate_hek_tag_data(std::optional<TagFourCC> generate_header_class, bool clear_on_save) {
+        // Calculate the size up front so everything (including the header) is written into one allocation
+        std::size_t tag_header_size = generate_header_class.has_value() ? sizeof(HEK::TagFileHeader) : 0;
+        std::vector<std::byte> converted_data(tag_header_size + this->calculate_hek_tag_data_size());
+        this->generate_hek_tag_data(converted_data.data(), converted_data.size(), generate_header_class, clear_on_save);
+        return converted_data;
+    }
+
+    std::size_t ParserStruct::generate_hek_tag_data(std::byte *output, std::size_t output_size, std::optional<TagFourCC> generate_header_class, bool clear_on_save) {
+        if(!generate_header_class.has_value()) {
+            return this->write_hek_tag_data(output, output_size, clear_on_save);
+        }
+
+        HEK::TagFileHeader header(*generate_header_class);
+        if(output_size < sizeof(header)) {
+            throw OutOfBoundsException();
+        }
+
+        auto data_size = this->write_hek_tag_data(output + sizeof(header), output_size - sizeof(header), clear_on_save);
+        header.crc32 = ~crc32(0, output + sizeof(header), data_size);
+        std::memcpy(output, &header, sizeof(header));
+        return sizeof(header) + data_size;
+    }
+    
     std::size_t ParserStruct::refactor_reference(const File::TagFilePath &from, const File::TagFilePath &to) {
         return this->refactor_reference(from.path.c_str(), from.fourcc, to.path.c_str(), to.fourcc);
     }
@@ -833,6 +934,111 @@ namespace Invader::Parser {
     static_assert(too_different(-1, 1) == true);
     static_assert(too_different(-0.000025, 0.000025) == false);
     static_assert(too_different(0.000025, -0.000025) == false);
+
+    // Values in a struct that can be compared straight from memory
+    struct FlatCompareSpan {
+        std::size_t offset;
+        std::size_t size;
+        bool floating_point;
+    };
+
+    // Size in bytes of an integer value, or 0 if it isn't one
+    static std::size_t flat_integer_size(const ParserStructValue &value) noexcept {
+        switch(value.get_type()) {
+            case ParserStructValue::ValueType::VALUE_TYPE_INT8:
+            case ParserStructValue::ValueType::VALUE_TYPE_UINT8:
+            case ParserStructValue::ValueType::VALUE_TYPE_COLORARGBINT:
+                return sizeof(std::uint8_t) * value.get_value_count();
+            case ParserStructValue::ValueType::VALUE_TYPE_INT16:
+            case ParserStructValue::ValueType::VALUE_TYPE_UINT16:
+            case ParserStructValue::ValueType::VALUE_TYPE_INDEX:
+            case ParserStructValue::ValueType::VALUE_TYPE_ENUM:
+            case ParserStructValue::ValueType::VALUE_TYPE_BITMASK:
+            case ParserStructValue::ValueType::VALUE_TYPE_POINT2DINT:
+            case ParserStructValue::ValueType::VALUE_TYPE_RECTANGLE2D:
+                return sizeof(std::uint16_t) * value.get_value_count();
+            case ParserStructValue::ValueType::VALUE_TYPE_INT32:
+            case ParserStructValue::ValueType::VALUE_TYPE_UINT32:
+                return sizeof(std::uint32_t) * value.get_value_count();
+            default:
+                return 0;
+        }
+    }
+
+    // Get where each value compare() looks at is in the struct, if they're all numbers, merging values that are next to
+    // each other so they can be compared in one go
+    static std::optional<std::vector<FlatCompareSpan>> flat_compare_layout(const ParserStruct &what, bool ignore_volatile) {
+        const auto *base = reinterpret_cast<const std::byte *>(&what);
+        std::vector<FlatCompareSpan> layout;
+
+        for(auto &value : what.get_values()) {
+            auto type = value.get_type();
+            if(type == ParserStructValue::ValueType::VALUE_TYPE_GROUP_START || type == ParserStructValue::ValueType::VALUE_TYPE_TAGID || (ignore_volatile && value.is_volatile())) {
+                continue;
+            }
+
+            FlatCompareSpan span;
+            span.offset = static_cast<std::size_t>(reinterpret_cast<const std::byte *>(value.get_address()) - base);
+            span.floating_point = value.get_number_format() == ParserStructValue::NumberFormat::NUMBER_FORMAT_FLOAT;
+            if(span.floating_point) {
+                span.size = value.get_value_count() * sizeof(float);
+            }
+            else if((span.size = flat_integer_size(value)) == 0) {
+                return std::nullopt;
+            }
+
+            if(!layout.empty() && layout.back().floating_point == span.floating_point && layout.back().offset + layout.back().size == span.offset) {
+                layout.back().size += span.size;
+            }
+            else {
+                layout.emplace_back(span);
+            }
+        }
+
+        return layout;
+    }
+
+    // Check if compare() would find two structs with this layout to be the same. Floats are checked in single precision
+    // without stopping at the first difference so the compiler can vectorize it. With precision, the tolerance is a bit
+    // looser than too_different() so this never misses a difference; anything close to it is left to compare().
+    static bool flat_compare(const std::vector<FlatCompareSpan> &layout, const ParserStruct &a, const ParserStruct &b, bool precision) noexcept {
+        const auto *a_base = reinterpret_cast<const std::byte *>(&a);
+        const auto *b_base = reinterpret_cast<const std::byte *>(&b);
+
+        for(auto &span : layout) {
+            if(!span.floating_point) {
+                if(std::memcmp(a_base + span.offset, b_base + span.offset, span.size) != 0) {
+                    return false;
+                }
+                continue;
+            }
+
+            const auto *a_floats = reinterpret_cast<const float *>(a_base + span.offset);
+            const auto *b_floats = reinterpret_cast<const float *>(b_base + span.offset);
+            std::size_t count = span.size / sizeof(float);
+            unsigned int different = 0;
+
+            if(precision) {
+                static constexpr const float delta = 0.0001F * 0.999F;
+                for(std::size_t i = 0; i < count; i++) {
+                    float max_discrepency = std::fabs(a_floats[i] * delta);
+                    float difference = std::fabs(a_floats[i] - b_floats[i]);
+                    different |= (difference > delta) & (difference > max_discrepency);
+                }
+            }
+            else {
+                for(std::size_t i = 0; i < count; i++) {
+                    different |= a_floats[i] != b_floats[i];
+                }
+            }
+
+            if(different) {
+                return false;
+            }
+        }
+
+        return true;
+    }
     
     bool ParserStruct::compare(const ParserStruct *what, bool precision, bool ignore_volatile, std::list<std::string> *differences_array, std::size_t depth) const {
         // Different struct name
@@ -1013,10 +1219,17 @@ namespace Invader::Parser {
                         
                         depth++;
                         
+                        // If the elements only have numbers, check them from memory first and only go through each value of the ones that differ
+                        auto flat_layout = vt_count > 0 ? flat_compare_layout(vt.get_object_in_array(0), ignore_volatile) : std::nullopt;
+                        
                         for(std::size_t i = 0; i < vt_count && should_continue; i++) {
                             const auto &vt_struct = vt.get_object_in_array(i);
                             const auto &vo_struct = vo.get_object_in_array(i);
                             
+                            if(flat_layout.has_value() && flat_compare(*flat_layout, vt_struct, vo_struct, precision)) {
+                                continue;
+                            }
+                            
                             // This will be filled if we're doing a verbose check
                             std::list<std::string> differences_this;
                             
@@ -1351,7 +1564,80 @@ namespace Invader::Parser {
         
         return !is_different;
     }
-    
+
+    std::uint64_t ParserStruct::content_hash() const {
+        const char *name = this->struct_name();
+        FNV1AHash hash;
+        hash.add_bytes(name, std::strlen(name));
+
+        for(auto &value : this->get_values()) {
+            auto type = value.get_type();
+            hash.add_value(static_cast<std::uint32_t>(type));
+
+            switch(type) {
+                case ParserStructValue::VALUE_TYPE_GROUP_START:
+                case ParserStructValue::VALUE_TYPE_TAGID:
+                    break;
+
+                case ParserStructValue::VALUE_TYPE_REFLEXIVE: {
+                    auto count = value.get_array_size();
+                    hash.add_value(static_cast<std::uint64_t>(count));
+                    for(std::size_t i = 0; i < count; i++) {
+                        hash.add_value(value.get_object_in_array(i).content_hash());
+                    }
+                    break;
+                }
+
+                case ParserStructValue::VALUE_TYPE_DEPENDENCY: {
+                    // Null dependencies are equal regardless of class (see Dependency::operator==)
+                    auto &dependency = value.get_dependency();
+                    hash.add_value(static_cast<std::uint64_t>(dependency.path.size()));
+                    if(!dependency.path.empty()) {
+                        hash.add_value(dependency.tag_fourcc);
+                        hash.add_bytes(dependency.path.data(), dependency.path.size());
+                    }
+                    break;
+                }
+
+                case ParserStructValue::VALUE_TYPE_TAGSTRING: {
+                    const char *string = value.get_string();
+                    hash.add_bytes(string, std::strlen(string) + 1);
+                    break;
+                }
+
+                case ParserStructValue::VALUE_TYPE_TAGDATAOFFSET: {
+                    auto &data = value.get_data();
+                    hash.add_value(static_cast<std::uint64_t>(data.size()));
+                    hash.add_bytes(data.data(), data.size());
+                    break;
+                }
+
+                default: {
+                    ParserStructValue::Number numbers[64];
+                    auto count = value.get_value_count();
+                    if(count > sizeof(numbers) / sizeof(*numbers)) {
+                        eprintf_error("Too many values to hash in %s::%s", name, value.get_member_name());
+                        std::terminate();
+                    }
+                    value.get_values(numbers);
+                    for(std::size_t i = 0; i < count; i++) {
+                        if(auto *integer = std::get_if<std::int64_t>(numbers + i)) {
+                            hash.add_value(*integer);
+                        }
+                        else {
+                            // Hash -0.0 and 0.0 the same since they compare the same
+                            auto real = std::get<double>(numbers[i]);
+                            hash.add_value(real == 0.0 ? 0.0 : real);
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        return hash.get();
+    }
+
     bool ParserStruct::check_for_broken_enums(bool reset_enums) {
         auto &values = this->get_values();
         bool result = false;
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstdlib>
+
+#include <invader/thread_pool.hpp>
+
+namespace Invader {
+    static std::atomic<std::size_t> shared_thread_count = 0;
+
+    static std::size_t default_thread_count() noexcept {
+        if(auto count = shared_thread_count.load(); count > 0) {
+            return count;
+        }
+
+        // Let the environment decide if it wants to
+        if(const char *environment_count = std::getenv("INVADER_THREADS"); environment_count != nullptr) {
+            char *end = nullptr;
+            auto count = std::strtoul(environment_count, &end, 10);
+            if(end != environment_count && *end == 0 && count > 0) {
+                return count;
+            }
+        }
+
+        return std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    ThreadPool &ThreadPool::shared() {
+        static ThreadPool pool(default_thread_count());
+        return pool;
+    }
+
+    void ThreadPool::set_shared_thread_count(std::size_t thread_count) noexcept {
+        shared_thread_count = std::max(thread_count, static_cast<std::size_t>(1));
+    }
+
+    std::size_t ThreadPool::get_shared_thread_count() noexcept {
+        return default_thread_count();
+    }
+
+    ThreadPool::ThreadPool(std::size_t thread_count) {
+        // The thread calling parallel_for() is one of the threads
+        thread_count = std::max(thread_count, static_cast<std::size_t>(1));
+        this->workers.reserve(thread_count - 1);
+        for(std::size_t t = 1; t < thread_count; t++) {
+            this->workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->job_available.notify_all();
+        for(auto &w : this->workers) {
+            w.join();
+        }
+    }
+
+    void ThreadPool::run_job(Job &job) noexcept {
+        for(std::size_t i; (i = job.next++) < job.count;) {
+            try {
+                (*job.function)(i);
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(job.exception_mutex);
+                if(!job.exception) {
+                    job.exception = std::current_exception();
+                }
+                job.next = job.count;
+            }
+        }
+    }
+
+    void ThreadPool::parallel_for(std::size_t count, const std::function<void (std::size_t)> &function, std::size_t max_threads) {
+        Job job;
+        job.function = &function;
+        job.count = count;
+        job.memory_usage_category = MemoryUsage::get_current_category();
+        auto thread_count = std::min({ max_threads, count, this->get_thread_count() });
+        job.helpers_wanted = thread_count > 1 ? thread_count - 1 : 0;
+
+        // Let idle workers help
+        bool queued = job.helpers_wanted > 0;
+        if(queued) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->jobs.push_back(&job);
+            }
+            this->job_available.notify_all();
+        }
+
+        run_job(job);
+
+        // Stop more workers from picking it up and wait for the ones that did
+        if(queued) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            auto position = std::find(this->jobs.begin(), this->jobs.end(), &job);
+            if(position != this->jobs.end()) {
+                this->jobs.erase(position);
+            }
+            this->helper_done.wait(lock, [&job]() { return job.helpers_working == 0; });
+        }
+
+        if(job.exception) {
+            std::rethrow_exception(job.exception);
+        }
+    }
+
+    void ThreadPool::work() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true) {
+            this->job_available.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+            if(this->stopping) {
+                return;
+            }
+
+            // Take a helper slot in the oldest job, removing it once it has all the help it wants
+            auto &job = *this->jobs.front();
+            if(--job.helpers_wanted == 0) {
+                this->jobs.pop_front();
+            }
+            job.helpers_working++;
+
+            // Anything allocated while helping counts towards what the thread that started the job was doing
+            lock.unlock();
+            {
+                MemoryUsage::Scope memory_usage_scope(job.memory_usage_category);
+                run_job(job);
+            }
+            lock.lock();
+
+            if(--job.helpers_working == 0) {
+                this->helper_done.notify_all();
+            }
+        }
+    }
+}